@@ -4,6 +4,7 @@
 
 use std::fs::File;
 use std::io::{BufReader, Write};
+use std::path::Path;
 use std::rc::Rc;
 
 use pico_args::Arguments;
@@ -13,7 +14,7 @@ use simlin_compat::engine::{
     eprintln, serde, ErrorCode, Project, Results, Simulation, Variable, Vm,
 };
 use simlin_compat::prost::Message;
-use simlin_compat::{load_csv, open_vensim, open_xmile, to_xmile};
+use simlin_compat::{load_csv, open_vensim, open_vensim_file, open_xmile, to_xmile};
 
 const VERSION: &str = "1.0";
 const EXIT_FAILURE: i32 = 1;
@@ -211,13 +212,17 @@ fn main() {
         }
     };
     let file_path = args.path.unwrap_or_else(|| "/dev/stdin".to_string());
-    let file = File::open(&file_path).unwrap();
-    let mut reader = BufReader::new(file);
 
-    let project = if args.is_vensim {
-        open_vensim(&mut reader)
+    let project = if args.is_vensim && file_path != "/dev/stdin" {
+        open_vensim_file(Path::new(&file_path))
     } else {
-        open_xmile(&mut reader)
+        let file = File::open(&file_path).unwrap();
+        let mut reader = BufReader::new(file);
+        if args.is_vensim {
+            open_vensim(&mut reader)
+        } else {
+            open_xmile(&mut reader)
+        }
     };
 
     if project.is_err() {
@@ -42,6 +42,26 @@ pub fn open_vensim(reader: &mut dyn BufRead) -> Result<Project> {
     xmile::project_from_reader(&mut f)
 }
 
+/// Like `open_vensim` but converting the file at `path` directly, without
+/// first reading it into memory.
+#[cfg(feature = "vensim")]
+pub fn open_vensim_file(path: &std::path::Path) -> Result<Project> {
+    use std::io::BufReader;
+
+    use simlin_engine::common::{Error, ErrorCode, ErrorKind};
+    use xmutil::convert_vensim_mdl_file;
+
+    let xmile_src = convert_vensim_mdl_file(path, false, 0).map_err(|err| {
+        Error::new(
+            ErrorKind::Import,
+            ErrorCode::VensimConversion,
+            Some(err.to_string()),
+        )
+    })?;
+    let mut f = BufReader::new(xmile_src.as_bytes());
+    xmile::project_from_reader(&mut f)
+}
+
 pub fn open_xmile(reader: &mut dyn BufRead) -> Result<Project> {
     xmile::project_from_reader(reader)
 }
@@ -0,0 +1,33 @@
+#!/bin/sh
+# builds xmutil.wasm, and xmutil.simd.wasm for browsers with SIMD128, from
+# the C++ in ../xmutil/third_party with emscripten - run it after changing
+# the C++ and check in the two files it writes
+set -e
+
+cd "$(dirname "$0")"
+src=../xmutil/third_party
+
+# everything XMUtil.h exports, so a new entry point is in the next build
+exports=$(sed -n 's/^XMUTIL_EXPORT[^(]*[ *]\([A-Za-z_0-9]*\)(.*/"_\1",/p' "$src/xmutil/XMUtil.h" | tr -d '\n')
+exports="[${exports}\"_malloc\",\"_free\"]"
+
+build() {
+  out=$1
+  shift
+  objs=$(mktemp -d)
+  for c in "$src"/libutf/*.c; do
+    emcc -O2 "$@" -Wno-parentheses -Wno-sign-compare -c "$c" -o "$objs/$(basename "$c").o"
+  done
+  for cpp in "$src"/tinyxml2/tinyxml2.cpp $(find "$src/xmutil" -name '*.cpp' | sort); do
+    em++ -O2 "$@" -std=c++14 -I"$src/tinyxml2" -I"$src" -w -c "$cpp" \
+      -o "$objs/$(echo "$cpp" | tr / _).o"
+  done
+  # a reactor, loaded without emscripten's JS - the table can grow for
+  # the progress callback (see progressFunction in index.ts)
+  em++ -O2 "$@" --no-entry -sSTANDALONE_WASM -sALLOW_MEMORY_GROWTH -sALLOW_TABLE_GROWTH \
+    -sEXPORTED_FUNCTIONS="$exports" "$objs"/*.o -o "$out"
+  rm -rf "$objs"
+}
+
+build xmutil.wasm
+build xmutil.simd.wasm -msimd128
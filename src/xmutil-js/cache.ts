@@ -0,0 +1,69 @@
+// Copyright 2021 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+// Where convertMdlToXmile can keep finished conversions, keyed by
+// cacheKey.  Failed conversions are never stored.
+export interface XmileCache {
+  get(key: string): string | undefined;
+  set(key: string, xmile: string): void;
+}
+
+// The version of what the converter writes, so conversions kept by an
+// older build aren't returned by a newer one - goes up with
+// CONVERTER_VERSION in the xmutil crate's cache.rs.
+export const converterVersion = 1;
+
+// Two FNV-1a passes with different offset bases over the MDL bytes, plus
+// the length, options and converterVersion, so the same model converted
+// the same way always maps to the same key.
+export function cacheKey(mdlSource: Readonly<Uint8Array>, isCompact: boolean, flags = 0): string {
+  let h1 = 0x811c9dc5;
+  let h2 = 0x050c5d1f;
+  for (let i = 0; i < mdlSource.length; i++) {
+    h1 = Math.imul(h1 ^ mdlSource[i], 0x01000193);
+    h2 = Math.imul(h2 ^ mdlSource[i], 0x01000193);
+  }
+  const hex = (h: number) => (h >>> 0).toString(16).padStart(8, '0');
+  const options = `${(flags >>> 0).toString(16)}${isCompact ? 'c' : 'p'}-v${converterVersion}`;
+  return `${hex(h1)}${hex(h2)}-${mdlSource.length.toString(16)}-${options}`;
+}
+
+// Keeps conversions in memory, dropping the least recently used once the
+// XMILE held goes over budget characters.
+export class MemoryXmileCache implements XmileCache {
+  private readonly entries = new Map<string, string>();
+  private used = 0;
+
+  constructor(private readonly budget: number) {}
+
+  get(key: string): string | undefined {
+    const xmile = this.entries.get(key);
+    if (xmile !== undefined) {
+      // Maps iterate in insertion order, so this makes it the newest
+      this.entries.delete(key);
+      this.entries.set(key, xmile);
+    }
+    return xmile;
+  }
+
+  set(key: string, xmile: string): void {
+    if (xmile.length > this.budget) {
+      return;
+    }
+    const old = this.entries.get(key);
+    if (old !== undefined) {
+      this.entries.delete(key);
+      this.used -= old.length;
+    }
+    for (const [oldestKey, oldest] of this.entries) {
+      if (this.used + xmile.length <= this.budget) {
+        break;
+      }
+      this.entries.delete(oldestKey);
+      this.used -= oldest.length;
+    }
+    this.entries.set(key, xmile);
+    this.used += xmile.length;
+  }
+}
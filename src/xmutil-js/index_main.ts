@@ -2,9 +2,45 @@
 // Use of this source code is governed by the Apache License,
 // Version 2.0, that can be found in the LICENSE file.
 
-import { promises as fs } from 'fs';
+import { promises as fs, readFileSync, renameSync, writeFileSync, mkdirSync } from 'fs';
 import { join } from 'path';
 
+  if (!module) {
+    return import('./xmutil.wasm');
+  }
+  return instantiateWasm<typeof import('./xmutil.wasm')>(module);
+}
+export type { XmileCache } from './cache';
+export { MemoryXmileCache, cacheKey, converterVersion } from './cache';
+
+// Keeps conversions as files in a directory, one per key, so they outlive
+// the process.  Errors reading or writing are treated as misses.
+export class DirXmileCache implements XmileCache {
+  constructor(private readonly dir: string) {
+    mkdirSync(dir, { recursive: true });
+  }
+
+  get(key: string): string | undefined {
+    try {
+      return readFileSync(join(this.dir, `${key}.xmile`), 'utf-8');
+    } catch {
+      return undefined;
+    }
+  }
+
+  set(key: string, xmile: string): void {
+    // write then rename so a reader never sees half a file
+    const path = join(this.dir, `${key}.xmile`);
+    const tmp = `${path}.tmp${process.pid}`;
+    try {
+      writeFileSync(tmp, xmile);
+      renameSync(tmp, path);
+    } catch {
+      // an unwritable cache just means converting again next time
+    }
+  }
+}
+
 export function defined<T>(object: T | undefined): T {
   if (object === undefined) {
     throw new Error('expected non-undefined object');
@@ -12,25 +48,69 @@ export function defined<T>(object: T | undefined): T {
   return object;
 }
 
+// where the wasm comes from if not xmutil.wasm beside this file - see
+// configureWasm
+export interface WasmOptions {
+  // the path of xmutil.wasm
+  path?: string;
+  // a build of the same sources with SIMD128, used instead of path where
+  // node has it
+  simdPath?: string;
+  // already compiled, as compiledWasmModule gives it - handed to a worker
+  // thread so it doesn't compile the same code again
+  module?: WebAssembly.Module;
+}
+
+let wasmOptions: WasmOptions = {};
+
+// how the wasm is loaded - only has an effect before the first conversion
+// or warmUp
+export function configureWasm(options: WasmOptions): void {
+  wasmOptions = options;
+}
+
+// i8x16.popcnt of a v128 const - valid only where node has SIMD128
+// prettier-ignore
+const simdTest = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, // magic, version
+  0x01, 0x05, 0x01, 0x60, 0x00, 0x01, 0x7b, 0x03, 0x02, 0x01, 0x00, // () -> v128
+  0x0a, 0x0a, 0x01, 0x08, 0x00, 0x41, 0x00, 0xfd, 0x0f, 0xfd, 0x62, 0x0b,
+]);
+
+// the module compiled once per process, for every thread given it
+let pendingCompile: Promise<WebAssembly.Module> | undefined;
+export function compiledWasmModule(): Promise<WebAssembly.Module> {
+  if (!pendingCompile) {
+    const { path = join(__dirname, 'xmutil.wasm'), simdPath, module } = wasmOptions;
+    const source = simdPath && WebAssembly.validate(simdTest) ? simdPath : path;
+    pendingCompile = module
+      ? Promise.resolve(module)
+      : fs.readFile(source).then((contents) => WebAssembly.compile(contents));
+    // a failed compile is tried again next time
+    pendingCompile.catch(() => (pendingCompile = undefined));
+  }
+  return pendingCompile;
+}
+
 let cachedWasmModule: typeof import('./xmutil.wasm') | undefined;
+let pendingWasmModule: Promise<typeof import('./xmutil.wasm')> | undefined;
 function getWasmModule(): Promise<typeof import('./xmutil.wasm')> {
-  return new Promise((resolve, reject) => {
-    if (cachedWasmModule) {
-      resolve(cachedWasmModule);
-      return;
-    }
+  if (!pendingWasmModule) {
+    pendingWasmModule = compiledWasmModule()
+      .then((module) => instantiateWasm<typeof import('./xmutil.wasm')>(module))
+      .then((wasm) => {
+        cachedWasmModule = wasm;
+        return wasm;
+      });
+    pendingWasmModule.catch(() => (pendingWasmModule = undefined));
+  }
+  return pendingWasmModule;
+}
 
-    fs.readFile(join(__dirname, 'xmutil.wasm'))
-      .then((contents) => {
-        WebAssembly.instantiate(contents)
-          .then((source) => {
-            cachedWasmModule = (source.instance.exports as unknown) as typeof import('./xmutil.wasm');
-            resolve(cachedWasmModule);
-          })
-          .catch(reject);
-      })
-      .catch(reject);
-  });
+// loads and compiles the wasm now rather than when the first model is
+// converted
+export async function warmUp(): Promise<void> {
+  await getWasmModule();
 }
 
 const cachedTextEncoder = new TextEncoder();
@@ -45,30 +125,240 @@ function getUint8Memory0() {
   return cachegetUint8Memory0;
 }
 
-function getStringFromWasm(ptr: number) {
+// the bytes of the string at ptr - up to its terminator unless the length
+// is already known
+function getStringFromWasm(ptr: number, len?: number) {
   const mem = getUint8Memory0();
-  let off = 0;
-  while (mem[ptr + off] !== 0) {
-    off++;
+  const end = len === undefined ? mem.indexOf(0, ptr) : ptr + len;
+  return mem.subarray(ptr, end);
+}
+
+// how far a conversion has got - see XMUTIL_PROGRESS_ in XMUtil.h
+export interface ConversionProgress {
+  stage: 'bytes' | 'equations' | 'views';
+  done: number;
+  total: number; // 0 for equations, which aren't counted until they are all read
+}
+const progressStages: ConversionProgress['stage'][] = ['bytes', 'equations', 'views'];
+
+// a wasm module exporting the one function it imports - a JS function
+// can only go in the conversion's function table, to be called back from
+// C++, as a wasm function.  The type is (i32 context, i32 stage, i32 done,
+// i32 total) -> ()
+// prettier-ignore
+const progressTrampoline = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, // magic, version
+  0x01, 0x08, 0x01, 0x60, 0x04, 0x7f, 0x7f, 0x7f, 0x7f, 0x00, // types
+  0x02, 0x07, 0x01, 0x01, 0x65, 0x01, 0x66, 0x00, 0x00, // import e.f
+  0x07, 0x05, 0x01, 0x01, 0x66, 0x00, 0x00, // export f
+]);
+
+// what the function in the table passes each report on to - only set while
+// a conversion is running, and conversions don't overlap
+let progressCallback: ((progress: ConversionProgress) => void) | undefined;
+let progressSlot: number | undefined;
+function progressFunction(table: WebAssembly.Table): number {
+  if (progressSlot === undefined) {
+    const report = (_context: number, stage: number, done: number, total: number) => {
+      progressCallback?.({ stage: progressStages[stage], done: done >>> 0, total: total >>> 0 });
+    };
+    const trampoline = new WebAssembly.Instance(new WebAssembly.Module(progressTrampoline), { e: { f: report } });
+    progressSlot = table.grow(1);
+    table.set(progressSlot, trampoline.exports.f as (...args: number[]) => void);
+  }
+  return progressSlot;
+}
+
+// hands take the XMILE for the MDL already copied to mdlSourcePtr, still
+// in the wasm heap, and returns what it gives back - undefined if the MDL
+// couldn't be converted.  Builds with _convert_mdl_to_xmile_v2 hand back the
+// length so the result isn't scanned for its end, and builds with
+// _convert_mdl_to_xmile_progress report to onProgress as they go
+function convertInWasm<T>(
+  wasm: typeof import('./xmutil.wasm'),
+  mdlSourcePtr: number,
+  len: number,
+  isCompact: boolean,
+  take: (xmile: Uint8Array) => T,
+  onProgress?: (progress: ConversionProgress) => void,
+): T | undefined {
+  const progress = onProgress && wasm.__indirect_function_table && wasm._convert_mdl_to_xmile_progress;
+  if ((progress || wasm._convert_mdl_to_xmile_v2) && wasm.xmutil_free_result) {
+    const outPtr = wasm.malloc(8); // char *xmile, size_t xmileLen
+    let status: number;
+    if (progress) {
+      const fn = progressFunction(defined(wasm.__indirect_function_table));
+      progressCallback = onProgress;
+      try {
+        status = progress(mdlSourcePtr, len, isCompact, 0, fn, 0, outPtr, outPtr + 4);
+      } finally {
+        progressCallback = undefined;
+      }
+    } else {
+      status = defined(wasm._convert_mdl_to_xmile_v2)(mdlSourcePtr, len, isCompact, 0, outPtr, outPtr + 4);
+    }
+    const out = new DataView(wasm.memory.buffer, outPtr, 8);
+    const resultPtr = out.getUint32(0, true);
+    const resultLen = out.getUint32(4, true);
+    wasm.free(outPtr);
+    const xmile = status === 0 ? take(getStringFromWasm(resultPtr, resultLen)) : undefined;
+    wasm.xmutil_free_result(resultPtr);
+    return xmile;
   }
-  return getUint8Memory0().subarray(ptr / 1, ptr / 1 + off);
+
+  const resultPtr = wasm._convert_mdl_to_xmile(mdlSourcePtr, len, isCompact);
+  if (!resultPtr) {
+    return undefined;
+  }
+  const xmile = take(getStringFromWasm(resultPtr));
+  wasm.free(resultPtr);
+  return xmile;
+}
+
+// copies mdlSource into the wasm heap and converts it - builds with
+// xmutil_input_buffer keep one buffer for the MDL across conversions, so
+// importing model after model doesn't keep growing the heap
+async function convertBytes<T>(
+  mdlSource: Readonly<Uint8Array>,
+  isCompact: boolean,
+  take: (xmile: Uint8Array) => T,
+  onProgress?: (progress: ConversionProgress) => void,
+): Promise<T | undefined> {
+  const wasm = await getWasmModule();
+
+  const inputBuffer = wasm.xmutil_input_buffer?.(mdlSource.length);
+  const mdlSourcePtr = inputBuffer || wasm.malloc(mdlSource.length);
+  getUint8Memory0().set(mdlSource, mdlSourcePtr);
+
+  const xmile = convertInWasm(wasm, mdlSourcePtr, mdlSource.length, isCompact, take, onProgress);
+  if (!inputBuffer) {
+    wasm.free(mdlSourcePtr);
+  }
+  return xmile;
+}
+
+// if a cache is given, a model already converted with the same options
+// is returned from it rather than converted again.
+export async function convertMdlToXmile(
+  mdlSource: string | Readonly<Uint8Array>,
+  pretty = true,
+  cache?: XmileCache,
+): Promise<string> {
+  if (typeof mdlSource === 'string') {
+    mdlSource = cachedTextEncoder.encode(mdlSource);
+  }
+
+  const key = cache ? cacheKey(mdlSource, !pretty, 0) : '';
+  const cached = cache?.get(key);
+  if (cached !== undefined) {
+    return cached;
+  }
+
+  const xmile = (await convertBytes(mdlSource, !pretty, (bytes) => cachedTextDecoder.decode(bytes))) ?? '';
+
+  if (cache && xmile.length > 0) {
+    cache.set(key, xmile);
+  }
+  return xmile;
 }
 
-export async function convertMdlToXmile(mdlSource: string | Readonly<Uint8Array>, pretty = true): Promise<string> {
+// as convertMdlToXmile (without a cache) but giving back the XMILE as
+// UTF-8, empty if the MDL couldn't be converted, and calling onProgress as
+// the conversion goes with builds that report how far they have got
+export async function convertMdlToXmileBytes(
+  mdlSource: string | Readonly<Uint8Array>,
+  pretty = true,
+  onProgress?: (progress: ConversionProgress) => void,
+): Promise<Uint8Array> {
   if (typeof mdlSource === 'string') {
     mdlSource = cachedTextEncoder.encode(mdlSource);
   }
+  const xmile = await convertBytes(mdlSource, !pretty, (bytes) => bytes.slice(), onProgress);
+  return xmile ?? new Uint8Array(0);
+}
+
+// what a conversion did and where its time went - see XMUtilStats in
+// XMUtil.h.  Work on the extra threads a large model is written with
+// isn't counted
+export interface ConversionStats {
+  inputBytes: number;
+  tokens: number;
+  lookups: number;
+  lookupMisses: number;
+  recoverySkips: number;
+  variables: number;
+  outputBytes: number;
+  readSeconds: number;
+  equationSeconds: number;
+  markTypesSeconds: number;
+  attachSeconds: number;
+  printSeconds: number;
+  printVariablesSeconds: number;
+  printViewsSeconds: number;
+}
 
+// in the order XMUtilStats has them - the counts as uint64s, then the
+// seconds as float64s
+const statsCounts = ['inputBytes', 'tokens', 'lookups', 'lookupMisses', 'recoverySkips', 'variables', 'outputBytes'];
+const statsSeconds = [
+  'readSeconds',
+  'equationSeconds',
+  'markTypesSeconds',
+  'attachSeconds',
+  'printSeconds',
+  'printVariablesSeconds',
+  'printViewsSeconds',
+];
+// and then the allocation counts, which wasm builds leave at 0 - three
+// arrays by stage, retainedBytes and allocationsCounted
+const statsAllocationWords = 3 * 5 + 2;
+const statsSize = 8 * (statsCounts.length + statsSeconds.length + statsAllocationWords);
+
+// as convertMdlToXmile (without a cache) but also counting what the
+// conversion did.  The stats are undefined with builds from before
+// _convert_mdl_to_xmile_stats, which are converted as usual
+export async function convertMdlToXmileWithStats(
+  mdlSource: string | Readonly<Uint8Array>,
+  pretty = true,
+): Promise<[string, ConversionStats | undefined]> {
   const wasm = await getWasmModule();
+  if (!wasm._convert_mdl_to_xmile_stats) {
+    return [await convertMdlToXmile(mdlSource, pretty), undefined];
+  }
+  if (typeof mdlSource === 'string') {
+    mdlSource = cachedTextEncoder.encode(mdlSource);
+  }
 
-  const mdlSourcePtr = wasm.malloc(mdlSource.length);
-  getUint8Memory0()
-    .subarray(mdlSourcePtr, mdlSourcePtr + mdlSource.length)
-    .set(mdlSource);
+  const inputBuffer = wasm.xmutil_input_buffer?.(mdlSource.length);
+  const mdlSourcePtr = inputBuffer || wasm.malloc(mdlSource.length);
+  getUint8Memory0().set(mdlSource, mdlSourcePtr);
 
-  const resultPtr = wasm._convert_mdl_to_xmile(mdlSourcePtr, mdlSource.length, !pretty);
-  const resultBuf = getStringFromWasm(resultPtr);
-  wasm.free(resultPtr);
+  const statsPtr = wasm.malloc(statsSize);
+  const resultPtr = wasm._convert_mdl_to_xmile_stats(mdlSourcePtr, mdlSource.length, !pretty, 0, statsPtr);
+  const view = new DataView(wasm.memory.buffer, statsPtr, statsSize);
+  const stats: Record<string, number> = {};
+  statsCounts.forEach((name, i) => {
+    stats[name] = view.getUint32(8 * i, true) + view.getUint32(8 * i + 4, true) * 2 ** 32;
+  });
+  statsSeconds.forEach((name, i) => {
+    stats[name] = view.getFloat64(8 * (statsCounts.length + i), true);
+  });
+  wasm.free(statsPtr);
+  if (!inputBuffer) {
+    wasm.free(mdlSourcePtr);
+  }
+
+  let xmile = '';
+  if (resultPtr) {
+    xmile = cachedTextDecoder.decode(getStringFromWasm(resultPtr));
+    wasm.free(resultPtr);
+  }
+  return [xmile, (stats as unknown) as ConversionStats];
+}
 
-  return cachedTextDecoder.decode(resultBuf);
+// gives back the buffer convertMdlToXmile keeps for MDL sources, for when
+// no more models are going to be imported for a while.  The next
+// conversion allocates a new one
+export function releaseInputBuffer(): void {
+  cachedWasmModule?.xmutil_release_input_buffer?.();
 }
@@ -0,0 +1,69 @@
+// Copyright 2021 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+// build-wasm.sh links a standalone reactor, which imports whatever WASI
+// functions the C++ library it pulls in calls - timing the stages reads
+// the clock, and anything printed goes through fd_write.  The converter
+// reads no files and has nowhere to print to, so the clock and the
+// process's (empty) arguments and environment are given, output is
+// dropped and the rest report ENOSYS.
+const wasiModule = 'wasi_snapshot_preview1';
+const ENOSYS = 52;
+
+type WasiFunction = (...args: (number | bigint)[]) => number | undefined;
+
+function wasiImports(module: WebAssembly.Module, memory: () => WebAssembly.Memory): WebAssembly.Imports {
+  const view = () => new DataView(memory().buffer);
+  const empty = (countPtr: number, sizePtr: number) => {
+    view().setUint32(countPtr, 0, true);
+    view().setUint32(sizePtr, 0, true);
+    return 0;
+  };
+  const given: Record<string, WasiFunction> = {
+    args_get: () => 0,
+    args_sizes_get: empty as WasiFunction,
+    environ_get: () => 0,
+    environ_sizes_get: empty as WasiFunction,
+    clock_time_get: ((id: number, _precision: bigint, timePtr: number) => {
+      // 0 is the wall clock, the rest only need to move on steadily
+      const ms = id === 0 ? Date.now() : performance.now();
+      view().setBigUint64(timePtr, BigInt(Math.round(ms * 1e6)), true);
+      return 0;
+    }) as WasiFunction,
+    fd_write: ((_fd: number, iovs: number, iovsLen: number, writtenPtr: number) => {
+      let written = 0;
+      for (let i = 0; i < iovsLen; i++) {
+        written += view().getUint32(iovs + 8 * i + 4, true);
+      }
+      view().setUint32(writtenPtr, written, true);
+      return 0;
+    }) as WasiFunction,
+    proc_exit: ((code: number) => {
+      throw new Error(`xmutil exited with status ${code}`);
+    }) as WasiFunction,
+  };
+  const wasi: Record<string, WasiFunction> = {};
+  for (const { module: from, name, kind } of WebAssembly.Module.imports(module)) {
+    if (from === wasiModule && kind === 'function') {
+      wasi[name] = given[name] ?? (() => ENOSYS);
+    }
+  }
+  return Object.keys(wasi).length ? { [wasiModule]: wasi } : {};
+}
+
+// instantiates a compiled xmutil.wasm, with the WASI functions it imports
+// and its static constructors run, as a reactor needs before anything else
+export async function instantiateWasm<T>(module: WebAssembly.Module): Promise<T> {
+  let memory: WebAssembly.Memory | undefined;
+  const imports = wasiImports(module, () => {
+    if (!memory) {
+      throw new Error('xmutil called WASI before it was instantiated');
+    }
+    return memory;
+  });
+  const instance = await WebAssembly.instantiate(module, imports);
+  memory = instance.exports.memory as WebAssembly.Memory;
+  (instance.exports._initialize as (() => void) | undefined)?.();
+  return (instance.exports as unknown) as T;
+}
@@ -0,0 +1,27 @@
+// Copyright 2021 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+// the script for a Web Worker converting models off the main thread, for
+// convertMdlToXmileInWorker - the wasm module is loaded in the worker the
+// first time it is asked to convert something
+
+import type { ConversionProgress, WorkerRequest, WorkerResponse } from './index';
+import { convertMdlToXmileBytes } from './index';
+
+interface WorkerScope {
+  onmessage: ((event: MessageEvent<WorkerRequest>) => void) | null;
+  postMessage(message: WorkerResponse, transfer: Transferable[]): void;
+}
+const scope = (self as unknown) as WorkerScope;
+
+scope.onmessage = (event: MessageEvent<WorkerRequest>) => {
+  const { id, mdl, pretty } = event.data;
+  const onProgress = (progress: ConversionProgress) => scope.postMessage({ id, progress }, []);
+  convertMdlToXmileBytes(new Uint8Array(mdl), pretty, onProgress)
+    .then((xmile) => {
+      const buffer = xmile.buffer as ArrayBuffer; // a copy out of the wasm heap, just the XMILE
+      scope.postMessage({ id, xmile: buffer }, [buffer]);
+    })
+    .catch((err: Error) => scope.postMessage({ id, error: err.message }, []));
+};
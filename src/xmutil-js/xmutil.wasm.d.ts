@@ -4,3 +4,37 @@ export const memory: WebAssembly.Memory;
 export function free(ptr: number): void;
 export function malloc(size: number): number;
 export function _convert_mdl_to_xmile(ptr: number, len: number, isCompact: boolean): number;
+// only in builds from after the length returning API was added
+export const _convert_mdl_to_xmile_v2:
+  | ((ptr: number, len: number, isCompact: boolean, flags: number, xmilePtr: number, xmileLenPtr: number) => number)
+  | undefined;
+export const xmutil_free_result: ((ptr: number) => void) | undefined;
+// and the reusable input buffer
+export const xmutil_input_buffer: ((size: number) => number) | undefined;
+export const xmutil_release_input_buffer: (() => void) | undefined;
+// and the conversion stats (stats points at an XMUtilStats)
+export const _convert_mdl_to_xmile_stats:
+  | ((ptr: number, len: number, isCompact: boolean, flags: number, stats: number) => number)
+  | undefined;
+// and progress reports, through a function in the table (progress is its
+// index there)
+export const __indirect_function_table: WebAssembly.Table | undefined;
+export const _convert_mdl_to_xmile_progress:
+  | ((
+      ptr: number,
+      len: number,
+      isCompact: boolean,
+      flags: number,
+      progress: number,
+      context: number,
+      xmilePtr: number,
+      xmileLenPtr: number,
+    ) => number)
+  | undefined;
+// and what-if reruns that carry on from checkpoints of a first run (names
+// points at count string pointers, values at count doubles)
+export const _simulation_new: ((ptr: number, len: number, checkpointInterval: number) => number) | undefined;
+export const _simulation_rerun:
+  | ((simulation: number, names: number, values: number, count: number, reusedRowsPtr: number) => number)
+  | undefined;
+export const _simulation_free: ((simulation: number) => void) | undefined;
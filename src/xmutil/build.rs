@@ -23,34 +23,54 @@ fn main() {
         .file("./third_party/xmutil/Function/Level.cpp")
         .file("./third_party/xmutil/Function/State.cpp")
         .file("./third_party/xmutil/Function/Function.cpp")
+        .file("./third_party/xmutil/Function/Kernel.cpp")
+        .file("./third_party/xmutil/Xmile/GzipWriter.cpp")
         .file("./third_party/xmutil/Xmile/XMILEGenerator.cpp")
+        .file("./third_party/xmutil/Xmile/XMILEWriter.cpp")
         .file("./third_party/xmutil/Vensim/VensimView.cpp")
         .file("./third_party/xmutil/Vensim/VensimParseFunctions.cpp")
         .file("./third_party/xmutil/Vensim/VYacc.tab.cpp")
         .file("./third_party/xmutil/Vensim/VensimLex.cpp")
         .file("./third_party/xmutil/Vensim/VensimParse.cpp")
+        .file("./third_party/xmutil/CodeGenerator.cpp")
         .file("./third_party/xmutil/Model.cpp")
+        .file("./third_party/xmutil/ModelGraph.cpp")
         .file("./third_party/xmutil/ContextInfo.cpp")
+        .file("./third_party/xmutil/ConversionSession.cpp")
+        .file("./third_party/xmutil/DataStore.cpp")
+        .file("./third_party/xmutil/MappedFile.cpp")
+        .file("./third_party/xmutil/Limits.cpp")
+        .file("./third_party/xmutil/Progress.cpp")
+        .file("./third_party/xmutil/Stats.cpp")
+        .file("./third_party/xmutil/UnitsCheck.cpp")
+        .file("./third_party/xmutil/Workers.cpp")
         .file("./third_party/xmutil/XMUtil.cpp")
         .file("./third_party/xmutil/Symbol/Symbol.cpp")
         .file("./third_party/xmutil/Symbol/SymbolTableBase.cpp")
+        .file("./third_party/xmutil/Symbol/SymbolArena.cpp")
         .file("./third_party/xmutil/Symbol/SymbolList.cpp")
         .file("./third_party/xmutil/Symbol/Units.cpp")
-        .file("./third_party/xmutil/Symbol/NotUsed_SymAllocList.cpp")
         .file("./third_party/xmutil/Symbol/SymbolNameSpace.cpp")
         .file("./third_party/xmutil/Symbol/SymbolListList.cpp")
         .file("./third_party/xmutil/Symbol/LeftHandSide.cpp")
         .file("./third_party/xmutil/Symbol/ExpressionList.cpp")
         .file("./third_party/xmutil/Symbol/Expression.cpp")
+        .file("./third_party/xmutil/Symbol/ExpressionCode.cpp")
+        .file("./third_party/xmutil/Symbol/ExpressionNodes.cpp")
         .file("./third_party/xmutil/Symbol/Equation.cpp")
         .file("./third_party/xmutil/Symbol/Variable.cpp")
-        .file("./third_party/xmutil/Symbol/UnitExpression.cpp");
+        .file("./third_party/xmutil/Symbol/UnitExpression.cpp")
+        .file("./third_party/xmutil/Symbol/UnitTable.cpp");
 
     let mut tinyxml_build = cc::Build::new();
     tinyxml_build
         .cpp(true)
         .file("./third_party/tinyxml2/tinyxml2.cpp");
 
+    if std::env::var_os("CARGO_FEATURE_COUNT_ALLOCATIONS").is_some() {
+        xmutil_build.define("XMUTIL_COUNT_ALLOCATIONS", None);
+    }
+
     let target = std::env::var("TARGET").unwrap();
     if target.starts_with("wasm") {
         // xmutil_build.cpp_set_stdlib("c++");
@@ -62,6 +82,13 @@ fn main() {
             std::env::var("HOME").unwrap()
         );
         println!("cargo:rustc-link-lib=c");
+        // a build with -C target-feature=+simd128 compiles the lexer and
+        // printer with their wasm_simd128.h paths, for xmutil.simd.wasm
+        let features = std::env::var("CARGO_CFG_TARGET_FEATURE").unwrap_or_default();
+        if features.split(',').any(|feature| feature == "simd128") {
+            xmutil_build.flag("-msimd128");
+            tinyxml_build.flag("-msimd128");
+        }
     }
 
     xmutil_build.compile("xmutil-native");
@@ -115,31 +142,47 @@ fn main() {
     println!("cargo:rerun-if-changed=third_party/libutf/utfrune.c");
     println!("cargo:rerun-if-changed=third_party/libutf/utfutf.c");
     println!("cargo:rerun-if-changed=third_party/tinyxml2/tinyxml2.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/CodeGenerator.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/ContextInfo.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/ConversionSession.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/DataStore.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/Function.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Function/Kernel.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/Level.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/State.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/TableFunction.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Limits.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/MappedFile.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Model.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/ModelGraph.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Progress.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Stats.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Equation.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Expression.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ExpressionCode.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ExpressionNodes.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ExpressionList.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/LeftHandSide.cpp");
-    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/NotUsed_SymAllocList.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Symbol.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolArena.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolList.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolListList.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolNameSpace.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolTableBase.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/UnitExpression.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/UnitTable.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Units.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/UnitsCheck.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Variable.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimLex.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimParse.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimParseFunctions.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimView.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VYacc.tab.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Workers.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Xmile/GzipWriter.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/Xmile/XMILEGenerator.cpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Xmile/XMILEWriter.cpp");
     println!("cargo:rerun-if-changed=third_party/xmutil/XMUtil.cpp");
 
     println!("cargo:rerun-if-changed=third_party/libutf/lib9.h");
@@ -148,30 +191,47 @@ fn main() {
     println!("cargo:rerun-if-changed=third_party/libutf/utf.h");
     println!("cargo:rerun-if-changed=third_party/tinyxml2/tinyxml2.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/ContextInfo.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/ConversionSession.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/DataStore.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/Function.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Function/Kernel.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/Level.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/State.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Function/TableFunction.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Limits.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/MappedFile.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Model.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/ModelGraph.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Progress.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Stats.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ElementSet.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Equation.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Expression.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ExpressionCode.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ExpressionNodes.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/ExpressionList.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/LeftHandSide.h");
-    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/NotUsed_SymAllocList.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Parse.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SmallVector.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Symbol.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolArena.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolList.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolListList.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolNameSpace.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/SymbolTableBase.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/UnitExpression.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/UnitTable.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Units.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Symbol/Variable.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Workers.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimLex.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimParseFunctions.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimParse.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VensimView.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/ViewGrid.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Vensim/VYacc.tab.hpp");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Xmile/GzipWriter.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/Xmile/XMILEGenerator.h");
+    println!("cargo:rerun-if-changed=third_party/xmutil/Xmile/XMILEWriter.h");
     println!("cargo:rerun-if-changed=third_party/xmutil/XMUtil.h");
 }
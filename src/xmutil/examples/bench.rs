@@ -0,0 +1,161 @@
+// Copyright 2020 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+//! Times each stage of the MDL to XMILE conversion, or with --memory
+//! counts what each stage allocates.
+//!
+//! cargo run --release --example bench -- [-n ITERATIONS] [PATH...]
+//! cargo run --release --features count-allocations --example bench -- --memory [PATH...]
+//!
+//! PATHs may be .mdl files or directories searched recursively; with none
+//! given the test/, default_projects/ and examples/ directories at the
+//! root of the repository are used.  The median over the iterations is
+//! reported for each model and stage, in milliseconds.  With --memory
+//! each model is converted once and each stage's allocations, bytes
+//! allocated and peak bytes held are reported, along with the bytes still
+//! held when the conversion is done.
+
+use std::fs;
+use std::path::{Path, PathBuf};
+
+use xmutil::{
+    convert_vensim_mdl_timed, convert_vensim_mdl_with_stats, StageTimes, STAGE_ATTACH,
+    STAGE_MARK_TYPES, STAGE_PARSE, STAGE_PRINT,
+};
+
+fn find_models(path: &Path, models: &mut Vec<PathBuf>) {
+    if path.is_dir() {
+        let mut entries: Vec<PathBuf> = match fs::read_dir(path) {
+            Ok(dir) => dir.filter_map(|e| e.ok()).map(|e| e.path()).collect(),
+            Err(_) => return,
+        };
+        entries.sort();
+        for entry in entries {
+            find_models(&entry, models);
+        }
+    } else if path
+        .extension()
+        .map_or(false, |ext| ext.eq_ignore_ascii_case("mdl"))
+    {
+        models.push(path.to_path_buf());
+    }
+}
+
+fn median(values: &mut [f64]) -> f64 {
+    values.sort_by(|a, b| a.partial_cmp(b).unwrap());
+    values[values.len() / 2]
+}
+
+fn memory(models: &[PathBuf]) {
+    println!(
+        "{:>22} {:>22} {:>22} {:>22} {:>10}  model (allocations/bytes/peak per stage)",
+        "parse", "mark", "attach", "print", "retained"
+    );
+    for model in models {
+        let source = match fs::read_to_string(model) {
+            Ok(source) => source,
+            Err(err) => {
+                eprintln!("{}: {}", model.display(), err);
+                continue;
+            }
+        };
+        let (xmile, stats) = convert_vensim_mdl_with_stats(&source, false, 0);
+        if stats.allocations_counted == 0 {
+            eprintln!("allocations are only counted with --features count-allocations");
+            std::process::exit(1);
+        }
+        let stage = |i: usize| {
+            format!(
+                "{}/{}k/{}k",
+                stats.allocations[i],
+                stats.allocated_bytes[i] / 1024,
+                stats.peak_bytes[i] / 1024
+            )
+        };
+        println!(
+            "{:>22} {:>22} {:>22} {:>22} {:>9}k  {}{}",
+            stage(STAGE_PARSE),
+            stage(STAGE_MARK_TYPES),
+            stage(STAGE_ATTACH),
+            stage(STAGE_PRINT),
+            stats.retained_bytes / 1024,
+            model.display(),
+            if xmile.is_some() { "" } else { " (failed)" }
+        );
+    }
+}
+
+fn main() {
+    let mut iterations = 10;
+    let mut memory_only = false;
+    let mut paths: Vec<PathBuf> = vec![];
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        if arg == "-n" {
+            iterations = args
+                .next()
+                .and_then(|n| n.parse().ok())
+                .expect("-n needs a number");
+        } else if arg == "--memory" {
+            memory_only = true;
+        } else {
+            paths.push(PathBuf::from(arg));
+        }
+    }
+    if paths.is_empty() {
+        let root = Path::new(env!("CARGO_MANIFEST_DIR")).join("../..");
+        for dir in &["test", "default_projects", "examples"] {
+            paths.push(root.join(dir));
+        }
+    }
+
+    let mut models = vec![];
+    for path in &paths {
+        find_models(path, &mut models);
+    }
+    if memory_only {
+        memory(&models);
+        return;
+    }
+
+    println!(
+        "{:>10} {:>10} {:>10} {:>10} {:>10} {:>10}  model",
+        "lex", "parse", "mark", "attach", "print", "total"
+    );
+    for model in &models {
+        let source = match fs::read_to_string(model) {
+            Ok(source) => source,
+            Err(err) => {
+                eprintln!("{}: {}", model.display(), err);
+                continue;
+            }
+        };
+        let mut samples: Vec<StageTimes> = vec![];
+        let mut ok = true;
+        for _ in 0..iterations.max(1) {
+            let (xmile, times) = convert_vensim_mdl_timed(&source, false);
+            ok = xmile.is_some();
+            samples.push(times);
+        }
+        let stage = |f: fn(&StageTimes) -> f64| {
+            median(&mut samples.iter().map(f).collect::<Vec<_>>()) * 1000.0
+        };
+        let lex = stage(|t| t.lex);
+        let parse = stage(|t| t.parse);
+        let mark = stage(|t| t.mark_types);
+        let attach = stage(|t| t.attach);
+        let print = stage(|t| t.print);
+        println!(
+            "{:>10.3} {:>10.3} {:>10.3} {:>10.3} {:>10.3} {:>10.3}  {}{}",
+            lex,
+            parse,
+            mark,
+            attach,
+            print,
+            parse + mark + attach + print,
+            model.display(),
+            if ok { "" } else { " (failed)" }
+        );
+    }
+}
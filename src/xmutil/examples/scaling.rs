@@ -0,0 +1,467 @@
+// Copyright 2020 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+//! Generates MDL models of a given shape and times converting them as
+//! one parameter of the shape is swept, to show how each stage scales.
+//!
+//! cargo run --release --example scaling -- [-n ITERATIONS] [--NAME VALUE]... [--sweep NAME=A,B,...]
+//! cargo run --release --example scaling -- [--NAME VALUE]... --emit > model.mdl
+//!
+//! The NAMEs are the fields of Shape below, with dashes for underscores.
+//! Each row gives the median milliseconds per stage over the iterations,
+//! the peak bytes any stage held (with --features count-allocations) and
+//! the slope of log(total time) against log(swept value) from the row
+//! before - about 1 where the conversion scales linearly, 2 where it is
+//! quadratic.
+
+use std::fmt::Write;
+
+use xmutil::{convert_vensim_mdl_timed, convert_vensim_mdl_with_stats, StageTimes};
+
+#[derive(Clone)]
+struct Shape {
+    // auxiliaries, each reading `inputs` others before it
+    variables: usize,
+    inputs: usize,
+    // stocks, each with an inflow read from an auxiliary and an outflow
+    stocks: usize,
+    // every auxiliary is arrayed over this many dimensions of this size
+    dimensions: usize,
+    dimension_size: usize,
+    // arrayed variables defined with an EXCEPT equation and one for the
+    // element left out (with at least one dimension)
+    excepts: usize,
+    // macros, each used once
+    macros: usize,
+    // lookups, each of this many points and read by an auxiliary
+    lookups: usize,
+    lookup_points: usize,
+    // the characters in each variable's comment
+    comment_length: usize,
+    // the variables drawn on each view, with a connector for each input
+    // on the same view and a ghost for one on another; 0 for no sketch
+    view_elements: usize,
+}
+
+impl Default for Shape {
+    fn default() -> Shape {
+        Shape {
+            variables: 1000,
+            inputs: 2,
+            stocks: 100,
+            dimensions: 0,
+            dimension_size: 4,
+            excepts: 0,
+            macros: 0,
+            lookups: 10,
+            lookup_points: 20,
+            comment_length: 40,
+            view_elements: 100,
+        }
+    }
+}
+
+impl Shape {
+    fn set(&mut self, name: &str, value: usize) -> bool {
+        let field = match name {
+            "variables" => &mut self.variables,
+            "inputs" => &mut self.inputs,
+            "stocks" => &mut self.stocks,
+            "dimensions" => &mut self.dimensions,
+            "dimension-size" => &mut self.dimension_size,
+            "excepts" => &mut self.excepts,
+            "macros" => &mut self.macros,
+            "lookups" => &mut self.lookups,
+            "lookup-points" => &mut self.lookup_points,
+            "comment-length" => &mut self.comment_length,
+            "view-elements" => &mut self.view_elements,
+            _ => return false,
+        };
+        *field = value;
+        true
+    }
+}
+
+// the inputs auxiliary i reads, all before it so the model is computable
+fn inputs(shape: &Shape, i: usize) -> Vec<usize> {
+    let mut used = vec![];
+    for k in 0..shape.inputs.min(i) {
+        let j = if k == 0 { i - 1 } else { (i * 7 + k * 13) % i };
+        if !used.contains(&j) {
+            used.push(j);
+        }
+    }
+    used
+}
+
+fn equation(out: &mut String, shape: &Shape, lhs: &str, rhs: &str) {
+    let comment: String = "measured to scale "
+        .chars()
+        .cycle()
+        .take(shape.comment_length)
+        .collect();
+    let _ = write!(
+        out,
+        "{}=\n\t{}\n\t~\tWidgets\n\t~\t{}\n\t|\n\n",
+        lhs, rhs, comment
+    );
+}
+
+fn generate(shape: &Shape) -> String {
+    let mut out = String::from("{UTF-8}\n");
+    for m in 0..shape.macros {
+        let _ = write!(
+            out,
+            ":MACRO: SCALED SMOOTH {m}(input, delay)\nSCALED SMOOTH {m} = INTEG((input - SCALED SMOOTH {m}) / delay, input)\n\
+             \t~\tinput\n\t~\t\n\t|\n\n:END OF MACRO:\n",
+            m = m
+        );
+    }
+    let mut dims = String::new();
+    for d in 0..shape.dimensions {
+        let elements: Vec<String> = (0..shape.dimension_size.max(1))
+            .map(|e| format!("d{}e{}", d, e))
+            .collect();
+        let _ = write!(
+            out,
+            "dim {}:\n\t{}\n\t~\t\n\t~\t\n\t|\n\n",
+            d,
+            elements.join(", ")
+        );
+        dims += if d == 0 { "[" } else { "," };
+        dims += &format!("dim {}", d);
+    }
+    if !dims.is_empty() {
+        dims += "]";
+    }
+
+    for i in 0..shape.variables {
+        let mut rhs = match i % 3 {
+            _ if i == 0 => "1".to_string(),
+            0 => "0.5 * ".to_string(),
+            1 => "1 + ".to_string(),
+            _ => "MAX(0, ".to_string(),
+        };
+        let mut terms: Vec<String> = inputs(shape, i)
+            .iter()
+            .map(|j| format!("aux {}{}", j, dims))
+            .collect();
+        if i > 0 {
+            if terms.is_empty() {
+                terms.push("1".into());
+            }
+            rhs += &terms.join(" + ");
+            if i % 3 == 2 {
+                rhs += ")";
+            }
+        }
+        if i < shape.lookups {
+            rhs = format!("{} + table {}(Time)", rhs, i);
+        }
+        if shape.stocks > 0 && i % (shape.variables / shape.stocks).max(1) == 0 {
+            rhs = format!("{} + stock {}", rhs, i % shape.stocks);
+        }
+        equation(&mut out, shape, &format!("aux {}{}", i, dims), &rhs);
+    }
+    for s in 0..shape.stocks {
+        // arrayed auxiliaries are summed over every dimension
+        let source = if shape.variables == 0 {
+            "1".to_string()
+        } else if dims.is_empty() {
+            format!("aux {}", s % shape.variables)
+        } else {
+            format!(
+                "SUM(aux {}{})",
+                s % shape.variables,
+                dims.replace(',', "!,").replace(']', "!]")
+            )
+        };
+        equation(
+            &mut out,
+            shape,
+            &format!("stock {}", s),
+            &format!("INTEG(inflow {s} - outflow {s}, 10)", s = s),
+        );
+        equation(&mut out, shape, &format!("inflow {}", s), &source);
+        equation(
+            &mut out,
+            shape,
+            &format!("outflow {}", s),
+            &format!("stock {} / 5", s),
+        );
+    }
+    for t in 0..shape.lookups {
+        let n = shape.lookup_points.max(2);
+        let points: Vec<String> = (0..n)
+            .map(|k| format!("({},{})", k, (k * 37 % 11) as f64 / 10.0))
+            .collect();
+        let _ = write!(
+            out,
+            "table {}(\n\t[(0,0)-({},1)],{})\n\t~\t\n\t~\t\n\t|\n\n",
+            t,
+            n - 1,
+            points.join(",")
+        );
+    }
+    if shape.dimensions > 0 {
+        for e in 0..shape.excepts {
+            let lhs = format!("except {}[dim 0]", e);
+            let _ = write!(
+                out,
+                "{}:EXCEPT: [d0e0]=\n\t{}\n\t~\t\n\t~\t\n\t|\n\n",
+                lhs, e
+            );
+            equation(&mut out, shape, &format!("except {}[d0e0]", e), "-1");
+        }
+    }
+    for m in 0..shape.macros {
+        let input = if shape.stocks > 0 {
+            format!("stock {}", m % shape.stocks)
+        } else {
+            "Time".into()
+        };
+        equation(
+            &mut out,
+            shape,
+            &format!("smoothed {}", m),
+            &format!("SCALED SMOOTH {}({}, 3)", m, input),
+        );
+    }
+
+    out += "********************************************************\n\t.Control\n\
+            ********************************************************~\n\t\tSimulation Control Parameters\n\t|\n\n";
+    equation(&mut out, shape, "FINAL TIME", "100");
+    equation(&mut out, shape, "INITIAL TIME", "0");
+    equation(&mut out, shape, "SAVEPER", "TIME STEP");
+    equation(&mut out, shape, "TIME STEP", "1");
+
+    out += "\\\\\\---/// Sketch information - do not modify anything except names\n\
+            V300  Do not put anything below this section - it will be ignored\n";
+    if shape.view_elements > 0 {
+        sketch(&mut out, shape);
+    }
+    out += "///---\\\\\\\n";
+    out
+}
+
+// views of view_elements auxiliaries each, with the stocks and their flows
+// on the view of the auxiliary sharing their number
+fn sketch(out: &mut String, shape: &Shape) {
+    let per_view = shape.view_elements;
+    let views = (shape.variables.max(shape.stocks) + per_view - 1) / per_view;
+    for v in 0..views.max(1) {
+        let _ = write!(
+            out,
+            "*View {}\n$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|72,72,100,0\n",
+            v + 1
+        );
+        let mut id = 0;
+        let mut next = || {
+            id += 1;
+            id
+        };
+        let first = v * per_view;
+        let last = (first + per_view).min(shape.variables);
+        let place = |k: usize| (100 + (k % 10) * 160, 100 + (k / 10) * 120);
+        let mut ids = vec![0; last.saturating_sub(first)];
+        for i in first..last {
+            let (x, y) = place(i - first);
+            ids[i - first] = next();
+            let _ = writeln!(
+                out,
+                "10,{},aux {},{},{},30,8,8,3,0,0,0,0,0,0",
+                ids[i - first],
+                i,
+                x,
+                y
+            );
+        }
+        for i in first..last {
+            let (x, y) = place(i - first);
+            for j in inputs(shape, i) {
+                let from = if j >= first {
+                    ids[j - first]
+                } else {
+                    let ghost = next();
+                    let _ = writeln!(
+                        out,
+                        "10,{},aux {},{},{},30,8,8,2,0,3,-1,0,0,0,128-128-128,0-0-0,|0||128-128-128",
+                        ghost,
+                        j,
+                        x - 40,
+                        y - 40
+                    );
+                    ghost
+                };
+                let _ = writeln!(
+                    out,
+                    "1,{},{},{},0,0,0,0,0,128,0,-1--1--1,,1|({},{})|",
+                    next(),
+                    from,
+                    ids[i - first],
+                    x - 20,
+                    y - 20
+                );
+            }
+        }
+        for s in (first..first + per_view).filter(|&s| s < shape.stocks) {
+            let (x, y) = place(s - first);
+            let (x, y) = (x + 60, y + 50);
+            let stock = next();
+            let _ = writeln!(
+                out,
+                "10,{},stock {},{},{},40,20,3,3,0,0,0,0,0,0",
+                stock, s, x, y
+            );
+            for (flow, dx) in [("inflow", -70i64), ("outflow", 70)].iter() {
+                let cloud = next();
+                let valve = next();
+                let name = next();
+                let (vx, cx) = (x as i64 + dx, x as i64 + 2 * dx);
+                let _ = writeln!(out, "12,{},48,{},{},10,8,0,3,0,0,-1,0,0,0", cloud, cx, y);
+                let (into, out_of) = if *flow == "inflow" {
+                    (stock, cloud)
+                } else {
+                    (cloud, stock)
+                };
+                let _ = writeln!(
+                    out,
+                    "1,{},{},{},4,0,0,22,0,0,0,-1--1--1,,1|({},{})|",
+                    next(),
+                    valve,
+                    into,
+                    vx,
+                    y
+                );
+                let _ = writeln!(
+                    out,
+                    "1,{},{},{},100,0,0,22,0,0,0,-1--1--1,,1|({},{})|",
+                    next(),
+                    valve,
+                    out_of,
+                    vx,
+                    y
+                );
+                let _ = writeln!(out, "11,{},0,{},{},6,8,34,3,0,0,1,0,0,0", valve, vx, y);
+                let _ = writeln!(
+                    out,
+                    "10,{},{} {},{},{},30,8,40,3,0,0,-1,0,0,0",
+                    name,
+                    flow,
+                    s,
+                    vx,
+                    y + 16
+                );
+            }
+        }
+    }
+}
+
+fn median(values: &mut [f64]) -> f64 {
+    values.sort_by(|a, b| a.partial_cmp(b).unwrap());
+    values[values.len() / 2]
+}
+
+fn main() {
+    let mut shape = Shape::default();
+    let mut iterations = 5;
+    let mut sweep: Option<(String, Vec<usize>)> = None;
+    let mut emit = false;
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        if arg == "--emit" {
+            emit = true;
+        } else if arg == "-n" {
+            iterations = args
+                .next()
+                .and_then(|n| n.parse().ok())
+                .expect("-n needs a number");
+        } else if arg == "--sweep" {
+            let spec = args.next().expect("--sweep needs NAME=A,B,...");
+            let mut parts = spec.splitn(2, '=');
+            let name = parts.next().unwrap().to_string();
+            let values: Vec<usize> = parts
+                .next()
+                .map(|v| {
+                    v.split(',')
+                        .map(|n| n.trim().parse().expect("sweep values are numbers"))
+                        .collect()
+                })
+                .expect("--sweep needs NAME=A,B,...");
+            if !shape.clone().set(&name, 0) {
+                panic!("no shape parameter {}", name);
+            }
+            sweep = Some((name, values));
+        } else if let Some(name) = arg.strip_prefix("--") {
+            let value = args
+                .next()
+                .and_then(|n| n.parse().ok())
+                .expect("shape parameters are numbers");
+            if !shape.set(name, value) {
+                panic!("no shape parameter {}", name);
+            }
+        } else {
+            panic!("unexpected argument {}", arg);
+        }
+    }
+    if emit {
+        print!("{}", generate(&shape));
+        return;
+    }
+    let (name, values) =
+        sweep.unwrap_or_else(|| ("variables".to_string(), vec![1000, 2000, 4000, 8000, 16000]));
+
+    println!(
+        "{:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>6}",
+        name, "mdl bytes", "parse", "mark", "attach", "print", "total", "peak", "slope"
+    );
+    let mut previous: Option<(usize, f64)> = None;
+    for value in values {
+        shape.set(&name, value);
+        let source = generate(&shape);
+        let mut samples: Vec<StageTimes> = vec![];
+        let mut ok = true;
+        for _ in 0..iterations.max(1) {
+            let (xmile, times) = convert_vensim_mdl_timed(&source, false);
+            ok = xmile.is_some();
+            samples.push(times);
+        }
+        let stage = |f: fn(&StageTimes) -> f64| {
+            median(&mut samples.iter().map(f).collect::<Vec<_>>()) * 1000.0
+        };
+        let (parse, mark, attach, print) = (
+            stage(|t| t.parse),
+            stage(|t| t.mark_types),
+            stage(|t| t.attach),
+            stage(|t| t.print),
+        );
+        let total = parse + mark + attach + print;
+        let (_, stats) = convert_vensim_mdl_with_stats(&source, false, 0);
+        let peak = if stats.allocations_counted != 0 {
+            format!("{}k", stats.peak_bytes.iter().max().unwrap() / 1024)
+        } else {
+            "-".into()
+        };
+        let slope = match previous {
+            Some((v, t)) if v > 0 && value != v && t > 0.0 && total > 0.0 => {
+                format!("{:.2}", (total / t).ln() / (value as f64 / v as f64).ln())
+            }
+            _ => "".into(),
+        };
+        println!(
+            "{:>10} {:>10} {:>10.3} {:>10.3} {:>10.3} {:>10.3} {:>10.3} {:>10} {:>6}{}",
+            value,
+            source.len(),
+            parse,
+            mark,
+            attach,
+            print,
+            total,
+            peak,
+            slope,
+            if ok { "" } else { "  (failed)" }
+        );
+        previous = Some((value, total));
+    }
+}
@@ -0,0 +1,213 @@
+// Copyright 2020 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+//! Converts every MDL file under the given paths to XMILE, in parallel,
+//! and reports how fast it went.
+//!
+//! xmutil-batch [-j THREADS] [-o DIR] [--compact] [--quiet] PATH...
+//!
+//! PATHs may be .mdl files or directories searched recursively.  Each
+//! model is converted to a .xmile file beside it, or with -o to the same
+//! place under DIR relative to the PATH it was found in.  Files are
+//! memory mapped and converted on THREADS threads (one per core by
+//! default), a line going out for each with its milliseconds and MB/s;
+//! at the end come the files and MB per second over the whole run, the
+//! median and 99th percentile milliseconds per file and the failures.
+//! The exit status is 1 if any model failed.
+
+use std::fs;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
+
+struct Model {
+    path: PathBuf,
+    output: PathBuf,
+    bytes: u64,
+}
+
+struct Outcome {
+    seconds: f64,
+    error: Option<String>,
+}
+
+fn find_models(path: &Path, root: &Path, out_dir: Option<&Path>, models: &mut Vec<Model>) {
+    if path.is_dir() {
+        let mut entries: Vec<PathBuf> = match fs::read_dir(path) {
+            Ok(dir) => dir.filter_map(|e| e.ok()).map(|e| e.path()).collect(),
+            Err(err) => {
+                eprintln!("{}: {}", path.display(), err);
+                return;
+            }
+        };
+        entries.sort();
+        for entry in entries {
+            find_models(&entry, root, out_dir, models);
+        }
+    } else if path
+        .extension()
+        .map_or(false, |ext| ext.eq_ignore_ascii_case("mdl"))
+    {
+        let output = match out_dir {
+            // a file named on its own goes straight into the directory
+            Some(dir) => match path.strip_prefix(root) {
+                Ok(rel) if !rel.as_os_str().is_empty() => dir.join(rel),
+                _ => dir.join(path.file_name().unwrap()),
+            },
+            None => path.to_path_buf(),
+        }
+        .with_extension("xmile");
+        let bytes = fs::metadata(path).map_or(0, |m| m.len());
+        models.push(Model {
+            path: path.to_path_buf(),
+            output,
+            bytes,
+        });
+    }
+}
+
+fn convert(model: &Model, is_compact: bool) -> Result<(), String> {
+    let xmile =
+        xmutil::convert_vensim_mdl_file(&model.path, is_compact, 0).map_err(|e| e.to_string())?;
+    if let Some(dir) = model.output.parent() {
+        fs::create_dir_all(dir).map_err(|e| e.to_string())?;
+    }
+    fs::write(&model.output, xmile).map_err(|e| e.to_string())
+}
+
+fn megabytes_per_second(bytes: u64, seconds: f64) -> f64 {
+    if seconds > 0.0 {
+        bytes as f64 / 1e6 / seconds
+    } else {
+        0.0
+    }
+}
+
+// the value below which fraction of the sorted values fall
+fn percentile(sorted: &[f64], fraction: f64) -> f64 {
+    if sorted.is_empty() {
+        return 0.0;
+    }
+    let i = (fraction * (sorted.len() - 1) as f64).round() as usize;
+    sorted[i.min(sorted.len() - 1)]
+}
+
+fn usage() -> ! {
+    eprintln!("usage: xmutil-batch [-j THREADS] [-o DIR] [--compact] [--quiet] PATH...");
+    std::process::exit(2);
+}
+
+fn main() {
+    let mut threads = 0;
+    let mut out_dir: Option<PathBuf> = None;
+    let mut is_compact = false;
+    let mut quiet = false;
+    let mut paths: Vec<PathBuf> = vec![];
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        if arg == "-j" {
+            threads = args
+                .next()
+                .and_then(|n| n.parse().ok())
+                .unwrap_or_else(|| usage());
+        } else if arg == "-o" {
+            out_dir = Some(args.next().map(PathBuf::from).unwrap_or_else(|| usage()));
+        } else if arg == "--compact" {
+            is_compact = true;
+        } else if arg == "--quiet" {
+            quiet = true;
+        } else if arg.starts_with('-') {
+            usage();
+        } else {
+            paths.push(PathBuf::from(arg));
+        }
+    }
+    if paths.is_empty() {
+        usage();
+    }
+
+    let mut models = vec![];
+    for path in &paths {
+        find_models(path, path, out_dir.as_deref(), &mut models);
+    }
+    if threads == 0 {
+        threads = xmutil::available_threads();
+    }
+    let threads = threads.min(models.len()).max(1);
+
+    // each thread takes the next model not yet claimed, so one slow model
+    // doesn't hold up the ones queued behind it
+    let models = Arc::new(models);
+    let next = Arc::new(AtomicUsize::new(0));
+    let outcomes: Arc<Mutex<Vec<Option<Outcome>>>> =
+        Arc::new(Mutex::new((0..models.len()).map(|_| None).collect()));
+    let start = Instant::now();
+    let workers: Vec<_> = (0..threads)
+        .map(|_| {
+            let (models, next, outcomes) = (models.clone(), next.clone(), outcomes.clone());
+            std::thread::spawn(move || loop {
+                let i = next.fetch_add(1, Ordering::Relaxed);
+                if i >= models.len() {
+                    break;
+                }
+                let model = &models[i];
+                let begun = Instant::now();
+                let error = convert(model, is_compact).err();
+                let seconds = begun.elapsed().as_secs_f64();
+                if !quiet {
+                    match &error {
+                        None => println!(
+                            "{:>10.3} ms {:>8.2} MB/s  {}",
+                            seconds * 1000.0,
+                            megabytes_per_second(model.bytes, seconds),
+                            model.path.display()
+                        ),
+                        Some(err) => println!(
+                            "{:>10.3} ms {:>13}  {} ({})",
+                            seconds * 1000.0,
+                            "failed",
+                            model.path.display(),
+                            err
+                        ),
+                    }
+                }
+                outcomes.lock().unwrap()[i] = Some(Outcome { seconds, error });
+            })
+        })
+        .collect();
+    for worker in workers {
+        worker.join().unwrap();
+    }
+    let elapsed = start.elapsed().as_secs_f64();
+
+    let outcomes: Vec<Outcome> = std::mem::take(&mut *outcomes.lock().unwrap())
+        .into_iter()
+        .flatten()
+        .collect();
+    let failures = outcomes.iter().filter(|o| o.error.is_some()).count();
+    let bytes: u64 = models.iter().map(|m| m.bytes).sum();
+    let mut latencies: Vec<f64> = outcomes.iter().map(|o| o.seconds * 1000.0).collect();
+    latencies.sort_by(|a, b| a.partial_cmp(b).unwrap());
+    println!(
+        "{} files ({:.2} MB) on {} threads in {:.3} s: {:.1} files/s, {:.2} MB/s, \
+         p50 {:.3} ms, p99 {:.3} ms, {} failed",
+        models.len(),
+        bytes as f64 / 1e6,
+        threads,
+        elapsed,
+        if elapsed > 0.0 {
+            models.len() as f64 / elapsed
+        } else {
+            0.0
+        },
+        megabytes_per_second(bytes, elapsed),
+        percentile(&latencies, 0.5),
+        percentile(&latencies, 0.99),
+        failures
+    );
+    if failures > 0 {
+        std::process::exit(1);
+    }
+}
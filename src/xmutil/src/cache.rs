@@ -0,0 +1,218 @@
+// Copyright 2020 The Model Authors. All rights reserved.
+// Use of this source code is governed by the Apache License,
+// Version 2.0, that can be found in the LICENSE file.
+
+//! A cache of conversions keyed by the MDL bytes and the options they were
+//! converted with, so importing the same model again returns the stored
+//! XMILE without running the converter.  This relies on the conversion
+//! being deterministic, which it is: symbols are written in the order they
+//! appear in the MDL file.
+
+use std::collections::{BTreeMap, HashMap};
+use std::fs;
+use std::io;
+use std::path::PathBuf;
+use std::sync::Mutex;
+
+/// The version of what the converter writes, part of every `CacheKey` so
+/// a `DirCache` filled by an older build isn't read by a newer one.  Bump
+/// it with any change that alters the output for the same MDL and options
+/// (`converterVersion` in xmutil-js's cache.ts goes up with it).
+pub const CONVERTER_VERSION: u32 = 1;
+
+/// Identifies a conversion: a 128 bit hash of the MDL source together with
+/// its length, `is_compact`, the option flags and `CONVERTER_VERSION`.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub struct CacheKey {
+    hash: [u64; 2],
+    len: u64,
+    flags: u32,
+    is_compact: bool,
+    version: u32,
+}
+
+// two FNV-1a passes with different offset bases - fast, and with the
+// length included collisions between real models aren't a concern
+const FNV_PRIME: u64 = 0x100_0000_01b3;
+const FNV_OFFSETS: [u64; 2] = [0xcbf2_9ce4_8422_2325, 0x6c62_272e_07bb_0142];
+
+impl CacheKey {
+    pub fn new(mdl_source: &[u8], is_compact: bool, flags: u32) -> CacheKey {
+        let mut hash = FNV_OFFSETS;
+        for &b in mdl_source {
+            for h in hash.iter_mut() {
+                *h = (*h ^ b as u64).wrapping_mul(FNV_PRIME);
+            }
+        }
+        CacheKey {
+            hash,
+            len: mdl_source.len() as u64,
+            flags,
+            is_compact,
+            version: CONVERTER_VERSION,
+        }
+    }
+
+    /// A file name safe string unique to the key.
+    pub fn to_hex(&self) -> String {
+        format!(
+            "{:016x}{:016x}-{:x}-{:x}{}-v{}",
+            self.hash[0],
+            self.hash[1],
+            self.len,
+            self.flags,
+            if self.is_compact { "c" } else { "p" },
+            self.version
+        )
+    }
+}
+
+/// Where a `ConversionCache` keeps its results.
+pub trait CacheBackend: Send {
+    fn get(&mut self, key: &CacheKey) -> Option<String>;
+    fn put(&mut self, key: CacheKey, xmile: &str);
+}
+
+/// Keeps results in memory, dropping the least recently used ones once
+/// the XMILE held goes over `budget` bytes.
+pub struct MemoryCache {
+    budget: usize,
+    used: usize,
+    tick: u64,
+    entries: HashMap<CacheKey, (String, u64)>,
+    by_use: BTreeMap<u64, CacheKey>,
+}
+
+impl MemoryCache {
+    pub fn new(budget: usize) -> MemoryCache {
+        MemoryCache {
+            budget,
+            used: 0,
+            tick: 0,
+            entries: HashMap::new(),
+            by_use: BTreeMap::new(),
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Bytes of XMILE currently held.
+    pub fn used(&self) -> usize {
+        self.used
+    }
+
+    fn touch(&mut self, key: &CacheKey) -> u64 {
+        self.tick += 1;
+        self.by_use.insert(self.tick, *key);
+        self.tick
+    }
+}
+
+impl CacheBackend for MemoryCache {
+    fn get(&mut self, key: &CacheKey) -> Option<String> {
+        let last = self.entries.get(key)?.1;
+        self.by_use.remove(&last);
+        let tick = self.touch(key);
+        let entry = self.entries.get_mut(key).unwrap();
+        entry.1 = tick;
+        Some(entry.0.clone())
+    }
+
+    fn put(&mut self, key: CacheKey, xmile: &str) {
+        if xmile.len() > self.budget {
+            return;
+        }
+        if let Some((old, last)) = self.entries.remove(&key) {
+            self.used -= old.len();
+            self.by_use.remove(&last);
+        }
+        while self.used + xmile.len() > self.budget {
+            let (&oldest, &victim) = self.by_use.iter().next().unwrap();
+            self.by_use.remove(&oldest);
+            let (old, _) = self.entries.remove(&victim).unwrap();
+            self.used -= old.len();
+        }
+        let tick = self.touch(&key);
+        self.used += xmile.len();
+        self.entries.insert(key, (xmile.to_owned(), tick));
+    }
+}
+
+/// Keeps results as files in a directory, one per key, so they outlive
+/// the process.  Nothing is ever removed; errors reading or writing are
+/// treated as misses.
+pub struct DirCache {
+    dir: PathBuf,
+}
+
+impl DirCache {
+    pub fn new<P: Into<PathBuf>>(dir: P) -> io::Result<DirCache> {
+        let dir = dir.into();
+        fs::create_dir_all(&dir)?;
+        Ok(DirCache { dir })
+    }
+
+    fn path(&self, key: &CacheKey) -> PathBuf {
+        self.dir.join(format!("{}.xmile", key.to_hex()))
+    }
+}
+
+impl CacheBackend for DirCache {
+    fn get(&mut self, key: &CacheKey) -> Option<String> {
+        fs::read_to_string(self.path(key)).ok()
+    }
+
+    fn put(&mut self, key: CacheKey, xmile: &str) {
+        // write then rename so a reader never sees half a file
+        let path = self.path(&key);
+        let tmp = path.with_extension(format!("tmp{}", std::process::id()));
+        if fs::write(&tmp, xmile).is_ok() && fs::rename(&tmp, &path).is_err() {
+            let _ = fs::remove_file(&tmp);
+        }
+    }
+}
+
+/// Converts MDL files, returning the stored XMILE for any source already
+/// converted with the same options.  Failed conversions aren't cached.
+/// The backend is locked only to look up and store results, so
+/// conversions themselves still run concurrently.
+pub struct ConversionCache<B: CacheBackend> {
+    backend: Mutex<B>,
+}
+
+impl<B: CacheBackend> ConversionCache<B> {
+    pub fn new(backend: B) -> ConversionCache<B> {
+        ConversionCache {
+            backend: Mutex::new(backend),
+        }
+    }
+
+    pub fn convert(&self, mdl_source: &str, is_compact: bool) -> Option<String> {
+        self.convert_with_flags(mdl_source, is_compact, 0)
+    }
+
+    pub fn convert_with_flags(
+        &self,
+        mdl_source: &str,
+        is_compact: bool,
+        flags: u32,
+    ) -> Option<String> {
+        let key = CacheKey::new(mdl_source.as_bytes(), is_compact, flags);
+        if let Some(xmile) = self.backend.lock().unwrap().get(&key) {
+            return Some(xmile);
+        }
+        let xmile = crate::convert_vensim_mdl_with_flags(mdl_source, is_compact, flags)?;
+        self.backend.lock().unwrap().put(key, &xmile);
+        Some(xmile)
+    }
+
+    pub fn backend(&self) -> std::sync::MutexGuard<'_, B> {
+        self.backend.lock().unwrap()
+    }
+}
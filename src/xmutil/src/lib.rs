@@ -2,53 +2,1179 @@
 // Use of this source code is governed by the Apache License,
 // Version 2.0, that can be found in the LICENSE file.
 
-use std::ffi::CStr;
+use std::ffi::{CStr, CString};
+use std::io::Read;
+use std::path::Path;
 use std::str;
-use std::sync::Mutex;
+use std::sync::atomic::AtomicI32;
+use std::time::Duration;
 
-use lazy_static::lazy_static;
+pub mod cache;
+
+pub use cache::{
+    CacheBackend, CacheKey, ConversionCache, DirCache, MemoryCache, CONVERTER_VERSION,
+};
 
 extern "C" {
-    fn _convert_mdl_to_xmile(
+    fn _available_threads() -> u32;
+    fn _set_available_threads(threads: u32);
+
+    fn _convert_mdl_to_xmile_batch(
+        mdl_sources: *const *const u8,
+        mdl_source_lens: *const u32,
+        count: u32,
+        is_compact: bool,
+        n_threads: u32,
+        results: *mut *const i8,
+    );
+
+    fn _convert_mdl_to_xmile_timed(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        is_compact: bool,
+        stage_seconds: *mut f64,
+    ) -> *const i8;
+
+    fn _convert_mdl_to_xmile_stats(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        is_compact: bool,
+        flags: u32,
+        stats: *mut ConversionStats,
+    ) -> *const i8;
+
+    fn _convert_mdl_to_xmile_diagnostics(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        is_compact: bool,
+        flags: u32,
+        xmile: *mut *mut i8,
+        xmile_len: *mut usize,
+        diagnostics: *mut *mut RawDiagnostic,
+        diagnostic_count: *mut u32,
+    ) -> i32;
+
+    fn _convert_mdl_to_xmile_limited(
         mdl_source: *const u8,
         mdl_source_len: u32,
         is_compact: bool,
+        flags: u32,
+        limits: *const RawLimits,
+        xmile: *mut *mut i8,
+        xmile_len: *mut usize,
+        diagnostics: *mut *mut RawDiagnostic,
+        diagnostic_count: *mut u32,
+    ) -> i32;
+
+    fn _convert_mdl_file_to_xmile(
+        path: *const i8,
+        is_compact: bool,
+        flags: u32,
+        xmile: *mut *mut i8,
+        xmile_len: *mut usize,
+        diagnostics: *mut *mut RawDiagnostic,
+        diagnostic_count: *mut u32,
+    ) -> i32;
+
+    fn _convert_mdl_reader_to_xmile(
+        read: extern "C" fn(*mut u8, *mut u8, usize) -> usize,
+        context: *mut u8,
+        is_compact: bool,
+        flags: u32,
+        xmile: *mut *mut i8,
+        xmile_len: *mut usize,
+        diagnostics: *mut *mut RawDiagnostic,
+        diagnostic_count: *mut u32,
+    ) -> i32;
+
+    fn xmutil_free_result(result: *mut u8);
+
+    fn _simulate_mdl(mdl_source: *const u8, mdl_source_len: u32) -> *const i8;
+
+    fn _profile_mdl(mdl_source: *const u8, mdl_source_len: u32) -> *const i8;
+
+    fn _generate_c_mdl(mdl_source: *const u8, mdl_source_len: u32) -> *const i8;
+
+    fn _simulate_mdl_runs(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        runs: u32,
+        seed: u64,
+        variables: *const *const i8,
+        variable_count: u32,
+        n_threads: u32,
+        sink: extern "C" fn(u32, *const u8, usize, *mut u8),
+        context: *mut u8,
+    ) -> bool;
+
+    fn _simulate_mdl_sweep(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        runs: u32,
+        seed: u64,
+        parameters: *const *const i8,
+        parameter_count: u32,
+        values: *const f64,
+        variables: *const *const i8,
+        variable_count: u32,
+        n_threads: u32,
+        sink: extern "C" fn(u32, *const u8, usize, *mut u8),
+        context: *mut u8,
+    ) -> bool;
+
+    fn _simulate_mdl_columns(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        variables: *const *const i8,
+        variable_count: u32,
+        chunk_rows: u32,
+        sink: extern "C" fn(*const i8, *const *const f64, u32, u32, *mut u8),
+        context: *mut u8,
+    ) -> bool;
+
+    fn _simulation_new(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        checkpoint_interval: f64,
+    ) -> *mut u8;
+    fn _simulation_rerun(
+        simulation: *mut u8,
+        names: *const *const i8,
+        values: *const f64,
+        count: u32,
+        reused_rows: *mut u32,
+    ) -> *const i8;
+    fn _simulation_free(simulation: *mut u8);
+
+    fn _data_store_add(name: *const i8, text: *const u8, text_len: u32) -> bool;
+    fn _data_store_load(name: *const i8, path: *const i8) -> bool;
+    fn _data_store_write_cache(name: *const i8, path: *const i8) -> bool;
+    fn _data_store_clear();
+
+    fn _mdl_session_new(is_compact: bool, flags: u32) -> *mut u8;
+    fn _mdl_session_convert(
+        session: *mut u8,
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        reparsed_chunks: *mut u32,
     ) -> *const i8;
+    fn _mdl_session_free(session: *mut u8);
+
+    fn _mdl_model_read(
+        mdl_source: *const u8,
+        mdl_source_len: u32,
+        flags: u32,
+        diagnostics: *mut *mut RawDiagnostic,
+        diagnostic_count: *mut u32,
+    ) -> *mut u8;
+    fn _mdl_model_write(
+        model: *mut u8,
+        is_compact: bool,
+        flags: u32,
+        xmile: *mut *mut i8,
+        xmile_len: *mut usize,
+    ) -> i32;
+    fn _mdl_model_free(model: *mut u8);
+}
+
+/// Flag for `convert_vensim_mdl_with_flags`: don't read the sketch, so
+/// the XMILE has the equations (and groups) but no views.
+pub const SKIP_VIEWS: u32 = 1;
+/// Flag for `convert_vensim_mdl_with_flags`: build each subexpression that
+/// appears in more than one equation once, so large models with repeated
+/// terms take less memory.  The XMILE is the same either way.
+pub const SHARE_EXPRESSIONS: u32 = 4;
+/// Flag for `convert_vensim_mdl_with_flags`: check the units given for
+/// each variable against its equation.  What doesn't fit doesn't stop the
+/// conversion; `check_vensim_mdl_units` hands back what was found.
+pub const CHECK_UNITS: u32 = 8;
+/// Flag for `convert_vensim_mdl_with_flags`: pass over the comment after
+/// each equation, so no variable has a `<doc>` but the XMILE is otherwise
+/// the same.
+pub const SKIP_DOCS: u32 = 16;
+/// Flag for `convert_vensim_mdl_with_flags`: leave out what XMILE readers
+/// assume when it is missing (`isee:prefs`, `method="Euler"`, empty
+/// sections) and write numbers in the fewest digits that read back the
+/// same.  With `SKIP_VIEWS` and `SKIP_DOCS` this is the smallest XMILE.
+pub const MINIMAL: u32 = 64;
+/// Flag for `convert_vensim_mdl_with_flags`: look for loops of equations
+/// that each need the next computed first, which convert but can't be
+/// simulated.  They don't stop the conversion; `check_vensim_mdl_loops`
+/// hands back what was found.
+pub const CHECK_LOOPS: u32 = 128;
+/// Flag for `convert_vensim_mdl_with_flags`: read the equations on one
+/// thread per core, each taking a run of them, putting what was read back
+/// together in file order.  The XMILE is the same either way; models with
+/// macros, or read with `SHARE_EXPRESSIONS`, are read on one thread.
+pub const PARALLEL_PARSE: u32 = 256;
+// XMUTIL_OUTPUT_GZIP - only set by convert_vensim_mdl_gzip
+const OUTPUT_GZIP: u32 = 32;
+
+/// Seconds spent in each stage of a single conversion.  `lex` is measured
+/// with a separate tokenizing pass; the others are the stages of the
+/// conversion itself.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct StageTimes {
+    pub lex: f64,
+    pub parse: f64,
+    pub mark_types: f64,
+    pub attach: f64,
+    pub print: f64,
+}
+
+/// What a conversion did and where its time went, as counted by
+/// `convert_vensim_mdl_with_stats`.  Work done on the extra threads a
+/// large model is written with isn't counted.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct ConversionStats {
+    pub input_bytes: u64,
+    pub tokens: u64,
+    /// Names looked up in the model or a macro, and how many of those
+    /// found nothing.
+    pub lookups: u64,
+    pub lookup_misses: u64,
+    /// Equations passed over after an error in one.
+    pub recovery_skips: u64,
+    pub variables: u64,
+    pub output_bytes: u64,
+    /// Reading the MDL, sketch and settings included.
+    pub read_seconds: f64,
+    /// The part of `read_seconds` spent parsing equations.
+    pub equation_seconds: f64,
+    pub mark_types_seconds: f64,
+    pub attach_seconds: f64,
+    pub print_seconds: f64,
+    /// The parts of `print_seconds` writing variables and views.
+    pub print_variables_seconds: f64,
+    pub print_views_seconds: f64,
+    /// The memory each stage allocated, indexed by the `STAGE_`
+    /// constants: how many allocations, how many bytes in all, and the
+    /// most held at once over what the stage started with.  Only counted
+    /// with the `count-allocations` feature, which sets
+    /// `allocations_counted` to 1.
+    pub allocations: [u64; STAGE_COUNT],
+    pub allocated_bytes: [u64; STAGE_COUNT],
+    pub peak_bytes: [u64; STAGE_COUNT],
+    /// Still allocated once the conversion is done, including the blocks
+    /// kept for the thread's next conversion.
+    pub retained_bytes: i64,
+    pub allocations_counted: u64,
+}
+
+/// Indexes into the per-stage arrays of `ConversionStats`, as
+/// XMUTIL_STAGE_ in XMUtil.h.
+pub const STAGE_LEX: usize = 0;
+pub const STAGE_PARSE: usize = 1;
+pub const STAGE_MARK_TYPES: usize = 2;
+pub const STAGE_ATTACH: usize = 3;
+pub const STAGE_PRINT: usize = 4;
+pub const STAGE_COUNT: usize = 5;
+
+// XMUtilDiagnostic
+#[repr(C)]
+struct RawDiagnostic {
+    kind: i32,
+    line: u32,
+    position: u32,
+    message: *const i8,
+    variable: *const i8,
+}
+
+/// Something found wrong with an equation in the MDL file.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct Diagnostic {
+    /// 1 based line the problem was found on.
+    pub line: u32,
+    /// How far into that line reading had got.
+    pub position: u32,
+    pub message: String,
+    /// The variable whose equation was being read, if it got that far.
+    pub variable: Option<String>,
+}
+
+impl std::fmt::Display for Diagnostic {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "line {}: {}", self.line, self.message)?;
+        if let Some(var) = &self.variable {
+            write!(f, " (in {})", var)?;
+        }
+        Ok(())
+    }
+}
+
+/// Why a conversion failed.
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub enum ConvertError {
+    /// The MDL couldn't be read; there is a diagnostic for each equation
+    /// that couldn't be.
+    Parse(Vec<Diagnostic>),
+    /// The model was read but couldn't all be written as XMILE; the text
+    /// says what went wrong.
+    Output(String),
+    /// The MDL file couldn't be opened or read.
+    Read(String),
+    /// The conversion hit one of its `Limits` and gave up; the text says
+    /// which.
+    Stopped(String),
+}
+
+impl std::fmt::Display for ConvertError {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        match self {
+            ConvertError::Parse(diags) => {
+                write!(f, "unable to parse the MDL file")?;
+                for diag in diags {
+                    write!(f, "\n{}", diag)?;
+                }
+                Ok(())
+            }
+            ConvertError::Output(msg) => write!(f, "unable to write the XMILE: {}", msg),
+            ConvertError::Read(msg) => write!(f, "{}", msg),
+            ConvertError::Stopped(msg) => write!(f, "{}", msg),
+        }
+    }
+}
+
+impl std::error::Error for ConvertError {}
+
+const XMUTIL_OK: i32 = 0;
+const XMUTIL_ERROR_PARSE: i32 = 1;
+const XMUTIL_ERROR_READ: i32 = 3;
+const XMUTIL_WARNING_UNITS: i32 = 4;
+const XMUTIL_ERROR_CANCELLED: i32 = 5;
+const XMUTIL_ERROR_DEADLINE: i32 = 6;
+const XMUTIL_ERROR_MEMORY: i32 = 7;
+const XMUTIL_WARNING_SIMULTANEOUS: i32 = 8;
+
+/// Bounds on one conversion for `convert_vensim_mdl_limited`, so a bad
+/// file can't hold up a worker for long.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct Limits<'a> {
+    /// Stops the conversion soon after it is set non-zero, from any thread.
+    pub cancel: Option<&'a AtomicI32>,
+    /// How long the conversion may take.
+    pub time: Option<Duration>,
+    /// How many bytes the model may take while it is converted (what the
+    /// XMILE takes isn't counted).
+    pub memory: Option<u64>,
 }
 
-// xmutil isn't thread-safe, so we need to synchronize calls into it.
-lazy_static! {
-    static ref LOCK: Mutex<()> = Mutex::new(());
+#[repr(C)]
+struct RawLimits {
+    cancel: *const AtomicI32,
+    seconds: f64,
+    memory_bytes: u64,
 }
 
+// each call to _convert_mdl_to_xmile has its own parser state, so
+// conversions can safely run concurrently on different threads.
 pub fn convert_vensim_mdl(mdl_source: &str, is_compact: bool) -> Option<String> {
-    // always grab the lock guard before calling in to _convert_mdl_to_xmile
-    let _guard = LOCK.lock().unwrap();
+    convert_vensim_mdl_checked(mdl_source, is_compact, 0).ok()
+}
+
+/// Like `convert_vensim_mdl` with `flags` (such as `SKIP_VIEWS`) changing
+/// what is converted.
+pub fn convert_vensim_mdl_with_flags(
+    mdl_source: &str,
+    is_compact: bool,
+    flags: u32,
+) -> Option<String> {
+    convert_vensim_mdl_checked(mdl_source, is_compact, flags).ok()
+}
+
+/// Like `convert_vensim_mdl_with_flags` but saying why a conversion
+/// failed.
+pub fn convert_vensim_mdl_checked(
+    mdl_source: &str,
+    is_compact: bool,
+    flags: u32,
+) -> Result<String, ConvertError> {
+    checked_result(|buf, len, raw, count| unsafe {
+        _convert_mdl_to_xmile_diagnostics(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            is_compact,
+            flags,
+            buf,
+            len,
+            raw,
+            count,
+        )
+    })
+}
+
+/// Like `convert_vensim_mdl_checked` but giving up with
+/// `ConvertError::Stopped` once one of `limits` is hit.
+pub fn convert_vensim_mdl_limited(
+    mdl_source: &str,
+    is_compact: bool,
+    flags: u32,
+    limits: &Limits,
+) -> Result<String, ConvertError> {
+    let raw_limits = RawLimits {
+        cancel: limits
+            .cancel
+            .map_or(std::ptr::null(), |c| c as *const AtomicI32),
+        seconds: limits
+            .time
+            .map_or(0.0, |t| t.as_secs_f64().max(f64::MIN_POSITIVE)),
+        memory_bytes: limits.memory.map_or(0, |m| m.max(1)),
+    };
+    checked_result(|buf, len, raw, count| unsafe {
+        _convert_mdl_to_xmile_limited(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            is_compact,
+            flags,
+            &raw_limits,
+            buf,
+            len,
+            raw,
+            count,
+        )
+    })
+}
+
+/// Checks the units given for each variable in the MDL against its
+/// equation, with a diagnostic for each that doesn't fit (the variable
+/// named, line 0) - empty if all do, or the units are left out.
+pub fn check_vensim_mdl_units(mdl_source: &str) -> Result<Vec<Diagnostic>, ConvertError> {
+    checked_warnings(mdl_source, CHECK_UNITS, XMUTIL_WARNING_UNITS)
+}
+
+/// Finds the loops of simultaneous equations in the MDL - equations that
+/// each need the next computed first, so the model can't be simulated -
+/// with a diagnostic for each naming the variables around it (the first
+/// of them as its variable, line 0).  Empty if there are none.
+pub fn check_vensim_mdl_loops(mdl_source: &str) -> Result<Vec<Diagnostic>, ConvertError> {
+    checked_warnings(mdl_source, CHECK_LOOPS, XMUTIL_WARNING_SIMULTANEOUS)
+}
+
+// converts with the check flag set and hands back the warnings of kind it
+// gave
+fn checked_warnings(
+    mdl_source: &str,
+    flag: u32,
+    kind: i32,
+) -> Result<Vec<Diagnostic>, ConvertError> {
+    let mut warnings = vec![];
+    checked_bytes(|buf, len, raw, count| unsafe {
+        let status = _convert_mdl_to_xmile_diagnostics(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            false,
+            SKIP_VIEWS | flag,
+            buf,
+            len,
+            raw,
+            count,
+        );
+        if status == XMUTIL_OK {
+            warnings = take_diagnostics(*raw, *count, kind);
+            *raw = std::ptr::null_mut();
+        }
+        status
+    })?;
+    Ok(warnings)
+}
+
+/// Like `convert_vensim_mdl_checked` but reading the MDL from the file at
+/// `path`.  The file is memory mapped rather than read into a `String`,
+/// so a large model isn't held in memory twice, and needn't be valid
+/// UTF-8 up front.
+pub fn convert_vensim_mdl_file<P: AsRef<Path>>(
+    path: P,
+    is_compact: bool,
+    flags: u32,
+) -> Result<String, ConvertError> {
+    let c_path = c_path(path.as_ref())?;
+    checked_result(|buf, len, raw, count| unsafe {
+        _convert_mdl_file_to_xmile(c_path.as_ptr(), is_compact, flags, buf, len, raw, count)
+    })
+}
+
+/// Like `convert_vensim_mdl_checked` but giving back the XMILE as gzip,
+/// compressed as it is written rather than in a pass over the whole text
+/// afterwards.
+pub fn convert_vensim_mdl_gzip(
+    mdl_source: &str,
+    is_compact: bool,
+    flags: u32,
+) -> Result<Vec<u8>, ConvertError> {
+    checked_bytes(|buf, len, raw, count| unsafe {
+        _convert_mdl_to_xmile_diagnostics(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            is_compact,
+            flags | OUTPUT_GZIP,
+            buf,
+            len,
+            raw,
+            count,
+        )
+    })
+}
+
+fn c_path(path: &Path) -> Result<CString, ConvertError> {
+    #[cfg(unix)]
+    let bytes = {
+        use std::os::unix::ffi::OsStrExt;
+        Some(path.as_os_str().as_bytes())
+    };
+    #[cfg(not(unix))]
+    let bytes = path.to_str().map(|s| s.as_bytes());
+    bytes
+        .and_then(|b| CString::new(b).ok())
+        .ok_or_else(|| ConvertError::Read(format!("unusable path {}", path.display())))
+}
+
+/// Like `convert_vensim_mdl_checked` but pulling the MDL from `reader` as
+/// the conversion gets to it, so only a window around the equation being
+/// read (and the sketch at the end) is held in memory rather than the
+/// whole file.  A failed read is `ConvertError::Read`.
+pub fn convert_vensim_mdl_reader<R: Read>(
+    reader: R,
+    is_compact: bool,
+    flags: u32,
+) -> Result<String, ConvertError> {
+    struct Source<R> {
+        reader: R,
+        error: Option<std::io::Error>,
+    }
+    extern "C" fn read<R: Read>(context: *mut u8, buffer: *mut u8, size: usize) -> usize {
+        let source = unsafe { &mut *(context as *mut Source<R>) };
+        if source.error.is_some() {
+            return 0;
+        }
+        let buf = unsafe { std::slice::from_raw_parts_mut(buffer, size) };
+        loop {
+            match source.reader.read(buf) {
+                Ok(n) => return n,
+                Err(e) if e.kind() == std::io::ErrorKind::Interrupted => continue,
+                Err(e) => {
+                    source.error = Some(e);
+                    return 0;
+                }
+            }
+        }
+    }
+    let mut source = Source {
+        reader,
+        error: None,
+    };
+    let context = &mut source as *mut Source<R> as *mut u8;
+    let result = checked_result(|buf, len, raw, count| unsafe {
+        _convert_mdl_reader_to_xmile(read::<R>, context, is_compact, flags, buf, len, raw, count)
+    });
+    match source.error {
+        Some(e) => Err(ConvertError::Read(format!("unable to read the MDL: {}", e))),
+        None => result,
+    }
+}
+
+// runs one of the conversions with diagnostics and turns what it hands
+// back into a Result
+fn checked_result<F>(convert: F) -> Result<String, ConvertError>
+where
+    F: FnOnce(&mut *mut i8, &mut usize, &mut *mut RawDiagnostic, &mut u32) -> i32,
+{
+    checked_bytes(convert).map(|bytes| String::from_utf8_lossy(&bytes).into_owned())
+}
+
+// as checked_result but leaving the output as it came
+fn checked_bytes<F>(convert: F) -> Result<Vec<u8>, ConvertError>
+where
+    F: FnOnce(&mut *mut i8, &mut usize, &mut *mut RawDiagnostic, &mut u32) -> i32,
+{
+    let mut buf: *mut i8 = std::ptr::null_mut();
+    let mut len: usize = 0;
+    let mut raw: *mut RawDiagnostic = std::ptr::null_mut();
+    let mut count: u32 = 0;
+    let status = convert(&mut buf, &mut len, &mut raw, &mut count);
+    let bytes = unsafe { take_bytes(buf, len) };
+    let diags = unsafe { take_diagnostics(raw, count, XMUTIL_ERROR_PARSE) };
+    let text = || String::from_utf8_lossy(&bytes).into_owned();
+    match status {
+        XMUTIL_OK => Ok(bytes),
+        XMUTIL_ERROR_PARSE => Err(ConvertError::Parse(diags)),
+        XMUTIL_ERROR_READ => Err(ConvertError::Read(text())),
+        XMUTIL_ERROR_CANCELLED | XMUTIL_ERROR_DEADLINE | XMUTIL_ERROR_MEMORY => {
+            Err(ConvertError::Stopped(text()))
+        }
+        _ => Err(ConvertError::Output(text())),
+    }
+}
+
+/// The threads a batch call given 0 threads uses: one per core.
+pub fn available_threads() -> usize {
+    unsafe { _available_threads() as usize }
+}
+
+/// Makes `available_threads` give `threads` on the calling thread, for the
+/// batch calls, `PARALLEL_PARSE` and writing large models there, whatever
+/// the cores; 0 goes back to one per core.  For trying the threaded paths
+/// on a machine with fewer cores than they need.
+pub fn set_available_threads(threads: usize) {
+    unsafe { _set_available_threads(threads as u32) }
+}
+
+/// Converts many MDL files in one call, spreading the work over
+/// `n_threads` threads (0 uses one thread per core).  Results are in
+/// the same order as `mdl_sources`.
+pub fn convert_vensim_mdl_batch(
+    mdl_sources: &[&str],
+    is_compact: bool,
+    n_threads: usize,
+) -> Vec<Option<String>> {
+    let ptrs: Vec<*const u8> = mdl_sources.iter().map(|s| s.as_ptr()).collect();
+    let lens: Vec<u32> = mdl_sources.iter().map(|s| s.len() as u32).collect();
+    let mut results: Vec<*const i8> = vec![std::ptr::null(); mdl_sources.len()];
+
+    unsafe {
+        _convert_mdl_to_xmile_batch(
+            ptrs.as_ptr(),
+            lens.as_ptr(),
+            mdl_sources.len() as u32,
+            is_compact,
+            n_threads.min(u32::MAX as usize) as u32,
+            results.as_mut_ptr(),
+        );
+        results
+            .into_iter()
+            .map(|buf| xmile_from_result(buf))
+            .collect()
+    }
+}
+
+/// Like `convert_vensim_mdl` but also reports how long each stage took;
+/// meant for benchmarking.
+pub fn convert_vensim_mdl_timed(
+    mdl_source: &str,
+    is_compact: bool,
+) -> (Option<String>, StageTimes) {
+    let mut seconds = [0.0f64; 5];
+    let xmile = unsafe {
+        let result_buf = _convert_mdl_to_xmile_timed(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            is_compact,
+            seconds.as_mut_ptr(),
+        );
+        xmile_from_result(result_buf)
+    };
+    let times = StageTimes {
+        lex: seconds[0],
+        parse: seconds[1],
+        mark_types: seconds[2],
+        attach: seconds[3],
+        print: seconds[4],
+    };
+    (xmile, times)
+}
+
+/// Like `convert_vensim_mdl_with_flags` but also counting what the
+/// conversion did; cheap enough to use on every conversion.
+pub fn convert_vensim_mdl_with_stats(
+    mdl_source: &str,
+    is_compact: bool,
+    flags: u32,
+) -> (Option<String>, ConversionStats) {
+    let mut stats = ConversionStats::default();
+    let xmile = unsafe {
+        let result_buf = _convert_mdl_to_xmile_stats(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            is_compact,
+            flags,
+            &mut stats,
+        );
+        xmile_from_result(result_buf)
+    };
+    (xmile, stats)
+}
+
+/// Simulates the model with xmutil's own engine rather than converting it,
+/// which is handy for checking a conversion.  The result is tab separated:
+/// a header of variable names (Time first) and then a line per saved time.
+/// Models using arrays, macros or functions the engine doesn't know give
+/// `None`, as do those with simultaneous equations (`check_vensim_mdl_loops`
+/// says which).
+pub fn simulate_vensim_mdl(mdl_source: &str) -> Option<String> {
+    unsafe {
+        let result_buf = _simulate_mdl(mdl_source.as_ptr(), mdl_source.len() as u32);
+        xmile_from_result(result_buf)
+    }
+}
+
+/// Simulates the model as `simulate_vensim_mdl` does but timing every
+/// equation, to see which dominate the run.  The result is tab separated: a
+/// header and then a line per variable, the one that took longest first,
+/// giving its share of the time, the ticks (processor cycles where there is
+/// a counter for them, otherwise nanoseconds) spent on it in all and in
+/// each of the initial, active and rate phases, and how many times it was
+/// computed in each.  `None` as for `simulate_vensim_mdl`.
+pub fn profile_vensim_mdl(mdl_source: &str) -> Option<String> {
+    unsafe {
+        let result_buf = _profile_mdl(mdl_source.as_ptr(), mdl_source.len() as u32);
+        xmile_from_result(result_buf)
+    }
+}
+
+/// Writes the model out as the source of a C module that simulates it with
+/// no interpreter, for building into a shared library or a wasm module.
+/// Its functions are the same for every model: `xm_init` a workspace of
+/// `xm_workspace_size()` bytes, change any of the parameters (the
+/// variables whose equations are just numbers) with `xm_set_parameter`,
+/// then `xm_run` it and read `xm_row_count()` rows of `xm_column_count()`
+/// values from `xm_results`, Time first.  Built with `-ffp-contract=off`
+/// it gives exactly what `simulate_vensim_mdl` does.  `None` if the model
+/// can't be simulated or uses something only the interpreter can compute.
+pub fn generate_vensim_mdl_c(mdl_source: &str) -> Option<String> {
+    unsafe {
+        let result_buf = _generate_c_mdl(mdl_source.as_ptr(), mdl_source.len() as u32);
+        xmile_from_result(result_buf)
+    }
+}
+
+/// Simulates the model `runs` times for a Monte Carlo or sensitivity study,
+/// compiling it only once and spreading the runs over `n_threads` threads
+/// (0 uses one per core).  Each run's `RANDOM` functions draw from a stream
+/// of their own, so run `i` depends only on `seed` and `i` and the results
+/// are the same however many threads there are.  The results, in run
+/// order, are in `simulate_vensim_mdl`'s format but with just Time and the
+/// `variables` named (everything if there are none), and only what those
+/// need is computed.  Where the model allows, a few runs at a time go
+/// through each step together.  `None` if the model can't be simulated or a variable
+/// isn't in it.
+pub fn simulate_vensim_mdl_runs(
+    mdl_source: &str,
+    runs: u32,
+    seed: u64,
+    variables: &[&str],
+    n_threads: usize,
+) -> Option<Vec<String>> {
+    extern "C" fn sink(run: u32, results: *const u8, len: usize, context: *mut u8) {
+        let out = unsafe { &mut *(context as *mut Vec<String>) };
+        let bytes = unsafe { std::slice::from_raw_parts(results, len) };
+        out[run as usize] = String::from_utf8_lossy(bytes).into_owned();
+    }
+    let names = variables
+        .iter()
+        .map(|&v| CString::new(v))
+        .collect::<Result<Vec<_>, _>>()
+        .ok()?;
+    let ptrs: Vec<*const i8> = names.iter().map(|n| n.as_ptr()).collect();
+    let mut out = vec![String::new(); runs as usize];
+    let ok = unsafe {
+        _simulate_mdl_runs(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            runs,
+            seed,
+            ptrs.as_ptr(),
+            ptrs.len() as u32,
+            n_threads.min(u32::MAX as usize) as u32,
+            sink,
+            &mut out as *mut Vec<String> as *mut u8,
+        )
+    };
+    if ok {
+        Some(out)
+    } else {
+        None
+    }
+}
 
-    let str_ptr = mdl_source.as_ptr();
-    let str_len = mdl_source.len() as u32;
+/// Simulates the model once for each entry of `values` as
+/// `simulate_vensim_mdl_runs` does, but with the `parameters` named set to
+/// that entry's values in place of the numbers the model has, for a
+/// sensitivity sweep.  A parameter is a variable whose equation is a
+/// number, or an element of one named as its column is (`stock[north]`),
+/// other than the control parameters.  Runs going through each step
+/// together each take their own values.  `None` as for
+/// `simulate_vensim_mdl_runs`, or if an entry doesn't have a value for each
+/// parameter or a parameter can't be set.
+pub fn simulate_vensim_mdl_sweep(
+    mdl_source: &str,
+    seed: u64,
+    parameters: &[&str],
+    values: &[Vec<f64>],
+    variables: &[&str],
+    n_threads: usize,
+) -> Option<Vec<String>> {
+    extern "C" fn sink(run: u32, results: *const u8, len: usize, context: *mut u8) {
+        let out = unsafe { &mut *(context as *mut Vec<String>) };
+        let bytes = unsafe { std::slice::from_raw_parts(results, len) };
+        out[run as usize] = String::from_utf8_lossy(bytes).into_owned();
+    }
+    if values.iter().any(|run| run.len() != parameters.len()) {
+        return None;
+    }
+    let c_strings = |names: &[&str]| {
+        names
+            .iter()
+            .map(|&v| CString::new(v))
+            .collect::<Result<Vec<_>, _>>()
+            .ok()
+    };
+    let parameter_names = c_strings(parameters)?;
+    let variable_names = c_strings(variables)?;
+    let parameter_ptrs: Vec<*const i8> = parameter_names.iter().map(|n| n.as_ptr()).collect();
+    let variable_ptrs: Vec<*const i8> = variable_names.iter().map(|n| n.as_ptr()).collect();
+    let flat: Vec<f64> = values.concat();
+    let mut out = vec![String::new(); values.len()];
+    let ok = unsafe {
+        _simulate_mdl_sweep(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            values.len() as u32,
+            seed,
+            parameter_ptrs.as_ptr(),
+            parameter_ptrs.len() as u32,
+            flat.as_ptr(),
+            variable_ptrs.as_ptr(),
+            variable_ptrs.len() as u32,
+            n_threads.min(u32::MAX as usize) as u32,
+            sink,
+            &mut out as *mut Vec<String> as *mut u8,
+        )
+    };
+    if ok {
+        Some(out)
+    } else {
+        None
+    }
+}
 
+/// Simulates the model once, handing `on_chunk` the values recorded as
+/// columns rather than text: the names (Time first, then the `variables`
+/// asked for, or everything if there are none) and a slice per name.  Only
+/// `chunk_rows` saved times (0 for the whole run) are held at once, each
+/// lot going to `on_chunk` as it fills, so a long run needs no more memory
+/// than a short one.  False if the model can't be simulated or a variable
+/// isn't in it - some chunks may have been handed over by then.
+pub fn simulate_vensim_mdl_columns<F: FnMut(&[String], &[&[f64]])>(
+    mdl_source: &str,
+    variables: &[&str],
+    chunk_rows: usize,
+    mut on_chunk: F,
+) -> bool {
+    struct Chunks<'a> {
+        names: Vec<String>,
+        on_chunk: &'a mut dyn FnMut(&[String], &[&[f64]]),
+    }
+    extern "C" fn sink(
+        names: *const i8,
+        columns: *const *const f64,
+        column_count: u32,
+        rows: u32,
+        context: *mut u8,
+    ) {
+        let chunks = unsafe { &mut *(context as *mut Chunks) };
+        if chunks.names.is_empty() {
+            let joined = unsafe { std::ffi::CStr::from_ptr(names) };
+            chunks.names = joined
+                .to_string_lossy()
+                .split('\t')
+                .map(String::from)
+                .collect();
+        }
+        let columns = unsafe { std::slice::from_raw_parts(columns, column_count as usize) };
+        let columns: Vec<&[f64]> = columns
+            .iter()
+            .map(|&c| unsafe { std::slice::from_raw_parts(c, rows as usize) })
+            .collect();
+        (chunks.on_chunk)(&chunks.names, &columns);
+    }
+    let names = match variables
+        .iter()
+        .map(|&v| CString::new(v))
+        .collect::<Result<Vec<_>, _>>()
+    {
+        Ok(names) => names,
+        Err(_) => return false,
+    };
+    let ptrs: Vec<*const i8> = names.iter().map(|n| n.as_ptr()).collect();
+    let mut chunks = Chunks {
+        names: Vec::new(),
+        on_chunk: &mut on_chunk,
+    };
     unsafe {
-        let result_buf = _convert_mdl_to_xmile(str_ptr, str_len, is_compact);
-        if result_buf.is_null() {
-            return None;
-        }
-        // TODO: I think we might be leaking this
-        let c_str: &CStr = CStr::from_ptr(result_buf);
-        let str_slice: &str = c_str.to_str().unwrap();
-        if str_slice.is_empty() {
+        _simulate_mdl_columns(
+            mdl_source.as_ptr(),
+            mdl_source.len() as u32,
+            ptrs.as_ptr(),
+            ptrs.len() as u32,
+            chunk_rows.min(u32::MAX as usize) as u32,
+            sink,
+            &mut chunks as *mut Chunks as *mut u8,
+        )
+    }
+}
+
+/// Adds external data for models simulated from now on to read with
+/// `GET DIRECT DATA` and the `GET DATA` functions.  `name` is the file
+/// name the models give and `text` is CSV or tab separated, as a
+/// spreadsheet saves it.  The data is parsed once and kept for the rest
+/// of the process, however many models use it.  False if there is nothing
+/// in it to use.
+pub fn add_data(name: &str, text: &str) -> bool {
+    match CString::new(name) {
+        Ok(name) => unsafe { _data_store_add(name.as_ptr(), text.as_ptr(), text.len() as u32) },
+        Err(_) => false,
+    }
+}
+
+/// Like `add_data` but reading the file at `path`, which may also be a
+/// cache written by `write_data_cache` - that is memory mapped rather
+/// than parsed again.
+pub fn load_data_file<P: AsRef<Path>>(name: &str, path: P) -> bool {
+    match (CString::new(name), c_path(path.as_ref())) {
+        (Ok(name), Ok(path)) => unsafe { _data_store_load(name.as_ptr(), path.as_ptr()) },
+        _ => false,
+    }
+}
+
+/// Writes the data added as `name` to `path` in a form `load_data_file`
+/// can map straight into memory.
+pub fn write_data_cache<P: AsRef<Path>>(name: &str, path: P) -> bool {
+    match (CString::new(name), c_path(path.as_ref())) {
+        (Ok(name), Ok(path)) => unsafe { _data_store_write_cache(name.as_ptr(), path.as_ptr()) },
+        _ => false,
+    }
+}
+
+/// Forgets all the data added.  Simulations already made go on reading
+/// what they were made with.
+pub fn clear_data() {
+    unsafe { _data_store_clear() }
+}
+
+/// A model simulated once, checkpointing the run as it goes, for what-if
+/// runs with some of its constants changed.  Each rerun carries on from the
+/// last checkpoint before the earliest time the changed constants can make
+/// a difference - a constant only read through the height of a `STEP`
+/// that starts halfway through needs only the second half run again.
+pub struct CheckpointedSimulation {
+    simulation: *mut u8,
+}
+
+// the simulation is only ever rerun through &mut self
+unsafe impl Send for CheckpointedSimulation {}
+
+impl CheckpointedSimulation {
+    /// Simulates the model as `simulate_vensim_mdl` does, taking a
+    /// checkpoint every `checkpoint_interval` of model time.  `None` if the
+    /// model can't be simulated.
+    pub fn new(mdl_source: &str, checkpoint_interval: f64) -> Option<CheckpointedSimulation> {
+        let simulation = unsafe {
+            _simulation_new(
+                mdl_source.as_ptr(),
+                mdl_source.len() as u32,
+                checkpoint_interval,
+            )
+        };
+        if simulation.is_null() {
             None
         } else {
-            Some(str_slice.to_owned())
+            Some(CheckpointedSimulation { simulation })
+        }
+    }
+
+    /// What `simulate_vensim_mdl` would give for the model with the
+    /// `constants` named set to the values given (the rest as the MDL has
+    /// them), and how many of its rows were copied from the first run
+    /// rather than computed again.  `None` if the run fails or a name isn't
+    /// a variable whose equation is a number.
+    pub fn rerun(&mut self, constants: &[(&str, f64)]) -> Option<(String, usize)> {
+        let names = constants
+            .iter()
+            .map(|&(name, _)| CString::new(name))
+            .collect::<Result<Vec<_>, _>>()
+            .ok()?;
+        let ptrs: Vec<*const i8> = names.iter().map(|n| n.as_ptr()).collect();
+        let values: Vec<f64> = constants.iter().map(|&(_, value)| value).collect();
+        let mut reused: u32 = 0;
+        unsafe {
+            let result_buf = _simulation_rerun(
+                self.simulation,
+                ptrs.as_ptr(),
+                values.as_ptr(),
+                ptrs.len() as u32,
+                &mut reused,
+            );
+            xmile_from_result(result_buf).map(|results| (results, reused as usize))
         }
     }
 }
 
+impl Drop for CheckpointedSimulation {
+    fn drop(&mut self) {
+        unsafe { _simulation_free(self.simulation) }
+    }
+}
+
+/// Converts successive edits of one MDL file, as an editor does after each
+/// change.  A version identical to the last one gets the last XMILE back
+/// without converting.  When only some equations changed just those are
+/// read again and put in place in the model kept from the last version;
+/// anything else is converted in full.  `reparsed_chunks` says how many
+/// equations were read.
+pub struct MdlSession {
+    session: *mut u8,
+    reparsed_chunks: usize,
+}
+
+// the session is only ever used through &mut self
+unsafe impl Send for MdlSession {}
+
+impl MdlSession {
+    pub fn new(is_compact: bool, flags: u32) -> MdlSession {
+        MdlSession {
+            session: unsafe { _mdl_session_new(is_compact, flags) },
+            reparsed_chunks: 0,
+        }
+    }
+
+    pub fn convert(&mut self, mdl_source: &str) -> Option<String> {
+        let mut reparsed: u32 = 0;
+        unsafe {
+            let result_buf = _mdl_session_convert(
+                self.session,
+                mdl_source.as_ptr(),
+                mdl_source.len() as u32,
+                &mut reparsed,
+            );
+            self.reparsed_chunks = reparsed as usize;
+            xmile_from_result(result_buf)
+        }
+    }
+
+    /// The equation chunks (with the sketch and settings counted as one)
+    /// read by the last `convert` - all of them when it converted in full,
+    /// none when nothing had changed.
+    pub fn reparsed_chunks(&self) -> usize {
+        self.reparsed_chunks
+    }
+}
+
+impl Drop for MdlSession {
+    fn drop(&mut self) {
+        unsafe { _mdl_session_free(self.session) }
+    }
+}
+
+/// An MDL file read once, to be written as many times as needed with
+/// different output options - compact or not, `MINIMAL` or gzip - without
+/// reading and analyzing it again for each.
+pub struct MdlModel {
+    model: *mut u8,
+}
+
+// the model is only ever written through &mut self
+unsafe impl Send for MdlModel {}
+
+impl MdlModel {
+    /// Reads the MDL.  `flags` are those changing what is read:
+    /// `SKIP_VIEWS`, `SKIP_DOCS` and `SHARE_EXPRESSIONS`.
+    pub fn read(mdl_source: &str, flags: u32) -> Result<MdlModel, ConvertError> {
+        let mut raw: *mut RawDiagnostic = std::ptr::null_mut();
+        let mut count: u32 = 0;
+        unsafe {
+            let model = _mdl_model_read(
+                mdl_source.as_ptr(),
+                mdl_source.len() as u32,
+                flags,
+                &mut raw,
+                &mut count,
+            );
+            let diags = take_diagnostics(raw, count, XMUTIL_ERROR_PARSE);
+            if model.is_null() {
+                Err(ConvertError::Parse(diags))
+            } else {
+                Ok(MdlModel { model })
+            }
+        }
+    }
+
+    /// What `convert_vensim_mdl_checked` would give for the MDL, with
+    /// `flags` added to those it was read with.
+    pub fn write(&mut self, is_compact: bool, flags: u32) -> Result<String, ConvertError> {
+        let model = self.model;
+        checked_result(|buf, len, _, _| unsafe {
+            _mdl_model_write(model, is_compact, flags, buf, len)
+        })
+    }
+
+    /// As `convert_vensim_mdl_gzip` for the MDL.
+    pub fn write_gzip(&mut self, is_compact: bool, flags: u32) -> Result<Vec<u8>, ConvertError> {
+        let model = self.model;
+        checked_bytes(|buf, len, _, _| unsafe {
+            _mdl_model_write(model, is_compact, flags | OUTPUT_GZIP, buf, len)
+        })
+    }
+}
+
+impl Drop for MdlModel {
+    fn drop(&mut self) {
+        unsafe { _mdl_model_free(self.model) }
+    }
+}
+
+// copies out and frees a string returned by the C++ side
+unsafe fn take_result(buf: *mut i8, len: usize) -> String {
+    String::from_utf8_lossy(&take_bytes(buf, len)).into_owned()
+}
+
+// as take_result for output that needn't be text
+unsafe fn take_bytes(buf: *mut i8, len: usize) -> Vec<u8> {
+    if buf.is_null() {
+        return vec![];
+    }
+    let bytes = std::slice::from_raw_parts(buf as *const u8, len).to_vec();
+    xmutil_free_result(buf as *mut u8);
+    bytes
+}
+
+// copies out the diagnostics of one kind from a conversion and frees them all
+unsafe fn take_diagnostics(raw: *mut RawDiagnostic, count: u32, kind: i32) -> Vec<Diagnostic> {
+    if raw.is_null() {
+        return vec![];
+    }
+    let text = |s: *const i8| CStr::from_ptr(s).to_string_lossy().into_owned();
+    let diags = std::slice::from_raw_parts(raw, count as usize)
+        .iter()
+        .filter(|d| d.kind == kind)
+        .map(|d| Diagnostic {
+            line: d.line,
+            position: d.position,
+            message: text(d.message),
+            variable: Some(text(d.variable)).filter(|v| !v.is_empty()),
+        })
+        .collect();
+    xmutil_free_result(raw as *mut u8);
+    diags
+}
+
+unsafe fn xmile_from_result(result_buf: *const i8) -> Option<String> {
+    if result_buf.is_null() {
+        return None;
+    }
+    let len = CStr::from_ptr(result_buf).to_bytes().len();
+    let text = take_result(result_buf as *mut i8, len);
+    if text.is_empty() {
+        None
+    } else {
+        Some(text)
+    }
+}
+
 #[cfg(test)]
 mod tests {
-    #[test]
-    fn it_works() {
-        let mdl_source = "{UTF-8}
+    use std::fmt::Write;
+
+    const MDL_SOURCE: &str = "{UTF-8}
 Inflow=
 	IF THEN ELSE(Time = INITIAL TIME , 10 , 3 )
 	~
@@ -159,13 +1285,2067 @@ $192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|72,72,1
 26:10
 ";
 
-        let actual = crate::convert_vensim_mdl(mdl_source, false).unwrap();
-        assert!(actual.starts_with("<xmile "));
-        assert!(actual.ends_with("</xmile>\n"));
-    }
-
     #[test]
-    fn failure_is_none() {
-        assert!(crate::convert_vensim_mdl(":ohno:", true).is_none())
+    fn it_works() {
+        let mdl_source = "{UTF-8}
+Inflow=
+	IF THEN ELSE(Time = INITIAL TIME , 10 , 3 )
+	~
+	~		|
+
+Outflow 1=
+	Stock/TIME STEP
+	~
+	~		|
+
+Outflow 2=
+	IF THEN ELSE( Time = FINAL TIME , 2 , 0 )
+	~
+	~		|
+
+Stock= INTEG (
+	Inflow-Outflow 1-Outflow 2,
+		0)
+	~
+	~		|
+
+********************************************************
+	.Control
+********************************************************~
+		Simulation Control Parameters
+	|
+
+FINAL TIME  = 10
+	~	Month
+	~	The final time for the simulation.
+	|
+
+INITIAL TIME  = 0
+	~	Month
+	~	The initial time for the simulation.
+	|
+
+SAVEPER  =
+        TIME STEP
+	~	Month [0,?]
+	~	The frequency with which output is stored.
+	|
+
+TIME STEP  = 1
+	~	Month [0,?]
+	~	The time step for the simulation.
+	|
+
+\\\\\\---/// Sketch information - do not modify anything except names
+V300  Do not put anything below this section - it will be ignored
+*View 1
+$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|72,72,100,0
+10,1,Stock,351,249,40,20,3,3,0,0,0,0,0,0
+12,2,48,513,251,10,8,0,3,0,0,-1,0,0,0
+1,4,6,2,4,0,0,22,0,0,0,-1--1--1,,1|(478,251)|
+1,5,6,1,100,0,0,22,0,0,0,-1--1--1,,1|(416,251)|
+11,6,0,447,251,6,8,34,3,0,0,1,0,0,0
+10,7,Outflow 1,447,267,27,8,40,3,0,0,-1,0,0,0
+1,8,1,7,1,0,0,0,0,128,0,-1--1--1,,1|(394,294)|
+10,9,TIME STEP,485,317,39,8,8,2,0,3,-1,0,0,0,128-128-128,0-0-0,|0||128-128-128
+1,10,9,7,0,0,0,0,0,128,0,-1--1--1,,1|(470,297)|
+12,11,48,191,244,10,8,0,3,0,0,-1,0,0,0
+1,13,15,1,4,0,0,22,0,0,0,-1--1--1,,1|(286,244)|
+1,14,15,11,100,0,0,22,0,0,0,-1--1--1,,1|(225,244)|
+11,15,0,256,244,6,8,34,3,0,0,1,0,0,0
+10,16,Inflow,256,260,18,8,40,3,0,0,-1,0,0,0
+10,17,INITIAL TIME,190,309,47,8,8,2,0,3,-1,0,0,0,128-128-128,0-0-0,|0||128-128-128
+1,18,17,16,0,0,0,0,0,128,0,-1--1--1,,1|(216,288)|
+10,19,Time,292,310,21,8,8,2,0,3,-1,0,0,0,128-128-128,0-0-0,|0||128-128-128
+1,20,19,16,0,0,0,0,0,128,0,-1--1--1,,1|(278,290)|
+12,21,48,355,133,10,8,0,3,0,0,-1,0,0,0
+1,23,25,21,4,0,0,22,0,0,0,-1--1--1,,1|(356,159)|
+1,24,25,1,100,0,0,22,0,0,0,-1--1--1,,1|(356,209)|
+11,25,0,356,183,8,6,33,3,0,0,4,0,0,0
+10,26,Outflow 2,391,183,27,8,40,3,0,0,-1,0,0,0
+10,27,Time,428,131,21,8,8,2,0,3,-1,0,0,0,128-128-128,0-0-0,|0||128-128-128
+10,28,FINAL TIME,494,188,43,8,8,2,0,3,-1,0,0,0,128-128-128,0-0-0,|0||128-128-128
+1,29,28,26,0,0,0,0,0,128,0,-1--1--1,,1|(441,185)|
+1,30,27,26,0,0,0,0,0,128,0,-1--1--1,,1|(413,151)|
+///---\\\\\\
+:L<%^E!@
+1:Current.vdf
+9:Current
+22:$,Dollar,Dollars,$s
+22:Day,Days
+22:Hour,Hours
+22:Month,Months
+22:Person,People,Persons
+22:Unit,Units
+22:Week,Weeks
+22:Year,Years
+15:0,0,0,0,0,0
+19:100,0
+27:2,
+34:0,
+4:Time
+5:Stock
+35:Date
+36:YYYY-MM-DD
+37:2000
+38:1
+39:1
+40:2
+41:0
+42:1
+24:0
+25:10
+26:10
+";
+
+        let actual = crate::convert_vensim_mdl(mdl_source, false).unwrap();
+        assert!(actual.starts_with("<xmile "));
+        assert!(actual.ends_with("</xmile>\n"));
+    }
+
+    #[test]
+    fn non_ascii_names() {
+        // names starting with a multi-byte character, referenced in a different case
+        let source = MDL_SOURCE
+            .replace("\tInflow-Outflow", "\tÜBERFLUSS-Outflow")
+            .replace("Inflow", "Überfluss")
+            .replace("Stock", "Ölstand");
+        let actual = crate::convert_vensim_mdl(&source, true).unwrap();
+        assert!(actual.contains("<flow name=\"Überfluss\">"));
+        assert!(actual.contains("<stock name=\"Ölstand\">"));
+        assert!(actual.contains("<inflow>Überfluss</inflow>"));
+    }
+
+    #[test]
+    fn constants_keep_precision() {
+        let source = MDL_SOURCE.replace(", 10 , 3 )", ", 0.1234567 , 1234567 )");
+        let actual = crate::convert_vensim_mdl(&source, true).unwrap();
+        assert!(actual.contains("Time = STARTTIME THEN 0.1234567 ELSE 1234567"));
+    }
+
+    #[test]
+    fn apply_to_all_equations() {
+        let arrays = "region: north, south, east ~ ~ |
+north south: north, south ~ ~ |
+same[north south] = 5 ~ ~ |
+same[east] = 5 ~ ~ |
+differ[north south] = 5 ~ ~ |
+differ[east] = 6 ~ ~ |
+except[region] :EXCEPT: [east] = 5 ~ ~ |
+except[east] = 5 ~ ~ |
+rest[region] :EXCEPT: [east] = 1 ~ ~ |
+rest[east] = 2 ~ ~ |
+south east: south, east ~ ~ |
+overlap[north south] = 5 ~ ~ |
+overlap[south east] = 5 ~ ~ |
+gap[north south] = 5 ~ ~ |
+gap[north] = 5 ~ ~ |
+";
+        let marker = "\\\\\\---///";
+        let source = MDL_SOURCE.replacen(marker, &format!("{}{}", arrays, marker), 1);
+        let actual = crate::convert_vensim_mdl(&source, true).unwrap();
+        assert!(actual.contains("<aux name=\"same\"><eqn>5</eqn><dimensions>"));
+        assert!(actual.contains("<element subscript=\"east\"><eqn>6</eqn></element>"));
+        // the elements an EXCEPT list names are left to the other equations
+        assert!(actual.contains("<aux name=\"except\"><eqn>5</eqn><dimensions>"));
+        let rest = &actual[actual.find("<aux name=\"rest\">").unwrap()..];
+        let rest = &rest[..rest.find("</aux>").unwrap()];
+        assert_eq!(1, rest.matches("<element subscript=\"east\">").count());
+        // as many element equations as elements, but south twice, isn't
+        // every element once - nor is north twice and east never
+        for name in &["overlap", "gap"] {
+            let aux = &actual[actual.find(&format!("<aux name=\"{}\">", name)).unwrap()..];
+            let aux = &aux[..aux.find("</aux>").unwrap()];
+            assert!(aux.contains("<element subscript="), "{}", aux);
+        }
+    }
+
+    #[test]
+    fn timed_conversion() {
+        let expected = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let (actual, times) = crate::convert_vensim_mdl_timed(MDL_SOURCE, true);
+        assert_eq!(Some(expected), actual);
+        assert!(times.lex > 0.0 && times.parse > 0.0 && times.print > 0.0);
+    }
+
+    #[test]
+    fn conversion_stats() {
+        let expected = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let (actual, stats) = crate::convert_vensim_mdl_with_stats(MDL_SOURCE, true, 0);
+        assert_eq!(Some(expected.clone()), actual);
+        assert_eq!(MDL_SOURCE.len() as u64, stats.input_bytes);
+        assert_eq!(expected.len() as u64, stats.output_bytes);
+        assert!(stats.tokens > 0 && stats.lookups >= stats.lookup_misses && stats.variables > 0);
+        assert_eq!(0, stats.recovery_skips);
+        assert!(stats.equation_seconds <= stats.read_seconds);
+        assert!(stats.print_variables_seconds + stats.print_views_seconds <= stats.print_seconds);
+        if stats.allocations_counted != 0 {
+            assert!(stats.allocations[crate::STAGE_PARSE] > 0);
+            assert!(
+                stats.peak_bytes[crate::STAGE_PRINT] <= stats.allocated_bytes[crate::STAGE_PRINT]
+            );
+        } else {
+            assert_eq!(0, stats.allocations.iter().sum::<u64>());
+        }
+
+        let bad = MDL_SOURCE.replacen("~", "= = ~", 1);
+        let (_, stats) = crate::convert_vensim_mdl_with_stats(&bad, true, 0);
+        assert!(stats.recovery_skips > 0);
+    }
+
+    #[test]
+    fn skip_views() {
+        let full = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let actual =
+            crate::convert_vensim_mdl_with_flags(MDL_SOURCE, true, crate::SKIP_VIEWS).unwrap();
+        assert!(full.contains("<view>"));
+        assert!(!actual.contains("<view>"));
+        let eqns = |x: &str| {
+            x.split("<eqn>")
+                .skip(1)
+                .map(|e| e[..e.find("</eqn>").unwrap()].to_string())
+                .collect::<Vec<_>>()
+        };
+        assert_eq!(eqns(&full), eqns(&actual));
+        // the integration method comes from the settings after the sketch
+        let method = |x: &str| {
+            x[x.find("method=").unwrap()..]
+                .split(' ')
+                .next()
+                .unwrap()
+                .to_string()
+        };
+        assert_eq!(method(&full), method(&actual));
+    }
+
+    #[test]
+    fn share_expressions() {
+        for compact in [true, false] {
+            let expected = crate::convert_vensim_mdl(MDL_SOURCE, compact).unwrap();
+            let actual =
+                crate::convert_vensim_mdl_with_flags(MDL_SOURCE, compact, crate::SHARE_EXPRESSIONS)
+                    .unwrap();
+            assert_eq!(expected, actual);
+        }
+    }
+
+    #[test]
+    fn parallel_parse() {
+        // enough equations of every kind that each thread reads several
+        // runs of them, with names first used far from where they're defined
+        let mut big = String::from("{UTF-8}\nregion: north, south, east ~ ~ |\n");
+        for i in 0..400 {
+            let _ = write!(
+                big,
+                "v{i}[region] = v{}[region] * 0.5 + later{} ~ Widget ~ Variable {i} |\n",
+                (i + 399) % 400,
+                i % 7
+            );
+            if i % 40 == 0 {
+                let _ = write!(big, "********************************************************\n\t.Group {i}\n********************************************************~\n\t\t|\n");
+            }
+            if i % 25 == 0 {
+                let _ = write!(
+                    big,
+                    "s{i} = INTEG(in{i} - out{i}, 1) ~ Widget ~ |\nin{i} = table{i}(Time) ~ ~ |\nout{i} = s{i} / 4 ~ ~ |\ntable{i}([(0,0)-(10,10)],(0,0),(5,{i}),(10,2)) ~ ~ |\n"
+                );
+            }
+        }
+        for i in 0..7 {
+            let _ = write!(big, "later{i} = {i} ~ ~ |\n");
+        }
+        big.push_str(&MDL_SOURCE[MDL_SOURCE.find("********").unwrap()..]);
+        let mut sources = vec![MDL_SOURCE.to_string(), big];
+        // macros are read on one thread
+        let macros =
+            ":MACRO: DOUBLE(x)\nDOUBLE = x * 2 ~ ~ |\n:END OF MACRO:\na = DOUBLE(3) ~ ~ |\n";
+        for source in [PRECEDENCE_MDL, PRECEDENCE_ROWS, PRECEDENCE_FOLDED, macros] {
+            sources.push(source.to_string() + "\\\\\\---///\n");
+        }
+        // however many cores this has, the pieces go to several threads
+        for threads in [2, 4] {
+            crate::set_available_threads(threads);
+            assert_eq!(threads, crate::available_threads());
+            for source in &sources {
+                for flags in [0, crate::SKIP_DOCS, crate::SKIP_VIEWS] {
+                    let expected =
+                        crate::convert_vensim_mdl_with_flags(source, false, flags).unwrap();
+                    let actual = crate::convert_vensim_mdl_with_flags(
+                        source,
+                        false,
+                        flags | crate::PARALLEL_PARSE,
+                    )
+                    .unwrap();
+                    assert_eq!(expected, actual);
+                }
+            }
+        }
+        // what is wrong is found just the same
+        let mdl = "a = 1 ~ ~ |\nb = (a + ~ ~ |\nc = a * 2 ~ ~ |\nd = ) ~ ~ |\n\\\\\\---///\n";
+        let diags = |flags| match crate::convert_vensim_mdl_checked(mdl, true, flags) {
+            Err(crate::ConvertError::Parse(diags)) => diags
+                .iter()
+                .map(|d| (d.line, d.message.clone(), d.variable.clone()))
+                .collect::<Vec<_>>(),
+            other => panic!("expected parse diagnostics, got {:?}", other),
+        };
+        assert_eq!(diags(0), diags(crate::PARALLEL_PARSE));
+        crate::set_available_threads(0);
+    }
+
+    #[test]
+    fn parallel_parse_stats() {
+        // what the threads reading the equations do is counted just as it
+        // is reading them on the one
+        let mut mdl = String::from("{UTF-8}\n");
+        for i in 0..300 {
+            let _ = write!(
+                mdl,
+                "v{i} = v{} * 0.5 + later{} + missing ~ Widget ~ |\n",
+                (i + 299) % 300,
+                i % 7
+            );
+            if i % 50 == 0 {
+                let _ = write!(mdl, "********************************************************\n\t.Group {i}\n********************************************************~\n\t\t|\n");
+                let _ = write!(
+                    mdl,
+                    "s{i} = INTEG(table{i}(Time), 1) ~ ~ |\ntable{i}([(0,0)-(10,10)],(0,0),(10,{i})) ~ ~ |\n"
+                );
+            }
+        }
+        mdl.push_str(&MDL_SOURCE[MDL_SOURCE.find("********").unwrap()..]);
+        crate::set_available_threads(4);
+        let (expected, one) = crate::convert_vensim_mdl_with_stats(&mdl, true, 0);
+        let (actual, several) =
+            crate::convert_vensim_mdl_with_stats(&mdl, true, crate::PARALLEL_PARSE);
+        crate::set_available_threads(0);
+        assert_eq!(expected, actual);
+        assert_eq!(one.input_bytes, several.input_bytes);
+        assert_eq!(one.tokens, several.tokens);
+        assert_eq!(one.lookups, several.lookups);
+        assert_eq!(one.lookup_misses, several.lookup_misses);
+        assert_eq!(one.recovery_skips, several.recovery_skips);
+        assert_eq!(one.variables, several.variables);
+        assert_eq!(one.output_bytes, several.output_bytes);
+    }
+
+    #[test]
+    fn parallel_variables() {
+        // more than two runs of PARALLEL_VARIABLES (2048) variables, with
+        // quoted names, arrays, stocks and tables among them
+        let mut mdl = String::from("{UTF-8}\nregion: north, south ~ ~ |\n");
+        for i in 0..5000 {
+            let _ = match i % 5 {
+                0 => write!(mdl, "\"v.{i}\" = {i} ~ Widget ~ Quoted {i} |\n"),
+                1 => write!(mdl, "v{i}[region] = \"v.{}\" * 2 ~ ~ |\n", i - 1),
+                2 => write!(mdl, "v{i} = INTEG(v{}[north], 1) ~ ~ |\n", i - 1),
+                3 => write!(mdl, "v{i}([(0,0)-(2,2)],(0,0),(1,{i}),(2,2)) ~ ~ |\n"),
+                _ => write!(mdl, "v{i} = v{}(Time) + v{} ~ ~ |\n", i - 1, i - 2),
+            };
+        }
+        mdl.push_str(&MDL_SOURCE[MDL_SOURCE.find("********").unwrap()..]);
+        for compact in [false, true] {
+            crate::set_available_threads(1);
+            let expected = crate::convert_vensim_mdl(&mdl, compact).unwrap();
+            for threads in [2, 4] {
+                crate::set_available_threads(threads);
+                assert_eq!(expected, crate::convert_vensim_mdl(&mdl, compact).unwrap());
+            }
+        }
+        // and what the threads writing do is counted as on the one
+        crate::set_available_threads(1);
+        let (_, one) = crate::convert_vensim_mdl_with_stats(&mdl, true, 0);
+        crate::set_available_threads(4);
+        let (_, several) = crate::convert_vensim_mdl_with_stats(&mdl, true, 0);
+        crate::set_available_threads(0);
+        assert_eq!(one.lookups, several.lookups);
+        assert_eq!(one.lookup_misses, several.lookup_misses);
+        assert_eq!(one.output_bytes, several.output_bytes);
+    }
+
+    #[test]
+    fn skip_docs() {
+        let mdl = "rate = 0.1 ~ 1/Month ~ How fast the stock grows |
+stock = INTEG(stock * rate, 1) ~ Widget ~ |
+INITIAL TIME = 0 ~ Month ~ |
+FINAL TIME = 10 ~ Month ~ |
+TIME STEP = 1 ~ Month ~ |
+SAVEPER = TIME STEP ~ Month ~ |
+\\\\\\---/// Sketch information - do not modify anything except names
+";
+        let full = crate::convert_vensim_mdl_with_flags(mdl, false, crate::SKIP_VIEWS).unwrap();
+        let actual =
+            crate::convert_vensim_mdl_with_flags(mdl, false, crate::SKIP_VIEWS | crate::SKIP_DOCS)
+                .unwrap();
+        assert!(full.contains("How fast the stock grows</doc>"));
+        let expected: Vec<&str> = full.lines().filter(|l| !l.contains("<doc>")).collect();
+        assert_eq!(expected, actual.lines().collect::<Vec<&str>>());
+    }
+
+    #[test]
+    fn minimal() {
+        let full = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let minimal =
+            crate::convert_vensim_mdl_with_flags(MDL_SOURCE, true, crate::MINIMAL).unwrap();
+        assert!(full.contains("<start>0.000000</start>"));
+        assert!(minimal.contains("<start>0</start>"));
+        assert!(!minimal.contains("isee:prefs"));
+        assert!(!minimal.contains("method=\"Euler\""));
+        assert!(minimal.len() < full.len());
+    }
+
+    // the bits of a deflate stream, least significant first
+    struct Bits<'a> {
+        data: &'a [u8],
+        pos: usize,
+    }
+
+    impl<'a> Bits<'a> {
+        fn bits(&mut self, n: u32) -> usize {
+            let mut value = 0;
+            for i in 0..n {
+                let bit = (self.data[self.pos / 8] >> (self.pos % 8)) & 1;
+                value |= (bit as usize) << i;
+                self.pos += 1;
+            }
+            value
+        }
+
+        // a symbol of the canonical code with counts[len] codes of each
+        // length, its symbols in code order
+        fn decode(&mut self, code: &(Vec<usize>, Vec<usize>)) -> usize {
+            let (counts, symbols) = code;
+            let (mut value, mut first, mut index) = (0, 0, 0);
+            for count in counts.iter().skip(1) {
+                value |= self.bits(1);
+                if value < first + count {
+                    return symbols[index + value - first];
+                }
+                index += count;
+                first = (first + count) << 1;
+                value <<= 1;
+            }
+            panic!("bad code at bit {}", self.pos);
+        }
+    }
+
+    fn huffman(lengths: &[usize]) -> (Vec<usize>, Vec<usize>) {
+        let mut counts = vec![0; 16];
+        for &len in lengths {
+            counts[len] += 1;
+        }
+        counts[0] = 0;
+        let mut symbols = Vec::new();
+        for len in 1..16 {
+            symbols.extend((0..lengths.len()).filter(|&sym| lengths[sym] == len));
+        }
+        (counts, symbols)
+    }
+
+    fn crc32(data: &[u8]) -> u32 {
+        let mut crc = !0u32;
+        for &byte in data {
+            crc ^= byte as u32;
+            for _ in 0..8 {
+                crc = if crc & 1 != 0 {
+                    (crc >> 1) ^ 0xedb8_8320
+                } else {
+                    crc >> 1
+                };
+            }
+        }
+        !crc
+    }
+
+    // RFC 1952 and 1951 read back as plainly as they can be, CRC and length
+    // checked
+    fn gunzip(gzip: &[u8]) -> Vec<u8> {
+        const LENGTH_BASE: [usize; 29] = [
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99,
+            115, 131, 163, 195, 227, 258,
+        ];
+        const LENGTH_EXTRA: [u32; 29] = [
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+        ];
+        const DISTANCE_BASE: [usize; 30] = [
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025,
+            1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+        ];
+        const DISTANCE_EXTRA: [u32; 30] = [
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12,
+            12, 13, 13,
+        ];
+        const ORDER: [usize; 19] = [
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+        ];
+        assert_eq!(&gzip[..3], &[0x1f, 0x8b, 8]);
+        let flags = gzip[3];
+        let mut at = 10;
+        if flags & 4 != 0 {
+            at += 2 + (gzip[at] as usize | (gzip[at + 1] as usize) << 8);
+        }
+        for flag in &[8, 16] {
+            if flags & flag != 0 {
+                at += gzip[at..].iter().position(|&b| b == 0).unwrap() + 1;
+            }
+        }
+        if flags & 2 != 0 {
+            at += 2;
+        }
+        let mut input = Bits {
+            data: gzip,
+            pos: at * 8,
+        };
+        let mut out: Vec<u8> = Vec::new();
+        loop {
+            let last = input.bits(1);
+            let kind = input.bits(2);
+            let (lit, dist) = match kind {
+                0 => {
+                    let start = (input.pos + 7) / 8;
+                    let len = gzip[start] as usize | (gzip[start + 1] as usize) << 8;
+                    let nlen = gzip[start + 2] as usize | (gzip[start + 3] as usize) << 8;
+                    assert_eq!(len ^ 0xffff, nlen);
+                    out.extend_from_slice(&gzip[start + 4..start + 4 + len]);
+                    input.pos = (start + 4 + len) * 8;
+                    if last != 0 {
+                        break;
+                    }
+                    continue;
+                }
+                1 => {
+                    let mut lengths = vec![8; 288];
+                    lengths[144..256].iter_mut().for_each(|len| *len = 9);
+                    lengths[256..280].iter_mut().for_each(|len| *len = 7);
+                    (huffman(&lengths), huffman(&[5; 30]))
+                }
+                2 => {
+                    let nlit = input.bits(5) + 257;
+                    let ndist = input.bits(5) + 1;
+                    let ncode = input.bits(4) + 4;
+                    let mut lengths = vec![0; 19];
+                    for &sym in &ORDER[..ncode] {
+                        lengths[sym] = input.bits(3);
+                    }
+                    let code = huffman(&lengths);
+                    let mut lengths = Vec::new();
+                    while lengths.len() < nlit + ndist {
+                        let (len, repeat) = match input.decode(&code) {
+                            sym @ 0..=15 => (sym, 1),
+                            16 => (*lengths.last().unwrap(), 3 + input.bits(2)),
+                            17 => (0, 3 + input.bits(3)),
+                            _ => (0, 11 + input.bits(7)),
+                        };
+                        lengths.extend(std::iter::repeat(len).take(repeat));
+                    }
+                    assert_eq!(nlit + ndist, lengths.len());
+                    (huffman(&lengths[..nlit]), huffman(&lengths[nlit..]))
+                }
+                _ => panic!("reserved block type"),
+            };
+            loop {
+                let sym = input.decode(&lit);
+                if sym < 256 {
+                    out.push(sym as u8);
+                    continue;
+                }
+                if sym == 256 {
+                    break;
+                }
+                let len = LENGTH_BASE[sym - 257] + input.bits(LENGTH_EXTRA[sym - 257]);
+                let d = input.decode(&dist);
+                let distance = DISTANCE_BASE[d] + input.bits(DISTANCE_EXTRA[d]);
+                assert!(distance <= out.len() && distance <= 32768);
+                for _ in 0..len {
+                    out.push(out[out.len() - distance]);
+                }
+            }
+            if last != 0 {
+                break;
+            }
+        }
+        let trailer = (input.pos + 7) / 8;
+        assert_eq!(trailer + 8, gzip.len());
+        let word = |i: usize| u32::from_le_bytes([gzip[i], gzip[i + 1], gzip[i + 2], gzip[i + 3]]);
+        assert_eq!(crc32(&out), word(trailer));
+        assert_eq!(out.len() as u32, word(trailer + 4));
+        out
+    }
+
+    #[test]
+    fn gzip() {
+        assert_eq!(0xcbf4_3926, crc32(b"123456789"));
+        // a model large enough to span many blocks and the whole window,
+        // and one of long repeats - a documentation of one letter
+        let mut large = String::from("{UTF-8}\n");
+        for i in 0..3000 {
+            large += &format!(
+                "variable {} = variable {} * 1.01 + {} ~ widgets ~ the {}th of them |\n",
+                i + 1,
+                i,
+                i % 17,
+                i
+            );
+        }
+        large += "variable 0 = 1 ~ widgets ~ |\n\\\\\\---/// Sketch information\n";
+        let repeats = format!(
+            "{{UTF-8}}\nx = 1 ~ ~ {} |\ny = x ~ ~ {} |\n\\\\\\---/// Sketch information\n",
+            "a".repeat(100_000),
+            "xyz".repeat(20_000)
+        );
+        for mdl in &[MDL_SOURCE, &large, &repeats] {
+            for &compact in &[false, true] {
+                let xmile = crate::convert_vensim_mdl(mdl, compact).unwrap();
+                let gzip = crate::convert_vensim_mdl_gzip(mdl, compact, 0).unwrap();
+                assert!(gzip.len() < xmile.len());
+                assert_eq!(xmile.as_bytes(), &gunzip(&gzip)[..]);
+            }
+        }
+        assert!(crate::convert_vensim_mdl_gzip("{UTF-8}\nx = ", false, 0).is_err());
+    }
+
+    #[test]
+    fn limits() {
+        use std::sync::atomic::AtomicI32;
+        let expected = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let cancel = AtomicI32::new(0);
+        let generous = crate::Limits {
+            cancel: Some(&cancel),
+            time: Some(std::time::Duration::from_secs(60)),
+            memory: Some(1 << 30),
+        };
+        let actual = crate::convert_vensim_mdl_limited(MDL_SOURCE, true, 0, &generous);
+        assert_eq!(Ok(expected), actual);
+
+        cancel.store(1, std::sync::atomic::Ordering::Relaxed);
+        match crate::convert_vensim_mdl_limited(MDL_SOURCE, true, 0, &generous) {
+            Err(crate::ConvertError::Stopped(msg)) => assert!(msg.contains("cancelled")),
+            other => panic!("expected a cancelled conversion, got {:?}", other),
+        }
+        let tight = crate::Limits {
+            memory: Some(1),
+            ..Default::default()
+        };
+        assert!(matches!(
+            crate::convert_vensim_mdl_limited(MDL_SOURCE, true, 0, &tight),
+            Err(crate::ConvertError::Stopped(_))
+        ));
+    }
+
+    #[test]
+    fn check_units() {
+        let mdl = "Population = INTEG(births - deaths, 100) ~ Person ~ |
+births = Population * birth rate ~ Persons/Year ~ |
+birth rate = 0.02 ~ 1/Year ~ |
+deaths = Population / lifetime ~ Person/Year ~ |
+lifetime = 70 ~ Years ~ |
+life left = lifetime - Time ~ Year ~ |
+INITIAL TIME = 0 ~ Year ~ |
+FINAL TIME = 10 ~ Year ~ |
+TIME STEP = 1 ~ Year ~ |
+\\\\\\---/// Sketch information
+";
+        assert_eq!(
+            Vec::<crate::Diagnostic>::new(),
+            crate::check_vensim_mdl_units(mdl).unwrap()
+        );
+
+        let bad = mdl
+            .replace("Population / lifetime", "Population * lifetime")
+            .replace("lifetime - Time", "lifetime - Population");
+        let mut found: Vec<(String, String)> = crate::check_vensim_mdl_units(&bad)
+            .unwrap()
+            .into_iter()
+            .map(|d| (d.variable.unwrap(), d.message))
+            .collect();
+        found.sort();
+        assert_eq!(2, found.len());
+        assert_eq!("deaths", found[0].0);
+        assert!(found[0]
+            .1
+            .starts_with("the units are Person/Year but the equation gives"));
+        assert_eq!("life left", found[1].0);
+        assert!(found[1].1.starts_with("adding"));
+        // the conversion is the same either way
+        assert_eq!(
+            crate::convert_vensim_mdl_with_flags(&bad, true, 0),
+            crate::convert_vensim_mdl_with_flags(&bad, true, crate::CHECK_UNITS)
+        );
+    }
+
+    #[test]
+    fn check_loops() {
+        let mdl = "a = b + 1 ~ ~ |
+b = a * 0.5 ~ ~ |
+c = SMOOTHI(d, 1, 0) ~ ~ |
+d = c * 2 ~ ~ |
+stock = INTEG(a + stock * 0.1, 1) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 4 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        // a and b each need the other, c and d go through a smooth
+        let loops = crate::check_vensim_mdl_loops(mdl).unwrap();
+        assert_eq!(1, loops.len());
+        assert_eq!(Some("a".to_string()), loops[0].variable);
+        assert_eq!("simultaneous equations a, b", loops[0].message);
+        assert!(crate::simulate_vensim_mdl(mdl).is_none());
+        // three equations each reading the next, and one more loop through
+        // the first of them
+        let three = mdl.replace("a * 0.5", "e * 0.5").replace(
+            "INITIAL TIME = 0",
+            "e = a - 1 ~ ~ |\nf = a + f ~ ~ |\nINITIAL TIME = 0",
+        );
+        let mut found: Vec<String> = crate::check_vensim_mdl_loops(&three)
+            .unwrap()
+            .into_iter()
+            .map(|d| d.message)
+            .collect();
+        found.sort();
+        assert_eq!(
+            vec!["simultaneous equations a, b, e", "simultaneous equations f"],
+            found
+        );
+
+        let fixed = mdl.replace("a * 0.5", "stock * 0.5");
+        assert!(crate::check_vensim_mdl_loops(&fixed).unwrap().is_empty());
+        assert!(crate::simulate_vensim_mdl(&fixed).is_some());
+        // the conversion is the same either way
+        assert_eq!(
+            crate::convert_vensim_mdl_with_flags(mdl, true, 0),
+            crate::convert_vensim_mdl_with_flags(mdl, true, crate::CHECK_LOOPS)
+        );
+    }
+
+    #[test]
+    fn simulation() {
+        let results = crate::simulate_vensim_mdl(MDL_SOURCE).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let stock = rows[0].iter().position(|&n| n == "Stock").unwrap();
+        assert_eq!(12, rows.len());
+        let stocks: Vec<&str> = rows[1..].iter().map(|r| r[stock]).collect();
+        assert_eq!(vec!["0", "10", "3", "3"], stocks[..4].to_vec());
+        assert!(crate::simulate_vensim_mdl(":ohno:").is_none());
+    }
+
+    #[test]
+    fn array_simulation() {
+        let mdl = "r: a, b, c ~ ~ |
+init[r] = 1, 2, 3 ~ ~ |
+stock[r] = INTEG(flow[r], init[r]) ~ ~ |
+flow[r] = stock[r] * rate ~ ~ |
+rate = 0.5 ~ ~ |
+backwards[r] = stock[c] - stock[r] ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 2 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let results = crate::simulate_vensim_mdl(mdl).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let column = |name: &str| {
+            let col = rows[0].iter().position(|&n| n == name).unwrap();
+            rows[1..].iter().map(|r| r[col]).collect::<Vec<_>>()
+        };
+        assert_eq!(vec!["1", "1.5", "2.25"], column("stock[a]"));
+        assert_eq!(vec!["3", "4.5", "6.75"], column("stock[c]"));
+        assert_eq!(vec!["1", "1.5", "2.25"], column("backwards[b]"));
+    }
+
+    #[test]
+    fn integration_methods() {
+        // decay, exactly exp(-k t), of five stocks so the levels advance
+        // partly through the vector path and partly through its scalar tail
+        let ks = [0.1, 0.2, 0.3, 0.4, 0.5];
+        let mdl = |dt: f64, method: u32| {
+            format!(
+                "r: a, b, c, d, e ~ ~ |
+k[r] = 0.1, 0.2, 0.3, 0.4, 0.5 ~ ~ |
+stock[r] = INTEG(-stock[r] * k[r], 1) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 4 ~ ~ |
+TIME STEP = {} ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+V300  Do not put anything below this section - it will be ignored
+*View 1
+$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|72,72,100,0
+///---\\\\\\
+:L\u{7f}<%^E!@
+15:0,0,0,{},0,0
+",
+                dt, method
+            )
+        };
+        // the levels a scalar loop gives, in the order the engine adds
+        let scalar = |dt: f64, method: u32, k: f64, steps: usize| {
+            let rate = |level: f64| -level * k;
+            let mut level = 1.0f64;
+            let mut levels = vec![level];
+            for _ in 0..steps {
+                let k1 = rate(level);
+                level = match method {
+                    0 => level + dt * k1,
+                    3 => {
+                        let k2 = rate(level + dt * k1);
+                        level + dt / 2.0 * (k1 + k2)
+                    }
+                    _ => {
+                        let k2 = rate(level + dt / 2.0 * k1);
+                        let k3 = rate(level + dt / 2.0 * k2);
+                        let k4 = rate(level + dt * k3);
+                        level + dt / 6.0 * (k1 + 2.0 * k2 + 2.0 * k3 + k4)
+                    }
+                };
+                levels.push(level);
+            }
+            levels
+        };
+        // Euler, RK4 and RK2 with the order of their error
+        for &(method, order) in &[(0u32, 1), (1, 4), (3, 2)] {
+            let mut errors = vec![];
+            for &dt in &[0.25, 0.125] {
+                let results = crate::simulate_vensim_mdl(&mdl(dt, method)).unwrap();
+                let rows: Vec<Vec<&str>> =
+                    results.lines().map(|l| l.split('\t').collect()).collect();
+                let steps = (4.0 / dt) as usize;
+                assert_eq!(steps + 2, rows.len());
+                for (k, elm) in ks.iter().zip(&["a", "b", "c", "d", "e"]) {
+                    let col = rows[0]
+                        .iter()
+                        .position(|n| *n == format!("stock[{}]", elm))
+                        .unwrap();
+                    let levels: Vec<f64> =
+                        rows[1..].iter().map(|r| r[col].parse().unwrap()).collect();
+                    assert_eq!(scalar(dt, method, *k, steps), levels, "{} {}", method, elm);
+                    if *elm == "e" {
+                        errors.push((levels[steps] - (-k * 4.0f64).exp()).abs());
+                    }
+                }
+            }
+            // halving the step divides the error by about 2^order
+            let ratio = errors[0] / errors[1];
+            let expected = f64::from(1 << order);
+            assert!(
+                ratio > expected * 0.9 && ratio < expected * 1.1,
+                "{} {}",
+                method,
+                ratio
+            );
+        }
+    }
+
+    #[test]
+    fn array_builtins() {
+        let mdl = "r: a, b, c ~ ~ |
+x[r] = -4, 0, 9 ~ ~ |
+y[r] = ABS(x[r]) + MAX(x[r], 1) + ZIDZ(1, x[r]) + XIDZ(2, x[r], 7) + SQRT(ABS(x[r])) ~ ~ |
+z = ABS(-4) + MAX(-4, 1) + ZIDZ(1, -4) + XIDZ(2, -4, 7) + SQRT(ABS(-4)) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 1 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let results = crate::simulate_vensim_mdl(mdl).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let column = |name: &str| {
+            let col = rows[0].iter().position(|&n| n == name).unwrap();
+            rows[1][col]
+        };
+        assert_eq!(column("z"), column("y[a]"));
+        assert_eq!("8", column("y[b]"));
+        assert_eq!("21.333333333333332", column("y[c]"));
+    }
+
+    #[test]
+    fn powers() {
+        let mdl = "r: a, b ~ ~ |
+x[r] = -2, 3 ~ ~ |
+square[r] = x[r]^2 ~ ~ |
+cube = x[a]^3 ~ ~ |
+root = 9^0.5 ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 1 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let results = crate::simulate_vensim_mdl(mdl).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let column = |name: &str| {
+            let col = rows[0].iter().position(|&n| n == name).unwrap();
+            rows[1][col]
+        };
+        assert_eq!("4", column("square[a]"));
+        assert_eq!("9", column("square[b]"));
+        assert_eq!("-8", column("cube"));
+        assert_eq!("3", column("root"));
+    }
+
+    // mixes of arithmetic, comparisons and logic with nothing in
+    // parentheses, and what Vensim's precedence makes of them at time t
+    const PRECEDENCE_MDL: &str = "a = IF THEN ELSE(Time - 1 > 0, 1, 0) ~ ~ |
+b = IF THEN ELSE(Time > 1 + 1, 1, 0) ~ ~ |
+c = IF THEN ELSE(Time > 1 :AND: Time < 3, 1, 0) ~ ~ |
+d = IF THEN ELSE(Time < 1 :OR: Time > 2 :AND: Time < 3.5, 1, 0) ~ ~ |
+e = Time - 1 > 0 ~ ~ |
+f = IF THEN ELSE(:NOT: Time * 0 > 1, 1, 0) ~ ~ |
+g = -Time ^ 2 + 2 * Time - 1 ~ ~ |
+h = 2 * Time - Time / 2 * 3 ~ ~ |
+i = Time = 2 :OR: Time <> 3 :AND: Time >= 3 ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 4 ~ ~ |
+TIME STEP = 0.5 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+
+    // the same as rows of elements, put in front of PRECEDENCE_MDL
+    const PRECEDENCE_ROWS: &str = "r: r1, r2, r3 ~ ~ |
+off[r] = 0.5, 1.5, 2.5 ~ ~ |
+row[r] = IF THEN ELSE(Time - off[r] > 0 :AND: :NOT: Time > off[r] + 1, 1, 0) ~ ~ |
+neg[r] = -off[r] ^ 2 + Time * 2 - off[r] / 2 * 4 ~ ~ |
+";
+
+    // and as constants, and equations reading them, that are folded in
+    const PRECEDENCE_FOLDED: &str = "k = 3 ~ ~ |
+one = 1 + 1 > 0 :AND: 2 * 3 = 6 ~ ~ |
+two = k - 1 > 1 ~ ~ |
+three = IF THEN ELSE(k - 2 * 1 = 1 :AND: :NOT: k < 2, 10, 20) ~ ~ |
+four = -k ^ 2 + k * 2 ~ ~ |
+five = 1 - 2 > 0 :OR: 3 < 2 + 2 ~ ~ |
+mixed = Time * two - k + 1 > 0 :AND: one = 1 ~ ~ |
+";
+
+    fn precedence_expected(name: &str, t: f64) -> Option<f64> {
+        let truth = |b: bool| if b { 1.0 } else { 0.0 };
+        if let Some(open) = name.find("[r") {
+            let off = name[open + 2..name.len() - 1].parse::<f64>().ok()? - 0.5;
+            return Some(match &name[..open] {
+                "row" => truth(t - off > 0.0 && !(t > off + 1.0)),
+                "neg" => -(off * off) + t * 2.0 - off / 2.0 * 4.0,
+                _ => return None,
+            });
+        }
+        Some(match name {
+            "a" => truth(t - 1.0 > 0.0),
+            "b" => truth(t > 2.0),
+            "c" => truth(t > 1.0 && t < 3.0),
+            "d" => truth(t < 1.0 || (t > 2.0 && t < 3.5)),
+            "e" => truth(t - 1.0 > 0.0),
+            "f" => truth(!(t * 0.0 > 1.0)),
+            "g" => -(t * t) + 2.0 * t - 1.0,
+            "h" => 2.0 * t - t / 2.0 * 3.0,
+            "i" => truth(t == 2.0 || (t != 3.0 && t >= 3.0)),
+            "k" => 3.0,
+            "one" => 1.0,
+            "two" => 1.0,
+            "three" => 10.0,
+            "four" => -3.0,
+            "five" => 1.0,
+            "mixed" => truth(t - 2.0 > 0.0),
+            _ => return None,
+        })
+    }
+
+    // every column of simulate_vensim_mdl's results with an expected value
+    // has it at every row, and there are `checked` of them
+    fn check_precedence(results: &str, checked: usize) {
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let mut found = 0;
+        for (col, name) in rows[0].iter().enumerate() {
+            if precedence_expected(name, 0.0).is_none() {
+                continue;
+            }
+            found += 1;
+            for row in &rows[1..] {
+                let t: f64 = row[0].parse().unwrap();
+                let value: f64 = row[col].parse().unwrap();
+                assert_eq!(
+                    precedence_expected(name, t).unwrap(),
+                    value,
+                    "{} at {}",
+                    name,
+                    t
+                );
+            }
+        }
+        assert_eq!(checked, found);
+    }
+
+    #[test]
+    fn operator_precedence() {
+        let results = crate::simulate_vensim_mdl(PRECEDENCE_MDL).unwrap();
+        assert_eq!(10, results.lines().count());
+        check_precedence(&results, 9);
+    }
+
+    #[test]
+    fn row_precedence() {
+        let mdl = format!("{}{}", PRECEDENCE_ROWS, PRECEDENCE_MDL);
+        let results = crate::simulate_vensim_mdl(&mdl).unwrap();
+        check_precedence(&results, 15);
+    }
+
+    #[test]
+    fn folded_precedence() {
+        let mdl = format!("{}{}", PRECEDENCE_FOLDED, PRECEDENCE_MDL);
+        let results = crate::simulate_vensim_mdl(&mdl).unwrap();
+        check_precedence(&results, 16);
+    }
+
+    #[test]
+    fn lane_precedence() {
+        // enough runs to go in lanes, with a draw for a choice to depend on
+        let mdl = format!(
+            "noise = RANDOM UNIFORM(0, 1, 0) ~ ~ |
+coin = IF THEN ELSE(noise - 0.5 > 0 :AND: noise < 2, 1, 0) ~ ~ |
+{}{}{}",
+            PRECEDENCE_FOLDED, PRECEDENCE_ROWS, PRECEDENCE_MDL
+        );
+        let runs = crate::simulate_vensim_mdl_runs(&mdl, 8, 42, &[], 1).unwrap();
+        for results in &runs {
+            check_precedence(results, 22);
+            let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+            let noise = rows[0].iter().position(|&n| n == "noise").unwrap();
+            let coin = rows[0].iter().position(|&n| n == "coin").unwrap();
+            for row in &rows[1..] {
+                let drawn: f64 = row[noise].parse().unwrap();
+                assert_eq!(if drawn > 0.5 { "1" } else { "0" }, row[coin]);
+            }
+        }
+        assert_ne!(runs[0], runs[1]);
+        // and they are the runs that go one at a time
+        let few = crate::simulate_vensim_mdl_runs(&mdl, 3, 42, &[], 1).unwrap();
+        assert_eq!(few[..], runs[..3]);
+    }
+
+    #[test]
+    fn delays_and_smooths() {
+        let mdl = "r: a, b ~ ~ |
+input = STEP(8, 1) ~ ~ |
+smoothed = SMOOTH(input, 2) ~ ~ |
+fixed = DELAY FIXED(input, 2, 1) ~ ~ |
+cascade = DELAY N(input, 2, 0, 2) ~ ~ |
+base[r] = 2, 4 ~ ~ |
+late[r] = DELAY1(base[r] * input, 1) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 3 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let results = crate::simulate_vensim_mdl(mdl).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let column = |name: &str| {
+            let col = rows[0].iter().position(|&n| n == name).unwrap();
+            rows[1..].iter().map(|r| r[col]).collect::<Vec<_>>()
+        };
+        assert_eq!(vec!["0", "0", "4", "6"], column("smoothed"));
+        assert_eq!(vec!["1", "1", "0", "8"], column("fixed"));
+        assert_eq!(vec!["0", "0", "0", "8"], column("cascade"));
+        assert_eq!(vec!["0", "0", "32", "32"], column("late[b]"));
+    }
+
+    #[test]
+    fn macros() {
+        let control = "INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 4 ~ ~ |
+TIME STEP = 0.5 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let mdl = ":MACRO: SMOOTHED(input, delay)
+SMOOTHED = INTEG((input - SMOOTHED) / delay, input) ~ ~ |
+:END OF MACRO:
+:MACRO: SCALE(x, k)
+SCALE = x * k + bump ~ ~ |
+bump = Time * 0.1 ~ ~ |
+:END OF MACRO:
+a = 10 + STEP(5, 1) ~ ~ |
+b = SMOOTHED(a * 2, 4) ~ ~ |
+c = SMOOTHED(SCALE(a, 0.5), 2) + SMOOTHED(b, 4) ~ ~ |
+"
+        .to_string()
+            + control;
+        let expanded = "a = 10 + STEP(5, 1) ~ ~ |
+b = INTEG((a * 2 - b) / 4, a * 2) ~ ~ |
+scaled = a * 0.5 + Time * 0.1 ~ ~ |
+smoothed = INTEG((scaled - smoothed) / 2, scaled) ~ ~ |
+again = INTEG((b - again) / 4, b) ~ ~ |
+c = smoothed + again ~ ~ |
+"
+        .to_string()
+            + control;
+        // each use gets a stock of its own, with the same results as writing it out
+        let column = |results: &str, name: &str| {
+            let rows: Vec<Vec<String>> = results
+                .lines()
+                .map(|l| l.split('\t').map(String::from).collect())
+                .collect();
+            let col = rows[0].iter().position(|n| n == name).unwrap();
+            rows[1..].iter().map(|r| r[col].clone()).collect::<Vec<_>>()
+        };
+        let used = crate::simulate_vensim_mdl(&mdl).unwrap();
+        let written = crate::simulate_vensim_mdl(&expanded).unwrap();
+        for name in &["a", "b", "c"] {
+            assert_eq!(column(&written, name), column(&used, name));
+        }
+    }
+
+    #[test]
+    fn profile() {
+        let mdl = "stock = INTEG(inflow, 1) ~ ~ |
+inflow = stock * growth rate ~ ~ |
+growth rate = 0.1 ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let report = crate::profile_vensim_mdl(mdl).unwrap();
+        let rows: Vec<Vec<&str>> = report.lines().map(|l| l.split('\t').collect()).collect();
+        assert_eq!("Variable", rows[0][0]);
+        let counts = |name: &str| {
+            let row = rows.iter().find(|r| r[0] == name).unwrap();
+            (row[6], row[7], row[8])
+        };
+        // the auxiliaries are computed at each of the 11 times, the flows
+        // into stocks at the 10 steps between
+        assert_eq!(("1", "0", "10"), counts("stock"));
+        assert_eq!(("0", "11", "0"), counts("inflow"));
+        assert!(crate::profile_vensim_mdl("{UTF-8}\nx = ").is_none());
+
+        // the hidden helpers of time functions and the variables of macro
+        // uses have no names of their own, so go by what they are computed for
+        let mdl = ":MACRO: SMOOTHED(input, delay)
+SMOOTHED = INTEG((input - SMOOTHED) / delay, input) ~ ~ |
+:END OF MACRO:
+input = 10 + STEP(5, 2) ~ ~ |
+delayed = DELAY1(input, 2) ~ ~ |
+pipeline = DELAY3(input, 3) ~ ~ |
+initialized = DELAY3I(input, 3, 5) ~ ~ |
+smoothed input = SMOOTH(input, 2) ~ ~ |
+fixed = DELAY FIXED(input, 1, 0) ~ ~ |
+macro use = SMOOTHED(input * 2, 4) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let report = crate::profile_vensim_mdl(mdl).unwrap();
+        let names: Vec<&str> = report
+            .lines()
+            .skip(1)
+            .map(|l| l.split('\t').next().unwrap())
+            .collect();
+        assert!(names.iter().all(|n| !n.is_empty()), "{}", report);
+        for name in &[
+            "input (STEP)",
+            "macro use (SMOOTHED)",
+            "macro use (SMOOTHED argument 1)",
+            "macro use (SMOOTHED argument 2)",
+        ] {
+            assert!(names.contains(name), "{} in {}", name, report);
+        }
+    }
+
+    #[test]
+    fn checkpointed_rerun() {
+        let model = |height: &str, rate: &str, method: &str| {
+            format!(
+                "stock = INTEG(inflow, 10) ~ ~ |
+inflow = stock * growth rate + STEP(step height, 6) + noise ~ ~ |
+noise = RANDOM UNIFORM(0, 1, 0) ~ ~ |
+smoothed = SMOOTH(stock, 2) ~ ~ |
+step height = {} ~ ~ |
+growth rate = {} ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 0.25 ~ ~ |
+SAVEPER = 0.5 ~ ~ |
+\\\\\\---/// Sketch information
+V300  Do not put anything below this section - it will be ignored
+*View 1
+$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|72,72,100,0
+///---\\\\\\
+:L\u{7f}<%^E!@
+15:0,0,0,{},0,0
+",
+                height, rate, method
+            )
+        };
+        // Euler, RK4 and RK2
+        for method in &["0", "1", "3"] {
+            let base = model("1", "0.05", method);
+            let mut sim = crate::CheckpointedSimulation::new(&base, 1.0).unwrap();
+            // the height only matters once the step is due at 6, so the
+            // rerun goes from the checkpoint at 5 - the rows at 0 to 4.5
+            // are the first run's
+            let (results, reused) = sim.rerun(&[("step height", 3.0)]).unwrap();
+            assert_eq!(
+                crate::simulate_vensim_mdl(&model("3", "0.05", method)).unwrap(),
+                results
+            );
+            assert_eq!(10, reused);
+            // the growth rate is read from the start
+            let (results, reused) = sim.rerun(&[("growth rate", 0.1)]).unwrap();
+            assert_eq!(
+                crate::simulate_vensim_mdl(&model("1", "0.1", method)).unwrap(),
+                results
+            );
+            assert_eq!(0, reused);
+            // with nothing different only the last checkpoint's steps run
+            let (results, reused) = sim.rerun(&[("step height", 1.0)]).unwrap();
+            assert_eq!(crate::simulate_vensim_mdl(&base).unwrap(), results);
+            assert_eq!(18, reused);
+            assert!(sim.rerun(&[("inflow", 1.0)]).is_none());
+            assert!(sim.rerun(&[("nothing", 1.0)]).is_none());
+        }
+        assert!(crate::CheckpointedSimulation::new("{UTF-8}\nx = ", 1.0).is_none());
+    }
+
+    #[test]
+    fn generate_c() {
+        let mdl = "stock = INTEG(inflow, 1) ~ ~ |
+inflow = stock * growth rate * effect(stock / 4) ~ ~ |
+effect((0,1),(1,0.5),(2,0)) ~ ~ |
+growth rate = 0.1 ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 0.5 ~ ~ |
+SAVEPER = 1 ~ ~ |
+\\\\\\---/// Sketch information
+";
+        assert!(crate::generate_vensim_mdl_c("{UTF-8}\nx = ").is_none());
+        let arrayed = "region : north, south, east ~ ~ |
+population[region] = INTEG(births[region] - deaths[region], start population[region]) ~ ~ |
+start population[region] = 10, 20, 30 ~ ~ |
+births[region] = population[region] * birth rate[region] + STEP(5, 3) + ramped[region] ~ ~ |
+birth rate[region] = 0.05, 0.04, 0.03 ~ ~ |
+slope[region] = 1, 2, 3 ~ ~ |
+ramped[region] = RAMP(slope[region], 2, 8) ~ ~ |
+deaths[region] = population[region] * 0.02 + PULSE(4, 2) * start population[region] ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 0.25 ~ ~ |
+SAVEPER = 1 ~ ~ |
+\\\\\\---/// Sketch information
+";
+        // the time functions feeding each kind of delay, under each method
+        let delays = |method: u32| {
+            format!(
+                "input = 10 + STEP(5, 2) + RAMP(1, 3, 6) + PULSE(5, 1) ~ ~ |
+delayed = DELAY1(input, 2) ~ ~ |
+pipeline = DELAY3(input, 3) ~ ~ |
+smoothed input = SMOOTH(input, 2) ~ ~ |
+fixed = DELAY FIXED(input, 1, 0) ~ ~ |
+stock = INTEG(delayed + pipeline - stock / 4, 0) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 0.25 ~ ~ |
+SAVEPER = 0.5 ~ ~ |
+\\\\\\---/// Sketch information
+V300  Do not put anything below this section - it will be ignored
+*View 1
+$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|72,72,100,0
+///---\\\\\\
+:L\u{7f}<%^E!@
+15:0,0,0,{},0,0
+",
+                method
+            )
+        };
+        let random = "noise = RANDOM UNIFORM(0, 1, 0) ~ ~ |
+shock = RANDOM NORMAL(-2, 2, 0, 1, 0) ~ ~ |
+stock = INTEG(noise + shock, 0) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 10 ~ ~ |
+TIME STEP = 0.5 ~ ~ |
+SAVEPER = 0.5 ~ ~ |
+\\\\\\---/// Sketch information
+";
+        // run with the parameters named on the command line set, printing
+        // the results as simulate_vensim_mdl would have them
+        let driver = r#"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+size_t xm_workspace_size(void);
+void xm_init(void *);
+int xm_parameter_find(const char *);
+void xm_set_parameter(void *, int, double);
+void xm_run(void *, uint64_t, uint64_t);
+int xm_column_count(void);
+const char *xm_column_name(int);
+int xm_row_count(void);
+const double *xm_results(const void *);
+int main(int argc, char **argv) {
+  void *w = malloc(xm_workspace_size());
+  xm_init(w);
+  for (int i = 1; i + 1 < argc; i += 2)
+    xm_set_parameter(w, xm_parameter_find(argv[i]), atof(argv[i + 1]));
+  xm_run(w, 0, 0);
+  for (int i = 0; i < xm_column_count(); i++)
+    printf("%s%c", xm_column_name(i), i + 1 < xm_column_count() ? '\t' : '\n');
+  for (int i = 0; i < xm_row_count() * xm_column_count(); i++)
+    printf("%.17g%c", xm_results(w)[i], (i + 1) % xm_column_count() ? '\t' : '\n');
+  return 0;
+}
+"#;
+        let dir = std::env::temp_dir().join(format!("xmutil-c-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        std::fs::write(dir.join("main.c"), driver).unwrap();
+        let parse = |s: &str| -> Vec<Vec<String>> {
+            s.lines()
+                .map(|l| {
+                    l.split('\t')
+                        .map(|v| v.parse::<f64>().map_or(v.to_string(), |f| f.to_string()))
+                        .collect()
+                })
+                .collect()
+        };
+        // each model gets a module - false if there is no C compiler to
+        // build it with, and so nothing to compare against
+        let check = |name: &str, mdl: &str, runs: &[(&[&str], String)]| {
+            let source = crate::generate_vensim_mdl_c(mdl).unwrap();
+            let c = format!("{}.c", name);
+            std::fs::write(dir.join(&c), &source).unwrap();
+            let exe = dir.join(name);
+            let built = std::process::Command::new("cc")
+                .current_dir(&dir)
+                .args(&["-std=c99", "-O2", "-Wall", "-Wextra", "-Werror"])
+                .args(&["-ffp-contract=off", &c, "main.c", "-o"])
+                .arg(&exe)
+                .arg("-lm")
+                .status();
+            let status = match built {
+                Ok(status) => status,
+                Err(_) => return false,
+            };
+            assert!(status.success(), "{}", name);
+            for (args, mdl) in runs {
+                let out = std::process::Command::new(&exe)
+                    .args(args.iter())
+                    .output()
+                    .unwrap();
+                let generated = String::from_utf8(out.stdout).unwrap();
+                let native = crate::simulate_vensim_mdl(mdl).unwrap();
+                assert_eq!(parse(&native), parse(&generated), "{} {:?}", name, args);
+            }
+            true
+        };
+        if check(
+            "growth",
+            mdl,
+            &[
+                (&[], mdl.to_string()),
+                (
+                    &["growth rate", "0.2"],
+                    mdl.replace("growth rate = 0.1", "growth rate = 0.2"),
+                ),
+            ],
+        ) {
+            check("arrayed", arrayed, &[(&[], arrayed.to_string())]);
+            // Euler, RK4 and RK2
+            for method in &[0, 1, 3] {
+                let mdl = delays(*method);
+                check(&format!("delays{}", method), &mdl, &[(&[], mdl.clone())]);
+            }
+            check("random", random, &[(&[], random.to_string())]);
+            // with k a parameter nothing that reads it is folded, so the
+            // module computes what the simulator folded in
+            let precedence = format!("{}{}{}", PRECEDENCE_FOLDED, PRECEDENCE_ROWS, PRECEDENCE_MDL);
+            check(
+                "precedence",
+                &precedence,
+                &[
+                    (&[], precedence.clone()),
+                    (&["k", "1"], precedence.replace("k = 3", "k = 1")),
+                ],
+            );
+        }
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn columnar_simulation() {
+        let results = crate::simulate_vensim_mdl(MDL_SOURCE).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let mut names = Vec::new();
+        let mut columns: Vec<Vec<f64>> = Vec::new();
+        let mut chunks = 0;
+        assert!(crate::simulate_vensim_mdl_columns(
+            MDL_SOURCE,
+            &[],
+            3,
+            |n, cols| {
+                assert!(cols.iter().all(|c| c.len() <= 3));
+                names = n.to_vec();
+                columns.resize(cols.len(), Vec::new());
+                for (all, chunk) in columns.iter_mut().zip(cols) {
+                    all.extend_from_slice(chunk);
+                }
+                chunks += 1;
+            }
+        ));
+        assert_eq!(rows[0], names);
+        assert_eq!(rows.len() - 1, columns[0].len());
+        assert_eq!((rows.len() - 1 + 2) / 3, chunks);
+        for (i, row) in rows[1..].iter().enumerate() {
+            for (col, value) in row.iter().enumerate() {
+                assert_eq!(value.parse::<f64>().unwrap(), columns[col][i]);
+            }
+        }
+        // just the variables asked for, all in one chunk
+        let mut kept = Vec::new();
+        assert!(crate::simulate_vensim_mdl_columns(
+            MDL_SOURCE,
+            &[&rows[0][1]],
+            0,
+            |n, cols| {
+                kept = n.to_vec();
+                assert_eq!(rows.len() - 1, cols[1].len());
+            }
+        ));
+        assert_eq!(vec!["Time", rows[0][1]], kept);
+        assert!(!crate::simulate_vensim_mdl_columns(
+            MDL_SOURCE,
+            &["missing"],
+            0,
+            |_, _| {}
+        ));
+    }
+
+    #[test]
+    fn external_data() {
+        assert!(crate::add_data(
+            "lib-test.csv",
+            "time,value\n0,10\n2,20\n4,40\n"
+        ));
+        let mdl = "value := GET DIRECT DATA('lib-test.csv', 'x', 'A', 'B2') ~ ~ |
+ahead = GET DATA AT TIME(value, Time + 1) ~ ~ |
+last = GET DATA LAST TIME(value) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 5 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let results = crate::simulate_vensim_mdl(mdl).unwrap();
+        let rows: Vec<Vec<&str>> = results.lines().map(|l| l.split('\t').collect()).collect();
+        let column = |name: &str| {
+            let col = rows[0].iter().position(|&n| n == name).unwrap();
+            rows[1..].iter().map(|r| r[col]).collect::<Vec<_>>()
+        };
+        assert_eq!(vec!["10", "15", "20", "30", "40", "40"], column("value"));
+        assert_eq!(vec!["15", "20", "30", "40", "40", "40"], column("ahead"));
+        assert_eq!(vec!["4"; 6], column("last"));
+
+        // the same from a cache of it
+        let dir = std::env::temp_dir().join(format!("xmutil-data-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let cache = dir.join("data.cache");
+        assert!(crate::write_data_cache("lib-test.csv", &cache));
+        assert!(crate::load_data_file("lib-test-cached.csv", &cache));
+        let cached = mdl.replace("lib-test.csv", "lib-test-cached.csv");
+        assert_eq!(Some(results), crate::simulate_vensim_mdl(&cached));
+        assert!(!crate::load_data_file(
+            "missing.csv",
+            dir.join("missing.csv")
+        ));
+        assert!(crate::simulate_vensim_mdl(&mdl.replace("lib-test.csv", "missing.csv")).is_none());
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn data_added_again_while_running() {
+        // the series runs were compiled against stay theirs however often
+        // the file is added again in the middle of them
+        let text = "time,value\n0,10\n2,20\n4,40\n";
+        assert!(crate::add_data("lib-test-again.csv", text));
+        let mdl = "value := GET DIRECT DATA('lib-test-again.csv', 'x', 'A', 'B2') ~ ~ |
+ahead = GET DATA AT TIME(value, Time + noise) ~ ~ |
+noise = RANDOM UNIFORM(0, 1, 0) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 200 ~ ~ |
+TIME STEP = 0.25 ~ ~ |
+SAVEPER = 1 ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let expected = crate::simulate_vensim_mdl_runs(mdl, 16, 42, &[], 1).unwrap();
+        let done = std::sync::Arc::new(std::sync::atomic::AtomicBool::new(false));
+        let adding = {
+            let done = done.clone();
+            std::thread::spawn(move || {
+                while !done.load(std::sync::atomic::Ordering::Relaxed) {
+                    assert!(crate::add_data("lib-test-again.csv", text));
+                }
+            })
+        };
+        for _ in 0..20 {
+            assert_eq!(
+                Some(&expected),
+                crate::simulate_vensim_mdl_runs(mdl, 16, 42, &[], 4).as_ref()
+            );
+        }
+        done.store(true, std::sync::atomic::Ordering::Relaxed);
+        adding.join().unwrap();
+    }
+
+    #[test]
+    fn monte_carlo_runs() {
+        let mdl = "noise = RANDOM UNIFORM(0, 10, 0) ~ ~ |
+draw = RANDOM NORMAL(-100, 100, 5, 1, 0) ~ ~ |
+stock = INTEG(noise, 0) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 5 ~ ~ |
+TIME STEP = 1 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let one = crate::simulate_vensim_mdl_runs(mdl, 8, 42, &["stock"], 1).unwrap();
+        let many = crate::simulate_vensim_mdl_runs(mdl, 8, 42, &["stock"], 3).unwrap();
+        assert_eq!(one, many);
+        assert!(one.iter().all(|r| r.starts_with("Time\tstock\n")));
+        assert_ne!(one[0], one[1]);
+        let other = crate::simulate_vensim_mdl_runs(mdl, 8, 43, &["stock"], 3).unwrap();
+        assert_ne!(one, other);
+        // too few to go in lanes, they come out as the runs that did
+        let few = crate::simulate_vensim_mdl_runs(mdl, 3, 42, &["stock"], 1).unwrap();
+        assert_eq!(few[..], one[..3]);
+        // the noise is fresh every step, and within the range
+        let rows: Vec<Vec<f64>> = crate::simulate_vensim_mdl_runs(mdl, 1, 7, &["noise"], 1)
+            .unwrap()[0]
+            .lines()
+            .skip(1)
+            .map(|l| l.split('\t').map(|v| v.parse().unwrap()).collect())
+            .collect();
+        assert_eq!(6, rows.len());
+        assert!(rows.iter().all(|r| r[1] >= 0.0 && r[1] < 10.0));
+        assert_ne!(rows[0][1], rows[1][1]);
+        assert!(crate::simulate_vensim_mdl_runs(mdl, 2, 42, &["missing"], 1).is_none());
+    }
+
+    #[test]
+    fn parameter_sweep() {
+        // each run is the model with the parameters changed in its MDL,
+        // whether it goes in lanes or on its own, on any number of threads
+        let mdl = "r: a, b ~ ~ |
+noise = RANDOM UNIFORM(0, 1, 0) ~ ~ |
+rate = 0.1 ~ ~ |
+scale[r] = 2, 3 ~ ~ |
+twice = rate * 2 ~ ~ |
+stock[r] = INTEG(stock[r] * twice * scale[r] + noise, 1) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 8 ~ ~ |
+TIME STEP = 0.5 ~ ~ |
+SAVEPER = 1 ~ ~ |
+\\\\\\---/// Sketch information
+";
+        let values: Vec<Vec<f64>> = (0..11)
+            .map(|i| vec![0.05 * i as f64, 1.0 + i as f64 / 3.0])
+            .collect();
+        let edited = |run: &[f64]| {
+            mdl.replace("rate = 0.1", &format!("rate = {:e}", run[0]))
+                .replace("scale[r] = 2, 3", &format!("scale[r] = 2, {:e}", run[1]))
+        };
+        for variables in [&[][..], &["stock"][..]] {
+            let swept = crate::simulate_vensim_mdl_sweep(
+                mdl,
+                42,
+                &["rate", "scale[b]"],
+                &values,
+                variables,
+                1,
+            )
+            .unwrap();
+            for (i, run) in values.iter().enumerate() {
+                let alone =
+                    crate::simulate_vensim_mdl_runs(&edited(run), i as u32 + 1, 42, variables, 1)
+                        .unwrap();
+                assert_eq!(alone[i], swept[i], "run {}", i);
+            }
+            assert_eq!(
+                Some(&swept),
+                crate::simulate_vensim_mdl_sweep(
+                    mdl,
+                    42,
+                    &["rate", "scale[b]"],
+                    &values,
+                    variables,
+                    3
+                )
+                .as_ref()
+            );
+        }
+        // what isn't a number, the controls and whole arrays can't be set
+        for name in ["twice", "stock[a]", "TIME STEP", "scale", "missing"] {
+            assert!(
+                crate::simulate_vensim_mdl_sweep(mdl, 42, &[name], &vec![vec![1.0]; 4], &[], 1)
+                    .is_none(),
+                "{}",
+                name
+            );
+        }
+        assert!(crate::simulate_vensim_mdl_sweep(mdl, 42, &["rate"], &[vec![]], &[], 1).is_none());
+    }
+
+    #[test]
+    fn requested_outputs() {
+        let mdl = "r: a, b ~ ~ |
+noise = RANDOM UNIFORM(0, 10, 0) ~ ~ |
+input = STEP(8, 1) + noise ~ ~ |
+late[r] = DELAY1(input * 2, 1) ~ ~ |
+stock = INTEG(inflow, 1) ~ ~ |
+inflow = SMOOTH(input, 2) ~ ~ |
+unused = SMOOTH3(stock, 3) ~ ~ |
+INITIAL TIME = 0 ~ ~ |
+FINAL TIME = 4 ~ ~ |
+TIME STEP = 0.5 ~ ~ |
+SAVEPER = TIME STEP ~ ~ |
+\\\\\\---/// Sketch information
+";
+        // only what each needs is computed, and the numbers are as in a full run
+        let all = crate::simulate_vensim_mdl_runs(mdl, 1, 3, &[], 1).unwrap();
+        let rows: Vec<Vec<&str>> = all[0].lines().map(|l| l.split('\t').collect()).collect();
+        for name in ["stock", "late[b]", "inflow", "noise"] {
+            let col = rows[0].iter().position(|&n| n == name).unwrap();
+            let expected: String = rows
+                .iter()
+                .map(|r| format!("{}\t{}\n", r[0], r[col]))
+                .collect();
+            let one = crate::simulate_vensim_mdl_runs(mdl, 1, 3, &[name], 1).unwrap();
+            assert_eq!(expected, one[0]);
+        }
+    }
+
+    #[test]
+    fn failure_is_none() {
+        assert!(crate::convert_vensim_mdl(":ohno:", true).is_none())
+    }
+
+    #[test]
+    fn checked_failure() {
+        assert!(matches!(
+            crate::convert_vensim_mdl_checked(":ohno:", true, 0),
+            Err(crate::ConvertError::Parse(_))
+        ));
+        assert_eq!(
+            crate::convert_vensim_mdl(MDL_SOURCE, true),
+            crate::convert_vensim_mdl_checked(MDL_SOURCE, true, 0).ok()
+        );
+    }
+
+    #[test]
+    fn parse_diagnostics() {
+        let mdl = "a = 1 ~ ~ |\nb = (a + ~ ~ |\nc = a * 2 ~ ~ |\nd = ) ~ ~ |\n\\\\\\---///\n";
+        match crate::convert_vensim_mdl_checked(mdl, true, 0) {
+            Err(crate::ConvertError::Parse(diags)) => {
+                assert_eq!(2, diags.len());
+                assert_eq!(2, diags[0].line);
+                assert_eq!(Some("b".to_owned()), diags[0].variable);
+                assert_eq!(4, diags[1].line);
+                assert_eq!(Some("d".to_owned()), diags[1].variable);
+            }
+            other => panic!("expected parse diagnostics, got {:?}", other),
+        }
+    }
+
+    #[test]
+    fn malformed_equations() {
+        // each bad equation is reported where it is and reading picks up at
+        // the next one - so the ones after are still parsed, and reported
+        // too if they're bad
+        let mdl = "a = 1 ~ ~ |
+t = TABBED ARRAY(1 2 x 4) ~ ~ |
+b = (a + ~ ~ |
+c = a * 2 ~ ~ |
+d = ) ~ ~ |
+e = c + ~ ~ |
+\\\\\\---///
+";
+        match crate::convert_vensim_mdl_checked(mdl, true, 0) {
+            Err(crate::ConvertError::Parse(diags)) => {
+                let found: Vec<(u32, &str, Option<&str>)> = diags
+                    .iter()
+                    .map(|d| (d.line, d.message.as_str(), d.variable.as_deref()))
+                    .collect();
+                assert_eq!(
+                    vec![
+                        (2, "Bad numbers", Some("t")),
+                        (3, "syntax error", Some("b")),
+                        (5, "syntax error", Some("d")),
+                        (6, "syntax error", Some("e")),
+                    ],
+                    found
+                );
+            }
+            other => panic!("expected parse diagnostics, got {:?}", other),
+        }
+    }
+
+    #[test]
+    fn placement() {
+        // what the sketch leaves out goes right of its inputs, each where
+        // nothing else is - e reaches into the cell just past b
+        let mut mdl = String::from("a = 1 ~ ~ |\nb = 2 ~ ~ |\ne = 3 ~ ~ |\n");
+        for i in 0..6 {
+            let _ = write!(mdl, "d{} = a + b + e ~ ~ |\n", i);
+        }
+        mdl.push_str(
+            "\\\\\\---/// Sketch information - do not modify anything except names
+V300  Do not put anything below this section - it will be ignored
+*View 1
+$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|96,96,100,0
+10,1,a,100,100,40,20,3,3,0,0,0,0,0,0
+10,2,b,300,200,40,20,3,3,0,0,0,0,0,0
+10,3,e,395,140,30,10,3,3,0,0,0,0,0,0
+///---\\\\\\
+",
+        );
+        let xmile = crate::convert_vensim_mdl(&mdl, true).unwrap();
+        let at = |name: &str| {
+            let tag = format!("<aux name=\"{}\" x=\"", name);
+            let rest = &xmile[xmile.find(&tag).unwrap() + tag.len()..];
+            let x: i32 = rest[..rest.find('"').unwrap()].parse().unwrap();
+            let rest = &rest[rest.find("y=\"").unwrap() + 3..];
+            let y: i32 = rest[..rest.find('"').unwrap()].parse().unwrap();
+            (x, y)
+        };
+        let drawn = [(at("a"), 40, 20), (at("b"), 40, 20), (at("e"), 30, 10)];
+        let placed: Vec<(i32, i32)> = (0..6).map(|i| at(&format!("d{}", i))).collect();
+        for (i, &(x, y)) in placed.iter().enumerate() {
+            assert!(x > drawn[1].0 .0 + 40, "d{} at {},{}", i, x, y);
+            for &((dx, dy), w, h) in &drawn {
+                assert!(
+                    (x - dx).abs() > w || (y - dy).abs() > h,
+                    "d{} at {},{}",
+                    i,
+                    x,
+                    y
+                );
+            }
+            for &(ox, oy) in &placed[..i] {
+                assert!(
+                    (x - ox).abs() >= 80 || (y - oy).abs() >= 40,
+                    "d{} at {},{}",
+                    i,
+                    x,
+                    y
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn bad_sketch() {
+        // sketch lines that make no sense are dropped rather than followed,
+        // with the equations and the rest of the view converted as usual
+        let sketch = |lines: &str| {
+            format!(
+                "a = 1 ~ ~ |
+c = a * 2 ~ ~ |
+\\\\\\---/// Sketch information - do not modify anything except names
+V300  Do not put anything below this section - it will be ignored
+*View 1
+$192-192-192,0,Times New Roman|12||0-0-0|0-0-0|0-0-255|-1--1--1|-1--1--1|96,96,100,0
+10,1,a,100,100,40,20,3,3,0,0,0,0,0,0
+{}
+///---\\\\\\
+",
+                lines
+            )
+        };
+        for lines in &[
+            "1,3,1,99,0,0,0,0,0,0,0,-1--1--1,,1|(150,100)|", // to an element that isn't there
+            "1,3,-4,1,0,0,0,0,0,0,0,-1--1--1,,1|(150,100)|", // from one before the first
+            "10,9999999999,c,200,100,40,20,3,3,0,0,0,0,0,0", // a UID no view has
+            "99,2,c,200,100",                                // an element type we don't know
+            "10,2,c,200,,x,y\n11,-5,c\n12,zz",               // fields missing or garbled
+        ] {
+            let mdl = sketch(lines);
+            match crate::convert_vensim_mdl_checked(&mdl, true, 0) {
+                Ok(xmile) => {
+                    assert!(
+                        xmile.contains("<aux name=\"a\"><eqn>1</eqn></aux>"),
+                        "{}",
+                        lines
+                    );
+                    assert!(
+                        xmile.contains("<aux name=\"c\"><eqn>a*2</eqn></aux>"),
+                        "{}",
+                        lines
+                    );
+                    assert!(xmile.contains("<view><aux name=\"a\""), "{}", lines);
+                    // the missing arrow from a to c is put back
+                    assert!(xmile.contains("<from>a</from><to>c</to>"), "{}", lines);
+                }
+                other => panic!("{}: expected the XMILE, got {:?}", lines, other),
+            }
+        }
+        // a bad equation is still reported however bad the sketch is
+        let mdl = sketch("1,3,1,99").replace("c = a * 2", "c = a *");
+        match crate::convert_vensim_mdl_checked(&mdl, true, 0) {
+            Err(crate::ConvertError::Parse(diags)) => {
+                assert_eq!(1, diags.len());
+                assert_eq!(2, diags[0].line);
+                assert_eq!(Some("c".to_owned()), diags[0].variable);
+            }
+            other => panic!("expected parse diagnostics, got {:?}", other),
+        }
+    }
+
+    #[test]
+    fn file_conversion() {
+        let dir = std::env::temp_dir().join(format!("xmutil-file-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("model.mdl");
+        std::fs::write(&path, MDL_SOURCE).unwrap();
+        assert_eq!(
+            crate::convert_vensim_mdl_checked(MDL_SOURCE, true, 0),
+            crate::convert_vensim_mdl_file(&path, true, 0)
+        );
+        let empty = dir.join("empty.mdl");
+        std::fs::write(&empty, "").unwrap();
+        assert_eq!(
+            crate::convert_vensim_mdl_checked("", true, 0),
+            crate::convert_vensim_mdl_file(&empty, true, 0)
+        );
+        assert!(matches!(
+            crate::convert_vensim_mdl_file(dir.join("missing.mdl"), true, 0),
+            Err(crate::ConvertError::Read(_))
+        ));
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn reader_conversion() {
+        // a few bytes at a time so tokens are split across reads
+        struct Trickle<'a>(&'a [u8]);
+        impl std::io::Read for Trickle<'_> {
+            fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+                let n = buf.len().min(self.0.len()).min(3);
+                buf[..n].copy_from_slice(&self.0[..n]);
+                self.0 = &self.0[n..];
+                Ok(n)
+            }
+        }
+        assert_eq!(
+            crate::convert_vensim_mdl_checked(MDL_SOURCE, true, 0),
+            crate::convert_vensim_mdl_reader(Trickle(MDL_SOURCE.as_bytes()), true, 0)
+        );
+        struct Broken;
+        impl std::io::Read for Broken {
+            fn read(&mut self, _: &mut [u8]) -> std::io::Result<usize> {
+                Err(std::io::Error::new(std::io::ErrorKind::Other, "gone"))
+            }
+        }
+        assert!(matches!(
+            crate::convert_vensim_mdl_reader(Broken, true, 0),
+            Err(crate::ConvertError::Read(_))
+        ));
+    }
+
+    #[test]
+    fn reader_conversion_large() {
+        // several windows' worth (LEX_READ_SIZE is 64K), so what has been
+        // read is dropped from the front as it goes, in reads that don't
+        // line up with it
+        struct Steps<'a>(&'a [u8], usize);
+        impl std::io::Read for Steps<'_> {
+            fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+                let n = buf.len().min(self.0.len()).min(self.1);
+                buf[..n].copy_from_slice(&self.0[..n]);
+                self.0 = &self.0[n..];
+                Ok(n)
+            }
+        }
+        let mut mdl = String::from("{UTF-8}\n");
+        for i in 0..3000 {
+            let _ = write!(
+                mdl,
+                "\"quoted {i}\" = v{}\n\t* 1.5 + 2e-3 ~ Widget/Month ~ A comment long enough to \\\n\tgo over a line, for {i} |\n",
+                (i + 1) % 3000
+            );
+            let _ = write!(mdl, "v{i} = \"quoted {}\" / 2 ~ ~ |\n", (i + 7) % 3000);
+        }
+        mdl.push_str(&MDL_SOURCE[MDL_SOURCE.find("********").unwrap()..]);
+        assert!(mdl.len() > 4 * 65536);
+        let expected = crate::convert_vensim_mdl_checked(&mdl, true, 0);
+        assert!(expected.is_ok());
+        for step in [1, 3, 4093, 65537, 1_000_000] {
+            assert_eq!(
+                expected,
+                crate::convert_vensim_mdl_reader(Steps(mdl.as_bytes(), step), true, 0),
+                "{}",
+                step
+            );
+        }
+    }
+
+    #[test]
+    fn concurrent_conversions() {
+        let expected = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let threads: Vec<_> = (0..8)
+            .map(|_| {
+                std::thread::spawn(move || {
+                    (0..16)
+                        .map(|_| crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap())
+                        .collect::<Vec<_>>()
+                })
+            })
+            .collect();
+        for thread in threads {
+            for actual in thread.join().unwrap() {
+                assert_eq!(expected, actual);
+            }
+        }
+    }
+
+    #[test]
+    fn batch_conversion() {
+        let expected = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let mut sources = vec![MDL_SOURCE; 32];
+        sources[5] = ":ohno:";
+
+        let results = crate::convert_vensim_mdl_batch(&sources, true, 4);
+        assert_eq!(sources.len(), results.len());
+        for (i, result) in results.iter().enumerate() {
+            if i == 5 {
+                assert!(result.is_none());
+            } else {
+                assert_eq!(Some(&expected), result.as_ref());
+            }
+        }
+
+        assert!(crate::convert_vensim_mdl_batch(&[], true, 0).is_empty());
+    }
+
+    #[test]
+    fn conversion_cache() {
+        let expected = crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap();
+        let cache = crate::ConversionCache::new(crate::MemoryCache::new(expected.len() * 2));
+        assert_eq!(Some(&expected), cache.convert(MDL_SOURCE, true).as_ref());
+        assert_eq!(Some(&expected), cache.convert(MDL_SOURCE, true).as_ref());
+        assert_eq!(1, cache.backend().len());
+        // the options are part of the key, and the oldest entry goes first
+        let pretty = cache.convert(MDL_SOURCE, false).unwrap();
+        assert_ne!(expected, pretty);
+        cache.convert_with_flags(MDL_SOURCE, true, crate::SKIP_VIEWS);
+        assert!(cache.backend().used() <= expected.len() * 2);
+        let key = crate::CacheKey::new(MDL_SOURCE.as_bytes(), true, 0);
+        assert!(crate::CacheBackend::get(&mut *cache.backend(), &key).is_none());
+        // a file kept by a build writing something else isn't picked up
+        assert!(key
+            .to_hex()
+            .ends_with(&format!("-v{}", crate::CONVERTER_VERSION)));
+        assert!(cache.convert(":ohno:", true).is_none());
+
+        let dir = std::env::temp_dir().join(format!("xmutil-cache-{}", std::process::id()));
+        let cache = crate::ConversionCache::new(crate::DirCache::new(&dir).unwrap());
+        assert_eq!(Some(&expected), cache.convert(MDL_SOURCE, true).as_ref());
+        let cache = crate::ConversionCache::new(crate::DirCache::new(&dir).unwrap());
+        assert_eq!(
+            Some(&expected),
+            crate::CacheBackend::get(&mut *cache.backend(), &key).as_ref()
+        );
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn model() {
+        let mut model = crate::MdlModel::read(MDL_SOURCE, 0).unwrap();
+        for (compact, flags) in [(true, 0), (false, 0), (true, crate::MINIMAL), (true, 0)] {
+            assert_eq!(
+                crate::convert_vensim_mdl_with_flags(MDL_SOURCE, compact, flags).unwrap(),
+                model.write(compact, flags).unwrap()
+            );
+        }
+        assert_eq!(
+            crate::convert_vensim_mdl_gzip(MDL_SOURCE, false, 0).unwrap(),
+            model.write_gzip(false, 0).unwrap()
+        );
+        assert!(matches!(
+            crate::MdlModel::read("{UTF-8}\nx = ", 0),
+            Err(crate::ConvertError::Parse(diags)) if !diags.is_empty()
+        ));
+    }
+
+    #[test]
+    fn session() {
+        let mut session = crate::MdlSession::new(true, 0);
+        let first = session.convert(MDL_SOURCE).unwrap();
+        assert_eq!(crate::convert_vensim_mdl(MDL_SOURCE, true).unwrap(), first);
+        let chunks = session.reparsed_chunks();
+        assert!(chunks > 1);
+        assert_eq!(Some(&first), session.convert(MDL_SOURCE).as_ref());
+        assert_eq!(0, session.reparsed_chunks());
+
+        // each edit of one equation reads just that one again, and gives
+        // what converting the edited model afresh does - even as flows
+        // come and go, units and comments change and new names are used
+        let mut version = MDL_SOURCE.to_string();
+        for (from, to) in [
+            ("Stock/TIME STEP", "Stock/(2*TIME STEP)"),
+            ("Inflow-Outflow 1-Outflow 2", "Inflow-Outflow 1"),
+            ("Inflow-Outflow 1,", "Inflow-Outflow 1-Outflow 2,"),
+            (
+                "= 10\n\t~\tMonth\n\t~\tThe final",
+                "= 12\n\t~\tYear\n\t~\tThe last",
+            ),
+            ("Stock/(2*TIME STEP)", "Stock/(2*TIME STEP) + Leak"),
+            (
+                "( Time = FINAL TIME , 2 , 0 )",
+                "( Time = FINAL TIME , 2 , 0 )\n\t~\tWidget/Month",
+            ),
+            ("        TIME STEP\n", "        INTEG(TIME STEP, 1)\n"),
+            ("INTEG(TIME STEP, 1)", "TIME STEP"),
+        ] {
+            version = version.replacen(from, to, 1);
+            let actual = session.convert(&version).unwrap();
+            assert_eq!(1, session.reparsed_chunks(), "{}", to);
+            assert_eq!(
+                crate::convert_vensim_mdl(&version, true).unwrap(),
+                actual,
+                "{}",
+                to
+            );
+        }
+        // taking away the only use of a name, making a flow a stock or
+        // defining another variable in its place takes reading it all again
+        for (from, to) in [
+            (" + Leak", ""),
+            ("IF THEN ELSE( Time", "INTEG(1, 0) + IF THEN ELSE( Time"),
+            ("INTEG(1, 0) + IF THEN ELSE( Time", "IF THEN ELSE( Time"),
+            ("Outflow 2=\n", "x=\n"),
+        ] {
+            version = version.replacen(from, to, 1);
+            let actual = session.convert(&version).unwrap();
+            assert_eq!(chunks, session.reparsed_chunks(), "{}", to);
+            assert_eq!(
+                crate::convert_vensim_mdl(&version, true).unwrap(),
+                actual,
+                "{}",
+                to
+            );
+        }
+        // as does an equation that doesn't read, until it does again
+        let broken = version.replacen("Stock/(2*TIME STEP)", "Stock/(2*", 1);
+        assert!(session.convert(&broken).is_none());
+        assert!(session.convert(&version).is_some());
+        assert_eq!(chunks, session.reparsed_chunks());
+        let edited = version.replacen("= 12", "= 14", 1);
+        assert_eq!(
+            crate::convert_vensim_mdl(&edited, true),
+            session.convert(&edited)
+        );
+        assert_eq!(1, session.reparsed_chunks());
     }
 }
@@ -0,0 +1,773 @@
+#include "CodeGenerator.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "DataStore.h"
+#include "Function/Kernel.h"
+#include "Symbol/Expression.h"
+#include "XMUtil.h"
+
+// a double as C reads it back exactly - always with a point or an exponent
+// so it stays a double, and -0 stays negative
+static void AppendNumber(std::string &out, double value) {
+  if (isnan(value)) {
+    out += "NAN";
+    return;
+  }
+  if (isinf(value)) {
+    out += value < 0 ? "-HUGE_VAL" : "HUGE_VAL";
+    return;
+  }
+  size_t start = out.size();
+  AppendDouble(out, value);
+  if (out.find_first_of(".e", start) == std::string::npos)
+    out += ".0";
+}
+
+static void AppendInt(std::string &out, long value) {
+  out += std::to_string(value);
+}
+
+// as a C string literal - anything outside printable ASCII as an octal
+// escape, so the source reads the same in any character set
+static void AppendString(std::string &out, const std::string &s) {
+  out.push_back('"');
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\' || c == '?') {  // ? so there are never trigraphs
+      out.push_back('\\');
+      out.push_back(static_cast<char>(c));
+    } else if (c < 0x20 || c >= 0x7f) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\%03o", c);
+      out += buf;
+    } else {
+      out.push_back(static_cast<char>(c));
+    }
+  }
+  out.push_back('"');
+}
+
+// a static array of count values (at least one, as C has no empty arrays)
+template <class T>
+static void AppendArray(std::string &out, const char *type, const std::string &name, const T *values, size_t count,
+                        void (*append)(std::string &, T)) {
+  out += "static const ";
+  out += type;
+  out += " " + name + "[] = {";
+  size_t line = out.size();
+  for (size_t i = 0; i < count; i++) {
+    std::string value;
+    append(value, values[i]);
+    if (!i || out.size() - line + value.size() > 100) {
+      line = out.size() + 1;
+      out += "\n   ";
+    }
+    out += " " + value + ",";
+  }
+  if (!count)
+    out += "0";
+  out += "\n};\n";
+}
+
+static void AppendDoubleValue(std::string &out, double value) {
+  AppendNumber(out, value);
+}
+
+static void AppendIntValue(std::string &out, int value) {
+  AppendInt(out, value);
+}
+
+static void AppendStringValue(std::string &out, const char *value) {
+  AppendString(out, value);
+}
+
+CodeGenerator::CodeGenerator(const SimulationPlan *plan) {
+  pPlan = plan;
+  iStack = 1;
+  iConstants = iGathers = 0;
+}
+
+std::string CodeGenerator::Name(const char *prefix, int i) const {
+  return prefix + std::to_string(i);
+}
+
+// the arrays a table or data series is looked up in, written once however
+// many equations use it
+int CodeGenerator::Table(const ExpressionTable *table) {
+  std::map<const void *, int>::iterator it = mTables.find(table);
+  if (it != mTables.end())
+    return it->second;
+  int i = static_cast<int>(mTables.size());
+  mTables[table] = i;
+  ExpressionTable *t = const_cast<ExpressionTable *>(table);
+  AppendArray(sData, "double", Name("xm_table_x", i), t->GetXVals()->data(), t->GetXVals()->size(),
+              AppendDoubleValue);
+  AppendArray(sData, "double", Name("xm_table_y", i), t->GetYVals()->data(), t->GetYVals()->size(),
+              AppendDoubleValue);
+  return i;
+}
+
+int CodeGenerator::Series(const DataSeries *series) {
+  std::map<const void *, int>::iterator it = mSeries.find(series);
+  if (it != mSeries.end())
+    return it->second;
+  int i = static_cast<int>(mSeries.size());
+  mSeries[series] = i;
+  AppendArray(sData, "double", Name("xm_series_t", i), series->Times(), series->Size(), AppendDoubleValue);
+  AppendArray(sData, "double", Name("xm_series_v", i), series->Values(), series->Size(), AppendDoubleValue);
+  return i;
+}
+
+void CodeGenerator::FindParameters(const ExpressionCode &code) {
+  // named as their columns are - the controls are left out, as the run's
+  // steps are fixed from them
+  static const char *const controls[] = {"INITIAL TIME", "FINAL TIME", "TIME STEP", "SAVEPER"};
+  std::map<int, size_t> columns;
+  for (size_t i = 0; i < pPlan->vColumns.size(); i++) {
+    const std::string &name = pPlan->vNames[i + 1];
+    if (!pPlan->vColumns[i].bLevel &&
+        std::find(std::begin(controls), std::end(controls), name) == std::end(controls))
+      columns[pPlan->vColumns[i].offset] = i + 1;
+  }
+  size_t pc = 0;
+  for (const ExpressionCode::EquationCode &eq : code.vEquations) {
+    // a variable set in more than one code is the same parameter in each
+    int first = code.NumbersAt(pc, eq.end);
+    if (first >= 0 && columns.count(first) && !mParameterAt.count(first)) {
+      const ExpressionCode::Instruction &load = code.vCode[pc];
+      mParameterAt[first] = static_cast<int>(vParameters.size());
+      for (int i = 0; i < eq.width; i++) {
+        Parameter parameter;
+        std::map<int, size_t>::iterator column = columns.find(first + i);
+        parameter.name = column == columns.end() ? std::string() : pPlan->vNames[column->second];
+        parameter.offset = first + i;
+        parameter.value = code.vConstants[load.arg + (load.op == ExpressionCode::OP_CONSTANTS ? i : 0)];
+        vParameters.push_back(parameter);
+      }
+    }
+    pc = eq.end;
+  }
+}
+
+
+void CodeGenerator::WriteCode(const ExpressionCode &code, const char *name) {
+  sCode += "\nstatic void ";
+  sCode += name;
+  sCode += "(xm_workspace *w, double t) {\n";
+  bool fixed = &code == &pPlan->mCode.mInitial || &code == &pPlan->mCode.mUnchanging;
+  size_t pc = 0;
+  for (const ExpressionCode::EquationCode &eq : code.vEquations) {
+    // the variable it computes, with nothing in the name able to end the
+    // comment - those a delay or smooth keeps for itself have none
+    std::string var = eq.eq->GetVariable()->GetName();
+    for (size_t at = var.find("*/"); at != std::string::npos; at = var.find("*/"))
+      var.replace(at, 2, "* /");
+    if (!var.empty())
+      sCode += "  /* " + var + " */\n";
+    int first = fixed ? code.NumbersAt(pc, eq.end) : -1;
+    if (first >= 0 && mParameterAt.count(first)) {
+      sCode += "  for (int i = 0; i < " + std::to_string(eq.width) + "; i++)\n";
+      sCode += "    w->aux[" + std::to_string(first) + " + i] = w->parameters[" +
+               std::to_string(mParameterAt[first]) + " + i];\n";
+    } else {
+      WriteOps(code, pc, eq.end, eq.width);
+    }
+    pc = eq.end;
+  }
+  sCode += "  (void)w;\n  (void)t;\n}\n";
+}
+
+// whether the scalar slot k is used anywhere in code other than being set
+// at the start of a statement
+static bool SlotRead(const std::string &code, int k) {
+  std::string name = "s" + std::to_string(k);
+  for (size_t at = code.find(name); at != std::string::npos; at = code.find(name, at + 1)) {
+    size_t end = at + name.size();
+    if (at && (isalnum(static_cast<unsigned char>(code[at - 1])) || code[at - 1] == '_'))
+      continue;
+    if (end < code.size() && (isalnum(static_cast<unsigned char>(code[end])) || code[end] == '_'))
+      continue;
+    size_t line = code.rfind('\n', at);
+    line = line == std::string::npos ? 0 : line + 1;
+    if (code.find_first_not_of(' ', line) == at && code.compare(end, 3, " = ") == 0)
+      continue;  // set here
+    return true;
+  }
+  return false;
+}
+
+// one equation's instructions as C.  A scalar one keeps its stack in
+// locals and jumps with goto; an arrayed one keeps rows of width in the
+// workspace's stack and loops over them for each instruction, as RunVector
+// does
+void CodeGenerator::WriteOps(const ExpressionCode &code, size_t pc, size_t end, int width) {
+  bool rows = width > 1;
+  if (rows && (code.iMaxDepth + 1) * width > iStack)
+    iStack = (code.iMaxDepth + 1) * width;
+  std::vector<size_t> targets;
+  for (size_t at = pc; at < end; at++) {
+    int op = code.vCode[at].op;
+    if (op == ExpressionCode::OP_JUMP || op == ExpressionCode::OP_JUMP_IF_ZERO)
+      targets.push_back(code.vCode[at].arg);
+  }
+  std::string out;
+  // stack entry k, and where element i of something at base is
+  auto v = [&](int k) {
+    return rows ? "w->stack[" + std::to_string(k * width) + " + i]" : "s" + std::to_string(k);
+  };
+  auto at = [&](int base) { return std::to_string(base) + (rows ? " + i" : ""); };
+  // a statement written as if at the top of the function, in a loop over
+  // the row if there is one
+  auto each = [&](const std::string &statement) {
+    if (!rows) {
+      out += "  " + statement + "\n";
+      return;
+    }
+    out += "  for (int i = 0; i < " + std::to_string(width) + "; i++)";
+    if (statement[0] == '{') {  // a block becomes the loop's
+      out += " " + statement + "\n";
+      return;
+    }
+    out += "\n    ";
+    for (char c : statement)
+      out += c == '\n' ? "\n  " : std::string(1, c);
+    out += "\n";
+  };
+  auto label = [&](size_t pc) {
+    if (std::find(targets.begin(), targets.end(), pc) != targets.end())
+      out += "L" + std::to_string(pc) + ":;\n";
+  };
+  // the random functions take the stream first
+  auto call = [&](const char *function, int first, int args) {
+    std::string text = std::string(function) + (strncmp(function, "xm_random", 9) ? "(" : "(&w->random, ");
+    for (int k = 0; k < args; k++)
+      text += (k ? ", " : "") + v(first + k);
+    return text + ")";
+  };
+  int depth = 0;
+  int locals = 0;
+  for (; pc < end; pc++) {
+    label(pc);
+    const ExpressionCode::Instruction &ins = code.vCode[pc];
+    switch (ins.op) {
+    case ExpressionCode::OP_NUMBER: {
+      std::string number;
+      AppendNumber(number, code.vConstants[ins.arg]);
+      each(v(depth++) + " = " + number + ";");
+      break;
+    }
+    case ExpressionCode::OP_LEVEL:
+      each(v(depth++) + " = w->level[" + std::to_string(ins.arg) + "];");
+      break;
+    case ExpressionCode::OP_AUX:
+      each(v(depth++) + " = w->aux[" + std::to_string(ins.arg) + "];");
+      break;
+    case ExpressionCode::OP_CONSTANTS: {
+      std::string name = Name("xm_constants", iConstants++);
+      AppendArray(sData, "double", name, code.vConstants.data() + ins.arg, width, AppendDoubleValue);
+      each(v(depth++) + " = " + name + "[" + (rows ? "i" : "0") + "];");
+      break;
+    }
+    case ExpressionCode::OP_LEVEL_SLICE:
+      each(v(depth++) + " = w->level[" + at(ins.arg) + "];");
+      break;
+    case ExpressionCode::OP_AUX_SLICE:
+      each(v(depth++) + " = w->aux[" + at(ins.arg) + "];");
+      break;
+    case ExpressionCode::OP_LEVEL_GATHER:
+    case ExpressionCode::OP_AUX_GATHER: {
+      const std::vector<int> &offsets = code.vGathers[ins.arg];
+      std::string name = Name("xm_gather", iGathers++);
+      AppendArray(sData, "int", name, offsets.data(), offsets.size(), AppendIntValue);
+      each(v(depth++) + " = w->" + (ins.op == ExpressionCode::OP_LEVEL_GATHER ? "level" : "aux") + "[" + name +
+           "[" + (rows ? "i" : "0") + "]];");
+      break;
+    }
+    case ExpressionCode::OP_LOOKUP: {
+      ExpressionTable *table = code.vTables[ins.arg];
+      int i = Table(table);
+      each(v(depth - 1) + " = xm_lookup(" + Name("xm_table_x", i) + ", " + Name("xm_table_y", i) + ", " +
+           std::to_string(table->GetXVals()->size()) + ", " + v(depth - 1) + ");");
+      break;
+    }
+    case ExpressionCode::OP_DATA:
+    case ExpressionCode::OP_DATA_AT: {
+      const DataSeries *series = code.vData[ins.arg].get();
+      int i = Series(series);
+      bool atTime = ins.op == ExpressionCode::OP_DATA_AT;
+      std::string x = atTime ? v(depth - 1) : "t";
+      each(v(atTime ? depth - 1 : depth++) + " = xm_lookup(" + Name("xm_series_t", i) + ", " +
+           Name("xm_series_v", i) + ", " + std::to_string(series->Size()) + ", " + x + ");");
+      break;
+    }
+    case ExpressionCode::OP_TIME:
+      each(v(depth++) + " = t;");
+      break;
+    case ExpressionCode::OP_TIME_STEP: {
+      std::string dt;
+      AppendNumber(dt, pPlan->dDT);
+      each(v(depth++) + " = " + dt + ";");
+      break;
+    }
+    case ExpressionCode::OP_ADD:
+    case ExpressionCode::OP_SUBTRACT:
+    case ExpressionCode::OP_MULTIPLY:
+    case ExpressionCode::OP_DIVIDE:
+    case ExpressionCode::OP_LT:
+    case ExpressionCode::OP_LE:
+    case ExpressionCode::OP_GT:
+    case ExpressionCode::OP_GE:
+    case ExpressionCode::OP_EQ:
+    case ExpressionCode::OP_NE: {
+      // indexed from OP_ADD, skipping OP_POWER and OP_NEGATE
+      static const char *const ops[] = {"+", "-", "*", "/", NULL, NULL, "<", "<=", ">", ">=", "==", "!="};
+      depth--;
+      each(v(depth - 1) + " = " + v(depth - 1) + " " + ops[ins.op - ExpressionCode::OP_ADD] + " " + v(depth) + ";");
+      break;
+    }
+    case ExpressionCode::OP_AND:
+    case ExpressionCode::OP_OR:
+      depth--;
+      each(v(depth - 1) + " = " + v(depth - 1) + " != 0 " + (ins.op == ExpressionCode::OP_AND ? "&&" : "||") + " " +
+           v(depth) + " != 0;");
+      break;
+    case ExpressionCode::OP_POWER:
+      depth--;
+      each(v(depth - 1) + " = " + call("xm_power", depth - 1, 2) + ";");
+      break;
+    case ExpressionCode::OP_POWER_WHOLE:
+      if (rows && ins.arg == 2)
+        each(v(depth - 1) + " *= " + v(depth - 1) + ";");
+      else
+        each(v(depth - 1) + " = xm_power_whole(" + v(depth - 1) + ", " + std::to_string(ins.arg) + ");");
+      break;
+    case ExpressionCode::OP_NEGATE:
+      each(v(depth - 1) + " = -" + v(depth - 1) + ";");
+      break;
+    case ExpressionCode::OP_NOT:
+      each(v(depth - 1) + " = " + v(depth - 1) + " == 0;");
+      break;
+    case ExpressionCode::OP_SELECT:
+      depth -= 2;
+      each(v(depth - 1) + " = " + v(depth - 1) + " != 0 ? " + v(depth) + " : " + v(depth + 1) + ";");
+      break;
+    case ExpressionCode::OP_CALL: {
+      const KernelInfo &kernel = Kernels[ins.arg];
+      depth -= kernel.args - 1;
+      std::string statement = "{\n    double a = " + v(depth - 1);
+      if (kernel.args > 1)
+        statement += ", b = " + v(depth);
+      if (kernel.args > 2)
+        statement += ", c = " + v(depth + 1);
+      if (kernel.args > 3)
+        statement += ", d = " + v(depth + 2);
+      statement += ";\n    " + v(depth - 1) + " = " + kernel.source + ";\n  }";
+      each(statement);
+      break;
+    }
+    case ExpressionCode::OP_RANDOM_UNIFORM:
+      depth -= 1;
+      each(v(depth - 1) + " = " + call("xm_random_uniform", depth - 1, 2) + ";");
+      break;
+    case ExpressionCode::OP_RANDOM_NORMAL:
+      depth -= 3;
+      each(v(depth - 1) + " = " + call("xm_random_normal", depth - 1, 4) + ";");
+      break;
+    case ExpressionCode::OP_RANDOM_POISSON:
+      depth -= 4;
+      each(v(depth - 1) + " = " + call("xm_random_poisson", depth - 1, 5) + ";");
+      break;
+    case ExpressionCode::OP_STAGES_INIT:
+    case ExpressionCode::OP_STAGES_OUTPUT:
+    case ExpressionCode::OP_STAGES_RATES: {
+      // the stages, each a row of width, as RunPipeline has them
+      const ExpressionCode::Pipeline &pipeline = code.vPipelines[ins.arg];
+      std::string n = std::to_string(pipeline.count);
+      std::string stage = std::to_string(pipeline.stages) + " + k * " + std::to_string(width) + (rows ? " + i" : "");
+      if (ins.op == ExpressionCode::OP_STAGES_INIT) {
+        std::string init = v(depth - 2), delay = v(depth - 1);
+        each("{\n    double value = " + (pipeline.bMaterial ? init + " * (" + delay + " / " + n + ")" : init) +
+             ";\n    for (int k = 0; k < " + n + "; k++)\n      w->level[" + stage + "] = value;\n  }");
+        depth--;
+      } else if (ins.op == ExpressionCode::OP_STAGES_OUTPUT) {
+        std::string last = "w->level[" + at(pipeline.stages + (pipeline.count - 1) * width) + "]";
+        std::string delay = v(depth - 1);
+        each(delay + " = " + (pipeline.bMaterial ? last + " / (" + delay + " / " + n + ")" : last) + ";");
+      } else {
+        std::string input = v(depth - 2), delay = v(depth - 1);
+        std::string statement = "{\n    double each = " + delay + " / " + n + ";\n    double in = " + input +
+                                ";\n    for (int k = 0; k < " + n + "; k++) {\n      double stage = w->level[" +
+                                stage + "];\n";
+        if (pipeline.bMaterial)
+          statement += "      double out = stage / each;\n      w->rate[" + stage +
+                       "] = in - out;\n      in = out;\n";
+        else
+          statement += "      w->rate[" + stage + "] = (in - stage) / each;\n      in = stage;\n";
+        statement += "    }\n    " + input + " = in;\n  }";
+        each(statement);
+        depth--;
+      }
+      break;
+    }
+    case ExpressionCode::OP_RING_INIT:
+    case ExpressionCode::OP_RING_OUTPUT:
+    case ExpressionCode::OP_RING_SHIFT: {
+      // the slots, each a row, with the one due out kept after them
+      const ExpressionCode::Pipeline &pipeline = code.vPipelines[ins.arg];
+      std::string next = "w->aux[" + std::to_string(pipeline.ring + pipeline.length * width) + "]";
+      std::string slot =
+          "w->aux[" + std::to_string(pipeline.ring) + " + slot * " + std::to_string(width) + (rows ? " + i" : "") + "]";
+      out += "  {\n";
+      size_t inner = out.size();
+      if (ins.op == ExpressionCode::OP_RING_INIT) {
+        each("for (int slot = 0; slot < " + std::to_string(pipeline.length) + "; slot++)\n    " + slot + " = " +
+             v(depth - 1) + ";");
+        out += "  " + next + " = 0;\n";
+      } else if (ins.op == ExpressionCode::OP_RING_OUTPUT) {
+        out += "  int slot = (int)" + next + ";\n";
+        each(v(depth++) + " = " + slot + ";");
+      } else {
+        out += "  int slot = (int)" + next + ";\n";
+        each("{\n    double in = " + v(depth - 1) + ";\n    " + v(depth - 1) + " = " + slot + ";\n    " + slot +
+             " = in;\n  }");
+        out += "  " + next + " = (slot + 1) % " + std::to_string(pipeline.length) + ";\n";
+      }
+      for (size_t line = inner; line < out.size(); line = out.find('\n', line) + 1)
+        out.insert(line, "  ");
+      out += "  }\n";
+      break;
+    }
+    case ExpressionCode::OP_JUMP:
+      depth--;  // the value moves to where the branches join, as for Emit
+      out += "  goto L" + std::to_string(ins.arg) + ";\n";
+      break;
+    case ExpressionCode::OP_JUMP_IF_ZERO:
+      depth--;
+      out += "  if (" + v(depth) + " == 0)\n    goto L" + std::to_string(ins.arg) + ";\n";
+      break;
+    case ExpressionCode::OP_STORE_LEVEL:
+    case ExpressionCode::OP_STORE_RATE:
+    case ExpressionCode::OP_STORE_AUX: {
+      static const char *const arrays[] = {"level", "rate", "aux"};
+      depth--;
+      each(std::string("w->") + arrays[ins.op - ExpressionCode::OP_STORE_LEVEL] + "[" + at(ins.arg) +
+           "] = " + v(depth) + ";");
+      break;
+    }
+    default:  // OP_EVAL, which Generate has refused
+      assert(0);
+      break;
+    }
+    locals = std::max(locals, depth);
+  }
+  label(end);
+  // scalars get a block of their own for the locals - those only ever set
+  // (the delay a SMOOTH's stages start without) cast to void for -Wextra
+  if (!rows && locals) {
+    sCode += "  {\n    double s0";
+    for (int k = 1; k < locals; k++)
+      sCode += ", s" + std::to_string(k);
+    sCode += ";\n";
+    for (int k = 0; k < locals; k++) {
+      if (!SlotRead(out, k))
+        sCode += "    (void)s" + std::to_string(k) + ";\n";
+    }
+    for (size_t start = 0; start < out.size();) {
+      size_t stop = out.find('\n', start) + 1;
+      sCode += "  " + out.substr(start, stop - start);
+      start = stop;
+    }
+    sCode += "  }\n";
+  } else {
+    sCode += out;
+  }
+}
+
+// what every module has - the arithmetic and random numbers of the engine,
+// written as ExpressionCode, TableFunction and ContextInfo have them
+static const char *const Runtime = R"(
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define XM_EXPORT __declspec(dllexport)
+#elif defined(__EMSCRIPTEN__)
+#include <emscripten.h>
+#define XM_EXPORT EMSCRIPTEN_KEEPALIVE
+#else
+#define XM_EXPORT __attribute__((visibility("default")))
+#endif
+
+static inline double xm_power_whole(double a, int n) {
+  double result = 1;
+  if (n < 0)
+    return 1 / xm_power_whole(a, -n);
+  for (; n; n >>= 1) {
+    if (n & 1)
+      result *= a;
+    a *= a;
+  }
+  return result;
+}
+
+static inline double xm_power(double a, double b) {
+  if (fabs(b) <= 64 && b == (int)b)
+    return xm_power_whole(a, (int)b);
+  if (b == 0.5)
+    return sqrt(a);
+  return pow(a, b);
+}
+
+/* y at d, along straight lines between the points of x and y */
+static inline double xm_lookup(const double *x, const double *y, size_t n, double d) {
+  size_t lo = 0, hi = n - 1;
+  if (d <= x[0])
+    return y[0];
+  if (d >= x[n - 1])
+    return y[n - 1];
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (x[mid] <= d)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return y[lo] + (y[lo + 1] - y[lo]) * (d - x[lo]) / (x[lo + 1] - x[lo]);
+}
+
+typedef struct {
+  uint64_t key;
+  uint64_t draws;
+} xm_random_stream;
+
+static inline uint64_t xm_mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+#define XM_GAMMA 0x9e3779b97f4a7c15ULL
+
+static inline void xm_random_start(xm_random_stream *r, uint64_t seed, uint64_t stream) {
+  r->key = xm_mix(xm_mix(seed + XM_GAMMA) + stream * XM_GAMMA);
+  r->draws = 0;
+}
+
+static inline double xm_random(xm_random_stream *r) {
+  uint64_t bits = xm_mix(r->key + ++r->draws * XM_GAMMA);
+  return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline double xm_clamp(double min, double max, double value) {
+  value = min < value ? value : min;
+  return value < max ? value : max;
+}
+
+static inline double xm_random_uniform(xm_random_stream *r, double min, double max) {
+  return min + (max - min) * xm_random(r);
+}
+
+static inline double xm_random_normal(xm_random_stream *r, double min, double max, double mean, double sd) {
+  double u = 1 - xm_random(r);
+  double z = sqrt(-2 * log(u)) * cos(6.283185307179586 * xm_random(r));
+  return xm_clamp(min, max, mean + sd * z);
+}
+
+static inline double xm_random_poisson(xm_random_stream *r, double min, double max, double mean, double shift,
+                                       double stretch) {
+  double k = 0;
+  if (mean < 30) {
+    double limit = exp(-mean);
+    for (double p = xm_random(r); p > limit; p *= xm_random(r))
+      k++;
+  } else {
+    k = floor(xm_random_normal(r, -HUGE_VAL, HUGE_VAL, mean, sqrt(mean)) + 0.5);
+    k = 0.0 < k ? k : 0.0;
+  }
+  return xm_clamp(min, max, k * stretch + shift);
+}
+)";
+
+// the rows a run records, as Simulate has them
+static long Rows(long steps, long every) {
+  return steps / every + (steps % every ? 2 : 1);
+}
+
+// xm_run mirrors Simulate for a single run
+void CodeGenerator::WriteRun(std::string &out) const {
+  std::string start, dt, half, sixth;
+  AppendNumber(start, pPlan->dStart);
+  AppendNumber(dt, pPlan->dDT);
+  AppendNumber(half, pPlan->dDT / 2);
+  AppendNumber(sixth, pPlan->dDT / 6);
+  std::string setTime = pPlan->iTime >= 0 ? "  w->aux[" + std::to_string(pPlan->iTime) + "] = t;\n" : "";
+  std::string levels = std::to_string(pPlan->iNLevel);
+  auto advance = [&](const char *from, const std::string &h, const char *sum) {
+    out += "    for (int i = 0; i < " + levels + "; i++)\n      w->level[i] = w->" + from + "[i] + " + h + " * " +
+           sum + ";\n";
+  };
+  if (pPlan->iIntegrationType != Integration_Type_EULER) {
+    out += "\n/* the model again at the intermediate levels of a Runge-Kutta step */\n";
+    out += "static void xm_stage(xm_workspace *w, double t, double *k) {\n" + setTime;
+    out += "  xm_active(w, t);\n  xm_rates(w, t);\n";
+    out += "  for (int i = 0; i < " + levels + "; i++)\n    k[i] = w->rate[i];\n}\n";
+  }
+  out += "\nXM_EXPORT void xm_run(void *workspace, uint64_t seed, uint64_t stream) {\n";
+  out += "  xm_workspace *w = (xm_workspace *)workspace;\n";
+  out += "  double *row = w->results;\n";
+  out += "  double t = " + start + ";\n";
+  out += "  for (int i = 0; i < " + levels + "; i++) {\n";
+  out += "    w->level[i] = xm_level_start[i];\n    w->rate[i] = xm_rate_start[i];\n  }\n";
+  out += "  for (int i = 0; i < " + std::to_string(pPlan->iNAux) + "; i++)\n    w->aux[i] = xm_aux_start[i];\n";
+  out += "  xm_random_start(&w->random, seed, stream);\n";
+  out += "  xm_initial_time(w, t);\n" + setTime + "  xm_initial(w, t);\n  xm_unchanging(w, t);\n";
+  out += "  for (long step = 0;; step++) {\n";
+  out += "    t = " + start + " + step * " + dt + ";\n";
+  if (!setTime.empty())
+    out += "  " + setTime;
+  out += "    xm_active(w, t);\n";
+  out += "    if (step % " + std::to_string(pPlan->iSaveEvery) + " == 0 || step == " + std::to_string(pPlan->iSteps) +
+         ") {\n";
+  out += "      row[0] = t;\n";
+  for (size_t i = 0; i < pPlan->vColumns.size(); i++) {
+    const SimulationPlan::Column &column = pPlan->vColumns[i];
+    out += "      row[" + std::to_string(i + 1) + "] = w->" + (column.bLevel ? "level" : "aux") + "[" +
+           std::to_string(column.offset) + "];\n";
+  }
+  out += "      row += " + std::to_string(pPlan->vColumns.size() + 1) + ";\n    }\n";
+  out += "    if (step == " + std::to_string(pPlan->iSteps) + ")\n      break;\n";
+  out += "    xm_rates(w, t);\n    xm_shifts(w, t);\n";
+  switch (pPlan->iIntegrationType) {
+  case Integration_Type_EULER:
+    advance("level", dt, "w->rate[i]");
+    break;
+  case Integration_Type_RK2:
+    out += "    for (int i = 0; i < " + levels + "; i++) {\n";
+    out += "      w->level0[i] = w->level[i];\n      w->k1[i] = w->rate[i];\n    }\n";
+    advance("level0", dt, "w->k1[i]");
+    out += "    xm_stage(w, t + " + dt + ", w->k2);\n";
+    advance("level0", half, "(w->k1[i] + w->k2[i])");
+    break;
+  default:
+    out += "    for (int i = 0; i < " + levels + "; i++) {\n";
+    out += "      w->level0[i] = w->level[i];\n      w->k1[i] = w->rate[i];\n    }\n";
+    advance("level0", half, "w->k1[i]");
+    out += "    xm_stage(w, t + " + half + ", w->k2);\n";
+    advance("level0", half, "w->k2[i]");
+    out += "    xm_stage(w, t + " + half + ", w->k3);\n";
+    advance("level0", dt, "w->k3[i]");
+    out += "    xm_stage(w, t + " + dt + ", w->k4);\n";
+    advance("level0", sixth, "(w->k1[i] + 2 * w->k2[i] + 2 * w->k3[i] + w->k4[i])");
+    break;
+  }
+  out += "  }\n}\n";
+}
+
+void CodeGenerator::WriteInterface(std::string &out) const {
+  std::vector<const char *> names;
+  for (const Parameter &parameter : vParameters)
+    names.push_back(parameter.name.c_str());
+  out += "\n";
+  AppendArray(out, "char *const", "xm_parameter_names", names.data(), names.size(), AppendStringValue);
+  names.clear();
+  for (const std::string &name : pPlan->vNames)
+    names.push_back(name.c_str());
+  AppendArray(out, "char *const", "xm_column_names", names.data(), names.size(), AppendStringValue);
+  std::string parameters = std::to_string(vParameters.size());
+  std::string columns = std::to_string(pPlan->vNames.size());
+  out += "\nXM_EXPORT int xm_abi_version(void) {\n  return " + std::to_string(CODE_GENERATOR_ABI) + ";\n}\n";
+  out += "\nXM_EXPORT size_t xm_workspace_size(void) {\n  return sizeof(xm_workspace);\n}\n";
+  out += "\nXM_EXPORT void xm_init(void *workspace) {\n";
+  out += "  for (int i = 0; i < " + parameters + "; i++)\n";
+  out += "    ((xm_workspace *)workspace)->parameters[i] = xm_parameter_defaults[i];\n}\n";
+  out += "\nXM_EXPORT int xm_parameter_count(void) {\n  return " + parameters + ";\n}\n";
+  out += "\nXM_EXPORT const char *xm_parameter_name(int i) {\n";
+  out += "  return i >= 0 && i < " + parameters + " ? xm_parameter_names[i] : NULL;\n}\n";
+  out += "\nXM_EXPORT int xm_parameter_find(const char *name) {\n";
+  out += "  for (int i = 0; i < " + parameters + "; i++) {\n";
+  out += "    const char *a = xm_parameter_names[i], *b = name;\n";
+  out += "    while (*a && *a == *b) {\n      a++;\n      b++;\n    }\n";
+  out += "    if (*a == *b)\n      return i;\n  }\n  return -1;\n}\n";
+  out += "\nXM_EXPORT double xm_get_parameter(const void *workspace, int i) {\n";
+  out += "  return i >= 0 && i < " + parameters + " ? ((const xm_workspace *)workspace)->parameters[i] : NAN;\n}\n";
+  out += "\nXM_EXPORT void xm_set_parameter(void *workspace, int i, double value) {\n";
+  out += "  if (i >= 0 && i < " + parameters + ")\n";
+  out += "    ((xm_workspace *)workspace)->parameters[i] = value;\n}\n";
+  out += "\nXM_EXPORT int xm_column_count(void) {\n  return " + columns + ";\n}\n";
+  out += "\nXM_EXPORT const char *xm_column_name(int i) {\n";
+  out += "  return i >= 0 && i < " + columns + " ? xm_column_names[i] : NULL;\n}\n";
+  out += "\nXM_EXPORT int xm_row_count(void) {\n";
+  out += "  return " + std::to_string(Rows(pPlan->iSteps, pPlan->iSaveEvery)) + ";\n}\n";
+  out += "\nXM_EXPORT const double *xm_results(const void *workspace) {\n";
+  out += "  return ((const xm_workspace *)workspace)->results;\n}\n";
+}
+
+bool CodeGenerator::Generate(std::string &out) {
+  const SimulationPlan::Code &code = pPlan->mCode;
+  const ExpressionCode *codes[] = {&code.mInitialTime, &code.mInitial, &code.mUnchanging,
+                                   &code.mActive,      &code.mRates,   &code.mShifts};
+  static const char *const names[] = {"xm_initial_time", "xm_initial", "xm_unchanging",
+                                      "xm_active",       "xm_rates",   "xm_shifts"};
+  for (const ExpressionCode *c : codes) {
+    if (!c->vExpressions.empty())
+      return false;
+  }
+  vParameters.clear();
+  mParameterAt.clear();
+  mTables.clear();
+  mSeries.clear();
+  sData.clear();
+  sCode.clear();
+  iStack = 1;
+  iConstants = iGathers = 0;
+  FindParameters(code.mInitial);
+  FindParameters(code.mUnchanging);
+  for (size_t i = 0; i < sizeof(codes) / sizeof(*codes); i++)
+    WriteCode(*codes[i], names[i]);
+
+  out = "/* generated by xmutil from a compiled model - see CodeGenerator.h for\n";
+  out += "   the interface.  To get the results xmutil's own engine does, build\n";
+  out += "   without contracted floating point:\n";
+  out += "     cc -O2 -ffp-contract=off -shared -fPIC model.c -o model.so -lm\n";
+  out += "     emcc -O2 -ffp-contract=off --no-entry model.c -o model.wasm */\n";
+  out += Runtime;
+
+  // the arrays as they start out, for what no equation sets
+  int levels = std::max(1, pPlan->iNLevel);
+  long rows = Rows(pPlan->iSteps, pPlan->iSaveEvery);
+  out += "\n";
+  AppendArray(out, "double", "xm_level_start", pPlan->pLevel, pPlan->iNLevel, AppendDoubleValue);
+  AppendArray(out, "double", "xm_rate_start", pPlan->pRate, pPlan->iNLevel, AppendDoubleValue);
+  AppendArray(out, "double", "xm_aux_start", pPlan->pAux, pPlan->iNAux, AppendDoubleValue);
+  std::vector<double> defaults;
+  for (const Parameter &parameter : vParameters)
+    defaults.push_back(parameter.value);
+  AppendArray(out, "double", "xm_parameter_defaults", defaults.data(), defaults.size(), AppendDoubleValue);
+  out += "\ntypedef struct {\n";
+  out += "  double parameters[" + std::to_string(std::max<size_t>(1, vParameters.size())) + "];\n";
+  out += "  double level[" + std::to_string(levels) + "];\n";
+  out += "  double rate[" + std::to_string(levels) + "];\n";
+  out += "  double aux[" + std::to_string(std::max(1, pPlan->iNAux)) + "];\n";
+  if (pPlan->iIntegrationType != Integration_Type_EULER) {
+    out += "  double level0[" + std::to_string(levels) + "];\n";
+    for (int k = 1; k <= (pPlan->iIntegrationType == Integration_Type_RK2 ? 2 : 4); k++)
+      out += "  double k" + std::to_string(k) + "[" + std::to_string(levels) + "];\n";
+  }
+  out += "  double stack[" + std::to_string(iStack) + "];\n";
+  out += "  double results[" + std::to_string(rows * static_cast<long>(pPlan->vNames.size())) + "];\n";
+  out += "  xm_random_stream random;\n";
+  out += "} xm_workspace;\n";
+  if (!sData.empty())
+    out += "\n" + sData;
+  out += sCode;
+  WriteRun(out);
+  WriteInterface(out);
+  return true;
+}
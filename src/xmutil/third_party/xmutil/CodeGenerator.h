@@ -0,0 +1,75 @@
+#ifndef _XMUTIL_CODEGENERATOR_H
+#define _XMUTIL_CODEGENERATOR_H
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+
+/* CodeGenerator - a model compiled by Model::Compile written out as C, to
+   be built into a shared object or wasm module that runs it with no
+   interpreter in between.  It is the plan's own code, instruction for
+   instruction, on the same level, rate and aux arrays, so with contracted
+   floating point turned off (-ffp-contract=off, as the engine is built)
+   a run gives exactly what SimulationPlan::Run does
+
+   the module needs nothing of the C library but <math.h>, takes no memory
+   of its own and has a C interface that doesn't change from model to
+   model (C99, built as it is or into wasm):
+
+     int xm_abi_version(void)          CODE_GENERATOR_ABI
+     size_t xm_workspace_size(void)    bytes, aligned as for a double
+     void xm_init(void *workspace)     the parameters at their defaults
+     int xm_parameter_count(void)
+     const char *xm_parameter_name(int i)
+     int xm_parameter_find(const char *name)      -1 if there is none
+     double xm_get_parameter(const void *workspace, int i)
+     void xm_set_parameter(void *workspace, int i, double value)
+     void xm_run(void *workspace, uint64_t seed, uint64_t stream)
+     int xm_column_count(void)         Time first
+     const char *xm_column_name(int i)
+     int xm_row_count(void)
+     const double *xm_results(const void *workspace)   row after row
+
+   the random functions draw from the stream of seed given as in Run.  The
+   parameters are the variables whose equations are numbers - an arrayed
+   one gives a parameter for each element, named as its column is.  The
+   control parameters (INITIAL TIME and the rest) and the delay times of
+   DELAY FIXED are as they were when the model was compiled */
+#define CODE_GENERATOR_ABI 1
+
+class CodeGenerator {
+public:
+  // plan compiled with parameters (see Model::Compile)
+  CodeGenerator(const SimulationPlan *plan);
+  // the C for the module - false if some of the code falls back to Eval,
+  // which has no C to give
+  bool Generate(std::string &out);
+
+private:
+  struct Parameter {
+    std::string name;
+    int offset;  // in the aux array
+    double value;
+  };
+  void FindParameters(const ExpressionCode &code);
+  void WriteCode(const ExpressionCode &code, const char *name);
+  void WriteOps(const ExpressionCode &code, size_t pc, size_t end, int width);
+  void WriteRun(std::string &out) const;
+  void WriteInterface(std::string &out) const;
+  int Table(const ExpressionTable *table);
+  int Series(const DataSeries *series);
+  std::string Name(const char *prefix, int i) const;
+  const SimulationPlan *pPlan;
+  std::vector<Parameter> vParameters;
+  std::map<int, int> mParameterAt;  // the first parameter of the equation storing at each aux offset
+  std::map<const void *, int> mTables;
+  std::map<const void *, int> mSeries;
+  std::string sData;  // the tables, series and gathers
+  std::string sCode;  // the functions for the plan's code
+  int iStack;         // the doubles the arrayed equations need for their rows
+  int iConstants;     // the arrays written so far for OP_CONSTANTS
+  int iGathers;       // and for the gathers
+};
+
+#endif
@@ -1,8 +1,69 @@
 #include "ContextInfo.h"
 
+#include <math.h>
+
+#include <algorithm>
+
+#include "Model.h"
 #include "Symbol/Expression.h"
 #include "Symbol/Symbol.h"
 #include "Symbol/Variable.h"
+#include "XMUtil.h"
+
+ContextInfo &ContextInfo::operator<<(double num) {
+  AppendDouble(*pOutput, num);
+  return *this;
+}
+
+// the splitmix64 finalizer - a counter run through it gives a stream
+// that passes the usual statistical tests
+static uint64_t RandomMix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+#define RANDOM_GAMMA 0x9e3779b97f4a7c15ULL
+
+void ContextInfo::SetRandomStream(uint64_t seed, uint64_t stream) {
+  iRandomKey = RandomMix(RandomMix(seed + RANDOM_GAMMA) + stream * RANDOM_GAMMA);
+  iRandomDraws = 0;
+}
+
+double ContextInfo::Random(void) {
+  uint64_t bits = RandomMix(iRandomKey + ++iRandomDraws * RANDOM_GAMMA);
+  return (bits >> 11) * (1.0 / 9007199254740992.0);  // the top 53 bits
+}
+
+double ContextInfo::RandomUniform(double min, double max) {
+  return min + (max - min) * Random();
+}
+
+double ContextInfo::RandomNormal(double min, double max, double mean, double sd) {
+  // Box-Muller, using only the cosine half so each value takes two draws
+  double u = 1 - Random();  // (0, 1] so the log is finite
+  double z = sqrt(-2 * log(u)) * cos(6.283185307179586 * Random());
+  return std::min(max, std::max(min, mean + sd * z));
+}
+
+double ContextInfo::RandomPoisson(double min, double max, double mean, double shift, double stretch) {
+  double k = 0;
+  if (mean < 30) {  // Knuth's - counting draws until their product drops below exp(-mean)
+    double limit = exp(-mean);
+    for (double p = Random(); p > limit; p *= Random())
+      k++;
+  } else {  // by then a rounded normal is close enough
+    k = std::max(0.0, floor(RandomNormal(-HUGE_VAL, HUGE_VAL, mean, sqrt(mean)) + 0.5));
+  }
+  return std::min(max, std::max(min, k * stretch + shift));
+}
+
+// from the model's cache if there is one, otherwise expanded into scratch
+const std::vector<Symbol *> &ContextInfo::SubscriptElements(Symbol *s, std::vector<Symbol *> &scratch) {
+  if (pModel)
+    return pModel->SubscriptElements(s);
+  Equation::GetSubscriptElements(scratch, s);
+  return scratch;
+}
 
 Symbol *ContextInfo::GetLHSSpecific(Symbol *dim) {
   if (!pLHSElmsGeneric || dim->isType() != Symtype_Variable)
@@ -10,13 +71,15 @@ Symbol *ContextInfo::GetLHSSpecific(Symbol *dim) {
   int n = pLHSElmsGeneric->size();
   int i;
   for (i = 0; i < n; i++) {
-    if ((*pLHSElmsGeneric)[i] == dim)
+    if ((*pLHSElmsGeneric)[i] == dim) {
+      bUsedLHSElms = true;
       return (*pLHSElmsSpecific)[i];
+    }
   }
   // no match
   // see if dim has anything it maps to - if so look for that on the LHS - then take the corresponding specific element
   Variable *v = static_cast<Variable *>(dim);
-  std::vector<Equation *> eqs = v->GetAllEquations();
+  const std::vector<Equation *> &eqs = v->GetAllEquations();
   if (!eqs.empty()) {
     Expression *exp = eqs[0]->GetExpression();
     assert(exp->GetType() == EXPTYPE_Symlist);
@@ -34,16 +97,17 @@ Symbol *ContextInfo::GetLHSSpecific(Symbol *dim) {
             Symbol *owner = sle.u.pSymbol;  // shoulw be  asubscript range
             for (i = 0; i < n; i++) {
               if ((*pLHSElmsGeneric)[i] == owner) {
+                bUsedLHSElms = true;
                 // look for pLHSElmsSpecific in the entries for owner as subscript definition - use that position from
                 // v above
                 // Variable *mv = static_cast<Variable *>(owner);
 
-                std::vector<Symbol *> list;
-                Equation::GetSubscriptElements(list, owner);
+                std::vector<Symbol *> scratch;
+                const std::vector<Symbol *> &list = SubscriptElements(owner, scratch);
                 for (size_t k = 0; k < list.size(); k++) {
                   if (list[k] == (*pLHSElmsSpecific)[i]) {
-                    std::vector<Symbol *> ours;
-                    Equation::GetSubscriptElements(ours, v);
+                    std::vector<Symbol *> scratch2;
+                    const std::vector<Symbol *> &ours = SubscriptElements(v, scratch2);
                     if (ours.size() == list.size())
                       return ours[k];
                   }
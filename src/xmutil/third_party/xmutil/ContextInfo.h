@@ -1,8 +1,9 @@
 #ifndef _XMUTIL_CONTEXTINFO_H
 #define _XMUTIL_CONTEXTINFO_H
 #include <assert.h>
+#include <stdint.h>
 
-#include <sstream>
+#include <string>
 #include <vector>
 /* a utility class helpfu in sorting and evaluating equations
  */
@@ -26,24 +27,55 @@
 #define DDF_data 8
 #define DDF_level 16
 
+class MacroInstance;
 class Model;
 class SymbolNameSpace;
 class Equation;  // forward
 class Symbol;
+class Variable;
 
-class ContextInfo : public std::ostringstream {
+/* output is appended to a string - by default one the ContextInfo owns,
+   or one the caller passes in so that it can be reused from equation to
+   equation without a stream being built each time */
+class ContextInfo {
 public:
-  ContextInfo(void) {
+  ContextInfo(std::string *output = NULL) {
+    pOutput = output ? output : &sOutput;
     iComputeType = 0;
     bInitEqn = false;
+    pLHSElmsGeneric = pLHSElmsSpecific = NULL;
+    pModel = NULL;
+    pMacroInstance = NULL;
+    bUsedLHSElms = false;
+    bEvalFailed = false;
     pEquations = NULL;
+    pDependencies = NULL;
+    pSymbolNameSpace = NULL;
+    cDynamicDependencyFlag = 0;
+    dTime = 0;
+    dDT = 1;
+    SetRandomStream(0, 0);
   }
   ~ContextInfo(void) {
   }
   friend class Model;
-  // ContextInfo& operator << (const char *s) { std::cout << s ; return *this; }
-  // ContextInfo& operator << (const std::string& s) {std::cout << s.c_str(); return *this; }
-  // ContextInfo& operator << (const double num) { std::cout << num ; return *this ;}
+  friend class SimulationPlan;
+  ContextInfo &operator<<(const char *s) {
+    pOutput->append(s);
+    return *this;
+  }
+  ContextInfo &operator<<(const std::string &s) {
+    pOutput->append(s);
+    return *this;
+  }
+  ContextInfo &operator<<(char c) {
+    pOutput->push_back(c);
+    return *this;
+  }
+  ContextInfo &operator<<(double num);  // shortest form that reads back the same
+  inline const std::string &str(void) {
+    return *pOutput;
+  }
   inline int GetComputeType(void) {
     return iComputeType;
   }
@@ -75,6 +107,15 @@ public:
     if (pEquations)
       pEquations->push_back(e);
   }
+  // while set CheckComputed lists the variables an expression reads here
+  // for Model::OrderEquations to put in order
+  inline void SetDependencies(std::vector<Variable *> *dependencies) {
+    pDependencies = dependencies;
+  }
+  inline void AddDependency(Variable *var) {
+    if (pDependencies)
+      pDependencies->push_back(var);
+  }
   inline SymbolNameSpace *GetSymbolNameSpace(void) {
     return pSymbolNameSpace;
   }
@@ -93,25 +134,85 @@ public:
   inline double GetDT(void) {
     return dDT;
   }
+  inline void SetTime(double time) {
+    dTime = time;
+  }
+  inline void SetDT(double dt) {
+    dDT = dt;
+  }
+  // called by anything that can't be evaluated so a simulation knows its
+  // results are no good
+  inline void SetEvalFailed(void) {
+    bEvalFailed = true;
+  }
+  inline bool EvalFailed(void) {
+    return bEvalFailed;
+  }
   inline void SetLHSElms(const std::vector<Symbol *> *generic, const std::vector<Symbol *> *specific) {
     assert(specific->size() == generic->size());
     pLHSElmsGeneric = generic;
     pLHSElmsSpecific = specific;
   }
   Symbol *GetLHSSpecific(Symbol *generic);
+  // lets subscript lookups use the model's cache of expanded ranges
+  inline void SetModel(Model *model) {
+    pModel = model;
+  }
+  inline Model *GetModel(void) {
+    return pModel;
+  }
+  // while ordering the equations of a use of a macro, the use
+  inline void SetMacroInstance(const MacroInstance *use) {
+    pMacroInstance = use;
+  }
+  inline const MacroInstance *GetMacroInstance(void) {
+    return pMacroInstance;
+  }
+  // the random functions draw from a counter based generator - the nth
+  // number of a stream depends on only the seed, the stream and n, so runs
+  // on different streams are independent and can go in any order
+  void SetRandomStream(uint64_t seed, uint64_t stream);
+  double Random(void);  // in [0, 1)
+  // how far the stream has got, to carry a run on from a checkpoint
+  uint64_t RandomDraws(void) const {
+    return iRandomDraws;
+  }
+  void SetRandomDraws(uint64_t draws) {
+    iRandomDraws = draws;
+  }
+  double RandomUniform(double min, double max);
+  // these are truncated to min and max as Vensim's are
+  double RandomNormal(double min, double max, double mean, double sd);
+  double RandomPoisson(double min, double max, double mean, double shift, double stretch);
+  // true once anything has depended on the specific LHS elements - if not
+  // the output is the same for every element
+  inline bool UsedLHSElms(void) {
+    return bUsedLHSElms;
+  }
 
 private:
+  const std::vector<Symbol *> &SubscriptElements(Symbol *s, std::vector<Symbol *> &scratch);
+  std::string *pOutput;
+  std::string sOutput;
   double dTime, dDT;
+  uint64_t iRandomKey;    // from the seed and stream
+  uint64_t iRandomDraws;  // how many numbers the stream has given so far
   double *pBaseLevel, *pCurLevel;
   double *pBaseRate, *pCurRate;
   double *pBaseAux, *pCurAux;
   SymbolNameSpace *pSymbolNameSpace;
+  Model *pModel;  // may be NULL
+  // the use of a macro whose body is being ordered, NULL but then
+  const MacroInstance *pMacroInstance;
   const std::vector<Symbol *> *pLHSElmsGeneric;   // left hand side current settings of subscripts
   const std::vector<Symbol *> *pLHSElmsSpecific;  // left hand side current settings of subscripts
   std::vector<Equation *> *pEquations;            /* passed from model - active or initial or... */
+  std::vector<Variable *> *pDependencies;         // see SetDependencies
   int iComputeType;                               // CF_... as above
   unsigned char cDynamicDependencyFlag;           // DDF_... as above
   bool bInitEqn;                                  // for xmile
+  bool bUsedLHSElms;                              // see UsedLHSElms
+  bool bEvalFailed;                               // see SetEvalFailed
 };
 
 #endif
@@ -0,0 +1,208 @@
+#include "ConversionSession.h"
+
+#include <stdlib.h>
+
+#include <unordered_map>
+
+#include "Symbol/Equation.h"
+#include "Symbol/SymbolArena.h"
+#include "Vensim/VensimLex.h"
+#include "XMUtil.h"
+#include "Xmile/XMILEWriter.h"
+
+// FNV-1a - chunks are only compared with the same chunk of the last
+// version, so a fast hash with the length alongside is plenty
+static uint64_t HashBytes(const char *s, size_t len) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3ULL;
+  return h;
+}
+
+// the equation read if that is all there is, other than its comment -
+// NULL for groups, several equations or nothing
+static const VensimParse::ChunkItem *OnlyEquation(const VensimParse::ChunkRead &read) {
+  const std::vector<VensimParse::ChunkItem> &items = read.vItems;
+  if (items.empty() || items.size() > 2 || items[0].iKind != '|' || (items.size() == 2 && items[1].iKind != '~'))
+    return NULL;
+  return &items[0];
+}
+
+ConversionSession::ConversionSession(bool compact, uint32_t flags)
+    : bChunked(false), bCompact(compact), iFlags(flags), bOK(false), iReparsed(0) {
+}
+
+bool ConversionSession::Convert(const char *contents, size_t length) {
+  std::vector<VensimSpan> spans;
+  bool macros = VensimLex::SplitEquations(contents, length, spans);
+  std::vector<Chunk> chunks;
+  for (const VensimSpan &span : spans)
+    chunks.push_back(Chunk{HashBytes(span.Begin(), span.Length()), span.Length()});
+  std::vector<size_t> changed;
+  if (chunks.size() == vChunks.size()) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+      if (!(chunks[i] == vChunks[i]))
+        changed.push_back(i);
+    }
+    if (changed.empty()) {
+      iReparsed = 0;
+      return bOK;
+    }
+  }
+
+  vChunks.swap(chunks);
+  if (bChunked && !changed.empty() && changed.back() + 1 < vChunks.size() &&
+      Update(contents, length, spans, changed)) {
+    iReparsed = changed.size();
+  } else {
+    iReparsed = vChunks.size();
+    if (!Read(contents, length, spans, macros)) {
+      sXMILE.clear();
+      return bOK = false;
+    }
+  }
+  return bOK = Write();
+}
+
+bool ConversionSession::Read(const char *contents, size_t length, const std::vector<VensimSpan> &spans,
+                             bool macros) {
+  pParse.reset();
+  pModel.reset(new Model);
+  bChunked = false;
+  vReads.clear();
+  SymbolArena::Scope arenaScope{pModel->Arena()};
+  pParse.reset(new VensimParse(pModel.get()));
+  pParse->SetSkipViews((iFlags & XMUTIL_SKIP_VIEWS) != 0);
+  pParse->SetShareExpressions((iFlags & XMUTIL_SHARE_EXPRESSIONS) != 0);
+  pParse->SetSkipDocs((iFlags & XMUTIL_SKIP_DOCS) != 0);
+  pParse->SetThreads(iFlags & XMUTIL_PARALLEL_PARSE ? _available_threads() : 1);
+  // as VensimParse::ProcessFile would read it in chunks, whatever the threads
+  bool chunked = !macros && !(iFlags & XMUTIL_SHARE_EXPRESSIONS) && spans.back().Length();
+  SymbolNameSpace *sns = pModel->GetNameSpace();
+  vBefore = sns->Symbols();
+  if (chunked ? !pParse->ProcessChunks(contents, length, spans, vReads)
+              : !pParse->ProcessFile("<in memory>", contents, length))
+    return false;
+
+  size_t read = sns->Symbols().size();
+  pModel->MarkVariableTypes(nullptr);
+  for (MacroFunction *mf : pModel->MacroFunctions())
+    pModel->MarkVariableTypes(mf->NameSpace());
+  pModel->AttachStragglers();
+  const std::vector<Symbol *> &symbols = sns->Symbols();
+  vMarked.assign(symbols.begin() + read, symbols.end());
+  bChunked = chunked;
+  return true;
+}
+
+bool ConversionSession::Update(const char *contents, size_t length, const std::vector<VensimSpan> &spans,
+                               const std::vector<size_t> &changed) {
+  SymbolArena::Scope arenaScope{pModel->Arena()};
+  SymbolNameSpace *sns = pModel->GetNameSpace();
+  std::unordered_map<Variable *, std::string> comments;  // for each variable with a new equation
+  for (size_t k : changed) {
+    const VensimParse::ChunkItem *was = OnlyEquation(vReads[k]);
+    if (!was)
+      return false;
+    VensimParse::ChunkRead read;
+    SymbolNameSpace::Log log;
+    bool ok = pParse->ReadChunk(spans[k], log, read);
+    sns->Adopt(log);
+    const VensimParse::ChunkItem *now = ok ? OnlyEquation(read) : NULL;
+    if (!now)
+      return false;
+    Variable *var = was->pEquation->GetVariable();
+    // whether the variable's units came from this chunk - those of a
+    // later one have gone with reading it
+    bool units = was->pUnits && was->pUnits == var->Units();
+    if (!pModel->ReplaceEquation(was->pEquation, now->pEquation))
+      return false;
+    vReads[k] = read;
+    // the units are the first its equations give
+    UnitExpression *first = NULL;
+    size_t at = vReads.size();
+    for (size_t i = 0; i < vReads.size() && !first; i++) {
+      for (const VensimParse::ChunkItem &item : vReads[i].vItems) {
+        if (item.iKind == '|' && item.pUnits && item.pEquation->GetVariable() == var) {
+          first = item.pUnits;
+          at = i;
+          break;
+        }
+      }
+    }
+    if (at == k)
+      var->SetUnits(first);
+    else if (units && first)
+      return false;
+    else if (units)
+      var->SetUnits(NULL);
+    comments[var].clear();
+  }
+
+  // the last comment each gets, following the variable each is for as
+  // adding the chunks in order does
+  Variable *active = NULL;
+  for (const VensimParse::ChunkRead &read : vReads) {
+    for (const VensimParse::ChunkItem &item : read.vItems) {
+      if (item.iKind == '|') {
+        active = item.pEquation->GetVariable();
+      } else if (item.iKind == '~' && active) {
+        std::unordered_map<Variable *, std::string>::iterator it = comments.find(active);
+        if (it != comments.end())
+          it->second = item.sText;
+      }
+    }
+  }
+  for (const std::pair<Variable *const, std::string> &comment : comments)
+    comment.first->SetComment(comment.second);
+
+  // the names in the order reading them all would have put them in - each
+  // where it was first used, unless nothing uses it any more
+  const std::vector<Symbol *> &symbols = sns->Symbols();
+  std::vector<Symbol *> order(vBefore);
+  std::vector<bool> placed(symbols.size(), false);
+  for (Symbol *sym : vBefore)
+    placed[sym->NameSpacePos()] = true;
+  for (const VensimParse::ChunkRead &read : vReads) {
+    for (Symbol *sym : read.vTouched) {
+      if (!placed[sym->NameSpacePos()]) {
+        placed[sym->NameSpacePos()] = true;
+        order.push_back(sym);
+      }
+    }
+  }
+  for (Symbol *sym : vMarked) {
+    if (!placed[sym->NameSpacePos()]) {
+      placed[sym->NameSpacePos()] = true;
+      order.push_back(sym);
+    }
+  }
+  if (order.size() != symbols.size())
+    return false;
+  sns->SetOrder(order);
+
+  // what AttachStragglers added to the views may no longer be wanted
+  pParse->ReadViewsAgain(contents, length, spans.back());
+  pModel->AttachStragglers();
+  return true;
+}
+
+bool ConversionSession::Write(void) {
+  SymbolArena::Scope arenaScope{pModel->Arena()};
+  XMILEWriter writer{bCompact};
+  writer.SetMinimal((iFlags & XMUTIL_MINIMAL) != 0);
+  std::vector<std::string> errs;
+  pModel->PrintXMILE(&writer, errs);
+  if (!errs.empty()) {
+    sXMILE.clear();
+    return false;
+  }
+  char *xmile = writer.Release(nullptr);
+  if (!xmile) {
+    sXMILE.clear();
+    return false;
+  }
+  sXMILE.assign(xmile);
+  free(xmile);
+  return true;
+}
@@ -0,0 +1,77 @@
+#ifndef _XMUTIL_CONVERSIONSESSION_H
+#define _XMUTIL_CONVERSIONSESSION_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+#include "Vensim/VensimParse.h"
+
+/* ConversionSession - converts successive versions of one MDL buffer, as
+   an editor does after each change
+
+   each version is split into the pieces the parser takes one at a time
+   (VensimLex::SplitEquations) and compared with the last version.  A
+   version whose pieces all match gets the last XMILE back without any
+   work.  The model read for the last version is kept, along with what
+   each of its chunks read, so when only some equations have changed (the
+   same number of chunks, the sketch and settings as they were) just those
+   chunks are read again.  Each new equation takes the place of the old
+   one in its variable (Model::ReplaceEquation), the units, comment and
+   order of the names are worked out again from the chunks, and the views
+   are read again for AttachStragglers before the model is written.
+
+   Anything else - chunks added or taken away, an equation now for another
+   variable, one that doesn't read, or one whose marking reaches past its
+   own variable and flows (see ReplaceEquation) - reads the whole model
+   again, as does every version with macros or with expressions shared,
+   which can't be read in chunks at all.  Either way the XMILE is what a
+   fresh conversion with the same flags would give */
+class ConversionSession {
+public:
+  ConversionSession(bool compact, uint32_t flags);
+  // false on failure, otherwise XMILE() is the conversion of contents
+  bool Convert(const char *contents, size_t length);
+  const std::string &XMILE(void) const {
+    return sXMILE;
+  }
+  // equation chunks (the sketch and settings count as one) read for the
+  // last Convert - all of them when it read the whole model, none when
+  // nothing had changed
+  size_t ReparsedChunks(void) const {
+    return iReparsed;
+  }
+
+private:
+  struct Chunk {
+    uint64_t hash;
+    size_t length;
+    bool operator==(const Chunk &other) const {
+      return hash == other.hash && length == other.length;
+    }
+  };
+  // the whole of contents into a new model - false if it doesn't read
+  bool Read(const char *contents, size_t length, const std::vector<VensimSpan> &spans, bool macros);
+  // the chunks changed into the model Read left - false if that can't be
+  // done, leaving the model to be read again
+  bool Update(const char *contents, size_t length, const std::vector<VensimSpan> &spans,
+              const std::vector<size_t> &changed);
+  bool Write(void);  // the model as XMILE into sXMILE
+  std::vector<Chunk> vChunks;
+  std::unique_ptr<Model> pModel;
+  std::unique_ptr<VensimParse> pParse;  // which read it and reads its chunks again - deleted first
+  bool bChunked;                        // whether pModel was read in chunks, so can be updated
+  std::vector<VensimParse::ChunkRead> vReads;  // for each chunk but the sketch
+  std::vector<Symbol *> vBefore;               // the names there before the chunks were read
+  std::vector<Symbol *> vMarked;               // and those marking the types added (net flows)
+  std::string sXMILE;
+  bool bCompact;
+  uint32_t iFlags;
+  bool bOK;  // whether sXMILE holds the result for vChunks
+  size_t iReparsed;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "DataStore.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "Function/TableFunction.h"
+#include "XMUtil.h"
+
+#if !defined(__wasm__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <mutex>
+#define DATA_LOCK std::lock_guard<std::mutex> lock{StoreMutex()}
+static std::mutex &StoreMutex(void) {
+  static std::mutex mutex;
+  return mutex;
+}
+#else
+#define DATA_LOCK
+#endif
+
+// a cache is this, then the version and a word to tell the byte order
+// by, then the row and column counts and then the cells
+static const char CacheMagic[8] = {'X', 'M', 'U', 'T', 'D', 'A', 'T', 'A'};
+#define CACHE_VERSION 1
+#define CACHE_BYTE_ORDER 0x01020304u
+#define CACHE_HEADER 32
+
+DataSeries::DataSeries(std::vector<double> &&times, std::vector<double> &&values)
+    : vTimes(std::move(times)), vValues(std::move(values)) {
+  assert(!vTimes.empty() && vTimes.size() == vValues.size());
+}
+
+double DataSeries::Lookup(double t, size_t *hint) const {
+  return TableFunction::Lookup(vTimes.data(), vValues.data(), vTimes.size(), t, hint);
+}
+
+DataStore &DataStore::Global(void) {
+  static DataStore store;
+  return store;
+}
+
+double DataStore::File::Cell(size_t row, size_t col) const {
+  return row < iRows && col < iCols ? pCells[col * iRows + row] : NAN;
+}
+
+// a whole cell as a number - spaces around it are fine but anything else
+// in it makes it NaN
+static double CellValue(const char *s, size_t len) {
+  while (len && (*s == ' ' || *s == '\t')) {
+    s++;
+    len--;
+  }
+  while (len && (s[len - 1] == ' ' || s[len - 1] == '\t'))
+    len--;
+  bool negative = false;
+  if (len && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    s++;
+    len--;
+  }
+  size_t i = 0, digits = 0;
+  for (; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+    digits++;
+  if (i < len && s[i] == '.') {
+    for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+      digits++;
+  }
+  if (!digits)
+    return NAN;
+  if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+    i++;
+    if (i < len && (s[i] == '+' || s[i] == '-'))
+      i++;
+    size_t start = i;
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+      ;
+    if (i == start)
+      return NAN;
+  }
+  if (i != len)
+    return NAN;
+  double value = StringToDouble(s, len);
+  return negative ? -value : value;
+}
+
+// the rows of text as a grid, quoted cells included
+static void ParseCells(const char *text, size_t length, std::vector<double> &cells, size_t &rows, size_t &cols) {
+  const char *end = text + length;
+  const char *eol = static_cast<const char *>(memchr(text, '\n', length));
+  char separator = memchr(text, '\t', (eol ? eol : end) - text) ? '\t' : ',';
+  std::vector<std::vector<double>> grid;
+  std::string quoted;
+  const char *p = text;
+  while (p < end) {
+    std::vector<double> row;
+    for (;;) {
+      double value;
+      if (p < end && *p == '"') {
+        quoted.clear();
+        for (p++; p < end; p++) {
+          if (*p == '"') {
+            if (p + 1 < end && p[1] == '"')
+              p++;
+            else {
+              p++;
+              break;
+            }
+          }
+          quoted.push_back(*p);
+        }
+        for (; p < end && *p != separator && *p != '\n' && *p != '\r'; p++)
+          ;
+        value = CellValue(quoted.data(), quoted.size());
+      } else {
+        const char *start = p;
+        for (; p < end && *p != separator && *p != '\n' && *p != '\r'; p++)
+          ;
+        value = CellValue(start, p - start);
+      }
+      row.push_back(value);
+      if (p >= end || *p != separator)
+        break;
+      p++;
+    }
+    if (p < end && *p == '\r')
+      p++;
+    if (p < end && *p == '\n')
+      p++;
+    grid.push_back(std::move(row));
+  }
+  rows = grid.size();
+  cols = 0;
+  for (const std::vector<double> &row : grid)
+    cols = std::max(cols, row.size());
+  cells.assign(rows * cols, NAN);
+  for (size_t r = 0; r < rows; r++) {
+    for (size_t c = 0; c < grid[r].size(); c++)
+      cells[c * rows + r] = grid[r][c];
+  }
+}
+
+bool DataStore::Add(const std::string &name, const char *text, size_t length, std::string *error) {
+  std::unique_ptr<File> file(new File);
+  ParseCells(text, length, file->vOwnCells, file->iRows, file->iCols);
+  file->pCells = file->vOwnCells.data();
+  if (!file->iRows || !file->iCols) {
+    if (error)
+      *error = "no data in " + name;
+    return false;
+  }
+  return Keep(name, std::move(file));
+}
+
+bool DataStore::Load(const std::string &name, const char *path, std::string *error) {
+  std::unique_ptr<File> file(new File);
+  if (!file->mMapping.Open(path)) {
+    if (error)
+      *error = file->mMapping.Error();
+    return false;
+  }
+  const char *data = file->mMapping.Data();
+  size_t length = file->mMapping.Length();
+  if (length < CACHE_HEADER || memcmp(data, CacheMagic, sizeof(CacheMagic)))
+    return Add(name, data, length, error);  // the mapping goes once it is parsed
+  uint32_t version, order;
+  uint64_t rows, cols;
+  memcpy(&version, data + 8, 4);
+  memcpy(&order, data + 12, 4);
+  memcpy(&rows, data + 16, 8);
+  memcpy(&cols, data + 24, 8);
+  size_t cells = (length - CACHE_HEADER) / sizeof(double);
+  if (version != CACHE_VERSION || order != CACHE_BYTE_ORDER || !rows || !cols || cols > cells / rows ||
+      rows * cols != cells || (length - CACHE_HEADER) % sizeof(double)) {
+    if (error)
+      *error = std::string(path) + " is not a data cache this can read";
+    return false;
+  }
+  file->iRows = static_cast<size_t>(rows);
+  file->iCols = static_cast<size_t>(cols);
+  const char *first = data + CACHE_HEADER;
+  if (reinterpret_cast<uintptr_t>(first) % alignof(double)) {  // only when read rather than mapped
+    file->vOwnCells.resize(cells);
+    memcpy(file->vOwnCells.data(), first, cells * sizeof(double));
+    file->pCells = file->vOwnCells.data();
+  } else
+    file->pCells = reinterpret_cast<const double *>(first);
+  return Keep(name, std::move(file));
+}
+
+bool DataStore::Keep(const std::string &name, std::unique_ptr<File> file) {
+  DATA_LOCK;
+  mFiles[name] = std::move(file);
+  return true;
+}
+
+bool DataStore::WriteCache(const std::string &name, const char *path, std::string *error) {
+  DATA_LOCK;
+  auto it = mFiles.find(name);
+  if (it == mFiles.end()) {
+    if (error)
+      *error = "no data added as " + name;
+    return false;
+  }
+  const File &file = *it->second;
+  FILE *out = fopen(path, "wb");
+  if (!out) {
+    if (error)
+      *error = std::string("unable to open ") + path + ": " + strerror(errno);
+    return false;
+  }
+  char header[CACHE_HEADER];
+  uint32_t version = CACHE_VERSION, order = CACHE_BYTE_ORDER;
+  uint64_t rows = file.iRows, cols = file.iCols;
+  memcpy(header, CacheMagic, sizeof(CacheMagic));
+  memcpy(header + 8, &version, 4);
+  memcpy(header + 12, &order, 4);
+  memcpy(header + 16, &rows, 8);
+  memcpy(header + 24, &cols, 8);
+  size_t cells = file.iRows * file.iCols;
+  bool ok = fwrite(header, 1, CACHE_HEADER, out) == CACHE_HEADER &&
+            fwrite(file.pCells, sizeof(double), cells, out) == cells;
+  ok = fclose(out) == 0 && ok;
+  if (!ok && error)
+    *error = std::string("unable to write ") + path;
+  return ok;
+}
+
+void DataStore::Clear(void) {
+  DATA_LOCK;
+  mFiles.clear();
+}
+
+// a column as letters (A is 0) and a row as digits (1 is 0) - false for
+// what is neither
+static bool CellPart(const std::string &s, size_t &i, bool letters, size_t *index) {
+  size_t start = i, value = 0;
+  for (; i < s.size(); i++) {
+    char c = s[i];
+    if (letters && c >= 'a' && c <= 'z')
+      c -= 'a' - 'A';
+    if (letters ? c < 'A' || c > 'Z' : c < '0' || c > '9')
+      break;
+    value = letters ? value * 26 + (c - 'A' + 1) : value * 10 + (c - '0');
+  }
+  if (i == start || !value)
+    return false;
+  *index = value - 1;
+  return true;
+}
+
+std::shared_ptr<const DataSeries> DataStore::Find(const std::string &name, const std::string &timeRowOrCol,
+                                                  const std::string &firstCell) {
+  size_t i = 0, col, row, time;
+  if (!CellPart(firstCell, i, true, &col) || !CellPart(firstCell, i, false, &row) || i != firstCell.size())
+    return NULL;
+  i = 0;
+  bool across = !CellPart(timeRowOrCol, i, true, &time);  // the times are a row
+  if (across && (i = 0, !CellPart(timeRowOrCol, i, false, &time)))
+    return NULL;
+  if (i != timeRowOrCol.size())
+    return NULL;
+
+  DATA_LOCK;
+  auto it = mFiles.find(name);
+  if (it == mFiles.end())
+    return NULL;
+  File &file = *it->second;
+  std::string key = (across ? "R" : "C") + std::to_string(time) + ":" + std::to_string(col) + "," +
+                    std::to_string(row);
+  std::shared_ptr<const DataSeries> &series = file.mSeries[key];
+  if (series)
+    return series;
+  std::vector<double> times, values;
+  size_t n = across ? (col < file.iCols ? file.iCols - col : 0) : (row < file.iRows ? file.iRows - row : 0);
+  for (size_t k = 0; k < n; k++) {
+    double t = across ? file.Cell(time, col + k) : file.Cell(row + k, time);
+    double v = across ? file.Cell(row, col + k) : file.Cell(row + k, col);
+    if (!std::isnan(t) && !std::isnan(v)) {
+      times.push_back(t);
+      values.push_back(v);
+    }
+  }
+  if (times.empty()) {
+    file.mSeries.erase(key);
+    return NULL;
+  }
+  if (!std::is_sorted(times.begin(), times.end())) {
+    std::vector<size_t> order(times.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&times](size_t a, size_t b) { return times[a] < times[b]; });
+    std::vector<double> sortedTimes(times.size()), sortedValues(times.size());
+    for (size_t k = 0; k < order.size(); k++) {
+      sortedTimes[k] = times[order[k]];
+      sortedValues[k] = values[order[k]];
+    }
+    times.swap(sortedTimes);
+    values.swap(sortedValues);
+  }
+  series = std::make_shared<DataSeries>(std::move(times), std::move(values));
+  return series;
+}
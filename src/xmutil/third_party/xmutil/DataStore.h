@@ -0,0 +1,91 @@
+#ifndef _XMUTIL_DATASTORE_H
+#define _XMUTIL_DATASTORE_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+/* DataSeries - the points of one GET DIRECT DATA series, sorted by time,
+   as a column of times and a column of values.  Nothing changes once it
+   is made, so any number of runs can look values up at once, each keeping
+   its own hint */
+class DataSeries {
+public:
+  DataSeries(std::vector<double> &&times, std::vector<double> &&values);
+  size_t Size(void) const {
+    return vTimes.size();
+  }
+  const double *Times(void) const {
+    return vTimes.data();
+  }
+  const double *Values(void) const {
+    return vValues.data();
+  }
+  double LastTime(void) const {
+    return vTimes.back();
+  }
+  // the value at time t, interpolated between the points either side of
+  // it and held at the first and last points beyond them.  hint (which may
+  // be NULL) keeps the point found so a run moving forward through time
+  // doesn't search
+  double Lookup(double t, size_t *hint) const;
+
+private:
+  std::vector<double> vTimes;
+  std::vector<double> vValues;
+};
+
+/* DataStore - the external data GET DIRECT DATA and the GET DATA functions
+   read, held for the whole process so every model converted or run shares
+   one copy of a file however many times it is named
+
+   a file is parsed once, when it is added, into a grid of numbers kept
+   column after column - a cell that isn't a number is NaN.  A series (a
+   time column or row and the values beside it) is taken out of the grid
+   and sorted the first time it is asked for and kept from then on.  Files
+   are CSV or tab separated, as a spreadsheet saves them, and the grid can
+   be written out as a cache that is later mapped into memory rather than
+   parsed again
+
+   adding and finding are thread safe.  A series found is shared with
+   whatever keeps it, so code compiled against it goes on reading the same
+   points after the file it came from is added again or the store cleared */
+class DataStore {
+public:
+  static DataStore &Global(void);  // the one the functions read
+  // text is CSV, or tab separated if its first line has a tab in it.  As
+  // with the others false (with error set if it isn't NULL) if it can't be
+  // used, leaving anything already added under name in place
+  bool Add(const std::string &name, const char *text, size_t length, std::string *error = NULL);
+  // the file at path (a cache if it starts as one does, CSV otherwise)
+  bool Load(const std::string &name, const char *path, std::string *error = NULL);
+  // writes what is held for name where Load can map it from
+  bool WriteCache(const std::string &name, const char *path, std::string *error = NULL);
+  void Clear(void);
+  // the series with times in timeRowOrCol (a column letter, or a row
+  // number for times that go across) and values from firstCell (as B2) on,
+  // as GET DIRECT DATA names them - NULL if name hasn't been added or there
+  // are no points there
+  std::shared_ptr<const DataSeries> Find(const std::string &name, const std::string &timeRowOrCol,
+                                         const std::string &firstCell);
+
+private:
+  struct File {
+    MappedFile mMapping;  // the cells of a cache are read from here
+    std::vector<double> vOwnCells;
+    const double *pCells;  // column after column
+    size_t iRows;
+    size_t iCols;
+    std::map<std::string, std::shared_ptr<const DataSeries>> mSeries;  // by where they came from
+    double Cell(size_t row, size_t col) const;
+  };
+  bool Keep(const std::string &name, std::unique_ptr<File> file);
+  std::map<std::string, std::unique_ptr<File>> mFiles;
+};
+
+#endif
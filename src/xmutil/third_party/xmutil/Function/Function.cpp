@@ -1,6 +1,15 @@
 #include "Function.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "../DataStore.h"
+#include "../Model.h"
+#include "../Symbol/Equation.h"
+#include "../Symbol/ExpressionCode.h"
 #include "../Symbol/ExpressionList.h"
+#include "../Symbol/LeftHandSide.h"
+#include "../Symbol/Variable.h"
 #include "../XMUtil.h"
 
 // model symbol - most variables including subscript ranges but not
@@ -16,12 +25,121 @@ Function::~Function(void) {
 MacroFunction::MacroFunction(SymbolNameSpace *sns, SymbolNameSpace *local, const std::string &name,
                              ExpressionList *margs)
     : Function(sns, name, margs->Length()), pSymbolNameSpace(local), mArgs(margs) {
+  iComputed = 0;
+  iOutput = -1;
+  iReady = 0;
 }
 
 std::string MacroFunction::ComputableName(void) {
   return SpaceToUnderBar(this->GetName());
 }
 
+// whether a use can compute e with variables of its own - a function with
+// memory needs a variable of its own to keep it so only the whole equation
+// can be one, a lookup must be of a table the body defines and another
+// macro can't be used
+static bool MacroUsable(Expression *e, bool top) {
+  switch (e->GetType()) {
+  case EXPTYPE_Number:
+    return true;
+  case EXPTYPE_Variable:
+    return !static_cast<ExpressionVariable *>(e)->GetSubs();
+  case EXPTYPE_FunctionMemory:
+    if (!top || static_cast<ExpressionFunctionMemory *>(e)->Placeholder())
+      return false;
+    /* fall through */
+  case EXPTYPE_Function: {
+    if (e->GetFunction()->Macro())
+      return false;  // each use of this would need uses of its own
+    ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+    int n = args ? args->Length() : 0;
+    for (int i = 0; i < n; i++) {
+      if (!MacroUsable(args->GetExp(i), false))
+        return false;
+    }
+    return true;
+  }
+  case EXPTYPE_Lookup: {
+    ExpressionVariable *table = static_cast<ExpressionVariable *>(e->GetArg(0));
+    if (table) {
+      const std::vector<Equation *> &eqs = table->GetVariable()->GetAllEquations();
+      if (table->GetSubs() || eqs.size() != 1 || eqs[0]->GetExpression()->GetType() != EXPTYPE_Table)
+        return false;
+    }
+    return MacroUsable(e->GetArg(1), false);
+  }
+  case EXPTYPE_Operator:
+  case EXPTYPE_Logical:
+    for (int i = 0; i < 2; i++) {
+      if (e->GetArg(i) && !MacroUsable(e->GetArg(i), false))
+        return false;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool MacroFunction::Ready(SymbolNameSpace *main) {
+  if (iReady)
+    return iReady > 0;
+  iReady = -1;
+  auto add = [this](Variable *var, Variable *read) {
+    mSlots[var] = static_cast<int>(vSlots.size());
+    vSlots.push_back(var);
+    vReads.push_back(read);
+  };
+  // what it computes - a table is the same for every use so stays shared
+  for (Variable *var : pSymbolNameSpace->Variables()) {
+    const std::vector<Equation *> &eqs = var->GetAllEquations();
+    if (eqs.empty() || eqs[0]->GetExpression()->GetType() == EXPTYPE_Table)
+      continue;
+    if (eqs.size() != 1 || eqs[0]->GetLeft()->GetSubs() || eqs[0]->GetLeft()->GetExceptList() ||
+        !MacroUsable(eqs[0]->GetExpression(), true))
+      return false;
+    add(var, NULL);
+  }
+  iComputed = static_cast<int>(vSlots.size());
+  for (int i = 0; i < mArgs->Length(); i++) {
+    Expression *arg = mArgs->GetExp(i);
+    if (arg->GetType() != EXPTYPE_Variable || static_cast<ExpressionVariable *>(arg)->GetSubs())
+      return false;
+    Variable *var = static_cast<ExpressionVariable *>(arg)->GetVariable();
+    if (mSlots.count(var))
+      return false;
+    add(var, NULL);
+  }
+  // anything else it names is the model's - Time, TIME STEP and the like
+  std::vector<Variable *> used;
+  for (int i = 0; i < iComputed; i++)
+    vSlots[i]->GetEquation(0)->GetExpression()->GetVarsUsed(used);
+  for (Variable *var : used) {
+    if (mSlots.count(var) || !var->GetAllEquations().empty())
+      continue;
+    Symbol *sym = main->Find(var->GetName());
+    if (!sym || sym->isType() != Symtype_Variable)
+      return false;
+    add(var, static_cast<Variable *>(sym));
+  }
+  Symbol *output = pSymbolNameSpace->Find(GetName());
+  iOutput = output && output->isType() == Symtype_Variable ? Slot(static_cast<Variable *>(output)) : -1;
+  if (iOutput < 0 || iOutput >= iComputed)
+    return false;
+  iReady = 1;
+  return true;
+}
+
+bool MacroFunction::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
+  Variable *output = info->GetModel() ? info->GetModel()->MacroOutput(arg) : NULL;
+  if (!output)
+    return Function::CheckComputedList(info, arg);
+  return output->CheckComputed(info, false);
+}
+
+bool MacroFunction::Compile(ExpressionCode *code, ExpressionList *arg) {
+  return code->MacroCall(arg);
+}
+
 bool Function::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
   return arg->CheckComputed(info, 0xffffffff);
 }
@@ -224,32 +342,294 @@ void FunctionLog::OutputComputable(ContextInfo *info, ExpressionList *arg) {
   Function::OutputComputable(info, arg);
 }
 
-#ifdef WANT_EVAL_STUFF
-double FunctionMax::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
-  double a1 = arg->GetExp(0)->Eval(info);
-  double a2 = arg->GetExp(1)->Eval(info);
-  return a1 > a2 ? a1 : a2;
+double Function::Eval(Expression *ex, ExpressionList *arg, ContextInfo *info) {
+  info->SetEvalFailed();
+  return 0;
+}
+
+// every argument is evaluated, even one the result doesn't use (the third
+// of XIDZ mostly), just as the compiled code does
+double FunctionKernel::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  const KernelInfo &kernel = Kernels[iKernel];
+  int n = kernel.args - iTimeArgs;
+  if (!arg || arg->Length() != n)
+    return Function::Eval(from, arg, info);
+  double rows[KERNEL_MAX_ARGS];
+  for (int i = 0; i < n; i++)
+    rows[i] = arg->GetExp(i)->Eval(info);
+  if (iTimeArgs > 0)
+    rows[n] = info->GetTime();
+  if (iTimeArgs > 1)
+    rows[n + 1] = info->GetDT();
+  kernel.run(rows, 1);
+  return rows[0];
+}
+bool FunctionKernel::Compile(ExpressionCode *code, ExpressionList *arg) {
+  if (!arg || arg->Length() != Kernels[iKernel].args - iTimeArgs)
+    return false;
+  for (int i = 0; i < arg->Length(); i++)
+    arg->GetExp(i)->Compile(code);
+  if (iTimeArgs > 0)
+    code->Emit(ExpressionCode::OP_TIME);
+  if (iTimeArgs > 1)
+    code->Emit(ExpressionCode::OP_TIME_STEP);
+  code->Call(iKernel);
+  return true;
+}
+double FunctionIfThenElse::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  if (arg->GetExp(0)->Eval(info) != 0)
+    return arg->GetExp(1)->Eval(info);
+  return arg->GetExp(2)->Eval(info);
 }
-double FunctionMin::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
-  double a1 = arg->GetExp(0)->Eval(info);
-  double a2 = arg->GetExp(1)->Eval(info);
-  return a1 < a2 ? a1 : a2;
+bool FunctionIfThenElse::Compile(ExpressionCode *code, ExpressionList *arg) {
+  arg->GetExp(0)->Compile(code);
+  double cond;
+  if (code->PopConstant(&cond)) {  // typically a switch set for the run
+    arg->GetExp(cond != 0 ? 1 : 2)->Compile(code);
+    return true;
+  }
+  if (code->Rows()) {  // the elements, or lanes, can go either way
+    arg->GetExp(1)->Compile(code);
+    arg->GetExp(2)->Compile(code);
+    code->Emit(ExpressionCode::OP_SELECT);
+    return true;
+  }
+  size_t iffalse = code->Here();
+  code->Emit(ExpressionCode::OP_JUMP_IF_ZERO);
+  arg->GetExp(1)->Compile(code);
+  size_t done = code->Here();
+  code->Emit(ExpressionCode::OP_JUMP);
+  code->PatchJump(iffalse);
+  arg->GetExp(2)->Compile(code);
+  code->PatchJump(done);
+  return true;
 }
 double FunctionInteg::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
   if (info->GetComputeType() == CF_initial)
     return arg->GetExp(1)->Eval(info);  // initialization
   return arg->GetExp(0)->Eval(info);
+}
+bool FunctionInteg::Compile(ExpressionCode *code, ExpressionList *arg) {
+  arg->GetExp(code->ComputeType() == CF_initial ? 1 : 0)->Compile(code);
+  return true;
+}
+double FunctionActiveInitial::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  if (info->GetComputeType() == CF_initial)
+    return arg->GetExp(1)->Eval(info);
+  return arg->GetExp(0)->Eval(info);
+}
+bool FunctionActiveInitial::Compile(ExpressionCode *code, ExpressionList *arg) {
+  arg->GetExp(code->ComputeType() == CF_initial ? 1 : 0)->Compile(code);
+  return true;
+}
+
+// the seed argument the random functions take is left alone - the numbers
+// come from the stream the run was given (see ContextInfo::SetRandomStream)
+// so that runs can be repeated and spread over threads
+static bool RandomCheckComputed(ContextInfo *info, ExpressionList *arg) {
+  if (info->GetComputeType() == CF_active)
+    info->AddDDF(DDF_time_varying);
+  return !arg || arg->CheckComputed(info, 0xffffffff);
+}
+static void RandomCompile(ExpressionCode *code, ExpressionList *arg, int count, int op) {
+  for (int i = 0; i < count; i++)
+    arg->GetExp(i)->Compile(code);
+  code->Emit(op);
+}
+double FunctionRandom01::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  return info->Random();
+}
+bool FunctionRandom01::Compile(ExpressionCode *code, ExpressionList *arg) {
+  code->Number(0);
+  code->Number(1);
+  code->Emit(ExpressionCode::OP_RANDOM_UNIFORM);
+  return true;
+}
+bool FunctionRandom01::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
+  return RandomCheckComputed(info, arg);
+}
+double FunctionRandomUniform::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  double min = arg->GetExp(0)->Eval(info);
+  return info->RandomUniform(min, arg->GetExp(1)->Eval(info));
+}
+bool FunctionRandomUniform::Compile(ExpressionCode *code, ExpressionList *arg) {
+  RandomCompile(code, arg, 2, ExpressionCode::OP_RANDOM_UNIFORM);
+  return true;
+}
+bool FunctionRandomUniform::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
+  return RandomCheckComputed(info, arg);
+}
+double FunctionRandomNormal::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  double min = arg->GetExp(0)->Eval(info);
+  double max = arg->GetExp(1)->Eval(info);
+  double mean = arg->GetExp(2)->Eval(info);
+  return info->RandomNormal(min, max, mean, arg->GetExp(3)->Eval(info));
+}
+bool FunctionRandomNormal::Compile(ExpressionCode *code, ExpressionList *arg) {
+  RandomCompile(code, arg, 4, ExpressionCode::OP_RANDOM_NORMAL);
+  return true;
+}
+bool FunctionRandomNormal::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
+  return RandomCheckComputed(info, arg);
+}
+double FunctionRandomPoisson::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  double min = arg->GetExp(0)->Eval(info);
+  double max = arg->GetExp(1)->Eval(info);
+  double mean = arg->GetExp(2)->Eval(info);
+  double shift = arg->GetExp(3)->Eval(info);
+  return info->RandomPoisson(min, max, mean, shift, arg->GetExp(4)->Eval(info));
+}
+bool FunctionRandomPoisson::Compile(ExpressionCode *code, ExpressionList *arg) {
+  RandomCompile(code, arg, 5, ExpressionCode::OP_RANDOM_POISSON);
+  return true;
+}
+bool FunctionRandomPoisson::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
+  return RandomCheckComputed(info, arg);
+}
+
+// the series GET DIRECT DATA with these arguments reads - NULL unless they
+// are all literals and the file they name has been added to the store with
+// data where they say
+static std::shared_ptr<const DataSeries> DirectData(ExpressionList *arg) {
+  if (!arg || arg->Length() != 4)
+    return NULL;
+  std::string text[4];
+  for (int i = 0; i < 4; i++) {
+    Expression *e = arg->GetExp(i);
+    if (e->GetType() != EXPTYPE_Literal)
+      return NULL;
+    const std::string &value = static_cast<ExpressionLiteral *>(e)->GetValue();
+    text[i] = value.size() >= 2 ? value.substr(1, value.size() - 2) : value;
+  }
+  return DataStore::Global().Find(text[0], text[2], text[3]);  // the tab only means something in a workbook
+}
+
+// the same for a variable defined by GET DIRECT DATA, as the GET DATA
+// functions are given
+static std::shared_ptr<const DataSeries> DataOf(Expression *e) {
+  if (e->GetType() != EXPTYPE_Variable)
+    return NULL;
+  const std::vector<Equation *> &eqs = static_cast<ExpressionVariable *>(e)->GetVariable()->GetAllEquations();
+  if (eqs.size() != 1)
+    return NULL;
+  Expression *def = eqs[0]->GetExpression();
+  if (def->GetType() != EXPTYPE_FunctionMemory || def->GetFunction()->GetName() != "GET DIRECT DATA")
+    return NULL;  // time dependent functions are all parsed as having memory
+  return DirectData(static_cast<ExpressionFunction *>(def)->GetArgs());
+}
+
+double FunctionGetDirectData::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  std::shared_ptr<const DataSeries> series = DirectData(arg);
+  if (series)
+    return series->Lookup(info->GetTime(), NULL);
+  info->SetEvalFailed();
+  return 0;
+}
+bool FunctionGetDirectData::Compile(ExpressionCode *code, ExpressionList *arg) {
+  std::shared_ptr<const DataSeries> series = DirectData(arg);
+  if (!series)
+    return false;
+  code->Data(series, false);
+  return true;
+}
+double FunctionGetDataAtTime::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  std::shared_ptr<const DataSeries> series = DataOf(arg->GetExp(0));
+  if (series)
+    return series->Lookup(arg->GetExp(1)->Eval(info), NULL);
+  info->SetEvalFailed();
   return 0;
 }
-double FunctionPulse::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
-  double s = arg->GetExp(0)->Eval(info);
-  double dt = info->GetDT();
-  double w = arg->GetExp(1)->Eval(info);
-  if (w < dt)
-    w = dt;
-  double t = info->GetTime();
-  if (t > s - dt / 4.0 && t < s + w - dt / 4.0)
-    return 1.0;
+bool FunctionGetDataAtTime::Compile(ExpressionCode *code, ExpressionList *arg) {
+  std::shared_ptr<const DataSeries> series = DataOf(arg->GetExp(0));
+  if (!series)
+    return false;
+  arg->GetExp(1)->Compile(code);
+  code->Data(series, true);
+  return true;
+}
+double FunctionGetDataLastTime::Eval(Expression *from, ExpressionList *arg, ContextInfo *info) {
+  std::shared_ptr<const DataSeries> series = DataOf(arg->GetExp(0));
+  if (series)
+    return series->LastTime();
+  info->SetEvalFailed();
   return 0;
 }
-#endif
+bool FunctionGetDataLastTime::Compile(ExpressionCode *code, ExpressionList *arg) {
+  std::shared_ptr<const DataSeries> series = DataOf(arg->GetExp(0));
+  if (!series)
+    return false;
+  code->Number(series->LastTime());
+  return true;
+}
+
+// the value of e if it is a number or a variable whose one equation gives
+// one - what a pipeline needs to be sized by before anything is computed
+static bool ConstantValue(Expression *e, double *value, int depth = 0) {
+  if (!e || depth > 16)
+    return false;
+  if (e->GetType() == EXPTYPE_Number) {
+    *value = e->Eval(NULL);
+    return true;
+  }
+  if (e->GetType() != EXPTYPE_Variable)
+    return false;
+  const std::vector<Equation *> &eqs = static_cast<ExpressionVariable *>(e)->GetVariable()->GetAllEquations();
+  return eqs.size() == 1 && ConstantValue(eqs[0]->GetExpression(), value, depth + 1);
+}
+void FunctionPipeline::Layout(SymbolNameSpace *sns, ExpressionList *arg, int *stages, int *ring) {
+  *stages = *ring = 0;
+  double value;
+  if (iKind == Kind_Fixed) {
+    Symbol *sym = sns->Find("TIME STEP");
+    const std::vector<Equation *> *eqs = NULL;
+    if (sym && sym->isType() == Symtype_Variable)
+      eqs = &static_cast<Variable *>(sym)->GetAllEquations();
+    double dt;
+    if (eqs && eqs->size() == 1 && ConstantValue((*eqs)[0]->GetExpression(), &dt) && dt > 0 &&
+        ConstantValue(arg->GetExp(1), &value) && value >= 0)
+      *ring = std::max(1, static_cast<int>(value / dt + 0.5));  // rounded to a whole number of steps
+  } else if (iOrderArg < 0) {
+    *stages = iOrder;
+  } else if (ConstantValue(arg->GetExp(iOrderArg), &value) && value >= 0.5) {
+    *stages = static_cast<int>(value + 0.5);
+  }
+}
+// the output comes from the stages, so like a level it doesn't wait on
+// the input - that is needed only for the rates
+bool FunctionPipeline::CheckComputedList(ContextInfo *info, ExpressionList *arg) {
+  unsigned delay = iKind == Kind_Fixed ? 0 : 0b10;  // DELAY FIXED was sized by it
+  switch (info->GetComputeType()) {
+  case CF_initial:
+    return arg->CheckComputed(info, (1 << (iInitArg >= 0 ? iInitArg : 0)) | delay);
+  case CF_rate:
+    return arg->CheckComputed(info, 0b01 | delay);
+  case CF_active:
+    info->AddDDF(DDF_level);
+    break;
+  }
+  return arg->CheckComputed(info, delay);
+}
+bool FunctionPipeline::Compile(ExpressionCode *code, ExpressionList *arg) {
+  int pipeline = code->AddPipeline(iKind == Kind_Material);
+  if (pipeline < 0)
+    return false;
+  bool fixed = iKind == Kind_Fixed;
+  int op;
+  switch (code->ComputeType()) {
+  case CF_initial:
+    arg->GetExp(iInitArg >= 0 ? iInitArg : 0)->Compile(code);
+    op = fixed ? ExpressionCode::OP_RING_INIT : ExpressionCode::OP_STAGES_INIT;
+    break;
+  case CF_rate:
+    arg->GetExp(0)->Compile(code);
+    op = fixed ? ExpressionCode::OP_RING_SHIFT : ExpressionCode::OP_STAGES_RATES;
+    break;
+  default:
+    op = fixed ? ExpressionCode::OP_RING_OUTPUT : ExpressionCode::OP_STAGES_OUTPUT;
+    break;
+  }
+  if (!fixed)
+    arg->GetExp(1)->Compile(code);
+  code->Emit(op, pipeline);
+  return true;
+}
@@ -1,12 +1,22 @@
 #ifndef _XMUTIL_SYMBOL_FUNCTION_H
 #define _XMUTIL_SYMBOL_FUNCTION_H
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "../Symbol/Symbol.h"
+#include "Kernel.h"
 #include "State.h"
 
 class Expression;      /* forward declaration */
 class ExpressionList;  // forward
+class ExpressionCode;
+class FunctionPipeline;
+class MacroFunction;
+class SymbolNameSpace;
 class UnitExpression;
+class Variable;
 
 /* abstract class - every function has its own subclass
    defined here with bodies in Function.cpp or in their own
@@ -28,9 +38,16 @@ public:
   virtual bool IsTimeDependent(void) {
     return false;
   }
-  virtual double Eval(Expression *ex, ExpressionList *arg, ContextInfo *info) {
-    return 0;
-  }  // make this pure virtual if finishing engine is required
+  // draws from the run's random stream, so leaving it out changes later draws
+  virtual bool IsRandom(void) {
+    return false;
+  }
+  // functions the simulator does not know flag info and give 0
+  virtual double Eval(Expression *ex, ExpressionList *arg, ContextInfo *info);
+  // false leaves the whole call to Eval
+  virtual bool Compile(ExpressionCode *code, ExpressionList *arg) {
+    return false;
+  }
   virtual bool CheckComputedList(ContextInfo *info, ExpressionList *arg);
   virtual void OutputComputable(ContextInfo *info, ExpressionList *arg);
   virtual std::string ComputableName(void) {
@@ -42,6 +59,12 @@ public:
   virtual bool IsActiveInit() {
     return false;
   }
+  virtual FunctionPipeline *Pipeline(void) {
+    return NULL;
+  }  // but for the delays and smooths the simulator runs
+  virtual MacroFunction *Macro(void) {
+    return NULL;
+  }  // but for a macro's
   int NumberArgs(void) {
     return iNumberArgs;
   }
@@ -71,6 +94,72 @@ private:
   unsigned iActiveArgMark;
 };
 
+/* a builtin that is just math on its arguments - both Eval and the
+   compiled code for it run its entry in Kernels (see Kernel.h), the
+   code for a whole row of elements at once.  The kernel of a function of
+   time takes the time (then TIME STEP, if timeArgs is 2) after the
+   function's arguments */
+class FunctionKernel : public Function {
+public:
+  FunctionKernel(SymbolNameSpace *sns, const std::string &name, int narg, int kernel, int timeArgs = 0)
+      : Function(sns, name, narg) {
+    iKernel = kernel;
+    iTimeArgs = timeArgs;
+  }
+  ~FunctionKernel(void) {
+  }
+  bool IsTimeDependent(void) override {
+    return iTimeArgs > 0;
+  }
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override;
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;
+
+private:
+  int iKernel;
+  int iTimeArgs;
+};
+
+/* a delay or smooth the simulator keeps a StatePipeline for - the input
+   is the first argument and the delay time the second.  The cascade has
+   order stages of delay time / order each, material ones passing on what
+   they hold over that time (DELAY N) and information ones moving toward
+   what is before them (SMOOTH N).  DELAY FIXED instead gives back the
+   input of delay time / TIME STEP steps before */
+class FunctionPipeline : public Function {
+public:
+  enum Kind { Kind_Smooth, Kind_Material, Kind_Fixed };
+  // initarg and orderarg are -1 when the input is the initial value or
+  // the order is always order
+  FunctionPipeline(SymbolNameSpace *sns, const std::string &name, int narg, int kind, int order, int initarg,
+                   int orderarg)
+      : Function(sns, name, narg) {
+    iKind = kind;
+    iOrder = order;
+    iInitArg = initarg;
+    iOrderArg = orderarg;
+  }
+  ~FunctionPipeline(void) {
+  }
+  bool IsMemoryless(void) override {
+    return false;
+  }
+  FunctionPipeline *Pipeline(void) override {
+    return this;
+  }
+  // the stages and ring slots each element needs - left 0 if they can't be
+  // known before the run, as the order (and for DELAY FIXED the delay time
+  // and TIME STEP) has to be a number or a variable set to one
+  void Layout(SymbolNameSpace *sns, ExpressionList *arg, int *stages, int *ring);
+  bool CheckComputedList(ContextInfo *info, ExpressionList *arg) override;
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;
+
+private:
+  int iKind;
+  int iOrder;
+  int iInitArg;
+  int iOrderArg;
+};
+
 class MacroFunction : public Function {
 public:
   class EqUnitPair {
@@ -94,12 +183,84 @@ public:
     return mArgs;
   }
   virtual std::string ComputableName(void);
+  MacroFunction *Macro(void) override {
+    return this;
+  }
+  // readies the body for the simulator, once however many times the macro
+  // is used - false if a use couldn't have copies of its own of what the
+  // body computes (subscripts, a function with memory inside an
+  // expression, an argument used as a lookup) or the body reads a name
+  // main, the name space of the model using it, doesn't have
+  bool Ready(SymbolNameSpace *main);
+  // the variables the body names that a use binds, in the order a
+  // MacroInstance keeps them: the ones it computes, then the arguments,
+  // then those read from the model using it
+  const std::vector<Variable *> &Slots(void) const {
+    return vSlots;
+  }
+  int Slot(Variable *var) const {  // -1 if var is none of them
+    std::unordered_map<Variable *, int>::const_iterator it = mSlots.find(var);
+    return it == mSlots.end() ? -1 : it->second;
+  }
+  int ComputedCount(void) const {  // of the slots, the first this many
+    return iComputed;
+  }
+  int Output(void) const {  // the slot of the variable named for the macro
+    return iOutput;
+  }
+  // the model's own variable for each of the slots read from it, NULL for
+  // the others
+  const std::vector<Variable *> &Reads(void) const {
+    return vReads;
+  }
+  // a use reads the output of its MacroInstance (see Model::MacroOutput)
+  bool CheckComputedList(ContextInfo *info, ExpressionList *arg) override;
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;
 
 private:
   SymbolNameSpace *pSymbolNameSpace;  // local
   MacroFunction(const MacroFunction &other);
   ExpressionList *mArgs;
   std::vector<EqUnitPair> mEquations;
+  std::vector<Variable *> vSlots;
+  std::vector<Variable *> vReads;
+  std::unordered_map<Variable *, int> mSlots;
+  int iComputed;
+  int iOutput;
+  int iReady;  // 0 until Ready is first called, then 1 or -1
+};
+
+/* one use of a macro by a model being simulated - the variable that stands
+   for each of the macro's slots in this use.  Model::AnalyzeEquations
+   gives the use a variable of its own for each the body computes, laid out
+   the same way for every use, and binds each argument to what was passed.
+   While an equation of the body is ordered or compiled for the use the
+   variables it names go through Resolve, so every use shares the one body */
+class MacroInstance {
+public:
+  MacroInstance(MacroFunction *macro) : pMacro(macro), vBound(macro->Reads()) {
+  }
+  MacroFunction *Macro(void) const {
+    return pMacro;
+  }
+  void Bind(int slot, Variable *var) {
+    vBound[slot] = var;
+  }
+  Variable *Resolve(Variable *var) const {
+    int slot = pMacro->Slot(var);
+    return slot < 0 ? var : vBound[slot];
+  }
+  Variable *Output(void) const {
+    return vBound[pMacro->Output()];
+  }
+  int BoundSlot(Variable *var) const {  // the slot var is bound to, -1 if none
+    std::vector<Variable *>::const_iterator it = std::find(vBound.begin(), vBound.end(), var);
+    return it == vBound.end() ? -1 : static_cast<int>(it - vBound.begin());
+  }
+
+private:
+  MacroFunction *pMacro;
+  std::vector<Variable *> vBound;  // by slot
 };
 
 #define FSubclassKeyword(name, xname, narg)                   \
@@ -137,6 +298,33 @@ private:
   }                                         \
   ;
 
+// a math builtin the simulator runs as kernel (see FunctionKernel)
+#define FSubclassKernel(name, xname, narg, cname, kernel)                   \
+  class name : public FunctionKernel {                                      \
+  public:                                                                   \
+    name(SymbolNameSpace *sns) : FunctionKernel(sns, xname, narg, kernel) { \
+    }                                                                       \
+    ~name(void) {                                                           \
+    }                                                                       \
+    std::string ComputableName(void) {                                      \
+      return cname;                                                         \
+    }                                                                       \
+  };
+
+// a random function - it gives a new number each time it is evaluated,
+// so whatever uses it is computed every step
+#define FSubclassRandom(name, xname, narg, cname)                                 \
+  FSubclassStart(name, xname, narg, cname)                                        \
+public:                                                                           \
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override; \
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;               \
+  bool CheckComputedList(ContextInfo *info, ExpressionList *arg) override;        \
+  bool IsRandom(void) override {                                                  \
+    return true;                                                                  \
+  }                                                                               \
+  }                                                                               \
+  ;
+
 #define FSubclassMemoryStart(name, xname, narg, actarg, iniarg, cnamea, cnamei)         \
   class name : public FunctionMemoryBase {                                              \
   public:                                                                               \
@@ -158,6 +346,33 @@ private:
   }                                                                        \
   ;
 
+#define FSubclassMemoryEval(name, xname, narg, actarg, iniarg, cnamea, cnamei)    \
+  FSubclassMemoryStart(name, xname, narg, actarg, iniarg, cnamea, cnamei)         \
+public:                                                                           \
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override; \
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;               \
+  }                                                                               \
+  ;
+
+// a delay or smooth the simulator runs (see FunctionPipeline)
+#define FSubclassPipelineStart(name, xname, narg, cname, kind, order, initarg, orderarg)              \
+  class name : public FunctionPipeline {                                                              \
+  public:                                                                                             \
+    name(SymbolNameSpace *sns) : FunctionPipeline(sns, xname, narg, kind, order, initarg, orderarg) { \
+    }                                                                                                 \
+    ~name(void) {                                                                                     \
+    }                                                                                                 \
+    std::string ComputableName(void) override {                                                       \
+      return cname;                                                                                   \
+    }                                                                                                 \
+                                                                                                      \
+  private:
+
+#define FSubclassPipeline(name, xname, narg, cname, kind, order, initarg, orderarg) \
+  FSubclassPipelineStart(name, xname, narg, cname, kind, order, initarg, orderarg)  \
+  }                                                                                 \
+  ;
+
 #define FSubclassTimeStart(name, xname, narg, cname)          \
   class name : public Function {                              \
   public:                                                     \
@@ -175,77 +390,114 @@ private:
                                                               \
   private:
 
+// a function of time the simulator runs as a kernel
+#define FSubclassTimeKernel(name, xname, narg, cname, kernel, timeargs)                \
+  class name : public FunctionKernel {                                                 \
+  public:                                                                              \
+    name(SymbolNameSpace *sns) : FunctionKernel(sns, xname, narg, kernel, timeargs) { \
+    }                                                                                  \
+    ~name(void) {                                                                      \
+    }                                                                                  \
+    std::string ComputableName(void) {                                                 \
+      return cname;                                                                    \
+    }                                                                                  \
+  };
+
 #define FSubclassTime(name, xname, narg, cname) \
   FSubclassTimeStart(name, xname, narg, cname)  \
   }                                             \
   ;
 
-FSubclass(FunctionAbs, "ABS", 1, "ABS") FSubclass(FunctionExp, "EXP", 1, "EXP")
-    FSubclass(FunctionSqrt, "SQRT", 1, "SQRT")
-
-        FSubclass(FunctionCosine, "COS", 1, "COS") FSubclass(FunctionTangent, "TAN", 1, "TAN")
-            FSubclass(FunctionSine, "SIN", 1, "SIN") FSubclass(FunctionArcCosine, "ARCCOS", 1, "ARCCOS")
-                FSubclass(FunctionArcSine, "ARCSIN", 1, "ARCSIN") FSubclass(FunctionArcTangent, "ARCTAN", 1, "ARCTAN")
-                    FSubclass(FunctionInterger, "INTEGER", 1, "INT")
+// GET DIRECT DATA and the functions of the data it gives - simulated from
+// what has been added to DataStore::Global() under the file name
+#define FSubclassData(name, xname, narg, cname)                                   \
+  FSubclassTimeStart(name, xname, narg, cname)                                    \
+public:                                                                           \
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override; \
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;               \
+  }                                                                               \
+  ;
 
-                        FSubclass(FunctionMax, "MAX", 2, "MAX") FSubclass(FunctionMin, "MIN", 2, "MIN")
-                            FSubclass(FunctionZidz, "ZIDZ", 2, "SAFEDIV") FSubclass(FunctionXidz, "XIDZ", 3, "SAFEDIV")
-                                FSubclass(FunctionWithLookup, "WITH LOOKUP", 3, "WITH_LOOKUP")
-                                    FSubclass(FunctionSum, "SUM", 1, "SUM");
+FSubclassKernel(FunctionAbs, "ABS", 1, "ABS", Kernel_Abs);
+FSubclassKernel(FunctionExp, "EXP", 1, "EXP", Kernel_Exp);
+FSubclassKernel(FunctionSqrt, "SQRT", 1, "SQRT", Kernel_Sqrt);
+FSubclassKernel(FunctionCosine, "COS", 1, "COS", Kernel_Cosine);
+FSubclassKernel(FunctionTangent, "TAN", 1, "TAN", Kernel_Tangent);
+FSubclassKernel(FunctionSine, "SIN", 1, "SIN", Kernel_Sine);
+FSubclassKernel(FunctionArcCosine, "ARCCOS", 1, "ARCCOS", Kernel_ArcCosine);
+FSubclassKernel(FunctionArcSine, "ARCSIN", 1, "ARCSIN", Kernel_ArcSine);
+FSubclassKernel(FunctionArcTangent, "ARCTAN", 1, "ARCTAN", Kernel_ArcTangent);
+FSubclassKernel(FunctionInterger, "INTEGER", 1, "INT", Kernel_Integer);
+FSubclassKernel(FunctionMax, "MAX", 2, "MAX", Kernel_Max);
+FSubclassKernel(FunctionMin, "MIN", 2, "MIN", Kernel_Min);
+FSubclassKernel(FunctionZidz, "ZIDZ", 2, "SAFEDIV", Kernel_Zidz);
+FSubclassKernel(FunctionXidz, "XIDZ", 3, "SAFEDIV", Kernel_Xidz);
+FSubclassKernel(FunctionModulo, "MODULO", 2, "MODULO", Kernel_Modulo);
+FSubclassKernel(FunctionLn, "LN", 1, "LN", Kernel_Ln);
+
+FSubclass(FunctionWithLookup, "WITH LOOKUP", 3, "WITH_LOOKUP");
+FSubclass(FunctionSum, "SUM", 1, "SUM");
 FSubclass(FunctionProd, "PROD", 1, "PROD");
 FSubclass(FunctionVectorSelect, "VECTOR SELECT", 5, "VECTOR SELECT");
 FSubclass(FunctionVectorElmMap, "VECTOR ELM MAP", 2, "VECTOR ELM MAP");
 FSubclass(FunctionVectorSortOrder, "VECTOR SORT ORDER", 2, "VECTOR SORT ORDER");
 FSubclass(FunctionGame, "GAME", 1, "");  // don't need this
-FSubclass(FunctionRandom01, "RANDOM 0 1", 0, "UNIFORM(0,1)");
-FSubclass(FunctionRandomUniform, "RANDOM UNIFORM", 3, "UNIFORM");
+FSubclassRandom(FunctionRandom01, "RANDOM 0 1", 0, "UNIFORM(0,1)");
+FSubclassRandom(FunctionRandomUniform, "RANDOM UNIFORM", 3, "UNIFORM");
 
 // actually memory but no init - or init - does not matter for translation
-FSubclass(FunctionSmooth, "SMOOTH", 2, "SMTH1") FSubclass(FunctionSmoothI, "SMOOTHI", 3, "SMTH1")
-    FSubclass(FunctionSmooth3, "SMOOTH3", 2, "SMTH3") FSubclass(FunctionTrend, "TREND", 3, "TREND")
-        FSubclass(FunctionDelay1, "DELAY1", 2, "DELAY1") FSubclass(FunctionDelay1I, "DELAY1I", 3, "DELAY1")
-            FSubclass(FunctionDelay3, "DELAY3", 2, "DELAY3") FSubclass(FunctionDelay3I, "DELAY3I", 3, "DELAY3")
-                FSubclass(FunctionDelay, "DELAY FIXED", 3, "DELAY") FSubclass(FunctionNPV, "NPV", 4, "NPV")
+FSubclassPipeline(FunctionSmooth, "SMOOTH", 2, "SMTH1", FunctionPipeline::Kind_Smooth, 1, -1, -1);
+FSubclassPipeline(FunctionSmoothI, "SMOOTHI", 3, "SMTH1", FunctionPipeline::Kind_Smooth, 1, 2, -1);
+FSubclassPipeline(FunctionSmooth3, "SMOOTH3", 2, "SMTH3", FunctionPipeline::Kind_Smooth, 3, -1, -1);
+FSubclass(FunctionTrend, "TREND", 3, "TREND");
+FSubclassPipeline(FunctionDelay1, "DELAY1", 2, "DELAY1", FunctionPipeline::Kind_Material, 1, -1, -1);
+FSubclassPipeline(FunctionDelay1I, "DELAY1I", 3, "DELAY1", FunctionPipeline::Kind_Material, 1, 2, -1);
+FSubclassPipeline(FunctionDelay3, "DELAY3", 2, "DELAY3", FunctionPipeline::Kind_Material, 3, -1, -1);
+FSubclassPipeline(FunctionDelay3I, "DELAY3I", 3, "DELAY3", FunctionPipeline::Kind_Material, 3, 2, -1);
+FSubclassPipeline(FunctionDelay, "DELAY FIXED", 3, "DELAY", FunctionPipeline::Kind_Fixed, 0, 2, -1);
+FSubclass(FunctionNPV, "NPV", 4, "NPV")
 
     // done as macros
     FSubclass(FunctionDelayConveyor, "DELAY CONVEYOR", 6, "DELAY_CONVEYOR")
     // - this one is fake - return NaN
     FSubclass(FunctionVectorReorder, "VECTOR REORDER", 2, "VECTOR_REORDER")
-        FSubclass(FunctionModulo, "MODULO", 2, "MODULO") FSubclass(FunctionGetDataAtTime, "GET DATA AT TIME", 2,
-                                                                   "GET_DATA_AT_TIME")
-            FSubclass(FunctionGetDataLastTime, "GET DATA LAST TIME", 1, "GET_DATA_LAST_TIME")
-                FSubclass(FunctionLookupArea, "LOOKUP AREA", 3, "LOOKUP_AREA")
+            FSubclassData(FunctionGetDataAtTime, "GET DATA AT TIME", 2, "GET_DATA_AT_TIME")
+                FSubclassData(FunctionGetDataLastTime, "GET DATA LAST TIME", 1, "GET_DATA_LAST_TIME")
+                    FSubclass(FunctionLookupArea, "LOOKUP AREA", 3, "LOOKUP_AREA")
                     FSubclass(FunctionLookupExtrapolate, "LOOKUP EXTRAPOLATE", 2, "LOOKUP")  // changes the graphical
     FSubclassStart(FunctionTimeBase, "TIME BASE", 2, "TIME_BASE") virtual void OutputComputable(ContextInfo *info,
                                                                                                 ExpressionList *arg);
 }
 ;
 
-FSubclassStart(FunctionDelayN, "DELAY N", 4, "DELAYN") public
+FSubclassPipelineStart(FunctionDelayN, "DELAY N", 4, "DELAYN", FunctionPipeline::Kind_Material, 0, 2, 3) public
     : virtual void OutputComputable(ContextInfo *info, ExpressionList *arg);
 }
 ;
-FSubclassStart(FunctionSmoothN, "SMOOTH N", 4, "SMTHN") public
+FSubclassPipelineStart(FunctionSmoothN, "SMOOTH N", 4, "SMTHN", FunctionPipeline::Kind_Smooth, 0, 2, 3) public
     : virtual void OutputComputable(ContextInfo *info, ExpressionList *arg);
 }
 ;
 
-FSubclassMemory(FunctionInteg, "INTEG", 2, 0b10, 0b01, "integ_active", "integ_init")
+FSubclassMemoryEval(FunctionInteg, "INTEG", 2, 0b10, 0b01, "integ_active", "integ_init")
     FSubclassMemoryStart(FunctionActiveInitial, "ACTIVE INITIAL", 2, 0b10, 0b01, "ai_active",
                          "ai_init") virtual bool IsActiveInit() override {
   return true;
 }
+double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override;
+bool Compile(ExpressionCode *code, ExpressionList *arg) override;
 }
 ;
 FSubclass(FunctionInitial, "INITIAL", 1, "INIT") FSubclass(FunctionReInitial, "REINITIAL", 1, "INIT")
 
-    FSubclassTime(FunctionRamp, "RAMP", 3, "RAMP") FSubclass(FunctionLn, "LN", 1, "LN")
-        FSubclassTime(FunctionPulse, "PULSE", 2, "pulse") FSubclassTime(FunctionStep, "STEP", 2, "step")
+    FSubclassTimeKernel(FunctionRamp, "RAMP", 3, "RAMP", Kernel_Ramp, 1)
+        FSubclassTimeKernel(FunctionPulse, "PULSE", 2, "pulse", Kernel_Pulse, 2)
+            FSubclassTimeKernel(FunctionStep, "STEP", 2, "step", Kernel_Step, 2)
 
             FSubclassKeyword(FunctionTabbedArray, "TABBED ARRAY", 1)
 
     // functions that will never translate - but easier to catch error on other side
-    FSubclass(FunctionGetDirectData, "GET DIRECT DATA", 4, "GET_DIRECT_DATA")
+    FSubclassData(FunctionGetDirectData, "GET DIRECT DATA", 4, "GET_DIRECT_DATA")
         FSubclass(FunctionGetDataMean, "GET DATA MEAN", 3, "GET_DATA_MEAN")
 
     /*
@@ -310,6 +562,12 @@ public:
     return "RandomNormal";
   }
   virtual void OutputComputable(ContextInfo *info, ExpressionList *arg);
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override;
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;
+  bool CheckComputedList(ContextInfo *info, ExpressionList *arg) override;
+  bool IsRandom(void) override {
+    return true;
+  }
 
 private:
 };
@@ -324,6 +582,12 @@ public:
     return "RandomPoisson";
   }
   virtual void OutputComputable(ContextInfo *info, ExpressionList *arg);
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override;
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;
+  bool CheckComputedList(ContextInfo *info, ExpressionList *arg) override;
+  bool IsRandom(void) override {
+    return true;
+  }
 
 private:
 };
@@ -338,14 +602,16 @@ public:
   std::string ComputableName(void) {
     return "IF";
   }
+  double Eval(Expression *from, ExpressionList *arg, ContextInfo *info) override;
+  bool Compile(ExpressionCode *code, ExpressionList *arg) override;
   virtual void OutputComputable(ContextInfo *info, ExpressionList *arg);
 
 private:
 };
 
-class FunctionLog : public Function {
+class FunctionLog : public FunctionKernel {
 public:
-  FunctionLog(SymbolNameSpace *sns) : Function(sns, "LOG", 2) {
+  FunctionLog(SymbolNameSpace *sns) : FunctionKernel(sns, "LOG", 2, Kernel_Log) {
     ;
   }
   ~FunctionLog(void) {
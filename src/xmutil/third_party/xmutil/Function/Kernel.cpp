@@ -0,0 +1,100 @@
+#include "Kernel.h"
+
+#include <cmath>
+
+// a kernel of one argument - the row is replaced in place
+#define KERNEL1(name, expr)                   \
+  static void name(double *rows, int width) { \
+    for (int i = 0; i < width; i++) {         \
+      double a = rows[i];                     \
+      rows[i] = expr;                         \
+    }                                         \
+  }
+
+// and of two, the result going over the first
+#define KERNEL2(name, expr)                   \
+  static void name(double *rows, int width) { \
+    const double *second = rows + width;      \
+    for (int i = 0; i < width; i++) {         \
+      double a = rows[i];                     \
+      double b = second[i];                   \
+      rows[i] = expr;                         \
+    }                                         \
+  }
+
+KERNEL1(RunAbs, std::fabs(a))
+KERNEL1(RunExp, std::exp(a))
+KERNEL1(RunSqrt, std::sqrt(a))
+KERNEL1(RunCosine, std::cos(a))
+KERNEL1(RunTangent, std::tan(a))
+KERNEL1(RunSine, std::sin(a))
+KERNEL1(RunArcCosine, std::acos(a))
+KERNEL1(RunArcSine, std::asin(a))
+KERNEL1(RunArcTangent, std::atan(a))
+KERNEL1(RunInteger, std::trunc(a))
+KERNEL1(RunLn, std::log(a))
+KERNEL2(RunLog, std::log(a) / std::log(b))
+KERNEL2(RunMax, a > b ? a : b)
+KERNEL2(RunMin, a < b ? a : b)
+KERNEL2(RunZidz, b == 0 ? 0 : a / b)
+KERNEL2(RunModulo, a - b * std::floor(a / b))  // the sign of the divisor as in Vensim
+
+static void RunXidz(double *rows, int width) {
+  const double *second = rows + width;
+  const double *third = second + width;
+  for (int i = 0; i < width; i++)
+    rows[i] = second[i] == 0 ? third[i] : rows[i] / second[i];
+}
+
+// the height once the time is past the start, within half a step
+static void RunStep(double *rows, int width) {
+  const double *start = rows + width;
+  const double *time = start + width;
+  const double *dt = time + width;
+  for (int i = 0; i < width; i++)
+    rows[i] = time[i] + dt[i] / 2 > start[i] ? rows[i] : 0;
+}
+
+// 1 from the start for the width, which is at least a step
+static void RunPulse(double *rows, int width) {
+  const double *length = rows + width;
+  const double *time = length + width;
+  const double *dt = time + width;
+  for (int i = 0; i < width; i++) {
+    double w = length[i] < dt[i] ? dt[i] : length[i];
+    rows[i] = time[i] > rows[i] - dt[i] / 4 && time[i] < rows[i] + w - dt[i] / 4 ? 1 : 0;
+  }
+}
+
+// the slope times how far the time, held at the end, is past the start
+static void RunRamp(double *rows, int width) {
+  const double *start = rows + width;
+  const double *end = start + width;
+  const double *time = end + width;
+  for (int i = 0; i < width; i++)
+    rows[i] = time[i] <= start[i] ? 0 : rows[i] * ((time[i] > end[i] ? end[i] : time[i]) - start[i]);
+}
+
+// indexed by Kernel
+const KernelInfo Kernels[Kernel_Count] = {
+    {1, RunAbs, "fabs(a)"},
+    {1, RunExp, "exp(a)"},
+    {1, RunSqrt, "sqrt(a)"},
+    {1, RunCosine, "cos(a)"},
+    {1, RunTangent, "tan(a)"},
+    {1, RunSine, "sin(a)"},
+    {1, RunArcCosine, "acos(a)"},
+    {1, RunArcSine, "asin(a)"},
+    {1, RunArcTangent, "atan(a)"},
+    {1, RunInteger, "trunc(a)"},
+    {1, RunLn, "log(a)"},
+    {2, RunLog, "log(a) / log(b)"},
+    {2, RunMax, "a > b ? a : b"},
+    {2, RunMin, "a < b ? a : b"},
+    {2, RunZidz, "b == 0 ? 0 : a / b"},
+    {3, RunXidz, "b == 0 ? c : a / b"},
+    {2, RunModulo, "a - b * floor(a / b)"},
+    {4, RunStep, "c + d / 2 > b ? a : 0"},
+    {4, RunPulse, "c > a - d / 4 && c < a + (b < d ? d : b) - d / 4 ? 1 : 0"},
+    {4, RunRamp, "d <= b ? 0 : a * ((d > c ? c : d) - b)"},
+};
@@ -0,0 +1,56 @@
+#ifndef _XMUTIL_FUNCTION_KERNEL_H
+#define _XMUTIL_FUNCTION_KERNEL_H
+
+/* the builtins that are pure math, each as a kernel working on rows of
+   its arguments - the simulator's code calls one for a whole arrayed
+   equation (OP_CALL), and the function's own Eval calls the same one with
+   rows of a single value, so the two can't give different results
+
+   a kernel is given its arguments' rows one after another in rows, each
+   width long, and leaves the result in the first.  The table is indexed
+   by Kernel_ and filled in at compile time
+
+   each kernel is a plain loop with no calls through pointers in it, so
+   the ones without library calls (ABS, MIN, MAX, ZIDZ and the like)
+   vectorize; the others call the same <cmath> functions Eval always has
+   element by element, as an approximation done a vector at a time would
+   change the numbers
+
+   STEP, PULSE and RAMP are kernels too, given the time of the run (and
+   for the first two TIME STEP) after their own arguments */
+
+#define KERNEL_MAX_ARGS 4  // the most any kernel takes
+
+enum Kernel {
+  Kernel_Abs,
+  Kernel_Exp,
+  Kernel_Sqrt,
+  Kernel_Cosine,
+  Kernel_Tangent,
+  Kernel_Sine,
+  Kernel_ArcCosine,
+  Kernel_ArcSine,
+  Kernel_ArcTangent,
+  Kernel_Integer,
+  Kernel_Ln,
+  Kernel_Log,
+  Kernel_Max,
+  Kernel_Min,
+  Kernel_Zidz,
+  Kernel_Xidz,
+  Kernel_Modulo,
+  Kernel_Step,
+  Kernel_Pulse,
+  Kernel_Ramp,
+  Kernel_Count
+};
+
+struct KernelInfo {
+  int args;
+  void (*run)(double *rows, int width);
+  const char *source;  // the same for one element as a C expression of a, b, c and d
+};
+
+extern const KernelInfo Kernels[Kernel_Count];
+
+#endif
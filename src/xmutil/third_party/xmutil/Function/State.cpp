@@ -6,7 +6,6 @@
 State::State(SymbolNameSpace *sns) : SymbolTableBase(sns) {
   pVals = NULL;
   iNVals = 0;
-  cComputeFlag = 0;
   cDynamicDependencyFlag = 0;
   cSparse = 0;
 }
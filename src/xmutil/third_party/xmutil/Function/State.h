@@ -8,6 +8,7 @@
 #include "../Symbol/SymbolTableBase.h"
 
 class Variable;
+class StatePipeline;
 
 /* state - contains information about the value of either explicit
    or implicit variables such as those associated with functions with
@@ -27,12 +28,27 @@ public:
     return true;
   }  // but false for STEP...
   inline int SetStateVec(double *p);
-  inline void ClearComputeFlag(void) {
-    cComputeFlag = 0;
-  }
   inline double GetValue(int off) {
     return pVals[off];
   }
+  double *GetValueP(void) {
+    return pVals;
+  }
+  int ValueCount(void) const {  // how many values from GetValueP - more than 1 for arrays
+    return iNVals;
+  }
+  unsigned char DynamicDependency(void) {
+    return cDynamicDependencyFlag;
+  }  // DDF_ flags found while ordering the active equations
+  void SetDynamicDependency(unsigned char ddf) {
+    cDynamicDependencyFlag = ddf;
+  }
+  virtual double *GetRateP(void) {
+    return NULL;
+  }  // but the rates for levels
+  virtual StatePipeline *Pipeline(void) {
+    return NULL;
+  }  // but for delays and smooths
   inline void SetInitialValue(int off, double val) {
     pVals[off] = val;
   }
@@ -50,7 +66,6 @@ public:
 private:
   double *pVals;  // this will be allocated from a global pool to facilitate variable step size integration
   int iNVals;     // actual number in pVals - might be sparse for an array
-  unsigned short cComputeFlag;           // used in equation ordering for unnamed state variables
   unsigned char cDynamicDependencyFlag;  // see context info
   unsigned char cSparse;                 // special value lookup required
 };
@@ -70,6 +85,9 @@ public:
   void SetRateP(double *p) {
     pRates = p;
   }
+  double *GetRateP(void) {
+    return pRates;
+  }
 
 private:
   double *pRates;
@@ -87,6 +105,49 @@ public:
 private:
 };
 
+/* the state of a delay or smooth - the value is its output, kept with the
+   auxiliaries, while what is in transit sits in blocks of its own taken
+   from the same pools: a cascade of stages integrated with the levels
+   (DELAY N, SMOOTH N and the fixed order versions) or for DELAY FIXED a
+   ring of the inputs over the delay then the slot the next one goes in.
+   Each stage, or ring slot, holds a value per element */
+class StatePipeline : public State {
+public:
+  StatePipeline(SymbolNameSpace *sns, int stages, int ring) : State(sns) {
+    iStageCount = stages;
+    iRingLength = ring;
+    pStages = pStageRates = pRing = NULL;
+  }
+  ~StatePipeline(void) {
+  }
+  friend class VariableContentVar;
+  StatePipeline *Pipeline(void) {
+    return this;
+  }
+  int StageCount(void) const {  // 0 for DELAY FIXED or sizes not known before the run
+    return iStageCount;
+  }
+  int RingLength(void) const {
+    return iRingLength;
+  }
+  double *GetStagesP(void) {
+    return pStages;
+  }
+  double *GetStageRatesP(void) {
+    return pStageRates;
+  }
+  double *GetRingP(void) {
+    return pRing;
+  }
+
+private:
+  double *pStages;  // in the level pool
+  double *pStageRates;
+  double *pRing;  // in the aux pool
+  int iStageCount;
+  int iRingLength;
+};
+
 class StateSubscriptRange : public State {
   StateSubscriptRange(SymbolNameSpace *sns) : State(sns) {
   }
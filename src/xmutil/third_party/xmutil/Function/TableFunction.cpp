@@ -2,6 +2,7 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "../Symbol/Expression.h"
@@ -15,26 +16,50 @@ TableFunction::~TableFunction(void) {
 }
 
 double TableFunction::Eval(ExpressionVariable *v, Expression *e, ContextInfo *info) {
-  double d = e->Eval(info);
-  ExpressionTable *et;
+  return GetTable(v)->Lookup(e->Eval(info));
+}
 
-  et = static_cast<ExpressionTable *>(v->GetVariable()->GetEquation(0)->GetExpression());
+ExpressionTable *TableFunction::GetTable(ExpressionVariable *v) {
+  ExpressionTable *et = static_cast<ExpressionTable *>(v->GetVariable()->GetEquation(0)->GetExpression());
   assert(et->GetType() == EXPTYPE_Table);
-  double *x = et->GetXVals()->data();
-  double *y = et->GetYVals()->data();
-  int n = et->GetXVals()->size();
-  assert(n == et->GetYVals()->size());
+  return et;
+}
+
+// the last i with x[i] <= d, for x[0] < d < x[n - 1]
+size_t TableFunction::Segment(const double *x, size_t n, double d, size_t *hint) {
+  if (hint) {
+    size_t i = *hint;
+    if (i + 1 < n && x[i] <= d) {
+      if (d < x[i + 1])
+        return i;
+      if (i + 2 < n && d < x[i + 2])
+        return *hint = i + 1;
+    }
+  }
+  size_t i;
+  if (n <= TABLE_LINEAR_MAX) {
+    i = 0;
+    for (size_t j = 1; j < n; j++)
+      i += x[j] <= d;
+  } else
+    i = std::upper_bound(x + 1, x + n, d) - x - 1;
+  if (hint)
+    *hint = i;
+  return i;
+}
+
+double TableFunction::Lookup(const double *x, const double *y, size_t n, double d, size_t *hint) {
+  assert(n);
   if (d <= x[0])
     return y[0];
   if (d >= x[n - 1])
     return y[n - 1];
-  for (int i = 0; i < n; i++) {
-    if (d >= x[i]) {
-      while (d >= x[i + 1])
-        i++;  // in case
-      return y[i] + (y[i + 1] - y[i]) * (d - x[i]) / (x[i + 1] - x[i]);
-    }
-  }
-  assert(0);
-  return FLT_MAX;
-}
\ No newline at end of file
+  size_t i = Segment(x, n, d, hint);
+  return y[i] + (y[i + 1] - y[i]) * (d - x[i]) / (x[i + 1] - x[i]);
+}
+
+void TableFunction::Lookup(const double *x, const double *y, size_t n, const double *d, double *out, size_t count) {
+  size_t hint = 0;
+  for (size_t k = 0; k < count; k++)
+    out[k] = Lookup(x, y, n, d[k], &hint);
+}
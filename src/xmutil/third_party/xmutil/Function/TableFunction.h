@@ -1,8 +1,11 @@
 #ifndef _XMUTIL_TABLEFUNCTION_H
 #define _XMUTIL_TABLEFUNCTION_H
 
+#include <stddef.h>
+
 class Expression;
 class ExpressionVariable;
+class ExpressionTable;
 class ContextInfo;
 
 /* table or lookup functions are used implicitly and are therefore not derived from
@@ -10,12 +13,27 @@ class ContextInfo;
    nor is it derived from State
 
    first pass this is never instantiated - only eval is ever called
+
+   the x values must be nondecreasing.  Short tables are searched with a
+   branch free count (which the compiler can vectorize) and long ones with a
+   binary search, and a hint remembers the last segment used since inputs
+   like Time move through a table in order
    */
+#define TABLE_LINEAR_MAX 16  // tables with more points than this use a binary search
+
 class TableFunction {
 public:
   TableFunction(void);
   ~TableFunction(void);
   static double Eval(ExpressionVariable *v, Expression *e, ContextInfo *info);
+  static ExpressionTable *GetTable(ExpressionVariable *v);  // the table a lookup variable holds
+  // interpolate d in the n points x,y - hint may be NULL
+  static double Lookup(const double *x, const double *y, size_t n, double d, size_t *hint);
+  // the same for count inputs at once, as for an arrayed lookup
+  static void Lookup(const double *x, const double *y, size_t n, const double *d, double *out, size_t count);
+
+private:
+  static size_t Segment(const double *x, size_t n, double d, size_t *hint);
 };
 
 #endif
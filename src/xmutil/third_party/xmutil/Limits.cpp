@@ -0,0 +1,66 @@
+#include "Limits.h"
+
+thread_local ConversionLimits *ConversionLimits::tCurrent = NULL;
+
+// how many times Reached has been asked on the thread since it last read
+// the clock
+static thread_local unsigned tCalls = 0;
+
+ConversionLimits::ConversionLimits(const XMUtilLimits *limits)
+    : pCancel(limits ? limits->cancel : NULL), bDeadline(limits && limits->seconds > 0),
+      iBudget(limits ? limits->memoryBytes : 0), iBytes(0), iStatus(XMUTIL_OK) {
+  if (bDeadline) {
+    std::chrono::duration<double> seconds(limits->seconds);
+    tDeadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::nanoseconds>(seconds);
+  }
+}
+
+bool ConversionLimits::Reached(void) {
+  if (Status() != XMUTIL_OK)
+    return true;
+  if (pCancel && __atomic_load_n(pCancel, __ATOMIC_RELAXED)) {
+    Hit(XMUTIL_ERROR_CANCELLED);
+    return true;
+  }
+  if (bDeadline && ++tCalls >= LIMITS_CLOCK_CALLS) {
+    tCalls = 0;
+    if (std::chrono::steady_clock::now() >= tDeadline) {
+      Hit(XMUTIL_ERROR_DEADLINE);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ConversionLimits::Add(size_t bytes) {
+  uint64_t total = iBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  if (iBudget && total > iBudget)
+    Hit(XMUTIL_ERROR_MEMORY);
+}
+
+// the first limit hit is the one reported
+void ConversionLimits::Hit(int status) {
+  int ok = XMUTIL_OK;
+  iStatus.compare_exchange_strong(ok, status, std::memory_order_relaxed);
+}
+
+std::string ConversionLimits::Describe(void) const {
+  switch (Status()) {
+  case XMUTIL_ERROR_CANCELLED:
+    return "the conversion was cancelled";
+  case XMUTIL_ERROR_DEADLINE:
+    return "the conversion ran out of time";
+  case XMUTIL_ERROR_MEMORY:
+    return "the conversion needed more than " + std::to_string(iBudget) + " bytes for the model";
+  default:
+    return std::string();
+  }
+}
+
+ConversionLimits::Scope::Scope(ConversionLimits *limits) : pPrevious(tCurrent) {
+  tCurrent = limits;
+}
+
+ConversionLimits::Scope::~Scope(void) {
+  tCurrent = pPrevious;
+}
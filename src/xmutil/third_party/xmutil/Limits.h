@@ -0,0 +1,71 @@
+#ifndef _XMUTIL_LIMITS_H
+#define _XMUTIL_LIMITS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "XMUtil.h"
+
+/* ConversionLimits - the cancel flag, deadline and memory budget behind
+   _convert_mdl_to_xmile_limited
+
+   while a ConversionLimits::Scope is active on a thread Stop() says
+   whether the conversion should give up - the lexer, the loop reading
+   equations, AttachStragglers and the generators ask it as they go and
+   wind down early, leaving ConvertMdl to hand back Status().  Outside of
+   a scope it costs a thread local load and a test.  The clock is only
+   read every LIMITS_CLOCK_CALLS asks on a thread
+
+   the memory counted is the blocks the model's arena takes - so the budget
+   is kept to within a block, and what the XMILE itself takes isn't part
+   of it.  Once a limit is hit Stop() stays true, from any thread */
+#define LIMITS_CLOCK_CALLS 256
+class ConversionLimits {
+public:
+  ConversionLimits(const XMUtilLimits *limits);  // NULL for none
+
+  static ConversionLimits *Current(void) {
+    return tCurrent;
+  }
+  static bool Stop(void) {
+    ConversionLimits *limits = tCurrent;
+    return limits && limits->Reached();
+  }
+  // from the arena as it takes another block
+  static void Allocated(size_t bytes) {
+    if (ConversionLimits *limits = tCurrent)
+      limits->Add(bytes);
+  }
+  bool Reached(void);
+  // XMUTIL_OK or the XMUTIL_ERROR_ for the limit that was hit
+  int Status(void) const {
+    return iStatus.load(std::memory_order_relaxed);
+  }
+  std::string Describe(void) const;
+
+  // threads helping with a conversion take a Scope on its limits too
+  class Scope {
+  public:
+    Scope(ConversionLimits *limits);
+    ~Scope(void);
+
+  private:
+    ConversionLimits *pPrevious;
+  };
+
+private:
+  void Add(size_t bytes);
+  void Hit(int status);
+  const int32_t *pCancel;
+  bool bDeadline;
+  std::chrono::steady_clock::time_point tDeadline;
+  uint64_t iBudget;  // 0 for none
+  std::atomic<uint64_t> iBytes;
+  std::atomic<int> iStatus;
+  static thread_local ConversionLimits *tCurrent;
+};
+
+#endif
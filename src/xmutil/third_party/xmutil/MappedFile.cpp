@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define XMUTIL_MAP_WIN32
+#include <windows.h>
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__wasm__)
+#define XMUTIL_MAP_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile(void) {
+#if defined(XMUTIL_MAP_POSIX)
+  if (pMapping)
+    munmap(const_cast<char *>(pMapping), iLength);
+#elif defined(XMUTIL_MAP_WIN32)
+  if (pMapping)
+    UnmapViewOfFile(pMapping);
+#endif
+}
+
+bool MappedFile::Open(const char *path) {
+#if defined(XMUTIL_MAP_POSIX)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    sError = std::string("unable to open ") + path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      close(fd);
+      madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+      pMapping = static_cast<const char *>(mapping);
+      iLength = st.st_size;
+      return true;
+    }
+  }
+  close(fd);  // empty, or not a regular file (a pipe say) - read it instead
+#elif defined(XMUTIL_MAP_WIN32)
+  HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  LARGE_INTEGER size;
+  if (handle != INVALID_HANDLE_VALUE && GetFileSizeEx(handle, &size) && size.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);  // the view keeps the mapping alive
+      if (view) {
+        CloseHandle(handle);
+        pMapping = static_cast<const char *>(view);
+        iLength = static_cast<size_t>(size.QuadPart);
+        return true;
+      }
+    }
+  }
+  if (handle != INVALID_HANDLE_VALUE)
+    CloseHandle(handle);
+#endif
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    sError = std::string("unable to open ") + path + ": " + strerror(errno);
+    return false;
+  }
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+    sContents.append(buf, n);
+  bool failed = ferror(file) != 0;
+  fclose(file);
+  if (failed) {
+    sError = std::string("unable to read ") + path;
+    return false;
+  }
+  iLength = sContents.size();
+  return true;
+}
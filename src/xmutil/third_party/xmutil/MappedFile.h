@@ -0,0 +1,41 @@
+#ifndef _XMUTIL_MAPPEDFILE_H
+#define _XMUTIL_MAPPEDFILE_H
+#include <stddef.h>
+
+#include <string>
+
+/* MappedFile - the contents of a file, read only, for converting straight
+   from disk
+
+   where the platform allows the file is mapped into memory rather than
+   read, so the pages are shared with the OS file cache instead of being
+   copied into a second buffer, and the mapping is marked for sequential
+   access as the lexer goes through it once from the start.  Elsewhere
+   (wasm) it is read into memory the ordinary way */
+class MappedFile {
+public:
+  MappedFile(void) : pMapping(NULL), iLength(0) {
+  }
+  ~MappedFile(void);
+  // false (with Error() saying why) if the file can't be read
+  bool Open(const char *path);
+  const char *Data(void) const {
+    return pMapping ? pMapping : sContents.data();
+  }
+  size_t Length(void) const {
+    return iLength;
+  }
+  const std::string &Error(void) const {
+    return sError;
+  }
+
+private:
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  const char *pMapping;  // NULL if the file was read into sContents instead
+  size_t iLength;
+  std::string sContents;
+  std::string sError;
+};
+
+#endif
@@ -1,20 +1,51 @@
 #include "Model.h"
 
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
 #include <vector>
 
 #include "Symbol/Equation.h"
+#include "Limits.h"
+#include "Symbol/ExpressionCode.h"
+#include "Symbol/ExpressionList.h"
 #include "Symbol/LeftHandSide.h"
 #include "Symbol/Symbol.h"
 #include "XMUtil.h"
 #include "Xmile/XMILEGenerator.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
 Model::Model(void) {
   dLevel = dRate = dAux = NULL;
+  iNLevel = iNAux = 0;
   iIntegrationType = Integration_Type_EULER;
 }
 
 Model::~Model(void) {
   // allocation is no longer clean ClearCompEquations() ;
+  // instead the arena destroys everything in one go
+  for (View *view : vViews)
+    delete view;
+  FreeStates();
+  mArena.Release();
+}
+
+void Model::ClearViews(void) {
+  for (View *view : vViews)
+    delete view;
+  vViews.clear();
+  for (Variable *var : mSymbolNameSpace.Variables())
+    var->SetView(NULL);
 }
 
 Equation *Model::AddUnnamedVariable(ExpressionFunctionMemory *e) {
@@ -37,29 +68,37 @@ void Model::ClearCompEquations(void) {
   vInitialComps.clear();
   vUnchangingComps.clear();
   vInitialTimeComps.clear();
+  vRateComps.clear();
 
-  SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-  for (const SymbolNameSpace::iterator &it : *ht) {
-    SNSitToSymbol(it)->SetupState(NULL);
-    SNSitToSymbol(it)->CheckPlaceholderVars(NULL);
+  for (Symbol *sym : mSymbolNameSpace.Symbols()) {
+    sym->SetupState(NULL);
+    sym->CheckPlaceholderVars(NULL);
   }
   for (Variable *v : vUnamedVars) {
     v->GetEquation(0)->GetExpression()->RemoveFunctionArgs();  // these are allocated in the real variable's equation
     v->SetupState(NULL);
     delete v;
   }
-  if (dLevel) {
-    delete dLevel;
-    dLevel = NULL;
-  }
-  if (dRate) {
-    delete dRate;
-    dRate = NULL;
-  }
-  if (dAux) {
-    delete dAux;
-    dAux = NULL;
+  vUnamedVars.clear();
+  vUnamedOwners.clear();
+  for (Variable *v : vMacroVars) {
+    v->GetEquation(0)->ReleaseExpression();  // the macro's body or the caller's argument
+    v->SetupState(NULL);
+    delete v;
   }
+  vMacroVars.clear();
+  vMacroOwners.clear();
+  mMacroCalls.clear();
+  mMacroBindings.clear();
+  dMacroInstances.clear();
+  FreeStates();
+}
+
+void Model::FreeStates(void) {
+  delete[] dLevel;
+  delete[] dRate;
+  delete[] dAux;
+  dLevel = dRate = dAux = NULL;
 }
 typedef struct {
   Variable *v;
@@ -68,29 +107,34 @@ typedef struct {
 bool Model::OrganizeSubscripts(void) {
   std::vector<SubInfoWCount> sublist;
   std::vector<Variable *> subelm;
-  SubInfoWCount siwc;
+  SubInfoWCount siwc = {NULL, 0};
   try {
-    SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-    for (const SymbolNameSpace::iterator &it : *ht) {
-      siwc.v = static_cast<Variable *> SNSitToSymbol(it);
-      if ((siwc.count = siwc.v->SubscriptCountVars(subelm))) {
+    for (Variable *var : mSymbolNameSpace.Variables()) {
+      siwc.v = var;
+      if ((siwc.count = siwc.v->SubscriptCountVars(subelm)) < 0)
+        break;
+      if (siwc.count)
         sublist.push_back(siwc);
-      }
     }
-    mSymbolNameSpace.ConfirmAllAllocations();
-  } catch (...) {
+  } catch (...) {  // out of memory
+    siwc.count = -1;
+  }
+  if (siwc.count < 0) {
     mSymbolNameSpace.DeleteAllUnconfirmedAllocations();
     return false;
   }
+  mSymbolNameSpace.ConfirmAllAllocations();
   return true;
 }
 
 bool Model::ValidatePlaceholderVars(void) {
   try {
-    SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-    for (const SymbolNameSpace::iterator &it : *ht) {
-      // printf("Checking placeholders out %s\n",SNSitToSymbol(it)->GetName().c_str()) ;
-      SNSitToSymbol(it)->CheckPlaceholderVars(this);
+    for (Symbol *sym : mSymbolNameSpace.Symbols()) {
+      // printf("Checking placeholders out %s\n",sym->GetName().c_str()) ;
+      sym->CheckPlaceholderVars(this);
+      // any placeholders made, nested ones included, are computed for sym
+      vUnamedOwners.resize(vUnamedVars.size(),
+                           sym->isType() == Symtype_Variable ? static_cast<Variable *>(sym) : NULL);
     }
     mSymbolNameSpace.ConfirmAllAllocations();
   } catch (...) {
@@ -100,10 +144,98 @@ bool Model::ValidatePlaceholderVars(void) {
   return true;
 }
 
+// each use of a macro gets variables of its own for what the body
+// computes, made one after another so all the uses' values are laid out
+// the same way
+bool Model::InstantiateMacros(void) {
+  if (mMacroFunctions.empty())
+    return true;
+  try {
+    bool ok = true;
+    for (Variable *var : mSymbolNameSpace.Variables()) {
+      for (Equation *eq : var->GetAllEquations())
+        ok = ok && InstantiateMacros(eq->GetExpression(), var);
+    }
+    if (ok) {
+      mSymbolNameSpace.ConfirmAllAllocations();
+      return true;
+    }
+  } catch (...) {
+  }
+  vMacroVars.clear();
+  vMacroOwners.clear();
+  mMacroCalls.clear();
+  mMacroBindings.clear();
+  dMacroInstances.clear();
+  mSymbolNameSpace.DeleteAllUnconfirmedAllocations();
+  return false;
+}
+
+bool Model::InstantiateMacros(Expression *e, Variable *owner) {
+  if (!e)
+    return true;
+  if (e->GetType() != EXPTYPE_Function && e->GetType() != EXPTYPE_FunctionMemory)
+    return InstantiateMacros(e->GetArg(0), owner) && InstantiateMacros(e->GetArg(1), owner);
+  ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+  int n = args ? args->Length() : 0;
+  for (int i = 0; i < n; i++) {
+    if (!InstantiateMacros(args->GetExp(i), owner))
+      return false;
+  }
+  MacroFunction *macro = e->GetFunction()->Macro();
+  if (!macro || mMacroCalls.count(args))
+    return true;
+  std::vector<Symbol *> dims;
+  if (!ValueDimensions(owner, dims) || !dims.empty())
+    return false;  // each element would need a use of its own
+  dMacroInstances.emplace_back(macro);
+  MacroInstance *use = &dMacroInstances.back();
+  mMacroCalls[args] = use;
+  auto add = [&](Expression *exp) {
+    Variable *var = new Variable(&mSymbolNameSpace, std::string());
+    ExpressionVariable *ev = new ExpressionVariable(&mSymbolNameSpace, var, NULL);
+    LeftHandSide *lhs = new LeftHandSide(&mSymbolNameSpace, ev, NULL, NULL, 0);
+    var->AddEq(new Equation(&mSymbolNameSpace, lhs, exp, '='));
+    vMacroVars.push_back(var);
+    vMacroOwners.push_back(owner);
+    return var;
+  };
+  const std::vector<Variable *> &slots = macro->Slots();
+  for (int i = 0; i < macro->ComputedCount(); i++) {
+    Variable *var = add(slots[i]->GetEquation(0)->GetExpression());
+    use->Bind(i, var);
+    mMacroBindings[var] = use;
+  }
+  // an argument that is a variable, or already has one, is used as it is
+  for (int i = 0; i < n; i++) {
+    Expression *arg = args->GetExp(i);
+    Variable *var = NULL;
+    if (arg->GetType() == EXPTYPE_Variable && !static_cast<ExpressionVariable *>(arg)->GetSubs())
+      var = static_cast<ExpressionVariable *>(arg)->GetVariable();
+    else if (arg->GetType() == EXPTYPE_FunctionMemory)
+      var = static_cast<ExpressionFunctionMemory *>(arg)->Placeholder();
+    else if (arg->GetType() == EXPTYPE_Function && arg->GetFunction()->Macro())
+      var = MacroOutput(static_cast<ExpressionFunction *>(arg)->GetArgs());
+    use->Bind(macro->ComputedCount() + i, var ? var : add(arg));
+  }
+  return true;
+}
+
+Variable *Model::MacroOutput(ExpressionList *args) const {
+  std::unordered_map<ExpressionList *, MacroInstance *>::const_iterator it = mMacroCalls.find(args);
+  return it == mMacroCalls.end() ? NULL : it->second->Output();
+}
+
+const MacroInstance *Model::MacroBinding(Variable *var) const {
+  std::unordered_map<Variable *, const MacroInstance *>::const_iterator it = mMacroBindings.find(var);
+  return it == mMacroBindings.end() ? NULL : it->second;
+}
+
 bool Model::SetupVariableStates(int pass /* 0 just assign, 1 determine sizes, 2 pass pointers for computation*/) {
   ContextInfo info;
   info.pSymbolNameSpace = &mSymbolNameSpace;
-  SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
+  info.SetModel(this);  // for the size of arrays
+  const std::vector<Symbol *> &symbols = mSymbolNameSpace.Symbols();
   info.iComputeType = pass;  // flag to skip empty or count sizes
   try {
     if (pass == 2) {
@@ -125,13 +257,16 @@ bool Model::SetupVariableStates(int pass /* 0 just assign, 1 determine sizes, 2
       info.pBaseLevel = info.pCurLevel = NULL;
       info.iComputeType = 0;
     }
-    for (const SymbolNameSpace::iterator &it : *ht) {
-      SNSitToSymbol(it)->SetupState(&info);
+    for (Symbol *sym : symbols) {
+      sym->SetupState(&info);
     }
     // placeholder vars also need state set up
     for (Variable *v : vUnamedVars) {
       v->SetupState(&info);
     }
+    for (Variable *v : vMacroVars) {
+      v->SetupState(&info);
+    }
     mSymbolNameSpace.ConfirmAllAllocations();
     if (pass == 1) {
       iNLevel = (info.pCurLevel - info.pBaseLevel);
@@ -139,75 +274,285 @@ bool Model::SetupVariableStates(int pass /* 0 just assign, 1 determine sizes, 2
     }
   } catch (...) {
     // set all states to null - they will be deleted
-    for (const SymbolNameSpace::iterator &it : *ht) {
-      SNSitToSymbol(it)->SetupState(NULL);  // clear if setup
+    for (Symbol *sym : symbols) {
+      sym->SetupState(NULL);  // clear if setup
     }
     mSymbolNameSpace.DeleteAllUnconfirmedAllocations();
-    if (dLevel) {
-      delete dLevel;
-      dLevel = NULL;
-    }
-    if (dRate) {
-      delete dRate;
-      dRate = NULL;
-    }
-    if (dAux) {
-      delete dAux;
-      dAux = NULL;
-    }
+    FreeStates();
     return false;
   }
   return true;
 }
 
-/* start anywhere - we just use the iterator order on the hash table -
+/* EquationOrder - puts the equations in the order each kind of
+   computation needs them, with an explicit stack rather than by recursing
+   down every chain of variables, so a long chain can't run the stack out
+   (wasm's especially)
+
+   every equation is looked at once for what it reads for initial values,
+   for the active values and for the rates - Visit then walks that depth
+   first, sending a variable's equations out after those of everything it
+   reads, just as the ordering by CheckComputed once did.  The unchanging
+   equations are the active ones whose values don't change, so the one
+   walk gives both.  Finding a variable already being visited is a loop of
+   simultaneous equations - unless it is a level, as except for initial
+   values a level depends on nothing */
+class EquationOrder {
+public:
+  enum Pass { Pass_Initial, Pass_Active, Pass_Rate, Pass_Count };
+  EquationOrder(std::vector<std::vector<Variable *>> *loops, const Model *model)
+      : pLoops(loops), pModel(model), bFailed(false) {
+  }
+  // -1 if var has nothing to compute
+  int Node(Variable *var);
+  // what each node's equations read in each pass - and what they read in
+  // turn
+  void Read(ContextInfo *info);
+  // visits node as a start (first) or as read by something else, sending
+  // out the equations that need computing - to unchanging for the active
+  // equations not changing over the run
+  void Visit(int node, Pass pass, bool first, std::vector<Equation *> *out,
+             std::vector<Equation *> *unchanging = NULL);
+  // true once there has been a loop or an equation reading something
+  // that can't be computed
+  bool Failed(void) const {
+    return bFailed;
+  }
+
+private:
+  enum { Mark_None, Mark_Open, Mark_Done };
+  struct OrderNode {
+    Variable *var;
+    State *state;
+    std::vector<int> vReads[Pass_Count];  // -1 ends the list of one that can't be computed
+    unsigned char cOwnDDF;                // from its own active equations
+    unsigned char cDDF;                   // with what it reads as well
+    unsigned char cMark[Pass_Count];
+  };
+  struct Frame {
+    int node;
+    size_t next;  // in vReads
+  };
+  void Enter(int node, Pass pass, bool first);
+  void Finish(Pass pass, std::vector<Equation *> *out, std::vector<Equation *> *unchanging);
+  void Loop(int loop);
+  std::vector<OrderNode> vNodes;
+  std::unordered_map<Variable *, int> mNodes;
+  std::vector<Frame> vStack;
+  std::vector<std::vector<Variable *>> *pLoops;
+  const Model *pModel;  // for the uses of macros
+  bool bFailed;
+};
+
+int EquationOrder::Node(Variable *var) {
+  auto it = mNodes.find(var);
+  if (it != mNodes.end())
+    return it->second;
+  State *state = var->Content() ? var->Content()->GetState() : NULL;
+  if (!state)
+    return -1;
+  OrderNode node;
+  node.var = var;
+  node.state = state;
+  node.cOwnDDF = node.cDDF = 0;
+  for (int pass = 0; pass < Pass_Count; pass++)
+    node.cMark[pass] = Mark_None;
+  vNodes.push_back(node);
+  return mNodes[var] = static_cast<int>(vNodes.size() - 1);
+}
+
+void EquationOrder::Read(ContextInfo *info) {
+  static const int computeTypes[Pass_Count] = {CF_initial, CF_active, CF_rate};
+  std::vector<Variable *> reads;
+  for (size_t i = 0; i < vNodes.size(); i++) {  // grows as unseen variables are read
+    const std::vector<Equation *> &eqs = vNodes[i].var->GetAllEquations();
+    info->SetMacroInstance(pModel->MacroBinding(vNodes[i].var));
+    for (int pass = 0; pass < Pass_Count; pass++) {
+      info->SetComputType(computeTypes[pass]);
+      info->ClearDDF();
+      reads.clear();
+      info->SetDependencies(&reads);
+      bool computable = true;
+      for (Equation *eq : eqs) {
+        if (!eq->GetExpression()->CheckComputed(info)) {
+          computable = false;
+          break;
+        }
+      }
+      info->SetDependencies(NULL);
+      for (Variable *var : reads) {
+        int read = Node(var);
+        vNodes[i].vReads[pass].push_back(read);
+      }
+      if (!computable)
+        vNodes[i].vReads[pass].push_back(-1);
+      if (pass == Pass_Active)
+        vNodes[i].cOwnDDF = info->GetDDF() | (vNodes[i].state->UpdateOnPartialStep() ? 0 : DDF_time_varying);
+    }
+  }
+  info->SetMacroInstance(NULL);
+}
+
+void EquationOrder::Visit(int node, Pass pass, bool first, std::vector<Equation *> *out,
+                          std::vector<Equation *> *unchanging) {
+  Enter(node, pass, first);
+  while (!vStack.empty()) {
+    Frame &top = vStack.back();
+    const std::vector<int> &reads = vNodes[top.node].vReads[pass];
+    if (top.next == reads.size())
+      Finish(pass, out, unchanging);
+    else if (reads[top.next] < 0) {
+      bFailed = true;
+      top.next++;
+    } else
+      Enter(reads[top.next++], pass, false);
+  }
+}
+
+void EquationOrder::Enter(int n, Pass pass, bool first) {
+  OrderNode &node = vNodes[n];
+  bool level = node.state->HasMemory();
+  unsigned char ignored = 0;
+  // what the reader's active value changes with
+  unsigned char &ddf = pass == Pass_Active && !vStack.empty() ? vNodes[vStack.back().node].cDDF : ignored;
+  if (node.cMark[pass] == Mark_Done) {
+    ddf |= level ? DDF_level : node.cDDF;
+    return;
+  }
+  if (!first && pass == Pass_Rate && node.state->Pipeline())
+    return;  // its output is computed with the active equations - only its own rates wait on its input
+  if (pass != Pass_Initial && level && (!first || node.cMark[pass] == Mark_Open)) {
+    ddf |= DDF_level;  // the level - even if the rate is a constant (only a 0 rate would really be unchanging)
+    return;
+  }
+  if (node.cMark[pass] == Mark_Open) {
+    Loop(n);
+    return;
+  }
+  if (first && pass == Pass_Initial && !level && !node.state->Pipeline())
+    return;  // computed initially only if something needing it is
+  node.cMark[pass] = Mark_Open;
+  node.cDDF = node.cOwnDDF;
+  Frame frame = {n, 0};
+  vStack.push_back(frame);
+}
+
+void EquationOrder::Finish(Pass pass, std::vector<Equation *> *out, std::vector<Equation *> *unchanging) {
+  OrderNode &node = vNodes[vStack.back().node];
+  vStack.pop_back();
+  node.cMark[pass] = Mark_Done;
+  bool level = node.state->HasMemory();
+  if (pass == Pass_Active) {
+    node.state->SetDynamicDependency(node.cDDF);
+    if (!vStack.empty())
+      vNodes[vStack.back().node].cDDF |= node.cDDF;
+    if (level)
+      return;
+    if (!(node.cDDF & (DDF_level | DDF_data | DDF_time_varying)))
+      out = unchanging;
+  } else if (pass == Pass_Rate && !level && !node.state->Pipeline())
+    return;
+  for (Equation *eq : node.var->GetAllEquations())
+    out->push_back(eq);
+}
+
+// notes the loop from what is being visited back to loop (once, however
+// many passes find it) and goes on past it to find any others
+void EquationOrder::Loop(int loop) {
+  bFailed = true;
+  std::vector<Variable *> vars;
+  bool in = false;
+  for (const Frame &frame : vStack) {
+    in = in || frame.node == loop;
+    if (in && !vNodes[frame.node].var->GetName().empty())  // not the placeholders for functions in an equation
+      vars.push_back(vNodes[frame.node].var);
+  }
+  for (const std::vector<Variable *> &found : *pLoops) {
+    if (found.size() == vars.size() && std::is_permutation(found.begin(), found.end(), vars.begin()))
+      return;
+  }
+  pLoops->push_back(vars);
+}
+
+/* start anywhere - we just use the order of the name space -
    and get every variable computed - this needs to be done for both
    active and initial value (potentially reinitial as well but that is
-   left out for now).
+   left out for now).  INITIAL TIME and TIME STEP come first, on their own
    */
-bool Model::OrderEquations(ContextInfo *info, bool tonly) {
-  bool haserr = false;
+bool Model::OrderEquations(void) {
+  EquationOrder order(&vSimultaneous, this);
+  std::vector<int> starts;
+  int initialTime, timeStep;
+  ContextInfo info;
+  info.SetModel(this);  // for the outputs of macros
   try {
-    SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-    if (tonly) {
-      Variable *v;
-      v = static_cast<Variable *>(mSymbolNameSpace.Find("INITIAL TIME"));
-      // note CheckComputed called with false for first otherwise these won't be
-      // initialized
-      if (!v || !v->CheckComputed(info, false))
-        haserr = true;
-      v = static_cast<Variable *>(mSymbolNameSpace.Find("TIME STEP"));
-      if (!v || !v->CheckComputed(info, false))
-        haserr = true;
-    } else {
-      for (const SymbolNameSpace::iterator &it : *ht) {
-        // printf("Looping to: %s\n",SNSitToSymbol(it)->GetName().c_str()) ;
-        if (!SNSitToSymbol(it)->CheckComputed(info, true))
-          haserr = true;  // continue looking for simultaneous even when false
-      }
-      for (Variable *v : vUnamedVars) {
-        if (!v->CheckComputed(info, true))
-          haserr = true;
-      }
+    Variable *v = static_cast<Variable *>(mSymbolNameSpace.Find("INITIAL TIME"));
+    Variable *dt = static_cast<Variable *>(mSymbolNameSpace.Find("TIME STEP"));
+    if (!v || !v->Content() || !dt || !dt->Content())
+      return false;
+    initialTime = order.Node(v);
+    timeStep = order.Node(dt);
+    for (Variable *v : Graph().Variables()) {  // nothing else has anything to compute
+      if (!v->Content() && mSubscriptElements.count(v))
+        continue;  // a subscript element - CacheSubscriptElements has them all
+      if (!v->Content())
+        return false;  // as it can't be computed
+      int node = order.Node(v);
+      if (node >= 0)
+        starts.push_back(node);
     }
-
+    for (Variable *v : vUnamedVars) {
+      int node = order.Node(v);
+      if (node >= 0)
+        starts.push_back(node);
+    }
+    for (Variable *v : vMacroVars) {
+      int node = order.Node(v);
+      if (node >= 0)
+        starts.push_back(node);
+    }
+    order.Read(&info);
     mSymbolNameSpace.ConfirmAllAllocations();
   } catch (...) {
     mSymbolNameSpace.DeleteAllUnconfirmedAllocations();
     return false;
   }
-  return !haserr;
+
+  // note INITIAL TIME and TIME STEP are visited as if something read them,
+  // otherwise they wouldn't be initialized
+  if (initialTime >= 0)
+    order.Visit(initialTime, EquationOrder::Pass_Initial, false, &vInitialTimeComps);
+  if (timeStep >= 0)
+    order.Visit(timeStep, EquationOrder::Pass_Initial, false, &vInitialTimeComps);
+  // every pass goes on after a failure so all the loops are found
+  for (int node : starts)
+    order.Visit(node, EquationOrder::Pass_Initial, true, &vInitialComps);
+  for (int node : starts)
+    order.Visit(node, EquationOrder::Pass_Active, true, &vActiveComps, &vUnchangingComps);
+  for (int node : starts)
+    order.Visit(node, EquationOrder::Pass_Rate, true, &vRateComps);
+  return !order.Failed();
 }
 
 bool Model::AnalyzeEquations(void) {
-  ContextInfo info;
-
-  ClearCompEquations();  // will also reset comp flag and delete placeholder vars
+  ClearCompEquations();  // will also delete placeholder vars
+  vSimultaneous.clear();
+  // Time has no equation but needs a state for the equations using it to
+  // read - with no equations it gets the same one as exogenous variables
+  Symbol *time = mSymbolNameSpace.Find("Time");
+  if (time && time->isType() == Symtype_Variable && !static_cast<Variable *>(time)->Content()) {
+    Variable *var = static_cast<Variable *>(time);
+    var->SetContent(new VariableContentVar);
+    var->SetAlternateName(var->GetName());
+  }
   /* ValidatePlaceholderVars will create the variables required for functions that either
      have memory are are time dependent (and therefore not subject to change within
      a DT as used in all but Euler integration */
   if (!ValidatePlaceholderVars())
     return false;
+  // after the placeholders, as a use of a macro can be passed one
+  if (!InstantiateMacros())
+    return false;
   /* SetupVariableStates will create states based on the variable equation types
      including subscript states needed to organize subscripts */
   if (!SetupVariableStates(0))
@@ -218,44 +563,958 @@ bool Model::AnalyzeEquations(void) {
     return false;
   if (!SetupVariableStates(2)) /* allocate and assign computed value locations */
     return false;
-  // three passes on ordering equations first for initial
-  // then for active - but putting out only those equations
-  // that are not clearly unchanging - then again for
-  // unchanging which are equations not put out in step
-  // 2 then during execution 1 and 3 are computed once
-  // and 2 is cycled through for integration
-  //
-
-  // before the passes initialize time, then dt
-  // fprintf(stderr, "\nInitial time \n");
-  info.iComputeType = CF_initial;
-  info.pEquations = &vInitialTimeComps;
-  if (!OrderEquations(&info, true))
-    return false;
-
-  // fprintf(stderr, "\nInitial equations \n");
-  info.iComputeType = CF_initial;
-  info.pEquations = &vInitialComps;
-  if (!OrderEquations(&info, false))
-    return false;
-  // fprintf(stderr, "\n\nActive equations \n");
-  info.iComputeType = CF_active;
-  info.pEquations = &vActiveComps;
-  if (!OrderEquations(&info, false))
-    return false;
-  // fprintf(stderr, "\n\nUnchanging equations \n");
-  info.iComputeType = CF_unchanging;
-  info.pEquations = &vUnchangingComps;
-  if (!OrderEquations(&info, false))
-    return false;
-  // fprintf(stderr, "\n\nRate equations \n");
-  info.iComputeType = CF_rate;
-  info.pEquations = &vRateComps;
-  if (!OrderEquations(&info, false))
+  // the equations are then ordered for initial time then the other
+  // initial values, for the active equations - putting out only those
+  // that are not clearly unchanging - then the unchanging ones, and the
+  // rates.  During execution the initial and unchanging are computed once
+  // and the active cycled through for integration
+  return OrderEquations();
+}
+
+bool Model::LoopsCheck(std::vector<Diagnostic> &problems) {
+  if (!CanSimulate())
+    return true;  // not far enough to order
+  AnalyzeEquations();
+  for (const std::vector<Variable *> &loop : vSimultaneous) {
+    std::string names;
+    for (Variable *var : loop) {
+      if (!names.empty())
+        names.append(", ");
+      names.append(var->GetName());
+    }
+    problems.push_back(Diagnostic(XMUTIL_WARNING_SIMULTANEOUS, "simultaneous equations " + names, 0, 0,
+                                  loop.empty() ? std::string() : loop[0]->GetName()));
+  }
+  return vSimultaneous.empty();
+}
+
+// data is not simulated yet, nor arrays that don't have one layout for
+// their values or macros whose bodies can't be shared by every use
+bool Model::CanSimulate(void) {
+  // a macro's Time is the model's, there even if nothing else names it
+  if (!mMacroFunctions.empty() && !mSymbolNameSpace.Find("Time")) {
+    new Variable(&mSymbolNameSpace, "Time");
+    mSymbolNameSpace.ConfirmAllAllocations();
+  }
+  for (MacroFunction *macro : mMacroFunctions) {
+    if (!macro->Ready(&mSymbolNameSpace))
+      return false;
+  }
+  std::vector<Symbol *> dims;
+  for (Variable *var : mSymbolNameSpace.Variables()) {
+    const std::vector<Equation *> &eqs = var->GetAllEquations();
+    if (eqs.size() == 1 && eqs[0]->GetExpression()->GetType() == EXPTYPE_Symlist)
+      continue;  // a subscript range
+    if (!ValueDimensions(var, dims))
+      return false;
+    for (Equation *eq : eqs) {
+      if (eq->GetExpression()->GetType() == EXPTYPE_Symlist)
+        return false;
+    }
+  }
+  return true;
+}
+
+bool Model::ValueDimensions(Variable *var, std::vector<Symbol *> &dims) {
+  dims.clear();
+  const std::vector<Equation *> &eqs = var->GetAllEquations();
+  SymbolList *subs = eqs.empty() ? NULL : eqs[0]->GetLeft()->GetSubs();
+  if (!subs) {
+    for (Equation *eq : eqs) {
+      if (eq->GetLeft()->GetSubs())
+        return false;
+    }
+    return true;
+  }
+  if (eqs.size() != 1 || eqs[0]->GetLeft()->GetExceptList())
+    return false;
+  int n = subs->Length();
+  for (int i = 0; i < n; i++) {
+    const SymbolList::SymbolListEntry &entry = (*subs)[i];
+    if (entry.eType != SymbolList::EntryType_SYMBOL)
+      return false;
+    dims.push_back(entry.u.pSymbol);
+  }
+  return true;
+}
+
+// the integration step works on the whole level and rate arrays at once -
+// as many doubles a time as the target has room for, and then the rest
+// one by one.  The arithmetic is done in the same order either way so
+// the results don't depend on which is used
+#if defined(__AVX__)
+#define LEVEL_LANES 4
+typedef __m256d LevelLanes;
+static inline LevelLanes LanesLoad(const double *p) {
+  return _mm256_loadu_pd(p);
+}
+static inline void LanesStore(double *p, LevelLanes v) {
+  _mm256_storeu_pd(p, v);
+}
+static inline LevelLanes LanesSplat(double x) {
+  return _mm256_set1_pd(x);
+}
+static inline LevelLanes LanesAdd(LevelLanes a, LevelLanes b) {
+  return _mm256_add_pd(a, b);
+}
+static inline LevelLanes LanesMul(LevelLanes a, LevelLanes b) {
+  return _mm256_mul_pd(a, b);
+}
+#elif defined(__SSE2__)
+#define LEVEL_LANES 2
+typedef __m128d LevelLanes;
+static inline LevelLanes LanesLoad(const double *p) {
+  return _mm_loadu_pd(p);
+}
+static inline void LanesStore(double *p, LevelLanes v) {
+  _mm_storeu_pd(p, v);
+}
+static inline LevelLanes LanesSplat(double x) {
+  return _mm_set1_pd(x);
+}
+static inline LevelLanes LanesAdd(LevelLanes a, LevelLanes b) {
+  return _mm_add_pd(a, b);
+}
+static inline LevelLanes LanesMul(LevelLanes a, LevelLanes b) {
+  return _mm_mul_pd(a, b);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define LEVEL_LANES 2
+typedef float64x2_t LevelLanes;
+static inline LevelLanes LanesLoad(const double *p) {
+  return vld1q_f64(p);
+}
+static inline void LanesStore(double *p, LevelLanes v) {
+  vst1q_f64(p, v);
+}
+static inline LevelLanes LanesSplat(double x) {
+  return vdupq_n_f64(x);
+}
+static inline LevelLanes LanesAdd(LevelLanes a, LevelLanes b) {
+  return vaddq_f64(a, b);
+}
+static inline LevelLanes LanesMul(LevelLanes a, LevelLanes b) {
+  return vmulq_f64(a, b);
+}
+#elif defined(__wasm_simd128__)
+#define LEVEL_LANES 2
+typedef v128_t LevelLanes;
+static inline LevelLanes LanesLoad(const double *p) {
+  return wasm_v128_load(p);
+}
+static inline void LanesStore(double *p, LevelLanes v) {
+  wasm_v128_store(p, v);
+}
+static inline LevelLanes LanesSplat(double x) {
+  return wasm_f64x2_splat(x);
+}
+static inline LevelLanes LanesAdd(LevelLanes a, LevelLanes b) {
+  return wasm_f64x2_add(a, b);
+}
+static inline LevelLanes LanesMul(LevelLanes a, LevelLanes b) {
+  return wasm_f64x2_mul(a, b);
+}
+#endif
+
+// level = from + h * k - level may be from
+static void Advance(double *level, const double *from, double h, const double *k, int n) {
+  int i = 0;
+#ifdef LEVEL_LANES
+  LevelLanes vh = LanesSplat(h);
+  for (; i + LEVEL_LANES <= n; i += LEVEL_LANES)
+    LanesStore(level + i, LanesAdd(LanesLoad(from + i), LanesMul(vh, LanesLoad(k + i))));
+#endif
+  for (; i < n; i++)
+    level[i] = from[i] + h * k[i];
+}
+
+// level = from + h * (k1 + k2), Heun's last step
+static void Advance2(double *level, const double *from, double h, const double *k1, const double *k2, int n) {
+  int i = 0;
+#ifdef LEVEL_LANES
+  LevelLanes vh = LanesSplat(h);
+  for (; i + LEVEL_LANES <= n; i += LEVEL_LANES) {
+    LevelLanes sum = LanesAdd(LanesLoad(k1 + i), LanesLoad(k2 + i));
+    LanesStore(level + i, LanesAdd(LanesLoad(from + i), LanesMul(vh, sum)));
+  }
+#endif
+  for (; i < n; i++)
+    level[i] = from[i] + h * (k1[i] + k2[i]);
+}
+
+// level = from + h * (k1 + 2 k2 + 2 k3 + k4), RK4's last step
+static void Advance4(double *level, const double *from, double h, const double *k1, const double *k2,
+                     const double *k3, const double *k4, int n) {
+  int i = 0;
+#ifdef LEVEL_LANES
+  LevelLanes vh = LanesSplat(h), two = LanesSplat(2);
+  for (; i + LEVEL_LANES <= n; i += LEVEL_LANES) {
+    LevelLanes sum = LanesAdd(LanesLoad(k1 + i), LanesMul(two, LanesLoad(k2 + i)));
+    sum = LanesAdd(sum, LanesMul(two, LanesLoad(k3 + i)));
+    sum = LanesAdd(sum, LanesLoad(k4 + i));
+    LanesStore(level + i, LanesAdd(LanesLoad(from + i), LanesMul(vh, sum)));
+  }
+#endif
+  for (; i < n; i++)
+    level[i] = from[i] + h * (k1[i] + 2 * k2[i] + 2 * k3[i] + k4[i]);
+}
+
+// true if e calls a random function anywhere in it
+static bool Draws(Expression *e) {
+  if (!e)
+    return false;
+  if (e->GetType() == EXPTYPE_Function || e->GetType() == EXPTYPE_FunctionMemory) {
+    if (e->GetFunction()->IsRandom())
+      return true;
+    ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+    for (int i = 0, n = args ? args->Length() : 0; i < n; i++) {
+      if (Draws(args->GetExp(i)))
+        return true;
+    }
+    return false;
+  }
+  return Draws(e->GetArg(0)) || Draws(e->GetArg(1));
+}
+
+bool Model::Needed(const std::vector<std::string> &outputs, std::unordered_set<Variable *> &needed) {
+  // the control parameters are always read, to set the run up, and anything
+  // drawing random numbers is kept so the draws the rest get are the same
+  static const char *controls[] = {"INITIAL TIME", "FINAL TIME", "TIME STEP", "SAVEPER", "Time"};
+  std::vector<Variable *> todo;
+  auto need = [&](Variable *var) {
+    if (needed.insert(var).second)
+      todo.push_back(var);
+  };
+  for (const char *name : controls) {
+    Symbol *sym = mSymbolNameSpace.Find(name);
+    if (sym && sym->isType() == Symtype_Variable)
+      need(static_cast<Variable *>(sym));
+  }
+  for (Variable *var : Graph().Variables()) {
+    for (Equation *eq : var->GetAllEquations()) {
+      if (Draws(eq->GetExpression()))
+        need(var);
+    }
+  }
+  for (size_t i = 0; i < vMacroVars.size(); i++) {
+    if (Draws(vMacroVars[i]->GetEquation(0)->GetExpression()))
+      need(vMacroOwners[i]);
+  }
+  for (const std::string &output : outputs) {
+    Symbol *sym = mSymbolNameSpace.Find(output.substr(0, output.find('[')));  // an element needs all of it
+    if (!sym || sym->isType() != Symtype_Variable)
+      return false;
+    need(static_cast<Variable *>(sym));
+  }
+  // back through what each equation reads - a stock's reads its flows - and
+  // then the placeholders for the functions in those, that read more
+  std::vector<Variable *> used;
+  for (;;) {
+    while (!todo.empty()) {
+      Variable *var = todo.back();
+      todo.pop_back();
+      for (Variable *in : Graph().Inputs(var))
+        need(in);
+    }
+    for (size_t i = 0; i < vUnamedVars.size(); i++) {
+      Variable *owner = i < vUnamedOwners.size() ? vUnamedOwners[i] : NULL;
+      if (needed.count(vUnamedVars[i]) || (owner && !needed.count(owner)))
+        continue;
+      needed.insert(vUnamedVars[i]);
+      used.clear();
+      for (Equation *eq : vUnamedVars[i]->GetAllEquations())
+        eq->GetExpression()->GetVarsUsed(used);
+      for (Variable *in : used)
+        need(in);
+    }
+    // and the uses of macros, whose equations read what the use binds -
+    // the model's own variables or ones of the use's that this gets to
+    for (size_t i = 0; i < vMacroVars.size(); i++) {
+      if (needed.count(vMacroVars[i]) || !needed.count(vMacroOwners[i]))
+        continue;
+      needed.insert(vMacroVars[i]);
+      const MacroInstance *use = MacroBinding(vMacroVars[i]);
+      used.clear();
+      vMacroVars[i]->GetEquation(0)->GetExpression()->GetVarsUsed(used);
+      for (Variable *in : used) {
+        in = use ? use->Resolve(in) : in;
+        if (in->GetSymbolNameSpace() == &mSymbolNameSpace && !in->GetName().empty())
+          need(in);
+      }
+    }
+    if (todo.empty())
+      return true;
+  }
+}
+
+Variable *Model::SetConstant(const std::string &name, double value, double *was) {
+  Symbol *sym = mSymbolNameSpace.Find(name);
+  if (!sym || sym->isType() != Symtype_Variable)
+    return NULL;
+  Variable *var = static_cast<Variable *>(sym);
+  const std::vector<Equation *> &equations = var->GetAllEquations();
+  if (equations.size() != 1 || !equations[0]->GetExpression() ||
+      equations[0]->GetExpression()->GetType() != EXPTYPE_Number)
+    return NULL;
+  ExpressionNumber *number = static_cast<ExpressionNumber *>(equations[0]->GetExpression());
+  if (was)
+    *was = number->GetValue();
+  number->SetValue(value);
+  return var;
+}
+
+double Model::FirstChange(const std::vector<Variable *> &changed, double start, double dt) {
+  static const char *controls[] = {"INITIAL TIME", "FINAL TIME", "TIME STEP", "SAVEPER"};
+  for (const char *name : controls) {
+    Symbol *sym = mSymbolNameSpace.Find(name);
+    if (std::find(changed.begin(), changed.end(), sym) != changed.end())
+      return start;
+  }
+  // the earliest time each variable can be computed differently - absent
+  // for never.  These only come down, so going over everything until
+  // nothing moves settles them, loops through stocks included
+  std::unordered_map<Variable *, double> when;
+  for (Variable *var : changed)
+    when[var] = start;
+  const double never = HUGE_VAL;
+  auto at = [&](Variable *var) {
+    std::unordered_map<Variable *, double>::const_iterator it = when.find(var);
+    return it == when.end() ? never : it->second;
+  };
+  // a number, or a variable that is one and isn't changed - anything else
+  // might move
+  auto fixed = [&](Expression *e, double &value) {
+    Variable *var = e && e->GetType() == EXPTYPE_Variable ? static_cast<ExpressionVariable *>(e)->GetVariable() : NULL;
+    if (var && at(var) == never) {
+      const std::vector<Equation *> &equations = var->GetAllEquations();
+      e = equations.size() == 1 ? equations[0]->GetExpression() : NULL;
+    }
+    if (!e || e->GetType() != EXPTYPE_Number)
+      return false;
+    value = static_cast<ExpressionNumber *>(e)->GetValue();
+    return true;
+  };
+  std::function<double(Expression *)> earliest = [&](Expression *e) -> double {
+    if (!e)
+      return never;
+    if (e->GetType() == EXPTYPE_Variable)
+      return at(static_cast<ExpressionVariable *>(e)->GetVariable());
+    if (e->GetType() != EXPTYPE_Function && e->GetType() != EXPTYPE_FunctionMemory)
+      return std::min(earliest(e->GetArg(0)), earliest(e->GetArg(1)));
+    ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+    int n = args ? args->Length() : 0;
+    const std::string &name = e->GetFunction()->GetName();
+    double gate;
+    // nothing these compute differs before they start, as Function.cpp
+    // evaluates them
+    if (name == "STEP" && n == 2 && fixed(args->GetExp(1), gate))
+      return std::max(earliest(args->GetExp(0)), gate - dt / 2);
+    if (name == "PULSE" && n == 2 && fixed(args->GetExp(0), gate))
+      return std::max(earliest(args->GetExp(1)), gate - dt / 4);
+    if (name == "RAMP" && n == 3 && fixed(args->GetExp(1), gate))
+      return std::max(std::min(earliest(args->GetExp(0)), earliest(args->GetExp(2))), gate);
+    double first = never;
+    for (int i = 0; i < n; i++)
+      first = std::min(first, earliest(args->GetExp(i)));
+    return first;
+  };
+  auto lower = [&](Variable *var, double t) {
+    if (!var || t >= at(var))
+      return false;
+    when[var] = t;
+    return true;
+  };
+  auto compute = [&](Variable *var) {
+    double first = never;
+    for (Equation *eq : var->GetAllEquations())
+      first = std::min(first, earliest(eq->GetExpression()));
+    return lower(var, first);
+  };
+  for (bool moved = true; moved;) {
+    moved = false;
+    for (Variable *var : mSymbolNameSpace.Variables())
+      moved |= compute(var);
+    // a placeholder reads what the function it stands for does, and is
+    // computed for its owner
+    for (size_t i = 0; i < vUnamedVars.size(); i++) {
+      moved |= compute(vUnamedVars[i]);
+      if (i < vUnamedOwners.size())
+        moved |= lower(vUnamedOwners[i], at(vUnamedVars[i]));
+    }
+    // a macro's equations only see what the use passes it, which the
+    // owner's call reads
+    for (size_t i = 0; i < vMacroVars.size(); i++)
+      moved |= lower(vMacroVars[i], at(vMacroOwners[i]));
+  }
+  // what the unchanging equations compute is computed again on resuming
+  std::unordered_set<Variable *> unchanging;
+  for (Equation *eq : vUnchangingComps)
+    unchanging.insert(eq->GetVariable());
+  double first = never;
+  for (const std::pair<Variable *const, double> &var : when) {
+    if (!unchanging.count(var.first))
+      first = std::min(first, var.second);
+  }
+  // a Runge-Kutta step computes the model a whole step on from its start
+  return std::max(start, first - dt);
+}
+
+bool Model::Simulate(SimulationResults *results) {
+  SimulationPlan plan;
+  return Compile(&plan) && plan.Run(results);
+}
+
+bool Model::Compile(SimulationPlan *plan, const std::vector<std::string> *outputs, int lanes, bool parameters) {
+  if (!CanSimulate() || !AnalyzeEquations())
+    return false;
+  // with outputs asked for, the equations for anything they don't need are
+  // left out - the order stays good as everything an equation reads is kept
+  std::unordered_set<Variable *> needed;
+  if (outputs && !Needed(*outputs, needed))
+    return false;
+  auto prune = [&](const std::vector<Equation *> &equations) {
+    std::vector<Equation *> kept;
+    for (Equation *e : equations) {
+      if (!outputs || needed.count(e->GetVariable()))
+        kept.push_back(e);
+    }
+    return kept;
+  };
+  std::vector<Equation *> initialComps = prune(vInitialComps);
+  std::vector<Equation *> unchangingComps = prune(vUnchangingComps);
+  std::vector<Equation *> activeComps = prune(vActiveComps);
+  ContextInfo info;
+  info.pSymbolNameSpace = &mSymbolNameSpace;
+  info.SetModel(this);
+  plan->pModel = this;
+  plan->pSymbolNameSpace = &mSymbolNameSpace;
+  plan->pLevel = dLevel;
+  plan->pRate = dRate;
+  plan->pAux = dAux;
+  plan->iNLevel = iNLevel;
+  plan->iNAux = iNAux;
+  plan->iIntegrationType = iIntegrationType;
+  plan->bParameters = parameters;
+
+  // the columns - everything with a value, in name order so runs compare
+  Variable *time = static_cast<Variable *>(mSymbolNameSpace.Find("Time"));
+  if (time && (time->isType() != Symtype_Variable || !time->Content()->HasState()))
+    time = NULL;
+  plan->iTime = time ? static_cast<int>(time->Content()->GetState()->GetValueP() - dAux) : -1;
+  std::vector<Variable *> vars;
+  for (Variable *var : mSymbolNameSpace.Variables()) {
+    if (var != time && var->Content() && var->Content()->HasState() && (!outputs || needed.count(var)))
+      vars.push_back(var);
+  }
+  std::sort(vars.begin(), vars.end(), [](Variable *a, Variable *b) { return a->GetName() < b->GetName(); });
+  plan->vNames.clear();
+  plan->vColumns.clear();
+  plan->vUnchangingColumns.clear();
+  plan->vNames.push_back("Time");
+  std::unordered_set<Variable *> unchanging;
+  for (Equation *eq : vUnchangingComps)
+    unchanging.insert(eq->GetVariable());
+  std::vector<Symbol *> dims;
+  for (Variable *var : vars) {
+    ValueDimensions(var, dims);
+    State *state = var->Content()->GetState();
+    SimulationPlan::Column column;
+    column.bLevel = state->HasMemory();
+    column.offset = static_cast<int>(state->GetValueP() - (column.bLevel ? dLevel : dAux));
+    int count = state->ValueCount();
+    for (int i = 0; i < count; i++) {
+      std::string name = var->GetName();
+      int at = i;
+      // the element names come off the end as the last subscript varies fastest
+      std::string elms;
+      for (size_t j = dims.size(); j-- > 0;) {
+        const std::vector<Symbol *> &along = SubscriptElements(dims[j]);
+        elms.insert(0, (j ? "," : "") + along[at % along.size()]->GetName());
+        at /= static_cast<int>(along.size());
+      }
+      if (!dims.empty())
+        name += "[" + elms + "]";
+      if (unchanging.count(var))
+        plan->vUnchangingColumns.push_back(static_cast<int>(plan->vColumns.size()));
+      plan->vNames.push_back(name);
+      plan->vColumns.push_back(column);
+      column.offset++;
+    }
+  }
+
+  auto value = [&](const char *name, double defval) {
+    Symbol *sym = mSymbolNameSpace.Find(name);
+    if (!sym || sym->isType() != Symtype_Variable)
+      return defval;
+    Variable *var = static_cast<Variable *>(sym);
+    return var->Content() && var->Content()->HasState() ? var->Eval(&info) : defval;
+  };
+  auto setTime = [&](double t) {
+    info.SetTime(t);
+    if (time)
+      time->SetInitialValue(0, t);
+  };
+
+  // all of the equations are compiled - arrayed ones can only run that way
+  auto compile = [&](ExpressionCode &code, std::vector<Equation *> &equations, int computeType, int lanes) {
+    code.Clear();
+    code.SetLanes(lanes);
+    code.SetFoldFixed(!parameters);
+    code.SetBases(dLevel, dRate, dAux);
+    code.SetModel(this);
+    for (Equation *e : equations)
+      code.AddEquation(e, computeType);
+    return !code.Unsupported();
+  };
+  auto run = [&](ExpressionCode &code, int computeType) {
+    info.iComputeType = computeType;
+    code.Run(&info, dLevel, dRate, dAux);
+  };
+
+  // the control parameters first, then the levels and whatever is constant
+  // - the model's arrays are set up as a run would leave them so the code
+  // for the active equations can take in what won't change
+  SimulationPlan::Code &code = plan->mCode;
+  if (!compile(code.mInitialTime, vInitialTimeComps, CF_initial, 1))
+    return false;
+  run(code.mInitialTime, CF_initial);
+  double start = value("INITIAL TIME", 0);
+  double dt = value("TIME STEP", 1);
+  setTime(start);
+  info.SetDT(dt);
+  if (!compile(code.mInitial, initialComps, CF_initial, 1))
+    return false;
+  run(code.mInitial, CF_initial);
+  if (!compile(code.mUnchanging, unchangingComps, CF_unchanging, 1))
+    return false;
+  run(code.mUnchanging, CF_unchanging);
+  double stop = value("FINAL TIME", 100);
+  double saveper = value("SAVEPER", dt);
+  if (info.EvalFailed() || !(dt > 0) || !(stop >= start) || !(saveper > 0))
+    return false;
+  plan->dStart = start;
+  plan->dDT = dt;
+  plan->iSteps = static_cast<long>((stop - start) / dt + 0.5);
+  plan->iSaveEvery = std::max(1L, static_cast<long>(saveper / dt + 0.5));
+
+  // what runs every step is compiled, the rest only runs once and has
+  // been by now, so whatever those computed is folded in as numbers
+  std::vector<Equation *> rates, shifts;
+  for (Equation *e : prune(vRateComps)) {
+    StatePipeline *pipeline = e->GetVariable()->Content()->GetState()->Pipeline();
+    (pipeline && pipeline->RingLength() ? shifts : rates).push_back(e);
+  }
+  if (!compile(code.mActive, activeComps, CF_active, 1) || !compile(code.mRates, rates, CF_rate, 1) ||
+      !compile(code.mShifts, shifts, CF_rate, 1))
+    return false;
+
+  // and again for lanes, now that everything folded in is there - a model
+  // that can't go that way still runs one at a time
+  plan->iLanes = 1;
+  if (lanes > 1) {
+    SimulationPlan::Code &laned = plan->mLaneCode;
+    if (compile(laned.mInitialTime, vInitialTimeComps, CF_initial, lanes) &&
+        compile(laned.mInitial, initialComps, CF_initial, lanes) &&
+        compile(laned.mUnchanging, unchangingComps, CF_unchanging, lanes) &&
+        compile(laned.mActive, activeComps, CF_active, lanes) && compile(laned.mRates, rates, CF_rate, lanes) &&
+        compile(laned.mShifts, shifts, CF_rate, lanes))
+      plan->iLanes = lanes;
+  }
+  return true;
+}
+
+SimulationPlan::SimulationPlan(void) {
+  pModel = NULL;
+  pSymbolNameSpace = NULL;
+  pLevel = pRate = pAux = NULL;
+  iIntegrationType = Integration_Type_EULER;
+  dStart = 0;
+  dDT = 1;
+  iSteps = 0;
+  iSaveEvery = 1;
+  iTime = -1;
+  iNLevel = iNAux = 0;
+  iLanes = 1;
+  bParameters = false;
+}
+
+bool SimulationPlan::Shared(void) const {
+  return mCode.mInitialTime.Shared() && mCode.mInitial.Shared() && mCode.mUnchanging.Shared() &&
+         mCode.mActive.Shared() && mCode.mRates.Shared() && mCode.mShifts.Shared();
+}
+
+bool SimulationPlan::Columns(const std::vector<std::string> &names, std::vector<int> &columns) const {
+  columns.clear();
+  for (const std::string &name : names) {
+    size_t found = columns.size();
+    for (size_t i = 1; i < vNames.size(); i++) {
+      const std::string &col = vNames[i];
+      if (col.compare(0, name.size(), name) == 0 && (col.size() == name.size() || col[name.size()] == '['))
+        columns.push_back(static_cast<int>(i - 1));
+    }
+    if (columns.size() == found)
+      return false;
+  }
+  return true;
+}
+
+bool SimulationPlan::Run(SimulationSink *sink, uint64_t seed, uint64_t stream, double *level, double *rate,
+                         double *aux, const std::vector<int> *columns, SimulationCheckpoints *checkpoints) const {
+  return Simulate(&sink, 1, seed, stream, level, rate, aux, columns, checkpoints, NULL, 0);
+}
+
+bool SimulationPlan::RunLanes(SimulationSink *const *sinks, uint64_t seed, uint64_t stream, double *level,
+                              double *rate, double *aux, const std::vector<int> *columns) const {
+  return iLanes > 1 && Simulate(sinks, iLanes, seed, stream, level, rate, aux, columns, NULL, NULL, 0);
+}
+
+bool SimulationPlan::RunWith(SimulationSink *const *sinks, int lanes, const std::vector<int> &parameters,
+                             const double *values, uint64_t seed, uint64_t stream, double *level, double *rate,
+                             double *aux, const std::vector<int> *columns) const {
+  static const char *const controls[] = {"INITIAL TIME", "FINAL TIME", "TIME STEP", "SAVEPER"};
+  if (!bParameters || (lanes != 1 && (lanes != iLanes || iLanes == 1)))
+    return false;
+  const Code &code = lanes > 1 ? mLaneCode : mCode;
+  std::vector<ExpressionCode::Setting> settings;
+  for (size_t i = 0; i < parameters.size(); i++) {
+    int col = parameters[i];
+    if (col < 0 || col >= static_cast<int>(vColumns.size()) || vColumns[col].bLevel ||
+        std::find(std::begin(controls), std::end(controls), vNames[col + 1]) != std::end(controls))
+      return false;
+    ExpressionCode::Setting setting;
+    setting.offset = vColumns[col].offset;
+    setting.values = values + i * lanes;
+    // what the run's steps come from stays as it was compiled
+    if (code.mInitialTime.SetsNumber(setting.offset) ||
+        (!code.mInitial.SetsNumber(setting.offset) && !code.mUnchanging.SetsNumber(setting.offset)))
+      return false;
+    settings.push_back(setting);
+  }
+  return Simulate(sinks, lanes, seed, stream, level, rate, aux, columns, NULL, NULL, 0, NULL, &settings);
+}
+
+double SimulationPlan::FirstChange(const std::vector<Variable *> &changed) const {
+  return pModel->FirstChange(changed, dStart, dDT);
+}
+
+bool SimulationPlan::Resume(SimulationSink *sink, const SimulationCheckpoints &checkpoints,
+                            const std::vector<Variable *> &changed, double *level, double *rate, double *aux,
+                            const std::vector<int> *columns) const {
+  if (checkpoints.iNLevel != iNLevel || checkpoints.iNAux != iNAux || checkpoints.dStart != dStart ||
+      checkpoints.dDT != dDT)
     return false;
+  double from = FirstChange(changed);
+  const SimulationCheckpoints::Checkpoint *resume = NULL;
+  for (const SimulationCheckpoints::Checkpoint &checkpoint : checkpoints.vCheckpoints) {
+    if (checkpoint.time < from && checkpoint.step <= iSteps)
+      resume = &checkpoint;
+  }
+  return Simulate(&sink, 1, checkpoints.iSeed, checkpoints.iStream, level, rate, aux, columns, NULL, resume,
+                  checkpoints.iUnchangingDraws);
+}
+
+bool SimulationPlan::Profile(SimulationSink *sink, SimulationProfile *profile, uint64_t seed, uint64_t stream,
+                             double *level, double *rate, double *aux, const std::vector<int> *columns) const {
+  profile->vCodes.clear();
+  profile->vEntries.clear();
+  bool ok = Simulate(&sink, 1, seed, stream, level, rate, aux, columns, NULL, NULL, 0, profile);
+  profile->Finish(pModel);
+  return ok;
+}
+
+bool SimulationPlan::Simulate(SimulationSink *const *sinks, int lanes, uint64_t seed, uint64_t stream,
+                              double *level, double *rate, double *aux, const std::vector<int> *columns,
+                              SimulationCheckpoints *take, const SimulationCheckpoints::Checkpoint *resume,
+                              uint64_t unchangingDraws, SimulationProfile *profile,
+                              const std::vector<ExpressionCode::Setting> *settings) const {
+  const Code &code = lanes > 1 ? mLaneCode : mCode;
+  std::vector<ContextInfo> infos(lanes);  // the code takes one for each lane
+  for (int lane = 0; lane < lanes; lane++) {
+    ContextInfo &info = infos[lane];
+    info.pSymbolNameSpace = pSymbolNameSpace;
+    info.SetModel(pModel);
+    info.SetRandomStream(seed, stream + lane);
+    info.SetDT(dDT);
+  }
+  ContextInfo &info = infos[0];  // what checkpoints are taken from, as they only come one lane at a time
+  ExpressionCode::Scratch scratch;
+  auto setTime = [&](double t) {
+    for (ContextInfo &lane : infos)
+      lane.SetTime(t);
+    if (iTime >= 0)
+      std::fill(aux + iTime * lanes, aux + (iTime + 1) * lanes, t);
+  };
+  auto run = [&](const ExpressionCode &code, int computeType) {
+    for (ContextInfo &lane : infos)
+      lane.iComputeType = computeType;
+    if (profile)
+      profile->Add(code,
+                   computeType == CF_active ? SimulationProfile::PHASE_ACTIVE
+                   : computeType == CF_rate ? SimulationProfile::PHASE_RATE
+                                            : SimulationProfile::PHASE_INITIAL,
+                   infos.data(), level, rate, aux, &scratch);
+    else if (settings && computeType != CF_active && computeType != CF_rate)  // only the codes run once set parameters
+      code.Run(infos.data(), level, rate, aux, &scratch, *settings);
+    else
+      code.Run(infos.data(), level, rate, aux, &scratch);
+  };
+  auto failed = [&]() {
+    return std::any_of(infos.begin(), infos.end(), [](ContextInfo &lane) { return lane.EvalFailed(); });
+  };
+
+  std::vector<std::string> names;
+  names.push_back(vNames[0]);
+  if (columns) {
+    for (int col : *columns)
+      names.push_back(vNames[col + 1]);
+  } else {
+    names.insert(names.end(), vNames.begin() + 1, vNames.end());
+  }
+  long first = resume ? resume->step : 0;
+  long firstSaved = (first + iSaveEvery - 1) / iSaveEvery;  // the first step recorded is this * iSaveEvery
+  for (int lane = 0; lane < lanes; lane++)
+    sinks[lane]->Begin(names, iSteps / iSaveEvery - firstSaved + (iSteps % iSaveEvery ? 2 : 1));
+  std::vector<double> row(names.size());
+  auto record = [&](double t) {
+    for (int lane = 0; lane < lanes; lane++) {
+      double *value = row.data();
+      *value++ = t;
+      if (columns) {
+        for (int col : *columns) {
+          const Column &column = vColumns[col];
+          *value++ = (column.bLevel ? level : aux)[column.offset * lanes + lane];
+        }
+      } else {
+        for (const Column &column : vColumns)
+          *value++ = (column.bLevel ? level : aux)[column.offset * lanes + lane];
+      }
+      sinks[lane]->Record(row.data());
+    }
+  };
+
+  // anything no equation sets starts out as the model has it
+  auto spread = [&](const double *from, double *to, int count) {
+    if (from == to)
+      return;
+    for (int i = 0; i < count; i++)
+      std::fill(to + i * lanes, to + (i + 1) * lanes, from[i]);
+  };
+  spread(pLevel, level, iNLevel);
+  spread(pRate, rate, iNLevel);
+  spread(pAux, aux, iNAux);
+  if (resume) {
+    // as the run was at the checkpoint, but with this plan's constants
+    std::copy(resume->level.begin(), resume->level.end(), level);
+    std::copy(resume->aux.begin(), resume->aux.end(), aux);
+    run(code.mInitialTime, CF_initial);
+    setTime(dStart);
+    info.SetRandomDraws(unchangingDraws);
+    run(code.mUnchanging, CF_unchanging);
+    info.SetRandomDraws(resume->draws);
+  } else {
+    run(code.mInitialTime, CF_initial);
+    setTime(dStart);
+    run(code.mInitial, CF_initial);
+    unchangingDraws = info.RandomDraws();
+    run(code.mUnchanging, CF_unchanging);
+  }
+  if (failed())
+    return false;
+
+  long every = 0;
+  if (take) {
+    take->vCheckpoints.clear();
+    take->iSeed = seed;
+    take->iStream = stream;
+    take->iUnchangingDraws = unchangingDraws;
+    take->dStart = dStart;
+    take->dDT = dDT;
+    take->iNLevel = iNLevel;
+    take->iNAux = iNAux;
+    if (take->dInterval > 0)
+      every = std::max(1L, static_cast<long>(take->dInterval / dDT + 0.5));
+  }
+  // the levels and rates of all the lanes are advanced together
+  int n = iNLevel * lanes;
+  std::vector<double> level0;
+  std::vector<double> k1, k2, k3, k4;
+  double dt = dDT;
+  for (long step = first;; step++) {
+    double t = dStart + step * dt;
+    if (every && step % every == 0 && step < iSteps) {
+      SimulationCheckpoints::Checkpoint checkpoint;
+      checkpoint.step = step;
+      checkpoint.time = t;
+      checkpoint.draws = info.RandomDraws();
+      checkpoint.level.assign(level, level + iNLevel);
+      checkpoint.aux.assign(aux, aux + iNAux);
+      take->vCheckpoints.push_back(std::move(checkpoint));
+    }
+    setTime(t);
+    run(code.mActive, CF_active);
+    if (step % iSaveEvery == 0 || step == iSteps)
+      record(t);
+    if (step == iSteps)
+      break;
+    run(code.mRates, CF_rate);
+    // the rings move on once a step, with the input from its start - the
+    // later stages of a Runge-Kutta step see what is due out at its end
+    run(code.mShifts, CF_rate);
+    if (iIntegrationType == Integration_Type_EULER) {
+      Advance(level, level, dt, rate, n);
+    } else {
+      // the stages evaluate the model again at the intermediate levels
+      auto stage = [&](double at, std::vector<double> &k) {
+        setTime(at);
+        run(code.mActive, CF_active);
+        run(code.mRates, CF_rate);
+        k.assign(rate, rate + n);
+      };
+      level0.assign(level, level + n);
+      k1.assign(rate, rate + n);
+      if (iIntegrationType == Integration_Type_RK2) {  // Heun's method
+        Advance(level, level0.data(), dt, k1.data(), n);
+        stage(t + dt, k2);
+        Advance2(level, level0.data(), dt / 2, k1.data(), k2.data(), n);
+      } else {
+        Advance(level, level0.data(), dt / 2, k1.data(), n);
+        stage(t + dt / 2, k2);
+        Advance(level, level0.data(), dt / 2, k2.data(), n);
+        stage(t + dt / 2, k3);
+        Advance(level, level0.data(), dt, k3.data(), n);
+        stage(t + dt, k4);
+        Advance4(level, level0.data(), dt / 6, k1.data(), k2.data(), k3.data(), k4.data(), n);
+      }
+    }
+    if (failed())
+      return false;
+  }
+  if (failed())
+    return false;
+  for (int lane = 0; lane < lanes; lane++)
+    sinks[lane]->End();
   return true;
 }
 
+SimulationCheckpoints::SimulationCheckpoints(double interval) {
+  dInterval = interval;
+  iSeed = iStream = iUnchangingDraws = 0;
+  dStart = 0;
+  dDT = 1;
+  iNLevel = iNAux = 0;
+}
+
+uint64_t SimulationProfile::Ticks(void) const {
+  uint64_t ticks = 0;
+  for (const Entry &entry : vEntries)
+    ticks += entry.Ticks();
+  return ticks;
+}
+
+std::string SimulationProfile::Report(void) const {
+  std::string out = "Variable\tShare %\tTicks (";
+  out += ExpressionCode::TickUnit();
+  out += ")\tInitial\tActive\tRate\tInitial count\tActive count\tRate count\n";
+  uint64_t total = Ticks();
+  for (const Entry &entry : vEntries) {
+    out += entry.name;
+    out.push_back('\t');
+    AppendFixed(out, total ? 100.0 * entry.Ticks() / total : 0);
+    out += "\t" + std::to_string(entry.Ticks());
+    for (int phase = 0; phase < PHASE_COUNT; phase++)
+      out += "\t" + std::to_string(entry.ticks[phase]);
+    for (int phase = 0; phase < PHASE_COUNT; phase++)
+      out += "\t" + std::to_string(entry.counts[phase]);
+    out.push_back('\n');
+  }
+  return out;
+}
+
+void SimulationProfile::Add(const ExpressionCode &code, int phase, ContextInfo *info, double *level, double *rate,
+                            double *aux, ExpressionCode::Scratch *scratch) {
+  Code *counts = NULL;
+  for (Code &c : vCodes) {
+    if (c.pCode == &code)
+      counts = &c;
+  }
+  if (!counts) {
+    vCodes.push_back(Code());
+    counts = &vCodes.back();
+    counts->pCode = &code;
+    counts->vTicks.assign(code.Equations(), 0);
+    counts->iRuns = 0;
+    counts->iPhase = phase;
+  }
+  code.Profile(info, level, rate, aux, scratch, counts->vTicks.data());
+  counts->iRuns++;
+}
+
+void SimulationProfile::Finish(Model *model) {
+  // a variable's initial and active equations go in the one entry
+  std::unordered_map<Variable *, size_t> found;
+  for (const Code &c : vCodes) {
+    for (size_t i = 0; i < c.vTicks.size(); i++) {
+      Variable *var = c.pCode->GetEquation(i)->GetVariable();
+      auto it = found.find(var);
+      if (it == found.end()) {
+        it = found.emplace(var, vEntries.size()).first;
+        Entry entry;
+        entry.var = var;
+        entry.name = model->ProfileName(var);
+        std::fill(entry.ticks, entry.ticks + PHASE_COUNT, 0);
+        std::fill(entry.counts, entry.counts + PHASE_COUNT, 0);
+        vEntries.push_back(entry);
+      }
+      Entry &entry = vEntries[it->second];
+      entry.ticks[c.iPhase] += c.vTicks[i];
+      entry.counts[c.iPhase] += c.iRuns;
+    }
+  }
+  vCodes.clear();
+  std::sort(vEntries.begin(), vEntries.end(), [](const Entry &a, const Entry &b) {
+    return a.Ticks() != b.Ticks() ? a.Ticks() > b.Ticks() : a.name < b.name;
+  });
+}
+
+SimulationColumns::SimulationColumns(size_t chunkRows, ChunkCallback chunk, void *context) {
+  pChunk = chunk;
+  pContext = context;
+  iChunkRows = chunk ? chunkRows : 0;
+  iCapacity = iRows = 0;
+}
+
+void SimulationColumns::Begin(const std::vector<std::string> &names, size_t rows) {
+  vNames = names;
+  iCapacity = std::max<size_t>(1, iChunkRows && iChunkRows < rows ? iChunkRows : rows);
+  vValues.resize(iCapacity * names.size());
+  iRows = 0;
+}
+
+void SimulationColumns::Record(const double *values) {
+  if (iRows == iCapacity) {
+    if (pChunk) {
+      pChunk(*this, pContext);
+      iRows = 0;
+    } else {  // more rows than Begin said - spread the columns out
+      std::vector<double> more(2 * iCapacity * vNames.size());
+      for (size_t col = 0; col < vNames.size(); col++)
+        std::copy(Column(col), Column(col) + iRows, more.data() + col * 2 * iCapacity);
+      vValues.swap(more);
+      iCapacity *= 2;
+    }
+  }
+  for (size_t col = 0; col < vNames.size(); col++)
+    vValues[col * iCapacity + iRows] = values[col];
+  iRows++;
+}
+
+void SimulationColumns::End(void) {
+  if (pChunk && iRows) {
+    pChunk(*this, pContext);
+    iRows = 0;
+  }
+}
+
 bool Model::OutputComputable(bool wantshort) {
   ContextInfo info;
   try {
@@ -296,24 +1555,15 @@ bool Model::OutputComputable(bool wantshort) {
 
 bool Model::MarkVariableTypes(SymbolNameSpace *ns) {
   try {
-    SymbolNameSpace::HashTable *ht;
-    if (ns)
-      ht = ns->GetHashTable();
-    else {
-      ht = mSymbolNameSpace.GetHashTable();
+    if (!ns)
       ns = &mSymbolNameSpace;
-    }
-    std::vector<Variable *> vars;
-    for (const SymbolNameSpace::iterator &it : *ht) {
-      Symbol *sym = SNSitToSymbol(it);
-
-      if (sym->isType() == Symtype_Variable)
-        vars.push_back(static_cast<Variable *>(sym));
-    }
+    std::vector<Variable *> vars = ns->Variables();  // a copy - MarkFlows may add more
     //
     for (Variable *var : vars) {
       var->MarkFlows(ns);  // may change number of entries so can't be in above loop
     }
+    if (ns == &mSymbolNameSpace)
+      mGraph.Clear();  // flows and stocks are only known now
     // don't do this - we have broken the allocation setup mSymbolNameSpace.ConfirmAllAllocations();
   } catch (...) {
     ns->DeleteAllUnconfirmedAllocations();
@@ -324,17 +1574,11 @@ bool Model::MarkVariableTypes(SymbolNameSpace *ns) {
   // - dump eveything - mostly just to see how the translation is going
   ContextInfo info;
 
-  SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-  for (const SymbolNameSpace::iterator &it : *ht) {
-    Symbol *sym = SNSitToSymbol(it);
-
-    if (sym->isType() == Symtype_Variable) {
-      Variable *var = static_cast<Variable *>(sym);
-      VariableContent *content = var->Content();
-      if (content) {  // array elements don't have
-        for (Equation *eq : content->GetAllEquations()) {
-          eq->OutputComputable(&info);
-        }
+  for (Variable *var : mSymbolNameSpace.Variables()) {
+    VariableContent *content = var->Content();
+    if (content) {  // array elements don't have
+      for (Equation *eq : content->GetAllEquations()) {
+        eq->OutputComputable(&info);
       }
     }
   }
@@ -343,18 +1587,130 @@ bool Model::MarkVariableTypes(SymbolNameSpace *ns) {
   return true;
 }
 
-void Model::AttachStragglers() {
-  SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-  std::vector<Variable *> vars;
-  for (const SymbolNameSpace::iterator &it : *ht) {
-    Symbol *sym = SNSitToSymbol(it);
+// whether a stock has var as an inflow or an outflow
+static bool ListedAsFlow(SymbolNameSpace *sns, Variable *var) {
+  for (Variable *stock : sns->Variables()) {
+    if (stock->VariableType() != XMILE_Type_STOCK)
+      continue;
+    std::vector<Variable *> &ins = stock->Inflows();
+    std::vector<Variable *> &outs = stock->Outflows();
+    if (std::find(ins.begin(), ins.end(), var) != ins.end() || std::find(outs.begin(), outs.end(), var) != outs.end())
+      return true;
+  }
+  return false;
+}
+
+// whether marking eq's variable changes others, in a way that can't be
+// taken back - subscript owners, a number table's expansion or the tables
+// LOOKUP EXTRAPOLATE sets extrapolating
+static bool MarksOthers(Equation *eq) {
+  Expression *exp = eq->GetExpression();
+  switch (exp->GetType()) {
+  case EXPTYPE_Symlist:
+  case EXPTYPE_NumberTable:
+    return true;
+  case EXPTYPE_Table:
+    return static_cast<ExpressionTable *>(exp)->Extrapolate();
+  case EXPTYPE_Function:
+    return static_cast<ExpressionFunction *>(exp)->GetFunction()->GetName() == "LOOKUP EXTRAPOLATE";
+  default:
+    return false;
+  }
+}
+
+// a variable's flows once it is a stock, or one that was
+static void Flows(Variable *var, std::vector<Variable *> &flows) {
+  flows = var->Inflows();
+  flows.insert(flows.end(), var->Outflows().begin(), var->Outflows().end());
+}
 
-    if (sym->isType() == Symtype_Variable)
-      vars.push_back(static_cast<Variable *>(sym));
+bool Model::ReplaceEquation(Equation *was, Equation *eq) {
+  Variable *var = was->GetVariable();
+  XMILE_Type type = var->VariableType();
+  if (eq->GetVariable() != var || var->GetSymbolNameSpace() != &mSymbolNameSpace || type == XMILE_Type_ARRAY ||
+      type == XMILE_Type_ARRAY_ELM || MarksOthers(eq))
+    return false;
+  std::vector<Equation *> equations = var->GetAllEquations();
+  std::vector<Equation *>::iterator it = std::find(equations.begin(), equations.end(), was);
+  if (it == equations.end())
+    return false;
+  for (Equation *other : equations) {
+    if (MarksOthers(other))
+      return false;
+  }
+  // a stock that is also another's flow got whichever type was marked last
+  if (type == XMILE_Type_STOCK && ListedAsFlow(&mSymbolNameSpace, var))
+    return false;
+  std::vector<Variable *> flows;
+  Flows(var, flows);
+  std::string net = var->GetName() + " net flow";
+  for (Variable *flow : flows) {
+    if (flow->VariableType() == XMILE_Type_STOCK || !flow->Inflows().empty() || !flow->Outflows().empty() ||
+        !flow->GetName().compare(0, net.size(), net))
+      return false;
+  }
+  // the flows it gains were marked as what they are without it
+  std::vector<Variable *> used;
+  eq->GetVarsUsed(used);
+  std::vector<XMILE_Type> types;
+  for (Variable *v : used)
+    types.push_back(v->VariableType());
+
+  *it = eq;
+  var->Content()->SetAllEquations(equations);
+  var->Inflows().clear();
+  var->Outflows().clear();
+  if (type != XMILE_Type_FLOW)  // a flow stays one whatever its equation
+    var->SetVariableType(XMILE_Type_UNKNOWN);
+  size_t count = mSymbolNameSpace.Symbols().size();
+  XMILE_Type now = var->MarkFlows(&mSymbolNameSpace);
+  if (mSymbolNameSpace.Symbols().size() != count || (type == XMILE_Type_FLOW && now == XMILE_Type_STOCK))
+    return false;  // a net flow, or a flow that is a stock
+  mGraph.Clear();
+  std::vector<Variable *> gained;
+  Flows(var, gained);
+  for (Variable *flow : gained) {
+    size_t i = std::find(used.begin(), used.end(), flow) - used.begin();
+    if (i == used.size() || types[i] == XMILE_Type_STOCK || !flow->Inflows().empty() || !flow->Outflows().empty())
+      return false;
+  }
+  // those it lost are what they are without it unless another stock has them
+  for (Variable *flow : flows) {
+    if (std::find(gained.begin(), gained.end(), flow) != gained.end() || ListedAsFlow(&mSymbolNameSpace, flow))
+      continue;
+    flow->SetVariableType(XMILE_Type_UNKNOWN);
+    if (flow->MarkFlows(&mSymbolNameSpace) == XMILE_Type_STOCK)
+      return false;
   }
+  return true;
+}
+
+const ModelGraph &Model::Graph(void) {
+  if (!mGraph.Built())
+    mGraph.Build(&mSymbolNameSpace);
+  return mGraph;
+}
+
+// Time and the simulation specs aren't drawn in the XMILE views
+static bool Drawn(Variable *var) {
+  static const char *const hidden[] = {"Time", "INITIAL TIME", "FINAL TIME", "TIME STEP", "SAVEPER"};
+  for (const char *name : hidden) {
+    if (StringMatch(var->GetName(), name))
+      return false;
+  }
+  return true;
+}
+
+void Model::AttachStragglers() {
+  const ModelGraph &graph = Graph();
+  const std::vector<Variable *> &vars = graph.Variables();
   // first try - anything that is not defined somewhere see if a ghost appears somewhere
   // and change that to the definition
+  // each loop over the variables gives up once the conversion's limits
+  // are hit - the conversion fails then so it doesn't matter where
   for (Variable *var : vars) {
+    if (ConversionLimits::Stop())
+      return;
     if (!var->GetView()) {
       for (View *view : vViews) {
         if (view->UpgradeGhost(var))
@@ -365,26 +1721,17 @@ void Model::AttachStragglers() {
   // now try undefined flows - attach to associated stocks
   for (Variable *var : vars) {
     if (!var->GetView() && var->VariableType() == XMILE_Type_FLOW) {
-      // we don't know flows uses so just look at all stocks
       Variable *upstream = NULL;
       Variable *downstream = NULL;
-      for (Variable *stock : vars) {
-        if (stock->VariableType() == XMILE_Type_STOCK) {
-          for (Variable *in : stock->Inflows()) {
-            if (in == var) {
-              downstream = stock;
-              break;
-            }
-          }
-          for (Variable *out : stock->Outflows()) {
-            if (out == var) {
-              upstream = stock;
-              break;
-            }
-          }
-          if (upstream && downstream)
-            break;
-        }
+      for (Variable *stock : graph.Stocks(var)) {
+        std::vector<Variable *> &ins = stock->Inflows();
+        std::vector<Variable *> &outs = stock->Outflows();
+        if (std::find(ins.begin(), ins.end(), var) != ins.end())
+          downstream = stock;
+        if (std::find(outs.begin(), outs.end(), var) != outs.end())
+          upstream = stock;
+        if (upstream && downstream)
+          break;
       }
       if (upstream && upstream->GetView()) {
         upstream->GetView()->AddFlowDefinition(var, upstream, downstream);
@@ -395,13 +1742,35 @@ void Model::AttachStragglers() {
   }
   // next pass look for inputs - if there are any put the var next to them
   // next pass look for otuputs - if there are any put the var next to them
-  // finally dump everything remaining at 40,40 on the first view
+  // (each pass can put things next to what it has just put down)
+  for (int pass = 0; pass < 2; pass++) {
+    for (Variable *var : vars) {
+      if (ConversionLimits::Stop())
+        return;
+      if (var->GetView() || var->VariableType() == XMILE_Type_ARRAY || var->VariableType() == XMILE_Type_ARRAY_ELM ||
+          var->VariableType() == XMILE_Type_UNKNOWN || !Drawn(var))
+        continue;
+      const std::vector<Variable *> &near = pass ? graph.Outputs(var) : graph.Inputs(var);
+      for (Variable *other : near) {
+        if (other->GetView() && other->GetView()->AddVarDefinitionNear(var, near, !pass))
+          break;
+      }
+    }
+  }
+  // finally dump everything remaining around 200,200 on the first view -
+  // what isn't drawn just at 200,200 so it doesn't push the rest about
   if (!vViews.empty()) {
     View *dump_view = vViews[0];
     for (Variable *var : vars) {
+      if (ConversionLimits::Stop())
+        return;
       if (!var->GetView() && var->VariableType() != XMILE_Type_ARRAY && var->VariableType() != XMILE_Type_ARRAY_ELM &&
-          var->VariableType() != XMILE_Type_UNKNOWN)
-        dump_view->AddVarDefinition(var, 200, 200);
+          var->VariableType() != XMILE_Type_UNKNOWN) {
+        if (Drawn(var))
+          dump_view->AddVarDefinitionAround(var, 200, 200);
+        else
+          dump_view->AddVarDefinition(var, 200, 200);
+      }
     }
   }
 
@@ -411,6 +1780,39 @@ void Model::AttachStragglers() {
   }
 }
 
+std::string Model::ProfileName(Variable *var) const {
+  std::string part;
+  Variable *owner = NULL;
+  std::vector<Variable *>::const_iterator it = std::find(vUnamedVars.begin(), vUnamedVars.end(), var);
+  if (it != vUnamedVars.end()) {
+    size_t i = it - vUnamedVars.begin();
+    owner = i < vUnamedOwners.size() ? vUnamedOwners[i] : NULL;
+    Expression *e = var->GetAllEquations().empty() ? NULL : var->GetAllEquations()[0]->GetExpression();
+    if (e && e->GetFunction())
+      part = e->GetFunction()->GetName();
+  } else if ((it = std::find(vMacroVars.begin(), vMacroVars.end(), var)) != vMacroVars.end()) {
+    owner = vMacroOwners[it - vMacroVars.begin()];
+    // the body's variable or the argument of the use it is bound to
+    for (const MacroInstance &use : dMacroInstances) {
+      int slot = use.BoundSlot(var);
+      if (slot < 0)
+        continue;
+      MacroFunction *macro = use.Macro();
+      part = macro->GetName();
+      if (slot >= macro->ComputedCount())
+        part += " argument " + std::to_string(slot - macro->ComputedCount() + 1);
+      else if (slot != macro->Output())
+        part += " " + macro->Slots()[slot]->GetName();
+      break;
+    }
+  } else
+    return var->GetAlternateName();
+  std::string name = owner ? owner->GetAlternateName() : std::string();
+  if (!part.empty())
+    name += (name.empty() ? "(" : " (") + part + ")";
+  return name.empty() ? "(unnamed)" : name;
+}
+
 bool Model::RenameVariable(Variable *v, const std::string &newname) {
   assert(!newname.empty());
   if (mSymbolNameSpace.Find(newname)) {
@@ -418,27 +1820,94 @@ bool Model::RenameVariable(Variable *v, const std::string &newname) {
       return true;  // nothing to do
     return false;
   }
-  if (!mSymbolNameSpace.Remove(v))
+  if (!mSymbolNameSpace.Rename(v, newname))
     return false;
-  v->SetName(newname);
-  mSymbolNameSpace.Insert(v);
+  mSubscriptElements.clear();
+  mElementIndex.clear();
+  mElementCount.clear();
   return true;
 }
 
+const std::vector<Symbol *> &Model::SubscriptElements(Symbol *s) {
+#ifndef XMUTIL_NO_THREADS
+  std::lock_guard<std::mutex> lock{mSubscriptLock};  // the map's nodes stay put so what is returned stays valid
+#endif
+  std::unordered_map<Symbol *, std::vector<Symbol *>>::iterator it = mSubscriptElements.find(s);
+  if (it != mSubscriptElements.end())
+    return it->second;
+  std::vector<Symbol *> elms;
+  Equation::GetSubscriptElements(elms, s);
+  return mSubscriptElements.emplace(s, std::move(elms)).first->second;
+}
+
+size_t Model::ElementCount(Symbol *owner) {
+  const std::vector<Symbol *> &elms = SubscriptElements(owner);
+#ifndef XMUTIL_NO_THREADS
+  std::lock_guard<std::mutex> lock{mSubscriptLock};
+#endif
+  std::unordered_map<Symbol *, size_t>::iterator it = mElementCount.find(owner);
+  if (it != mElementCount.end())
+    return it->second;
+  size_t count = 0;
+  for (Symbol *elm : elms) {
+    if (mElementIndex.emplace(elm, count).second)
+      count++;
+  }
+  mElementCount.emplace(owner, count);
+  return count;
+}
+
+size_t Model::ElementIndex(Symbol *elm) {
+  Symbol *owner = elm->Owner();
+  ElementCount(owner);
+#ifndef XMUTIL_NO_THREADS
+  std::lock_guard<std::mutex> lock{mSubscriptLock};
+#endif
+  std::unordered_map<Symbol *, size_t>::iterator it = mElementIndex.find(elm);
+  if (it != mElementIndex.end())
+    return it->second;
+  // not one of its owner's elements - it goes after them
+  size_t &count = mElementCount[owner];
+  mElementIndex.emplace(elm, count);
+  return count++;
+}
+
+ElementSet Model::SubscriptSet(Symbol *s) {
+  ElementSet set{ElementCount(s->Owner())};
+  for (Symbol *elm : SubscriptElements(s))
+    set.Add(ElementIndex(elm));
+  return set;
+}
+
+// expand every subscript range in one pass so that later lookups never
+// walk the definitions again
+void Model::CacheSubscriptElements(void) {
+  for (Variable *s : mSymbolNameSpace.Variables()) {
+    const std::vector<Equation *> &eqs = s->GetAllEquations();
+    Expression *exp = eqs.size() == 1 ? eqs[0]->GetExpression() : NULL;
+    if (!exp || exp->GetType() != EXPTYPE_Symlist)
+      continue;
+    SubscriptElements(s);
+    SymbolList *symlist = static_cast<ExpressionSymbolList *>(exp)->SymList();
+    int n = symlist->Length();
+    for (int i = 0; i < n; i++) {
+      const SymbolList::SymbolListEntry &elm = (*symlist)[i];
+      if (elm.eType == SymbolList::EntryType_SYMBOL)
+        SubscriptElements(elm.u.pSymbol);
+    }
+  }
+}
+
 void Model::GenerateCanonicalNames(void) {
   assert(0);
 }
 
 void Model::GenerateShortNames(void) {
   size_t i = 0;
-  SymbolNameSpace::HashTable *ht = mSymbolNameSpace.GetHashTable();
-  for (const SymbolNameSpace::iterator &it : *ht) {
-    Variable *v = static_cast<Variable *>(SNSitToSymbol(it));
-    if (v->isType() == Symtype_Variable) {
-      std::string s = "v" + std::to_string(i);
-      i++;
-      v->SetAlternateName(s);
-    }
+  for (Variable *v : mSymbolNameSpace.Variables()) {
+    std::string s = "v" + std::to_string(i);
+    i++;
+    v->SetAlternateName(s);
   }
   for (auto v : vUnamedVars) {
     std::string s = "v" + std::to_string(i);
@@ -480,21 +1949,10 @@ void Model::SetUnwanted(const char *str, const char *defname) {
 }
 
 std::vector<Variable *> Model::GetVariables(SymbolNameSpace *ns) {
-  std::vector<Variable *> vars;
-  SymbolNameSpace::HashTable *ht;
-  if (ns)
-    ht = ns->GetHashTable();
-  else
-    ht = mSymbolNameSpace.GetHashTable();
-  for (auto it = ht->begin(); it != ht->end(); it++) {
-    Symbol *s = it->second;
-    if (s->isType() == Symtype_Variable)
-      vars.push_back(static_cast<Variable *>(s));
-  }
-  return vars;
+  return ns ? ns->Variables() : mSymbolNameSpace.Variables();
 }
 
-std::string Model::PrintXMILE(bool isCompact, std::vector<std::string> &errs) {
+void Model::PrintXMILE(XMILEWriter *writer, std::vector<std::string> &errs) {
   XMILEGenerator generator(this);
-  return generator.Print(isCompact, errs);
+  generator.Print(writer, errs);
 }
@@ -1,16 +1,335 @@
 #ifndef _XMUTIL_MODEL_H
 #define _XMUTIL_MODEL_H
+#include <stdint.h>
+
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "ModelGraph.h"
+#include "Symbol/ElementSet.h"
 #include "Symbol/Expression.h"
+#include "Symbol/ExpressionCode.h"
+#include "Symbol/SymbolArena.h"
 #include "Symbol/Variable.h"
+#include "XMUtil.h"
+#ifndef XMUTIL_NO_THREADS
+#include <mutex>
+#endif
+
+class XMILEWriter;
 
 enum Integration_Type { Integration_Type_EULER, Integration_Type_RK2, Integration_Type_RK4 };
+
+/* what SimulationPlan::Run hands what it records to - a row at each saved
+   time holding Time and then the columns the run was asked for */
+class SimulationSink {
+public:
+  virtual ~SimulationSink() {
+  }
+  // before the first row - rows is how many there will be
+  virtual void Begin(const std::vector<std::string> &names, size_t rows) = 0;
+  virtual void Record(const double *values) = 0;  // one for each name
+  virtual void End(void) {  // after the last row of a run that got through
+  }
+};
+
+/* what Model::Simulate records - a row for each saved time holding Time
+   and then the value of every variable in vNames (vNames[0] is Time) */
+class SimulationResults : public SimulationSink {
+public:
+  std::vector<std::string> vNames;
+  std::vector<double> vValues;  // row after row
+  void Begin(const std::vector<std::string> &names, size_t rows) override {
+    vNames = names;
+    vValues.clear();
+    vValues.reserve(rows * names.size());
+  }
+  void Record(const double *values) override {
+    vValues.insert(vValues.end(), values, values + vNames.size());
+  }
+  size_t Rows(void) const {
+    return vNames.empty() ? 0 : vValues.size() / vNames.size();
+  }
+  double Value(size_t row, size_t col) const {
+    return vValues[row * vNames.size() + col];
+  }
+};
+
+/* the same kept as a contiguous column per name, in a buffer sized when
+   the run begins.  Given a chunk callback only chunkRows rows are held -
+   each time they fill (and at the end) they go to the callback and the
+   buffer starts over, so a long run with a fine TIME STEP takes no more
+   memory than a short one */
+class SimulationColumns : public SimulationSink {
+public:
+  typedef void (*ChunkCallback)(const SimulationColumns &columns, void *context);
+  // a chunkRows of 0 holds the whole run
+  SimulationColumns(size_t chunkRows = 0, ChunkCallback chunk = NULL, void *context = NULL);
+  const std::vector<std::string> &Names(void) const {
+    return vNames;
+  }
+  size_t Rows(void) const {  // held just now
+    return iRows;
+  }
+  const double *Column(size_t col) const {  // Rows() values
+    return vValues.data() + col * iCapacity;
+  }
+  void Begin(const std::vector<std::string> &names, size_t rows) override;
+  void Record(const double *values) override;
+  void End(void) override;
+
+private:
+  std::vector<std::string> vNames;
+  std::vector<double> vValues;  // column after column, each iCapacity long
+  ChunkCallback pChunk;
+  void *pContext;
+  size_t iChunkRows;
+  size_t iCapacity;
+  size_t iRows;
+};
+
+class Model;
+
+// how many runs go in step when a batch of them is asked for (see
+// SimulationPlan::RunLanes) - a vector register's worth of doubles or more
+#ifdef __AVX512F__
+#define SIMULATION_LANES 8
+#else
+#define SIMULATION_LANES 4
+#endif
+
+/* snapshots SimulationPlan::Run takes of a run every so often, each all a
+   run needs to carry on from the start of its step: the levels, the
+   auxiliaries (which hold the delays' rings) and how far the random stream
+   has got.  A plan compiled from the same model with only some constants
+   changed can Resume from the last one taken before the change can first
+   make a difference, rather than run again from INITIAL TIME */
+class SimulationCheckpoints {
+public:
+  // one every interval of model time, rounded to whole steps - 0 takes none
+  SimulationCheckpoints(double interval = 0);
+  size_t Count(void) const {
+    return vCheckpoints.size();
+  }
+  double Time(size_t i) const {  // when the ith was taken
+    return vCheckpoints[i].time;
+  }
+
+private:
+  friend class SimulationPlan;
+  struct Checkpoint {
+    long step;
+    double time;
+    uint64_t draws;
+    std::vector<double> level;
+    std::vector<double> aux;
+  };
+  std::vector<Checkpoint> vCheckpoints;
+  double dInterval;
+  // what the run was, so a resumed one draws the same numbers
+  uint64_t iSeed;
+  uint64_t iStream;
+  uint64_t iUnchangingDraws;  // the draws before the unchanging equations ran
+  // and the plan's layout, which has to match
+  double dStart;
+  double dDT;
+  int iNLevel;
+  int iNAux;
+};
+
+/* where a run's time went, for SimulationPlan::Profile - the ticks of
+   ExpressionCode::Ticks spent computing each variable, split by phase:
+   initial is INITIAL TIME through the unchanging equations, active the
+   auxiliaries each step and rate the flows (both once for every stage of
+   a Runge-Kutta step).  Timing every equation on its own adds a little to
+   each, so the totals come out above those of an unprofiled run.  The
+   entries point into the model, as the plan does */
+class SimulationProfile {
+public:
+  enum Phase { PHASE_INITIAL, PHASE_ACTIVE, PHASE_RATE, PHASE_COUNT };
+  struct Entry {
+    Variable *var;
+    std::string name;              // see Model::ProfileName
+    uint64_t ticks[PHASE_COUNT];   // spent computing it
+    uint64_t counts[PHASE_COUNT];  // times it was computed
+    uint64_t Ticks(void) const {
+      return ticks[PHASE_INITIAL] + ticks[PHASE_ACTIVE] + ticks[PHASE_RATE];
+    }
+  };
+  // a variable for each equation that ran, the most ticks first
+  const std::vector<Entry> &Entries(void) const {
+    return vEntries;
+  }
+  uint64_t Ticks(void) const;  // over all of them
+  // a tab separated table of the entries - a header line, then a line for
+  // each with its share of the ticks, the ticks in each phase and the
+  // counts
+  std::string Report(void) const;
+
+private:
+  friend class SimulationPlan;
+  struct Code {
+    const ExpressionCode *pCode;
+    std::vector<uint64_t> vTicks;  // for each of its equations
+    uint64_t iRuns;
+    int iPhase;
+  };
+  // runs code as ExpressionCode::Run does, timing it
+  void Add(const ExpressionCode &code, int phase, ContextInfo *info, double *level, double *rate, double *aux,
+           ExpressionCode::Scratch *scratch);
+  void Finish(Model *model);  // gathers the ticks into entries
+  std::vector<Code> vCodes;  // while the run goes - only a few
+  std::vector<Entry> vEntries;
+};
+
+/* a model made ready to simulate by Model::Compile - its equations as code
+   and the layout of the level, rate and aux arrays the code runs against.
+   A run changes nothing in the plan, so when it is Shared any number of
+   runs can go at once from different threads, each with arrays of its own.
+   It points into the model so mustn't outlive it */
+class SimulationPlan {
+public:
+  SimulationPlan(void);
+  // how many values each of a run's arrays needs - the rate array is the
+  // same size as the level array
+  int LevelCount(void) const {
+    return iNLevel;
+  }
+  int AuxCount(void) const {
+    return iNAux;
+  }
+  // false if some of the code reads the model's own arrays, leaving runs
+  // to use those (see Run) one at a time
+  bool Shared(void) const;
+  // what Run records into, in order - Time first
+  const std::vector<std::string> &Names(void) const {
+    return vNames;
+  }
+  // those of Names after Time that the unchanging equations compute, so
+  // stay the same all through a run
+  const std::vector<int> &UnchangingColumns(void) const {
+    return vUnchangingColumns;
+  }
+  // where the variables named are among Names - all the elements of an
+  // arrayed one.  False if any of them isn't there
+  bool Columns(const std::vector<std::string> &names, std::vector<int> &columns) const;
+  // a run from INITIAL TIME to FINAL TIME in the arrays given, recording
+  // Time and columns (every name if columns is NULL) into sink.  The random functions
+  // draw from the stream of seed given, so a run's results depend on only
+  // the seed and stream whatever else is running.  Any checkpoints taken
+  // before are replaced by this run's.  False if the model turned out not
+  // to be computable
+  bool Run(SimulationSink *sink, uint64_t seed, uint64_t stream, double *level, double *rate, double *aux,
+           const std::vector<int> *columns = NULL, SimulationCheckpoints *checkpoints = NULL) const;
+  // the same in the model's own arrays - this is not thread safe
+  bool Run(SimulationSink *sink, uint64_t seed = 0, uint64_t stream = 0, const std::vector<int> *columns = NULL,
+           SimulationCheckpoints *checkpoints = NULL) const {
+    return Run(sink, seed, stream, pLevel, pRate, pAux, columns, checkpoints);
+  }
+  // carries on the run that took checkpoints, in a plan compiled from the
+  // same model with the constants changed given new values, from the last
+  // checkpoint before FirstChange for them - recording only the rows from
+  // there on, as those before are as that run recorded them but for the
+  // UnchangingColumns.  The unchanging equations run again, so the new
+  // values take effect.
+  // Without a checkpoint that early it is the whole run again, as Run with
+  // the same stream.  False if the plans' arrays aren't laid out the same,
+  // or as for Run
+  bool Resume(SimulationSink *sink, const SimulationCheckpoints &checkpoints, const std::vector<Variable *> &changed,
+              double *level, double *rate, double *aux, const std::vector<int> *columns = NULL) const;
+  bool Resume(SimulationSink *sink, const SimulationCheckpoints &checkpoints, const std::vector<Variable *> &changed,
+              const std::vector<int> *columns = NULL) const {
+    return Resume(sink, checkpoints, changed, pLevel, pRate, pAux, columns);
+  }
+  // the first time a step can start at which changing the constants given
+  // can make a difference - see Model::FirstChange
+  double FirstChange(const std::vector<Variable *> &changed) const;
+  // Run, timing each equation as it goes into profile - slower, and one
+  // run at a time even with lanes compiled
+  bool Profile(SimulationSink *sink, SimulationProfile *profile, uint64_t seed, uint64_t stream, double *level,
+               double *rate, double *aux, const std::vector<int> *columns = NULL) const;
+  bool Profile(SimulationSink *sink, SimulationProfile *profile, uint64_t seed = 0, uint64_t stream = 0,
+               const std::vector<int> *columns = NULL) const {
+    return Profile(sink, profile, seed, stream, pLevel, pRate, pAux, columns);
+  }
+  // how many runs RunLanes takes at once - 1 if the plan wasn't compiled
+  // for more, or its model can't run that way
+  int Lanes(void) const {
+    return iLanes;
+  }
+  // Lanes() runs in step, on streams stream to stream + Lanes() - 1 of seed,
+  // each recording into its own sink what Run would on its stream.  The
+  // arrays are Lanes() times the size Run takes, each value with its lanes
+  // together.  False as for Run, or if Lanes() is 1
+  bool RunLanes(SimulationSink *const *sinks, uint64_t seed, uint64_t stream, double *level, double *rate,
+                double *aux, const std::vector<int> *columns = NULL) const;
+  // Run with lanes of 1, RunLanes with Lanes(), but with the parameters at
+  // columns (as Columns gives them) taking values instead of the numbers
+  // the model has - values[i * lanes + lane] for parameters[i] - so each
+  // lane can run a different scenario.  The parameters are variables, or
+  // elements of them, whose equations are numbers, other than the control
+  // parameters.  Only for a plan compiled with parameters, and as for
+  // CodeGenerator's modules DELAY FIXED keeps the delay times it was
+  // compiled with.  False if one of parameters can't be set, or as for Run
+  bool RunWith(SimulationSink *const *sinks, int lanes, const std::vector<int> &parameters, const double *values,
+               uint64_t seed, uint64_t stream, double *level, double *rate, double *aux,
+               const std::vector<int> *columns = NULL) const;
+
+private:
+  friend class Model;
+  friend class CodeGenerator;
+  bool Simulate(SimulationSink *const *sinks, int lanes, uint64_t seed, uint64_t stream, double *level,
+                double *rate, double *aux, const std::vector<int> *columns, SimulationCheckpoints *take,
+                const SimulationCheckpoints::Checkpoint *resume, uint64_t unchangingDraws,
+                SimulationProfile *profile = NULL, const std::vector<ExpressionCode::Setting> *settings = NULL) const;
+  struct Column {
+    int offset;  // in the level array if bLevel, the aux array otherwise
+    bool bLevel;
+  };
+  // the equations as code, in the order they run
+  struct Code {
+    ExpressionCode mInitialTime;
+    ExpressionCode mInitial;
+    ExpressionCode mUnchanging;
+    ExpressionCode mActive;
+    ExpressionCode mRates;
+    ExpressionCode mShifts;  // DELAY FIXED takes in its input once a step
+  };
+  Code mCode;
+  Code mLaneCode;  // compiled for iLanes runs at once, if iLanes is more than 1
+  std::vector<std::string> vNames;
+  std::vector<Column> vColumns;  // those after Time
+  std::vector<int> vUnchangingColumns;
+  Model *pModel;
+  SymbolNameSpace *pSymbolNameSpace;
+  double *pLevel;  // the model's own arrays
+  double *pRate;
+  double *pAux;
+  Integration_Type iIntegrationType;
+  double dStart;
+  double dDT;
+  long iSteps;
+  long iSaveEvery;
+  int iTime;  // where Time is kept in the aux array, or -1
+  int iNLevel;
+  int iNAux;
+  int iLanes;
+  bool bParameters;  // compiled with parameters, so nothing fixed is folded into the code
+};
+
 class View {
 public:
+  virtual ~View() {
+  }
   virtual bool UpgradeGhost(Variable *var) = 0;
   virtual bool AddFlowDefinition(Variable *var, Variable *in, Variable *out) = 0;
   virtual bool AddVarDefinition(Variable *var, int x, int y) = 0;
+  virtual bool AddVarDefinitionAround(Variable *var, int x, int y) = 0;  // in the free space nearest x,y
+  // as AddVarDefinitionAround beside the ones of near on this view, to the
+  // right of them if after - false if there are none
+  virtual bool AddVarDefinitionNear(Variable *var, const std::vector<Variable *> &near, bool after) = 0;
   virtual void CheckLinksIn() = 0;
   // just a placeholder to derive from
 };
@@ -18,21 +337,106 @@ class Model {
 public:
   Model(void);
   ~Model(void);
-  bool UnitsCheck(void) {
-    return false;
-  }
+  // adds an XMUTIL_WARNING_UNITS diagnostic for each equation that doesn't
+  // fit the units given for its variable - false if there were any
+  bool UnitsCheck(std::vector<Diagnostic> &problems);
+  // adds an XMUTIL_WARNING_SIMULTANEOUS diagnostic for each loop of
+  // equations that can't be ordered - false if there were any.  It
+  // analyzes the equations, so nothing is written from the model after
+  bool LoopsCheck(std::vector<Diagnostic> &problems);
   bool AnalyzeEquations(void);
+  // runs the equations ordered by AnalyzeEquations from INITIAL TIME to
+  // FINAL TIME using IntegrationType() - false if the model uses anything
+  // that can't be evaluated yet (arrays not defined by a single equation,
+  // array functions, DELAY CONVEYOR and the like, or a delay whose size
+  // isn't known before the run, or a macro that can't be used the way it
+  // is - see MacroFunction::Ready - or is in an arrayed equation).  An
+  // arrayed variable gets a column per element, named as in
+  // stock[north,young]
+  bool Simulate(SimulationResults *results);
+  // compiles the model into plan once for any number of runs - false
+  // whenever Simulate would be because of what the model uses.  Given
+  // outputs (names as SimulationPlan::Columns takes them) only what those
+  // read, directly or through stocks and their flows, is computed and
+  // given columns - false if one isn't a variable.  With lanes more than 1
+  // the code is compiled a second time for SimulationPlan::RunLanes, if
+  // the model allows it.  With parameters what the unchanging equations
+  // compute is read from the aux array each step instead of being folded
+  // in as numbers, so a run is slower but those values can be changed
+  // before it (as CodeGenerator's modules do)
+  bool Compile(SimulationPlan *plan, const std::vector<std::string> *outputs = NULL, int lanes = 1,
+               bool parameters = false);
+  // the variable named if its equation is just a number, which becomes
+  // value (was given what it had) - NULL if it is anything else
+  Variable *SetConstant(const std::string &name, double value, double *was = NULL);
+  // for a run from start in steps of dt, the earliest a step can start and
+  // see anything different with the constants given changed, other than
+  // what the unchanging equations compute.  That is start unless all they
+  // change is gated by the times STEP, PULSE and RAMP start at (when those
+  // are numbers) - following what reads them through to everything
+  // computed from that, stocks included.  A change to a control parameter
+  // is always from start.  Only after Compile
+  double FirstChange(const std::vector<Variable *> &changed, double start, double dt);
+  // the loops of simultaneous equations the last AnalyzeEquations found,
+  // each the variables around it with every one reading the next
+  const std::vector<std::vector<Variable *>> &Simultaneous(void) const {
+    return vSimultaneous;
+  }
   SymbolNameSpace *GetNameSpace(void) {
     return &mSymbolNameSpace;
   }
+  // install with a SymbolArena::Scope around anything that builds or
+  // modifies the model so its objects are freed along with it
+  SymbolArena *Arena(void) {
+    return &mArena;
+  }
   Equation *AddUnnamedVariable(ExpressionFunctionMemory *e);
+  // once AnalyzeEquations has set up the uses of macros, the variable
+  // giving the value of the call with these arguments - NULL if none
+  Variable *MacroOutput(ExpressionList *args) const;
+  // the use of a macro var computes the body's equation for, NULL if var
+  // isn't one of a use's
+  const MacroInstance *MacroBinding(Variable *var) const;
+  // what a report calls var - its GetAlternateName, or for a placeholder
+  // or a macro's variable, which have none of their own, the name of the
+  // variable it is computed for with the function or macro it is part of,
+  // as in "flow (DELAY3)"
+  std::string ProfileName(Variable *var) const;
   bool RenameVariable(Variable *v, const std::string &newname);
+  // the elements a subscript range stands for with nested ranges and
+  // equivalences flattened out - an element just gives itself.  Safe to
+  // call from several threads at once
+  const std::vector<Symbol *> &SubscriptElements(Symbol *s);
+  void CacheSubscriptElements(void);  // once the model is parsed
+  // a subscript element's place among those of the range that owns it,
+  // for ElementSets over that range, and how many places the range has.
+  // Only once the types are marked, as that settles the owners
+  size_t ElementIndex(Symbol *elm);
+  size_t ElementCount(Symbol *owner);
+  // the elements s (a range, subrange or element) stands for, over its owner
+  ElementSet SubscriptSet(Symbol *s);
+  // the subscripts a variable's values are laid out over, the last varying
+  // fastest, from the left hand side of its one equation - none for a
+  // scalar.  False if there is no single layout (an equation per element,
+  // EXCEPT lists or ! subscripts)
+  bool ValueDimensions(Variable *var, std::vector<Symbol *> &dims);
   void GenerateCanonicalNames(void);
   void GenerateShortNames(void);
   bool OutputComputable(bool wantshort);
   bool MarkVariableTypes(SymbolNameSpace *ns);
+  // once the types are marked, puts eq in place of was, one of a main model
+  // variable's equations, and marks that variable (and the flows it gains
+  // or loses) as MarkVariableTypes would have with eq there all along.
+  // False where that takes marking the whole model again - subscript
+  // ranges, number tables, LOOKUP EXTRAPOLATE, net flows and a stock
+  // becoming a flow or a flow a stock - with the model then only fit for
+  // throwing away
+  bool ReplaceEquation(Equation *was, Equation *eq);
+  // the dependencies between the main model's variables - built on first
+  // use and thrown away when marking types changes them
+  const ModelGraph &Graph(void);
   void AttachStragglers();  // try to get diagramatic stuff right
-  std::string PrintXMILE(bool isCompact, std::vector<std::string> &errs);
+  void PrintXMILE(XMILEWriter *writer, std::vector<std::string> &errs);
 
   double GetConstanValue(const char *var, double defval);
   UnitExpression *GetUnits(const char *var);
@@ -47,6 +451,8 @@ public:
   std::vector<View *> &Views() {
     return vViews;
   }
+  // deletes the views, leaving no variable in one
+  void ClearViews(void);
 
   std::vector<MacroFunction *> &MacroFunctions() {
     return mMacroFunctions;
@@ -65,24 +471,46 @@ public:
   }
 
 private:
-  bool OrderEquations(ContextInfo *info, bool tonly);
+  bool OrderEquations(void);
   bool SetupVariableStates(int pass);
   bool ValidatePlaceholderVars(void);
+  bool InstantiateMacros(void);
+  bool InstantiateMacros(Expression *e, Variable *owner);  // the calls in e, arguments first
   bool OrganizeSubscripts(void);
   void ClearCompEquations(void);
+  void FreeStates(void);
+  bool CanSimulate(void);
+  bool Needed(const std::vector<std::string> &outputs, std::unordered_set<Variable *> &needed);
 
+  SymbolArena mArena;
   SymbolNameSpace mSymbolNameSpace;
+  ModelGraph mGraph;
   std::vector<ModelGroup> vGroups;
   std::vector<View *> vViews;
   std::vector<Variable *> vUnamedVars;
+  std::vector<Variable *> vUnamedOwners;  // the variable each of vUnamedVars was made for
+  // the variables each use of a macro computes, and those for arguments
+  // that aren't variables to begin with
+  std::vector<Variable *> vMacroVars;
+  std::vector<Variable *> vMacroOwners;  // the variable whose equation uses the macro
+  std::deque<MacroInstance> dMacroInstances;
+  std::unordered_map<ExpressionList *, MacroInstance *> mMacroCalls;     // each use by its arguments
+  std::unordered_map<Variable *, const MacroInstance *> mMacroBindings;  // see MacroBinding
   // std::vector<Equation *>vConstantComps ; // actually just assignment
   std::vector<Equation *> vInitialTimeComps;
   std::vector<Equation *> vInitialComps;
   std::vector<Equation *> vUnchangingComps;
   std::vector<Equation *> vActiveComps;
   std::vector<Equation *> vRateComps;
+  std::vector<std::vector<Variable *>> vSimultaneous;  // see Simultaneous
   std::vector<MacroFunction *> mMacroFunctions;
   std::vector<std::string> vUnitEquivs;
+  std::unordered_map<Symbol *, std::vector<Symbol *>> mSubscriptElements;  // see SubscriptElements
+  std::unordered_map<Symbol *, size_t> mElementIndex;  // see ElementIndex
+  std::unordered_map<Symbol *, size_t> mElementCount;  // by owner
+#ifndef XMUTIL_NO_THREADS
+  std::mutex mSubscriptLock;  // for mSubscriptElements and mElementIndex
+#endif
   /* the last could be part of active but it is helpful to split
      out when creating equations for a computer language */
   int iNLevel;
@@ -0,0 +1,65 @@
+#include "ModelGraph.h"
+
+#include "Symbol/Equation.h"
+#include "Symbol/ExpressionNodes.h"
+#include "Symbol/SymbolNameSpace.h"
+#include "Symbol/Variable.h"
+
+static const std::vector<Variable *> NoVariables;
+
+void ModelGraph::Build(SymbolNameSpace *sns) {
+  Clear();
+  vVariables = sns->Variables();
+  {
+    // only for the walk, so gone again before the inputs are used
+    ExpressionNodes nodes;
+    std::vector<std::pair<Variable *, uint32_t>> roots;
+    for (Variable *var : vVariables) {
+      for (Equation *eq : var->GetAllEquations()) {
+        if (eq->GetExpression())
+          roots.push_back(std::make_pair(var, nodes.Add(eq->GetExpression())));
+      }
+    }
+    for (const std::pair<Variable *, uint32_t> &root : roots)  // a variable's equations are together
+      nodes.GetVarsUsed(root.second, mInputs[root.first]);
+  }
+  for (Variable *var : vVariables) {
+    for (Variable *in : Inputs(var))
+      mOutputs[in].push_back(var);
+  }
+  for (Variable *stock : vVariables) {
+    if (stock->VariableType() != XMILE_Type_STOCK)
+      continue;
+    for (int dir = 0; dir < 2; dir++) {
+      for (Variable *flow : dir ? stock->Outflows() : stock->Inflows()) {
+        std::vector<Variable *> &stocks = mStocks[flow];
+        if (stocks.empty() || stocks.back() != stock)  // a stock may have the same flow both ways
+          stocks.push_back(stock);
+      }
+    }
+  }
+  bBuilt = true;
+}
+
+void ModelGraph::Clear(void) {
+  vVariables.clear();
+  mStocks.clear();
+  mInputs.clear();
+  mOutputs.clear();
+  bBuilt = false;
+}
+
+const std::vector<Variable *> &ModelGraph::Inputs(Variable *var) const {
+  std::unordered_map<Variable *, std::vector<Variable *>>::const_iterator it = mInputs.find(var);
+  return it == mInputs.end() ? NoVariables : it->second;
+}
+
+const std::vector<Variable *> &ModelGraph::Outputs(Variable *var) const {
+  std::unordered_map<Variable *, std::vector<Variable *>>::const_iterator it = mOutputs.find(var);
+  return it == mOutputs.end() ? NoVariables : it->second;
+}
+
+const std::vector<Variable *> &ModelGraph::Stocks(Variable *flow) const {
+  std::unordered_map<Variable *, std::vector<Variable *>>::const_iterator it = mStocks.find(flow);
+  return it == mStocks.end() ? NoVariables : it->second;
+}
@@ -0,0 +1,36 @@
+#include "Progress.h"
+
+thread_local ConversionProgress *ConversionProgress::tCurrent = NULL;
+
+ConversionProgress::ConversionProgress(XMUtilProgress progress, void *context, uint32_t totalBytes)
+    : pProgress(progress), pContext(context), iTotalBytes(totalBytes), iEquations(0), iReportedBytes(0) {
+}
+
+void ConversionProgress::Read(size_t bytesRead, bool last) {
+#ifndef XMUTIL_NO_THREADS
+  std::lock_guard<std::mutex> lock{mReporting};
+#endif
+  if (!last)
+    iEquations++;
+  if (last || bytesRead - iReportedBytes >= PROGRESS_BYTES) {
+    iReportedBytes = bytesRead;
+    Report(XMUTIL_PROGRESS_BYTES, bytesRead, iTotalBytes);
+  }
+  if (last || iEquations % PROGRESS_EQUATIONS == 0)
+    Report(XMUTIL_PROGRESS_EQUATIONS, iEquations, 0);
+}
+
+void ConversionProgress::Viewed(size_t done, size_t total) {
+#ifndef XMUTIL_NO_THREADS
+  std::lock_guard<std::mutex> lock{mReporting};
+#endif
+  Report(XMUTIL_PROGRESS_VIEWS, done, total);
+}
+
+ConversionProgress::Scope::Scope(ConversionProgress *progress) : pPrevious(tCurrent) {
+  tCurrent = progress;
+}
+
+ConversionProgress::Scope::~Scope(void) {
+  tCurrent = pPrevious;
+}
@@ -0,0 +1,75 @@
+#ifndef _XMUTIL_PROGRESS_H
+#define _XMUTIL_PROGRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "XMUtil.h"
+
+#ifndef XMUTIL_NO_THREADS
+#include <mutex>
+#endif
+
+/* ConversionProgress - the callback behind _convert_mdl_to_xmile_progress
+
+   while a ConversionProgress::Scope is active on a thread the loop reading
+   equations and the XMILE generator say how far they have got, and that
+   is passed on - the bytes read every PROGRESS_BYTES or so, the equations
+   every PROGRESS_EQUATIONS and each view as it is written - so an embedder
+   posting each report to another thread isn't swamped.  Outside of a
+   scope reporting costs a thread local load and a test.  Threads helping
+   with the conversion (RunWorkers) take the same ConversionProgress, which
+   reports for one of them at a time */
+#define PROGRESS_BYTES 65536
+#define PROGRESS_EQUATIONS 256
+class ConversionProgress {
+public:
+  ConversionProgress(XMUtilProgress progress, void *context, uint32_t totalBytes);
+
+  static ConversionProgress *Current(void) {
+    return tCurrent;
+  }
+
+  // after each equation, with how far into the MDL reading has got
+  static void Equation(size_t bytesRead) {
+    if (ConversionProgress *progress = tCurrent)
+      progress->Read(bytesRead, false);
+  }
+  // once the sketch and settings are read too - the last counts are
+  // always given
+  static void Read(size_t bytesRead) {
+    if (ConversionProgress *progress = tCurrent)
+      progress->Read(bytesRead, true);
+  }
+  static void View(size_t done, size_t total) {
+    if (ConversionProgress *progress = tCurrent)
+      progress->Viewed(done, total);
+  }
+
+  class Scope {
+  public:
+    Scope(ConversionProgress *progress);
+    ~Scope(void);
+
+  private:
+    ConversionProgress *pPrevious;
+  };
+
+private:
+  void Read(size_t bytesRead, bool last);
+  void Viewed(size_t done, size_t total);
+  void Report(int stage, size_t done, size_t total) {
+    pProgress(pContext, stage, static_cast<uint32_t>(done), static_cast<uint32_t>(total));
+  }
+  XMUtilProgress pProgress;
+  void *pContext;
+  uint32_t iTotalBytes;  // 0 when it isn't known up front
+  size_t iEquations;
+  size_t iReportedBytes;
+#ifndef XMUTIL_NO_THREADS
+  std::mutex mReporting;
+#endif
+  static thread_local ConversionProgress *tCurrent;
+};
+
+#endif
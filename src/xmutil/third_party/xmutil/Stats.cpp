@@ -0,0 +1,138 @@
+#include "Stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+thread_local XMUtilStats *ConversionStats::tCurrent = NULL;
+
+// what the thread has allocated with new since it started
+struct AllocationCounts {
+  uint64_t count;
+  uint64_t bytes;
+  int64_t live;
+  int64_t peak;  // the most live has been since a stage last reset it
+};
+static thread_local AllocationCounts tAllocations;
+
+#ifdef XMUTIL_COUNT_ALLOCATIONS
+// enough to keep what follows aligned for anything new gives out
+#define ALLOCATION_HEADER 16
+
+static void *CountedAllocate(size_t size) {
+  char *p = static_cast<char *>(malloc(size + ALLOCATION_HEADER));
+  if (!p)
+    return NULL;
+  memcpy(p, &size, sizeof(size));
+  AllocationCounts &counts = tAllocations;
+  counts.count++;
+  counts.bytes += size;
+  counts.live += size;
+  counts.peak = std::max(counts.peak, counts.live);
+  return p + ALLOCATION_HEADER;
+}
+
+static void CountedFree(void *ptr) {
+  if (!ptr)
+    return;
+  char *p = static_cast<char *>(ptr) - ALLOCATION_HEADER;
+  size_t size;
+  memcpy(&size, p, sizeof(size));
+  tAllocations.live -= size;
+  free(p);
+}
+
+void *operator new(size_t size) {
+  void *p = CountedAllocate(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return CountedAllocate(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return CountedAllocate(size);
+}
+void operator delete(void *p) noexcept {
+  CountedFree(p);
+}
+void operator delete[](void *p) noexcept {
+  CountedFree(p);
+}
+void operator delete(void *p, size_t) noexcept {
+  CountedFree(p);
+}
+void operator delete[](void *p, size_t) noexcept {
+  CountedFree(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  CountedFree(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  CountedFree(p);
+}
+#endif
+
+ConversionStats::Scope::Scope(XMUtilStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+#ifdef XMUTIL_COUNT_ALLOCATIONS
+  stats->allocationsCounted = 1;
+#endif
+  pPrevious = tCurrent;
+  tCurrent = stats;
+  iLive = tAllocations.live;
+}
+
+ConversionStats::Scope::~Scope(void) {
+  tCurrent->retainedBytes = tAllocations.live - iLive;
+  tCurrent = pPrevious;
+}
+
+ConversionStats::Allocations::Allocations(int stage) : pStats(Current()), iStage(stage) {
+  AllocationCounts &counts = tAllocations;
+  iCount = counts.count;
+  iBytes = counts.bytes;
+  iLive = counts.live;
+  iPeak = counts.peak;
+  counts.peak = counts.live;
+}
+
+ConversionStats::Allocations::~Allocations(void) {
+  AllocationCounts &counts = tAllocations;
+  if (pStats) {
+    pStats->allocations[iStage] += counts.count - iCount;
+    pStats->allocatedBytes[iStage] += counts.bytes - iBytes;
+    pStats->peakBytes[iStage] = std::max<uint64_t>(pStats->peakBytes[iStage], counts.peak - iLive);
+  }
+  counts.peak = std::max(iPeak, counts.peak);  // for any stage this one is part of
+}
+
+void ConversionStats::Add(XMUtilStats *into, const XMUtilStats &from) {
+  into->inputBytes += from.inputBytes;
+  into->tokens += from.tokens;
+  into->lookups += from.lookups;
+  into->lookupMisses += from.lookupMisses;
+  into->recoverySkips += from.recoverySkips;
+  into->variables += from.variables;
+  into->outputBytes += from.outputBytes;
+  // seconds spent on several threads at once add up to more than went by
+  into->readSeconds += from.readSeconds;
+  into->equationSeconds += from.equationSeconds;
+  into->markTypesSeconds += from.markTypesSeconds;
+  into->attachSeconds += from.attachSeconds;
+  into->printSeconds += from.printSeconds;
+  into->printVariablesSeconds += from.printVariablesSeconds;
+  into->printViewsSeconds += from.printViewsSeconds;
+  for (int i = 0; i < XMUTIL_STAGE_COUNT; i++) {
+    into->allocations[i] += from.allocations[i];
+    into->allocatedBytes[i] += from.allocatedBytes[i];
+    into->peakBytes[i] = std::max(into->peakBytes[i], from.peakBytes[i]);
+  }
+  into->retainedBytes += from.retainedBytes;
+}
@@ -0,0 +1,97 @@
+#ifndef _XMUTIL_STATS_H
+#define _XMUTIL_STATS_H
+
+#include <stdint.h>
+
+#include <chrono>
+
+#include "XMUtil.h"
+
+/* ConversionStats - the counters and timers behind
+   _convert_mdl_to_xmile_stats
+
+   while a ConversionStats::Scope is active on a thread XMUTIL_COUNT and
+   ConversionStats::Timer add to its XMUtilStats - outside of one they cost
+   a thread local load and a test, so they can sit in the lexer and the
+   name lookups.  Threads helping with a conversion (RunWorkers) count
+   into stats of their own, added to it when they are done.  Building with
+   XMUTIL_NO_STATS leaves them all out
+
+   building with XMUTIL_COUNT_ALLOCATIONS replaces the global operator new
+   and delete with ones counting what each thread allocates, which
+   XMUTIL_ALLOCATIONS splits up by stage.  That puts a header on every
+   allocation so it is a build for measuring, not for shipping.  Memory
+   freed on a thread other than the one that allocated it (the fragments
+   of a large model written across threads) is counted against the thread
+   freeing it */
+class ConversionStats {
+public:
+  static XMUtilStats *Current(void) {
+    return tCurrent;
+  }
+  // what a thread helping with the conversion counted, into its stats
+  static void Add(XMUtilStats *into, const XMUtilStats &from);
+
+  class Scope {
+  public:
+    Scope(XMUtilStats *stats);  // which is zeroed
+    ~Scope(void);
+
+  private:
+    XMUtilStats *pPrevious;
+    int64_t iLive;  // allocated on the thread when the scope began
+  };
+
+  // with XMUTIL_COUNT_ALLOCATIONS the allocations from here to the end of
+  // the block go to the stage given
+  class Allocations {
+  public:
+    Allocations(int stage);
+    ~Allocations(void);
+
+  private:
+    XMUtilStats *pStats;
+    int iStage;
+    uint64_t iCount;
+    uint64_t iBytes;
+    int64_t iLive;
+    int64_t iPeak;
+  };
+
+  // adds the seconds from here to the end of the block to the field given
+  class Timer {
+  public:
+    Timer(double XMUtilStats::*field) : pStats(Current()), pField(field) {
+      if (pStats)
+        tStart = std::chrono::steady_clock::now();
+    }
+    ~Timer(void) {
+      if (pStats)
+        pStats->*pField += std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    }
+
+  private:
+    XMUtilStats *pStats;
+    double XMUtilStats::*pField;
+    std::chrono::steady_clock::time_point tStart;
+  };
+
+private:
+  static thread_local XMUtilStats *tCurrent;
+};
+
+#ifdef XMUTIL_NO_STATS
+#define XMUTIL_COUNT(field, n)
+#define XMUTIL_TIME(field)
+#define XMUTIL_ALLOCATIONS(stage)
+#else
+#define XMUTIL_COUNT(field, n)                            \
+  do {                                                    \
+    if (XMUtilStats *stats_ = ConversionStats::Current()) \
+      stats_->field += (n);                               \
+  } while (0)
+#define XMUTIL_TIME(field) ConversionStats::Timer timer_##field(&XMUtilStats::field)
+#define XMUTIL_ALLOCATIONS(stage) ConversionStats::Allocations allocations_##stage(stage)
+#endif
+
+#endif
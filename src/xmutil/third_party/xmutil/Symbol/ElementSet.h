@@ -0,0 +1,100 @@
+#ifndef _XMUTIL_SYMBOL_ELEMENTSET_H
+#define _XMUTIL_SYMBOL_ELEMENTSET_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/* ElementSet - a set of the elements of one subscript range, one bit for
+   each at the position Model::ElementIndex gives it, so taking EXCEPT
+   lists out, checking one set covers another or finding elements defined
+   twice is a pass over a few words rather than a walk through a tree of
+   pointers */
+class ElementSet {
+public:
+  ElementSet(void) {
+    iCount = 0;
+  }
+  explicit ElementSet(size_t count) {
+    Resize(count);
+  }
+  // all elements start out absent
+  void Resize(size_t count) {
+    iCount = count;
+    vWords.assign((count + 63) / 64, 0);
+  }
+  size_t Capacity(void) const {
+    return iCount;
+  }
+
+  void Add(size_t elm) {
+    if (elm >= iCount)
+      Grow(elm + 1);
+    vWords[elm / 64] |= uint64_t(1) << (elm % 64);
+  }
+  bool Has(size_t elm) const {
+    return elm < iCount && (vWords[elm / 64] >> (elm % 64) & 1);
+  }
+  size_t Count(void) const {
+    size_t count = 0;
+    for (uint64_t word : vWords)
+      count += Bits(word);
+    return count;
+  }
+  bool Empty(void) const {
+    for (uint64_t word : vWords) {
+      if (word)
+        return false;
+    }
+    return true;
+  }
+
+  // true if every element of other is also here
+  bool Contains(const ElementSet &other) const {
+    for (size_t i = 0; i < other.vWords.size(); i++) {
+      if (other.vWords[i] & ~(i < vWords.size() ? vWords[i] : 0))
+        return false;
+    }
+    return true;
+  }
+  bool Intersects(const ElementSet &other) const {
+    for (size_t i = 0; i < vWords.size() && i < other.vWords.size(); i++) {
+      if (vWords[i] & other.vWords[i])
+        return true;
+    }
+    return false;
+  }
+  ElementSet &operator|=(const ElementSet &other) {
+    if (other.iCount > iCount)
+      Grow(other.iCount);
+    for (size_t i = 0; i < other.vWords.size(); i++)
+      vWords[i] |= other.vWords[i];
+    return *this;
+  }
+  ElementSet &operator&=(const ElementSet &other) {
+    for (size_t i = 0; i < vWords.size(); i++)
+      vWords[i] &= i < other.vWords.size() ? other.vWords[i] : 0;
+    return *this;
+  }
+  // takes out the elements in other - as :EXCEPT: does
+  void Remove(const ElementSet &other) {
+    for (size_t i = 0; i < vWords.size() && i < other.vWords.size(); i++)
+      vWords[i] &= ~other.vWords[i];
+  }
+
+private:
+  void Grow(size_t count) {
+    iCount = count;
+    vWords.resize((count + 63) / 64, 0);
+  }
+  static size_t Bits(uint64_t word) {
+    size_t count = 0;
+    for (; word; word &= word - 1)
+      count++;
+    return count;
+  }
+  std::vector<uint64_t> vWords;
+  size_t iCount;
+};
+
+#endif
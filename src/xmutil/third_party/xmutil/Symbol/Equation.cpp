@@ -11,10 +11,10 @@ Equation::Equation(SymbolNameSpace *sns, LeftHandSide *lhs, Expression *ex, int
 }
 
 Equation::~Equation(void) {
-  if (HasGoodAlloc()) {
+  if (OwnsChildren())
     delete pLeftHandSide;
+  if (OwnsExpressions())
     delete pExpression;
-  }
 }
 
 Variable *Equation::GetVariable(void) {
@@ -29,18 +29,22 @@ void Equation::CheckPlaceholderVars(Model *m) {
   pExpression->CheckPlaceholderVars(m, true);
 }
 
-std::string Equation::RHSFormattedXMILE(const std::vector<Symbol *> &subs, const std::vector<Symbol *> &dims,
-                                        bool init) {
-  if (!pExpression)
-    return "{empty}";
-  ContextInfo info;
+bool Equation::RHSFormattedXMILE(const std::vector<Symbol *> &subs, const std::vector<Symbol *> &dims, bool init,
+                                 std::string &out, Model *model) {
+  out.clear();
+  if (!pExpression) {
+    out = "{empty}";
+    return false;
+  }
+  ContextInfo info(&out);
+  info.SetModel(model);
   if (init)
     info.SetInitEqn(true);
 
   assert(subs.size() == dims.size());
   info.SetLHSElms(&subs, &dims);
   pExpression->OutputComputable(&info);
-  return info.str();
+  return info.UsedLHSElms();
 }
 
 bool Equation::IsActiveInit() {
@@ -53,7 +57,7 @@ void Equation::GetSubscriptElements(std::vector<Symbol *> &vals, Symbol *s) {
     return;
   Variable *v = static_cast<Variable *>(s);
 
-  std::vector<Equation *> eqs = v->GetAllEquations();
+  const std::vector<Equation *> &eqs = v->GetAllEquations();
   if (!eqs.empty())  // recur this is a nested def or equivalence
   {
     assert(eqs.size() == 1);
@@ -73,8 +77,8 @@ void Equation::GetSubscriptElements(std::vector<Symbol *> &vals, Symbol *s) {
 }
 
 // look at the lhs of equation to get element by element expanded subscripts - eg [plant] becomes [p1],[p2],[p3]
-bool Equation::SubscriptExpand(std::vector<std::vector<Symbol *>> &elms,
-                               std::vector<Symbol *> &orig)  // can be one or many depending on the subs
+bool Equation::SubscriptExpand(std::vector<std::vector<Symbol *>> &elms, std::vector<Symbol *> &orig,
+                               Model *model)  // can be one or many depending on the subs
 {
   SymbolList *subs = pLeftHandSide->GetSubs();
   if (!subs)
@@ -91,7 +95,10 @@ bool Equation::SubscriptExpand(std::vector<std::vector<Symbol *>> &elms,
     if (sub.eType == SymbolList::EntryType_SYMBOL)  // only valid type
     {
       // see if it has an equation
-      GetSubscriptElements(cur_elms, sub.u.pSymbol);
+      if (model)
+        cur_elms = model->SubscriptElements(sub.u.pSymbol);
+      else
+        GetSubscriptElements(cur_elms, sub.u.pSymbol);
       orig.push_back(sub.u.pSymbol);
     } else {
       assert(false);
@@ -102,12 +109,52 @@ bool Equation::SubscriptExpand(std::vector<std::vector<Symbol *>> &elms,
     maxpos.push_back(cur_elms.size());
     curpos.push_back(0);
   }
+  // each list after :EXCEPT: takes out the combinations with every subscript
+  // among those it gives in the same place - as sets over the owners
+  std::vector<std::vector<ElementSet>> excepts;
+  std::vector<std::vector<size_t>> places;  // ElementIndex of elmlist
+  SymbolListList *except = pLeftHandSide->GetExceptList();
+  if (model && except) {
+    for (int k = 0; k < except->Length(); k++) {
+      const SymbolList *list = (*except)[k];
+      if (list->Length() != n)
+        continue;
+      std::vector<ElementSet> sets;
+      for (int i = 0; i < n; i++) {
+        const SymbolList::SymbolListEntry &sub = (*list)[i];
+        Symbol *elm = elmlist[i][0];
+        // only ranges sharing an owner can say anything
+        if (sub.eType == SymbolList::EntryType_SYMBOL && elm && sub.u.pSymbol->Owner() == elm->Owner())
+          sets.push_back(model->SubscriptSet(sub.u.pSymbol));
+        else
+          sets.push_back(ElementSet());
+      }
+      excepts.push_back(std::move(sets));
+    }
+    for (int i = 0; !excepts.empty() && i < n; i++) {
+      places.emplace_back();
+      for (Symbol *elm : elmlist[i])
+        places.back().push_back(elm ? model->ElementIndex(elm) : SIZE_MAX);
+    }
+  }
   // now cycle through elmlist - might be a single entry - we need to do all combinations
   while (curpos[0] < maxpos[0]) {
-    cur_elms.clear();
-    for (int i = 0; i < n; i++)
-      cur_elms.push_back(elmlist[i][curpos[i]]);
-    elms.push_back(cur_elms);
+    bool excepted = false;
+    for (const std::vector<ElementSet> &sets : excepts) {
+      int i = 0;
+      while (i < n && sets[i].Has(places[i][curpos[i]]))
+        i++;
+      if (i == n) {
+        excepted = true;
+        break;
+      }
+    }
+    if (!excepted) {
+      cur_elms.clear();
+      for (int i = 0; i < n; i++)
+        cur_elms.push_back(elmlist[i][curpos[i]]);
+      elms.push_back(cur_elms);
+    }
     for (int j = n; j-- > 0;) {
       curpos[j]++;
       if (curpos[j] < maxpos[j])
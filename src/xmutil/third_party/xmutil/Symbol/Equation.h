@@ -18,16 +18,23 @@ public:
   inline Expression *GetExpression(void) {
     return pExpression;
   }
+  void ReleaseExpression(void) {  // before deleting an equation sharing another's
+    pExpression = NULL;
+  }
   ExpressionTable *GetTable(void);
   int SubscriptCount(std::vector<Variable *> &elmlist);
   static void GetSubscriptElements(std::vector<Symbol *> &vals, Symbol *s);  // if nested defs
-  bool SubscriptExpand(std::vector<std::vector<Symbol *>> &elms,
-                       std::vector<Symbol *> &subs);  // can be one or many depending on the subs
+  // with a model the elements come from Model::SubscriptElements, less any
+  // combinations an :EXCEPT: list takes out
+  bool SubscriptExpand(std::vector<std::vector<Symbol *>> &elms, std::vector<Symbol *> &subs,
+                       Model *model = NULL);  // can be one or many depending on the subs
   void Execute(ContextInfo *info);
   void OutputComputable(ContextInfo *info);
   void CheckPlaceholderVars(Model *m);
-  std::string RHSFormattedXMILE(const std::vector<Symbol *> &subs, const std::vector<Symbol *> &dims,
-                                bool init);  // need a_b*c
+  // replaces the contents of out so the same buffer can be reused - returns
+  // true if the text depends on which elements dims holds
+  bool RHSFormattedXMILE(const std::vector<Symbol *> &subs, const std::vector<Symbol *> &dims, bool init,
+                         std::string &out, Model *model = NULL);  // need a_b*c
   bool IsActiveInit();                       // true only for active
 private:
   LeftHandSide *pLeftHandSide;
@@ -18,6 +18,7 @@ Expression::~Expression(void) {
 }
 
 double Expression::Eval(ContextInfo *info) {
+  info->SetEvalFailed();
   return FLT_MAX;
 }
 
@@ -25,7 +26,7 @@ void Expression::OutputComputable(ContextInfo *info) {
 }
 
 ExpressionFunction::~ExpressionFunction() {
-  if (HasGoodAlloc())
+  if (OwnsExpressions())
     delete pArgs;
 }
 
@@ -43,6 +44,7 @@ void ExpressionFunction::GetVarsUsed(std::vector<Variable *> &vars) {
 }
 
 void ExpressionFunctionMemory::CheckPlaceholderVars(Model *m, bool isfirst) {
+  ExpressionFunction::CheckPlaceholderVars(m, isfirst);  // a delay of a smooth needs one for the smooth
   if (isfirst || !m) {
     pPlacholderEquation = NULL;  // deletion is handled by Model
   } else {
@@ -82,10 +84,12 @@ static void is_all_plus_minus(Expression *e, FlowList *fl, bool neg) {
     fl->SetValid(false);
 }
 void ExpressionVariable::GetVarsUsed(std::vector<Variable *> &vars) {
-  for (Variable *var : vars) {
-    if (var == pVariable)
-      return;
-  }
+  // everything in vars comes through here, so if pVariable is already
+  // there it is where it was last put
+  size_t pos = pVariable->VarsUsedPos();
+  if (pos < vars.size() && vars[pos] == pVariable)
+    return;
+  pVariable->SetVarsUsedPos(vars.size());
   vars.push_back(pVariable);
 }  // list of variables used
 
@@ -142,6 +146,125 @@ bool FlowList::operator==(const FlowList &rhs) {
   return true;
 }
 
+// true is 1 and false 0 - and and or only evaluate what they need to
+// paren and unary minus have just the one operand, and a leading sign
+// is an add or subtract with no left operand
+void ExpressionOperator2::CompileOperator(ExpressionCode *code, int op) {
+  if (!pE1) {
+    pE2->Compile(code);
+    if (op == ExpressionCode::OP_SUBTRACT)
+      code->Emit(ExpressionCode::OP_NEGATE);
+    return;
+  }
+  pE1->Compile(code);
+  if (op == ExpressionCode::OP_NONE)
+    return;
+  if (op != ExpressionCode::OP_NEGATE)
+    pE2->Compile(code);
+  code->Emit(op);
+}
+
+// not keeps its operand in pE2
+double ExpressionLogical::Eval(ContextInfo *info) {
+  if (mOper == VPTT_not)
+    return pE2->Eval(info) == 0;
+  double a = pE1->Eval(info);
+  switch (mOper) {
+  case VPTT_and:
+    return a != 0 && pE2->Eval(info) != 0;
+  case VPTT_or:
+    return a != 0 || pE2->Eval(info) != 0;
+  default:
+    break;
+  }
+  double b = pE2->Eval(info);
+  switch (mOper) {
+  case VPTT_le:
+    return a <= b;
+  case VPTT_ge:
+    return a >= b;
+  case VPTT_ne:
+    return a != b;
+  case '<':
+    return a < b;
+  case '>':
+    return a > b;
+  case '=':
+    return a == b;
+  default:
+    info->SetEvalFailed();
+    return 0;
+  }
+}
+
+// and and or skip the second operand as Eval does, leaving 0 or 1
+void ExpressionLogical::Compile(ExpressionCode *code) {
+  int op;
+  switch (mOper) {
+  case VPTT_not:
+    pE2->Compile(code);
+    code->Emit(ExpressionCode::OP_NOT);
+    return;
+  case VPTT_and:
+  case VPTT_or: {
+    pE1->Compile(code);
+    double a;
+    if (code->PopConstant(&a)) {
+      if ((a != 0) == (mOper == VPTT_or)) {
+        code->Number(a != 0);
+      } else {
+        pE2->Compile(code);
+        code->Emit(ExpressionCode::OP_NOT);
+        code->Emit(ExpressionCode::OP_NOT);
+      }
+      return;
+    }
+    if (code->Rows()) {  // the elements, or lanes, can go either way
+      pE2->Compile(code);
+      code->Emit(mOper == VPTT_and ? ExpressionCode::OP_AND : ExpressionCode::OP_OR);
+      return;
+    }
+    if (mOper == VPTT_or)
+      code->Emit(ExpressionCode::OP_NOT);
+    size_t skip = code->Here();
+    code->Emit(ExpressionCode::OP_JUMP_IF_ZERO);
+    pE2->Compile(code);
+    code->Emit(ExpressionCode::OP_NOT);
+    code->Emit(ExpressionCode::OP_NOT);
+    size_t done = code->Here();
+    code->Emit(ExpressionCode::OP_JUMP);
+    code->PatchJump(skip);
+    code->Number(mOper == VPTT_or ? 1 : 0);
+    code->PatchJump(done);
+    return;
+  }
+  case VPTT_le:
+    op = ExpressionCode::OP_LE;
+    break;
+  case VPTT_ge:
+    op = ExpressionCode::OP_GE;
+    break;
+  case VPTT_ne:
+    op = ExpressionCode::OP_NE;
+    break;
+  case '<':
+    op = ExpressionCode::OP_LT;
+    break;
+  case '>':
+    op = ExpressionCode::OP_GT;
+    break;
+  case '=':
+    op = ExpressionCode::OP_EQ;
+    break;
+  default:
+    code->Fallback(this);
+    return;
+  }
+  pE1->Compile(code);
+  pE2->Compile(code);
+  code->Emit(op);
+}
+
 void ExpressionLogical::OutputComputable(ContextInfo *info) {
   if (pE1)
     pE1->OutputComputable(info);
@@ -185,6 +308,19 @@ void ExpressionTable::TransformLegacy() {
   vYVals.resize(n);
 }
 
+double ExpressionLookup::Eval(ContextInfo *info) {
+  if (!pLookupTable)
+    pLookupTable = TableFunction::GetTable(pExpressionVariable);
+  return pLookupTable->Lookup(pExpression->Eval(info));
+}
+
+void ExpressionLookup::Compile(ExpressionCode *code) {
+  if (!pLookupTable)
+    pLookupTable = TableFunction::GetTable(pExpressionVariable);
+  pExpression->Compile(code);
+  code->Lookup(pLookupTable);
+}
+
 void ExpressionLookup::OutputComputable(ContextInfo *info) {
   if (pExpressionVariable) {
     *info << "LOOKUP(";
@@ -9,6 +9,7 @@
 #include "../Function/Function.h"
 #include "../Function/State.h"
 #include "../Function/TableFunction.h"
+#include "ExpressionCode.h"
 #include "SymbolList.h"
 #include "SymbolTableBase.h"
 #include "Variable.h"
@@ -30,7 +31,8 @@ enum EXPTYPE {
   EXPTYPE_FunctionMemory,
   EXPTYPE_Lookup,
   EXPTYPE_Table,
-  EXPTYPE_Operator
+  EXPTYPE_Operator,
+  EXPTYPE_Logical
 };
 
 class Expression : public SymbolTableBase {
@@ -41,6 +43,10 @@ public:
     return EXPTYPE_None;
   }
   virtual double Eval(ContextInfo *info) = 0;
+  // lowers the expression for the simulator - the default just calls Eval
+  virtual void Compile(ExpressionCode *code) {
+    code->Fallback(this);
+  }
   virtual void FlipSign(void) {
   }
   virtual Function *GetFunction(void) {
@@ -82,7 +88,7 @@ public:
     pSubList = subs;
   }
   virtual ~ExpressionVariable(void) {
-    if (HasGoodAlloc()) {
+    if (OwnsChildren()) {
       if (pSubList)
         delete pSubList; /* leave pVariable alone */
     }
@@ -102,11 +108,17 @@ public:
   virtual void CheckPlaceholderVars(Model *m, bool isfirst) {
   }
   bool CheckComputed(ContextInfo *info) {
-    return pVariable->CheckComputed(info, false);
+    // in a macro's body, what this use of the macro binds the name to
+    const MacroInstance *use = info->GetMacroInstance();
+    return (use ? use->Resolve(pVariable) : pVariable)->CheckComputed(info, false);
   }
   double Eval(ContextInfo *info) {
     return pVariable->Eval(info);
   }
+  void Compile(ExpressionCode *code) {
+    if (!code->Load(pVariable, pSubList))
+      code->Fallback(this);
+  }
   virtual void OutputComputable(ContextInfo *info) {
     assert(pVariable);
     pVariable->OutputComputable(info);
@@ -132,7 +144,7 @@ public:
     pMap = map;
   }
   virtual ~ExpressionSymbolList(void) {
-    if (HasGoodAlloc()) {
+    if (OwnsChildren()) {
       if (pSymList)
         delete pSymList;
       if (pMap)
@@ -148,6 +160,7 @@ public:
     return true;
   }
   double Eval(ContextInfo *info) {
+    info->SetEvalFailed();
     return -FLT_MAX;
   }
   virtual void OutputComputable(ContextInfo *info) {
@@ -186,9 +199,18 @@ public:
   void FlipSign(void) {
     value = -value;
   }
+  double GetValue(void) const {
+    return value;
+  }
+  void SetValue(double num) {
+    value = num;
+  }
   virtual double Eval(ContextInfo *info) {
     return value;
   }
+  void Compile(ExpressionCode *code) {
+    code->Number(value);
+  }
   virtual void CheckPlaceholderVars(Model *m, bool isfirst) {
   }
   virtual void OutputComputable(ContextInfo *info) {
@@ -215,7 +237,11 @@ public:
   virtual EXPTYPE GetType(void) {
     return EXPTYPE_Literal;
   }
+  const std::string &GetValue(void) const {  // quotes and all
+    return value;
+  }
   virtual double Eval(ContextInfo *info) {
+    info->SetEvalFailed();
     return -1;
   }
   virtual void CheckPlaceholderVars(Model *m, bool isfirst) {
@@ -244,13 +270,21 @@ public:
     return EXPTYPE_NumberTable;
   }
   virtual double Eval(ContextInfo *info) {
+    info->SetEvalFailed();
     return -FLT_MAX;
   }
+  void Compile(ExpressionCode *code) {  // one number for each element
+    if (!code->Numbers(vVals))
+      code->Fallback(this);
+  }
   virtual void CheckPlaceholderVars(Model *m, bool isfirst) {
   }
   virtual void OutputComputable(ContextInfo *info) {
     *info << " ??? ";
   }
+  void Reserve(size_t count) {
+    vVals.reserve(count);
+  }
   void AddValue(unsigned row, double num) {
     vVals.push_back(num);
   }  // if (row + 1 > vRow.size()) vRow.resize(row + 1); vRow[row].push_back(num); }
@@ -284,6 +318,10 @@ public:
   virtual double Eval(ContextInfo *info) override {
     return pFunction->Eval(this, pArgs, info);
   }
+  void Compile(ExpressionCode *code) override {
+    if (!pFunction->Compile(code, pArgs))
+      code->Fallback(this);
+  }
   virtual Function *GetFunction(void) override {
     return pFunction;
   }
@@ -292,7 +330,7 @@ public:
   }
   void CheckPlaceholderVars(Model *m, bool isfirst) override;
   bool CheckComputed(ContextInfo *info) override {
-    return pFunction->CheckComputed(info, pArgs);
+    return pFunction->CheckComputedList(info, pArgs);
   }
   void RemoveFunctionArgs(void) override {
     pArgs = NULL;
@@ -329,7 +367,16 @@ public:
       return pPlacholderEquation->GetVariable()->Eval(info);
     return ExpressionFunction::Eval(info);
   }
+  void Compile(ExpressionCode *code) {
+    if (!pPlacholderEquation)
+      ExpressionFunction::Compile(code);
+    else if (!code->Load(pPlacholderEquation->GetVariable(), NULL))
+      code->Fallback(this);
+  }
   void CheckPlaceholderVars(Model *m, bool isfirst);
+  Variable *Placeholder(void) {  // NULL if the function defines the LHS
+    return pPlacholderEquation ? pPlacholderEquation->GetVariable() : NULL;
+  }
   bool CheckComputed(ContextInfo *info) {
     if (pPlacholderEquation)
       return pPlacholderEquation->GetVariable()->CheckComputed(info, false);
@@ -354,14 +401,16 @@ public:
     pExpressionVariable = var;
     pExpression = e;
     pExpressionTable = NULL;
+    pLookupTable = NULL;
   }
   ExpressionLookup(SymbolNameSpace *sns, Expression *e, ExpressionTable *tbl) : Expression(sns) {
     pExpressionVariable = NULL;
     pExpression = e;
     pExpressionTable = tbl;
+    pLookupTable = tbl;
   }
   ~ExpressionLookup(void) {
-    if (HasGoodAlloc()) {
+    if (OwnsExpressions()) {
       delete pExpressionVariable;
       delete pExpression;
     }
@@ -378,9 +427,8 @@ public:
   bool CheckComputed(ContextInfo *info) {
     return pExpression->CheckComputed(info);
   }
-  double Eval(ContextInfo *info) {
-    return TableFunction::Eval(pExpressionVariable, pExpression, info);
-  }
+  double Eval(ContextInfo *info);
+  void Compile(ExpressionCode *code);
   virtual void OutputComputable(ContextInfo *info);
   virtual bool TestMarkFlows(SymbolNameSpace *sns, FlowList *fl, Equation *eq) {
     return false;
@@ -393,11 +441,15 @@ public:
   }  // list of variables used
   virtual void MarkType(XMILE_Type type) {
   }
+  virtual Expression *GetArg(int pos) {  // the lookup variable, then what it is looked up at
+    return pos == 0 ? pExpressionVariable : pos == 1 ? pExpression : NULL;
+  }
 
 private:
   ExpressionVariable *pExpressionVariable;  // null for with_lookup
   Expression *pExpression;
   ExpressionTable *pExpressionTable;
+  ExpressionTable *pLookupTable;  // found on the first Eval or Compile
 };
 
 class ExpressionTable : public Expression {
@@ -405,6 +457,7 @@ public:
   ExpressionTable(SymbolNameSpace *sns) : Expression(sns) {
     bHasRange = false;
     bExtrapolate = false;
+    iLastSegment = 0;
   }
   ~ExpressionTable(void) { /* vector destructors only*/
   }
@@ -414,6 +467,10 @@ public:
   virtual ExpressionTable *GetTable(void) {
     return this;
   }
+  void Reserve(size_t count) {
+    vXVals.reserve(count);
+    vYVals.reserve(count);
+  }
   void AddPair(double x, double y) {
     vXVals.push_back(x);
     vYVals.push_back(y);
@@ -438,6 +495,16 @@ public:
   std::vector<double> *GetYVals(void) {
     return &vYVals;
   }
+  // the interpolated value at d - the segment found is kept for the next call
+  double Lookup(double d) {
+    return TableFunction::Lookup(vXVals.data(), vYVals.data(), vXVals.size(), d, &iLastSegment);
+  }
+  double Lookup(double d, size_t *hint) const {  // keeping the segment in hint instead
+    return TableFunction::Lookup(vXVals.data(), vYVals.data(), vXVals.size(), d, hint);
+  }
+  void Lookup(const double *d, double *out, size_t count) {
+    TableFunction::Lookup(vXVals.data(), vYVals.data(), vXVals.size(), d, out, count);
+  }
   virtual void OutputComputable(ContextInfo *info) {
     *info << "0+0";
   }  // unattached table give it a 0+0 equation - points dealt with separately
@@ -458,6 +525,7 @@ public:
 private:
   std::vector<double> vXVals;
   std::vector<double> vYVals;
+  size_t iLastSegment;
   double dY1, dX2, dY2;
   bool bHasRange;
   bool bExtrapolate;
@@ -470,7 +538,7 @@ public:
     pE2 = e2;
   }
   ~ExpressionOperator2(void) {
-    if (HasGoodAlloc()) {
+    if (OwnsExpressions()) {
       if (pE1)
         delete pE1;
       if (pE2)
@@ -517,13 +585,15 @@ public:
   virtual Expression *GetArg(int pos) override {
     return pos == 0 ? pE1 : pos == 1 ? pE2 : NULL;
   }
+  virtual ExpressionCode::Op GetCode(void) = 0;  // what it compiles to - OP_NONE for parentheses
+  void CompileOperator(ExpressionCode *code, int op);
 
 protected:
   Expression *pE1;
   Expression *pE2;
 };
 
-#define EO2SubClassRaw(name, evaleq, before, middle, after)                                         \
+#define EO2SubClassRaw(name, evaleq, op, before, middle, after)                                     \
   class name : public ExpressionOperator2 {                                                         \
   public:                                                                                           \
     name(SymbolNameSpace *sns, Expression *e1, Expression *e2) : ExpressionOperator2(sns, e1, e2) { \
@@ -533,6 +603,12 @@ protected:
     virtual double Eval(ContextInfo *info) {                                                        \
       return (evaleq);                                                                              \
     }                                                                                               \
+    void Compile(ExpressionCode *code) {                                                            \
+      CompileOperator(code, ExpressionCode::op);                                                    \
+    }                                                                                               \
+    ExpressionCode::Op GetCode(void) {                                                              \
+      return ExpressionCode::op;                                                                    \
+    }                                                                                               \
     virtual const char *GetOperator() {                                                             \
       return middle;                                                                                \
     }                                                                                               \
@@ -549,15 +625,16 @@ protected:
       *info << after;                                                                               \
     }                                                                                               \
   };
-#define EO2SubClass(name, evaleq, compsym) EO2SubClassRaw(name, evaleq, "", compsym, "");
+#define EO2SubClass(name, evaleq, op, compsym) EO2SubClassRaw(name, evaleq, op, "", compsym, "");
 
-EO2SubClass(ExpressionMultiply, pE1->Eval(info) * pE2->Eval(info), "*")
-    EO2SubClass(ExpressionDivide, pE1->Eval(info) / pE2->Eval(info), "/")
-        EO2SubClass(ExpressionAdd, pE1->Eval(info) + pE2->Eval(info), "+")
-            EO2SubClass(ExpressionSubtract, pE1->Eval(info) - pE2->Eval(info), "-")
-                EO2SubClass(ExpressionPower, exp(log(pE1->Eval(info)) * pE2->Eval(info)), "^")
-                    EO2SubClassRaw(ExpressionParen, pE1->Eval(info), "(", "", ")")
-                        EO2SubClassRaw(ExpressionUnaryMinus, (-pE1->Eval(info)), "-", "", "")
+EO2SubClass(ExpressionMultiply, pE1->Eval(info) * pE2->Eval(info), OP_MULTIPLY, "*")
+    EO2SubClass(ExpressionDivide, pE1->Eval(info) / pE2->Eval(info), OP_DIVIDE, "/")
+        EO2SubClass(ExpressionAdd, pE1 ? pE1->Eval(info) + pE2->Eval(info) : pE2->Eval(info), OP_ADD, "+")
+            EO2SubClass(ExpressionSubtract, pE1 ? pE1->Eval(info) - pE2->Eval(info) : -pE2->Eval(info), OP_SUBTRACT,
+                        "-")
+                EO2SubClass(ExpressionPower, ExpressionCode::Power(pE1->Eval(info), pE2->Eval(info)), OP_POWER, "^")
+                    EO2SubClassRaw(ExpressionParen, pE1->Eval(info), OP_NONE, "(", "", ")")
+                        EO2SubClassRaw(ExpressionUnaryMinus, (-pE1->Eval(info)), OP_NEGATE, "-", "", "")
 
                             class ExpressionLogical : public Expression {
 public:
@@ -567,20 +644,35 @@ public:
     mOper = oper;
   }
   ~ExpressionLogical(void) {
-    if (HasGoodAlloc()) {
+    if (OwnsExpressions()) {
       delete pE1;
       delete pE2;
     }
   }
-  virtual double Eval(ContextInfo *info) {
-    return 0;
+  virtual EXPTYPE GetType(void) {
+    return EXPTYPE_Logical;
+  }
+  virtual Expression *GetArg(int pos) {
+    return pos == 0 ? pE1 : pos == 1 ? pE2 : NULL;
+  }
+  int GetOper(void) const {  // a comparison character or VPTT_ token
+    return mOper;
   }
+  virtual double Eval(ContextInfo *info);
+  void Compile(ExpressionCode *code);
   void CheckPlaceholderVars(Model *m, bool isfirst) {
     if (pE1)
       pE1->CheckPlaceholderVars(m, false);
     if (pE2)
       pE2->CheckPlaceholderVars(m, false);
   }
+  bool CheckComputed(ContextInfo *info) override {
+    if (pE1 && !pE1->CheckComputed(info))
+      return false;
+    if (pE2 && !pE2->CheckComputed(info))
+      return false;
+    return true;
+  }
   void OutputComputable(ContextInfo *info);
   virtual bool TestMarkFlows(SymbolNameSpace *sns, FlowList *fl, Equation *eq) {
     if (pE1 && pE1->TestMarkFlows(sns, fl, eq))
@@ -0,0 +1,954 @@
+#include "ExpressionCode.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "../ContextInfo.h"
+#include "../DataStore.h"
+#include "../Function/Kernel.h"
+#include "../Function/TableFunction.h"
+#include "../Model.h"
+#include "Equation.h"
+#include "Expression.h"
+#include "LeftHandSide.h"
+#include "Variable.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+ExpressionCode::ExpressionCode(void) {
+  pLevelBase = pRateBase = pAuxBase = NULL;
+  pModel = NULL;
+  pState = NULL;
+  pMacroInstance = NULL;
+  iDepth = iMaxDepth = 0;
+  iComputeType = 0;
+  iJumpTarget = 0;
+  iWidth = iMaxWidth = 1;
+  iLanes = 1;
+  bUnsupported = false;
+  bFoldFixed = true;
+}
+
+void ExpressionCode::SetBases(double *level, double *rate, double *aux) {
+  pLevelBase = level;
+  pRateBase = rate;
+  pAuxBase = aux;
+}
+
+void ExpressionCode::Clear(void) {
+  vCode.clear();
+  vSegments.clear();
+  vEquations.clear();
+  vConstants.clear();
+  vExpressions.clear();
+  vTables.clear();
+  vData.clear();
+  vGathers.clear();
+  vPipelines.clear();
+  iDepth = iMaxDepth = 0;
+  iJumpTarget = 0;
+  iWidth = iMaxWidth = 1;
+  bUnsupported = false;
+}
+
+// the same arithmetic Run does so folding can't change any results
+static double Apply(int op, double a, double b) {
+  switch (op) {
+  case ExpressionCode::OP_ADD:
+    return a + b;
+  case ExpressionCode::OP_SUBTRACT:
+    return a - b;
+  case ExpressionCode::OP_MULTIPLY:
+    return a * b;
+  case ExpressionCode::OP_DIVIDE:
+    return a / b;
+  case ExpressionCode::OP_POWER:
+    return ExpressionCode::Power(a, b);
+  case ExpressionCode::OP_NEGATE:
+    return -a;
+  case ExpressionCode::OP_LT:
+    return a < b;
+  case ExpressionCode::OP_LE:
+    return a <= b;
+  case ExpressionCode::OP_GT:
+    return a > b;
+  case ExpressionCode::OP_GE:
+    return a >= b;
+  case ExpressionCode::OP_EQ:
+    return a == b;
+  case ExpressionCode::OP_NE:
+    return a != b;
+  case ExpressionCode::OP_AND:
+    return a != 0 && b != 0;
+  case ExpressionCode::OP_OR:
+    return a != 0 || b != 0;
+  case ExpressionCode::OP_NOT:
+    return a == 0;
+  default:
+    assert(0);
+    return 0;
+  }
+}
+
+bool ExpressionCode::PopConstant(double *value) {
+  if (vCode.size() <= iJumpTarget || vCode.back().op != OP_NUMBER)
+    return false;
+  *value = vConstants.back();  // constants are only added with their instruction
+  vConstants.pop_back();
+  vCode.pop_back();
+  iDepth--;
+  return true;
+}
+
+// keeps track of how deep the stack can get so Run never has to check
+void ExpressionCode::Emit(int op, int arg) {
+  if (op >= OP_ADD && op <= OP_NOT) {
+    size_t n = vCode.size();
+    double a, b;
+    if (op == OP_NEGATE || op == OP_NOT) {
+      if (PopConstant(&a)) {
+        Number(Apply(op, a, 0));
+        return;
+      }
+    } else if (n >= iJumpTarget + 2 && vCode[n - 2].op == OP_NUMBER && vCode[n - 1].op == OP_NUMBER) {
+      PopConstant(&b);
+      PopConstant(&a);
+      Number(Apply(op, a, b));
+      return;
+    }
+  }
+  // a power of a number known now comes down to a square root or some
+  // multiplying, the same as Power would do for it
+  double power;
+  if (op == OP_POWER && PopConstant(&power)) {
+    if (fabs(power) <= POWER_WHOLE_MAX && power == static_cast<int>(power)) {
+      if (power != 1)
+        Emit(OP_POWER_WHOLE, static_cast<int>(power));
+      return;
+    }
+    if (power == 0.5) {
+      Call(Kernel_Sqrt);
+      return;
+    }
+    Number(power);
+  }
+  Instruction ins;
+  ins.op = op;
+  ins.arg = arg;
+  vCode.push_back(ins);
+  switch (op) {
+  case OP_NUMBER:
+  case OP_LEVEL:
+  case OP_AUX:
+  case OP_CONSTANTS:
+  case OP_LEVEL_SLICE:
+  case OP_AUX_SLICE:
+  case OP_LEVEL_GATHER:
+  case OP_AUX_GATHER:
+  case OP_EVAL:
+  case OP_DATA:
+  case OP_TIME:
+  case OP_TIME_STEP:
+  case OP_RING_OUTPUT:
+    iDepth++;
+    break;
+  case OP_LOOKUP:
+  case OP_DATA_AT:
+  case OP_NEGATE:
+  case OP_NOT:
+  case OP_POWER_WHOLE:
+  case OP_STAGES_OUTPUT:
+  case OP_RING_INIT:
+  case OP_RING_SHIFT:
+    break;
+  case OP_SELECT:
+    iDepth -= 2;
+    break;
+  case OP_CALL:
+    iDepth -= Kernels[arg].args - 1;
+    break;
+  case OP_RANDOM_NORMAL:
+    iDepth -= 3;
+    break;
+  case OP_RANDOM_POISSON:
+    iDepth -= 4;
+    break;
+  case OP_JUMP:  // the value moves to where the branches join
+  default:       // binary operators, conditional jumps and stores
+    iDepth--;
+    break;
+  }
+  if (iDepth > iMaxDepth)
+    iMaxDepth = iDepth;
+}
+
+void ExpressionCode::Number(double value) {
+  vConstants.push_back(value);
+  Emit(OP_NUMBER, static_cast<int>(vConstants.size() - 1));
+}
+
+// evaluating the expression gives a single value, which is all an
+// arrayed variable would give too - so only things without them can
+void ExpressionCode::Fallback(Expression *exp) {
+  if (iLanes > 1)
+    bUnsupported = true;  // it reads the model's arrays, not the lanes
+  if (pMacroInstance)
+    bUnsupported = true;  // and the body's variables, not the use's
+  std::vector<Variable *> vars;
+  exp->GetVarsUsed(vars);
+  for (Variable *var : vars) {
+    State *state = var->Content() ? var->Content()->GetState() : NULL;
+    if (state && state->ValueCount() > 1)
+      bUnsupported = true;
+  }
+  vExpressions.push_back(exp);
+  Emit(OP_EVAL, static_cast<int>(vExpressions.size() - 1));
+}
+
+void ExpressionCode::Call(int kernel) {
+  const KernelInfo &info = Kernels[kernel];
+  size_t n = vCode.size();
+  size_t args = static_cast<size_t>(info.args);
+  bool numbers = n >= iJumpTarget + args;
+  for (size_t i = n - args; numbers && i < n; i++)
+    numbers = vCode[i].op == OP_NUMBER;
+  if (!numbers) {
+    Emit(OP_CALL, kernel);
+    return;
+  }
+  double rows[KERNEL_MAX_ARGS];
+  for (size_t i = args; i-- > 0;)
+    PopConstant(&rows[i]);
+  info.run(rows, 1);
+  Number(rows[0]);
+}
+
+void ExpressionCode::Lookup(ExpressionTable *table) {
+  double x;
+  if (PopConstant(&x)) {
+    Number(table->Lookup(x));
+    return;
+  }
+  vTables.push_back(table);
+  Emit(OP_LOOKUP, static_cast<int>(vTables.size() - 1));
+}
+
+void ExpressionCode::Data(std::shared_ptr<const DataSeries> series, bool atTime) {
+  double t;
+  if (atTime && PopConstant(&t)) {
+    Number(series->Lookup(t, NULL));
+    return;
+  }
+  vData.push_back(std::move(series));
+  Emit(atTime ? OP_DATA_AT : OP_DATA, static_cast<int>(vData.size() - 1));
+}
+
+bool ExpressionCode::Numbers(const std::vector<double> &values) {
+  if (values.size() != static_cast<size_t>(iWidth))
+    return false;
+  if (iWidth == 1) {
+    Number(values[0]);
+    return true;
+  }
+  Emit(OP_CONSTANTS, static_cast<int>(vConstants.size()));
+  vConstants.insert(vConstants.end(), values.begin(), values.end());
+  return true;
+}
+
+int ExpressionCode::AddPipeline(bool material) {
+  StatePipeline *state = pState ? pState->Pipeline() : NULL;
+  if (!state || !(state->StageCount() || state->RingLength()))
+    return -1;
+  Pipeline pipeline;
+  pipeline.count = state->StageCount();
+  pipeline.stages = pipeline.count ? static_cast<int>(state->GetStagesP() - pLevelBase) : 0;
+  assert(!pipeline.count || state->GetStageRatesP() - pRateBase == pipeline.stages);
+  pipeline.length = state->RingLength();
+  pipeline.ring = pipeline.length ? static_cast<int>(state->GetRingP() - pAuxBase) : 0;
+  pipeline.bMaterial = material;
+  vPipelines.push_back(pipeline);
+  return static_cast<int>(vPipelines.size() - 1);
+}
+
+// where each element of the equation being compiled finds var[subs] among
+// var's values.  A subscript the left hand side also has follows it element
+// by element (so a subrange picks out its part of the full range), any
+// other has to name a single element
+bool ExpressionCode::Offsets(Variable *var, SymbolList *subs, std::vector<int> &offsets) {
+  std::vector<Symbol *> dims;
+  int n = subs ? subs->Length() : 0;
+  offsets.assign(iWidth, 0);
+  if (!pModel || !pModel->ValueDimensions(var, dims) || dims.size() != static_cast<size_t>(n))
+    return false;
+  int stride = 1;
+  for (int j = n; j-- > 0;) {
+    const SymbolList::SymbolListEntry &entry = (*subs)[j];
+    if (entry.eType != SymbolList::EntryType_SYMBOL)
+      return false;
+    const std::vector<Symbol *> &elms = pModel->SubscriptElements(dims[j]);
+    std::vector<Symbol *>::const_iterator lhs = std::find(vDims.begin(), vDims.end(), entry.u.pSymbol);
+    if (lhs == vDims.end()) {
+      const std::vector<Symbol *> &one = pModel->SubscriptElements(entry.u.pSymbol);
+      std::vector<Symbol *>::const_iterator at =
+          one.size() == 1 ? std::find(elms.begin(), elms.end(), one[0]) : elms.end();
+      if (at == elms.end())
+        return false;
+      for (int &offset : offsets)
+        offset += static_cast<int>(at - elms.begin()) * stride;
+    } else {
+      // the left hand side varies its last subscript fastest
+      int lhsStride = 1;
+      for (std::vector<Symbol *>::const_iterator it = lhs + 1; it != vDims.end(); ++it)
+        lhsStride *= static_cast<int>(pModel->SubscriptElements(*it).size());
+      const std::vector<Symbol *> &lhsElms = pModel->SubscriptElements(*lhs);
+      std::vector<int> positions;
+      for (Symbol *elm : lhsElms) {
+        std::vector<Symbol *>::const_iterator at = std::find(elms.begin(), elms.end(), elm);
+        if (at == elms.end())
+          return false;
+        positions.push_back(static_cast<int>(at - elms.begin()) * stride);
+      }
+      int count = static_cast<int>(lhsElms.size());
+      for (int i = 0; i < iWidth; i++)
+        offsets[i] += positions[(i / lhsStride) % count];
+    }
+    stride *= static_cast<int>(elms.size());
+  }
+  return true;
+}
+
+bool ExpressionCode::Load(Variable *var, SymbolList *subs) {
+  if (pMacroInstance)
+    var = pMacroInstance->Resolve(var);
+  State *state = var->Content() ? var->Content()->GetState() : NULL;
+  if (!state)
+    return false;
+  // computed before the run and fixed through it
+  bool fixed = bFoldFixed && (iComputeType & (CF_active | CF_rate)) && !state->HasMemory() &&
+               !(state->DynamicDependency() & (DDF_level | DDF_data | DDF_time_varying));
+  bool level = state->HasMemory();
+  double *values = state->GetValueP();
+  int base = static_cast<int>(values - (level ? pLevelBase : pAuxBase));
+  std::vector<int> offsets;
+  if (!subs && state->ValueCount() == 1) {
+    offsets.assign(iWidth, 0);
+  } else if (!Offsets(var, subs, offsets)) {
+    bUnsupported = true;
+    Number(0);  // keeps the stack right for whatever follows
+    return true;
+  }
+  bool same = std::all_of(offsets.begin(), offsets.end(), [&](int offset) { return offset == offsets[0]; });
+  if (fixed && same) {
+    Number(values[offsets[0]]);
+  } else if (same) {
+    Emit(level ? OP_LEVEL : OP_AUX, base + offsets[0]);
+  } else if (fixed) {
+    Emit(OP_CONSTANTS, static_cast<int>(vConstants.size()));
+    for (int offset : offsets)
+      vConstants.push_back(values[offset]);
+  } else {
+    bool slice = true;
+    for (int i = 0; i < iWidth && slice; i++)
+      slice = offsets[i] == offsets[0] + i;
+    if (slice) {
+      Emit(level ? OP_LEVEL_SLICE : OP_AUX_SLICE, base + offsets[0]);
+    } else {
+      for (int &offset : offsets)
+        offset += base;
+      vGathers.push_back(offsets);
+      Emit(level ? OP_LEVEL_GATHER : OP_AUX_GATHER, static_cast<int>(vGathers.size() - 1));
+    }
+  }
+  return true;
+}
+
+bool ExpressionCode::MacroCall(ExpressionList *args) {
+  Variable *output = pModel ? pModel->MacroOutput(args) : NULL;
+  return output && Load(output, NULL);
+}
+
+void ExpressionCode::AddEquation(Equation *eq, int computeType) {
+  iComputeType = computeType;
+  State *state = eq->GetVariable()->Content()->GetState();
+  assert(state);
+  pState = state;
+  iWidth = state->ValueCount();
+  vDims.clear();
+  if (pModel && !pModel->ValueDimensions(eq->GetVariable(), vDims))
+    bUnsupported = true;
+  if (iWidth > iMaxWidth)
+    iMaxWidth = iWidth;
+  pMacroInstance = pModel ? pModel->MacroBinding(eq->GetVariable()) : NULL;
+  eq->GetExpression()->Compile(this);
+  pMacroInstance = NULL;
+  if (!state->HasMemory())
+    Emit(OP_STORE_AUX, static_cast<int>(state->GetValueP() - pAuxBase));
+  else if (computeType == CF_initial)
+    Emit(OP_STORE_LEVEL, static_cast<int>(state->GetValueP() - pLevelBase));
+  else
+    Emit(OP_STORE_RATE, static_cast<int>(state->GetRateP() - pRateBase));
+  assert(iDepth == 0);
+  pState = NULL;
+  if (iLanes > 1) {
+    // both sides of a condition are computed, so a draw in either would
+    // move a lane's stream on further than running it alone would
+    bool selects = false, draws = false;
+    for (size_t pc = vSegments.empty() ? 0 : vSegments.back().end; pc < vCode.size(); pc++) {
+      int op = vCode[pc].op;
+      selects = selects || op == OP_SELECT || op == OP_AND || op == OP_OR;
+      draws = draws || (op >= OP_RANDOM_UNIFORM && op <= OP_RANDOM_POISSON);
+    }
+    if (selects && draws)
+      bUnsupported = true;
+  }
+  EquationCode code;
+  code.eq = eq;
+  code.end = vCode.size();
+  code.width = iWidth;
+  vEquations.push_back(code);
+  Segment segment;
+  segment.end = vCode.size();
+  segment.width = iWidth;
+  if (!vSegments.empty() && vSegments.back().width == iWidth)
+    vSegments.back().end = segment.end;  // scalars especially run together
+  else
+    vSegments.push_back(segment);
+}
+
+void ExpressionCode::Prepare(Scratch *scratch) const {
+  // a row for each entry the stack can hold serves scalars as well
+  size_t depth = (iMaxDepth + 1) * static_cast<size_t>(iMaxWidth) * iLanes;
+  if (scratch->vStack.size() < depth)
+    scratch->vStack.resize(depth);
+  if (scratch->vHints.size() < vTables.size())
+    scratch->vHints.resize(vTables.size(), 0);
+  if (scratch->vDataHints.size() < vData.size())
+    scratch->vDataHints.resize(vData.size(), 0);
+}
+
+void ExpressionCode::Run(ContextInfo *info, double *level, double *rate, double *aux, Scratch *scratch) const {
+  Prepare(scratch);
+  size_t pc = 0;
+  for (const Segment &segment : vSegments) {
+    if (segment.width == 1 && iLanes == 1)
+      RunScalar(info, pc, segment.end, level, rate, aux, scratch);
+    else
+      RunVector(info, pc, segment.end, segment.width * iLanes, iLanes, level, rate, aux, scratch);
+    pc = segment.end;
+  }
+}
+
+void ExpressionCode::Run(ContextInfo *info, double *level, double *rate, double *aux, Scratch *scratch,
+                         const std::vector<Setting> &settings) const {
+  if (settings.empty()) {
+    Run(info, level, rate, aux, scratch);
+    return;
+  }
+  // an equation at a time, so the settings go in before anything reads them
+  Prepare(scratch);
+  size_t pc = 0;
+  for (const EquationCode &code : vEquations) {
+    if (code.width == 1 && iLanes == 1)
+      RunScalar(info, pc, code.end, level, rate, aux, scratch);
+    else
+      RunVector(info, pc, code.end, code.width * iLanes, iLanes, level, rate, aux, scratch);
+    int first = NumbersAt(pc, code.end);
+    if (first >= 0) {
+      for (const Setting &setting : settings) {
+        if (setting.offset >= first && setting.offset < first + code.width)
+          std::copy(setting.values, setting.values + iLanes, aux + static_cast<size_t>(setting.offset) * iLanes);
+      }
+    }
+    pc = code.end;
+  }
+}
+
+bool ExpressionCode::SetsNumber(int offset) const {
+  size_t pc = 0;
+  for (const EquationCode &code : vEquations) {
+    int first = NumbersAt(pc, code.end);
+    if (first >= 0 && offset >= first && offset < first + code.width)
+      return true;
+    pc = code.end;
+  }
+  return false;
+}
+
+int ExpressionCode::NumbersAt(size_t pc, size_t end) const {
+  if (end - pc != 2 || (vCode[pc].op != OP_NUMBER && vCode[pc].op != OP_CONSTANTS) ||
+      vCode[pc + 1].op != OP_STORE_AUX)
+    return -1;
+  return vCode[pc + 1].arg;
+}
+
+void ExpressionCode::Profile(ContextInfo *info, double *level, double *rate, double *aux, Scratch *scratch,
+                             uint64_t *ticks) const {
+  Prepare(scratch);
+  size_t pc = 0;
+  for (size_t i = 0; i < vEquations.size(); i++) {
+    const EquationCode &code = vEquations[i];
+    uint64_t start = Ticks();
+    if (code.width == 1 && iLanes == 1)
+      RunScalar(info, pc, code.end, level, rate, aux, scratch);
+    else
+      RunVector(info, pc, code.end, code.width * iLanes, iLanes, level, rate, aux, scratch);
+    ticks[i] += Ticks() - start;
+    pc = code.end;
+  }
+}
+
+uint64_t ExpressionCode::Ticks(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+const char *ExpressionCode::TickUnit(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  return "cycles";
+#else
+  return "ns";
+#endif
+}
+
+void ExpressionCode::RunScalar(ContextInfo *info, size_t pc, size_t end, double *level, double *rate, double *aux,
+                               Scratch *scratch) const {
+  double *sp = scratch->vStack.data();  // points past the top
+  const Instruction *code = vCode.data();
+  for (; pc < end; pc++) {
+    const Instruction &ins = code[pc];
+    switch (ins.op) {
+    case OP_NUMBER:
+      *sp++ = vConstants[ins.arg];
+      break;
+    case OP_LEVEL:
+      *sp++ = level[ins.arg];
+      break;
+    case OP_AUX:
+      *sp++ = aux[ins.arg];
+      break;
+    case OP_EVAL:
+      *sp++ = vExpressions[ins.arg]->Eval(info);
+      break;
+    case OP_LOOKUP:
+      sp[-1] = vTables[ins.arg]->Lookup(sp[-1], &scratch->vHints[ins.arg]);
+      break;
+    case OP_DATA:
+      *sp++ = vData[ins.arg]->Lookup(info->GetTime(), &scratch->vDataHints[ins.arg]);
+      break;
+    case OP_DATA_AT:
+      sp[-1] = vData[ins.arg]->Lookup(sp[-1], &scratch->vDataHints[ins.arg]);
+      break;
+    case OP_TIME:
+      *sp++ = info->GetTime();
+      break;
+    case OP_TIME_STEP:
+      *sp++ = info->GetDT();
+      break;
+    case OP_ADD:
+      sp--;
+      sp[-1] += *sp;
+      break;
+    case OP_SUBTRACT:
+      sp--;
+      sp[-1] -= *sp;
+      break;
+    case OP_MULTIPLY:
+      sp--;
+      sp[-1] *= *sp;
+      break;
+    case OP_DIVIDE:
+      sp--;
+      sp[-1] /= *sp;
+      break;
+    case OP_POWER:
+      sp--;
+      sp[-1] = Power(sp[-1], *sp);
+      break;
+    case OP_POWER_WHOLE:
+      sp[-1] = PowerWhole(sp[-1], ins.arg);
+      break;
+    case OP_NEGATE:
+      sp[-1] = -sp[-1];
+      break;
+    case OP_LT:
+      sp--;
+      sp[-1] = sp[-1] < *sp;
+      break;
+    case OP_LE:
+      sp--;
+      sp[-1] = sp[-1] <= *sp;
+      break;
+    case OP_GT:
+      sp--;
+      sp[-1] = sp[-1] > *sp;
+      break;
+    case OP_GE:
+      sp--;
+      sp[-1] = sp[-1] >= *sp;
+      break;
+    case OP_EQ:
+      sp--;
+      sp[-1] = sp[-1] == *sp;
+      break;
+    case OP_NE:
+      sp--;
+      sp[-1] = sp[-1] != *sp;
+      break;
+    case OP_NOT:
+      sp[-1] = sp[-1] == 0;
+      break;
+    case OP_CALL: {
+      const KernelInfo &kernel = Kernels[ins.arg];
+      sp -= kernel.args - 1;
+      kernel.run(sp - 1, 1);
+      break;
+    }
+    case OP_RANDOM_UNIFORM:
+      sp--;
+      sp[-1] = info->RandomUniform(sp[-1], *sp);
+      break;
+    case OP_RANDOM_NORMAL:
+      sp -= 3;
+      sp[-1] = info->RandomNormal(sp[-1], sp[0], sp[1], sp[2]);
+      break;
+    case OP_RANDOM_POISSON:
+      sp -= 4;
+      sp[-1] = info->RandomPoisson(sp[-1], sp[0], sp[1], sp[2], sp[3]);
+      break;
+    case OP_STAGES_INIT:
+    case OP_STAGES_OUTPUT:
+    case OP_STAGES_RATES:
+    case OP_RING_INIT:
+    case OP_RING_OUTPUT:
+    case OP_RING_SHIFT:
+      sp = RunPipeline(ins, sp, 1, 1, level, rate, aux);
+      break;
+    case OP_JUMP:
+      pc = ins.arg - 1;
+      break;
+    case OP_JUMP_IF_ZERO:
+      if (*--sp == 0)
+        pc = ins.arg - 1;
+      break;
+    case OP_STORE_LEVEL:
+      level[ins.arg] = *--sp;
+      break;
+    case OP_STORE_RATE:
+      rate[ins.arg] = *--sp;
+      break;
+    case OP_STORE_AUX:
+      aux[ins.arg] = *--sp;
+      break;
+    default:
+      assert(0);
+      break;
+    }
+  }
+}
+
+// each operator is a loop over the rows of its operands - sp points past
+// the top row
+#define ROW_LOOP(expr)              \
+  do {                              \
+    double *a = sp - 2 * width;     \
+    double *b = sp - width;         \
+    for (int i = 0; i < width; i++) \
+      a[i] = expr;                  \
+    sp = b;                         \
+  } while (0)
+
+// the lanes of a value are together, so with lanes an element's value is
+// lanes long wherever it comes from
+void ExpressionCode::RunVector(ContextInfo *info, size_t pc, size_t end, int width, int lanes, double *level,
+                               double *rate, double *aux, Scratch *scratch) const {
+  double *sp = scratch->vStack.data();
+  const Instruction *code = vCode.data();
+  for (; pc < end; pc++) {
+    const Instruction &ins = code[pc];
+    switch (ins.op) {
+    case OP_NUMBER:
+      std::fill(sp, sp + width, vConstants[ins.arg]);
+      sp += width;
+      break;
+    case OP_LEVEL:
+    case OP_AUX: {
+      const double *from = (ins.op == OP_LEVEL ? level : aux) + ins.arg * lanes;
+      if (lanes == 1) {
+        std::fill(sp, sp + width, *from);
+      } else {
+        for (int i = 0; i < width; i += lanes)
+          std::copy(from, from + lanes, sp + i);
+      }
+      sp += width;
+      break;
+    }
+    case OP_CONSTANTS:
+      if (lanes == 1) {
+        std::copy(vConstants.data() + ins.arg, vConstants.data() + ins.arg + width, sp);
+      } else {
+        for (int i = 0; i < width; i += lanes)
+          std::fill(sp + i, sp + i + lanes, vConstants[ins.arg + i / lanes]);
+      }
+      sp += width;
+      break;
+    case OP_LEVEL_SLICE:
+      std::copy(level + ins.arg * lanes, level + ins.arg * lanes + width, sp);
+      sp += width;
+      break;
+    case OP_AUX_SLICE:
+      std::copy(aux + ins.arg * lanes, aux + ins.arg * lanes + width, sp);
+      sp += width;
+      break;
+    case OP_LEVEL_GATHER:
+    case OP_AUX_GATHER: {
+      const double *from = ins.op == OP_LEVEL_GATHER ? level : aux;
+      const int *offsets = vGathers[ins.arg].data();
+      for (int i = 0; i < width; i += lanes) {
+        const double *value = from + offsets[i / lanes] * lanes;
+        std::copy(value, value + lanes, sp + i);
+      }
+      sp += width;
+      break;
+    }
+    case OP_EVAL:
+      std::fill(sp, sp + width, vExpressions[ins.arg]->Eval(info));
+      sp += width;
+      break;
+    case OP_LOOKUP: {
+      ExpressionTable *table = vTables[ins.arg];
+      size_t *hint = &scratch->vHints[ins.arg];
+      double *a = sp - width;
+      for (int i = 0; i < width; i++)
+        a[i] = table->Lookup(a[i], hint);
+      break;
+    }
+    case OP_DATA:
+      std::fill(sp, sp + width, vData[ins.arg]->Lookup(info->GetTime(), &scratch->vDataHints[ins.arg]));
+      sp += width;
+      break;
+    case OP_DATA_AT: {
+      const DataSeries *series = vData[ins.arg].get();
+      size_t *hint = &scratch->vDataHints[ins.arg];
+      double *a = sp - width;
+      for (int i = 0; i < width; i++)
+        a[i] = series->Lookup(a[i], hint);
+      break;
+    }
+    case OP_TIME:  // the lanes all go in step
+      std::fill(sp, sp + width, info->GetTime());
+      sp += width;
+      break;
+    case OP_TIME_STEP:
+      std::fill(sp, sp + width, info->GetDT());
+      sp += width;
+      break;
+    case OP_ADD:
+      ROW_LOOP(a[i] + b[i]);
+      break;
+    case OP_SUBTRACT:
+      ROW_LOOP(a[i] - b[i]);
+      break;
+    case OP_MULTIPLY:
+      ROW_LOOP(a[i] * b[i]);
+      break;
+    case OP_DIVIDE:
+      ROW_LOOP(a[i] / b[i]);
+      break;
+    case OP_POWER:
+      ROW_LOOP(Power(a[i], b[i]));
+      break;
+    case OP_POWER_WHOLE: {
+      double *a = sp - width;
+      if (ins.arg == 2) {  // by far the most common
+        for (int i = 0; i < width; i++)
+          a[i] *= a[i];
+      } else {
+        for (int i = 0; i < width; i++)
+          a[i] = PowerWhole(a[i], ins.arg);
+      }
+      break;
+    }
+    case OP_NEGATE: {
+      double *a = sp - width;
+      for (int i = 0; i < width; i++)
+        a[i] = -a[i];
+      break;
+    }
+    case OP_LT:
+      ROW_LOOP(a[i] < b[i]);
+      break;
+    case OP_LE:
+      ROW_LOOP(a[i] <= b[i]);
+      break;
+    case OP_GT:
+      ROW_LOOP(a[i] > b[i]);
+      break;
+    case OP_GE:
+      ROW_LOOP(a[i] >= b[i]);
+      break;
+    case OP_EQ:
+      ROW_LOOP(a[i] == b[i]);
+      break;
+    case OP_NE:
+      ROW_LOOP(a[i] != b[i]);
+      break;
+    case OP_AND:
+      ROW_LOOP(a[i] != 0 && b[i] != 0);
+      break;
+    case OP_OR:
+      ROW_LOOP(a[i] != 0 || b[i] != 0);
+      break;
+    case OP_NOT: {
+      double *a = sp - width;
+      for (int i = 0; i < width; i++)
+        a[i] = a[i] == 0;
+      break;
+    }
+    case OP_SELECT: {
+      double *cond = sp - 3 * width;
+      const double *iftrue = sp - 2 * width;
+      const double *iffalse = sp - width;
+      for (int i = 0; i < width; i++)
+        cond[i] = cond[i] != 0 ? iftrue[i] : iffalse[i];
+      sp = cond + width;
+      break;
+    }
+    case OP_CALL: {  // one call for the whole row
+      const KernelInfo &kernel = Kernels[ins.arg];
+      sp -= (kernel.args - 1) * width;
+      kernel.run(sp - width, width);
+      break;
+    }
+    case OP_RANDOM_UNIFORM:  // a draw for each element, from its lane's stream
+      ROW_LOOP(info[i % lanes].RandomUniform(a[i], b[i]));
+      break;
+    case OP_RANDOM_NORMAL: {
+      double *a = sp - 4 * width;
+      double *b = a + width, *c = b + width, *d = c + width;
+      for (int i = 0; i < width; i++)
+        a[i] = info[i % lanes].RandomNormal(a[i], b[i], c[i], d[i]);
+      sp = b;
+      break;
+    }
+    case OP_RANDOM_POISSON: {
+      double *a = sp - 5 * width;
+      double *b = a + width, *c = b + width, *d = c + width, *e = d + width;
+      for (int i = 0; i < width; i++)
+        a[i] = info[i % lanes].RandomPoisson(a[i], b[i], c[i], d[i], e[i]);
+      sp = b;
+      break;
+    }
+    case OP_STAGES_INIT:
+    case OP_STAGES_OUTPUT:
+    case OP_STAGES_RATES:
+    case OP_RING_INIT:
+    case OP_RING_OUTPUT:
+    case OP_RING_SHIFT:
+      sp = RunPipeline(ins, sp, width, lanes, level, rate, aux);
+      break;
+    case OP_STORE_LEVEL:
+      sp -= width;
+      std::copy(sp, sp + width, level + ins.arg * lanes);
+      break;
+    case OP_STORE_RATE:
+      sp -= width;
+      std::copy(sp, sp + width, rate + ins.arg * lanes);
+      break;
+    case OP_STORE_AUX:
+      sp -= width;
+      std::copy(sp, sp + width, aux + ins.arg * lanes);
+      break;
+    default:  // jumps are never emitted for arrayed equations
+      assert(0);
+      break;
+    }
+  }
+}
+
+// the delays and smooths for a row of width values - each stage and slot
+// is a row too, with the lanes of an element together as everywhere else.
+// Returns the new top of the stack
+double *ExpressionCode::RunPipeline(const Instruction &ins, double *sp, int width, int lanes, double *level,
+                                    double *rate, double *aux) const {
+  const Pipeline &pipeline = vPipelines[ins.arg];
+  double *stages = level + pipeline.stages * lanes;
+  double *ring = aux + pipeline.ring * lanes;
+  double *next = ring + pipeline.length * width;  // the slot due out - the first lane's, as all move together
+  int n = pipeline.count;
+  switch (ins.op) {
+  case OP_STAGES_INIT: {
+    double *init = sp - 2 * width;  // and the output - it starts out there
+    const double *delay = sp - width;
+    for (int i = 0; i < width; i++) {
+      double value = pipeline.bMaterial ? init[i] * (delay[i] / n) : init[i];
+      for (int k = 0; k < n; k++)
+        stages[k * width + i] = value;
+    }
+    return sp - width;
+  }
+  case OP_STAGES_OUTPUT: {
+    double *delay = sp - width;
+    const double *last = stages + (n - 1) * width;
+    for (int i = 0; i < width; i++)
+      delay[i] = pipeline.bMaterial ? last[i] / (delay[i] / n) : last[i];
+    return sp;
+  }
+  case OP_STAGES_RATES: {
+    double *input = sp - 2 * width;
+    const double *delay = sp - width;
+    double *rates = rate + pipeline.stages * lanes;
+    for (int i = 0; i < width; i++) {
+      double each = delay[i] / n;
+      double in = input[i];  // what flows into the stage, or what it moves toward
+      for (int k = 0; k < n; k++) {
+        double stage = stages[k * width + i];
+        if (pipeline.bMaterial) {
+          double out = stage / each;
+          rates[k * width + i] = in - out;
+          in = out;
+        } else {
+          rates[k * width + i] = (in - stage) / each;
+          in = stage;
+        }
+      }
+      input[i] = in;
+    }
+    return sp - width;
+  }
+  case OP_RING_INIT: {
+    const double *init = sp - width;
+    for (int slot = 0; slot < pipeline.length; slot++)
+      std::copy(init, init + width, ring + slot * width);
+    *next = 0;
+    return sp;
+  }
+  case OP_RING_OUTPUT: {
+    const double *out = ring + static_cast<int>(*next) * width;
+    std::copy(out, out + width, sp);
+    return sp + width;
+  }
+  case OP_RING_SHIFT: {
+    int slot = static_cast<int>(*next);
+    double *input = sp - width;
+    double *out = ring + slot * width;
+    for (int i = 0; i < width; i++)
+      std::swap(input[i], out[i]);
+    *next = (slot + 1) % pipeline.length;
+    return sp;
+  }
+  default:
+    assert(0);
+    return sp;
+  }
+}
@@ -0,0 +1,308 @@
+#ifndef _XMUTIL_SYMBOL_EXPRESSIONCODE_H
+#define _XMUTIL_SYMBOL_EXPRESSIONCODE_H
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+class ContextInfo;
+class DataSeries;
+class Equation;
+class Expression;
+class ExpressionList;
+class ExpressionTable;
+class MacroInstance;
+class Model;
+class State;
+class Symbol;
+class SymbolList;
+class Variable;
+
+#define POWER_WHOLE_MAX 64  // whole exponents up to this are done by multiplying
+
+/* ExpressionCode - a list of equations lowered to a stack machine so the
+   simulator can run them in one loop instead of walking each expression
+   tree through virtual Eval calls
+
+   variables are referred to by their offset in the level, rate or aux
+   array rather than by pointer, so the same code can run against any
+   copy of those arrays.  An expression that doesn't know how to compile
+   itself becomes a single OP_EVAL that calls its Eval - the results are
+   the same either way
+
+   variables that don't change over the run are read as numbers when the
+   code is built, and operators on numbers are folded as they are emitted,
+   so the equations need to be added after the initial and unchanging
+   equations have been computed
+
+   an apply-to-all equation runs as one pass of its code over all of its
+   elements at once.  Each stack entry is then a row of values, one per
+   element in the order the left hand side lays them out, and a variable
+   with the same layout loads as a slice of its contiguous values, so the
+   arithmetic comes down to loops over plain arrays.  Conditions select
+   between rows rather than jumping.  Anything in an arrayed equation
+   that can't be done that way makes the code Unsupported
+
+   compiled for lanes, each value in the arrays is Lanes() values in a row,
+   one for each of that many runs going in step, and every equation runs
+   as rows that long (an arrayed one's elements each a row of lanes), so
+   one pass over the code moves all the runs on.  Conditions select there
+   too, which leaves the jumps out, and the lanes each draw from a stream
+   of their own.  Falling back to Eval, or a random function in an
+   equation that selects, makes the code Unsupported as the lanes couldn't
+   give what separate runs would
+
+   running the code changes nothing in it - the stack and the places the
+   tables were last looked up live in a Scratch - so one copy can be run
+   by several threads at once, each with its own arrays and Scratch, as
+   long as it is Shared */
+
+class ExpressionCode {
+public:
+  enum Op {
+    OP_NONE,            // placeholder - never emitted
+    OP_NUMBER,          // push vConstants[arg]
+    OP_LEVEL,           // push level[arg]
+    OP_AUX,             // push aux[arg]
+    OP_CONSTANTS,       // push a row of vConstants from arg
+    OP_LEVEL_SLICE,     // push a row of level from arg
+    OP_AUX_SLICE,       // push a row of aux from arg
+    OP_LEVEL_GATHER,    // push a row of level at the offsets in vGathers[arg]
+    OP_AUX_GATHER,      // push a row of aux at the offsets in vGathers[arg]
+    OP_EVAL,            // push vExpressions[arg]->Eval
+    OP_LOOKUP,          // replace the top with vTables[arg] at that value
+    OP_DATA,            // push vData[arg] at the time of the run
+    OP_DATA_AT,         // replace the top with vData[arg] at that time
+    OP_TIME,            // push the time of the run
+    OP_TIME_STEP,       // push TIME STEP
+    OP_ADD,             // OP_ADD through OP_NOT fold when their operands are numbers
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_POWER,
+    OP_NEGATE,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,  // 1 if both are non zero - for rows, as scalars jump past the second
+    OP_OR,
+    OP_NOT,
+    OP_SELECT,          // pops two values and a condition, keeps the first if it is true
+    OP_CALL,            // replaces the arguments of Kernels[arg] with its result
+    OP_POWER_WHOLE,     // raises the top to the power arg
+    OP_RANDOM_UNIFORM,  // pops min and max, pushes a draw between them
+    OP_RANDOM_NORMAL,   // pops min, max, mean and standard deviation
+    OP_RANDOM_POISSON,  // pops min, max, mean, shift and stretch
+    OP_STAGES_INIT,     // pops the initial value and delay time, sets vPipelines[arg]'s stages and gives the output
+    OP_STAGES_OUTPUT,   // replaces the delay time with the output
+    OP_STAGES_RATES,    // pops the input and delay time, sets the stage rates and gives the output
+    OP_RING_INIT,       // fills the ring with the value on top, leaving it
+    OP_RING_OUTPUT,     // push the slot of the ring due out
+    OP_RING_SHIFT,      // replaces the input with the slot due out, which it takes
+    OP_JUMP,            // to instruction arg
+    OP_JUMP_IF_ZERO,    // pops the condition
+    OP_STORE_LEVEL,     // pop into level[arg]
+    OP_STORE_RATE,
+    OP_STORE_AUX
+  };
+  struct Instruction {
+    int op;
+    int arg;
+  };
+  // a value for each lane stored in aux[offset] in place of the number its
+  // equation gives (see Run)
+  struct Setting {
+    int offset;
+    const double *values;  // Lanes() of them
+  };
+  // what a run changes as it goes - one for each run going at once
+  struct Scratch {
+    std::vector<double> vStack;
+    std::vector<size_t> vHints;      // the segment each table found last
+    std::vector<size_t> vDataHints;  // and each series
+  };
+
+  ExpressionCode(void);
+  // a^b as OP_POWER and ExpressionPower::Eval do it - a whole exponent by
+  // multiplying (so a negative base works), a half as sqrt and anything
+  // else through pow
+  static double Power(double a, double b) {
+    if (fabs(b) <= POWER_WHOLE_MAX && b == static_cast<int>(b))
+      return PowerWhole(a, static_cast<int>(b));
+    if (b == 0.5)
+      return sqrt(a);
+    return pow(a, b);
+  }
+  static double PowerWhole(double a, int n) {
+    if (n < 0)
+      return 1 / PowerWhole(a, -n);
+    double result = 1;
+    for (; n; n >>= 1) {  // by squaring
+      if (n & 1)
+        result *= a;
+      a *= a;
+    }
+    return result;
+  }
+  // the arrays the model's states point into - needed to turn a state
+  // into an offset while compiling
+  void SetBases(double *level, double *rate, double *aux);
+  // whether variables computed before the run and fixed through it are
+  // read as numbers in the code for the active and rate equations, rather
+  // than from the aux array - set before adding equations.  True unless set
+  void SetFoldFixed(bool fold) {
+    bFoldFixed = fold;
+  }
+  // where the layout of arrayed variables comes from
+  void SetModel(Model *model) {
+    pModel = model;
+  }
+  void Clear(void);
+  // how many runs the code is compiled to take at once - set before adding
+  // equations.  1 unless set
+  void SetLanes(int lanes) {
+    iLanes = lanes;
+  }
+  int Lanes(void) const {
+    return iLanes;
+  }
+  // appends the code for an equation of the given CF_ type - computeType
+  // decides what the equation stores into just as Equation::Execute does
+  void AddEquation(Equation *eq, int computeType);
+  void Run(ContextInfo *info, double *level, double *rate, double *aux) {
+    Run(info, level, rate, aux, &mScratch);
+  }
+  // compiled for lanes info is Lanes() of them, one for each lane, and the
+  // arrays are Lanes() times as long
+  void Run(ContextInfo *info, double *level, double *rate, double *aux, Scratch *scratch) const;
+  // the same with settings, each taking effect as the equation of numbers
+  // alone that sets its offset runs, so what is computed from it after
+  // sees the setting's values
+  void Run(ContextInfo *info, double *level, double *rate, double *aux, Scratch *scratch,
+           const std::vector<Setting> &settings) const;
+  // whether an equation of numbers alone (one, or one for each element)
+  // stores at aux[offset] - what a Setting can be for
+  bool SetsNumber(int offset) const;
+  // the same one equation at a time, adding the ticks of the clock each
+  // took (see Ticks) to ticks[i], which has an entry for each of Equations()
+  void Profile(ContextInfo *info, double *level, double *rate, double *aux, Scratch *scratch, uint64_t *ticks) const;
+  // cycles of the processor's time stamp counter where there is one,
+  // otherwise nanoseconds
+  static uint64_t Ticks(void);
+  static const char *TickUnit(void);  // "cycles" or "ns" to match
+  // the equations added, in the order they run
+  size_t Equations(void) const {
+    return vEquations.size();
+  }
+  Equation *GetEquation(size_t i) const {
+    return vEquations[i].eq;
+  }
+  // true if nothing falls back to Eval, which reads the arrays the model's
+  // states point to rather than those passed to Run
+  bool Shared(void) const {
+    return vExpressions.empty();
+  }
+  size_t Size(void) const {
+    return vCode.size();
+  }
+  // true if an arrayed equation needed something that can't be compiled
+  bool Unsupported(void) const {
+    return bUnsupported;
+  }
+
+  // used by Expression::Compile
+  int ComputeType(void) const {
+    return iComputeType;
+  }
+  int Width(void) const {  // elements in the equation being compiled
+    return iWidth;
+  }
+  bool Rows(void) const {  // true if conditions need to select rather than jump
+    return iWidth > 1 || iLanes > 1;
+  }
+  void Emit(int op, int arg = 0);
+  void Number(double value);
+  void Fallback(Expression *exp);  // an OP_EVAL for exp
+  void Call(int kernel);           // folded if the arguments are all numbers
+  void Lookup(ExpressionTable *table);
+  void Data(std::shared_ptr<const DataSeries> series, bool atTime);  // OP_DATA_AT if atTime, otherwise OP_DATA
+  bool Load(Variable *var, SymbolList *subs);  // false if var has no state
+  bool MacroCall(ExpressionList *args);  // the output of the use of a macro with these arguments
+  bool Numbers(const std::vector<double> &values);  // false unless there is one per element
+  bool PopConstant(double *value);  // takes back a trailing OP_NUMBER
+  // the stages or ring of the equation being compiled for the OP_STAGES_
+  // and OP_RING_ instructions - -1 if it has neither
+  int AddPipeline(bool material);
+  size_t Here(void) const {
+    return vCode.size();
+  }
+  void PatchJump(size_t at) {  // point the jump at the next instruction
+    vCode[at].arg = static_cast<int>(vCode.size());
+    iJumpTarget = vCode.size();
+  }
+
+private:
+  friend class CodeGenerator;
+  struct Segment {
+    size_t end;  // the code of an equation runs up to here
+    int width;
+  };
+  struct EquationCode {
+    Equation *eq;
+    size_t end;  // as for Segment, but never run together
+    int width;
+  };
+  struct Pipeline {
+    int stages;  // the first stage - the rates have the same offset
+    int count;
+    int ring;  // the first slot - the next gets taken from after the last
+    int length;
+    bool bMaterial;
+  };
+  bool Offsets(Variable *var, SymbolList *subs, std::vector<int> &offsets);
+  // the aux offset the code from pc to end, an equation, stores numbers
+  // alone at - -1 if it computes anything
+  int NumbersAt(size_t pc, size_t end) const;
+  void Prepare(Scratch *scratch) const;  // sizes what a run needs
+  double *RunPipeline(const Instruction &ins, double *sp, int width, int lanes, double *level, double *rate,
+                      double *aux) const;
+  void RunScalar(ContextInfo *info, size_t pc, size_t end, double *level, double *rate, double *aux,
+                 Scratch *scratch) const;
+  // width is the length of a row - the elements times the lanes
+  void RunVector(ContextInfo *info, size_t pc, size_t end, int width, int lanes, double *level, double *rate,
+                 double *aux, Scratch *scratch) const;
+  std::vector<Instruction> vCode;
+  std::vector<Segment> vSegments;
+  std::vector<EquationCode> vEquations;
+  std::vector<double> vConstants;
+  std::vector<Expression *> vExpressions;
+  std::vector<ExpressionTable *> vTables;
+  std::vector<std::shared_ptr<const DataSeries>> vData;  // kept for as long as the code is
+  std::vector<std::vector<int>> vGathers;
+  std::vector<Pipeline> vPipelines;
+  Scratch mScratch;  // for runs against the model's own arrays
+  std::vector<Symbol *> vDims;  // the left hand side subscripts of the equation being compiled
+  State *pState;                // and what it stores into
+  Model *pModel;
+  // the use of a macro the equation being compiled is from - NULL if none
+  const MacroInstance *pMacroInstance;
+  size_t iJumpTarget;  // nothing before this can be folded into what follows
+  double *pLevelBase;
+  double *pRateBase;
+  double *pAuxBase;
+  int iDepth;
+  int iMaxDepth;
+  int iComputeType;
+  int iWidth;
+  int iMaxWidth;
+  int iLanes;
+  bool bUnsupported;
+  bool bFoldFixed;
+};
+
+#endif
@@ -6,7 +6,7 @@ ExpressionList::ExpressionList(SymbolNameSpace *sns) : SymbolTableBase(sns) {
 }
 
 ExpressionList::~ExpressionList(void) {
-  if (this->HasGoodAlloc()) {
+  if (this->OwnsExpressions()) {
     for (Expression *e : vExpressions) {
       delete e;
     }
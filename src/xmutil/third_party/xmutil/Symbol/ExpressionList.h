@@ -1,9 +1,8 @@
 #ifndef _XMUTIL_EXPRESSIONIST_H
 #define _XMUTIL_EXPRESSIONIST_H
 
-#include <vector>
-
 #include "Expression.h"
+#include "SmallVector.h"
 class Model;
 
 class ExpressionList : public SymbolTableBase {
@@ -31,7 +30,7 @@ public:
   void OutputComputable(ContextInfo *info, unsigned wantargs);
 
 private:
-  std::vector<Expression *> vExpressions;
+  SmallVector<Expression *, 4> vExpressions;
 };
 
 #endif
\ No newline at end of file
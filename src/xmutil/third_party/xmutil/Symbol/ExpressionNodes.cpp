@@ -0,0 +1,261 @@
+#include "ExpressionNodes.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include "../ContextInfo.h"
+#include "../Symbol/Parse.h"
+#include "Expression.h"
+#include "ExpressionList.h"
+#include "Variable.h"
+#define YYSTYPE ParseUnion
+#include "../Vensim/VYacc.tab.hpp"
+
+static_assert(sizeof(ExpressionNodes::Node) == 16, "nodes are meant to pack into 16 bytes");
+
+uint32_t ExpressionNodes::Push(const Node &node) {
+  vNodes.push_back(node);
+  return static_cast<uint32_t>(vNodes.size() - 1);
+}
+
+uint32_t ExpressionNodes::Add(Expression *e) {
+  Node node;
+  node.tag = NODE_EXPRESSION;
+  node.op = 0;
+  node.index = 0;
+  switch (e->GetType()) {
+  case EXPTYPE_Number:
+    node.tag = NODE_NUMBER;
+    node.number = static_cast<ExpressionNumber *>(e)->GetValue();
+    return Push(node);
+  case EXPTYPE_Variable: {
+    ExpressionVariable *ev = static_cast<ExpressionVariable *>(e);
+    node.tag = NODE_VARIABLE;
+    node.variable = ev->GetVariable();
+    node.index = NODE_NONE;
+    if (ev->GetSubs()) {
+      node.index = static_cast<uint32_t>(vSubs.size());
+      vSubs.push_back(ev->GetSubs());
+    }
+    return Push(node);
+  }
+  case EXPTYPE_Operator:
+  case EXPTYPE_Logical:
+    node.tag = e->GetType() == EXPTYPE_Operator ? NODE_OPERATOR : NODE_LOGICAL;
+    node.op = e->GetType() == EXPTYPE_Operator ? static_cast<ExpressionOperator2 *>(e)->GetCode()
+                                               : static_cast<ExpressionLogical *>(e)->GetOper();
+    for (int i = 0; i < 2; i++)
+      node.operand[i] = e->GetArg(i) ? Add(e->GetArg(i)) : NODE_NONE;
+    return Push(node);
+  default:
+    break;
+  }
+  // the rest are called through, with what is under them kept to walk
+  std::vector<uint32_t> children;
+  if (e->GetType() == EXPTYPE_Function || e->GetType() == EXPTYPE_FunctionMemory) {
+    ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+    for (int i = 0, n = args ? args->Length() : 0; i < n; i++)
+      children.push_back(Add(args->GetExp(i)));
+  } else if (e->GetType() == EXPTYPE_Lookup) {
+    for (int i = 0; i < 2; i++) {
+      if (e->GetArg(i))
+        children.push_back(Add(e->GetArg(i)));
+    }
+  }
+  assert(children.size() <= UINT16_MAX);
+  node.expression = e;
+  node.index = static_cast<uint32_t>(vChildren.size());
+  node.op = static_cast<uint16_t>(children.size());
+  vChildren.insert(vChildren.end(), children.begin(), children.end());
+  return Push(node);
+}
+
+void ExpressionNodes::Clear(void) {
+  vNodes.clear();
+  vChildren.clear();
+  vSubs.clear();
+}
+
+void ExpressionNodes::GetVarsUsed(uint32_t node, std::vector<Variable *> &vars) const {
+  const Node &n = vNodes[node];
+  switch (n.tag) {
+  case NODE_VARIABLE: {
+    // as ExpressionVariable::GetVarsUsed
+    size_t pos = n.variable->VarsUsedPos();
+    if (pos < vars.size() && vars[pos] == n.variable)
+      return;
+    n.variable->SetVarsUsedPos(vars.size());
+    vars.push_back(n.variable);
+    return;
+  }
+  case NODE_OPERATOR:
+  case NODE_LOGICAL:
+    for (uint32_t operand : n.operand) {
+      if (operand != NODE_NONE)
+        GetVarsUsed(operand, vars);
+    }
+    return;
+  case NODE_EXPRESSION:
+    for (uint32_t i = 0; i < n.op; i++)
+      GetVarsUsed(vChildren[n.index + i], vars);
+    return;
+  default:
+    return;
+  }
+}
+
+double ExpressionNodes::Eval(uint32_t node, ContextInfo *info) const {
+  const Node &n = vNodes[node];
+  switch (n.tag) {
+  case NODE_NUMBER:
+    return n.number;
+  case NODE_VARIABLE:
+    return n.variable->Eval(info);
+  case NODE_EXPRESSION:
+    return n.expression->Eval(info);
+  case NODE_OPERATOR: {
+    bool first = n.operand[0] != NODE_NONE;
+    double a = first ? Eval(n.operand[0], info) : 0;
+    switch (n.op) {
+    case ExpressionCode::OP_NONE:
+      return a;
+    case ExpressionCode::OP_NEGATE:
+      return -a;
+    default:
+      break;
+    }
+    double b = Eval(n.operand[1], info);
+    switch (n.op) {
+    case ExpressionCode::OP_ADD:
+      return first ? a + b : b;
+    case ExpressionCode::OP_SUBTRACT:
+      return first ? a - b : -b;
+    case ExpressionCode::OP_MULTIPLY:
+      return a * b;
+    case ExpressionCode::OP_DIVIDE:
+      return a / b;
+    case ExpressionCode::OP_POWER:
+      return ExpressionCode::Power(a, b);
+    default:
+      assert(false);
+      return 0;
+    }
+  }
+  case NODE_LOGICAL: {
+    // as ExpressionLogical::Eval
+    if (n.op == VPTT_not)
+      return Eval(n.operand[1], info) == 0;
+    double a = Eval(n.operand[0], info);
+    switch (n.op) {
+    case VPTT_and:
+      return a != 0 && Eval(n.operand[1], info) != 0;
+    case VPTT_or:
+      return a != 0 || Eval(n.operand[1], info) != 0;
+    default:
+      break;
+    }
+    double b = Eval(n.operand[1], info);
+    switch (n.op) {
+    case VPTT_le:
+      return a <= b;
+    case VPTT_ge:
+      return a >= b;
+    case VPTT_ne:
+      return a != b;
+    case '<':
+      return a < b;
+    case '>':
+      return a > b;
+    case '=':
+      return a == b;
+    default:
+      info->SetEvalFailed();
+      return 0;
+    }
+  }
+  default:
+    assert(false);
+    return 0;
+  }
+}
+
+void ExpressionNodes::OutputComputable(uint32_t node, ContextInfo *info) const {
+  const Node &n = vNodes[node];
+  switch (n.tag) {
+  case NODE_NUMBER:
+    *info << n.number;
+    return;
+  case NODE_VARIABLE:
+    n.variable->OutputComputable(info);
+    if (n.index != NODE_NONE)
+      vSubs[n.index]->OutputComputable(info);
+    return;
+  case NODE_EXPRESSION:
+    n.expression->OutputComputable(info);
+    return;
+  default:
+    break;
+  }
+  // the operators - what goes before, between and after the operands
+  const char *before = "", *middle = "", *after = "";
+  char compare[4] = {' ', 0, ' ', 0};
+  if (n.tag == NODE_OPERATOR) {
+    switch (n.op) {
+    case ExpressionCode::OP_ADD:
+      middle = "+";
+      break;
+    case ExpressionCode::OP_SUBTRACT:
+      middle = "-";
+      break;
+    case ExpressionCode::OP_MULTIPLY:
+      middle = "*";
+      break;
+    case ExpressionCode::OP_DIVIDE:
+      middle = "/";
+      break;
+    case ExpressionCode::OP_POWER:
+      middle = "^";
+      break;
+    case ExpressionCode::OP_NEGATE:
+      before = "-";
+      break;
+    default:  // parentheses
+      before = "(";
+      after = ")";
+      break;
+    }
+  } else {
+    switch (n.op) {
+    case VPTT_le:
+      middle = " <= ";
+      break;
+    case VPTT_ge:
+      middle = " >= ";
+      break;
+    case VPTT_ne:
+      middle = " <> ";
+      break;
+    case VPTT_and:
+      middle = " and ";
+      break;
+    case VPTT_or:
+      middle = " or ";
+      break;
+    case VPTT_not:
+      middle = " not ";
+      break;
+    default:
+      assert(n.op < 128);
+      compare[1] = static_cast<char>(n.op);
+      middle = compare;
+      break;
+    }
+  }
+  *info << before;
+  if (n.operand[0] != NODE_NONE)
+    OutputComputable(n.operand[0], info);
+  *info << middle;
+  if (n.operand[1] != NODE_NONE)
+    OutputComputable(n.operand[1], info);
+  *info << after;
+}
@@ -0,0 +1,73 @@
+#ifndef _XMUTIL_SYMBOL_EXPRESSIONNODES_H
+#define _XMUTIL_SYMBOL_EXPRESSIONNODES_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+class ContextInfo;
+class Expression;
+class SymbolList;
+class Variable;
+
+#define NODE_NONE 0xffffffffu  // an operand that isn't there, as the + of unary plus
+
+/* ExpressionNodes - expression trees flattened into one array of 16 byte
+   records that refer to each other by index rather than pointer, so a walk
+   over every equation in a model reads straight through memory instead of
+   chasing nodes allocated all over the heap and calling through a vtable
+   at each one
+
+   numbers, variables and the arithmetic and logical operators are held
+   whole.  Anything else (function calls, lookups, tables, literals) keeps a
+   pointer back to its Expression, which the walks call as before, along
+   with the nodes of the expressions under it so the variables it uses can
+   still be found without going back to the tree
+
+   the nodes are a copy, not a replacement - the parser builds the trees
+   and marking flows rewrites them, so nodes have to be added again after
+   anything that changes the trees, and are best let go once walked */
+class ExpressionNodes {
+public:
+  enum Tag {
+    NODE_NUMBER,      // number
+    NODE_VARIABLE,    // variable, with its subscripts at vSubs[index] unless index is NODE_NONE
+    NODE_OPERATOR,    // operand[] under op, an ExpressionCode::Op (OP_NONE for parentheses)
+    NODE_LOGICAL,     // operand[] under op, a comparison or VPTT_and, VPTT_or or VPTT_not
+    NODE_EXPRESSION,  // expression, with the op nodes at vChildren[index] on under it
+  };
+  struct Node {
+    uint8_t tag;
+    uint16_t op;
+    uint32_t index;
+    union {
+      double number;
+      Variable *variable;
+      Expression *expression;
+      uint32_t operand[2];
+    };
+  };
+
+  // the node e becomes, the last of those for it and what's below it
+  uint32_t Add(Expression *e);
+  void Clear(void);
+  size_t Size(void) const {
+    return vNodes.size();
+  }
+  const Node &operator[](uint32_t node) const {
+    return vNodes[node];
+  }
+
+  // as the Expression functions of the same names
+  void GetVarsUsed(uint32_t node, std::vector<Variable *> &vars) const;
+  double Eval(uint32_t node, ContextInfo *info) const;
+  void OutputComputable(uint32_t node, ContextInfo *info) const;
+
+private:
+  uint32_t Push(const Node &node);
+  std::vector<Node> vNodes;
+  std::vector<uint32_t> vChildren;
+  std::vector<SymbolList *> vSubs;
+};
+
+#endif
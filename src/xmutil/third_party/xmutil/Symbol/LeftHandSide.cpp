@@ -25,7 +25,7 @@ LeftHandSide::LeftHandSide(SymbolNameSpace *sns, const LeftHandSide &base, Varia
 }
 
 LeftHandSide::~LeftHandSide(void) {
-  if (HasGoodAlloc()) {
+  if (OwnsChildren()) {
     if (pExpressionVariable)
       delete pExpressionVariable;
     if (pExceptList)
@@ -24,6 +24,9 @@ public:
   SymbolList *GetSubs() {
     return pExpressionVariable->GetSubs();
   }
+  SymbolListList *GetExceptList() {
+    return pExceptList;
+  }
 
 private:
   LeftHandSide(const LeftHandSide &base);
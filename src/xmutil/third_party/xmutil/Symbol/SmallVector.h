@@ -0,0 +1,100 @@
+#ifndef _XMUTIL_SYMBOL_SMALLVECTOR_H
+#define _XMUTIL_SYMBOL_SMALLVECTOR_H
+#include <stddef.h>
+#include <string.h>
+
+#include <type_traits>
+
+#include "SymbolArena.h"
+
+/* SmallVector - the storage for the short lists the parser grows an entry
+   at a time (subscripts, function arguments, except lists).  The first N
+   entries are held in the object itself so most lists never need a block
+   of their own, and a longer list takes one from the current SymbolArena
+   along with the object holding it
+
+   the entries are moved about as bytes so they must be trivially copyable
+   - pointers and small records of them */
+template <class T, unsigned N> class SmallVector {
+  static_assert(std::is_trivially_copyable<T>::value, "SmallVector entries are copied as bytes");
+
+public:
+  SmallVector(void) {
+    pData = Inline();
+    iSize = 0;
+    iCapacity = N;
+  }
+  SmallVector(const SmallVector &other) : SmallVector() {
+    *this = other;
+  }
+  ~SmallVector(void) {
+    if (pData != Inline())
+      SymbolArena::Free(pData);
+  }
+  SmallVector &operator=(const SmallVector &other) {
+    if (this != &other) {
+      iSize = 0;
+      reserve(other.iSize);
+      memcpy(pData, other.pData, other.iSize * sizeof(T));
+      iSize = other.iSize;
+    }
+    return *this;
+  }
+
+  void push_back(const T &entry) {
+    T copy = entry;  // entry may be one of ours
+    if (iSize == iCapacity)
+      Grow(iCapacity * 2);
+    pData[iSize++] = copy;
+  }
+  void reserve(size_t capacity) {
+    if (capacity > iCapacity)
+      Grow(static_cast<unsigned>(capacity));
+  }
+  void clear(void) {
+    iSize = 0;
+  }
+  size_t size(void) const {
+    return iSize;
+  }
+  bool empty(void) const {
+    return iSize == 0;
+  }
+  T &operator[](size_t pos) {
+    return pData[pos];
+  }
+  const T &operator[](size_t pos) const {
+    return pData[pos];
+  }
+  T *begin(void) {
+    return pData;
+  }
+  T *end(void) {
+    return pData + iSize;
+  }
+  const T *begin(void) const {
+    return pData;
+  }
+  const T *end(void) const {
+    return pData + iSize;
+  }
+
+private:
+  T *Inline(void) {
+    return reinterpret_cast<T *>(mInline);
+  }
+  void Grow(unsigned capacity) {
+    T *data = static_cast<T *>(SymbolArena::AllocateBytes(capacity * sizeof(T)));
+    memcpy(data, pData, iSize * sizeof(T));
+    if (pData != Inline())
+      SymbolArena::Free(pData);
+    pData = data;
+    iCapacity = capacity;
+  }
+  T *pData;
+  unsigned iSize;
+  unsigned iCapacity;
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type mInline[N];
+};
+
+#endif
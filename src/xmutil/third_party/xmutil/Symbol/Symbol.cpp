@@ -9,22 +9,23 @@
 // does not manage self needs to be part of a collection
 
 Symbol::Symbol(SymbolNameSpace *sns, const std::string &name) : SymbolTableBase(sns) {
-  sName = name;
+  pName = sns->Intern(name);
   pOwner = NULL;
   pSubranges = NULL;
+  iNameSpacePos = 0;
   // insert into the name space sns if it has a name - empty get special treatment
   if (!name.empty())
     sns->Insert(this);
 }
 
 Symbol::~Symbol(void) {
-  if (!HasGoodAlloc() && !sName.empty()) {  // remove from the lookup table
+  if (!SymbolArena::Releasing() && !HasGoodAlloc() && !pName->empty()) {  // remove from the lookup table
     GetSymbolNameSpace()->Remove(this);
   }
 }
 
 const std::string &Symbol::GetName(void) {
-  return sName;
+  return *pName;
 }
 
 void Symbol::SetOwner(Symbol *var) {
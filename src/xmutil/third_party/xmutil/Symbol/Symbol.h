@@ -1,6 +1,7 @@
 #ifndef _XMUTIL_SYMBOL_H
 #define _XMUTIL_SYMBOL_H
 
+#include <set>
 #include <string>
 
 #include "../ContextInfo.h"
@@ -43,7 +44,7 @@ public:
   }
   const std::string &GetName(void);
   inline void SetName(const std::string &name) {
-    sName = name;
+    pName = GetSymbolNameSpace()->Intern(name);
   }
   void SetOwner(Symbol *var);
   void AddSubrange(Symbol *sub, Symbol *oldowner);
@@ -53,9 +54,17 @@ public:
   Symbol *Owner() {
     return pOwner ? pOwner : this;
   }
+  // where this is in SymbolNameSpace::Symbols - maintained by the name space
+  size_t NameSpacePos() const {
+    return iNameSpacePos;
+  }
+  void SetNameSpacePos(size_t pos) {
+    iNameSpacePos = pos;
+  }
 
 private:
-  std::string sName;
+  const std::string *pName;  // interned in the name space
+  size_t iNameSpacePos;
   Symbol *pOwner;
   std::set<Symbol *> *pSubranges;  // backward from SetOwber
 };
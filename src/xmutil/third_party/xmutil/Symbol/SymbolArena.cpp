@@ -0,0 +1,178 @@
+#include "SymbolArena.h"
+
+#include <new>
+
+#include "../Limits.h"
+#include "../XMUtil.h"
+#include "SymbolTableBase.h"
+
+// every allocation is preceded by a header saying where it came from so
+// that Free can find its way back to the arena
+struct SymbolArenaHeader {
+  SymbolArena *arena;  // NULL for heap allocations made outside of a Scope
+  size_t index;        // position in the arena's object list
+};
+#define ARENA_NOT_OBJECT static_cast<size_t>(-1)  // the index of AllocateBytes memory
+
+#define ARENA_ALIGN alignof(std::max_align_t)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_HEADER ARENA_ROUND(sizeof(SymbolArenaHeader))
+#define ARENA_BLOCK 65536
+
+static thread_local SymbolArena *tCurrentArena = NULL;
+static thread_local SymbolArena *tReleasingArena = NULL;
+
+// released ARENA_BLOCK sized blocks waiting for the next arena on the thread
+struct SymbolArenaCache {
+  ~SymbolArenaCache(void) {
+    Trim();
+  }
+  void Trim(void) {
+    for (char *block : vBlocks)
+      ::operator delete(block);
+    vBlocks.clear();
+  }
+  std::vector<char *> vBlocks;
+};
+static thread_local SymbolArenaCache tBlockCache;
+
+SymbolArena::SymbolArena(void) {
+  pNext = pEnd = NULL;
+}
+
+SymbolArena::~SymbolArena(void) {
+  Release();
+}
+
+void SymbolArena::Release(void) {
+  SymbolArena *previous = tReleasingArena;
+  tReleasingArena = this;
+  // newest first - nothing is destroyed before the things created after it
+  for (size_t i = vObjects.size(); i-- > 0;) {
+    void *p = vObjects[i];
+    if (p) {
+      vObjects[i] = NULL;
+      // SymbolTableBase is the first base of everything allocated here so
+      // the allocation address is also the object address
+      static_cast<SymbolTableBase *>(p)->~SymbolTableBase();
+    }
+  }
+  tReleasingArena = previous;
+  vObjects.clear();
+  std::vector<char *> &cache = tBlockCache.vBlocks;
+  for (char *block : vBlocks) {
+    if (cache.size() < ARENA_CACHE_BLOCKS)
+      cache.push_back(block);
+    else
+      ::operator delete(block);
+  }
+  vBlocks.clear();
+  for (char *block : vBigBlocks)
+    ::operator delete(block);
+  vBigBlocks.clear();
+  pNext = pEnd = NULL;
+}
+
+void SymbolArena::Adopt(SymbolArena &other) {
+  for (void *p : other.vObjects) {
+    if (p) {
+      SymbolArenaHeader *header = reinterpret_cast<SymbolArenaHeader *>(static_cast<char *>(p) - ARENA_HEADER);
+      header->arena = this;
+      header->index = vObjects.size();
+      vObjects.push_back(p);
+    }
+  }
+  other.vObjects.clear();
+  // the rest of other's current block is left unused
+  vBlocks.insert(vBlocks.end(), other.vBlocks.begin(), other.vBlocks.end());
+  other.vBlocks.clear();
+  vBigBlocks.insert(vBigBlocks.end(), other.vBigBlocks.begin(), other.vBigBlocks.end());
+  other.vBigBlocks.clear();
+  other.pNext = other.pEnd = NULL;
+}
+
+void *SymbolArena::Bump(size_t size) {
+  if (size > static_cast<size_t>(pEnd - pNext)) {
+    if (size > ARENA_BLOCK / 4) {  // big ones get their own block and leave the current one alone
+      char *block = static_cast<char *>(::operator new(size));
+      vBigBlocks.push_back(block);
+      ConversionLimits::Allocated(size);
+      return block;
+    }
+    std::vector<char *> &cache = tBlockCache.vBlocks;
+    char *block;
+    if (cache.empty()) {
+      block = static_cast<char *>(::operator new(ARENA_BLOCK));
+    } else {
+      block = cache.back();
+      cache.pop_back();
+    }
+    vBlocks.push_back(block);
+    ConversionLimits::Allocated(ARENA_BLOCK);  // a cached block counts - it is held for the model
+    pNext = block;
+    pEnd = block + ARENA_BLOCK;
+  }
+  void *p = pNext;
+  pNext += size;
+  return p;
+}
+
+void *SymbolArena::Allocate(size_t size) {
+  SymbolArena *arena = tCurrentArena;
+  SymbolArenaHeader *header;
+  if (arena) {
+    header = static_cast<SymbolArenaHeader *>(arena->Bump(ARENA_HEADER + ARENA_ROUND(size)));
+    header->index = arena->vObjects.size();
+  } else {
+    header = static_cast<SymbolArenaHeader *>(::operator new(ARENA_HEADER + size));
+    header->index = 0;
+  }
+  header->arena = arena;
+  void *p = reinterpret_cast<char *>(header) + ARENA_HEADER;
+  if (arena)
+    arena->vObjects.push_back(p);
+  return p;
+}
+
+void *SymbolArena::AllocateBytes(size_t size) {
+  SymbolArena *arena = tCurrentArena;
+  SymbolArenaHeader *header;
+  if (arena)
+    header = static_cast<SymbolArenaHeader *>(arena->Bump(ARENA_HEADER + ARENA_ROUND(size)));
+  else
+    header = static_cast<SymbolArenaHeader *>(::operator new(ARENA_HEADER + size));
+  header->arena = arena;
+  header->index = ARENA_NOT_OBJECT;
+  return reinterpret_cast<char *>(header) + ARENA_HEADER;
+}
+
+void SymbolArena::Free(void *p) {
+  if (!p)
+    return;
+  SymbolArenaHeader *header = reinterpret_cast<SymbolArenaHeader *>(static_cast<char *>(p) - ARENA_HEADER);
+  if (!header->arena)
+    ::operator delete(header);
+  else if (header->index != ARENA_NOT_OBJECT)
+    header->arena->vObjects[header->index] = NULL;  // the memory itself comes back on Release
+}
+
+bool SymbolArena::Releasing(void) {
+  return tReleasingArena != NULL;
+}
+
+bool SymbolArena::Active(void) {
+  return tCurrentArena != NULL;
+}
+
+void SymbolArena::Trim(void) {
+  tBlockCache.Trim();
+}
+
+SymbolArena::Scope::Scope(SymbolArena *arena) {
+  pPrevious = tCurrentArena;
+  tCurrentArena = arena;
+}
+
+SymbolArena::Scope::~Scope(void) {
+  tCurrentArena = pPrevious;
+}
@@ -0,0 +1,65 @@
+#ifndef _XMUTIL_SYMBOL_SYMBOLARENA_H
+#define _XMUTIL_SYMBOL_SYMBOLARENA_H
+#include <cstddef>
+#include <vector>
+
+/* SymbolArena - a bump allocator for the SymbolTableBase object graph
+  (expressions, equations, symbols and so on)
+
+  while a SymbolArena::Scope is active on a thread every SymbolTableBase
+  created on that thread is carved out of the arena.  deleting an object
+  still runs its destructor but the memory is only reclaimed when the
+  arena is released.  Release destroys whatever objects are still alive -
+  without following the pointers between them - and gives the blocks back
+  in one go, so a Model that owns an arena cleans up completely
+
+  the standard size blocks go to a per thread cache, up to
+  ARENA_CACHE_BLOCKS of them, for the next arena on the thread to carve
+  from - converting models back to back then stops going through the
+  system allocator once the cache is warm.  Trim empties the cache */
+#define ARENA_CACHE_BLOCKS 64  // 4MB at 64K a block
+class SymbolArena {
+public:
+  SymbolArena(void);
+  ~SymbolArena(void);
+  void Release(void);
+  // takes over what other holds - its objects are released with this
+  // arena's from then on, after them as they are newer.  other is left
+  // empty.  Neither arena may be in use on another thread
+  void Adopt(SymbolArena &other);
+
+  // used by SymbolTableBase::operator new/delete - outside of any Scope
+  // these fall back to the regular heap
+  static void *Allocate(size_t size);
+  static void Free(void *p);
+  // memory that isn't an object, so Release leaves it be - for the storage
+  // behind the objects, as SmallVector uses.  Free gives it back
+  static void *AllocateBytes(size_t size);
+  // true while this thread is releasing an arena - destructors should
+  // then leave the objects they point to alone as they are being
+  // destroyed anyway
+  static bool Releasing(void);
+  // true while a Scope is active on this thread
+  static bool Active(void);
+  // frees the blocks this thread is keeping for reuse
+  static void Trim(void);
+
+  class Scope {
+  public:
+    Scope(SymbolArena *arena);
+    ~Scope(void);
+
+  private:
+    SymbolArena *pPrevious;
+  };
+
+private:
+  void *Bump(size_t size);
+  std::vector<char *> vBlocks;
+  std::vector<char *> vBigBlocks;  // larger than ARENA_BLOCK, so never cached
+  char *pNext;
+  char *pEnd;
+  std::vector<void *> vObjects;  // live objects in allocation order - NULL once deleted
+};
+
+#endif
@@ -1,8 +1,7 @@
 #ifndef _XMUTIL_SYMLIST_H
 #define _XMUTIL_SYMLIST_H
 
-#include <vector>
-
+#include "SmallVector.h"
 #include "Symbol.h"
 #include "SymbolTableBase.h"
 
@@ -37,7 +36,7 @@ public:
     vSymbols.push_back(SymbolListEntry(next));
     return this;
   }
-  int Length(void) {
+  int Length(void) const {
     return vSymbols.size();
   }
   const SymbolListEntry &operator[](int pos) const {
@@ -57,7 +56,7 @@ public:
   virtual void OutputComputable(ContextInfo *info);
 
 private:
-  std::vector<SymbolListEntry> vSymbols;
+  SmallVector<SymbolListEntry, 4> vSymbols;
   Symbol *pMapRange;
 };
 
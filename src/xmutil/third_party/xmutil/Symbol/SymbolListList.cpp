@@ -14,7 +14,7 @@ SymbolListList::SymbolListList(SymbolNameSpace *sns, SymbolListList *orig) : Sym
 }
 
 SymbolListList::~SymbolListList(void) {
-  if (bNoDelete)
+  if (bNoDelete || SymbolArena::Releasing())
     return;
   int n = vSymbolLists.size();
   for (int i = 0; i < n; i++)
@@ -1,8 +1,7 @@
 #ifndef _XMUTIL_SYMBOLLISTLIST_H
 #define _XMUTIL_SYMBOLLISTLIST_H
 
-#include <vector>
-
+#include "SmallVector.h"
 #include "SymbolList.h"
 #include "SymbolTableBase.h"
 
@@ -14,7 +13,7 @@ public:
     vSymbolLists.push_back(last);
     return this;
   }
-  int Length(void) {
+  int Length(void) const {
     return vSymbolLists.size();
   }
   const SymbolList *operator[](int pos) const {
@@ -23,7 +22,7 @@ public:
   ~SymbolListList(void);
 
 private:
-  std::vector<SymbolList *> vSymbolLists;
+  SmallVector<SymbolList *, 4> vSymbolLists;
   bool bNoDelete;
 };
 
@@ -2,13 +2,36 @@
 
 #include <assert.h>
 
-#include <cstring>
+#include <algorithm>
 
+#include "../Stats.h"
 #include "../XMUtil.h"
 #include "Symbol.h"
+#include "Variable.h"
+#include "libutf/utf.h"
+
+thread_local SymbolNameSpace *SymbolNameSpace::tLogNameSpace = NULL;
+thread_local SymbolNameSpace::Log *SymbolNameSpace::tLog = NULL;
+
+SymbolNameSpace::LogScope::LogScope(SymbolNameSpace *sns, Log *log) {
+  pPreviousNameSpace = tLogNameSpace;
+  pPrevious = tLog;
+  tLogNameSpace = sns;
+  tLog = log;
+}
+
+SymbolNameSpace::LogScope::~LogScope(void) {
+  tLogNameSpace = pPreviousNameSpace;
+  tLog = pPrevious;
+}
 
 SymbolNameSpace::SymbolNameSpace(void) {
-  assert(sUnconfirmedAllocations.size() == 0);
+  bSharesExpressions = false;
+  iRemoved = 0;
+  bVariablesKnown = false;
+  bConcurrent = false;
+  bFrozen = false;
+  pBuiltins = NULL;
 }
 
 SymbolNameSpace::~SymbolNameSpace(void) {
@@ -18,116 +41,259 @@ SymbolNameSpace::~SymbolNameSpace(void) {
   // }
 }
 
-Symbol *SymbolNameSpace::Find(const std::string &sin) {
-  std::string *s = ToLowerSpace(sin);
-  HashTable::iterator node = mHashTable.find(*s);
-  delete s;
-  if (node != mHashTable.end())
-    return node->second;
-  return NULL;
+Symbol *SymbolNameSpace::Find(const char *name, size_t len) {
+  XMUTIL_COUNT(lookups, 1);
+  const std::string &s = ToLowerSpace(name, len);
+  Symbol *sym = FindOwn(s);
+  if (!sym)
+    sym = FindBuiltin(s);
+  if (!sym)
+    XMUTIL_COUNT(lookupMisses, 1);
+  return sym;
+}
+
+Symbol *SymbolNameSpace::FindBuiltinFirst(const char *name, size_t len) {
+  XMUTIL_COUNT(lookups, 1);
+  const std::string &s = ToLowerSpace(name, len);
+  Symbol *sym = FindBuiltin(s);
+  if (!sym)
+    sym = FindOwn(s);
+  if (!sym)
+    XMUTIL_COUNT(lookupMisses, 1);
+  return sym;
+}
+
+Symbol *SymbolNameSpace::FindOwn(const std::string &s) {
+  Shard &shard = ShardFor(s);
+  Lock lock{shard.mLock, bConcurrent};
+  HashTable::iterator node = shard.mTable.find(s);
+  if (node == shard.mTable.end())
+    return NULL;
+  Touched(node->second);
+  return node->second;
+}
+
+Symbol *SymbolNameSpace::FindBuiltin(const std::string &s) const {
+  if (!pBuiltins)
+    return NULL;
+  // never changes so needs no lock
+  const std::vector<std::pair<std::string, Symbol *>> &sorted = pBuiltins->vSorted;
+  std::vector<std::pair<std::string, Symbol *>>::const_iterator it =
+      std::lower_bound(sorted.begin(), sorted.end(), s,
+                       [](const std::pair<std::string, Symbol *> &entry, const std::string &key) {
+                         return entry.first < key;
+                       });
+  return it != sorted.end() && it->first == s ? it->second : NULL;
+}
+
+void SymbolNameSpace::Freeze(void) {
+  vSorted.clear();
+  for (const Shard &shard : aShards)
+    vSorted.insert(vSorted.end(), shard.mTable.begin(), shard.mTable.end());
+  std::sort(vSorted.begin(), vSorted.end());
+  bFrozen = true;
 }
 
 void SymbolNameSpace::Insert(Symbol *sym) {
-  std::string *s = ToLowerSpace(sym->GetName());
-  HashTable::iterator node = mHashTable.find(*s);
-  if (node != mHashTable.end()) {
-    assert(node->second == sym);
-    delete s;
-    return; /* already in place */
-  }
-  mHashTable[*s] = sym;
-  delete s;
+  // called while sym is being made - another thread could find it half
+  // made, so that waits for Kept
+  if (bConcurrent)
+    return;
+  Symbol *in = InsertIfAbsent(sym);
+  assert(in == sym); /* already in place if not new */
+  (void)in;
+}
+
+Symbol *SymbolNameSpace::Kept(Symbol *sym) {
+  if (!bConcurrent)
+    return sym;
+  Symbol *held = InsertIfAbsent(sym);
+  if (held != sym)
+    delete sym;  // still unconfirmed so takes itself out of the log
+  return held;
+}
+
+Symbol *SymbolNameSpace::InsertIfAbsent(Symbol *sym) {
+  const std::string &s = ToLowerSpace(sym->GetName());
+  Shard &shard = ShardFor(s);
+  Lock lock{shard.mLock, bConcurrent};
+  std::pair<HashTable::iterator, bool> node = shard.mTable.emplace(s, sym);
+  Touched(node.first->second);
+  if (!node.second)
+    return node.first->second;
+  Lock order{mSymbolsLock, bConcurrent};
+  sym->SetNameSpacePos(vSymbols.size());
+  vSymbols.push_back(sym);
+  bVariablesKnown = false;
+  return sym;
 }
 
 bool SymbolNameSpace::Remove(Symbol *sym) {
-  std::string *s = ToLowerSpace(sym->GetName());
-  HashTable::iterator node = mHashTable.find(*s);
-  delete s;
-  if (node != mHashTable.end()) {
-    mHashTable.erase(node);
+  const std::string &s = ToLowerSpace(sym->GetName());
+  Shard &shard = ShardFor(s);
+  Lock lock{shard.mLock, bConcurrent};
+  HashTable &table = shard.mTable;
+  HashTable::iterator node = table.find(s);
+  // a symbol that lost a race to InsertIfAbsent has its name but isn't
+  // what the table holds for it
+  if (node != table.end() && node->second == sym) {
+    table.erase(node);
+    Lock order{mSymbolsLock, bConcurrent};
+    size_t pos = sym->NameSpacePos();
+    assert(pos < vSymbols.size() && vSymbols[pos] == sym);
+    vSymbols[pos] = NULL;  // keeps the others where they are
+    iRemoved++;
+    bVariablesKnown = false;
     return true; /* already in place */
   }
   return false;
 }
 
+const std::vector<Symbol *> &SymbolNameSpace::Symbols(void) {
+  if (iRemoved) {
+    size_t n = 0;
+    for (Symbol *sym : vSymbols) {
+      if (sym) {
+        sym->SetNameSpacePos(n);
+        vSymbols[n++] = sym;
+      }
+    }
+    vSymbols.resize(n);
+    iRemoved = 0;
+  }
+  return vSymbols;
+}
+
+const std::vector<Variable *> &SymbolNameSpace::Variables(void) {
+  if (!bVariablesKnown) {
+    vVariables.clear();
+    for (Symbol *sym : Symbols()) {
+      if (sym->isType() == Symtype_Variable)
+        vVariables.push_back(static_cast<Variable *>(sym));
+    }
+    bVariablesKnown = true;
+  }
+  return vVariables;
+}
+
 bool SymbolNameSpace::Rename(Symbol *sym, const std::string &newname) {
-  std::string *s = ToLowerSpace(sym->GetName());
-  HashTable::iterator oldnode = mHashTable.find(*s);
-  delete s;
-  std::string *s2 = ToLowerSpace(newname);
-  HashTable::iterator newnode = mHashTable.find(*s2);
-  if (oldnode != mHashTable.end() && newnode == mHashTable.end()) {
-    mHashTable.erase(oldnode);
-    mHashTable[*s2] = sym;
-    delete s2;
+  const std::string &s1 = ToLowerSpace(sym->GetName());
+  HashTable &oldtable = ShardFor(s1).mTable;
+  HashTable::iterator oldnode = oldtable.find(s1);
+  const std::string &s2 = ToLowerSpace(newname);  // reuses the buffer - oldnode is already found
+  HashTable &newtable = ShardFor(s2).mTable;
+  if (oldnode != oldtable.end() && !newtable.count(s2) && !FindBuiltin(s2)) {
+    oldtable.erase(oldnode);
+    newtable[s2] = sym;
     sym->SetName(newname);
     return true; /* already in place */
   }
-  delete s2;
   return false;
 }
 
+const std::string *SymbolNameSpace::Intern(const std::string &name) {
+  Lock lock{mNamesLock, bConcurrent};
+  std::unordered_set<std::string>::const_iterator it = sNames.find(name);
+  if (it != sNames.end())
+    return &*it;
+  return &*sNames.insert(name).first;
+}
+
+const std::string *SymbolNameSpace::InternUnderBar(const std::string &name) {
+  if (name.find(' ') == std::string::npos)
+    return Intern(name);
+  return Intern(SpaceToUnderBar(name));
+}
+
+static inline bool IsNameSpace(char c) {
+  return c == ' ' || c == '_' || c == '\t' || c == '\n' || c == '\r';
+}
+
 // note that this works on escaped strings - but does not validate
 // escaping beyond stripping a leading " matched to a terminal " (that is
 // "this is "not a good" string" would become
 // this is "not a good" string
 // which is invalid
 //
-std::string *SymbolNameSpace::ToLowerSpace(const std::string &sin) {
-  int n = sin.length();
-  char *ws = new char[n + 2];
-  memset(ws, 0, n + 2);
-  memcpy(ws, sin.c_str(), n);
-  if (*ws == '\"' && ws[n - 1] == '\"' && n > 1) {
-    memcpy(ws, sin.c_str() + 1, n - 2);
+// the result goes into a per thread buffer that is reused by the next
+// call so that lookups don't allocate - copy it if it needs to be kept
+const std::string &SymbolNameSpace::ToLowerSpace(const char *src, size_t n) {
+  static thread_local std::string ws;
+  if (n > 1 && src[0] == '\"' && src[n - 1] == '\"') {
+    src++;
     n -= 2;
   }
-  ws[n] = 0;
+  ws.clear();
 
-  int i, j;
-  for (i = j = 0; i < n; i++)  // remove leading blanks
-    if (ws[i] != ' ' && ws[i] != '_' && ws[i] != '\t' && ws[i] != '\n' && ws[i] != '\r')
+  size_t i;
+  for (i = 0; i < n; i++)  // remove leading blanks
+    if (!IsNameSpace(src[i]))
       break;
-  // convert underbars to blanks and compact
+  // convert underbars to blanks and compact, lower case as we go
   for (; i < n; i++) {
-    if (ws[i] == '\\' && i < n - 1 && ws[i + 1] == '_') {
-      ws[j++] = '\\';
-      ws[j++] = '_';
+    char c = src[i];
+    if (c == '\\' && i < n - 1 && src[i + 1] == '_') {
+      ws += "\\_";
       i++;  // hard underbar treat as a nonspace character
-    } else if (ws[i] == '_' || ws[i] == ' ' || ws[i] == '\t' || ws[i] == '\n' || ws[i] == '\r') {
+    } else if (IsNameSpace(c)) {
       for (; i < n - 1; i++) {
-        if (ws[i + 1] != ' ' && ws[i + 1] != '_' && ws[i + 1] != '\t' && ws[i + 1] != '\n' && ws[i + 1] != '\r')
+        if (!IsNameSpace(src[i + 1]))
           break;
       }
-      ws[j++] = ' ';
-    } else
-      ws[j++] = ws[i];
-  }
-  for (; j > 0; j--) {
-    if (ws[j - 1] != ' ' && ws[j - 1] != '_' && ws[j - 1] != '\t' && ws[j - 1] != '\n' && ws[j - 1] != '\r')
-      break;
+      ws.push_back(' ');
+    } else if (!(c & 0x80)) {
+      ws.push_back(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    } else if (!fullrune(const_cast<char *>(&src[i]), n - i)) {
+      ws.push_back(c);  // truncated sequence - the name need not be terminated so don't read past it
+    } else {
+      Rune u;
+      int len = chartorune(&u, &src[i]);
+      Rune l = RuneToLower(u);
+      char buf[UTFmax];
+      ws.append(buf, runetochar(buf, &l));
+      i += len - 1;
+    }
   }
-  ws[j] = 0;
-  char *ws2 = utf8ToLower(ws, j);
-  std::string *s = new std::string(ws2);
-  delete[] ws;
-  delete[] ws2;
-  return s;
+  while (!ws.empty() && IsNameSpace(ws.back()))
+    ws.pop_back();
+  return ws;
 }
 
 void SymbolNameSpace::DeleteAllUnconfirmedAllocations(void) {
-  std::set<SymbolTableBase *>::iterator i;
-  while ((i = sUnconfirmedAllocations.begin()) != sUnconfirmedAllocations.end()) {
-    SymbolTableBase *s = *i;
-    sUnconfirmedAllocations.erase(i);
-    delete (s);
+  Log &log = ActiveLog();
+  // newest first - unconfirmed objects don't delete what they point to so
+  // the order only matters for the name table
+  for (size_t i = log.vAllocations.size(); i-- > log.iConfirmed;) {
+    SymbolTableBase *s = log.vAllocations[i];
+    if (s) {
+      log.vAllocations[i] = NULL;
+      delete (s);
+    }
   }
-  sUnconfirmedAllocations.clear();
+  log.vAllocations.resize(log.iConfirmed);
 }
 
 void SymbolNameSpace::ConfirmAllAllocations(void) {
-  for (std::set<SymbolTableBase *>::value_type i : sUnconfirmedAllocations) {
-    i->MarkGoodAlloc();
+  Log &log = ActiveLog();
+  log.iConfirmed = log.vAllocations.size();
+}
+
+void SymbolNameSpace::Adopt(Log &log) {
+  assert(&log != &mLog);
+  for (size_t i = 0; i < log.vAllocations.size(); i++) {
+    if (SymbolTableBase *s = log.vAllocations[i]) {
+      s->iAllocation = mLog.vAllocations.size();
+      mLog.vAllocations.push_back(s);
+    }
   }
-  sUnconfirmedAllocations.clear();
+  mLog.iConfirmed = mLog.vAllocations.size();
+  log = Log();
+}
+
+void SymbolNameSpace::SetOrder(const std::vector<Symbol *> &order) {
+  assert(order.size() == Symbols().size());
+  vSymbols = order;
+  for (size_t i = 0; i < vSymbols.size(); i++)
+    vSymbols[i]->SetNameSpacePos(i);
+  bVariablesKnown = false;
 }
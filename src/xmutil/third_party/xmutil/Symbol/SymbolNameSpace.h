@@ -1,44 +1,212 @@
 #ifndef _XMUTIL_SYMBOL_NAMESPACE_H
 #define _XMUTIL_SYMBOL_NAMESPACE_H
-#include <set>
+#include <assert.h>
+
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../XMUtil.h"
+#ifndef XMUTIL_NO_THREADS
+#include <mutex>
+#endif
 class Symbol;
 class SymbolTableBase;  // forward declaration
+class Variable;
 
 /* Namespace gives hashed lookup for names
 
    to make it case and _ insensitive we convert the incoming name before
-   passing it to the lookup functions - altering the hash and equality
-   function would (likely) be a bit faster */
+   passing it to the lookup functions - the conversion is done into a
+   reused buffer so a lookup does not allocate
+
+   the names themselves are interned - each distinct spelling is stored
+   once and Symbols point at it, so equal names share storage and can be
+   compared by address
+
+   the symbols are also kept in the order they were added, which is the
+   order every pass goes through them in - the hash table is only there
+   for finding them by name, so results don't depend on how a particular
+   standard library lays its buckets out
+
+   the table is split into shards by the hash of the converted name, each
+   with a lock of its own that is only taken once the name space is set
+   concurrent - then any number of threads can find, insert if absent and
+   intern at once, waiting on each other only for names in the same shard.
+   The symbols stay where they were made so what is found stays valid
+
+   names not found are looked for in the builtins name space if there is
+   one - the functions every model starts with are made once and shared,
+   read only, by every name space of every conversion
+
+   it also keeps a log of SymbolTableBase allocations so that a partially
+   parsed equation can be thrown away - everything before the checkpoint
+   is confirmed, everything after it is deleted on rollback.  A thread
+   reading equations of its own while the name space is concurrent keeps
+   a Log apart under a LogScope, which Adopt later takes in */
 
-#define SNSitToSymbol(it) (it.second)
 class SymbolNameSpace {
 public:
+  // an allocation log - the name space's own, or one a thread keeps apart
+  struct Log {
+    Log(void) : iConfirmed(0) {
+    }
+    std::vector<SymbolTableBase *> vAllocations;  // NULL once deleted
+    size_t iConfirmed;                             // allocations before this are confirmed
+    // with a LogScope, the symbols of the name space found or inserted by
+    // name in the order they were - the first use of each is where a read
+    // on one thread would have inserted it
+    std::vector<Symbol *> vTouched;
+  };
+  // while one is active on a thread the allocations made against sns on
+  // that thread go to log rather than the name space's own, and so do
+  // confirming and rolling them back
+  class LogScope {
+  public:
+    LogScope(SymbolNameSpace *sns, Log *log);
+    ~LogScope(void);
+
+  private:
+    SymbolNameSpace *pPreviousNameSpace;
+    Log *pPrevious;
+  };
   SymbolNameSpace(void);
   ~SymbolNameSpace(void);
-  Symbol *Find(const std::string &name);
+  Symbol *Find(const std::string &name) {
+    return Find(name.c_str(), name.length());
+  }
+  Symbol *Find(const char *name, size_t len);  // name need not be terminated
   void Insert(Symbol *sym);
+  // sym if nothing has its name yet, otherwise what does - when threads
+  // race to add the same name they all get the one that got there first
+  Symbol *InsertIfAbsent(Symbol *sym);
+  // a symbol just made with a name, or what another thread made with the
+  // same name first when they raced - sym is then deleted.  Once
+  // concurrent a new symbol is only added to the table by this, so
+  // anything making symbols then needs it
+  Symbol *Kept(Symbol *sym);
+  // whether Find, Insert, InsertIfAbsent, Kept, Remove and Intern can be
+  // called from more than one thread at once - set while nothing else is
+  // using the name space.  Rename and the symbol lists still need it to
+  // themselves, and each thread needs an allocation log of its own
+  void SetConcurrent(bool concurrent) {
+    bConcurrent = concurrent;
+  }
+  // where Find looks for names this doesn't have - builtins is never changed
+  // after being set up, and Freeze has been called, so can be shared across
+  // threads
+  void SetBuiltins(const SymbolNameSpace *builtins) {
+    assert(!builtins || builtins->bFrozen);
+    pBuiltins = builtins;
+  }
+  // done adding - makes the table sorted by converted name that the name
+  // spaces using this as their builtins search
+  void Freeze(void);
+  // as Find but looking in the builtins before this name space's own names
+  Symbol *FindBuiltinFirst(const char *name, size_t len);
   bool Remove(Symbol *sym);
   bool Rename(Symbol *sym, const std::string &newname);
+  // the returned string lives as long as the name space
+  const std::string *Intern(const std::string &name);
+  const std::string *InternUnderBar(const std::string &name);  // Intern(SpaceToUnderBar(name))
   void DeleteAllUnconfirmedAllocations(void);
   void ConfirmAllAllocations(void);
-  void RemoveUnconfirmedAllocation(SymbolTableBase *s) {
-    sUnconfirmedAllocations.erase(s);
+  inline void RemoveUnconfirmedAllocation(size_t index) {
+    ActiveLog().vAllocations[index] = NULL;
   }
-  inline void AddUnconfirmedAllocation(SymbolTableBase *s) {
-    sUnconfirmedAllocations.insert(s);
+  inline size_t AddUnconfirmedAllocation(SymbolTableBase *s) {
+    Log &log = ActiveLog();
+    log.vAllocations.push_back(s);
+    return log.vAllocations.size() - 1;
   }
-  typedef std::unordered_map<std::string, Symbol *> HashTable;
-  typedef HashTable::value_type iterator;  // allows iterator type to be used directly with c++11 for loops
-  inline HashTable *GetHashTable(void) {
-    return &mHashTable;
+  inline bool IsConfirmedAllocation(size_t index) {
+    return index < ActiveLog().iConfirmed;
+  }
+  // the allocations in log, kept under a LogScope that is gone now, as the
+  // newest of the name space's own - all of them confirmed.  log is left
+  // empty
+  void Adopt(Log &log);
+  // puts the symbols in order, which has each of them once - for after
+  // threads have inserted them in whatever order they got there
+  void SetOrder(const std::vector<Symbol *> &order);
+  // set once an expression belongs to more than one equation - nothing
+  // deletes expressions then, they go with the arena
+  void SetSharesExpressions(void) {
+    bSharesExpressions = true;
+  }
+  bool SharesExpressions(void) const {
+    return bSharesExpressions;
   }
+  // in the order they were added (renaming keeps the place) - symbols
+  // must not be added or removed while going through either list
+  const std::vector<Symbol *> &Symbols(void);
+  const std::vector<Variable *> &Variables(void);  // just the Symtype_Variable ones
 
 private:
-  std::string *ToLowerSpace(const std::string &name);
-  std::set<SymbolTableBase *> sUnconfirmedAllocations;
-  HashTable mHashTable;
+  typedef std::unordered_map<std::string, Symbol *> HashTable;
+  enum { SHARDS = 16 };
+#ifndef XMUTIL_NO_THREADS
+  typedef std::mutex Mutex;
+#else
+  struct Mutex {  // nothing to wait for with just the one thread
+    void lock(void) {
+    }
+    void unlock(void) {
+    }
+  };
+#endif
+  // holds a lock only while the name space is concurrent
+  class Lock {
+  public:
+    Lock(Mutex &mutex, bool concurrent) : pMutex(concurrent ? &mutex : NULL) {
+      if (pMutex)
+        pMutex->lock();
+    }
+    ~Lock(void) {
+      if (pMutex)
+        pMutex->unlock();
+    }
+
+  private:
+    Mutex *pMutex;
+  };
+  struct Shard {
+    Mutex mLock;
+    HashTable mTable;
+  };
+  // the shard a converted name is kept in
+  Shard &ShardFor(const std::string &s) {
+    return aShards[std::hash<std::string>()(s) % SHARDS];
+  }
+  Symbol *FindOwn(const std::string &s);  // s already converted
+  Symbol *FindBuiltin(const std::string &s) const;
+  const std::string &ToLowerSpace(const std::string &name) {
+    return ToLowerSpace(name.c_str(), name.length());
+  }
+  const std::string &ToLowerSpace(const char *name, size_t len);
+  Log &ActiveLog(void) {
+    return tLogNameSpace == this ? *tLog : mLog;
+  }
+  void Touched(Symbol *sym) {  // found or inserted by name
+    if (tLogNameSpace == this)
+      tLog->vTouched.push_back(sym);
+  }
+  Log mLog;
+  static thread_local SymbolNameSpace *tLogNameSpace;  // whose allocations go to tLog
+  static thread_local Log *tLog;
+  Shard aShards[SHARDS];
+  Mutex mSymbolsLock;  // for vSymbols while concurrent
+  Mutex mNamesLock;    // and sNames
+  std::vector<Symbol *> vSymbols;  // NULL where removed until the next Symbols call
+  std::vector<Variable *> vVariables;
+  size_t iRemoved;     // NULLs in vSymbols
+  bool bVariablesKnown;  // vVariables matches vSymbols
+  bool bSharesExpressions;
+  bool bConcurrent;
+  bool bFrozen;
+  std::vector<std::pair<std::string, Symbol *>> vSorted;  // by converted name once frozen
+  std::unordered_set<std::string> sNames;  // node based so the strings never move
+  const SymbolNameSpace *pBuiltins;
 };
 
 #endif
@@ -4,11 +4,11 @@
 
 SymbolTableBase::SymbolTableBase(SymbolNameSpace *sns) {
   pSymbolNameSpace = sns;
-  sns->AddUnconfirmedAllocation(this);
+  iAllocation = sns->AddUnconfirmedAllocation(this);
 }
 
 SymbolTableBase::~SymbolTableBase(void) {
-  if (!HasGoodAlloc()) {  // remove from this list no longer part of it
-    pSymbolNameSpace->RemoveUnconfirmedAllocation(this);
+  if (!SymbolArena::Releasing() && !HasGoodAlloc()) {  // remove from this list no longer part of it
+    pSymbolNameSpace->RemoveUnconfirmedAllocation(iAllocation);
   }
 }
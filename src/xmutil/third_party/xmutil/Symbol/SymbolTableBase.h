@@ -12,6 +12,7 @@
 //
 //
 
+#include "SymbolArena.h"
 #include "SymbolNameSpace.h"
 
 // forward class declarations - used by the concrete classes
@@ -23,19 +24,36 @@ class Variable;
 class SymbolTableBase {
 public:
   SymbolTableBase(SymbolNameSpace *sns);
-  inline void MarkGoodAlloc(void) {
-    pSymbolNameSpace = NULL;
-  }
+  // confirmed once the name space checkpoint has moved past this allocation
   inline bool HasGoodAlloc(void) {
-    return pSymbolNameSpace == NULL;
+    return pSymbolNameSpace->IsConfirmedAllocation(iAllocation);
   }
   inline SymbolNameSpace *GetSymbolNameSpace(void) {
     return pSymbolNameSpace;
   }
+  // true if the things this points to should be deleted along with it -
+  // not before it is confirmed, nor while the arena is releasing
+  // everything anyway
+  inline bool OwnsChildren(void) {
+    return !SymbolArena::Releasing() && HasGoodAlloc();
+  }
+  // the same for the expressions it points to, which may be shared
+  inline bool OwnsExpressions(void) {
+    return OwnsChildren() && !pSymbolNameSpace->SharesExpressions();
+  }
+  // all allocations come from the current SymbolArena
+  static void *operator new(size_t size) {
+    return SymbolArena::Allocate(size);
+  }
+  static void operator delete(void *p) {
+    SymbolArena::Free(p);
+  }
   virtual ~SymbolTableBase(void) = 0;
   // SymNameSpace *GetNameSpace() { return pSymbolNameSpace ; }
 private:
+  friend class SymbolNameSpace;  // moves iAllocation when adopting a log
   SymbolNameSpace *pSymbolNameSpace;
+  size_t iAllocation;  // position in the name space allocation log
 };
 
 #endif
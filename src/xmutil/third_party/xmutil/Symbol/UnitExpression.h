@@ -12,6 +12,13 @@ public:
   UnitExpression *Multiply(UnitExpression *mult);
   UnitExpression *Divide(UnitExpression *denom);
   std::string GetEquationString();
+  // what was written, simplified - UnitTable::Canonical takes it further
+  const std::vector<Units *> &Numerator(void) const {
+    return vNumerator;
+  }
+  const std::vector<Units *> &Denominator(void) const {
+    return vDenominator;
+  }
   inline void SetRange(double minval, double maxval, double increment) {
     dMinVal = minval;
     dMaxVal = maxval;
@@ -0,0 +1,185 @@
+#include "UnitTable.h"
+
+#include <algorithm>
+
+#include "UnitExpression.h"
+#include "Units.h"
+
+static std::string FoldUnitName(const std::string &name) {
+  std::string folded(name);
+  for (char &c : folded) {
+    if (c >= 'A' && c <= 'Z')
+      c = c - 'A' + 'a';
+    else if (c == '_')
+      c = ' ';
+  }
+  return folded;
+}
+
+size_t UnitTable::SignatureHash::operator()(const Signature &sig) const {
+  size_t h = sig.size();
+  for (const std::pair<uint32_t, int> &term : sig)
+    h = h * 1000003 ^ (static_cast<size_t>(term.first) << 8 ^ static_cast<size_t>(term.second & 0xff));
+  return h;
+}
+
+UnitTable::UnitTable(void) {
+  Intern(Signature());  // UNITS_DIMENSIONLESS
+}
+
+uint32_t UnitTable::BaseIndex(const std::string &name) {
+  std::string folded = FoldUnitName(name);
+  std::unordered_map<std::string, uint32_t>::iterator it = mBases.find(folded);
+  if (it != mBases.end())
+    return it->second;
+  // the singular or plural of one already seen - Hare and Hares, Fox and Foxes
+  std::string forms[] = {folded + "s", folded + "es", std::string(), std::string()};
+  if (folded.size() > 1 && folded.back() == 's')
+    forms[2] = folded.substr(0, folded.size() - 1);
+  if (folded.size() > 2 && folded.compare(folded.size() - 2, 2, "es") == 0)
+    forms[3] = folded.substr(0, folded.size() - 2);
+  for (const std::string &form : forms) {
+    it = form.empty() ? mBases.end() : mBases.find(form);
+    if (it != mBases.end()) {
+      mBases.emplace(folded, it->second);
+      return it->second;
+    }
+  }
+  uint32_t index = static_cast<uint32_t>(vBaseNames.size());
+  vBaseNames.push_back(name);
+  mBases.emplace(folded, index);
+  return index;
+}
+
+void UnitTable::AddEquivalence(const std::string &equiv) {
+  size_t start = 0;
+  uint32_t first = 0;
+  bool any = false;
+  while (start <= equiv.size()) {
+    size_t end = equiv.find(',', start);
+    if (end == std::string::npos)
+      end = equiv.size();
+    std::string name = equiv.substr(start, end - start);
+    if (!name.empty()) {
+      if (!any)
+        first = BaseIndex(name);
+      else
+        mBases.emplace(FoldUnitName(name), first);  // a name already in use keeps its meaning
+      any = true;
+    }
+    start = end + 1;
+  }
+}
+
+UnitId UnitTable::Base(const std::string &name) {
+  std::string folded = FoldUnitName(name);
+  if (folded.empty() || folded == "1" || folded == "dmnl" || folded == "dimensionless")
+    return UNITS_DIMENSIONLESS;
+  return Intern(Signature(1, std::make_pair(BaseIndex(name), 1)));
+}
+
+UnitId UnitTable::Canonical(UnitExpression *units) {
+  UnitId id = UNITS_DIMENSIONLESS;
+  for (Units *u : units->Numerator())
+    id = Multiply(id, Base(u->GetName().substr(1)));  // past the > that keeps units apart from variables
+  for (Units *u : units->Denominator())
+    id = Divide(id, Base(u->GetName().substr(1)));
+  return id;
+}
+
+UnitId UnitTable::Intern(const Signature &sig) {
+  std::unordered_map<Signature, UnitId, SignatureHash>::iterator it = mIds.find(sig);
+  if (it != mIds.end())
+    return it->second;
+  UnitId id = static_cast<UnitId>(vSignatures.size());
+  vSignatures.push_back(sig);
+  mIds.emplace(sig, id);
+  return id;
+}
+
+UnitId UnitTable::Multiply(UnitId a, UnitId b) {
+  if (a == UNITS_DIMENSIONLESS)
+    return b;
+  if (b == UNITS_DIMENSIONLESS)
+    return a;
+  if (a > b)
+    std::swap(a, b);
+  uint64_t key = static_cast<uint64_t>(a) << 32 | b;
+  std::unordered_map<uint64_t, UnitId>::iterator it = mProducts.find(key);
+  if (it != mProducts.end())
+    return it->second;
+  // both sorted so a merge of the two
+  const Signature &sa = vSignatures[a];
+  const Signature &sb = vSignatures[b];
+  Signature product;
+  size_t i = 0, j = 0;
+  while (i < sa.size() || j < sb.size()) {
+    if (j == sb.size() || (i < sa.size() && sa[i].first < sb[j].first)) {
+      product.push_back(sa[i++]);
+    } else if (i == sa.size() || sb[j].first < sa[i].first) {
+      product.push_back(sb[j++]);
+    } else {
+      int power = sa[i].second + sb[j].second;
+      if (power)
+        product.push_back(std::make_pair(sa[i].first, power));
+      i++, j++;
+    }
+  }
+  UnitId id = Intern(product);
+  mProducts.emplace(key, id);
+  return id;
+}
+
+UnitId UnitTable::Divide(UnitId a, UnitId b) {
+  return Multiply(a, Power(b, -1));
+}
+
+UnitId UnitTable::Power(UnitId a, int power) {
+  if (a == UNITS_DIMENSIONLESS || power == 1)
+    return a;
+  if (!power)
+    return UNITS_DIMENSIONLESS;
+  uint64_t key = static_cast<uint64_t>(a) << 32 | static_cast<uint32_t>(power);
+  std::unordered_map<uint64_t, UnitId>::iterator it = mPowers.find(key);
+  if (it != mPowers.end())
+    return it->second;
+  Signature raised = vSignatures[a];
+  for (std::pair<uint32_t, int> &term : raised)
+    term.second *= power;
+  UnitId id = Intern(raised);
+  mPowers.emplace(key, id);
+  return id;
+}
+
+bool UnitTable::Root(UnitId a, int root, UnitId &result) {
+  Signature lowered = vSignatures[a];
+  for (std::pair<uint32_t, int> &term : lowered) {
+    if (term.second % root)
+      return false;
+    term.second /= root;
+  }
+  result = Intern(lowered);
+  return true;
+}
+
+std::string UnitTable::Describe(UnitId id) const {
+  const Signature &sig = vSignatures[id];
+  std::string num, denom;
+  int ndenom = 0;
+  for (const std::pair<uint32_t, int> &term : sig) {
+    std::string &side = term.second > 0 ? num : denom;
+    int power = term.second > 0 ? term.second : -term.second;
+    if (!side.empty())
+      side.push_back('*');
+    side += vBaseNames[term.first];
+    if (power != 1)
+      side += "^" + std::to_string(power);
+    if (term.second < 0)
+      ndenom++;
+  }
+  if (num.empty())
+    num = "1";
+  if (denom.empty())
+    return num;
+  return num + "/" + (ndenom > 1 ? "(" + denom + ")" : denom);
+}
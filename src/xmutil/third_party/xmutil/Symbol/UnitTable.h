@@ -0,0 +1,54 @@
+#ifndef _XMUTIL_SYMBOL_UNITTABLE_H
+#define _XMUTIL_SYMBOL_UNITTABLE_H
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class UnitExpression;
+
+typedef uint32_t UnitId;
+#define UNITS_DIMENSIONLESS 0  // the UnitId of 1, Dmnl and anything that cancels out
+
+/* UnitTable - units of measure in one canonical form, the base units they
+   are made of each with the power it is raised to, sorted by base.  Each
+   form is interned so units that are the same are the same UnitId however
+   they were written (Person/Month, 1/Month*Person) and comparing them is
+   comparing numbers.  Products and powers are remembered too, so working
+   out the units of an equation is mostly a hash lookup per operator
+
+   base units are matched ignoring case, with _ the same as a space and
+   the singular the same as the plural (Fox, Foxes), and the names in a
+   unit equivalence from the settings (Dollar,Dollars,$) all stand for the
+   first of them */
+class UnitTable {
+public:
+  UnitTable(void);
+  void AddEquivalence(const std::string &equiv);  // comma separated
+  UnitId Base(const std::string &name);
+  UnitId Canonical(UnitExpression *units);
+  UnitId Multiply(UnitId a, UnitId b);
+  UnitId Divide(UnitId a, UnitId b);
+  UnitId Power(UnitId a, int power);
+  // false if the units can't be raised to 1/root with whole powers left
+  bool Root(UnitId a, int root, UnitId &result);
+  std::string Describe(UnitId id) const;  // as Person/Month
+
+private:
+  typedef std::vector<std::pair<uint32_t, int>> Signature;  // base and power, sorted by base
+  struct SignatureHash {
+    size_t operator()(const Signature &sig) const;
+  };
+  uint32_t BaseIndex(const std::string &name);
+  UnitId Intern(const Signature &sig);
+  std::vector<std::string> vBaseNames;               // as first written
+  std::unordered_map<std::string, uint32_t> mBases;  // folded names and aliases
+  std::vector<Signature> vSignatures;                // by UnitId
+  std::unordered_map<Signature, UnitId, SignatureHash> mIds;
+  std::unordered_map<uint64_t, UnitId> mProducts;  // a << 32 | b
+  std::unordered_map<uint64_t, UnitId> mPowers;    // a << 32 | power
+};
+
+#endif
@@ -7,6 +7,6 @@ Units::Units(SymbolNameSpace *sns, const std::string &name) : Symbol(sns, name)
 }
 
 Units::~Units(void) {
-  if (pUnitExpression)
+  if (pUnitExpression && !SymbolArena::Releasing())
     delete pUnitExpression;
 }
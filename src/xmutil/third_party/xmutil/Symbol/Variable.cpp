@@ -2,6 +2,7 @@
 
 #include <assert.h>
 
+#include "../Model.h"
 #include "../Symbol/Expression.h"
 #include "../Symbol/LeftHandSide.h"
 #include "../XMUtil.h"
@@ -15,31 +16,59 @@ Variable::Variable(SymbolNameSpace *sns, const std::string &name) : Symbol(sns,
   pVariableContent = NULL;
   mVariableType = XMILE_Type_UNKNOWN;  // till typed
   iNelm = 0;
+  iVarsUsedPos = 0;
   _unwanted = false;
 }
 
 Variable::~Variable(void) {
   if (pVariableContent) {
-    if (HasGoodAlloc())
+    if (OwnsChildren())
       pVariableContent->Clear();
     delete pVariableContent;
     pVariableContent = NULL;
   }
 }
 
-std::string Variable::GetAlternateName(void) {
-  std::string name = pVariableContent ? pVariableContent->GetAlternateName() : GetName();
-  // strip out surrounding quotes if they exist - we want to deliver the name without them
+// strip out surrounding quotes if they exist - we want to deliver the name without them
+static const std::string *Unquoted(SymbolNameSpace *sns, const std::string &name) {
   if (name.size() > 2 && name[0] == '\"' && name.back() == '\"')
-    name = name.substr(1, name.size() - 2);
-  return name;
+    return sns->Intern(name.substr(1, name.size() - 2));
+  return sns->Intern(name);
+}
+
+// the content keeps the name already unquoted so asking for it costs nothing
+void Variable::SetAlternateName(const std::string &altname) {
+  SymbolNameSpace *sns = GetSymbolNameSpace();
+  pVariableContent->SetAlternateName(Unquoted(sns, altname), sns->InternUnderBar(altname));
+}
+
+const std::string &Variable::GetAlternateName(void) {
+  if (pVariableContent)
+    return pVariableContent->GetAlternateName();
+  return *Unquoted(GetSymbolNameSpace(), GetName());
+}
+
+static const std::vector<Equation *> NoEquations;
+
+const std::vector<Equation *> &VariableContent::GetAllEquations() {
+  return NoEquations;
+}
+
+const std::vector<Equation *> &Variable::GetAllEquations() {
+  return pVariableContent ? pVariableContent->GetAllEquations() : NoEquations;
+}
+
+const std::string &VariableContent::GetAlternateName(void) {
+  static const std::string none;
+  assert(0);
+  return none;
 }
 
 XMILE_Type Variable::MarkFlows(SymbolNameSpace *sns) {
   if (!pVariableContent)
     return mVariableType;
 
-  std::vector<Equation *> equations = pVariableContent->GetAllEquations();
+  const std::vector<Equation *> &equations = pVariableContent->GetAllEquations();
 
   if (equations.empty()) {
     // todo data variables have empty equations  - could fill something in here???
@@ -79,7 +108,8 @@ XMILE_Type Variable::MarkFlows(SymbolNameSpace *sns) {
         const std::vector<double> &vals = t->GetVals();
         assert(vals.size() == elms.size());
         if (vals.size() == elms.size()) {
-          equations.erase(equations.begin() + i);
+          std::vector<Equation *> expanded(equations);
+          expanded.erase(expanded.begin() + i);
           size_t n2 = vals.size();
           for (size_t j = 0; j < n2; j++) {
             SymbolList *entry = new SymbolList(sns, elms[j][0], SymbolList::EntryType_SYMBOL);
@@ -88,10 +118,10 @@ XMILE_Type Variable::MarkFlows(SymbolNameSpace *sns) {
             LeftHandSide *lhs = new LeftHandSide(sns, eq->GetLeft()->GetExpressionVariable(), entry, NULL, 0);
             ExpressionNumber *expnum = new ExpressionNumber(sns, vals[j]);
             Equation *neq = new Equation(sns, lhs, expnum, '=');
-            equations.push_back(neq);
+            expanded.push_back(neq);
           }
           // now reenter with new equations
-          pVariableContent->SetAllEquations(equations);
+          pVariableContent->SetAllEquations(expanded);
           return MarkFlows(sns);
         }
       }
@@ -104,8 +134,7 @@ XMILE_Type Variable::MarkFlows(SymbolNameSpace *sns) {
         std::vector<Variable *> vars;
         exp->GetVarsUsed(vars);
         // the first should be a graphical
-        std::vector<Equation *> eqs = vars[0]->GetAllEquations();
-        for (Equation *eq : eqs) {
+        for (Equation *eq : vars[0]->GetAllEquations()) {
           Expression *exp = eq->GetExpression();
           if (exp->GetType() == EXPTYPE_Table)
             static_cast<ExpressionTable *>(exp)->SetExtrapolate(true);
@@ -201,21 +230,30 @@ void VariableContentVar::Clear(void) {
     delete vEquations[i];
   // comment takes care of itself
 }
-std::vector<Variable *> VariableContentVar::GetInputVars() {
-  std::vector<Variable *> vars;
-  for (Equation *eq : this->vEquations)
-    eq->GetVarsUsed(vars);
-  return vars;
+static const std::vector<Variable *> NoInputVars;
+
+const std::vector<Variable *> &VariableContent::GetInputVars() {
+  return NoInputVars;
+}
+
+const std::vector<Variable *> &VariableContentVar::GetInputVars() {
+  if (!bInputVarsKnown) {
+    vInputVars.clear();
+    for (Equation *eq : this->vEquations)
+      eq->GetVarsUsed(vInputVars);
+    bInputVarsKnown = true;
+  }
+  return vInputVars;
+}
+
+const std::vector<Variable *> &Variable::GetInputVars() {
+  return pVariableContent ? pVariableContent->GetInputVars() : NoInputVars;
 }
 
 void Variable::AddEq(Equation *eq) {
   if (!pVariableContent) {
-    try {
-      pVariableContent = new VariableContentVar;
-      pVariableContent->SetAlternateName(this->GetName());  // until overidden
-    } catch (...) {
-      throw "Memory failure adding equations";
-    }
+    pVariableContent = new VariableContentVar;
+    SetAlternateName(this->GetName());  // until overidden
   }
   pVariableContent->AddEq(eq);
 }
@@ -233,88 +271,21 @@ void VariableContentVar::CheckPlaceholderVars(Model *m) {
   }
 }
 
+// the ordering itself is done by Model::OrderEquations from what this
+// says the expression being looked at reads - something without a state
+// has nothing to order
 bool VariableContentVar::CheckComputed(Symbol *parent, ContextInfo *info, bool first) {
-  // printf("Checking out %s\n",GetName().c_str()) ;
-  if (!pState) {
-    // printf("   - not computable ignoring\n") ;
-    return true;
-  }
-  if (pState->cComputeFlag & info->GetComputeType()) {
-    if (info->GetComputeType() == CF_active) {
-      if (pState->HasMemory())
-        info->AddDDF(DDF_level);  // not recorded in cDynamicDependencyFlag
-      else
-        info->AddDDF(pState->cDynamicDependencyFlag);
-    }
-    return true;  // done
-  }
-  int intype = info->GetComputeType() << 1;
-  if (pState->cComputeFlag & intype) {
-    if (info->GetComputeType() == CF_initial) {
-      // std::cerr << "Simultaneous initial equations found " << std::endl;
-    } else {
-      if (pState->HasMemory()) {  // first call was for rates - now for level
-        assert(!first);
-        info->AddDDF(DDF_level);
-        return true;
-      }
-      // std::cerr << "Simultaneous active equations found " << std::endl;
-    }
-    // std::cerr << "     " << parent->GetName() << std::endl;
-    pState->cComputeFlag &= ~intype;
-    return false;
-  } else if (!first && (info->GetComputeType() != CF_initial) && pState->HasMemory()) {
-    // printf("Not tracing further for level  %s\n",GetName().c_str()) ;
-    info->AddDDF(
-        DDF_level);  // this is the level - even if the rate is a constant (only a 0 rate would really be unchanging)
-    return true;
-  } else if (first && info->GetComputeType() == CF_initial && !pState->HasMemory()) {
-    return true; /* don't need to do anything, if var is needed will be called not first */
-  } else {       // really need to check
-    unsigned char ddf = info->GetDDF();
-    if (info->GetComputeType() == CF_active) {
-      info->ClearDDF();
-      if (!pState->UpdateOnPartialStep())
-        info->AddDDF(DDF_time_varying);
-    }
-    pState->cComputeFlag |= intype;
-    for (Equation *e : vEquations) {
-      if (!e->GetExpression()->CheckComputed(info)) {
-        // std::cerr << "     " << parent->GetName() << std::endl;
-        pState->cComputeFlag &= ~intype;
-        pState->cComputeFlag |= info->GetComputeType();  // don't reenter
-        return false;
-      }
-    }
-    if (info->GetComputeType() == CF_active) {
-      pState->cDynamicDependencyFlag = info->GetDDF();
-      info->AddDDF(ddf);
-    }
-  }
-
-  pState->cComputeFlag = (pState->cComputeFlag | info->GetComputeType()) & (~intype);
-
-  /* add the equations - some can be ignored */
-  if (info->GetComputeType() == CF_active) {
-    if (pState->HasMemory() || !(pState->cDynamicDependencyFlag & (DDF_level | DDF_data | DDF_time_varying)))
-      return true;
-  } else if (info->GetComputeType() == CF_unchanging) {
-    if (pState->HasMemory() || pState->cDynamicDependencyFlag & (DDF_level | DDF_data | DDF_time_varying))
-      return true;
-  } else if (info->GetComputeType() == CF_rate) {
-    if (!pState->HasMemory())
-      return true;
-  }
-  // fprintf(stderr, "Outputting equations for  %s\n", parent->GetName().c_str());
-  for (Equation *e : vEquations) {
-    info->PushEquation(e);
-  }
+  if (pState)
+    info->AddDependency(static_cast<Variable *>(parent));
   return true;
 }
 
 void VariableContentVar::SetupState(ContextInfo *info) {
   bool hasmemory = false;
   bool timedependent = false;
+  bool ispipeline = false;
+  int stages = 0;
+  int ring = 0;
   if (!info) {
     if (pState)
       delete pState;
@@ -328,11 +299,15 @@ void VariableContentVar::SetupState(ContextInfo *info) {
     bool haseq = false;
     for (Equation *e : vEquations) {
       haseq = true;
-      if (e->GetExpression()->GetType() == EXPTYPE_Table) {
-        return;  // for now no state assigned
+      if (e->GetExpression()->GetType() == EXPTYPE_Table || e->GetExpression()->GetType() == EXPTYPE_Symlist) {
+        return;  // for now no state assigned - nor ever for subscript ranges
       }
       Function *f = e->GetExpression()->GetFunction();
-      if (f) {
+      if (f && f->Pipeline()) {
+        ispipeline = true;
+        ExpressionList *args = static_cast<ExpressionFunction *>(e->GetExpression())->GetArgs();
+        f->Pipeline()->Layout(info->GetSymbolNameSpace(), args, &stages, &ring);
+      } else if (f) {
         if (!f->IsMemoryless())
           hasmemory = true;
         if (f->IsTimeDependent())
@@ -342,13 +317,22 @@ void VariableContentVar::SetupState(ContextInfo *info) {
     // empty equation causes what???
     if (!haseq)
       timedependent = true;  // consistent with exog variables
-    if (hasmemory)
+    if (ispipeline)
+      pState = new StatePipeline(info->GetSymbolNameSpace(), stages, ring);
+    else if (hasmemory)
       pState = new StateLevel(info->GetSymbolNameSpace());
     else if (timedependent)
       pState = new StateTime(info->GetSymbolNameSpace());
     else
       pState = new State(info->GetSymbolNameSpace());
-    pState->iNVals = 1;  // todo arrays
+    // an array has a value for each element of its subscripts
+    pState->iNVals = 1;
+    std::vector<Symbol *> dims;
+    Model *model = info->GetModel();
+    if (model && haseq && model->ValueDimensions(vEquations[0]->GetVariable(), dims)) {
+      for (Symbol *dim : dims)
+        pState->iNVals *= static_cast<int>(model->SubscriptElements(dim).size());
+    }
   }
   // the following addresses will be nonsense on the first pass we just
   // use them to set the requires size for the integration state vector
@@ -357,6 +341,12 @@ void VariableContentVar::SetupState(ContextInfo *info) {
     pState->SetRateP(info->GetRateP(pState->iNVals));
   } else
     pState->pVals = info->GetAuxP(pState->iNVals);
+  if (StatePipeline *pipeline = pState->Pipeline()) {
+    int count = pipeline->iStageCount * pState->iNVals;
+    pipeline->pStages = info->GetLevelP(count);
+    pipeline->pStageRates = info->GetRateP(count);
+    pipeline->pRing = info->GetAuxP(pipeline->iRingLength ? pipeline->iRingLength * pState->iNVals + 1 : 0);
+  }
 }
 
 int VariableContentVar::SubscriptCount(std::vector<Variable *> &elmlist) {
@@ -368,7 +358,7 @@ int VariableContentVar::SubscriptCount(std::vector<Variable *> &elmlist) {
       for (size_t i = 1; i < vEquations.size(); i++) {
         std::vector<Variable *> other;
         if (vEquations[0]->SubscriptCount(other) != count)
-          throw "Bad subscript equations";
+          return -1;  // the equations disagree
       }
     }
     // we need to get to the array not the elements for elmlist - not map to parent only if multiple equations
@@ -37,6 +37,12 @@ public:
   inline double Eval(ContextInfo *info) {
     return pState->GetValue(0);
   }  // todo subscritps
+  bool HasState(void) {
+    return pState != NULL;
+  }  // only once the model has been analyzed
+  State *GetState(void) {
+    return pState;
+  }
   inline void SetInitialValue(int off, double val) {
     pState->SetInitialValue(off, val);
   }
@@ -53,21 +59,19 @@ public:
   virtual Equation *GetEquation(int pos) {
     return NULL;
   }
-  virtual std::vector<Equation *> GetAllEquations() {
-    return std::vector<Equation *>();
-  }
-  virtual void SetAllEquations(std::vector<Equation *> set) {
+  virtual const std::vector<Equation *> &GetAllEquations();
+  virtual void SetAllEquations(const std::vector<Equation *> &set) {
     assert(false);
   }
-  virtual std::vector<Variable *> GetInputVars() {
-    return std::vector<Variable *>();
-  }
+  virtual const std::vector<Variable *> &GetInputVars();
   virtual bool AddUnits(UnitExpression *un) {
     return false;
   }
   virtual UnitExpression *Units() {
     return NULL;
   }
+  virtual void SetUnits(UnitExpression *un) {
+  }
   virtual void OutputComputable(ContextInfo *info) {
     assert(0);
   }
@@ -75,13 +79,9 @@ public:
   }
   virtual void SetupState(ContextInfo *info) {
   }  // returns number of entries in state vector required (states can also claim thier own storage)
-  virtual void SetAlternateName(const std::string &altname) {
-  }
-  virtual const std::string &GetAlternateName(void) {
-    assert(0);
-    std::string *s = new std::string;
-    return *s;
+  virtual void SetAlternateName(const std::string *altname, const std::string *underbar) {
   }
+  virtual const std::string &GetAlternateName(void);
   virtual int SubscriptCount(std::vector<Variable *> &elmlist) {
     return 0;
   }
@@ -119,6 +119,8 @@ class VariableContentVar : public VariableContent {
 public:
   VariableContentVar(void) {
     pUnits = NULL;
+    pAlternateName = pUnderBarName = NULL;
+    bInputVarsKnown = false;
   }
   ~VariableContentVar(void) {
   }
@@ -128,17 +130,20 @@ public:
   void Clear(void);
   void AddEq(Equation *eq) {
     vEquations.push_back(eq);
+    bInputVarsKnown = false;
   }
   virtual Equation *GetEquation(int pos) {
     return vEquations[pos];
   }
-  virtual std::vector<Equation *> GetAllEquations() {
+  virtual const std::vector<Equation *> &GetAllEquations() {
     return vEquations;
   }
-  virtual void SetAllEquations(std::vector<Equation *> set) {
+  virtual void SetAllEquations(const std::vector<Equation *> &set) {
     vEquations = set;
+    bInputVarsKnown = false;
   }
-  virtual std::vector<Variable *> GetInputVars();
+  // worked out on first use - ask once the equations have stopped changing
+  virtual const std::vector<Variable *> &GetInputVars();
   bool AddUnits(UnitExpression *un) {
     if (!pUnits) {
       pUnits = un;
@@ -149,17 +154,21 @@ public:
   UnitExpression *Units() {
     return pUnits;
   }
+  void SetUnits(UnitExpression *un) {  // in place of any there were
+    pUnits = un;
+  }
   void OutputComputable(ContextInfo *info) {
-    *info << SpaceToUnderBar(sAlternateName);
+    *info << *pUnderBarName;
   }
   void CheckPlaceholderVars(Model *m);
   void SetupState(ContextInfo *info);  // returns number of entries in state vector required (states can also claim
                                        // thier own storage)
-  void SetAlternateName(const std::string &altname) {
-    sAlternateName = altname;
+  void SetAlternateName(const std::string *altname, const std::string *underbar) {
+    pAlternateName = altname;
+    pUnderBarName = underbar;
   }
   const std::string &GetAlternateName(void) {
-    return sAlternateName;
+    return *pAlternateName;
   }
   virtual int SubscriptCount(std::vector<Variable *> &elmlist);
 
@@ -168,8 +177,11 @@ protected:
       vSubscripts;  // for regular variables the family's for subscripts the family (possibly self) follwed by elements
   std::vector<Equation *> vEquations;
   std::string Comment;         // arbitrary UTF8 string
-  std::string sAlternateName;  // for writing out equations as computer code
-  UnitExpression *pUnits;      // units could be attached to equations
+  const std::string *pAlternateName;  // for writing out equations as computer code - interned
+  const std::string *pUnderBarName;   // the same with spaces replaced by _
+  UnitExpression *pUnits;             // units could be attached to equations
+  std::vector<Variable *> vInputVars;
+  bool bInputVarsKnown;
 };
 
 class Variable : public Symbol {
@@ -213,6 +225,7 @@ public:
     if (pVariableContent)
       pVariableContent->SetupState(info);
   }
+  // -1 if the equations don't agree on how many there are
   int SubscriptCountVars(std::vector<Variable *> &elmlist) {
     return pVariableContent ? pVariableContent->SubscriptCount(elmlist) : 0;
   }
@@ -221,15 +234,16 @@ public:
   inline Equation *GetEquation(int pos) {
     return pVariableContent->GetEquation(pos);
   }
-  std::vector<Equation *> GetAllEquations() {
-    return pVariableContent ? pVariableContent->GetAllEquations() : std::vector<Equation *>();
-  }
+  const std::vector<Equation *> &GetAllEquations();
   inline bool AddUnits(UnitExpression *un) {
     return pVariableContent->AddUnits(un);
   }
   UnitExpression *Units() {
     return pVariableContent ? pVariableContent->Units() : NULL;
   }
+  inline void SetUnits(UnitExpression *un) {
+    pVariableContent->SetUnits(un);
+  }
   inline void OutputComputable(ContextInfo *info) {
     if (pVariableContent)
       pVariableContent->OutputComputable(info);
@@ -239,19 +253,15 @@ public:
   inline double Eval(ContextInfo *info) {
     return pVariableContent->Eval(info);
   }
-  inline std::vector<Variable *> GetInputVars() {
-    return pVariableContent ? pVariableContent->GetInputVars() : std::vector<Variable *>();
-  }
+  const std::vector<Variable *> &GetInputVars();
   inline void SetInitialValue(int off, double val) {
     pVariableContent->SetInitialValue(off, val);
   }
   inline void SetActiveValue(int off, double val) {
     pVariableContent->SetActiveValue(off, val);
   }
-  inline void SetAlternateName(const std::string &altname) {
-    pVariableContent->SetAlternateName(altname);
-  }
-  std::string GetAlternateName(void);
+  void SetAlternateName(const std::string &altname);
+  const std::string &GetAlternateName(void);  // without any surrounding quotes
 
   XMILE_Type MarkFlows(SymbolNameSpace *sns);  // mark the variableType of inflows/outflows
   XMILE_Type VariableType() {
@@ -267,6 +277,13 @@ public:
   void SetNelm(int set) {
     iNelm = set;
   }
+  // where GetVarsUsed last put this in its list - lets it skip repeats without a search
+  size_t VarsUsedPos() const {
+    return iVarsUsedPos;
+  }
+  void SetVarsUsedPos(size_t pos) {
+    iVarsUsedPos = pos;
+  }
 
   // for other function calles
   inline VariableContent *Content(void) {
@@ -289,6 +306,7 @@ private:
   VariableContent *pVariableContent;  // dependent on variable type which is not known on instantiation
   XMILE_Type mVariableType;
   int iNelm;    // used for subscript owners
+  size_t iVarsUsedPos;
   View *_view;  // view defined in
   bool _unwanted;
 };
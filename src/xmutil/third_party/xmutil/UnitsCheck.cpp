@@ -0,0 +1,286 @@
+// UnitsCheck.cpp : check the units given for each variable against its equations
+#include <string.h>
+
+#include <unordered_map>
+
+#include "Function/Function.h"
+#include "Model.h"
+#include "Symbol/ExpressionList.h"
+#include "Symbol/Parse.h"
+#include "Symbol/UnitTable.h"
+#include "XMUtil.h"
+#define YYSTYPE ParseUnion
+#include "Vensim/VYacc.tab.hpp"
+
+namespace {
+
+// what the units of an expression came to.  Unknown where a variable has
+// none given or nothing follows from a function's arguments, and a number
+// fits whatever it is added to or compared with but is dimensionless when
+// multiplied
+enum UnitsKind { UNITS_KNOWN, UNITS_UNKNOWN, UNITS_NUMBER };
+struct Inferred {
+  UnitsKind kind;
+  UnitId id;
+};
+const Inferred kUnknown = {UNITS_UNKNOWN, UNITS_DIMENSIONLESS};
+const Inferred kNumber = {UNITS_NUMBER, UNITS_DIMENSIONLESS};
+Inferred Known(UnitId id) {
+  Inferred inferred = {UNITS_KNOWN, id};
+  return inferred;
+}
+
+// the functions whose units follow from their arguments
+enum FunctionUnits {
+  FU_OTHER,
+  FU_SAME,           // all the arguments and the result alike - MIN, MAX
+  FU_CHOICE,         // IF THEN ELSE - the last two alike
+  FU_QUOTIENT,       // ZIDZ, XIDZ - the first over the second, what XIDZ falls back on alike
+  FU_DIMENSIONLESS,  // EXP, SIN - dimensionless in and out
+  FU_ROOT,           // SQRT
+  FU_STOCK,          // INTEG - the rate over time, the initial value alike
+  FU_DELAY,          // SMOOTH, DELAY1 - the input, then the time, then the initial value alike
+};
+struct FunctionRule {
+  const char *name;
+  FunctionUnits units;
+};
+const FunctionRule kFunctionRules[] = {
+    {"ABS", FU_SAME},
+    {"INTEGER", FU_SAME},
+    {"MAX", FU_SAME},
+    {"MIN", FU_SAME},
+    {"MODULO", FU_SAME},
+    {"SUM", FU_SAME},
+    {"INITIAL", FU_SAME},
+    {"REINITIAL", FU_SAME},
+    {"ACTIVE INITIAL", FU_SAME},
+    {"QUANTUM", FU_SAME},
+    {"IF THEN ELSE", FU_CHOICE},
+    {"ZIDZ", FU_QUOTIENT},
+    {"XIDZ", FU_QUOTIENT},
+    {"EXP", FU_DIMENSIONLESS},
+    {"LN", FU_DIMENSIONLESS},
+    {"LOG", FU_DIMENSIONLESS},
+    {"SIN", FU_DIMENSIONLESS},
+    {"COS", FU_DIMENSIONLESS},
+    {"TAN", FU_DIMENSIONLESS},
+    {"ARCSIN", FU_DIMENSIONLESS},
+    {"ARCCOS", FU_DIMENSIONLESS},
+    {"ARCTAN", FU_DIMENSIONLESS},
+    {"SQRT", FU_ROOT},
+    {"INTEG", FU_STOCK},
+    {"SMOOTH", FU_DELAY},
+    {"SMOOTHI", FU_DELAY},
+    {"SMOOTH3", FU_DELAY},
+    {"SMOOTH3I", FU_DELAY},
+    {"SMOOTH N", FU_DELAY},
+    {"DELAY1", FU_DELAY},
+    {"DELAY1I", FU_DELAY},
+    {"DELAY3", FU_DELAY},
+    {"DELAY3I", FU_DELAY},
+    {"DELAY N", FU_DELAY},
+    {"DELAY FIXED", FU_DELAY},
+};
+
+// one pass over each equation, every node looked at once
+class UnitsChecker {
+public:
+  UnitsChecker(Model *model, std::vector<Diagnostic> &problems) : vProblems(problems) {
+    for (const std::string &equiv : model->UnitEquivs())
+      mTable.AddEquivalence(equiv);
+    for (const FunctionRule &rule : kFunctionRules)
+      mRules.emplace(rule.name, rule.units);
+    UnitExpression *time = model->GetUnits("TIME STEP");
+    mTime = time ? Known(mTable.Canonical(time)) : kUnknown;
+  }
+  void Check(Variable *var);
+
+private:
+  Inferred Declared(Variable *var);
+  Inferred Walk(Expression *e);
+  Inferred WalkFunction(Expression *e);
+  Inferred Agree(Inferred a, Inferred b, const char *what);
+  Inferred Times(Inferred a, Inferred b);
+  Inferred Over(Inferred a, Inferred b);
+  void Problem(const std::string &message);
+  std::vector<Diagnostic> &vProblems;
+  UnitTable mTable;
+  Inferred mTime;
+  std::unordered_map<Variable *, Inferred> mDeclared;
+  std::unordered_map<std::string, FunctionUnits> mRules;
+  Variable *pVariable = NULL;  // whose equation is being checked
+};
+
+Inferred UnitsChecker::Declared(Variable *var) {
+  std::unordered_map<Variable *, Inferred>::iterator it = mDeclared.find(var);
+  if (it != mDeclared.end())
+    return it->second;
+  UnitExpression *units = var->Units();
+  Inferred declared = units ? Known(mTable.Canonical(units)) : kUnknown;
+  mDeclared.emplace(var, declared);
+  return declared;
+}
+
+void UnitsChecker::Problem(const std::string &message) {
+  vProblems.push_back(Diagnostic(XMUTIL_WARNING_UNITS, message, 0, 0, pVariable->GetName()));
+}
+
+// for + - and comparisons - a mismatch is reported once and then unknown
+// so it doesn't come up again further out
+Inferred UnitsChecker::Agree(Inferred a, Inferred b, const char *what) {
+  if (a.kind == UNITS_KNOWN && b.kind == UNITS_KNOWN) {
+    if (a.id == b.id)
+      return a;
+    Problem(std::string(what) + " " + mTable.Describe(a.id) + " and " + mTable.Describe(b.id));
+    return kUnknown;
+  }
+  if (a.kind == UNITS_KNOWN)
+    return a;
+  if (b.kind == UNITS_KNOWN || b.kind == UNITS_UNKNOWN)
+    return b;
+  return a;
+}
+
+Inferred UnitsChecker::Times(Inferred a, Inferred b) {
+  if (a.kind == UNITS_UNKNOWN || b.kind == UNITS_UNKNOWN)
+    return kUnknown;
+  if (a.kind == UNITS_NUMBER && b.kind == UNITS_NUMBER)
+    return kNumber;
+  return Known(mTable.Multiply(a.id, b.id));
+}
+
+Inferred UnitsChecker::Over(Inferred a, Inferred b) {
+  if (a.kind == UNITS_UNKNOWN || b.kind == UNITS_UNKNOWN)
+    return kUnknown;
+  if (a.kind == UNITS_NUMBER && b.kind == UNITS_NUMBER)
+    return kNumber;
+  return Known(mTable.Divide(a.id, b.id));
+}
+
+Inferred UnitsChecker::Walk(Expression *e) {
+  if (!e)
+    return kNumber;  // the missing side of unary minus
+  switch (e->GetType()) {
+  case EXPTYPE_Number:
+    return kNumber;
+  case EXPTYPE_Variable:
+    return Declared(static_cast<ExpressionVariable *>(e)->GetVariable());
+  case EXPTYPE_Lookup: {
+    Walk(e->GetArg(1));
+    Expression *var = e->GetArg(0);
+    return var ? Declared(static_cast<ExpressionVariable *>(var)->GetVariable()) : kUnknown;
+  }
+  case EXPTYPE_Logical: {
+    Inferred a = Walk(e->GetArg(0));
+    Inferred b = Walk(e->GetArg(1));
+    int oper = static_cast<ExpressionLogical *>(e)->GetOper();
+    if (oper != VPTT_and && oper != VPTT_or && oper != VPTT_not)
+      Agree(a, b, "comparing");
+    return kNumber;
+  }
+  case EXPTYPE_Operator: {
+    Inferred a = Walk(e->GetArg(0));
+    Inferred b = Walk(e->GetArg(1));
+    switch (static_cast<ExpressionOperator2 *>(e)->GetCode()) {
+    case ExpressionCode::OP_ADD:
+    case ExpressionCode::OP_SUBTRACT:
+      return Agree(a, b, "adding");
+    case ExpressionCode::OP_MULTIPLY:
+      return Times(a, b);
+    case ExpressionCode::OP_DIVIDE:
+      return Over(a, b);
+    case ExpressionCode::OP_POWER: {
+      if (a.kind != UNITS_KNOWN || a.id == UNITS_DIMENSIONLESS)
+        return a;
+      Expression *exponent = e->GetArg(1);
+      if (exponent->GetType() == EXPTYPE_Number) {
+        double power = static_cast<ExpressionNumber *>(exponent)->GetValue();
+        if (power == static_cast<int>(power))
+          return Known(mTable.Power(a.id, static_cast<int>(power)));
+      }
+      return kUnknown;
+    }
+    default:  // parentheses, negation
+      return e->GetArg(0) ? a : b;
+    }
+  }
+  case EXPTYPE_Function:
+  case EXPTYPE_FunctionMemory:
+    return WalkFunction(e);
+  default:
+    return kUnknown;
+  }
+}
+
+Inferred UnitsChecker::WalkFunction(Expression *e) {
+  ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+  std::vector<Inferred> in;
+  for (int i = 0, n = args ? args->Length() : 0; i < n; i++)
+    in.push_back(Walk(args->GetExp(i)));
+  std::unordered_map<std::string, FunctionUnits>::iterator rule = mRules.find(e->GetFunction()->GetName());
+  if (rule == mRules.end() || in.empty())
+    return kUnknown;
+  switch (rule->second) {
+  case FU_SAME: {
+    Inferred result = in[0];
+    for (size_t i = 1; i < in.size(); i++)
+      result = Agree(result, in[i], "the arguments are");
+    return result;
+  }
+  case FU_CHOICE:
+    return in.size() == 3 ? Agree(in[1], in[2], "the choices are") : kUnknown;
+  case FU_QUOTIENT: {
+    Inferred result = in.size() >= 2 ? Over(in[0], in[1]) : kUnknown;
+    return in.size() == 3 ? Agree(result, in[2], "the quotient and fallback are") : result;
+  }
+  case FU_DIMENSIONLESS:
+    for (const Inferred &arg : in) {
+      if (arg.kind == UNITS_KNOWN && arg.id != UNITS_DIMENSIONLESS)
+        Problem(e->GetFunction()->GetName() + " of " + mTable.Describe(arg.id) + ", which should be dimensionless");
+    }
+    return Known(UNITS_DIMENSIONLESS);
+  case FU_ROOT: {
+    UnitId root;
+    if (in[0].kind == UNITS_KNOWN && mTable.Root(in[0].id, 2, root))
+      return Known(root);
+    return in[0].kind == UNITS_NUMBER ? kNumber : kUnknown;
+  }
+  case FU_STOCK:
+    return in.size() == 2 ? Agree(Times(in[0], mTime), in[1], "the rate times time and initial value are")
+                          : kUnknown;
+  case FU_DELAY:
+    if (in.size() >= 2)
+      Agree(in[1], mTime, "the delay time and time units are");
+    return in.size() >= 3 ? Agree(in[0], in[2], "the input and initial value are") : in[0];
+  default:
+    return kUnknown;
+  }
+}
+
+void UnitsChecker::Check(Variable *var) {
+  pVariable = var;
+  Inferred declared = Declared(var);
+  for (Equation *eq : var->GetAllEquations()) {
+    Expression *exp = eq->GetExpression();
+    if (!exp || exp->GetType() == EXPTYPE_Symlist)
+      continue;  // a subscript range
+    size_t before = vProblems.size();
+    Inferred result = Walk(exp);
+    if (vProblems.size() > before)
+      continue;  // what it gives is no more than a guess past that
+    if (declared.kind == UNITS_KNOWN && result.kind == UNITS_KNOWN && result.id != declared.id)
+      Problem("the units are " + mTable.Describe(declared.id) + " but the equation gives " +
+              mTable.Describe(result.id));
+  }
+}
+
+}  // namespace
+
+bool Model::UnitsCheck(std::vector<Diagnostic> &problems) {
+  size_t before = problems.size();
+  UnitsChecker checker{this, problems};
+  for (Variable *var : mSymbolNameSpace.Variables())
+    checker.Check(var);
+  return problems.size() == before;
+}
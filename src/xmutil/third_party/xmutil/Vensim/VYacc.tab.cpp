@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2019 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -34,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -41,134 +45,159 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
-
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "3.5"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 0
+#define YYPURE 2
 
 /* Push parsers.  */
-#define YYPUSH 0
+#define YYPUSH 1
 
 /* Pull parsers.  */
-#define YYPULL 1
+#define YYPULL 0
+
 
 /* Substitute the variable and function names.  */
-#define yyparse vpyyparse
-#define yylex vpyylex
-#define yyerror vpyyerror
-#define yydebug vpyydebug
-#define yynerrs vpyynerrs
-#define yylval vpyylval
-#define yychar vpyychar
+#define yypush_parse    vpyypush_parse
+#define yypstate_new    vpyypstate_new
+#define yypstate_clear  vpyypstate_clear
+#define yypstate_delete vpyypstate_delete
+#define yypstate        vpyypstate
+#define yylex           vpyylex
+#define yyerror         vpyyerror
+#define yydebug         vpyydebug
+#define yynerrs         vpyynerrs
 
 /* First part of user prologue.  */
-#line 7 "VYacc.y"
+#line 11 "VYacc.y"
 
 #include "../Symbol/Parse.h"
 #include "VensimParseFunctions.h"
-extern int vpyylex(void);
-extern void vpyyerror(char const *);
 #define YYSTYPE ParseUnion
-
-#line 85 "VYacc.tab.cpp"
-
-#ifndef YY_CAST
-#ifdef __cplusplus
-#define YY_CAST(Type, Val) static_cast<Type>(Val)
-#define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type>(Val)
-#else
-#define YY_CAST(Type, Val) ((Type)(Val))
-#define YY_REINTERPRET_CAST(Type, Val) ((Type)(Val))
-#endif
-#endif
-#ifndef YY_NULLPTR
-#if defined __cplusplus
-#if 201103L <= __cplusplus
-#define YY_NULLPTR nullptr
-#else
-#define YY_NULLPTR 0
-#endif
-#else
-#define YY_NULLPTR ((void *)0)
-#endif
-#endif
-
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-#undef YYERROR_VERBOSE
-#define YYERROR_VERBOSE 1
-#else
-#define YYERROR_VERBOSE 0
-#endif
-
-/* Use api.header.include to #include this header
-   instead of duplicating it here.  */
-#ifndef YY_VPYY_VYACC_TAB_HPP_INCLUDED
-#define YY_VPYY_VYACC_TAB_HPP_INCLUDED
-/* Debug traces.  */
-#ifndef YYDEBUG
-#define YYDEBUG 0
-#endif
-#if YYDEBUG
-extern int vpyydebug;
-#endif
-
-/* Token type.  */
-#ifndef YYTOKENTYPE
-#define YYTOKENTYPE
-enum yytokentype {
-  VPTT_dataequals = 258,
-  VPTT_with_lookup = 259,
-  VPTT_map = 260,
-  VPTT_equiv = 261,
-  VPTT_groupstar = 262,
-  VPTT_and = 263,
-  VPTT_macro = 264,
-  VPTT_end_of_macro = 265,
-  VPTT_or = 266,
-  VPTT_not = 267,
-  VPTT_hold_backward = 268,
-  VPTT_look_forward = 269,
-  VPTT_except = 270,
-  VPTT_na = 271,
-  VPTT_interpolate = 272,
-  VPTT_raw = 273,
-  VPTT_test_input = 274,
-  VPTT_the_condition = 275,
-  VPTT_implies = 276,
-  VPTT_ge = 277,
-  VPTT_le = 278,
-  VPTT_ne = 279,
-  VPTT_tabbed_array = 280,
-  VPTT_eqend = 281,
-  VPTT_number = 282,
-  VPTT_literal = 283,
-  VPTT_symbol = 284,
-  VPTT_units_symbol = 285,
-  VPTT_function = 286
+extern int vpyylex (YYSTYPE *lvalp, VensimParse *vp);
+extern void vpyyerror (VensimParse *vp, char const *);
+
+#line 88 "VYacc.tab.cpp"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "VYacc.tab.hpp"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_VPTT_dataequals = 3,            /* VPTT_dataequals  */
+  YYSYMBOL_VPTT_with_lookup = 4,           /* VPTT_with_lookup  */
+  YYSYMBOL_VPTT_map = 5,                   /* VPTT_map  */
+  YYSYMBOL_VPTT_equiv = 6,                 /* VPTT_equiv  */
+  YYSYMBOL_VPTT_groupstar = 7,             /* VPTT_groupstar  */
+  YYSYMBOL_VPTT_and = 8,                   /* VPTT_and  */
+  YYSYMBOL_VPTT_macro = 9,                 /* VPTT_macro  */
+  YYSYMBOL_VPTT_end_of_macro = 10,         /* VPTT_end_of_macro  */
+  YYSYMBOL_VPTT_or = 11,                   /* VPTT_or  */
+  YYSYMBOL_VPTT_not = 12,                  /* VPTT_not  */
+  YYSYMBOL_VPTT_hold_backward = 13,        /* VPTT_hold_backward  */
+  YYSYMBOL_VPTT_look_forward = 14,         /* VPTT_look_forward  */
+  YYSYMBOL_VPTT_except = 15,               /* VPTT_except  */
+  YYSYMBOL_VPTT_na = 16,                   /* VPTT_na  */
+  YYSYMBOL_VPTT_interpolate = 17,          /* VPTT_interpolate  */
+  YYSYMBOL_VPTT_raw = 18,                  /* VPTT_raw  */
+  YYSYMBOL_VPTT_test_input = 19,           /* VPTT_test_input  */
+  YYSYMBOL_VPTT_the_condition = 20,        /* VPTT_the_condition  */
+  YYSYMBOL_VPTT_implies = 21,              /* VPTT_implies  */
+  YYSYMBOL_VPTT_ge = 22,                   /* VPTT_ge  */
+  YYSYMBOL_VPTT_le = 23,                   /* VPTT_le  */
+  YYSYMBOL_VPTT_ne = 24,                   /* VPTT_ne  */
+  YYSYMBOL_VPTT_tabbed_array = 25,         /* VPTT_tabbed_array  */
+  YYSYMBOL_VPTT_eqend = 26,                /* VPTT_eqend  */
+  YYSYMBOL_VPTT_number = 27,               /* VPTT_number  */
+  YYSYMBOL_VPTT_literal = 28,              /* VPTT_literal  */
+  YYSYMBOL_VPTT_symbol = 29,               /* VPTT_symbol  */
+  YYSYMBOL_VPTT_units_symbol = 30,         /* VPTT_units_symbol  */
+  YYSYMBOL_VPTT_function = 31,             /* VPTT_function  */
+  YYSYMBOL_32_ = 32,                       /* '%'  */
+  YYSYMBOL_33_ = 33,                       /* '|'  */
+  YYSYMBOL_34_ = 34,                       /* '='  */
+  YYSYMBOL_35_ = 35,                       /* '<'  */
+  YYSYMBOL_36_ = 36,                       /* '>'  */
+  YYSYMBOL_37_ = 37,                       /* '-'  */
+  YYSYMBOL_38_ = 38,                       /* '+'  */
+  YYSYMBOL_39_ = 39,                       /* '*'  */
+  YYSYMBOL_40_ = 40,                       /* '/'  */
+  YYSYMBOL_VPTT_unary = 41,                /* VPTT_unary  */
+  YYSYMBOL_42_ = 42,                       /* '^'  */
+  YYSYMBOL_43_ = 43,                       /* '~'  */
+  YYSYMBOL_44_ = 44,                       /* '('  */
+  YYSYMBOL_45_ = 45,                       /* ')'  */
+  YYSYMBOL_46_ = 46,                       /* ','  */
+  YYSYMBOL_47_ = 47,                       /* ':'  */
+  YYSYMBOL_48_ = 48,                       /* '['  */
+  YYSYMBOL_49_ = 49,                       /* ']'  */
+  YYSYMBOL_50_ = 50,                       /* '!'  */
+  YYSYMBOL_51_ = 51,                       /* '?'  */
+  YYSYMBOL_52_ = 52,                       /* ';'  */
+  YYSYMBOL_YYACCEPT = 53,                  /* $accept  */
+  YYSYMBOL_fulleq = 54,                    /* fulleq  */
+  YYSYMBOL_macrostart = 55,                /* macrostart  */
+  YYSYMBOL_56_1 = 56,                      /* $@1  */
+  YYSYMBOL_macroend = 57,                  /* macroend  */
+  YYSYMBOL_eqn = 58,                       /* eqn  */
+  YYSYMBOL_lhs = 59,                       /* lhs  */
+  YYSYMBOL_var = 60,                       /* var  */
+  YYSYMBOL_sublist = 61,                   /* sublist  */
+  YYSYMBOL_symlist = 62,                   /* symlist  */
+  YYSYMBOL_subdef = 63,                    /* subdef  */
+  YYSYMBOL_unitsrange = 64,                /* unitsrange  */
+  YYSYMBOL_urangenum = 65,                 /* urangenum  */
+  YYSYMBOL_number = 66,                    /* number  */
+  YYSYMBOL_units = 67,                     /* units  */
+  YYSYMBOL_interpmode = 68,                /* interpmode  */
+  YYSYMBOL_exceptlist = 69,                /* exceptlist  */
+  YYSYMBOL_mapsymlist = 70,                /* mapsymlist  */
+  YYSYMBOL_maplist = 71,                   /* maplist  */
+  YYSYMBOL_exprlist = 72,                  /* exprlist  */
+  YYSYMBOL_exp = 73,                       /* exp  */
+  YYSYMBOL_tablevals = 74,                 /* tablevals  */
+  YYSYMBOL_xytablevals = 75,               /* xytablevals  */
+  YYSYMBOL_xytablevec = 76,                /* xytablevec  */
+  YYSYMBOL_tablepairs = 77                 /* tablepairs  */
 };
-#endif
+typedef enum yysymbol_kind_t yysymbol_kind_t;
 
-/* Value type.  */
 
-extern YYSTYPE vpyylval;
 
-int vpyyparse(void);
-
-#endif /* !YY_VPYY_VYACC_TAB_HPP_INCLUDED  */
 
 #ifdef short
-#undef short
+# undef short
 #endif
 
 /* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
@@ -176,11 +205,11 @@ int vpyyparse(void);
    so that the code can choose integer types of a good width.  */
 
 #ifndef __PTRDIFF_MAX__
-#include <limits.h> /* INFRINGES ON USER NAME SPACE */
-#if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
-#include <stdint.h> /* INFRINGES ON USER NAME SPACE */
-#define YY_STDINT_H
-#endif
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
 #endif
 
 /* Narrow types that promote to a signed type and that can represent a
@@ -204,9 +233,22 @@ typedef int_least16_t yytype_int16;
 typedef short yytype_int16;
 #endif
 
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
 #if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
 typedef __UINT_LEAST8_TYPE__ yytype_uint8;
-#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H && UINT_LEAST8_MAX <= INT_MAX)
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
 typedef uint_least8_t yytype_uint8;
 #elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
 typedef unsigned char yytype_uint8;
@@ -216,7 +258,8 @@ typedef short yytype_uint8;
 
 #if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
 typedef __UINT_LEAST16_TYPE__ yytype_uint16;
-#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H && UINT_LEAST16_MAX <= INT_MAX)
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
 typedef uint_least16_t yytype_uint16;
 #elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
 typedef unsigned short yytype_uint16;
@@ -225,38 +268,42 @@ typedef int yytype_uint16;
 #endif
 
 #ifndef YYPTRDIFF_T
-#if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
-#define YYPTRDIFF_T __PTRDIFF_TYPE__
-#define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
-#elif defined PTRDIFF_MAX
-#ifndef ptrdiff_t
-#include <stddef.h> /* INFRINGES ON USER NAME SPACE */
-#endif
-#define YYPTRDIFF_T ptrdiff_t
-#define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
-#else
-#define YYPTRDIFF_T long
-#define YYPTRDIFF_MAXIMUM LONG_MAX
-#endif
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
 #endif
 
 #ifndef YYSIZE_T
-#ifdef __SIZE_TYPE__
-#define YYSIZE_T __SIZE_TYPE__
-#elif defined size_t
-#define YYSIZE_T size_t
-#elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
-#include <stddef.h> /* INFRINGES ON USER NAME SPACE */
-#define YYSIZE_T size_t
-#else
-#define YYSIZE_T unsigned
-#endif
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
 #endif
 
-#define YYSIZE_MAXIMUM \
-  YY_CAST(YYPTRDIFF_T, (YYPTRDIFF_MAXIMUM < YY_CAST(YYSIZE_T, -1) ? YYPTRDIFF_MAXIMUM : YY_CAST(YYSIZE_T, -1)))
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
 
-#define YYSIZEOF(X) YY_CAST(YYPTRDIFF_T, sizeof(X))
 
 /* Stored state numbers (used for stacks). */
 typedef yytype_uint8 yy_state_t;
@@ -265,513 +312,612 @@ typedef yytype_uint8 yy_state_t;
 typedef int yy_state_fast_t;
 
 #ifndef YY_
-#if defined YYENABLE_NLS && YYENABLE_NLS
-#if ENABLE_NLS
-#include <libintl.h> /* INFRINGES ON USER NAME SPACE */
-#define YY_(Msgid) dgettext("bison-runtime", Msgid)
-#endif
-#endif
-#ifndef YY_
-#define YY_(Msgid) Msgid
-#endif
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
 #endif
 
+
 #ifndef YY_ATTRIBUTE_PURE
-#if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
-#define YY_ATTRIBUTE_PURE __attribute__((__pure__))
-#else
-#define YY_ATTRIBUTE_PURE
-#endif
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
 #endif
 
 #ifndef YY_ATTRIBUTE_UNUSED
-#if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
-#define YY_ATTRIBUTE_UNUSED __attribute__((__unused__))
-#else
-#define YY_ATTRIBUTE_UNUSED
-#endif
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
 #endif
 
 /* Suppress unused-variable warnings by "using" E.  */
-#if !defined lint || defined __GNUC__
-#define YYUSE(E) ((void)(E))
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
 #else
-#define YYUSE(E) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-#if defined __GNUC__ && !defined __ICC && 407 <= __GNUC__ * 100 + __GNUC_MINOR__
 /* Suppress an incorrect diagnostic about yylval being uninitialized.  */
-#define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                                            \
-  _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
-      _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
-#define YY_IGNORE_MAYBE_UNINITIALIZED_END _Pragma("GCC diagnostic pop")
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
 #else
-#define YY_INITIAL_VALUE(Value) Value
+# define YY_INITIAL_VALUE(Value) Value
 #endif
 #ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-#define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-#define YY_IGNORE_MAYBE_UNINITIALIZED_END
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
 #endif
 #ifndef YY_INITIAL_VALUE
-#define YY_INITIAL_VALUE(Value) /* Nothing. */
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
 #endif
 
-#if defined __cplusplus && defined __GNUC__ && !defined __ICC && 6 <= __GNUC__
-#define YY_IGNORE_USELESS_CAST_BEGIN _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wuseless-cast\"")
-#define YY_IGNORE_USELESS_CAST_END _Pragma("GCC diagnostic pop")
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
 #endif
 #ifndef YY_IGNORE_USELESS_CAST_BEGIN
-#define YY_IGNORE_USELESS_CAST_BEGIN
-#define YY_IGNORE_USELESS_CAST_END
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
 #endif
 
-#define YY_ASSERT(E) ((void)(0 && (E)))
-
-#if !defined yyoverflow || YYERROR_VERBOSE
 
-/* The parser invokes alloca or malloc; define the necessary symbols.  */
+#define YY_ASSERT(E) ((void) (0 && (E)))
 
-#ifdef YYSTACK_USE_ALLOCA
-#if YYSTACK_USE_ALLOCA
-#ifdef __GNUC__
-#define YYSTACK_ALLOC __builtin_alloca
-#elif defined __BUILTIN_VA_ARG_INCR
-#include <alloca.h> /* INFRINGES ON USER NAME SPACE */
-#elif defined _AIX
-#define YYSTACK_ALLOC __alloca
-#elif defined _MSC_VER
-#include <malloc.h> /* INFRINGES ON USER NAME SPACE */
-#define alloca _alloca
-#else
-#define YYSTACK_ALLOC alloca
-#if !defined _ALLOCA_H && !defined EXIT_SUCCESS
-#include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-/* Use EXIT_SUCCESS as a witness for stdlib.h.  */
-#ifndef EXIT_SUCCESS
-#define EXIT_SUCCESS 0
-#endif
-#endif
-#endif
-#endif
-#endif
+#if !defined yyoverflow
 
-#ifdef YYSTACK_ALLOC
-/* Pacify GCC's 'empty if-body' warning.  */
-#define YYSTACK_FREE(Ptr) \
-  do { /* empty */        \
-    ;                     \
-  } while (0)
-#ifndef YYSTACK_ALLOC_MAXIMUM
-/* The OS might guarantee only one guard page at the bottom of the stack,
-   and a page size can be as small as 4096 bytes.  So we cannot safely
-   invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
-   to allow for a few compiler-allocated temporary stack slots.  */
-#define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
-#endif
-#else
-#define YYSTACK_ALLOC YYMALLOC
-#define YYSTACK_FREE YYFREE
-#ifndef YYSTACK_ALLOC_MAXIMUM
-#define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
-#endif
-#if (defined __cplusplus && !defined EXIT_SUCCESS && \
-     !((defined YYMALLOC || defined malloc) && (defined YYFREE || defined free)))
-#include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-#ifndef EXIT_SUCCESS
-#define EXIT_SUCCESS 0
-#endif
-#endif
-#ifndef YYMALLOC
-#define YYMALLOC malloc
-#if !defined malloc && !defined EXIT_SUCCESS
-void *malloc(YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
-#endif
-#endif
-#ifndef YYFREE
-#define YYFREE free
-#if !defined free && !defined EXIT_SUCCESS
-void free(void *);      /* INFRINGES ON USER NAME SPACE */
-#endif
-#endif
-#endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
 
-#if (!defined yyoverflow && (!defined __cplusplus || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
 
 /* A type that is properly aligned for any stack member.  */
-union yyalloc {
+union yyalloc
+{
   yy_state_t yyss_alloc;
   YYSTYPE yyvs_alloc;
 };
 
 /* The size of the maximum gap between one aligned stack and the next.  */
-#define YYSTACK_GAP_MAXIMUM (YYSIZEOF(union yyalloc) - 1)
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
 
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
-#define YYSTACK_BYTES(N) ((N) * (YYSIZEOF(yy_state_t) + YYSIZEOF(YYSTYPE)) + YYSTACK_GAP_MAXIMUM)
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
 
-#define YYCOPY_NEEDED 1
+# define YYCOPY_NEEDED 1
 
 /* Relocate STACK from its old location to the new one.  The
    local variables YYSIZE and YYSTACKSIZE give the old and new number of
    elements in the stack, and YYPTR gives the new location of the
    stack.  Advance YYPTR to a properly aligned location for the next
    stack.  */
-#define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
-  do {                                                                 \
-    YYPTRDIFF_T yynewbytes;                                            \
-    YYCOPY(&yyptr->Stack_alloc, Stack, yysize);                        \
-    Stack = &yyptr->Stack_alloc;                                       \
-    yynewbytes = yystacksize * YYSIZEOF(*Stack) + YYSTACK_GAP_MAXIMUM; \
-    yyptr += yynewbytes / YYSIZEOF(*yyptr);                            \
-  } while (0)
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
 
 #endif
 
 #if defined YYCOPY_NEEDED && YYCOPY_NEEDED
 /* Copy COUNT objects from SRC to DST.  The source and destination do
    not overlap.  */
-#ifndef YYCOPY
-#if defined __GNUC__ && 1 < __GNUC__
-#define YYCOPY(Dst, Src, Count) __builtin_memcpy(Dst, Src, YY_CAST(YYSIZE_T, (Count)) * sizeof(*(Src)))
-#else
-#define YYCOPY(Dst, Src, Count)         \
-  do {                                  \
-    YYPTRDIFF_T yyi;                    \
-    for (yyi = 0; yyi < (Count); yyi++) \
-      (Dst)[yyi] = (Src)[yyi];          \
-  } while (0)
-#endif
-#endif
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
 #endif /* !YYCOPY_NEEDED */
 
 /* YYFINAL -- State number of the termination state.  */
-#define YYFINAL 16
+#define YYFINAL  16
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST 316
+#define YYLAST   319
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS 52
+#define YYNTOKENS  53
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS 25
+#define YYNNTS  25
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES 97
+#define YYNRULES  97
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES 228
+#define YYNSTATES  228
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   287
 
-#define YYUNDEFTOK 2
-#define YYMAXUTOK 286
 
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex, with out-of-bounds checking.  */
-#define YYTRANSLATE(YYX) (0 <= (YYX) && (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
 
 /* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
    as returned by yylex.  */
-static const yytype_int8 yytranslate[] = {
-    0,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  49, 2,  2,  2,  32, 2,  2,  43, 44, 39, 35, 45, 34, 2,  40, 2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    46, 51, 37, 36, 38, 50, 2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  47, 2,  48, 41, 2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  2,  2,  2,  2,  33, 2,  42, 2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, 2, 2, 2,
-    2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  1,  2, 3, 4, 5,
-    6,  7,  8,  9,  10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,    50,     2,     2,     2,    32,     2,     2,
+      44,    45,    39,    38,    46,    37,     2,    40,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,    47,    52,
+      35,    34,    36,    51,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,    48,     2,    49,    42,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,    33,     2,    43,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28,    29,    30,    31,    41
+};
 
 #if YYDEBUG
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_uint8 yyrline[] = {
-    0,   83,  83,  84,  85,  86,  87,  88,  89,  90,  94,  94,  98,  105, 106, 107, 108, 109, 110, 111,
-    112, 117, 118, 119, 123, 124, 128, 132, 133, 134, 135, 138, 139, 140, 141, 145, 146, 147, 148, 149,
-    153, 154, 157, 158, 159, 163, 164, 165, 166, 171, 172, 173, 174, 178, 179, 183, 184, 185, 186, 191,
-    192, 197, 198, 199, 200, 204, 205, 206, 207, 208, 209, 210, 211, 212, 213, 214, 215, 216, 217, 218,
-    219, 220, 221, 222, 223, 224, 225, 226, 227, 231, 232, 234, 239, 240, 245, 246, 251, 252};
+static const yytype_int16 yyrline[] =
+{
+       0,   101,   101,   102,   103,   104,   105,   106,   107,   108,
+     112,   112,   116,   123,   124,   125,   126,   127,   128,   129,
+     130,   135,   136,   137,   141,   142,   146,   150,   151,   152,
+     153,   156,   157,   158,   159,   163,   164,   165,   166,   167,
+     171,   172,   175,   176,   177,   181,   182,   183,   184,   189,
+     190,   191,   192,   196,   197,   201,   202,   203,   204,   209,
+     210,   215,   216,   217,   218,   222,   223,   224,   225,   226,
+     227,   228,   229,   230,   231,   232,   233,   234,   235,   236,
+     237,   238,   239,   240,   241,   242,   243,   244,   245,   249,
+     250,   252,   257,   258,   263,   264,   269,   270
+};
 #endif
 
-#if YYDEBUG || YYERROR_VERBOSE || 0
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
-static const char *const yytname[] = {"$end",
-                                      "error",
-                                      "$undefined",
-                                      "VPTT_dataequals",
-                                      "VPTT_with_lookup",
-                                      "VPTT_map",
-                                      "VPTT_equiv",
-                                      "VPTT_groupstar",
-                                      "VPTT_and",
-                                      "VPTT_macro",
-                                      "VPTT_end_of_macro",
-                                      "VPTT_or",
-                                      "VPTT_not",
-                                      "VPTT_hold_backward",
-                                      "VPTT_look_forward",
-                                      "VPTT_except",
-                                      "VPTT_na",
-                                      "VPTT_interpolate",
-                                      "VPTT_raw",
-                                      "VPTT_test_input",
-                                      "VPTT_the_condition",
-                                      "VPTT_implies",
-                                      "VPTT_ge",
-                                      "VPTT_le",
-                                      "VPTT_ne",
-                                      "VPTT_tabbed_array",
-                                      "VPTT_eqend",
-                                      "VPTT_number",
-                                      "VPTT_literal",
-                                      "VPTT_symbol",
-                                      "VPTT_units_symbol",
-                                      "VPTT_function",
-                                      "'%'",
-                                      "'|'",
-                                      "'-'",
-                                      "'+'",
-                                      "'='",
-                                      "'<'",
-                                      "'>'",
-                                      "'*'",
-                                      "'/'",
-                                      "'^'",
-                                      "'~'",
-                                      "'('",
-                                      "')'",
-                                      "','",
-                                      "':'",
-                                      "'['",
-                                      "']'",
-                                      "'!'",
-                                      "'?'",
-                                      "';'",
-                                      "$accept",
-                                      "fulleq",
-                                      "macrostart",
-                                      "$@1",
-                                      "macroend",
-                                      "eqn",
-                                      "lhs",
-                                      "var",
-                                      "sublist",
-                                      "symlist",
-                                      "subdef",
-                                      "unitsrange",
-                                      "urangenum",
-                                      "number",
-                                      "units",
-                                      "interpmode",
-                                      "exceptlist",
-                                      "mapsymlist",
-                                      "maplist",
-                                      "exprlist",
-                                      "exp",
-                                      "tablevals",
-                                      "xytablevals",
-                                      "xytablevec",
-                                      "tablepairs",
-                                      YY_NULLPTR};
-#endif
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "VPTT_dataequals",
+  "VPTT_with_lookup", "VPTT_map", "VPTT_equiv", "VPTT_groupstar",
+  "VPTT_and", "VPTT_macro", "VPTT_end_of_macro", "VPTT_or", "VPTT_not",
+  "VPTT_hold_backward", "VPTT_look_forward", "VPTT_except", "VPTT_na",
+  "VPTT_interpolate", "VPTT_raw", "VPTT_test_input", "VPTT_the_condition",
+  "VPTT_implies", "VPTT_ge", "VPTT_le", "VPTT_ne", "VPTT_tabbed_array",
+  "VPTT_eqend", "VPTT_number", "VPTT_literal", "VPTT_symbol",
+  "VPTT_units_symbol", "VPTT_function", "'%'", "'|'", "'='", "'<'", "'>'",
+  "'-'", "'+'", "'*'", "'/'", "VPTT_unary", "'^'", "'~'", "'('", "')'",
+  "','", "':'", "'['", "']'", "'!'", "'?'", "';'", "$accept", "fulleq",
+  "macrostart", "$@1", "macroend", "eqn", "lhs", "var", "sublist",
+  "symlist", "subdef", "unitsrange", "urangenum", "number", "units",
+  "interpmode", "exceptlist", "mapsymlist", "maplist", "exprlist", "exp",
+  "tablevals", "xytablevals", "xytablevec", "tablepairs", YY_NULLPTR
+};
 
-#ifdef YYPRINT
-/* YYTOKNUM[NUM] -- (External) token number corresponding to the
-   (internal) symbol number NUM (which must be that of a token).  */
-static const yytype_int16 yytoknum[] = {0,   256, 257, 258, 259, 260, 261, 262, 263, 264, 265, 266, 267,
-                                        268, 269, 270, 271, 272, 273, 274, 275, 276, 277, 278, 279, 280,
-                                        281, 282, 283, 284, 285, 286, 37,  124, 45,  43,  61,  60,  62,
-                                        42,  47,  94,  126, 40,  41,  44,  58,  91,  93,  33,  63,  59};
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
 #endif
 
-#define YYPACT_NINF (-208)
+#define YYPACT_NINF (-154)
 
-#define yypact_value_is_default(Yyn) ((Yyn) == YYPACT_NINF)
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
 
 #define YYTABLE_NINF (-1)
 
-#define yytable_value_is_error(Yyn) 0
+#define yytable_value_is_error(Yyn) \
+  0
 
 /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
    STATE-NUM.  */
-static const yytype_int16 yypact[] = {
-    66,  -208, -208, -208, -208, 50,   21,   -208, -208, 9,    0,    126,  16,   -2,   27,  -208, -208, 20,   260,
-    3,   130,  -208, -208, 31,   -208, -208, -208, 54,   88,   -208, 108,  -1,   93,   82,  -208, -208, -208, -21,
-    -10, -19,  32,   260,  -208, -208, -208, 31,   116,  260,  260,  260,  138,  201,  143, -208, 10,   201,  -208,
-    144, 183,  91,   153,  -208, 111,  172,  174,  175,  -208, 31,   260,  187,  45,   90,  -208, -208, 188,  -208,
-    128, -208, 177,  -208, -208, -208, -21,  -21,  -10,  185,  240,  207,  207,  112,  260, 260,  260,  260,  260,
-    260, 260,  260,  260,  260,  260,  260,  260,  260,  260,  260,  260,  -208, -208, 182, 91,   -208, -208, 91,
-    189, -208, -33,  199,  -208, 204,  205,  -208, 222,  206,  -208, -10,  -208, -208, 208, -208, 77,   -208, 167,
-    154, 241,  25,   25,   25,   207,  207,  25,   25,   25,   185,  185,  185,  46,   201, 201,  91,   209,  -208,
-    91,  -208, 190,  211,  95,   224,  -208, 115,  -10,  -208, -208, 216,  217,  91,   215, -208, 27,   -208, 233,
-    237, -10,  -208, 121,  51,   -208, 226,  91,   155,  227,  242,  244,  -10,  -208, 247, 249,  251,  252,  -208,
-    27,  -208, -208, 250,  91,   253,  256,  -208, 169,  -208, 255,  -208, 91,   -208, 91,  257,  261,  91,   267,
-    262, 264,  131,  91,   265,  259,  266,  135,  127,  91,   268,  174,  175,  270,  265, 140,  175,  271,  265};
+static const yytype_int16 yypact[] =
+{
+       4,  -154,  -154,  -154,  -154,    15,    16,  -154,  -154,   -36,
+       0,   203,    -5,    -9,    21,  -154,  -154,    51,    -6,   115,
+      38,  -154,  -154,    48,  -154,  -154,  -154,    72,    53,  -154,
+      91,    -1,    78,    34,  -154,  -154,  -154,    43,   -10,   -24,
+      82,    -6,  -154,  -154,  -154,    48,    89,    -6,    -6,    -6,
+      95,   200,   103,  -154,   -34,   200,  -154,   130,   154,    98,
+     149,  -154,   151,   165,   173,   186,  -154,    48,    -6,   206,
+       7,    17,  -154,  -154,   215,  -154,   155,  -154,   204,  -154,
+    -154,  -154,    43,    43,   -10,   241,   229,   210,   210,   126,
+      -6,    -6,    -6,    -6,    -6,    -6,    -6,    -6,    -6,    -6,
+      -6,    -6,    -6,    -6,    -6,    -6,    -6,  -154,  -154,   207,
+      98,  -154,  -154,    98,   211,  -154,    46,   225,  -154,   230,
+     216,  -154,   232,   218,  -154,   -10,  -154,  -154,   223,  -154,
+     131,  -154,   167,   241,   191,   209,   209,   209,   209,   209,
+     209,    84,    84,   210,   210,   210,    32,   200,   200,    98,
+     224,  -154,    98,  -154,   226,   237,    35,   235,  -154,    39,
+     -10,  -154,  -154,   243,   240,    98,   242,  -154,    21,  -154,
+     260,   261,   -10,  -154,    92,     9,  -154,   246,    98,   110,
+     247,   248,   249,   -10,  -154,   251,   252,   262,   255,  -154,
+      21,  -154,  -154,   253,    98,   256,   259,  -154,   127,  -154,
+     258,  -154,    98,  -154,    98,   263,   265,    98,   268,   266,
+     264,   105,    98,   269,   270,   271,   121,   142,    98,   272,
+     173,   186,   267,   269,   139,   186,   273,   269
+};
 
 /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
    Performed when YYTABLE does not specify something else to do.  Zero
    means the default is an error.  */
-static const yytype_int8 yydefact[] = {
-    0,  3,  10, 12, 2,  24, 0,  4,  5,  0, 18, 21, 0, 0,  0,  25, 1,  0,  0,  0,  0,  51, 52, 0,  49, 50, 23, 22, 0,
-    31, 0,  59, 27, 0,  45, 9,  8,  0,  0, 0,  35, 0, 66, 65, 68, 24, 0,  0,  0,  0,  67, 17, 0,  20, 13, 61, 42, 0,
-    0,  0,  0,  94, 0,  0,  92, 89, 53, 0, 0,  0,  0, 0,  19, 28, 0,  26, 0,  41, 0,  40, 7,  6,  0,  0,  0,  84, 0,
-    86, 87, 0,  0,  0,  0,  0,  0,  0,  0, 0,  0,  0, 0,  0,  0,  0,  0,  0,  64, 43, 44, 0,  0,  14, 15, 0,  0,  54,
-    0,  0,  55, 0,  60, 33, 0,  29, 48, 0, 47, 46, 0, 72, 0,  70, 0,  83, 82, 80, 78, 81, 74, 73, 85, 77, 79, 75, 76,
-    88, 0,  62, 63, 0,  0,  95, 0,  11, 0, 0,  0,  0, 30, 0,  0,  71, 69, 0,  0,  0,  0,  32, 0,  57, 0,  0,  0,  38,
-    0,  0,  96, 0,  0,  0,  0,  0,  0,  0, 36, 0,  0, 0,  0,  56, 0,  34, 39, 0,  0,  0,  0,  97, 0,  37, 0,  16, 0,
-    58, 0,  0,  0,  0,  0,  0,  0,  0,  0, 0,  0,  0, 0,  0,  0,  0,  93, 90, 0,  0,  0,  91, 0,  0};
+static const yytype_int8 yydefact[] =
+{
+       0,     3,    10,    12,     2,    24,     0,     4,     5,     0,
+      18,    21,     0,     0,     0,    25,     1,     0,     0,     0,
+       0,    51,    52,     0,    49,    50,    23,    22,     0,    31,
+       0,    59,    27,     0,    45,     9,     8,     0,     0,     0,
+      35,     0,    66,    65,    68,    24,     0,     0,     0,     0,
+      67,    17,     0,    20,    13,    61,    42,     0,     0,     0,
+       0,    94,     0,     0,    92,    89,    53,     0,     0,     0,
+       0,     0,    19,    28,     0,    26,     0,    41,     0,    40,
+       7,     6,     0,     0,     0,    84,     0,    86,    87,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,    64,    43,    44,     0,
+       0,    14,    15,     0,     0,    54,     0,     0,    55,     0,
+      60,    33,     0,    29,    48,     0,    47,    46,     0,    72,
+       0,    70,     0,    83,    82,    80,    78,    81,    85,    77,
+      79,    74,    73,    75,    76,    88,     0,    62,    63,     0,
+       0,    95,     0,    11,     0,     0,     0,     0,    30,     0,
+       0,    71,    69,     0,     0,     0,     0,    32,     0,    57,
+       0,     0,     0,    38,     0,     0,    96,     0,     0,     0,
+       0,     0,     0,     0,    36,     0,     0,     0,     0,    56,
+       0,    34,    39,     0,     0,     0,     0,    97,     0,    37,
+       0,    16,     0,    58,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+      93,    90,     0,     0,     0,    91,     0,     0
+};
 
 /* YYPGOTO[NTERM-NUM].  */
-static const yytype_int16 yypgoto[] = {-208, -208, -208, -208, -208, -208, -208, 309, -18, -155, -208, -208, -83,
-                                       -20,  -35,  -208, -208, -208, -208, -60,  11,  137, -208, 98,   -207};
+static const yytype_int16 yypgoto[] =
+{
+    -154,  -154,  -154,  -154,  -154,  -154,  -154,   306,   -18,  -153,
+    -154,  -154,   -83,   -20,   -35,  -154,  -154,  -154,  -154,   -60,
+      11,   132,  -154,    97,    69
+};
 
 /* YYDEFGOTO[NTERM-NUM].  */
-static const yytype_int8 yydefgoto[] = {-1, 6,  7,  12, 8,   9,  10, 50, 15, 33, 31, 39, 78,
-                                        79, 40, 26, 27, 120, 72, 54, 55, 62, 63, 64, 65};
+static const yytype_int8 yydefgoto[] =
+{
+       0,     6,     7,    12,     8,     9,    10,    50,    15,    33,
+      31,    39,    78,    79,    40,    26,    27,   120,    72,    54,
+      55,    62,    63,    64,    65
+};
 
 /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
    positive, shift that token.  If negative, reduce the rule whose
    number is the opposite.  If YYTABLE_NINF, syntax error.  */
-static const yytype_uint8 yytable[] = {
-    61,  128, 76,  18,  70,  66,  216, 52,  116, 34,  221, 153, 105, 179, 80,  41,  225, 56,  106, 42,  221, 16,  37,
-    81,  57,  58,  130, 29,  53,  51,  43,  44,  45,  91,  46,  198, 19,  47,  48,  109, 77,  30,  159, 20,  71,  28,
-    49,  126, 127, 115, 34,  17,  85,  35,  91,  105, 32,  92,  87,  88,  89,  106, 36,  37,  101, 102, 103, 38,  93,
-    94,  95,  82,  83,  1,   118, 2,   3,   174, 14,  84,  96,  97,  98,  99,  100, 101, 102, 103, 119, 182, 150, 163,
-    4,   151, 59,  5,   13,  14,  185, 67,  193, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143, 144, 145,
-    146, 147, 148, 56,  121, 91,  161, 105, 92,  169, 57,  58,  74,  106, 164, 75,  68,  166, 122, 93,  94,  95,  69,
-    170, 21,  22,  23,  73,  24,  25,  177, 96,  97,  98,  99,  100, 101, 102, 103, 56,  111, 131, 56,  188, 86,  172,
-    57,  58,  173, 57,  58,  183, 82,  83,  184, 59,  107, 124, 59,  200, 91,  213, 60,  92,  214, 114, 90,  205, 219,
-    206, 213, 104, 209, 226, 93,  94,  95,  215, 101, 102, 103, 110, 61,  222, 189, 74,  96,  97,  98,  99,  100, 101,
-    102, 103, 91,  108, 162, 92,  203, 74,  91,  112, 123, 92,  113, 114, 117, 125, 93,  94,  95,  103, 149, 154, 93,
-    94,  95,  152, 155, 167, 96,  97,  98,  99,  100, 101, 102, 103, 98,  99,  100, 101, 102, 103, 91,  156, 157, 41,
-    160, 165, 158, 42,  168, 171, 175, 178, 176, 180, 93,  94,  95,  181, 43,  44,  45,  187, 46,  41,  190, 47,  48,
-    42,  98,  99,  100, 101, 102, 103, 49,  129, 196, 191, 43,  44,  45,  194, 46,  192, 195, 47,  48,  197, 201, 199,
-    202, 204, 210, 207, 49,  217, 208, 211, 212, 59,  11,  0,   218, 186, 223, 224, 220, 227};
-
-static const yytype_int16 yycheck[] = {
-    20,  84,  37,  3,   5,  23, 213, 4,   68,  30, 217, 44, 45,  168, 33,  12, 223, 27,  51, 16,  227, 0,   43,
-    42,  34,  35,  86,  29, 25, 18,  27,  28,  29, 8,   31, 190, 36,  34,  35, 59,  50,  43, 125, 43,  45,  29,
-    43,  82,  83,  67,  30, 42, 41,  33,  8,   45, 29,  11, 47,  48,  49,  51, 42,  43,  39, 40,  41,  47,  22,
-    23,  24,  39,  40,  7,  29, 9,   10,  160, 47, 47,  34, 35,  36,  37,  38, 39,  40,  41, 43,  172, 110, 45,
-    26,  113, 43,  29,  46, 47, 47,  45,  183, 90, 91,  92, 93,  94,  95,  96, 97,  98,  99, 100, 101, 102, 103,
-    104, 105, 106, 27,  29, 8,  44,  45,  11,  29, 34,  35, 45,  51,  149, 48, 43,  152, 43, 22,  23,  24,  29,
-    43,  13,  14,  15,  49, 17, 18,  165, 34,  35, 36,  37, 38,  39,  40,  41, 27,  44,  44, 27,  178, 43,  45,
-    34,  35,  48,  34,  35, 45, 39,  40,  48,  43, 27,  44, 43,  194, 8,   45, 47,  11,  48, 45,  43,  202, 48,
-    204, 45,  43,  207, 48, 22, 23,  24,  212, 39, 40,  41, 43,  217, 218, 44, 45,  34,  35, 36,  37,  38,  39,
-    40,  41,  8,   27,  44, 11, 44,  45,  8,   44, 29,  11, 45,  45,  34,  45, 22,  23,  24, 41,  45,  29,  22,
-    23,  24,  43,  29,  44, 34, 35,  36,  37,  38, 39,  40, 41,  36,  37,  38, 39,  40,  41, 8,   45,  29,  12,
-    45,  45,  49,  16,  46, 34, 43,  45,  44,  29, 22,  23, 24,  29,  27,  28, 29,  44,  31, 12,  46,  34,  35,
-    16,  36,  37,  38,  39, 40, 41,  43,  44,  34, 44,  27, 28,  29,  43,  31, 48,  44,  34, 35,  44,  44,  48,
-    43,  45,  34,  45,  43, 45, 44,  44,  43,  43, 0,   -1, 45,  175, 45,  44, 217, 45};
-
-/* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-   symbol of state STATE-NUM.  */
-static const yytype_int8 yystos[] = {
-    0,  7,  9,  10, 26, 29, 53, 54, 56, 57, 58, 59, 55, 46, 47, 60, 0,  42, 3,  36, 43, 13, 14, 15, 17, 18, 67, 68, 29,
-    29, 43, 62, 29, 61, 30, 33, 42, 43, 47, 63, 66, 12, 16, 27, 28, 29, 31, 34, 35, 43, 59, 72, 4,  25, 71, 72, 27, 34,
-    35, 43, 47, 65, 73, 74, 75, 76, 60, 45, 43, 29, 5,  45, 70, 49, 45, 48, 66, 50, 64, 65, 33, 42, 39, 40, 47, 72, 43,
-    72, 72, 72, 43, 8,  11, 22, 23, 24, 34, 35, 36, 37, 38, 39, 40, 41, 43, 45, 51, 27, 27, 65, 43, 44, 44, 45, 45, 60,
-    71, 34, 29, 43, 69, 29, 43, 29, 44, 45, 66, 66, 64, 44, 71, 44, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72,
-    72, 72, 72, 72, 45, 65, 65, 43, 44, 29, 29, 45, 29, 49, 64, 45, 44, 44, 45, 65, 45, 65, 44, 46, 29, 43, 34, 45, 48,
-    64, 43, 44, 65, 45, 61, 29, 29, 64, 45, 48, 47, 73, 44, 65, 44, 46, 44, 48, 64, 43, 44, 34, 44, 61, 48, 65, 44, 43,
-    44, 45, 65, 65, 45, 44, 65, 34, 44, 43, 45, 48, 65, 76, 45, 45, 48, 75, 76, 65, 45, 44, 76, 48, 45};
-
-/* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-static const yytype_int8 yyr1[] = {0,  52, 53, 53, 53, 53, 53, 53, 53, 53, 55, 54, 56, 57, 57, 57, 57, 57, 57, 57,
-                                   57, 58, 58, 58, 59, 59, 60, 61, 61, 61, 61, 62, 62, 62, 62, 63, 63, 63, 63, 63,
-                                   64, 64, 65, 65, 65, 66, 66, 66, 66, 67, 67, 67, 67, 68, 68, 69, 69, 69, 69, 70,
-                                   70, 71, 71, 71, 71, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72,
-                                   72, 72, 72, 72, 72, 72, 72, 72, 72, 73, 73, 73, 74, 74, 75, 75, 76, 76};
-
-/* YYR2[YYN] -- Number of symbols on the right hand side of rule YYN.  */
-static const yytype_int8 yyr2[] = {0, 2, 1, 1, 1, 1, 4, 4, 3, 3, 0, 6, 1, 3, 4, 4,  10, 3, 1,  4, 3, 1, 2, 2, 1,
-                                   2, 3, 1, 2, 3, 4, 1, 5, 3, 7, 1, 6, 8, 5, 7, 1,  1,  1, 2,  2, 1, 3, 3, 3, 1,
-                                   1, 1, 1, 2, 3, 1, 5, 3, 7, 0, 2, 1, 3, 3, 2, 1,  1,  1, 1,  4, 3, 4, 3, 3, 3,
-                                   3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 3, 2, 2, 3, 1, 15, 17, 1, 15, 1, 3, 5, 7};
-
-#define yyerrok (yyerrstatus = 0)
-#define yyclearin (yychar = YYEMPTY)
-#define YYEMPTY (-2)
-#define YYEOF 0
-
-#define YYACCEPT goto yyacceptlab
-#define YYABORT goto yyabortlab
-#define YYERROR goto yyerrorlab
-
-#define YYRECOVERING() (!!yyerrstatus)
-
-#define YYBACKUP(Token, Value)                      \
-  do                                                \
-    if (yychar == YYEMPTY) {                        \
-      yychar = (Token);                             \
-      yylval = (Value);                             \
-      YYPOPSTACK(yylen);                            \
-      yystate = *yyssp;                             \
-      goto yybackup;                                \
-    } else {                                        \
-      yyerror(YY_("syntax error: cannot back up")); \
-      YYERROR;                                      \
-    }                                               \
+static const yytype_uint8 yytable[] =
+{
+      61,   128,    76,    18,    70,    66,    41,    17,   116,    80,
+      42,     1,   105,     2,     3,   179,    16,    56,   106,    81,
+      29,    43,    44,    45,    28,    46,   130,    57,    58,    51,
+       4,    47,    48,     5,    19,    30,   118,   198,    49,   109,
+      91,    77,   159,    92,    20,    71,   121,   126,   127,   115,
+      32,   119,    85,    59,    93,    94,    95,   185,    87,    88,
+      89,   122,    13,    14,   169,    56,    96,    97,    98,    99,
+     100,   101,   102,    34,   103,    57,    58,   174,   163,   170,
+      74,    34,    59,    75,    35,   172,    60,    37,   173,   182,
+     150,   153,   105,   151,    36,    37,    14,    68,   106,    38,
+     193,   132,   133,   134,   135,   136,   137,   138,   139,   140,
+     141,   142,   143,   144,   145,   146,   147,   148,    67,    52,
+      69,    82,    83,   101,   102,    56,   103,    41,    73,   164,
+      84,    42,   166,    86,    91,    57,    58,    92,   183,    90,
+      53,   184,    43,    44,    45,   177,    46,   104,    93,    94,
+      95,   213,    47,    48,   214,   189,    74,   107,   188,    49,
+      96,    97,    98,    99,   100,   101,   102,   114,   103,    56,
+     219,   131,   203,    74,   200,    91,   161,   105,    92,    57,
+      58,   108,   205,   106,   206,   213,    59,   209,   226,    93,
+      94,    95,   215,   110,    82,    83,   111,    61,   222,    91,
+     124,    96,    97,    98,    99,   100,   101,   102,    91,   103,
+     112,    92,   162,    93,    94,    95,    21,    22,    23,   113,
+      24,    25,    93,    94,    95,    96,    97,    98,    99,   100,
+     101,   102,   114,   103,    96,    97,    98,    99,   100,   101,
+     102,    41,   103,   117,   123,    42,    99,   100,   101,   102,
+     125,   103,   103,   149,   154,   152,    43,    44,    45,   155,
+      46,   157,   156,    93,    94,    95,    47,    48,   158,   160,
+     165,   167,   171,    49,   129,    96,    97,    98,    99,   100,
+     101,   102,   216,   103,   168,   176,   221,   175,   178,   180,
+     181,   187,   225,   191,   190,   194,   221,   195,   192,   196,
+     197,   201,   199,   202,   204,   210,    11,   186,   212,   207,
+     208,   211,   224,    59,   220,     0,   217,   218,   223,   227
+};
+
+static const yytype_int16 yycheck[] =
+{
+      20,    84,    37,     3,     5,    23,    12,    43,    68,    33,
+      16,     7,    46,     9,    10,   168,     0,    27,    52,    43,
+      29,    27,    28,    29,    29,    31,    86,    37,    38,    18,
+      26,    37,    38,    29,    34,    44,    29,   190,    44,    59,
+       8,    51,   125,    11,    44,    46,    29,    82,    83,    67,
+      29,    44,    41,    44,    22,    23,    24,    48,    47,    48,
+      49,    44,    47,    48,    29,    27,    34,    35,    36,    37,
+      38,    39,    40,    30,    42,    37,    38,   160,    46,    44,
+      46,    30,    44,    49,    33,    46,    48,    44,    49,   172,
+     110,    45,    46,   113,    43,    44,    48,    44,    52,    48,
+     183,    90,    91,    92,    93,    94,    95,    96,    97,    98,
+      99,   100,   101,   102,   103,   104,   105,   106,    46,     4,
+      29,    39,    40,    39,    40,    27,    42,    12,    50,   149,
+      48,    16,   152,    44,     8,    37,    38,    11,    46,    44,
+      25,    49,    27,    28,    29,   165,    31,    44,    22,    23,
+      24,    46,    37,    38,    49,    45,    46,    27,   178,    44,
+      34,    35,    36,    37,    38,    39,    40,    46,    42,    27,
+      49,    45,    45,    46,   194,     8,    45,    46,    11,    37,
+      38,    27,   202,    52,   204,    46,    44,   207,    49,    22,
+      23,    24,   212,    44,    39,    40,    45,   217,   218,     8,
+      45,    34,    35,    36,    37,    38,    39,    40,     8,    42,
+      45,    11,    45,    22,    23,    24,    13,    14,    15,    46,
+      17,    18,    22,    23,    24,    34,    35,    36,    37,    38,
+      39,    40,    46,    42,    34,    35,    36,    37,    38,    39,
+      40,    12,    42,    37,    29,    16,    37,    38,    39,    40,
+      46,    42,    42,    46,    29,    44,    27,    28,    29,    29,
+      31,    29,    46,    22,    23,    24,    37,    38,    50,    46,
+      46,    45,    37,    44,    45,    34,    35,    36,    37,    38,
+      39,    40,   213,    42,    47,    45,   217,    44,    46,    29,
+      29,    45,   223,    45,    47,    44,   227,    45,    49,    37,
+      45,    45,    49,    44,    46,    37,     0,   175,    44,    46,
+      45,    45,    45,    44,   217,    -1,    46,    46,    46,    46
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,     7,     9,    10,    26,    29,    54,    55,    57,    58,
+      59,    60,    56,    47,    48,    61,     0,    43,     3,    34,
+      44,    13,    14,    15,    17,    18,    68,    69,    29,    29,
+      44,    63,    29,    62,    30,    33,    43,    44,    48,    64,
+      67,    12,    16,    27,    28,    29,    31,    37,    38,    44,
+      60,    73,     4,    25,    72,    73,    27,    37,    38,    44,
+      48,    66,    74,    75,    76,    77,    61,    46,    44,    29,
+       5,    46,    71,    50,    46,    49,    67,    51,    65,    66,
+      33,    43,    39,    40,    48,    73,    44,    73,    73,    73,
+      44,     8,    11,    22,    23,    24,    34,    35,    36,    37,
+      38,    39,    40,    42,    44,    46,    52,    27,    27,    66,
+      44,    45,    45,    46,    46,    61,    72,    37,    29,    44,
+      70,    29,    44,    29,    45,    46,    67,    67,    65,    45,
+      72,    45,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    46,
+      66,    66,    44,    45,    29,    29,    46,    29,    50,    65,
+      46,    45,    45,    46,    66,    46,    66,    45,    47,    29,
+      44,    37,    46,    49,    65,    44,    45,    66,    46,    62,
+      29,    29,    65,    46,    49,    48,    74,    45,    66,    45,
+      47,    45,    49,    65,    44,    45,    37,    45,    62,    49,
+      66,    45,    44,    45,    46,    66,    66,    46,    45,    66,
+      37,    45,    44,    46,    49,    66,    77,    46,    46,    49,
+      76,    77,    66,    46,    45,    77,    49,    46
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    53,    54,    54,    54,    54,    54,    54,    54,    54,
+      56,    55,    57,    58,    58,    58,    58,    58,    58,    58,
+      58,    59,    59,    59,    60,    60,    61,    62,    62,    62,
+      62,    63,    63,    63,    63,    64,    64,    64,    64,    64,
+      65,    65,    66,    66,    66,    67,    67,    67,    67,    68,
+      68,    68,    68,    69,    69,    70,    70,    70,    70,    71,
+      71,    72,    72,    72,    72,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    73,
+      73,    73,    73,    73,    73,    73,    73,    73,    73,    74,
+      74,    74,    75,    75,    76,    76,    77,    77
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     1,     1,     1,     1,     4,     4,     3,     3,
+       0,     6,     1,     3,     4,     4,    10,     3,     1,     4,
+       3,     1,     2,     2,     1,     2,     3,     1,     2,     3,
+       4,     1,     5,     3,     7,     1,     6,     8,     5,     7,
+       1,     1,     1,     2,     2,     1,     3,     3,     3,     1,
+       1,     1,     1,     2,     3,     1,     5,     3,     7,     0,
+       2,     1,     3,     3,     2,     1,     1,     1,     1,     4,
+       3,     4,     3,     3,     3,     3,     3,     3,     3,     3,
+       3,     3,     3,     3,     2,     3,     2,     2,     3,     1,
+      15,    17,     1,    15,     1,     3,     5,     7
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (vp, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
   while (0)
 
-/* Error token number */
-#define YYTERROR 1
-#define YYERRCODE 256
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
 
 /* Enable debugging if requested.  */
 #if YYDEBUG
 
-#ifndef YYFPRINTF
-#include <stdio.h> /* INFRINGES ON USER NAME SPACE */
-#define YYFPRINTF fprintf
-#endif
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
 
-#define YYDPRINTF(Args) \
-  do {                  \
-    if (yydebug)        \
-      YYFPRINTF Args;   \
-  } while (0)
 
-/* This macro is provided for backward compatibility. */
-#ifndef YY_LOCATION_PRINT
-#define YY_LOCATION_PRINT(File, Loc) ((void)0)
-#endif
 
-#define YY_SYMBOL_PRINT(Title, Type, Value, Location) \
-  do {                                                \
-    if (yydebug) {                                    \
-      YYFPRINTF(stderr, "%s ", Title);                \
-      yy_symbol_print(stderr, Type, Value);           \
-      YYFPRINTF(stderr, "\n");                        \
-    }                                                 \
-  } while (0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, vp); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
 
 /*-----------------------------------.
 | Print this symbol's value on YYO.  |
 `-----------------------------------*/
 
-static void yy_symbol_value_print(FILE *yyo, int yytype, YYSTYPE const *const yyvaluep) {
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, VensimParse *vp)
+{
   FILE *yyoutput = yyo;
-  YYUSE(yyoutput);
+  YY_USE (yyoutput);
+  YY_USE (vp);
   if (!yyvaluep)
     return;
-#ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT(yyo, yytoknum[yytype], *yyvaluep);
-#endif
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE(yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
+
 /*---------------------------.
 | Print this symbol on YYO.  |
 `---------------------------*/
 
-static void yy_symbol_print(FILE *yyo, int yytype, YYSTYPE const *const yyvaluep) {
-  YYFPRINTF(yyo, "%s %s (", yytype < YYNTOKENS ? "token" : "nterm", yytname[yytype]);
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, VensimParse *vp)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print(yyo, yytype, yyvaluep);
-  YYFPRINTF(yyo, ")");
+  yy_symbol_value_print (yyo, yykind, yyvaluep, vp);
+  YYFPRINTF (yyo, ")");
 }
 
 /*------------------------------------------------------------------.
@@ -779,57 +925,69 @@ static void yy_symbol_print(FILE *yyo, int yytype, YYSTYPE const *const yyvaluep
 | TOP (included).                                                   |
 `------------------------------------------------------------------*/
 
-static void yy_stack_print(yy_state_t *yybottom, yy_state_t *yytop) {
-  YYFPRINTF(stderr, "Stack now");
-  for (; yybottom <= yytop; yybottom++) {
-    int yybot = *yybottom;
-    YYFPRINTF(stderr, " %d", yybot);
-  }
-  YYFPRINTF(stderr, "\n");
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
 }
 
-#define YY_STACK_PRINT(Bottom, Top)    \
-  do {                                 \
-    if (yydebug)                       \
-      yy_stack_print((Bottom), (Top)); \
-  } while (0)
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
 
 /*------------------------------------------------.
 | Report that the YYRULE is going to be reduced.  |
 `------------------------------------------------*/
 
-static void yy_reduce_print(yy_state_t *yyssp, YYSTYPE *yyvsp, int yyrule) {
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, VensimParse *vp)
+{
   int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
   int yyi;
-  YYFPRINTF(stderr, "Reducing stack by rule %d (line %d):\n", yyrule - 1, yylno);
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
   /* The symbols being reduced.  */
-  for (yyi = 0; yyi < yynrhs; yyi++) {
-    YYFPRINTF(stderr, "   $%d = ", yyi + 1);
-    yy_symbol_print(stderr, yystos[yyssp[yyi + 1 - yynrhs]], &yyvsp[(yyi + 1) - (yynrhs)]);
-    YYFPRINTF(stderr, "\n");
-  }
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], vp);
+      YYFPRINTF (stderr, "\n");
+    }
 }
 
-#define YY_REDUCE_PRINT(Rule)              \
-  do {                                     \
-    if (yydebug)                           \
-      yy_reduce_print(yyssp, yyvsp, Rule); \
-  } while (0)
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, vp); \
+} while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-#define YYDPRINTF(Args)
-#define YY_SYMBOL_PRINT(Title, Type, Value, Location)
-#define YY_STACK_PRINT(Bottom, Top)
-#define YY_REDUCE_PRINT(Rule)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
 
+
 /* YYINITDEPTH -- initial size of the parser's stacks.  */
 #ifndef YYINITDEPTH
-#define YYINITDEPTH 200
+# define YYINITDEPTH 200
 #endif
 
 /* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
@@ -840,302 +998,182 @@ int yydebug;
    evaluated with infinite-precision integer arithmetic.  */
 
 #ifndef YYMAXDEPTH
-#define YYMAXDEPTH 10000
-#endif
-
-#if YYERROR_VERBOSE
-
-#ifndef yystrlen
-#if defined __GLIBC__ && defined _STRING_H
-#define yystrlen(S) (YY_CAST(YYPTRDIFF_T, strlen(S)))
-#else
-/* Return the length of YYSTR.  */
-static YYPTRDIFF_T yystrlen(const char *yystr) {
-  YYPTRDIFF_T yylen;
-  for (yylen = 0; yystr[yylen]; yylen++)
-    continue;
-  return yylen;
-}
-#endif
+# define YYMAXDEPTH 10000
 #endif
+/* Parser data structure.  */
+struct yypstate
+  {
+    /* Number of syntax errors so far.  */
+    int yynerrs;
 
-#ifndef yystpcpy
-#if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#define yystpcpy stpcpy
-#else
-/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
-   YYDEST.  */
-static char *yystpcpy(char *yydest, const char *yysrc) {
-  char *yyd = yydest;
-  const char *yys = yysrc;
+    yy_state_fast_t yystate;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus;
 
-  while ((*yyd++ = *yys++) != '\0')
-    continue;
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
 
-  return yyd - 1;
-}
-#endif
-#endif
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize;
 
-#ifndef yytnamerr
-/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
-   quotes and backslashes, so that it's suitable for yyerror.  The
-   heuristic is that double-quoting is unnecessary unless the string
-   contains an apostrophe, a comma, or backslash (other than
-   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
-   null, do not copy; instead, return the length of what the result
-   would have been.  */
-static YYPTRDIFF_T yytnamerr(char *yyres, const char *yystr) {
-  if (*yystr == '"') {
-    YYPTRDIFF_T yyn = 0;
-    char const *yyp = yystr;
-
-    for (;;)
-      switch (*++yyp) {
-      case '\'':
-      case ',':
-        goto do_not_strip_quotes;
-
-      case '\\':
-        if (*++yyp != '\\')
-          goto do_not_strip_quotes;
-        else
-          goto append;
-
-      append:
-      default:
-        if (yyres)
-          yyres[yyn] = *yyp;
-        yyn++;
-        break;
-
-      case '"':
-        if (yyres)
-          yyres[yyn] = '\0';
-        return yyn;
-      }
-  do_not_strip_quotes:;
-  }
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss;
+    yy_state_t *yyssp;
 
-  if (yyres)
-    return yystpcpy(yyres, yystr) - yyres;
-  else
-    return yystrlen(yystr);
-}
-#endif
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs;
+    YYSTYPE *yyvsp;
+    /* Whether this instance has not started parsing yet.
+     * If 2, it corresponds to a finished parsing.  */
+    int yynew;
+  };
 
-/* Copy into *YYMSG, which is of size *YYMSG_ALLOC, an error message
-   about the unexpected token YYTOKEN for the state stack whose top is
-   YYSSP.
-
-   Return 0 if *YYMSG was successfully written.  Return 1 if *YYMSG is
-   not large enough to hold the message.  In that case, also set
-   *YYMSG_ALLOC to the required number of bytes.  Return 2 if the
-   required number of bytes is too large to store.  */
-static int yysyntax_error(YYPTRDIFF_T *yymsg_alloc, char **yymsg, yy_state_t *yyssp, int yytoken) {
-  enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-  /* Internationalized format string. */
-  const char *yyformat = YY_NULLPTR;
-  /* Arguments of yyformat: reported tokens (one for the "unexpected",
-     one per "expected"). */
-  char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-  /* Actual size of YYARG. */
-  int yycount = 0;
-  /* Cumulated lengths of YYARG.  */
-  YYPTRDIFF_T yysize = 0;
-
-  /* There are many possibilities here to consider:
-     - If this state is a consistent state with a default action, then
-       the only way this function was invoked is if the default action
-       is an error action.  In that case, don't check for expected
-       tokens because there are none.
-     - The only way there can be no lookahead present (in yychar) is if
-       this state is a consistent state with a default action.  Thus,
-       detecting the absence of a lookahead is sufficient to determine
-       that there is no unexpected or expected token to report.  In that
-       case, just report a simple "syntax error".
-     - Don't assume there isn't a lookahead just because this state is a
-       consistent state with a default action.  There might have been a
-       previous inconsistent state, consistent state with a non-default
-       action, or user semantic action that manipulated yychar.
-     - Of course, the expected token list depends on states to have
-       correct lookahead information, and it depends on the parser not
-       to perform extra reductions after fetching a lookahead from the
-       scanner and before detecting a syntax error.  Thus, state merging
-       (from LALR or IELR) and default reductions corrupt the expected
-       token list.  However, the list is correct for canonical LR with
-       one exception: it will still contain any token that will not be
-       accepted due to an error action in a later state.
-  */
-  if (yytoken != YYEMPTY) {
-    int yyn = yypact[*yyssp];
-    YYPTRDIFF_T yysize0 = yytnamerr(YY_NULLPTR, yytname[yytoken]);
-    yysize = yysize0;
-    yyarg[yycount++] = yytname[yytoken];
-    if (!yypact_value_is_default(yyn)) {
-      /* Start YYX at -YYN if negative to avoid negative indexes in
-         YYCHECK.  In other words, skip the first -YYN actions for
-         this state because they are default actions.  */
-      int yyxbegin = yyn < 0 ? -yyn : 0;
-      /* Stay within bounds of both yycheck and yytname.  */
-      int yychecklim = YYLAST - yyn + 1;
-      int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-      int yyx;
-
-      for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-        if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR && !yytable_value_is_error(yytable[yyx + yyn])) {
-          if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM) {
-            yycount = 1;
-            yysize = yysize0;
-            break;
-          }
-          yyarg[yycount++] = yytname[yyx];
-          {
-            YYPTRDIFF_T yysize1 = yysize + yytnamerr(YY_NULLPTR, yytname[yyx]);
-            if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-              yysize = yysize1;
-            else
-              return 2;
-          }
-        }
-    }
-  }
 
-  switch (yycount) {
-#define YYCASE_(N, S) \
-  case N:             \
-    yyformat = S;     \
-    break
-  default: /* Avoid compiler warnings. */
-    YYCASE_(0, YY_("syntax error"));
-    YYCASE_(1, YY_("syntax error, unexpected %s"));
-    YYCASE_(2, YY_("syntax error, unexpected %s, expecting %s"));
-    YYCASE_(3, YY_("syntax error, unexpected %s, expecting %s or %s"));
-    YYCASE_(4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
-    YYCASE_(5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
-#undef YYCASE_
-  }
 
-  {
-    /* Don't count the "%s"s in the final size, but reserve room for
-       the terminator.  */
-    YYPTRDIFF_T yysize1 = yysize + (yystrlen(yyformat) - 2 * yycount) + 1;
-    if (yysize <= yysize1 && yysize1 <= YYSTACK_ALLOC_MAXIMUM)
-      yysize = yysize1;
-    else
-      return 2;
-  }
 
-  if (*yymsg_alloc < yysize) {
-    *yymsg_alloc = 2 * yysize;
-    if (!(yysize <= *yymsg_alloc && *yymsg_alloc <= YYSTACK_ALLOC_MAXIMUM))
-      *yymsg_alloc = YYSTACK_ALLOC_MAXIMUM;
-    return 1;
-  }
 
-  /* Avoid sprintf, as that infringes on the user's name space.
-     Don't have undefined behavior even if the translation
-     produced a string with the wrong number of "%s"s.  */
-  {
-    char *yyp = *yymsg;
-    int yyi = 0;
-    while ((*yyp = *yyformat) != '\0')
-      if (*yyp == '%' && yyformat[1] == 's' && yyi < yycount) {
-        yyp += yytnamerr(yyp, yyarg[yyi++]);
-        yyformat += 2;
-      } else {
-        ++yyp;
-        ++yyformat;
-      }
-  }
-  return 0;
-}
-#endif /* YYERROR_VERBOSE */
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
-static void yydestruct(const char *yymsg, int yytype, YYSTYPE *yyvaluep) {
-  YYUSE(yyvaluep);
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, VensimParse *vp)
+{
+  YY_USE (yyvaluep);
+  YY_USE (vp);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT(yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
-  YYUSE(yytype);
+  YY_USE (yykind);
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
-/* The lookahead symbol.  */
-int yychar;
 
-/* The semantic value of the lookahead symbol.  */
-YYSTYPE yylval;
-/* Number of syntax errors so far.  */
-int yynerrs;
 
-/*----------.
-| yyparse.  |
-`----------*/
 
-int yyparse(void) {
-  yy_state_fast_t yystate;
-  /* Number of tokens to shift before error messages enabled.  */
-  int yyerrstatus;
 
-  /* The stacks and their tools:
-     'yyss': related to states.
-     'yyvs': related to semantic values.
+#define vpyynerrs yyps->vpyynerrs
+#define yystate yyps->yystate
+#define yyerrstatus yyps->yyerrstatus
+#define yyssa yyps->yyssa
+#define yyss yyps->yyss
+#define yyssp yyps->yyssp
+#define yyvsa yyps->yyvsa
+#define yyvs yyps->yyvs
+#define yyvsp yyps->yyvsp
+#define yystacksize yyps->yystacksize
+
+/* Initialize the parser data structure.  */
+static void
+yypstate_clear (yypstate *yyps)
+{
+  yynerrs = 0;
+  yystate = 0;
+  yyerrstatus = 0;
+
+  yyssp = yyss;
+  yyvsp = yyvs;
+
+  /* Initialize the state stack, in case yypcontext_expected_tokens is
+     called before the first call to yyparse. */
+  *yyssp = 0;
+  yyps->yynew = 1;
+}
+
+/* Initialize the parser data structure.  */
+yypstate *
+yypstate_new (void)
+{
+  yypstate *yyps;
+  yyps = YY_CAST (yypstate *, YYMALLOC (sizeof *yyps));
+  if (!yyps)
+    return YY_NULLPTR;
+  yystacksize = YYINITDEPTH;
+  yyss = yyssa;
+  yyvs = yyvsa;
+  yypstate_clear (yyps);
+  return yyps;
+}
+
+void
+yypstate_delete (yypstate *yyps)
+{
+  if (yyps)
+    {
+#ifndef yyoverflow
+      /* If the stack was reallocated but the parse did not complete, then the
+         stack still needs to be freed.  */
+      if (yyss != yyssa)
+        YYSTACK_FREE (yyss);
+#endif
+      YYFREE (yyps);
+    }
+}
+
+
 
-     Refer to the stacks through separate pointers, to allow yyoverflow
-     to reallocate them elsewhere.  */
+/*---------------.
+| yypush_parse.  |
+`---------------*/
 
-  /* The state stack.  */
-  yy_state_t yyssa[YYINITDEPTH];
-  yy_state_t *yyss;
-  yy_state_t *yyssp;
+int
+yypush_parse (yypstate *yyps,
+              int yypushed_char, YYSTYPE const *yypushed_val, VensimParse *vp)
+{
+/* Lookahead token kind.  */
+int yychar;
 
-  /* The semantic value stack.  */
-  YYSTYPE yyvsa[YYINITDEPTH];
-  YYSTYPE *yyvs;
-  YYSTYPE *yyvsp;
 
-  YYPTRDIFF_T yystacksize;
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
 
   int yyn;
+  /* The return value of yyparse.  */
   int yyresult;
-  /* Lookahead token as an internal (translated) token number.  */
-  int yytoken = 0;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
-#if YYERROR_VERBOSE
-  /* Buffer for error messages, and its allocated size.  */
-  char yymsgbuf[128];
-  char *yymsg = yymsgbuf;
-  YYPTRDIFF_T yymsg_alloc = sizeof yymsgbuf;
-#endif
 
-#define YYPOPSTACK(N) (yyvsp -= (N), yyssp -= (N))
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
 
   /* The number of symbols on the RHS of the reduced rule.
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
-  yyssp = yyss = yyssa;
-  yyvsp = yyvs = yyvsa;
-  yystacksize = YYINITDEPTH;
+  switch (yyps->yynew)
+    {
+    case 0:
+      yyn = yypact[yystate];
+      goto yyread_pushed_token;
 
-  YYDPRINTF((stderr, "Starting parse\n"));
+    case 2:
+      yypstate_clear (yyps);
+      break;
+
+    default:
+      break;
+    }
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
   yychar = YYEMPTY; /* Cause a token to be read.  */
+
   goto yysetstate;
 
+
 /*------------------------------------------------------------.
 | yynewstate -- push a new state, which is found in yystate.  |
 `------------------------------------------------------------*/
@@ -1144,79 +1182,88 @@ yynewstate:
      have just been pushed.  So pushing a state here evens the stacks.  */
   yyssp++;
 
+
 /*--------------------------------------------------------------------.
 | yysetstate -- set current state (the top of the stack) to yystate.  |
 `--------------------------------------------------------------------*/
 yysetstate:
-  YYDPRINTF((stderr, "Entering state %d\n", yystate));
-  YY_ASSERT(0 <= yystate && yystate < YYNSTATES);
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
   YY_IGNORE_USELESS_CAST_BEGIN
-  *yyssp = YY_CAST(yy_state_t, yystate);
+  *yyssp = YY_CAST (yy_state_t, yystate);
   YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
 #if !defined yyoverflow && !defined YYSTACK_RELOCATE
-    goto yyexhaustedlab;
+    YYNOMEM;
 #else
-  {
-    /* Get the current used size of the three stacks, in elements.  */
-    YYPTRDIFF_T yysize = yyssp - yyss + 1;
-
-#if defined yyoverflow
-    {
-      /* Give user a chance to reallocate the stack.  Use copies of
-         these so that the &'s don't force the real ones into
-         memory.  */
-      yy_state_t *yyss1 = yyss;
-      YYSTYPE *yyvs1 = yyvs;
-
-      /* Each stack pointer address is followed by the size of the
-         data in use in that stack, in bytes.  This used to be a
-         conditional around just the two extra args, but that might
-         be undefined if yyoverflow is a macro.  */
-      yyoverflow(YY_("memory exhausted"), &yyss1, yysize * YYSIZEOF(*yyssp), &yyvs1, yysize * YYSIZEOF(*yyvsp),
-                 &yystacksize);
-      yyss = yyss1;
-      yyvs = yyvs1;
-    }
-#else /* defined YYSTACK_RELOCATE */
-    /* Extend the stack our own way.  */
-    if (YYMAXDEPTH <= yystacksize)
-      goto yyexhaustedlab;
-    yystacksize *= 2;
-    if (YYMAXDEPTH < yystacksize)
-      yystacksize = YYMAXDEPTH;
-
     {
-      yy_state_t *yyss1 = yyss;
-      union yyalloc *yyptr = YY_CAST(union yyalloc *, YYSTACK_ALLOC(YY_CAST(YYSIZE_T, YYSTACK_BYTES(yystacksize))));
-      if (!yyptr)
-        goto yyexhaustedlab;
-      YYSTACK_RELOCATE(yyss_alloc, yyss);
-      YYSTACK_RELOCATE(yyvs_alloc, yyvs);
-#undef YYSTACK_RELOCATE
-      if (yyss1 != yyssa)
-        YYSTACK_FREE(yyss1);
-    }
-#endif
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
 
-    yyssp = yyss + yysize - 1;
-    yyvsp = yyvs + yysize - 1;
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
 
-    YY_IGNORE_USELESS_CAST_BEGIN
-    YYDPRINTF((stderr, "Stack size increased to %ld\n", YY_CAST(long, yystacksize)));
-    YY_IGNORE_USELESS_CAST_END
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
 
-    if (yyss + yystacksize - 1 <= yyssp)
-      YYABORT;
-  }
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
 #endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
+
   if (yystate == YYFINAL)
     YYACCEPT;
 
   goto yybackup;
 
+
 /*-----------.
 | yybackup.  |
 `-----------*/
@@ -1226,24 +1273,49 @@ yybackup:
 
   /* First try to decide what to do without reference to lookahead token.  */
   yyn = yypact[yystate];
-  if (yypact_value_is_default(yyn))
+  if (yypact_value_is_default (yyn))
     goto yydefault;
 
   /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid lookahead symbol.  */
-  if (yychar == YYEMPTY) {
-    YYDPRINTF((stderr, "Reading a token: "));
-    yychar = yylex();
-  }
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      if (!yyps->yynew)
+        {
+          YYDPRINTF ((stderr, "Return for a new token:\n"));
+          yyresult = YYPUSH_MORE;
+          goto yypushreturn;
+        }
+      yyps->yynew = 0;
+yyread_pushed_token:
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yypushed_char;
+      if (yypushed_val)
+        yylval = *yypushed_val;
+    }
 
-  if (yychar <= YYEOF) {
-    yychar = yytoken = YYEOF;
-    YYDPRINTF((stderr, "Now at end of input.\n"));
-  } else {
-    yytoken = YYTRANSLATE(yychar);
-    YY_SYMBOL_PRINT("Next token is", yytoken, &yylval, &yylloc);
-  }
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
 
   /* If the proper action on seeing token YYTOKEN is to reduce or to
      detect an error, take that action.  */
@@ -1251,12 +1323,13 @@ yybackup:
   if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
     goto yydefault;
   yyn = yytable[yyn];
-  if (yyn <= 0) {
-    if (yytable_value_is_error(yyn))
-      goto yyerrlab;
-    yyn = -yyn;
-    goto yyreduce;
-  }
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
 
   /* Count tokens shifted since error; after three, turn off error
      status.  */
@@ -1264,7 +1337,7 @@ yybackup:
     yyerrstatus--;
 
   /* Shift the lookahead token.  */
-  YY_SYMBOL_PRINT("Shifting", yytoken, &yylval, &yylloc);
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
   yystate = yyn;
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
@@ -1274,6 +1347,7 @@ yybackup:
   yychar = YYEMPTY;
   goto yynewstate;
 
+
 /*-----------------------------------------------------------.
 | yydefault -- do the default action for the current state.  |
 `-----------------------------------------------------------*/
@@ -1283,6 +1357,7 @@ yydefault:
     goto yyerrlab;
   goto yyreduce;
 
+
 /*-----------------------------.
 | yyreduce -- do a reduction.  |
 `-----------------------------*/
@@ -1298,790 +1373,593 @@ yyreduce:
      users should not rely upon it.  Assigning to YYVAL
      unconditionally makes the parser a bit smaller, and it avoids a
      GCC warning that YYVAL may be used uninitialized.  */
-  yyval = yyvsp[1 - yylen];
-
-  YY_REDUCE_PRINT(yyn);
-  switch (yyn) {
-  case 2:
-#line 83 "VYacc.y"
-  {
-    return VPTT_eqend;
-  }
-#line 1500 "VYacc.tab.cpp"
-  break;
-
-  case 3:
-#line 84 "VYacc.y"
-  {
-    return VPTT_groupstar;
-  }
-#line 1506 "VYacc.tab.cpp"
-  break;
-
-  case 4:
-#line 85 "VYacc.y"
-  {
-    return '|';
-  }
-#line 1512 "VYacc.tab.cpp"
-  break;
-
-  case 5:
-#line 86 "VYacc.y"
-  {
-    return '|';
-  }
-#line 1518 "VYacc.tab.cpp"
-  break;
-
-  case 6:
-#line 87 "VYacc.y"
-  {
-    vpyy_addfulleq((yyvsp[-3].eqn), (yyvsp[-1].uni));
-    return '~';
-  }
-#line 1524 "VYacc.tab.cpp"
-  break;
-
-  case 7:
-#line 88 "VYacc.y"
-  {
-    vpyy_addfulleq((yyvsp[-3].eqn), (yyvsp[-1].uni));
-    return '|';
-  }
-#line 1530 "VYacc.tab.cpp"
-  break;
+  yyval = yyvsp[1-yylen];
 
-  case 8:
-#line 89 "VYacc.y"
-  {
-    vpyy_addfulleq((yyvsp[-2].eqn), NULL);
-    return '~';
-  }
-#line 1536 "VYacc.tab.cpp"
-  break;
 
-  case 9:
-#line 90 "VYacc.y"
-  {
-    vpyy_addfulleq((yyvsp[-2].eqn), NULL);
-    return '|';
-  }
-#line 1542 "VYacc.tab.cpp"
-  break;
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 2: /* fulleq: VPTT_eqend  */
+#line 101 "VYacc.y"
+                   { vpyy_equation_end(vp,VPTT_eqend) ; YYACCEPT ; }
+#line 1386 "VYacc.tab.cpp"
+    break;
 
-  case 10:
-#line 94 "VYacc.y"
-  {
-    vpyy_macro_start();
-  }
-#line 1548 "VYacc.tab.cpp"
-  break;
+  case 3: /* fulleq: VPTT_groupstar  */
+#line 102 "VYacc.y"
+                         { vpyy_equation_end(vp,VPTT_groupstar) ; YYACCEPT ; }
+#line 1392 "VYacc.tab.cpp"
+    break;
 
-  case 11:
-#line 94 "VYacc.y"
-  {
-    vpyy_macro_expression((yyvsp[-3].sym), (yyvsp[-1].exl));
-  }
-#line 1554 "VYacc.tab.cpp"
-  break;
+  case 4: /* fulleq: macrostart  */
+#line 103 "VYacc.y"
+                                  { vpyy_equation_end(vp,'|') ; YYACCEPT ; }
+#line 1398 "VYacc.tab.cpp"
+    break;
 
-  case 12:
-#line 98 "VYacc.y"
-  {
-    (yyval.tok) = (yyvsp[0].tok);
-    vpyy_macro_end();
-  }
-#line 1560 "VYacc.tab.cpp"
-  break;
+  case 5: /* fulleq: macroend  */
+#line 104 "VYacc.y"
+                                          { vpyy_equation_end(vp,'|') ; YYACCEPT ; }
+#line 1404 "VYacc.tab.cpp"
+    break;
 
-  case 13:
+  case 6: /* fulleq: eqn '~' unitsrange '~'  */
 #line 105 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_addeq((yyvsp[-2].lhs), NULL, (yyvsp[0].exl), '=');
-  }
-#line 1566 "VYacc.tab.cpp"
-  break;
+                                                      {vpyy_addfulleq(vp,(yyvsp[-3].eqn),(yyvsp[-1].uni)) ; vpyy_equation_end(vp,'~') ; YYACCEPT ; }
+#line 1410 "VYacc.tab.cpp"
+    break;
 
-  case 14:
+  case 7: /* fulleq: eqn '~' unitsrange '|'  */
 #line 106 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_add_lookup((yyvsp[-3].lhs), NULL, (yyvsp[-1].tbl), 0);
-  }
-#line 1572 "VYacc.tab.cpp"
-  break;
+                                                       {vpyy_addfulleq(vp,(yyvsp[-3].eqn),(yyvsp[-1].uni)) ; vpyy_equation_end(vp,'|') ; YYACCEPT ; }
+#line 1416 "VYacc.tab.cpp"
+    break;
 
-  case 15:
+  case 8: /* fulleq: eqn '~' '~'  */
 #line 107 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_add_lookup((yyvsp[-3].lhs), NULL, (yyvsp[-1].tbl), 1);
-  }
-#line 1578 "VYacc.tab.cpp"
-  break;
+                                         {vpyy_addfulleq(vp,(yyvsp[-2].eqn),NULL) ; vpyy_equation_end(vp,'~') ; YYACCEPT ;}
+#line 1422 "VYacc.tab.cpp"
+    break;
 
-  case 16:
+  case 9: /* fulleq: eqn '~' '|'  */
 #line 108 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_add_lookup((yyvsp[-9].lhs), (yyvsp[-5].exn), (yyvsp[-2].tbl), 0);
-  }
+                                                   {vpyy_addfulleq(vp,(yyvsp[-2].eqn),NULL) ; vpyy_equation_end(vp,'|') ; YYACCEPT ;}
+#line 1428 "VYacc.tab.cpp"
+    break;
+
+  case 10: /* $@1: %empty  */
+#line 112 "VYacc.y"
+                   { vpyy_macro_start(vp); }
+#line 1434 "VYacc.tab.cpp"
+    break;
+
+  case 11: /* macrostart: VPTT_macro $@1 VPTT_symbol '(' exprlist ')'  */
+#line 112 "VYacc.y"
+                                                                            { vpyy_macro_expression(vp,(yyvsp[-3].sym),(yyvsp[-1].exl)) ;}
+#line 1440 "VYacc.tab.cpp"
+    break;
+
+  case 12: /* macroend: VPTT_end_of_macro  */
+#line 116 "VYacc.y"
+                     { (yyval.tok) = (yyvsp[0].tok); vpyy_macro_end(vp); }
+#line 1446 "VYacc.tab.cpp"
+    break;
+
+  case 13: /* eqn: lhs '=' exprlist  */
+#line 123 "VYacc.y"
+                    {(yyval.eqn) = vpyy_addeq(vp,(yyvsp[-2].lhs),NULL,(yyvsp[0].exl),'=') ; if (!(yyval.eqn)) YYABORT ; }
+#line 1452 "VYacc.tab.cpp"
+    break;
+
+  case 14: /* eqn: lhs '(' tablevals ')'  */
+#line 124 "VYacc.y"
+                           { (yyval.eqn) = vpyy_add_lookup(vp,(yyvsp[-3].lhs),NULL,(yyvsp[-1].tbl), 0) ; }
+#line 1458 "VYacc.tab.cpp"
+    break;
+
+  case 15: /* eqn: lhs '(' xytablevals ')'  */
+#line 125 "VYacc.y"
+                             { (yyval.eqn) = vpyy_add_lookup(vp,(yyvsp[-3].lhs),NULL,(yyvsp[-1].tbl), 1) ; }
+#line 1464 "VYacc.tab.cpp"
+    break;
+
+  case 16: /* eqn: lhs '=' VPTT_with_lookup '(' exp ',' '(' tablevals ')' ')'  */
+#line 126 "VYacc.y"
+                                                                { (yyval.eqn) = vpyy_add_lookup(vp,(yyvsp[-9].lhs),(yyvsp[-5].exn),(yyvsp[-2].tbl), 0) ; }
+#line 1470 "VYacc.tab.cpp"
+    break;
+
+  case 17: /* eqn: lhs VPTT_dataequals exp  */
+#line 127 "VYacc.y"
+                             {(yyval.eqn) = vpyy_addeq(vp,(yyvsp[-2].lhs),(yyvsp[0].exn),NULL,VPTT_dataequals) ; if (!(yyval.eqn)) YYABORT ; }
+#line 1476 "VYacc.tab.cpp"
+    break;
+
+  case 18: /* eqn: lhs  */
+#line 128 "VYacc.y"
+         { (yyval.eqn) = vpyy_add_lookup(vp,(yyvsp[0].lhs),NULL,NULL, 0) ; }
+#line 1482 "VYacc.tab.cpp"
+    break;
+
+  case 19: /* eqn: VPTT_symbol ':' subdef maplist  */
+#line 129 "VYacc.y"
+                                    {(yyval.eqn) = vpyy_addeq(vp,vpyy_addexceptinterp(vp,vpyy_var_expression(vp,(yyvsp[-3].sym),NULL),NULL,0),(Expression *)vpyy_symlist_expression(vp,(yyvsp[-1].sml),(yyvsp[0].sml)),NULL,':') ; if (!(yyval.eqn)) YYABORT ; }
+#line 1488 "VYacc.tab.cpp"
+    break;
+
+  case 20: /* eqn: lhs '=' VPTT_tabbed_array  */
+#line 130 "VYacc.y"
+                               { (yyval.eqn) = vpyy_addeq(vp,(yyvsp[-2].lhs),(yyvsp[0].exn),NULL,'=') ; if (!(yyval.eqn)) YYABORT ; }
+#line 1494 "VYacc.tab.cpp"
+    break;
+
+  case 21: /* lhs: var  */
+#line 135 "VYacc.y"
+        { (yyval.lhs) = vpyy_addexceptinterp(vp,(yyvsp[0].var),NULL,0) ; }
+#line 1500 "VYacc.tab.cpp"
+    break;
+
+  case 22: /* lhs: var exceptlist  */
+#line 136 "VYacc.y"
+                     {(yyval.lhs) = vpyy_addexceptinterp(vp,(yyvsp[-1].var),(yyvsp[0].sll),0) ;}
+#line 1506 "VYacc.tab.cpp"
+    break;
+
+  case 23: /* lhs: var interpmode  */
+#line 137 "VYacc.y"
+                    {(yyval.lhs) = vpyy_addexceptinterp(vp,(yyvsp[-1].var),NULL,(yyvsp[0].tok)) ;}
+#line 1512 "VYacc.tab.cpp"
+    break;
+
+  case 24: /* var: VPTT_symbol  */
+#line 141 "VYacc.y"
+                    { (yyval.var) = vpyy_var_expression(vp,(yyvsp[0].sym),NULL);}
+#line 1518 "VYacc.tab.cpp"
+    break;
+
+  case 25: /* var: VPTT_symbol sublist  */
+#line 142 "VYacc.y"
+                              { (yyval.var) = vpyy_var_expression(vp,(yyvsp[-1].sym),(yyvsp[0].sml)) ;}
+#line 1524 "VYacc.tab.cpp"
+    break;
+
+  case 26: /* sublist: '[' symlist ']'  */
+#line 146 "VYacc.y"
+                        {(yyval.sml) = (yyvsp[-1].sml) ;}
+#line 1530 "VYacc.tab.cpp"
+    break;
+
+  case 27: /* symlist: VPTT_symbol  */
+#line 150 "VYacc.y"
+                    { (yyval.sml) = vpyy_symlist(vp,NULL,(yyvsp[0].sym),0,NULL) ; if (!(yyval.sml)) YYABORT ; }
+#line 1536 "VYacc.tab.cpp"
+    break;
+
+  case 28: /* symlist: VPTT_symbol '!'  */
+#line 151 "VYacc.y"
+                          { (yyval.sml) = vpyy_symlist(vp,NULL,(yyvsp[-1].sym),1,NULL) ; if (!(yyval.sml)) YYABORT ; }
+#line 1542 "VYacc.tab.cpp"
+    break;
+
+  case 29: /* symlist: symlist ',' VPTT_symbol  */
+#line 152 "VYacc.y"
+                                  { (yyval.sml) = vpyy_symlist(vp,(yyvsp[-2].sml),(yyvsp[0].sym),0,NULL) ; if (!(yyval.sml)) YYABORT ; }
+#line 1548 "VYacc.tab.cpp"
+    break;
+
+  case 30: /* symlist: symlist ',' VPTT_symbol '!'  */
+#line 153 "VYacc.y"
+                                      { (yyval.sml) = vpyy_symlist(vp,(yyvsp[-3].sml),(yyvsp[-1].sym),1,NULL) ; if (!(yyval.sml)) YYABORT ; }
+#line 1554 "VYacc.tab.cpp"
+    break;
+
+  case 31: /* subdef: VPTT_symbol  */
+#line 156 "VYacc.y"
+                    { (yyval.sml) = vpyy_symlist(vp,NULL,(yyvsp[0].sym),0,NULL) ; if (!(yyval.sml)) YYABORT ; }
+#line 1560 "VYacc.tab.cpp"
+    break;
+
+  case 32: /* subdef: '(' VPTT_symbol '-' VPTT_symbol ')'  */
+#line 157 "VYacc.y"
+                                              {(yyval.sml) = vpyy_symlist(vp,NULL,(yyvsp[-3].sym),0,(yyvsp[-1].sym)) ; if (!(yyval.sml)) YYABORT ; }
+#line 1566 "VYacc.tab.cpp"
+    break;
+
+  case 33: /* subdef: subdef ',' VPTT_symbol  */
+#line 158 "VYacc.y"
+                                 { (yyval.sml) = vpyy_symlist(vp,(yyvsp[-2].sml),(yyvsp[0].sym),0,NULL) ; if (!(yyval.sml)) YYABORT ; }
+#line 1572 "VYacc.tab.cpp"
+    break;
+
+  case 34: /* subdef: subdef ',' '(' VPTT_symbol '-' VPTT_symbol ')'  */
+#line 159 "VYacc.y"
+                                                         {(yyval.sml) = vpyy_symlist(vp,(yyvsp[-6].sml),(yyvsp[-3].sym),0,(yyvsp[-1].sym)) ; if (!(yyval.sml)) YYABORT ; }
+#line 1578 "VYacc.tab.cpp"
+    break;
+
+  case 35: /* unitsrange: units  */
+#line 163 "VYacc.y"
+              { (yyval.uni) = (yyvsp[0].uni) ; }
 #line 1584 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 17:
-#line 109 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_addeq((yyvsp[-2].lhs), (yyvsp[0].exn), NULL, VPTT_dataequals);
-  }
+  case 36: /* unitsrange: units '[' urangenum ',' urangenum ']'  */
+#line 164 "VYacc.y"
+                                                { (yyval.uni) = vpyy_unitsrange(vp,(yyvsp[-5].uni),(yyvsp[-3].num),(yyvsp[-1].num),-1) ; }
 #line 1590 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 18:
-#line 110 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_add_lookup((yyvsp[0].lhs), NULL, NULL, 0);
-  }
+  case 37: /* unitsrange: units '[' urangenum ',' urangenum ',' urangenum ']'  */
+#line 165 "VYacc.y"
+                                                              { (yyval.uni) = vpyy_unitsrange(vp,(yyvsp[-7].uni),(yyvsp[-5].num),(yyvsp[-3].num),(yyvsp[-1].num)) ; }
 #line 1596 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 19:
-#line 111 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_addeq(vpyy_addexceptinterp(vpyy_var_expression((yyvsp[-3].sym), NULL), NULL, 0),
-                             (Expression *)vpyy_symlist_expression((yyvsp[-1].sml), (yyvsp[0].sml)), NULL, ':');
-  }
+  case 38: /* unitsrange: '[' urangenum ',' urangenum ']'  */
+#line 166 "VYacc.y"
+                                          { (yyval.uni) = vpyy_unitsrange(vp,NULL,(yyvsp[-3].num),(yyvsp[-1].num),-1) ; }
 #line 1602 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 20:
-#line 112 "VYacc.y"
-  {
-    (yyval.eqn) = vpyy_addeq((yyvsp[-2].lhs), (yyvsp[0].exn), NULL, '=');
-  }
+  case 39: /* unitsrange: '[' urangenum ',' urangenum ',' urangenum ']'  */
+#line 167 "VYacc.y"
+                                                        { (yyval.uni) = vpyy_unitsrange(vp,NULL,(yyvsp[-5].num),(yyvsp[-3].num),(yyvsp[-1].num)) ; }
 #line 1608 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 21:
-#line 117 "VYacc.y"
-  {
-    (yyval.lhs) = vpyy_addexceptinterp((yyvsp[0].var), NULL, 0);
-  }
+  case 40: /* urangenum: number  */
+#line 171 "VYacc.y"
+               {(yyval.num) = (yyvsp[0].num) ; }
 #line 1614 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 22:
-#line 118 "VYacc.y"
-  {
-    (yyval.lhs) = vpyy_addexceptinterp((yyvsp[-1].var), (yyvsp[0].sll), 0);
-  }
+  case 41: /* urangenum: '?'  */
+#line 172 "VYacc.y"
+              {(yyval.num) = -1e30 ; }
 #line 1620 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 23:
-#line 119 "VYacc.y"
-  {
-    (yyval.lhs) = vpyy_addexceptinterp((yyvsp[-1].var), NULL, (yyvsp[0].tok));
-  }
+  case 42: /* number: VPTT_number  */
+#line 175 "VYacc.y"
+                    {(yyval.num) = (yyvsp[0].num) ; }
 #line 1626 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 24:
-#line 123 "VYacc.y"
-  {
-    (yyval.var) = vpyy_var_expression((yyvsp[0].sym), NULL);
-  }
+  case 43: /* number: '-' VPTT_number  */
+#line 176 "VYacc.y"
+                          {(yyval.num) = -(yyvsp[0].num) ;}
 #line 1632 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 25:
-#line 124 "VYacc.y"
-  {
-    (yyval.var) = vpyy_var_expression((yyvsp[-1].sym), (yyvsp[0].sml));
-  }
+  case 44: /* number: '+' VPTT_number  */
+#line 177 "VYacc.y"
+                          {(yyval.num) = (yyvsp[0].num) ;}
 #line 1638 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 26:
-#line 128 "VYacc.y"
-  {
-    (yyval.sml) = (yyvsp[-1].sml);
-  }
+  case 45: /* units: VPTT_units_symbol  */
+#line 181 "VYacc.y"
+                          { (yyval.uni) = (yyvsp[0].uni) ; }
 #line 1644 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 27:
-#line 132 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist(NULL, (yyvsp[0].sym), 0, NULL);
-  }
+  case 46: /* units: units '/' units  */
+#line 182 "VYacc.y"
+                          {(yyval.uni) = vpyy_unitsdiv(vp,(yyvsp[-2].uni),(yyvsp[0].uni));}
 #line 1650 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 28:
-#line 133 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist(NULL, (yyvsp[-1].sym), 1, NULL);
-  }
+  case 47: /* units: units '*' units  */
+#line 183 "VYacc.y"
+                          {(yyval.uni) = vpyy_unitsmult(vp,(yyvsp[-2].uni),(yyvsp[0].uni));}
 #line 1656 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 29:
-#line 134 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist((yyvsp[-2].sml), (yyvsp[0].sym), 0, NULL);
-  }
+  case 48: /* units: '(' units ')'  */
+#line 184 "VYacc.y"
+                        { (yyval.uni) = (yyvsp[-1].uni) ; }
 #line 1662 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 30:
-#line 135 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist((yyvsp[-3].sml), (yyvsp[-1].sym), 1, NULL);
-  }
+  case 49: /* interpmode: VPTT_interpolate  */
+#line 189 "VYacc.y"
+                     { (yyval.tok) = (yyvsp[0].tok) ; }
 #line 1668 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 31:
-#line 138 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist(NULL, (yyvsp[0].sym), 0, NULL);
-  }
+  case 50: /* interpmode: VPTT_raw  */
+#line 190 "VYacc.y"
+                   { (yyval.tok) = (yyvsp[0].tok) ; }
 #line 1674 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 32:
-#line 139 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist(NULL, (yyvsp[-3].sym), 0, (yyvsp[-1].sym));
-  }
+  case 51: /* interpmode: VPTT_hold_backward  */
+#line 191 "VYacc.y"
+                             { (yyval.tok) = (yyvsp[0].tok) ; }
 #line 1680 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 33:
-#line 140 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist((yyvsp[-2].sml), (yyvsp[0].sym), 0, NULL);
-  }
+  case 52: /* interpmode: VPTT_look_forward  */
+#line 192 "VYacc.y"
+                            { (yyval.tok) = (yyvsp[0].tok) ; }
 #line 1686 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 34:
-#line 141 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist((yyvsp[-6].sml), (yyvsp[-3].sym), 0, (yyvsp[-1].sym));
-  }
+  case 53: /* exceptlist: VPTT_except sublist  */
+#line 196 "VYacc.y"
+                        { (yyval.sll) = vpyy_chain_sublist(vp,NULL,(yyvsp[0].sml)) ; }
 #line 1692 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 35:
-#line 145 "VYacc.y"
-  {
-    (yyval.uni) = (yyvsp[0].uni);
-  }
+  case 54: /* exceptlist: exceptlist ',' sublist  */
+#line 197 "VYacc.y"
+                                 { vpyy_chain_sublist(vp,(yyvsp[-2].sll),(yyvsp[0].sml)) ; (yyval.sll) = (yyvsp[-2].sll) ; }
 #line 1698 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 36:
-#line 146 "VYacc.y"
-  {
-    (yyval.uni) = vpyy_unitsrange((yyvsp[-5].uni), (yyvsp[-3].num), (yyvsp[-1].num), -1);
-  }
+  case 55: /* mapsymlist: VPTT_symbol  */
+#line 201 "VYacc.y"
+                    { (yyval.sml) = vpyy_symlist(vp,NULL,(yyvsp[0].sym),0,NULL) ; if (!(yyval.sml)) YYABORT ; }
 #line 1704 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 37:
-#line 147 "VYacc.y"
-  {
-    (yyval.uni) = vpyy_unitsrange((yyvsp[-7].uni), (yyvsp[-5].num), (yyvsp[-3].num), (yyvsp[-1].num));
-  }
+  case 56: /* mapsymlist: '(' VPTT_symbol ':' symlist ')'  */
+#line 202 "VYacc.y"
+                                          { (yyval.sml) = vpyy_mapsymlist(vp,NULL, (yyvsp[-3].sym), (yyvsp[-1].sml)); }
 #line 1710 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 38:
-#line 148 "VYacc.y"
-  {
-    (yyval.uni) = vpyy_unitsrange(NULL, (yyvsp[-3].num), (yyvsp[-1].num), -1);
-  }
+  case 57: /* mapsymlist: mapsymlist ',' VPTT_symbol  */
+#line 203 "VYacc.y"
+                                     { (yyval.sml) = vpyy_symlist(vp,(yyvsp[-2].sml),(yyvsp[0].sym),0,NULL) ; if (!(yyval.sml)) YYABORT ; }
 #line 1716 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 39:
-#line 149 "VYacc.y"
-  {
-    (yyval.uni) = vpyy_unitsrange(NULL, (yyvsp[-5].num), (yyvsp[-3].num), (yyvsp[-1].num));
-  }
+  case 58: /* mapsymlist: mapsymlist ',' '(' VPTT_symbol ':' symlist ')'  */
+#line 204 "VYacc.y"
+                                                         { (yyval.sml) = vpyy_mapsymlist(vp,(yyvsp[-6].sml), (yyvsp[-3].sym), (yyvsp[-1].sml));}
 #line 1722 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 40:
-#line 153 "VYacc.y"
-  {
-    (yyval.num) = (yyvsp[0].num);
-  }
+  case 59: /* maplist: %empty  */
+#line 209 "VYacc.y"
+    { (yyval.sml) = NULL ; }
 #line 1728 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 41:
-#line 154 "VYacc.y"
-  {
-    (yyval.num) = -1e30;
-  }
+  case 60: /* maplist: VPTT_map mapsymlist  */
+#line 210 "VYacc.y"
+                              { (yyval.sml) =  (yyvsp[0].sml) ; }
 #line 1734 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 42:
-#line 157 "VYacc.y"
-  {
-    (yyval.num) = (yyvsp[0].num);
-  }
+  case 61: /* exprlist: exp  */
+#line 215 "VYacc.y"
+       {(yyval.exl) = vpyy_chain_exprlist(vp,NULL,(yyvsp[0].exn)) ;}
 #line 1740 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 43:
-#line 158 "VYacc.y"
-  {
-    (yyval.num) = -(yyvsp[0].num);
-  }
+  case 62: /* exprlist: exprlist ',' exp  */
+#line 216 "VYacc.y"
+                      {(yyval.exl) = vpyy_chain_exprlist(vp,(yyvsp[-2].exl),(yyvsp[0].exn)) ; }
 #line 1746 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 44:
-#line 159 "VYacc.y"
-  {
-    (yyval.num) = (yyvsp[0].num);
-  }
+  case 63: /* exprlist: exprlist ';' exp  */
+#line 217 "VYacc.y"
+                      {(yyval.exl) = vpyy_chain_exprlist(vp,(yyvsp[-2].exl),(yyvsp[0].exn)) ; }
 #line 1752 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 45:
-#line 163 "VYacc.y"
-  {
-    (yyval.uni) = (yyvsp[0].uni);
-  }
+  case 64: /* exprlist: exprlist ';'  */
+#line 218 "VYacc.y"
+                  {(yyval.exl) = (yyvsp[-1].exl) ; }
 #line 1758 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 46:
-#line 164 "VYacc.y"
-  {
-    (yyval.uni) = vpyy_unitsdiv((yyvsp[-2].uni), (yyvsp[0].uni));
-  }
+  case 65: /* exp: VPTT_number  */
+#line 222 "VYacc.y"
+                          { (yyval.exn) = vpyy_num_expression(vp,(yyvsp[0].num)) ; }
 #line 1764 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 47:
-#line 165 "VYacc.y"
-  {
-    (yyval.uni) = vpyy_unitsmult((yyvsp[-2].uni), (yyvsp[0].uni));
-  }
+  case 66: /* exp: VPTT_na  */
+#line 223 "VYacc.y"
+                                          { (yyval.exn) = vpyy_num_expression(vp,-1E38);}
 #line 1770 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 48:
-#line 166 "VYacc.y"
-  {
-    (yyval.uni) = (yyvsp[-1].uni);
-  }
+  case 67: /* exp: var  */
+#line 224 "VYacc.y"
+                          { (yyval.exn) = (Expression *)(yyvsp[0].var) ; }
 #line 1776 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 49:
-#line 171 "VYacc.y"
-  {
-    (yyval.tok) = (yyvsp[0].tok);
-  }
+  case 68: /* exp: VPTT_literal  */
+#line 225 "VYacc.y"
+                              { (yyval.exn) = vpyy_literal_expression(vp,(yyvsp[0].lit)) ; }
 #line 1782 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 50:
-#line 172 "VYacc.y"
-  {
-    (yyval.tok) = (yyvsp[0].tok);
-  }
+  case 69: /* exp: var '(' exp ')'  */
+#line 226 "VYacc.y"
+                              { (yyval.exn) = vpyy_lookup_expression(vp,(yyvsp[-3].var),(yyvsp[-1].exn)) ; }
 #line 1788 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 51:
-#line 173 "VYacc.y"
-  {
-    (yyval.tok) = (yyvsp[0].tok);
-  }
+  case 70: /* exp: '(' exp ')'  */
+#line 227 "VYacc.y"
+                              { (yyval.exn) = vpyy_operator_expression(vp,'(',(yyvsp[-1].exn),NULL) ; if (!(yyval.exn)) YYABORT ; }
 #line 1794 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 52:
-#line 174 "VYacc.y"
-  {
-    (yyval.tok) = (yyvsp[0].tok);
-  }
+  case 71: /* exp: VPTT_function '(' exprlist ')'  */
+#line 228 "VYacc.y"
+                                        { (yyval.exn) = vpyy_function_expression(vp,(yyvsp[-3].fnc),(yyvsp[-1].exl)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1800 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 53:
-#line 178 "VYacc.y"
-  {
-    (yyval.sll) = vpyy_chain_sublist(NULL, (yyvsp[0].sml));
-  }
+  case 72: /* exp: VPTT_function '(' ')'  */
+#line 229 "VYacc.y"
+                               { (yyval.exn) = vpyy_function_expression(vp,(yyvsp[-2].fnc),NULL) ; if (!(yyval.exn)) YYABORT ; }
 #line 1806 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 54:
-#line 179 "VYacc.y"
-  {
-    vpyy_chain_sublist((yyvsp[-2].sll), (yyvsp[0].sml));
-    (yyval.sll) = (yyvsp[-2].sll);
-  }
+  case 73: /* exp: exp '+' exp  */
+#line 230 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'+',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1812 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 55:
-#line 183 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist(NULL, (yyvsp[0].sym), 0, NULL);
-  }
+  case 74: /* exp: exp '-' exp  */
+#line 231 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'-',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1818 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 56:
-#line 184 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_mapsymlist(NULL, (yyvsp[-3].sym), (yyvsp[-1].sml));
-  }
+  case 75: /* exp: exp '*' exp  */
+#line 232 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'*',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1824 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 57:
-#line 185 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_symlist((yyvsp[-2].sml), (yyvsp[0].sym), 0, NULL);
-  }
+  case 76: /* exp: exp '/' exp  */
+#line 233 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'/',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1830 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 58:
-#line 186 "VYacc.y"
-  {
-    (yyval.sml) = vpyy_mapsymlist((yyvsp[-6].sml), (yyvsp[-3].sym), (yyvsp[-1].sml));
-  }
+  case 77: /* exp: exp '<' exp  */
+#line 234 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'<',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1836 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 59:
-#line 191 "VYacc.y"
-  {
-    (yyval.sml) = NULL;
-  }
+  case 78: /* exp: exp VPTT_le exp  */
+#line 235 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,VPTT_le,(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1842 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 60:
-#line 192 "VYacc.y"
-  {
-    (yyval.sml) = (yyvsp[0].sml);
-  }
+  case 79: /* exp: exp '>' exp  */
+#line 236 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'>',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1848 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 61:
-#line 197 "VYacc.y"
-  {
-    (yyval.exl) = vpyy_chain_exprlist(NULL, (yyvsp[0].exn));
-  }
+  case 80: /* exp: exp VPTT_ge exp  */
+#line 237 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,VPTT_ge,(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1854 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 62:
-#line 198 "VYacc.y"
-  {
-    (yyval.exl) = vpyy_chain_exprlist((yyvsp[-2].exl), (yyvsp[0].exn));
-  }
+  case 81: /* exp: exp VPTT_ne exp  */
+#line 238 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,VPTT_ne,(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1860 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 63:
-#line 199 "VYacc.y"
-  {
-    (yyval.exl) = vpyy_chain_exprlist((yyvsp[-2].exl), (yyvsp[0].exn));
-  }
+  case 82: /* exp: exp VPTT_or exp  */
+#line 239 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,VPTT_or,(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1866 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 64:
-#line 200 "VYacc.y"
-  {
-    (yyval.exl) = (yyvsp[-1].exl);
-  }
+  case 83: /* exp: exp VPTT_and exp  */
+#line 240 "VYacc.y"
+                           { (yyval.exn) = vpyy_operator_expression(vp,VPTT_and,(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1872 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 65:
-#line 204 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_num_expression((yyvsp[0].num));
-  }
+  case 84: /* exp: VPTT_not exp  */
+#line 241 "VYacc.y"
+                                  { (yyval.exn) = vpyy_operator_expression(vp,VPTT_not,(yyvsp[0].exn),NULL) ; if (!(yyval.exn)) YYABORT ; }
 #line 1878 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 66:
-#line 205 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_num_expression(-1E38);
-  }
+  case 85: /* exp: exp '=' exp  */
+#line 242 "VYacc.y"
+                      { (yyval.exn) = vpyy_operator_expression(vp,'=',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1884 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 67:
-#line 206 "VYacc.y"
-  {
-    (yyval.exn) = (Expression *)(yyvsp[0].var);
-  }
+  case 86: /* exp: '-' exp  */
+#line 243 "VYacc.y"
+                                { (yyval.exn) = vpyy_operator_expression(vp,'-',NULL, (yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1890 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 68:
-#line 207 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_literal_expression((yyvsp[0].lit));
-  }
+  case 87: /* exp: '+' exp  */
+#line 244 "VYacc.y"
+                                { (yyval.exn) = vpyy_operator_expression(vp,'+',NULL, (yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1896 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 69:
-#line 208 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_lookup_expression((yyvsp[-3].var), (yyvsp[-1].exn));
-  }
+  case 88: /* exp: exp '^' exp  */
+#line 245 "VYacc.y"
+                          { (yyval.exn) = vpyy_operator_expression(vp,'^',(yyvsp[-2].exn),(yyvsp[0].exn)) ; if (!(yyval.exn)) YYABORT ; }
 #line 1902 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 70:
-#line 209 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('(', (yyvsp[-1].exn), NULL);
-  }
+  case 89: /* tablevals: tablepairs  */
+#line 249 "VYacc.y"
+                   { (yyval.tbl) = (yyvsp[0].tbl) ; }
 #line 1908 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 71:
-#line 210 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_function_expression((yyvsp[-3].fnc), (yyvsp[-1].exl));
-  }
+  case 90: /* tablevals: '[' '(' number ',' number ')' '-' '(' number ',' number ')' ']' ',' tablepairs  */
+#line 251 "VYacc.y"
+        { (yyval.tbl) = vpyy_tablerange(vp,(yyvsp[0].tbl),(yyvsp[-12].num),(yyvsp[-10].num),(yyvsp[-6].num),(yyvsp[-4].num)) ; }
 #line 1914 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 72:
-#line 211 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_function_expression((yyvsp[-2].fnc), NULL);
-  }
+  case 91: /* tablevals: '[' '(' number ',' number ')' '-' '(' number ',' number ')' ',' tablepairs ']' ',' tablepairs  */
+#line 253 "VYacc.y"
+        { (yyval.tbl) = vpyy_tablerange(vp,(yyvsp[0].tbl),(yyvsp[-14].num),(yyvsp[-12].num),(yyvsp[-8].num),(yyvsp[-6].num)) ; }
 #line 1920 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 73:
-#line 212 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('+', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
+  case 92: /* xytablevals: xytablevec  */
+#line 257 "VYacc.y"
+                   { (yyval.tbl) = (yyvsp[0].tbl) ; }
 #line 1926 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 74:
-#line 213 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('-', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
+  case 93: /* xytablevals: '[' '(' number ',' number ')' '-' '(' number ',' number ')' ']' ',' xytablevec  */
+#line 259 "VYacc.y"
+        { (yyval.tbl) = vpyy_tablerange(vp,(yyvsp[0].tbl),(yyvsp[-12].num),(yyvsp[-10].num),(yyvsp[-6].num),(yyvsp[-4].num)) ; }
 #line 1932 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 75:
-#line 214 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('*', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
+  case 94: /* xytablevec: number  */
+#line 263 "VYacc.y"
+                { (yyval.tbl) = vpyy_tablevec(vp,NULL,(yyvsp[0].num)) ;}
 #line 1938 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 76:
-#line 215 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('/', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
+  case 95: /* xytablevec: xytablevec ',' number  */
+#line 264 "VYacc.y"
+                                  {(yyval.tbl) = vpyy_tablevec(vp,(yyvsp[-2].tbl),(yyvsp[0].num)) ;}
 #line 1944 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 77:
-#line 216 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('<', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
+  case 96: /* tablepairs: '(' number ',' number ')'  */
+#line 269 "VYacc.y"
+                                  { (yyval.tbl) = vpyy_tablepair(vp,NULL,(yyvsp[-3].num),(yyvsp[-1].num)) ;}
 #line 1950 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 78:
-#line 217 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression(VPTT_le, (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
+  case 97: /* tablepairs: tablepairs ',' '(' number ',' number ')'  */
+#line 270 "VYacc.y"
+                                                    {(yyval.tbl) = vpyy_tablepair(vp,(yyvsp[-6].tbl),(yyvsp[-3].num),(yyvsp[-1].num)) ;}
 #line 1956 "VYacc.tab.cpp"
-  break;
-
-  case 79:
-#line 218 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('>', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 1962 "VYacc.tab.cpp"
-  break;
-
-  case 80:
-#line 219 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression(VPTT_ge, (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 1968 "VYacc.tab.cpp"
-  break;
-
-  case 81:
-#line 220 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression(VPTT_ne, (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 1974 "VYacc.tab.cpp"
-  break;
-
-  case 82:
-#line 221 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression(VPTT_or, (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 1980 "VYacc.tab.cpp"
-  break;
-
-  case 83:
-#line 222 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression(VPTT_and, (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 1986 "VYacc.tab.cpp"
-  break;
-
-  case 84:
-#line 223 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression(VPTT_not, (yyvsp[0].exn), NULL);
-  }
-#line 1992 "VYacc.tab.cpp"
-  break;
-
-  case 85:
-#line 224 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('=', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 1998 "VYacc.tab.cpp"
-  break;
-
-  case 86:
-#line 225 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('-', NULL, (yyvsp[0].exn));
-  }
-#line 2004 "VYacc.tab.cpp"
-  break;
-
-  case 87:
-#line 226 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('+', NULL, (yyvsp[0].exn));
-  }
-#line 2010 "VYacc.tab.cpp"
-  break;
-
-  case 88:
-#line 227 "VYacc.y"
-  {
-    (yyval.exn) = vpyy_operator_expression('^', (yyvsp[-2].exn), (yyvsp[0].exn));
-  }
-#line 2016 "VYacc.tab.cpp"
-  break;
-
-  case 89:
-#line 231 "VYacc.y"
-  {
-    (yyval.tbl) = (yyvsp[0].tbl);
-  }
-#line 2022 "VYacc.tab.cpp"
-  break;
-
-  case 90:
-#line 233 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablerange((yyvsp[0].tbl), (yyvsp[-12].num), (yyvsp[-10].num), (yyvsp[-6].num), (yyvsp[-4].num));
-  }
-#line 2028 "VYacc.tab.cpp"
-  break;
-
-  case 91:
-#line 235 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablerange((yyvsp[0].tbl), (yyvsp[-14].num), (yyvsp[-12].num), (yyvsp[-8].num), (yyvsp[-6].num));
-  }
-#line 2034 "VYacc.tab.cpp"
-  break;
-
-  case 92:
-#line 239 "VYacc.y"
-  {
-    (yyval.tbl) = (yyvsp[0].tbl);
-  }
-#line 2040 "VYacc.tab.cpp"
-  break;
-
-  case 93:
-#line 241 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablerange((yyvsp[0].tbl), (yyvsp[-12].num), (yyvsp[-10].num), (yyvsp[-6].num), (yyvsp[-4].num));
-  }
-#line 2046 "VYacc.tab.cpp"
-  break;
-
-  case 94:
-#line 245 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablevec(NULL, (yyvsp[0].num));
-  }
-#line 2052 "VYacc.tab.cpp"
-  break;
-
-  case 95:
-#line 246 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablevec((yyvsp[-2].tbl), (yyvsp[0].num));
-  }
-#line 2058 "VYacc.tab.cpp"
-  break;
-
-  case 96:
-#line 251 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablepair(NULL, (yyvsp[-3].num), (yyvsp[-1].num));
-  }
-#line 2064 "VYacc.tab.cpp"
-  break;
+    break;
 
-  case 97:
-#line 252 "VYacc.y"
-  {
-    (yyval.tbl) = vpyy_tablepair((yyvsp[-6].tbl), (yyvsp[-3].num), (yyvsp[-1].num));
-  }
-#line 2070 "VYacc.tab.cpp"
-  break;
 
-#line 2074 "VYacc.tab.cpp"
+#line 1960 "VYacc.tab.cpp"
 
-  default:
-    break;
-  }
+      default: break;
+    }
   /* User semantic actions sometimes alter yychar, and that requires
      that yytoken be updated with the new translation.  We take the
      approach of translating immediately before every use of yytoken.
@@ -2093,11 +1971,10 @@ yyreduce:
      case of YYERROR or YYBACKUP, subsequent parser actions might lead
      to an incorrect destructor call or verbose syntax error message
      before the lookahead is translated.  */
-  YY_SYMBOL_PRINT("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
-  YYPOPSTACK(yylen);
+  YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT(yyss, yyssp);
 
   *++yyvsp = yyval;
 
@@ -2107,71 +1984,52 @@ yyreduce:
   {
     const int yylhs = yyr1[yyn] - YYNTOKENS;
     const int yyi = yypgoto[yylhs] + *yyssp;
-    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp ? yytable[yyi] : yydefgoto[yylhs]);
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
   }
 
   goto yynewstate;
 
+
 /*--------------------------------------.
 | yyerrlab -- here on detecting error.  |
 `--------------------------------------*/
 yyerrlab:
   /* Make sure we have latest lookahead translation.  See comments at
      user semantic actions for why this is necessary.  */
-  yytoken = yychar == YYEMPTY ? YYEMPTY : YYTRANSLATE(yychar);
-
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
-  if (!yyerrstatus) {
-    ++yynerrs;
-#if !YYERROR_VERBOSE
-    yyerror(YY_("syntax error"));
-#else
-#define YYSYNTAX_ERROR yysyntax_error(&yymsg_alloc, &yymsg, yyssp, yytoken)
+  if (!yyerrstatus)
     {
-      char const *yymsgp = YY_("syntax error");
-      int yysyntax_error_status;
-      yysyntax_error_status = YYSYNTAX_ERROR;
-      if (yysyntax_error_status == 0)
-        yymsgp = yymsg;
-      else if (yysyntax_error_status == 1) {
-        if (yymsg != yymsgbuf)
-          YYSTACK_FREE(yymsg);
-        yymsg = YY_CAST(char *, YYSTACK_ALLOC(YY_CAST(YYSIZE_T, yymsg_alloc)));
-        if (!yymsg) {
-          yymsg = yymsgbuf;
-          yymsg_alloc = sizeof yymsgbuf;
-          yysyntax_error_status = 2;
-        } else {
-          yysyntax_error_status = YYSYNTAX_ERROR;
-          yymsgp = yymsg;
-        }
-      }
-      yyerror(yymsgp);
-      if (yysyntax_error_status == 2)
-        goto yyexhaustedlab;
+      ++yynerrs;
+      yyerror (vp, YY_("syntax error"));
     }
-#undef YYSYNTAX_ERROR
-#endif
-  }
-
-  if (yyerrstatus == 3) {
-    /* If just tried and failed to reuse lookahead token after an
-       error, discard it.  */
 
-    if (yychar <= YYEOF) {
-      /* Return failure if at end of input.  */
-      if (yychar == YYEOF)
-        YYABORT;
-    } else {
-      yydestruct("Error: discarding", yytoken, &yylval);
-      yychar = YYEMPTY;
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, vp);
+          yychar = YYEMPTY;
+        }
     }
-  }
 
   /* Else will try to reuse lookahead token after shifting the error
      token.  */
   goto yyerrlab1;
 
+
 /*---------------------------------------------------.
 | yyerrorlab -- error raised explicitly by YYERROR.  |
 `---------------------------------------------------*/
@@ -2180,102 +2038,129 @@ yyerrorlab:
      label yyerrorlab therefore never appears in user code.  */
   if (0)
     YYERROR;
+  ++yynerrs;
 
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
-  YYPOPSTACK(yylen);
+  YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT(yyss, yyssp);
+  YY_STACK_PRINT (yyss, yyssp);
   yystate = *yyssp;
   goto yyerrlab1;
 
+
 /*-------------------------------------------------------------.
 | yyerrlab1 -- common code for both syntax error and YYERROR.  |
 `-------------------------------------------------------------*/
 yyerrlab1:
-  yyerrstatus = 3; /* Each real token shifted decrements this.  */
-
-  for (;;) {
-    yyn = yypact[yystate];
-    if (!yypact_value_is_default(yyn)) {
-      yyn += YYTERROR;
-      if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR) {
-        yyn = yytable[yyn];
-        if (0 < yyn)
-          break;
-      }
-    }
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
-    /* Pop the current state because it cannot handle the error token.  */
-    if (yyssp == yyss)
-      YYABORT;
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
 
-    yydestruct("Error: popping", yystos[yystate], yyvsp);
-    YYPOPSTACK(1);
-    yystate = *yyssp;
-    YY_STACK_PRINT(yyss, yyssp);
-  }
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, vp);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
 
   YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
   YY_IGNORE_MAYBE_UNINITIALIZED_END
 
+
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
 
+
 /*-------------------------------------.
 | yyacceptlab -- YYACCEPT comes here.  |
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
+
 
 /*-----------------------------------.
 | yyabortlab -- YYABORT comes here.  |
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
-#if !defined yyoverflow || YYERROR_VERBOSE
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror(YY_("memory exhausted"));
+  yyerror (vp, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
-/*-----------------------------------------------------.
-| yyreturn -- parsing is finished, return the result.  |
-`-----------------------------------------------------*/
-yyreturn:
-  if (yychar != YYEMPTY) {
-    /* Make sure we have latest lookahead translation.  See comments at
-       user semantic actions for why this is necessary.  */
-    yytoken = YYTRANSLATE(yychar);
-    yydestruct("Cleanup: discarding lookahead", yytoken, &yylval);
-  }
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, vp);
+    }
   /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
-  YYPOPSTACK(yylen);
-  YY_STACK_PRINT(yyss, yyssp);
-  while (yyssp != yyss) {
-    yydestruct("Cleanup: popping", yystos[*yyssp], yyvsp);
-    YYPOPSTACK(1);
-  }
-#ifndef yyoverflow
-  if (yyss != yyssa)
-    YYSTACK_FREE(yyss);
-#endif
-#if YYERROR_VERBOSE
-  if (yymsg != yymsgbuf)
-    YYSTACK_FREE(yymsg);
-#endif
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, vp);
+      YYPOPSTACK (1);
+    }
+  yyps->yynew = 2;
+  goto yypushreturn;
+
+
+/*-------------------------.
+| yypushreturn -- return.  |
+`-------------------------*/
+yypushreturn:
+
   return yyresult;
 }
-#line 258 "VYacc.y"
+#undef vpyynerrs
+#undef yystate
+#undef yyerrstatus
+#undef yyssa
+#undef yyss
+#undef yyssp
+#undef yyvsa
+#undef yyvs
+#undef yyvsp
+#undef yystacksize
+#line 276 "VYacc.y"
+
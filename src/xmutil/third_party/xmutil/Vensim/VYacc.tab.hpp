@@ -1,8 +1,8 @@
-/* A Bison parser, made by GNU Bison 3.5.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
 /* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2019 Free Software Foundation,
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
    Inc.
 
    This program is free software: you can redistribute it and/or modify
@@ -16,7 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -31,8 +31,9 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Undocumented macros, especially those whose name start with YY_,
-   are private implementation details.  Do not rely on them.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
 
 #ifndef YY_VPYY_VYACC_TAB_HPP_INCLUDED
 # define YY_VPYY_VYACC_TAB_HPP_INCLUDED
@@ -43,49 +44,74 @@
 #if YYDEBUG
 extern int vpyydebug;
 #endif
+/* "%code requires" blocks.  */
+#line 7 "VYacc.y"
 
-/* Token type.  */
+class VensimParse;
+
+#line 53 "VYacc.tab.hpp"
+
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
   enum yytokentype
   {
-    VPTT_dataequals = 258,
-    VPTT_with_lookup = 259,
-    VPTT_map = 260,
-    VPTT_equiv = 261,
-    VPTT_groupstar = 262,
-    VPTT_and = 263,
-    VPTT_macro = 264,
-    VPTT_end_of_macro = 265,
-    VPTT_or = 266,
-    VPTT_not = 267,
-    VPTT_hold_backward = 268,
-    VPTT_look_forward = 269,
-    VPTT_except = 270,
-    VPTT_na = 271,
-    VPTT_interpolate = 272,
-    VPTT_raw = 273,
-    VPTT_test_input = 274,
-    VPTT_the_condition = 275,
-    VPTT_implies = 276,
-    VPTT_ge = 277,
-    VPTT_le = 278,
-    VPTT_ne = 279,
-    VPTT_tabbed_array = 280,
-    VPTT_eqend = 281,
-    VPTT_number = 282,
-    VPTT_literal = 283,
-    VPTT_symbol = 284,
-    VPTT_units_symbol = 285,
-    VPTT_function = 286
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    VPTT_dataequals = 258,         /* VPTT_dataequals  */
+    VPTT_with_lookup = 259,        /* VPTT_with_lookup  */
+    VPTT_map = 260,                /* VPTT_map  */
+    VPTT_equiv = 261,              /* VPTT_equiv  */
+    VPTT_groupstar = 262,          /* VPTT_groupstar  */
+    VPTT_and = 263,                /* VPTT_and  */
+    VPTT_macro = 264,              /* VPTT_macro  */
+    VPTT_end_of_macro = 265,       /* VPTT_end_of_macro  */
+    VPTT_or = 266,                 /* VPTT_or  */
+    VPTT_not = 267,                /* VPTT_not  */
+    VPTT_hold_backward = 268,      /* VPTT_hold_backward  */
+    VPTT_look_forward = 269,       /* VPTT_look_forward  */
+    VPTT_except = 270,             /* VPTT_except  */
+    VPTT_na = 271,                 /* VPTT_na  */
+    VPTT_interpolate = 272,        /* VPTT_interpolate  */
+    VPTT_raw = 273,                /* VPTT_raw  */
+    VPTT_test_input = 274,         /* VPTT_test_input  */
+    VPTT_the_condition = 275,      /* VPTT_the_condition  */
+    VPTT_implies = 276,            /* VPTT_implies  */
+    VPTT_ge = 277,                 /* VPTT_ge  */
+    VPTT_le = 278,                 /* VPTT_le  */
+    VPTT_ne = 279,                 /* VPTT_ne  */
+    VPTT_tabbed_array = 280,       /* VPTT_tabbed_array  */
+    VPTT_eqend = 281,              /* VPTT_eqend  */
+    VPTT_number = 282,             /* VPTT_number  */
+    VPTT_literal = 283,            /* VPTT_literal  */
+    VPTT_symbol = 284,             /* VPTT_symbol  */
+    VPTT_units_symbol = 285,       /* VPTT_units_symbol  */
+    VPTT_function = 286,           /* VPTT_function  */
+    VPTT_unary = 287               /* VPTT_unary  */
   };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
 
 /* Value type.  */
 
 
-extern YYSTYPE vpyylval;
 
-int vpyyparse (void);
+
+#ifndef YYPUSH_MORE_DEFINED
+# define YYPUSH_MORE_DEFINED
+enum { YYPUSH_MORE = 4 };
+#endif
+
+typedef struct vpyypstate vpyypstate;
+
+
+int vpyypush_parse (vpyypstate *ps,
+                  int pushed_char, YYSTYPE const *pushed_val, VensimParse *vp);
+
+vpyypstate *vpyypstate_new (void);
+void vpyypstate_delete (vpyypstate *ps);
+
 
 #endif /* !YY_VPYY_VYACC_TAB_HPP_INCLUDED  */
@@ -4,13 +4,30 @@ Converting VYacc.y
 Outputs: VYacc.tab.cpp VYacc.tab.hpp 
 */
 
+%code requires {
+class VensimParse;
+}
+
 %{
 #include "../Symbol/Parse.h"
 #include "VensimParseFunctions.h"
-extern int vpyylex (void);
-extern void vpyyerror (char const *);
 #define YYSTYPE ParseUnion
+extern int vpyylex (YYSTYPE *lvalp, VensimParse *vp);
+extern void vpyyerror (VensimParse *vp, char const *);
 %}
+
+/* errors don't throw - vpyyerror and the lexer's YYerror note the error
+   with the VensimParse and the parse aborts, as do the actions below
+   whose helper gives back NULL having noted one */
+
+/* reentrant - all state lives in the VensimParse object passed through.
+   A push parser, so one parser state is fed the tokens of every equation
+   in turn rather than each equation setting up a parse of its own, and
+   each equation ends with an accept that readies it for the next */
+%define api.pure full
+%define api.push-pull push
+%parse-param {VensimParse *vp}
+%lex-param {VensimParse *vp}
      
 /* tokens returned by the tokenizer (in addition to single char tokens) */
 %token <tok> VPTT_dataequals
@@ -67,61 +84,62 @@ extern void vpyyerror (char const *);
 %type <tok> macrostart macroend /* not really used - just sets/unsets a flag */
 
 
-/* precedence - low to high */     
-%left '-' '+'
+/* precedence - low to high, as Vensim has it */
 %left VPTT_or
-%left '=' '<' '>' VPTT_le VPTT_ge VPTT_ne
 %left VPTT_and
+%right VPTT_not
+%left '=' '<' '>' VPTT_le VPTT_ge VPTT_ne
+%left '-' '+'
 %left '*' '/'
-%left VPTT_not
+%right VPTT_unary /* unary minus and plus - not a token, just their precedence */
 %right '^'      /* exponentiation */
 
 %% /* The grammar follows.  */
 
 
 fulleq :
-	VPTT_eqend { return VPTT_eqend ; } /* finished no more to do */
-	| VPTT_groupstar { return VPTT_groupstar ; } /* process the group name elsewhere */
-	| macrostart		  { return '|'; } /* sets the context for equations that follow */
-	| macroend			  {return '|'; } /* back to regular equations */
-	| eqn '~' unitsrange '~' /* comment follows */{vpyy_addfulleq($1,$3) ; return '~' ; }
-	| eqn '~' unitsrange '|' /* comment skipped */ {vpyy_addfulleq($1,$3) ; return '|' ; }
-	| eqn '~' '~' /* units skipped */{vpyy_addfulleq($1,NULL) ; return '~' ;}
-	| eqn '~' '|' /* units, comment skipped */ {vpyy_addfulleq($1,NULL) ; return '|' ;}
+	VPTT_eqend { vpyy_equation_end(vp,VPTT_eqend) ; YYACCEPT ; } /* finished no more to do */
+	| VPTT_groupstar { vpyy_equation_end(vp,VPTT_groupstar) ; YYACCEPT ; } /* process the group name elsewhere */
+	| macrostart		  { vpyy_equation_end(vp,'|') ; YYACCEPT ; } /* sets the context for equations that follow */
+	| macroend			  { vpyy_equation_end(vp,'|') ; YYACCEPT ; } /* back to regular equations */
+	| eqn '~' unitsrange '~' /* comment follows */{vpyy_addfulleq(vp,$1,$3) ; vpyy_equation_end(vp,'~') ; YYACCEPT ; }
+	| eqn '~' unitsrange '|' /* comment skipped */ {vpyy_addfulleq(vp,$1,$3) ; vpyy_equation_end(vp,'|') ; YYACCEPT ; }
+	| eqn '~' '~' /* units skipped */{vpyy_addfulleq(vp,$1,NULL) ; vpyy_equation_end(vp,'~') ; YYACCEPT ;}
+	| eqn '~' '|' /* units, comment skipped */ {vpyy_addfulleq(vp,$1,NULL) ; vpyy_equation_end(vp,'|') ; YYACCEPT ;}
 	;
 
 macrostart:
-	VPTT_macro { vpyy_macro_start(); } VPTT_symbol '(' exprlist ')'   { vpyy_macro_expression($3,$5) ;}
+	VPTT_macro { vpyy_macro_start(vp); } VPTT_symbol '(' exprlist ')'   { vpyy_macro_expression(vp,$3,$5) ;}
 	;
 
 macroend:
-   VPTT_end_of_macro { $$ = $1; vpyy_macro_end(); }
+   VPTT_end_of_macro { $$ = $1; vpyy_macro_end(vp); }
    ;
 
 
 
 
 eqn : 
-   lhs '=' exprlist {$$ = vpyy_addeq($1,NULL,$3,'=') ; }
-   | lhs '(' tablevals ')' { $$ = vpyy_add_lookup($1,NULL,$3, 0) ; }
-   | lhs '(' xytablevals ')' { $$ = vpyy_add_lookup($1,NULL,$3, 1) ; }
-   | lhs '=' VPTT_with_lookup '(' exp ',' '(' tablevals ')' ')' { $$ = vpyy_add_lookup($1,$5,$8, 0) ; }
-   | lhs VPTT_dataequals exp {$$ = vpyy_addeq($1,$3,NULL,VPTT_dataequals) ; }
-   | lhs { $$ = vpyy_add_lookup($1,NULL,NULL, 0) ; } // treat as if a lookup on time - don't have numbers
-   | VPTT_symbol ':' subdef maplist {$$ = vpyy_addeq(vpyy_addexceptinterp(vpyy_var_expression($1,NULL),NULL,0),(Expression *)vpyy_symlist_expression($3,$4),NULL,':') ; }
-   | lhs '=' VPTT_tabbed_array { $$ = vpyy_addeq($1,$3,NULL,'=') ; }
+   lhs '=' exprlist {$$ = vpyy_addeq(vp,$1,NULL,$3,'=') ; if (!$$) YYABORT ; }
+   | lhs '(' tablevals ')' { $$ = vpyy_add_lookup(vp,$1,NULL,$3, 0) ; }
+   | lhs '(' xytablevals ')' { $$ = vpyy_add_lookup(vp,$1,NULL,$3, 1) ; }
+   | lhs '=' VPTT_with_lookup '(' exp ',' '(' tablevals ')' ')' { $$ = vpyy_add_lookup(vp,$1,$5,$8, 0) ; }
+   | lhs VPTT_dataequals exp {$$ = vpyy_addeq(vp,$1,$3,NULL,VPTT_dataequals) ; if (!$$) YYABORT ; }
+   | lhs { $$ = vpyy_add_lookup(vp,$1,NULL,NULL, 0) ; } // treat as if a lookup on time - don't have numbers
+   | VPTT_symbol ':' subdef maplist {$$ = vpyy_addeq(vp,vpyy_addexceptinterp(vp,vpyy_var_expression(vp,$1,NULL),NULL,0),(Expression *)vpyy_symlist_expression(vp,$3,$4),NULL,':') ; if (!$$) YYABORT ; }
+   | lhs '=' VPTT_tabbed_array { $$ = vpyy_addeq(vp,$1,$3,NULL,'=') ; if (!$$) YYABORT ; }
    ;
 
 
 lhs : 
-   var  { $$ = vpyy_addexceptinterp($1,NULL,0) ; }
-   | var exceptlist  {$$ = vpyy_addexceptinterp($1,$2,0) ;}
-   | var interpmode {$$ = vpyy_addexceptinterp($1,NULL,$2) ;}
+   var  { $$ = vpyy_addexceptinterp(vp,$1,NULL,0) ; }
+   | var exceptlist  {$$ = vpyy_addexceptinterp(vp,$1,$2,0) ;}
+   | var interpmode {$$ = vpyy_addexceptinterp(vp,$1,NULL,$2) ;}
    ;
 
 var : 
-	VPTT_symbol { $$ = vpyy_var_expression($1,NULL);}
-	| VPTT_symbol sublist { $$ = vpyy_var_expression($1,$2) ;}
+	VPTT_symbol { $$ = vpyy_var_expression(vp,$1,NULL);}
+	| VPTT_symbol sublist { $$ = vpyy_var_expression(vp,$1,$2) ;}
 	;
 
 sublist :
@@ -129,24 +147,24 @@ sublist :
 	;
 
 symlist :
-	VPTT_symbol { $$ = vpyy_symlist(NULL,$1,0,NULL) ; }
-	| VPTT_symbol '!' { $$ = vpyy_symlist(NULL,$1,1,NULL) ; }
-	| symlist ',' VPTT_symbol { $$ = vpyy_symlist($1,$3,0,NULL) ;}
-	| symlist ',' VPTT_symbol '!' { $$ = vpyy_symlist($1,$3,1,NULL) ;}
+	VPTT_symbol { $$ = vpyy_symlist(vp,NULL,$1,0,NULL) ; if (!$$) YYABORT ; }
+	| VPTT_symbol '!' { $$ = vpyy_symlist(vp,NULL,$1,1,NULL) ; if (!$$) YYABORT ; }
+	| symlist ',' VPTT_symbol { $$ = vpyy_symlist(vp,$1,$3,0,NULL) ; if (!$$) YYABORT ; }
+	| symlist ',' VPTT_symbol '!' { $$ = vpyy_symlist(vp,$1,$3,1,NULL) ; if (!$$) YYABORT ; }
 	;
 subdef :
-	VPTT_symbol { $$ = vpyy_symlist(NULL,$1,0,NULL) ; }
-	| '(' VPTT_symbol '-' VPTT_symbol ')' {$$ = vpyy_symlist(NULL,$2,0,$4) ;}
-	| subdef ',' VPTT_symbol { $$ = vpyy_symlist($1,$3,0,NULL) ; }
-	| subdef ',' '(' VPTT_symbol '-' VPTT_symbol ')' {$$ = vpyy_symlist($1,$4,0,$6) ; }
+	VPTT_symbol { $$ = vpyy_symlist(vp,NULL,$1,0,NULL) ; if (!$$) YYABORT ; }
+	| '(' VPTT_symbol '-' VPTT_symbol ')' {$$ = vpyy_symlist(vp,NULL,$2,0,$4) ; if (!$$) YYABORT ; }
+	| subdef ',' VPTT_symbol { $$ = vpyy_symlist(vp,$1,$3,0,NULL) ; if (!$$) YYABORT ; }
+	| subdef ',' '(' VPTT_symbol '-' VPTT_symbol ')' {$$ = vpyy_symlist(vp,$1,$4,0,$6) ; if (!$$) YYABORT ; }
 	;
 
 unitsrange : 
 	units { $$ = $1 ; }
-	| units '[' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange($1,$3,$5,-1) ; }
-	| units '[' urangenum ',' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange($1,$3,$5,$7) ; }
-	| '[' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange(NULL,$2,$4,-1) ; }
-	| '[' urangenum ',' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange(NULL,$2,$4,$6) ; }
+	| units '[' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange(vp,$1,$3,$5,-1) ; }
+	| units '[' urangenum ',' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange(vp,$1,$3,$5,$7) ; }
+	| '[' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange(vp,NULL,$2,$4,-1) ; }
+	| '[' urangenum ',' urangenum ',' urangenum ']' { $$ = vpyy_unitsrange(vp,NULL,$2,$4,$6) ; }
 	;
 
 urangenum :
@@ -161,8 +179,8 @@ number :
 
 units :
 	VPTT_units_symbol { $$ = $1 ; }
-	| units '/' units {$$ = vpyy_unitsdiv($1,$3);}
-	| units '*' units {$$ = vpyy_unitsmult($1,$3);}
+	| units '/' units {$$ = vpyy_unitsdiv(vp,$1,$3);}
+	| units '*' units {$$ = vpyy_unitsmult(vp,$1,$3);}
 	| '(' units ')' { $$ = $2 ; } /* don't record */
 	;
 
@@ -175,15 +193,15 @@ interpmode :
 	;
 
 exceptlist :
-    VPTT_except sublist { $$ = vpyy_chain_sublist(NULL,$2) ; }
-	| exceptlist ',' sublist { vpyy_chain_sublist($1,$3) ; $$ = $1 ; }
+    VPTT_except sublist { $$ = vpyy_chain_sublist(vp,NULL,$2) ; }
+	| exceptlist ',' sublist { vpyy_chain_sublist(vp,$1,$3) ; $$ = $1 ; }
 	;
 
 mapsymlist :
-	VPTT_symbol { $$ = vpyy_symlist(NULL,$1,0,NULL) ; }
-	| '(' VPTT_symbol ':' symlist ')' { $$ = vpyy_mapsymlist(NULL, $2, $4); }
-	| mapsymlist ',' VPTT_symbol { $$ = vpyy_symlist($1,$3,0,NULL) ;}
-	| mapsymlist ',' '(' VPTT_symbol ':' symlist ')' { $$ = vpyy_mapsymlist($1, $4, $6);}
+	VPTT_symbol { $$ = vpyy_symlist(vp,NULL,$1,0,NULL) ; if (!$$) YYABORT ; }
+	| '(' VPTT_symbol ':' symlist ')' { $$ = vpyy_mapsymlist(vp,NULL, $2, $4); }
+	| mapsymlist ',' VPTT_symbol { $$ = vpyy_symlist(vp,$1,$3,0,NULL) ; if (!$$) YYABORT ; }
+	| mapsymlist ',' '(' VPTT_symbol ':' symlist ')' { $$ = vpyy_mapsymlist(vp,$1, $4, $6);}
 	;
 
 
@@ -194,62 +212,62 @@ maplist :
 
    // number lists can use ; to end a line
 exprlist :
-   exp {$$ = vpyy_chain_exprlist(NULL,$1) ;}
-   | exprlist ',' exp {$$ = vpyy_chain_exprlist($1,$3) ; }
-   | exprlist ';' exp {$$ = vpyy_chain_exprlist($1,$3) ; }
+   exp {$$ = vpyy_chain_exprlist(vp,NULL,$1) ;}
+   | exprlist ',' exp {$$ = vpyy_chain_exprlist(vp,$1,$3) ; }
+   | exprlist ';' exp {$$ = vpyy_chain_exprlist(vp,$1,$3) ; }
    | exprlist ';' {$$ = $1 ; }
    ;
     
 exp:
-      VPTT_number         { $$ = vpyy_num_expression($1) ; } /* since we allow unary - number not used here */
-	 | VPTT_na			  { $$ = vpyy_num_expression(-1E38);}
+      VPTT_number         { $$ = vpyy_num_expression(vp,$1) ; } /* since we allow unary - number not used here */
+	 | VPTT_na			  { $$ = vpyy_num_expression(vp,-1E38);}
      | var                { $$ = (Expression *)$1 ; } /* ExpressionVariable is subclassed from Expression */
-	 | VPTT_literal       { $$ = vpyy_literal_expression($1) ; } // not part of XMILE - just dumped directly for editing afterward
-	 | var '(' exp ')'    { $$ = vpyy_lookup_expression($1,$3) ; }
-	 | '(' exp ')'        { $$ = vpyy_operator_expression('(',$2,NULL) ; }
-     | VPTT_function '(' exprlist ')'   { $$ = vpyy_function_expression($1,$3) ;}
-     | VPTT_function '(' ')'   { $$ = vpyy_function_expression($1,NULL) ;}
-     | exp '+' exp        { $$ = vpyy_operator_expression('+',$1,$3) ; }
-     | exp '-' exp        { $$ = vpyy_operator_expression('-',$1,$3) ; }
-     | exp '*' exp        { $$ = vpyy_operator_expression('*',$1,$3) ; }
-     | exp '/' exp        { $$ = vpyy_operator_expression('/',$1,$3) ; }
-     | exp '<' exp        { $$ = vpyy_operator_expression('<',$1,$3) ; }
-     | exp VPTT_le exp    { $$ = vpyy_operator_expression(VPTT_le,$1,$3) ; }
-     | exp '>' exp        { $$ = vpyy_operator_expression('>',$1,$3) ; }
-     | exp VPTT_ge exp    { $$ = vpyy_operator_expression(VPTT_ge,$1,$3) ; }
-     | exp VPTT_ne exp    { $$ = vpyy_operator_expression(VPTT_ne,$1,$3) ; }
-     | exp VPTT_or exp    { $$ = vpyy_operator_expression(VPTT_or,$1,$3) ; }
-     | exp VPTT_and exp    { $$ = vpyy_operator_expression(VPTT_and,$1,$3) ; }
-	 | VPTT_not exp		  { $$ = vpyy_operator_expression(VPTT_not,$2,NULL) ; }
-     | exp '=' exp    { $$ = vpyy_operator_expression('=',$1,$3) ; }
-     | '-' exp            { $$ = vpyy_operator_expression('-',NULL, $2) ; } /* unary plus - might be used by numbers */
-     | '+' exp            { $$ = vpyy_operator_expression('+',NULL, $2) ; } /* unary plus - might be used by numbers */
-     | exp '^' exp        { $$ = vpyy_operator_expression('^',$1,$3) ; }
+	 | VPTT_literal       { $$ = vpyy_literal_expression(vp,$1) ; } // not part of XMILE - just dumped directly for editing afterward
+	 | var '(' exp ')'    { $$ = vpyy_lookup_expression(vp,$1,$3) ; }
+	 | '(' exp ')'        { $$ = vpyy_operator_expression(vp,'(',$2,NULL) ; if (!$$) YYABORT ; }
+     | VPTT_function '(' exprlist ')'   { $$ = vpyy_function_expression(vp,$1,$3) ; if (!$$) YYABORT ; }
+     | VPTT_function '(' ')'   { $$ = vpyy_function_expression(vp,$1,NULL) ; if (!$$) YYABORT ; }
+     | exp '+' exp        { $$ = vpyy_operator_expression(vp,'+',$1,$3) ; if (!$$) YYABORT ; }
+     | exp '-' exp        { $$ = vpyy_operator_expression(vp,'-',$1,$3) ; if (!$$) YYABORT ; }
+     | exp '*' exp        { $$ = vpyy_operator_expression(vp,'*',$1,$3) ; if (!$$) YYABORT ; }
+     | exp '/' exp        { $$ = vpyy_operator_expression(vp,'/',$1,$3) ; if (!$$) YYABORT ; }
+     | exp '<' exp        { $$ = vpyy_operator_expression(vp,'<',$1,$3) ; if (!$$) YYABORT ; }
+     | exp VPTT_le exp    { $$ = vpyy_operator_expression(vp,VPTT_le,$1,$3) ; if (!$$) YYABORT ; }
+     | exp '>' exp        { $$ = vpyy_operator_expression(vp,'>',$1,$3) ; if (!$$) YYABORT ; }
+     | exp VPTT_ge exp    { $$ = vpyy_operator_expression(vp,VPTT_ge,$1,$3) ; if (!$$) YYABORT ; }
+     | exp VPTT_ne exp    { $$ = vpyy_operator_expression(vp,VPTT_ne,$1,$3) ; if (!$$) YYABORT ; }
+     | exp VPTT_or exp    { $$ = vpyy_operator_expression(vp,VPTT_or,$1,$3) ; if (!$$) YYABORT ; }
+     | exp VPTT_and exp    { $$ = vpyy_operator_expression(vp,VPTT_and,$1,$3) ; if (!$$) YYABORT ; }
+	 | VPTT_not exp		  { $$ = vpyy_operator_expression(vp,VPTT_not,$2,NULL) ; if (!$$) YYABORT ; }
+     | exp '=' exp    { $$ = vpyy_operator_expression(vp,'=',$1,$3) ; if (!$$) YYABORT ; }
+     | '-' exp %prec VPTT_unary { $$ = vpyy_operator_expression(vp,'-',NULL, $2) ; if (!$$) YYABORT ; } /* unary plus - might be used by numbers */
+     | '+' exp %prec VPTT_unary { $$ = vpyy_operator_expression(vp,'+',NULL, $2) ; if (!$$) YYABORT ; } /* unary plus - might be used by numbers */
+     | exp '^' exp        { $$ = vpyy_operator_expression(vp,'^',$1,$3) ; if (!$$) YYABORT ; }
      ;
 
 tablevals : 
 	tablepairs { $$ = $1 ; }
 	| '[' '(' number ',' number ')' '-' '(' number ',' number ')' ']' ',' tablepairs 
-	{ $$ = vpyy_tablerange($15,$3,$5,$9,$11) ; }
+	{ $$ = vpyy_tablerange(vp,$15,$3,$5,$9,$11) ; }
 	| '[' '(' number ',' number ')' '-' '(' number ',' number ')' ',' tablepairs ']' ',' tablepairs 
-	{ $$ = vpyy_tablerange($17,$3,$5,$9,$11) ; }
+	{ $$ = vpyy_tablerange(vp,$17,$3,$5,$9,$11) ; }
 	;
 
 	xytablevals :
 	xytablevec { $$ = $1 ; }
 	| '[' '(' number ',' number ')' '-' '(' number ',' number ')' ']' ',' xytablevec 
-	{ $$ = vpyy_tablerange($15,$3,$5,$9,$11) ; }
+	{ $$ = vpyy_tablerange(vp,$15,$3,$5,$9,$11) ; }
 	;
 
 	xytablevec :
-	number  { $$ = vpyy_tablevec(NULL,$1) ;}
-	| xytablevec ',' number   {$$ = vpyy_tablevec($1,$3) ;}
+	number  { $$ = vpyy_tablevec(vp,NULL,$1) ;}
+	| xytablevec ',' number   {$$ = vpyy_tablevec(vp,$1,$3) ;}
 	;
 
 	
 tablepairs :
-	'(' number ',' number ')' { $$ = vpyy_tablepair(NULL,$2,$4) ;}
-	| tablepairs ',' '(' number ',' number ')'  {$$ = vpyy_tablepair($1,$4,$6) ;}
+	'(' number ',' number ')' { $$ = vpyy_tablepair(vp,NULL,$2,$4) ;}
+	| tablepairs ',' '(' number ',' number ')'  {$$ = vpyy_tablepair(vp,$1,$4,$6) ;}
 	;
 
 
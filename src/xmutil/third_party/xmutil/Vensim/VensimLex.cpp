@@ -2,28 +2,187 @@
  */
 #include "VensimLex.h"
 
+#include <cstring>
+
 #include "VensimParse.h"
 /* try to avoid the tab.h file as it is C  */
 #define YYSTYPE ParseUnion
 #include "../Symbol/Expression.h"
+#include "../Limits.h"
+#include "../Stats.h"
 #include "../Symbol/Variable.h"
 #include "../XMUtil.h"
 #include "VYacc.tab.hpp"
 
-VensimLex::VensimLex(void) {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// character classes for the lexer - a table lookup rather than the (locale
+// dependent) ctype calls
+#define LEX_SPACE 1     // skipped between tokens
+#define LEX_SYMSTART 2  // can start a variable name
+#define LEX_SYMBOL 4    // can continue a variable name
+#define LEX_DIGIT 8
+
+class LexCharTable {
+public:
+  LexCharTable(void) {
+    for (int i = 0; i < 256; i++) {
+      unsigned char f = 0;
+      if (i == ' ' || i == '\t' || i == '\n' || i == '\r')
+        f |= LEX_SPACE;
+      if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || i > 127)
+        f |= LEX_SYMSTART | LEX_SYMBOL;
+      if (i >= '0' && i <= '9')
+        f |= LEX_DIGIT | LEX_SYMBOL;
+      if (i == ' ' || i == '_' || i == '$' || i == '\t' || i == '\'')
+        f |= LEX_SYMBOL;
+      ucFlags[i] = f;
+    }
+  }
+  inline bool Is(unsigned char c, unsigned char flag) const {
+    return (ucFlags[c] & flag) != 0;
+  }
+
+private:
+  unsigned char ucFlags[256];
+};
+static const LexCharTable LexChars;
+
+// offset of the first of a, b, c, \n or \0 in s[pos, len) or len if
+// there is none - most of an MDL file is comments and sketch information
+// that is only looked at for a handful of delimiters so do this 16 bytes
+// at a time where we can
+static off_t ScanForAny(const char *s, off_t pos, off_t len, char a, char b, char c) {
+#if defined(__SSE2__)
+  const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+  const __m128i vn = _mm_set1_epi8('\n'), vz = _mm_setzero_si128();
+  for (; pos + 16 <= len; pos += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + pos));
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+                               _mm_or_si128(_mm_cmpeq_epi8(v, vc), _mm_cmpeq_epi8(v, vn)));
+    int mask = _mm_movemask_epi8(_mm_or_si128(hit, _mm_cmpeq_epi8(v, vz)));
+    if (mask)
+      return pos + __builtin_ctz(mask);
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  const uint8x16_t va = vdupq_n_u8(a), vb = vdupq_n_u8(b), vc = vdupq_n_u8(c), vn = vdupq_n_u8('\n');
+  for (; pos + 16 <= len; pos += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(s + pos));
+    uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)), vorrq_u8(vceqq_u8(v, vc), vceqq_u8(v, vn)));
+    if (vmaxvq_u8(vorrq_u8(hit, vceqzq_u8(v))))
+      break;  // the loop below finds which one
+  }
+#elif defined(__wasm_simd128__)
+  const v128_t va = wasm_i8x16_splat(a), vb = wasm_i8x16_splat(b), vc = wasm_i8x16_splat(c);
+  const v128_t vn = wasm_i8x16_splat('\n'), vz = wasm_i8x16_splat(0);
+  for (; pos + 16 <= len; pos += 16) {
+    v128_t v = wasm_v128_load(s + pos);
+    v128_t hit = wasm_v128_or(wasm_v128_or(wasm_i8x16_eq(v, va), wasm_i8x16_eq(v, vb)),
+                              wasm_v128_or(wasm_i8x16_eq(v, vc), wasm_i8x16_eq(v, vn)));
+    int mask = wasm_i8x16_bitmask(wasm_v128_or(hit, wasm_i8x16_eq(v, vz)));
+    if (mask)
+      return pos + __builtin_ctz(mask);
+  }
+#endif
+  for (; pos < len; pos++) {
+    char d = s[pos];
+    if (d == a || d == b || d == c || d == '\n' || !d)
+      break;
+  }
+  return pos;
+}
+
+VensimLex::VensimLex(VensimParse *parse) {
+  pVensimParse = parse;
   ucContent = NULL;
+  pRead = NULL;
+  pReadContext = NULL;
+  bReadDone = true;
+  bTokenView = false;
+  iTokenStart = 0;
+  iTokenLength = 0;
   iCurPos = iFileLength = 0;
+  iDropped = 0;
+  bChunk = false;
   GetReady();
 }
 VensimLex::~VensimLex() {
 }
 void VensimLex::Initialize(const char *content, off_t length) {
+  InitializeChunk(content, length);
+  bChunk = false;
+  XMUTIL_COUNT(inputBytes, length);
+}
+// the chunks are parts of an MDL already counted as a whole
+void VensimLex::InitializeChunk(const char *content, off_t length) {
+  bChunk = true;
+  pRead = NULL;
+  bReadDone = true;
   ucContent = content;
   iFileLength = length;
   iLineStart = iCurPos = 0;
+  iDropped = 0;
+  iLineNumber = 1;
+  vLineSteps.clear();
+  GetReady();
+}
+void VensimLex::Initialize(XMUtilReader read, void *context) {
+  bChunk = false;
+  pRead = read;
+  pReadContext = context;
+  bReadDone = false;
+  vWindow.clear();
+  ucContent = vWindow.data();
+  iFileLength = 0;
+  iLineStart = iCurPos = 0;
+  iHoldPos = iHoldStart = 0;
+  iDropped = 0;
   iLineNumber = 1;
+  vLineSteps.clear();
   GetReady();
 }
+
+#define LEX_READ_SIZE 65536  // asked of the reader at a time
+
+bool VensimLex::Fill(void) {
+  if (!Pending())
+    return false;
+  vWindow.resize(iFileLength + LEX_READ_SIZE);
+  size_t len = pRead(pReadContext, vWindow.data() + iFileLength, LEX_READ_SIZE);
+  vWindow.resize(iFileLength + len);
+  ucContent = vWindow.data();
+  if (!len) {
+    bReadDone = true;
+    return false;
+  }
+  iFileLength += len;
+  XMUTIL_COUNT(inputBytes, len);
+  return true;
+}
+
+// once enough has been read past the lexed part at the start of the window
+// is moved out - its capacity stays for what is read next
+void VensimLex::DropConsumed(void) {
+  if (!pRead || iCurPos < LEX_READ_SIZE)
+    return;
+  off_t drop = iCurPos;
+  vWindow.erase(vWindow.begin(), vWindow.begin() + drop);
+  ucContent = vWindow.data();
+  iFileLength -= drop;
+  iDropped += drop;
+  iCurPos = 0;
+  iLineStart -= drop;  // may now be before the window - only differences are used
+  iHoldPos -= drop;
+  iHoldStart -= drop;
+  iTokenStart -= drop;
+  vLineSteps.clear();  // no PushBack goes back past a token start
+}
 int VensimLex::GetEndToken(void) {
   return VPTT_eqend;
 }
@@ -33,45 +192,96 @@ void VensimLex::GetReady(void) {
   bInUnits = false;
 }
 std::string *VensimLex::CurToken() {
+  if (bTokenView) {
+    sToken.assign(ucContent + iTokenStart, iTokenLength);
+    bTokenView = false;
+  }
   return &sToken;
 }
 
-int VensimLex::yylex() {
+double VensimLex::TokenNumber(void) {
+  return StringToDouble(TokenText(), TokenLength());
+}
+
+// past the colon keyword kw at s (upper case, with spaces matching any run
+// of spaces, tabs or underbars as KeywordMatch does) or NULL if it isn't
+// there, in which case stop (if given) is where the match failed
+static const char *MatchKeyword(const char *s, const char *end, const char *kw, const char **stop = NULL) {
+  for (; *kw; kw++) {
+    if (*kw == ' ') {
+      if (s == end || (*s != ' ' && *s != '_' && *s != '\t'))
+        break;
+      while (s < end && (*s == ' ' || *s == '_' || *s == '\t'))
+        s++;
+    } else if (s == end || toupper(static_cast<unsigned char>(*s)) != *kw)
+      break;
+    else
+      s++;
+  }
+  if (!*kw)
+    return s;
+  if (stop)
+    *stop = s;
+  return NULL;
+}
+
+// whether the len characters at s start with upper, ignoring case
+static bool StartsWithUpper(const char *s, size_t len, const char *upper) {
+  for (; *upper; upper++, s++, len--) {
+    if (!len || toupper(static_cast<unsigned char>(*s)) != *upper)
+      return false;
+  }
+  return true;
+}
+
+int VensimLex::yylex(ParseUnion *lvalp) {
+  if (ConversionLimits::Stop())
+    return 0;  // as if the input ended - a long equation stops part way
   int toktype = NextToken();
+  // the end a chunk is given isn't in the MDL (see ProcessChunks)
+  if (toktype != VPTT_eqend || !bChunk || iCurPos < iFileLength)
+    XMUTIL_COUNT(tokens, 1);
+  const char *tok = TokenText();
   switch (toktype) {
   case VPTT_literal:
-    vpyylval.lit = sToken.c_str();
+    lvalp->lit = sToken.c_str();
     break;
   case VPTT_number:
-    vpyylval.num = atof(sToken.c_str());
+    lvalp->num = TokenNumber();
     break;
   case VPTT_symbol:
     if (bInUnits) {
-      vpyylval.uni = VPObject->InsertUnitExpression(VPObject->InsertUnits(sToken));
       toktype = VPTT_units_symbol;
+      Units *units = pVensimParse->InsertUnits(tok, TokenLength());
+      if (!units)
+        return YYerror;  // the name is already something else
+      lvalp->uni = pVensimParse->InsertUnitExpression(units);
       break;
     }
     // special things here - try to do almost everything (including INTEG) as a function but some need to call out to
     // different toktypes
-    if ((sToken[0] == 'w' || sToken[0] == 'W') && (sToken[1] == 'i' || sToken[1] == 'I') &&
-        (sToken[2] == 't' || sToken[2] == 'T') && (sToken[3] == 'h' || sToken[3] == 'H') &&
-        (sToken[4] == ' ' || sToken[4] == ' ') && (sToken[5] == 'l' || sToken[5] == 'L') &&
-        (sToken[6] == 'o' || sToken[6] == 'O') && (sToken[7] == 'o' || sToken[7] == 'O') &&
-        (sToken[8] == 'k' || sToken[8] == 'K') && (sToken[9] == 'u' || sToken[9] == 'U') &&
-        (sToken[10] == 'p' || sToken[10] == 'P')) {
+    if (StartsWithUpper(tok, TokenLength(), "WITH LOOKUP")) {
       toktype = VPTT_with_lookup;
     } else {
-      vpyylval.sym = VPObject->InsertVariable(sToken);
-      if (vpyylval.sym->isType() == Symtype_Function) {
-        Function *f = static_cast<Function *>(static_cast<Symbol *>(vpyylval.sym));
+      lvalp->sym = pVensimParse->InsertVariable(tok, TokenLength());
+      if (!lvalp->sym)
+        return YYerror;
+      if (lvalp->sym->isType() == Symtype_Function) {
+        Function *f = static_cast<Function *>(static_cast<Symbol *>(lvalp->sym));
         if (f->AsKeyword()) {
-          return ReadTabbedArray();  // todo other keywords - this will return an ExpressionNumberTable
+          return ReadTabbedArray(lvalp);  // todo other keywords - this will return an ExpressionNumberTable
         } else
           toktype = VPTT_function;
       }
     }
 
     break;
+  case VPTT_units_symbol: {
+    Units *units = pVensimParse->InsertUnits(tok, TokenLength());
+    if (!units)
+      return YYerror;
+    lvalp->uni = pVensimParse->InsertUnitExpression(units);
+  } break;
   default:
     break;
   }
@@ -89,7 +299,7 @@ void VensimLex::GetDigits() {
   }
 }
 
-int VensimLex::ReadTabbedArray(void) {
+int VensimLex::ReadTabbedArray(ParseUnion *lvalp) {
   char c;
   int row;
   int toktype;
@@ -101,23 +311,39 @@ int VensimLex::ReadTabbedArray(void) {
     return c;
   }
   // then just numbers - tab or space separated with new lines
-  ExpressionNumberTable *ent = new ExpressionNumberTable(VPObject->GetSymbolNameSpace());
+  ExpressionNumberTable *ent = new ExpressionNumberTable(pVensimParse->GetSymbolNameSpace());
+  // size the table from the number of whitespace separated words up to the ')'
+  size_t words = 0;
+  bool inword = false;
+  for (off_t i = iCurPos; i < iFileLength && ucContent[i] != ')' && ucContent[i] != '~'; i++) {
+    bool space = ucContent[i] == ' ' || ucContent[i] == '\t' || ucContent[i] == '\r' || ucContent[i] == '\n';
+    if (!space && !inword)
+      words++;
+    inword = !space;
+  }
+  ent->Reserve(words);
   row = 0;
   while ((toktype = NextToken())) {
+    double sign = 1;
     if ((toktype == '+' || toktype == '-')) {
+      if (toktype == '-')
+        sign = -1;
       if (NextToken() == VPTT_number) {
-        vpyylval.num = -vpyylval.num;
         toktype = VPTT_number;
-      } else
-        throw "Bad numbers";
+      } else {
+        pVensimParse->SyntaxError("Bad numbers");
+        return YYerror;
+      }
     }
     if (toktype == ')') {  // finished
-      vpyylval.exn = ent;
+      lvalp->exn = ent;
       return VPTT_tabbed_array;
     }
-    if (toktype != VPTT_number)
-      throw "Bad numbers";
-    ent->AddValue(row, vpyylval.num);
+    if (toktype != VPTT_number) {
+      pVensimParse->SyntaxError("Bad numbers");
+      return YYerror;
+    }
+    ent->AddValue(row, sign * TokenNumber());
     // test for \n
     while ((c = GetNextChar(false))) {
       if (c == '\n') {
@@ -144,15 +370,73 @@ int VensimLex::ReadTabbedArray(void) {
 int VensimLex::NextToken()  // also sets token type
 {
   unsigned char c;
-  int toktype;
 
+  DropConsumed();
   do {
     c = GetNextChar(false);
-  } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');  // consume whitespace
+  } while (LexChars.Is(c, LEX_SPACE));  // consume whitespace
   if (!c)
+    return bChunk && iCurPos >= iFileLength ? VPTT_eqend : 0;
+  int toktype = ScanToken(c);
+  if (toktype)
+    return toktype;
+  return AssembleToken(c);
+}
+
+// symbols and numbers make up most of the tokens - when they can be read
+// without continuation lines they are left as views into
+// ucContent rather than being copied.  returns 0 if the character at a
+// time route is needed
+int VensimLex::ScanToken(unsigned char c) {
+  off_t start = iCurPos - 1;
+  off_t end = iCurPos;
+  int toktype;
+  if (LexChars.Is(c, LEX_SYMSTART) || ((iInUnitsComment == 1) && c == '$')) {
+    while (Fill(end) && LexChars.Is(ucContent[end], LEX_SYMBOL))
+      end++;
+    toktype = VPTT_symbol;
+  } else if ((LexChars.Is(c, LEX_DIGIT) && (c != '1' || !bInUnits)) || c == '.') {
+    if (c == '.' && (!Fill(end) || !LexChars.Is(ucContent[end], LEX_DIGIT)))
+      return 0;  // the plain '.'
+    while (Fill(end) && LexChars.Is(ucContent[end], LEX_DIGIT))
+      end++;
+    if (c != '.' && Fill(end) && ucContent[end] == '.') {
+      end++;
+      while (Fill(end) && LexChars.Is(ucContent[end], LEX_DIGIT))
+        end++;
+    }
+    if (Fill(end) && (ucContent[end] == 'E' || ucContent[end] == 'e')) {  // xxx.xxxE+-xx
+      end++;
+      if (Fill(end) && (ucContent[end] == '+' || ucContent[end] == '-'))
+        end++;
+      while (Fill(end) && LexChars.Is(ucContent[end], LEX_DIGIT))
+        end++;
+    }
+    toktype = VPTT_number;
+  } else
     return 0;
+  if (Fill(end) && ucContent[end] == '\\')
+    return 0;  // may be a continuation line
+  iCurPos = end;
+  if (toktype == VPTT_symbol) {
+    // strip any terminal spaces
+    while (ucContent[end - 1] == ' ' || ucContent[end - 1] == '_')
+      end--;
+  }
+  bTokenView = true;
+  iTokenStart = start;
+  iTokenLength = end - start;
+  return toktype;
+}
+
+// everything else - built up a character at a time in sToken
+int VensimLex::AssembleToken(unsigned char c) {
+  int toktype;
+
+  bTokenView = false;
   sToken.clear();
   PushBack(c, false);
+  off_t start = iCurPos;  // where the markers go back to
   c = GetNextChar(true);
 
   toktype = c;  // default for many tokens
@@ -197,9 +481,7 @@ int VensimLex::NextToken()  // also sets token type
   case '/':
     // either / or ///---\\\      but skip last \ because continuation line chars will mess thigns up xxx
     if (TestTokenMatch("//---\\\\", false)) {
-      assert(!sBuffer.length());
-      sBuffer = "///---\\\\";
-      iCurPos--;          // back up - wont be a problem with continuation lines in this case
+      iCurPos = start;    // MarkerLine reads the marker line from its start
       return VPTT_eqend;  // finished normal parse
     }
     break;
@@ -242,8 +524,7 @@ int VensimLex::NextToken()  // also sets token type
     break;
   case '1':
     if (bInUnits) {
-      vpyylval.uni = VPObject->InsertUnitExpression(VPObject->InsertUnits("1"));
-      return VPTT_units_symbol;
+      return VPTT_units_symbol;  // sToken is "1" - yylex fills in the unit expression
     }
     /* fallthrough */
   case '.':  // maybe a number check next digit
@@ -264,6 +545,7 @@ int VensimLex::NextToken()  // also sets token type
         PushBack(c, true);
         break;  // not a number return '.'
       }
+      GetDigits();
     } else {
       GetDigits();
       c = GetNextChar(true);
@@ -335,7 +617,7 @@ int VensimLex::NextToken()  // also sets token type
       }
     }
     ReturnToMark();  // failed to find pair give up
-  } break;           // give up and just return the one char - will throw error message
+  } break;           // give up and just return the one char - the parser will report it
   case '\'':         // vensim literal - just look for matching '
   {
     int len;
@@ -364,16 +646,14 @@ int VensimLex::NextToken()  // also sets token type
     break;    // give up and just return the one char
   case '\\':  // either \\\---/// or a continuation line or an error
     if (TestTokenMatch("\\\\---///", false)) {
-      assert(!sBuffer.length());
-      sBuffer = "\\\\\\---///";
-      iCurPos--;          // back up - wont be a problem with continuation lines in this case
+      iCurPos = start;
       return VPTT_eqend;  // finished normal parse
     }
     break;
   default:                                                                // a variable name or an unrecognizable token
-    if (isalpha(c) || c > 127 || ((iInUnitsComment == 1) && c == '$')) {  // a variable
+    if (LexChars.Is(c, LEX_SYMSTART) || ((iInUnitsComment == 1) && c == '$')) {  // a variable
       while ((c = GetNextChar(true))) {
-        if (!isalnum(c) && c != ' ' && c != '_' && c != '$' && c != '\t' && c != '\'' && c < 128) {
+        if (!LexChars.Is(c, LEX_SYMBOL)) {
           PushBack(c, true);
           break;
         }
@@ -391,32 +671,55 @@ int VensimLex::TestColonKeyword() {
   // := :AND:  :HOLD BACKWARD: :IMPLIES: :INTERPOLATE: :LOOK FORWARD: :OR: :NA:  :NOT: :RAW: :TEST INPUT: :THE
   // CONDITION:
 
-  const char *keywords[] = {
-      ":AND:",   ":END OF MACRO:", ":EXCEPT:", ":HOLD BACKWARD:", ":IMPLIES:", ":INTERPOLATE:", ":LOOK FORWARD:",
-      ":MACRO:", ":OR:",           ":NA:",     ":NOT:",           ":RAW:",     ":TESTINPUT:",   ":THECONDITION:",
-      NULL};
-
-  int keyvals[] = {VPTT_and,
-                   VPTT_end_of_macro,
-                   VPTT_except,
-                   VPTT_hold_backward,
-                   VPTT_implies,
-                   VPTT_interpolate,
-                   VPTT_look_forward,
-                   VPTT_macro,
-                   VPTT_or,
-                   VPTT_na,
-                   VPTT_not,
-                   VPTT_raw,
-                   VPTT_test_input,
-                   VPTT_the_condition,
-                   -1};
-  int i;
+  static const struct {
+    const char *keyword;  // after the leading colon
+    int toktype;
+  } keywords[] = {{"AND:", VPTT_and},
+                  {"END OF MACRO:", VPTT_end_of_macro},
+                  {"EXCEPT:", VPTT_except},
+                  {"HOLD BACKWARD:", VPTT_hold_backward},
+                  {"IMPLIES:", VPTT_implies},
+                  {"INTERPOLATE:", VPTT_interpolate},
+                  {"LOOK FORWARD:", VPTT_look_forward},
+                  {"MACRO:", VPTT_macro},
+                  {"OR:", VPTT_or},
+                  {"NA:", VPTT_na},
+                  {"NOT:", VPTT_not},
+                  {"RAW:", VPTT_raw},
+                  {"TESTINPUT:", VPTT_test_input},
+                  {"THECONDITION:", VPTT_the_condition}};
+  const int count = sizeof(keywords) / sizeof(keywords[0]);
+
+  // the characters GetNextChar would give are the ones in the content, so
+  // match there without taking and returning them one at a time.  Only a
+  // backslash (which might start a continuation line) needs the slow way
+  if (iCurPos < iFileLength && ucContent[iCurPos] != '\\') {
+    const char *s = ucContent + iCurPos;
+    const char *end = ucContent + iFileLength;
+    char first = toupper(static_cast<unsigned char>(*s));
+    bool escaped = false;
+    for (int i = 0; i < count; i++) {
+      if (first != keywords[i].keyword[0])
+        continue;
+      const char *stop;
+      const char *past = MatchKeyword(s, end, keywords[i].keyword, &stop);
+      if (past) {
+        sToken.append(s, past - s);
+        iCurPos += past - s;
+        return keywords[i].toktype;
+      }
+      if (stop < end ? *stop == '\\' : Pending())
+        escaped = true;  // or it might go on past the window
+    }
+    if (!escaped)
+      return ':';
+  }
+
   char c = GetNextChar(true);
-  for (i = 0; keywords[i]; i++) {
-    if (toupper(c) == keywords[i][1]) {
-      if (KeywordMatch(keywords[i] + 2))
-        return keyvals[i];
+  for (int i = 0; i < count; i++) {
+    if (toupper(c) == keywords[i].keyword[0]) {
+      if (KeywordMatch(keywords[i].keyword + 1))
+        return keywords[i].toktype;
     }
   }
   PushBack(c, true);
@@ -457,19 +760,14 @@ bool VensimLex::KeywordMatch(const char *target) {
 
 char VensimLex::GetNextChar(bool store) {
   char c;
-  if (sBuffer.length()) {
-    c = sBuffer.back();
-    sBuffer.pop_back();
-    if (store)
-      sToken.push_back(c);
-    return c;
-  }
-  if (iCurPos >= iFileLength)
+  if (!Fill(iCurPos))
     return 0;  // nothing to do
+  off_t from = iCurPos;
   c = ucContent[iCurPos++];
   if (c == '\\') {  // check for continuation lines
-    if (iCurPos < iFileLength && (ucContent[iCurPos] == '\n' || ucContent[iCurPos] == '\r')) {
-      for (; iCurPos < iFileLength;) {
+    if (Fill(iCurPos) && (ucContent[iCurPos] == '\n' || ucContent[iCurPos] == '\r')) {
+      LineStep step = {from, 0, iLineNumber, iLineStart};
+      for (; Fill(iCurPos);) {
         c = ucContent[iCurPos++];
         if (c == '\n') {
           iLineNumber++;
@@ -478,8 +776,12 @@ char VensimLex::GetNextChar(bool store) {
           break;
         // note as in vensim two \ line ends in a row just cause an error
       }
+      step.iTo = iCurPos;
+      AddLineStep(step);
     }
   } else if (c == '\n') {
+    LineStep step = {from, iCurPos, iLineNumber, iLineStart};
+    AddLineStep(step);
     iLineNumber++;
     iLineStart = iCurPos;  // actually the next pos
   }
@@ -488,6 +790,14 @@ char VensimLex::GetNextChar(bool store) {
   return c;
 }
 
+void VensimLex::AddLineStep(const LineStep &step) {
+  // nothing pushes back more than a few characters, so only the latest
+  // steps are ever needed
+  if (vLineSteps.size() >= 64)
+    vLineSteps.erase(vLineSteps.begin(), vLineSteps.begin() + 32);
+  vLineSteps.push_back(step);
+}
+
 // check for token match - advance position on success
 bool VensimLex::TestTokenMatch(const char *tok, bool storeonsuccess) {
   char c;
@@ -510,7 +820,13 @@ bool VensimLex::TestTokenMatch(const char *tok, bool storeonsuccess) {
 std::string VensimLex::GetComment(const char *tok) {
   char c;
   std::string rval;
-  while ((c = GetNextChar(false))) {
+  while (true) {
+    // take everything up to a possible delimiter in one go
+    off_t end = ScanForAny(ucContent, iCurPos, iFileLength, *tok, '\\', '\\');
+    rval.append(ucContent + iCurPos, end - iCurPos);
+    iCurPos = end;
+    if (!(c = GetNextChar(false)))
+      break;
     if (c == *tok && TestTokenMatch(tok + 1, true)) {
       PushBack(c, false);  // next call to findToken will find this
       // strip trailing white space
@@ -523,7 +839,6 @@ std::string VensimLex::GetComment(const char *tok) {
       return rval;
     } else if (c == '\\' && TestTokenMatch("\\\\---///", false)) {
       PushBack(c, false);
-      SyncBuffers();
       return rval;  // an error
     }
     rval.push_back(c);
@@ -533,70 +848,177 @@ std::string VensimLex::GetComment(const char *tok) {
 
 bool VensimLex::FindToken(const char *tok) {
   char c;
-  while ((c = GetNextChar(false))) {
+  while (true) {
+    // skip to a possible delimiter in one go
+    iCurPos = ScanForAny(ucContent, iCurPos, iFileLength, *tok, '\\', '/');
+    if (!(c = GetNextChar(false)))
+      break;
     if (c == *tok && TestTokenMatch(tok + 1, true))
       return true;
     else if (c == '\\' && TestTokenMatch("\\\\---///", false)) {
       PushBack(c, false);
-      SyncBuffers();
       return false;
     } else if (c == '/')
       if (TestTokenMatch("//---\\\\", false)) {
         PushBack(c, false);
-        SyncBuffers();
         return false;
       }
   }
   return false;
 }
 
-bool VensimLex::BufferReadLine(char *buf, size_t buflen) {
-  const char *tv = sBuffer.c_str();
-  while (buflen > 0 && *tv) {
-    *buf = *tv;
-    buf++;
-    buflen--;
-    tv++;
+// past the close of the quoted name, {comment} or 'literal' opened by c
+// just before p - or p itself if it isn't closed within 1024 characters, in
+// which case the tokenizer takes c as a character of its own
+static const char *SkipQuoted(char c, const char *p, const char *end) {
+  char close = c == '{' ? '}' : c;
+  int nesting = 1;
+  for (const char *q = p; q < end && q - p < 1024; q++) {
+    if (c == '"' && *q == '\\')
+      q++;
+    else if (c == '{' && *q == '{')
+      nesting++;
+    else if (*q == close && !--nesting)
+      return q + 1;
   }
-  return ReadLine(buf, buflen);
+  return p;
 }
-bool VensimLex::ReadLine(char *buf, size_t buflen) {
-  char c;
-  buflen--;  // need \0
-  size_t off = 0;
-  while (iCurPos < iFileLength) {
-    c = ucContent[iCurPos++];
-    if (off >= buflen) {
-      iCurPos--;
-      buf[off] = 0;
-      return true;
+
+bool VensimLex::SplitEquations(const char *content, size_t length, std::vector<VensimSpan> &chunks) {
+  const char *end = content + length;
+  const char *start = content;
+  const char *p = content;
+  int part = 0;         // 0 the equation, 1 the units, 2 the comment text
+  bool atStart = true;  // nothing but white space since the last chunk
+  bool inMacro = false;
+  bool macros = false;
+  while (p < end) {
+    char c = *p;
+    if ((c == '\\' && end - p >= 9 && !memcmp(p, "\\\\\\---///", 9)) ||
+        (c == '/' && end - p >= 9 && !memcmp(p, "///---\\\\\\", 9)))
+      break;
+    if (atStart) {
+      if (LexChars.Is(c, LEX_SPACE)) {
+        p++;
+        continue;
+      } else if (c == '{') {  // {UTF-8} and the like don't start anything
+        p = SkipQuoted(c, p + 1, end);
+        continue;
+      }
+      atStart = false;
+      const char *after;
+      if (c == ':' && MatchKeyword(p, end, ":MACRO:"))
+        inMacro = macros = true;
+      else if (inMacro && c == ':' && (after = MatchKeyword(p, end, ":END OF MACRO:"))) {
+        // the whole definition goes to the one parse, which switches name spaces for it
+        p = after;
+        chunks.push_back(VensimSpan(start, p));
+        start = p;
+        inMacro = false;
+        atStart = true;
+        continue;
+      } else if (c == '*' && end - p >= 3 && p[1] == '*' && p[2] == '*')
+        part = 2;  // a group header - read up to the | with no tokenizing
     }
-    if (c == '\n') {
-      buf[off] = 0;
-      if (iCurPos < iFileLength && ucContent[iCurPos] == '\r')
-        iCurPos++;
-      return true;
+    p++;
+    if (part == 2) {
+      if (c != '|')
+        continue;
+    } else if (c == '~') {
+      part++;
+      continue;
+    } else if (c == '"' || c == '{' || (c == '\'' && (p - 1 == content || !LexChars.Is(p[-2], LEX_SYMBOL)))) {
+      p = SkipQuoted(c, p, end);
+      continue;
+    } else if (c != '|')
+      continue;
+    // an equation ends here
+    part = 0;
+    atStart = true;
+    if (!inMacro) {
+      chunks.push_back(VensimSpan(start, p));
+      start = p;
     }
-    if (c == '\r') {
-      buf[off] = 0;
-      if (iCurPos < iFileLength && ucContent[iCurPos] == '\n')
-        iCurPos++;
-      return true;
+  }
+  if (start < p)
+    chunks.push_back(VensimSpan(start, p));
+  chunks.push_back(VensimSpan(p, end));
+  return macros;
+}
+
+// a look ahead that does not move the read position - the count stops at
+// the end of the equation so a missing ')' costs nothing extra
+size_t VensimLex::CountAhead(char c) {
+  size_t count = 0;
+  int depth = 0;
+  for (off_t i = iCurPos; i < iFileLength; i++) {
+    char d = ucContent[i];
+    if (d == '~' || d == '|')
+      break;
+    if (d == c && !depth)
+      count++;
+    if (d == '(')
+      depth++;
+    else if (d == ')' && --depth < 0)
+      break;
+  }
+  return count;
+}
+
+// go through the equation part of the file the way the parser would but
+// without looking anything up - this lets the cost of tokenizing be
+// measured on its own.  returns the number of tokens seen
+int VensimLex::SkimTokens(void) {
+  int count = 0;
+  int toktype;
+  GetReady();
+  while ((toktype = NextToken()) && toktype != VPTT_eqend) {
+    count++;
+    if (toktype == '~' && iInUnitsComment > 1) {  // the comment follows as text
+      GetComment("|");
+      FindToken("|");
+      GetReady();
     }
-    buf[off++] = c;
   }
-  buf[0] = 0;
-  return false;
+  return count;
+}
+
+// the lexer left iCurPos at the start of the marker - read the line from there
+bool VensimLex::MarkerLine(VensimSpan &line) {
+  while (Fill())
+    ;  // the rest is read as spans into the window so it can't move again
+  return NextLine(line);
+}
+bool VensimLex::NextLine(VensimSpan &line) {
+  if (iCurPos >= iFileLength) {
+    line = VensimSpan();
+    return false;
+  }
+  off_t end = iCurPos;
+  while ((end = ScanForAny(ucContent, end, iFileLength, '\r', '\r', '\r')) < iFileLength && ucContent[end] != '\r' &&
+         ucContent[end] != '\n')
+    end++;  // a stray nul
+  line = VensimSpan(ucContent + iCurPos, ucContent + end);
+  iCurPos = end;
+  if (iCurPos < iFileLength) {  // \n\r and \r\n are one line end as well
+    char c = ucContent[iCurPos++];
+    if (iCurPos < iFileLength && ucContent[iCurPos] == (c == '\n' ? '\r' : '\n'))
+      iCurPos++;
+  }
+  return true;
 }
 
 void VensimLex::PushBack(char c, bool store) {
-  assert(c);
-  sBuffer.push_back(c);
+  if (!c)
+    return;  // GetNextChar hit the end of the input - nothing was taken
+  if (!vLineSteps.empty() && vLineSteps.back().iTo == iCurPos) {
+    const LineStep &step = vLineSteps.back();
+    iCurPos = step.iFrom;
+    iLineNumber = step.iLineNumber;
+    iLineStart = step.iLineStart;
+    vLineSteps.pop_back();
+  } else
+    iCurPos--;
   if (store)
     sToken.pop_back();
 }
-void VensimLex::SyncBuffers(void) {
-  int i = sBuffer.length();
-  iCurPos -= i;
-  sBuffer.clear();
-}
@@ -4,19 +4,75 @@
 /* a tokenizer for Vensim files - it is called by VensimPare both
   indirectly throught the Bison generated parser and directly for
   comments and group defs */
+#include <string.h>
+
 #include <string>
 #include <vector>
 
 #include "../Symbol/Parse.h"
+#include "../XMUtil.h"
+
+class VensimParse;
+
+/* VensimSpan - a piece of the file contents, used to read the sketch a line
+  at a time without copying it or splitting long lines - the fields are
+  taken off the front by VensimParse::GetInt and friends */
+class VensimSpan {
+public:
+  VensimSpan(void) : pBegin(""), pEnd(pBegin) {
+  }
+  VensimSpan(const char *begin, const char *end) : pBegin(begin), pEnd(end) {
+  }
+  const char *Begin(void) const {
+    return pBegin;
+  }
+  const char *End(void) const {
+    return pEnd;
+  }
+  size_t Length(void) const {
+    return pEnd - pBegin;
+  }
+  char First(void) const {
+    return pBegin < pEnd ? *pBegin : 0;
+  }
+  bool StartsWith(const char *prefix) const {
+    size_t len = strlen(prefix);
+    return Length() >= len && !memcmp(pBegin, prefix, len);
+  }
+  VensimSpan From(size_t off) const {
+    return VensimSpan(off < Length() ? pBegin + off : pEnd, pEnd);
+  }
+  std::string ToString(void) const {
+    return std::string(pBegin, pEnd);
+  }
+
+private:
+  const char *pBegin;
+  const char *pEnd;
+};
 
 class VensimLex {
 public:
-  VensimLex(void);
+  VensimLex(VensimParse *parse);
   ~VensimLex(void);
   void Initialize(const char *content, off_t length);
+  // the contents come from read a piece at a time instead, held in a window
+  // that only keeps what is needed for the token being read - everything
+  // from the sketch marker on is read in whole as the views are read with
+  // spans into it
+  void Initialize(XMUtilReader read, void *context);
+  // for one of the chunks SplitEquations gives - its end reads as the
+  // marker ending the equations would
+  void InitializeChunk(const char *content, off_t length);
+  // on to pos, the start of a line, without reading what is before it -
+  // line numbers are out from then on
+  void SkipTo(off_t pos) {
+    iCurPos = iLineStart = pos;
+    vLineSteps.clear();
+  }
   std::string *CurToken(void);
   void GetReady(void);
-  int yylex(void);
+  int yylex(ParseUnion *lvalp);
   int GetEndToken(void);
   int LineNumber(void) {
     return iLineNumber;
@@ -24,28 +80,91 @@ public:
   int Position(void) {
     return iCurPos - iLineStart;
   }
+  size_t BytesRead(void) const {  // from the start of the file
+    return iDropped + iCurPos;
+  }
   std::string GetComment(const char *tok);
   bool FindToken(const char *tok);
-  bool BufferReadLine(char *buf, size_t buflen);  // start with buffer then read the line
-  bool ReadLine(char *buf, size_t buflen);        // read a line if enough room otherwise part of it
+  bool MarkerLine(VensimSpan &line);  // the line with the marker the equations stopped at
+  bool NextLine(VensimSpan &line);    // false at the end of the file
+  int SkimTokens(void);  // tokenize the equations without building anything - for timing
+  size_t CountAhead(char c);  // occurrences of c before the ')' closing the current group
+  // splits the equations in content into the pieces the parser takes one
+  // at a time - each ends with the '|' closing an equation, a group header
+  // or a whole macro definition.  Quoted names, {comments}, 'literals' and
+  // the comment text after the second ~ are passed over, and the last chunk
+  // is everything from the sketch or settings marker (possibly empty).
+  // Returns whether any chunk is a macro definition
+  static bool SplitEquations(const char *content, size_t length, std::vector<VensimSpan> &chunks);
 private:
   char GetNextChar(bool store);
-  void PushBack(char c, bool store);
-  void SyncBuffers(void);
+  void PushBack(char c, bool store);  // c must be the last character GetNextChar returned
   bool TestTokenMatch(const char *tok, bool update);
+  int ScanToken(unsigned char c);
+  int AssembleToken(unsigned char c);
+  // the current token is either a view straight into ucContent (the usual
+  // case for symbols and numbers) or, when it had to be assembled a
+  // character at a time, the contents of sToken - neither is terminated
+  const char *TokenText(void) {
+    return bTokenView ? ucContent + iTokenStart : sToken.c_str();
+  }
+  size_t TokenLength(void) {
+    return bTokenView ? iTokenLength : sToken.length();
+  }
+  double TokenNumber(void);
+  // with a reader - more of the file on the end of the window, false if
+  // there is no more.  Positions stay the same but ucContent may move
+  bool Fill(void);
+  bool Fill(off_t pos) {  // pos is in the window if it is in the file
+    while (pos >= iFileLength) {
+      if (!Fill())
+        return false;
+    }
+    return true;
+  }
+  bool Pending(void) const {  // the window may not end where the file does
+    return pRead && !bReadDone;
+  }
+  void DropConsumed(void);  // only between tokens - nothing before iCurPos is looked at again
+  XMUtilReader pRead;
+  void *pReadContext;
+  bool bReadDone;
+  std::vector<char> vWindow;
+  bool bTokenView;
+  off_t iTokenStart;
+  size_t iTokenLength;
   std::string sToken;
-  std::string sBuffer;
   const char *ucContent;
   off_t iCurPos, iHoldPos;
+  off_t iDropped;  // moved out of the front of the window
   off_t iLineStart, iHoldStart;
+  int iHoldLine;
   void MarkPosition(void) {
     iHoldPos = iCurPos;
     iHoldStart = iLineStart;
+    iHoldLine = iLineNumber;
   }
   void ReturnToMark(void) {
     iCurPos = iHoldPos;
     iLineStart = iHoldStart;
-    sBuffer.clear();
+    iLineNumber = iHoldLine;
+    ForgetLineSteps();
+  }
+  // characters are only ever pushed back by moving iCurPos back over them -
+  // reads that went past a newline or a continuation line are noted, most
+  // recent last, so PushBack knows where the read started and what the line
+  // count was before it
+  struct LineStep {
+    off_t iFrom;
+    off_t iTo;
+    int iLineNumber;
+    off_t iLineStart;
+  };
+  std::vector<LineStep> vLineSteps;
+  void AddLineStep(const LineStep &step);
+  void ForgetLineSteps(void) {  // those for reads past where iCurPos is now
+    while (!vLineSteps.empty() && vLineSteps.back().iTo > iCurPos)
+      vLineSteps.pop_back();
   }
   int iLineNumber;
   off_t iFileLength;
@@ -54,8 +173,10 @@ private:
   void GetDigits(void);
   int iInUnitsComment;  // 0 no, 1 units, 2 comment
   int TestColonKeyword(void);
-  int ReadTabbedArray(void);
+  int ReadTabbedArray(ParseUnion *lvalp);
   bool bInUnits;
+  VensimParse *pVensimParse;  // owner - looks up symbols for tokens
+  bool bChunk;                 // see InitializeChunk
 };
 
 #endif
@@ -6,112 +6,127 @@
 #include "VensimParse.h"
 
 #include <cstring>
+#include <memory>
 
 #include "../Symbol/ExpressionList.h"
 #include "../Symbol/LeftHandSide.h"
+#include "../Limits.h"
+#include "../Progress.h"
+#include "../Stats.h"
 #include "../Symbol/Variable.h"
-#define YYSTYPE VensimParse
+#include "../Workers.h"
+#define YYSTYPE ParseUnion
 #include "../XMUtil.h"
 #include "VYacc.tab.hpp"
 #include "VensimView.h"
 
-VensimParse *VPObject = NULL;
-
-VensimParse::VensimParse(Model *model) {
+VensimParse::VensimParse(Model *model) : mVensimLex(this) {
 #if YYDEBUG
   vpyydebug = 0;
 #endif
-  assert(!VPObject);
-  VPObject = this;
   _model = model;
   pSymbolNameSpace = model->GetNameSpace();
   bLongName = false;
+  pActiveVar = pEquationVar = NULL;
+  pParserState = vpyypstate_new();
+  iEquationEnd = 0;
+  bSyntaxError = false;
   ReadyFunctions();
 }
 VensimParse::~VensimParse(void) {
-  VPObject = NULL;
+  vpyypstate_delete(pParserState);
 }
 
-void VensimParse::ReadyFunctions() {
-  // initialize functions - actually need to split this up for common functions
-  // and those specific to Vensim - later
+// the functions are the same for every model so they are made just once, on
+// the heap rather than in the arena of whichever model comes first, and
+// then shared read only
+static SymbolNameSpace *MakeBuiltins(void) {
+  SymbolArena::Scope heap{nullptr};
+  SymbolNameSpace *sns = new SymbolNameSpace();
   try {
-    new FunctionMin(pSymbolNameSpace);
-    new FunctionMax(pSymbolNameSpace);
-    new FunctionInteg(pSymbolNameSpace);
-    new FunctionActiveInitial(pSymbolNameSpace);
-    new FunctionInitial(pSymbolNameSpace);
-    new FunctionReInitial(pSymbolNameSpace);
-    new FunctionSampleIfTrue(pSymbolNameSpace);
-    new FunctionPulse(pSymbolNameSpace);
-    new FunctionPulseTrain(pSymbolNameSpace);
-    new FunctionQuantum(pSymbolNameSpace);
-    new FunctionIfThenElse(pSymbolNameSpace);
-    new FunctionLog(pSymbolNameSpace);
-    new FunctionZidz(pSymbolNameSpace);
-    new FunctionXidz(pSymbolNameSpace);
-    new FunctionWithLookup(pSymbolNameSpace);  // but WITH_LOOKUP is treated specially by parser
-    new FunctionStep(pSymbolNameSpace);
-    new FunctionTabbedArray(pSymbolNameSpace);
-    new FunctionRamp(pSymbolNameSpace);
-    new FunctionLn(pSymbolNameSpace);
-    new FunctionSmooth(pSymbolNameSpace);
-    new FunctionSmoothI(pSymbolNameSpace);
-    new FunctionSmooth3(pSymbolNameSpace);
-    new FunctionTrend(pSymbolNameSpace);
-    new FunctionDelay1(pSymbolNameSpace);
-    new FunctionDelay1I(pSymbolNameSpace);
-    new FunctionDelay3(pSymbolNameSpace);
-    new FunctionDelay3I(pSymbolNameSpace);
-    new FunctionDelay(pSymbolNameSpace);
-    new FunctionDelayN(pSymbolNameSpace);
-    new FunctionSmoothN(pSymbolNameSpace);
-    new FunctionDelayConveyor(pSymbolNameSpace);
-    new FunctionVectorReorder(pSymbolNameSpace);
-    new FunctionRandomNormal(pSymbolNameSpace);
-    new FunctionRandomPoisson(pSymbolNameSpace);
-    new FunctionLookupArea(pSymbolNameSpace);
-    new FunctionLookupExtrapolate(pSymbolNameSpace);
-    new FunctionGetDataAtTime(pSymbolNameSpace);
-    new FunctionGetDataLastTime(pSymbolNameSpace);
-    new FunctionModulo(pSymbolNameSpace);
-    new FunctionNPV(pSymbolNameSpace);
-    new FunctionSum(pSymbolNameSpace);
-    new FunctionProd(pSymbolNameSpace);
-    new FunctionTimeBase(pSymbolNameSpace);
-    new FunctionVectorSelect(pSymbolNameSpace);
-    new FunctionVectorElmMap(pSymbolNameSpace);
-    new FunctionVectorSortOrder(pSymbolNameSpace);
-    new FunctionGame(pSymbolNameSpace);
-    new FunctionRandom01(pSymbolNameSpace);
-    new FunctionRandomUniform(pSymbolNameSpace);
-    new FunctionAbs(pSymbolNameSpace);
-    new FunctionExp(pSymbolNameSpace);
-    new FunctionSqrt(pSymbolNameSpace);
-
-    new FunctionCosine(pSymbolNameSpace);
-    new FunctionSine(pSymbolNameSpace);
-    new FunctionTangent(pSymbolNameSpace);
-    new FunctionArcCosine(pSymbolNameSpace);
-    new FunctionArcSine(pSymbolNameSpace);
-    new FunctionArcTangent(pSymbolNameSpace);
-    new FunctionInterger(pSymbolNameSpace);
-
-    new FunctionGetDirectData(pSymbolNameSpace);
-    new FunctionGetDataMean(pSymbolNameSpace);
-
-    pSymbolNameSpace->ConfirmAllAllocations();
+    new FunctionMin(sns);
+    new FunctionMax(sns);
+    new FunctionInteg(sns);
+    new FunctionActiveInitial(sns);
+    new FunctionInitial(sns);
+    new FunctionReInitial(sns);
+    new FunctionSampleIfTrue(sns);
+    new FunctionPulse(sns);
+    new FunctionPulseTrain(sns);
+    new FunctionQuantum(sns);
+    new FunctionIfThenElse(sns);
+    new FunctionLog(sns);
+    new FunctionZidz(sns);
+    new FunctionXidz(sns);
+    new FunctionWithLookup(sns);  // but WITH_LOOKUP is treated specially by parser
+    new FunctionStep(sns);
+    new FunctionTabbedArray(sns);
+    new FunctionRamp(sns);
+    new FunctionLn(sns);
+    new FunctionSmooth(sns);
+    new FunctionSmoothI(sns);
+    new FunctionSmooth3(sns);
+    new FunctionTrend(sns);
+    new FunctionDelay1(sns);
+    new FunctionDelay1I(sns);
+    new FunctionDelay3(sns);
+    new FunctionDelay3I(sns);
+    new FunctionDelay(sns);
+    new FunctionDelayN(sns);
+    new FunctionSmoothN(sns);
+    new FunctionDelayConveyor(sns);
+    new FunctionVectorReorder(sns);
+    new FunctionRandomNormal(sns);
+    new FunctionRandomPoisson(sns);
+    new FunctionLookupArea(sns);
+    new FunctionLookupExtrapolate(sns);
+    new FunctionGetDataAtTime(sns);
+    new FunctionGetDataLastTime(sns);
+    new FunctionModulo(sns);
+    new FunctionNPV(sns);
+    new FunctionSum(sns);
+    new FunctionProd(sns);
+    new FunctionTimeBase(sns);
+    new FunctionVectorSelect(sns);
+    new FunctionVectorElmMap(sns);
+    new FunctionVectorSortOrder(sns);
+    new FunctionGame(sns);
+    new FunctionRandom01(sns);
+    new FunctionRandomUniform(sns);
+    new FunctionAbs(sns);
+    new FunctionExp(sns);
+    new FunctionSqrt(sns);
+
+    new FunctionCosine(sns);
+    new FunctionSine(sns);
+    new FunctionTangent(sns);
+    new FunctionArcCosine(sns);
+    new FunctionArcSine(sns);
+    new FunctionArcTangent(sns);
+    new FunctionInterger(sns);
+
+    new FunctionGetDirectData(sns);
+    new FunctionGetDataMean(sns);
+
+    sns->ConfirmAllAllocations();
+    sns->Freeze();
   } catch (...) {
     // std::cerr << "Failed to initialize symbol table" << std::endl;
     assert(false);
   }
+  return sns;
+}
+
+void VensimParse::ReadyFunctions() {
+  static const SymbolNameSpace *builtins = MakeBuiltins();  // thread safe the first time too
+  pSymbolNameSpace->SetBuiltins(builtins);
 }
 Equation *VensimParse::AddEq(LeftHandSide *lhs, Expression *ex, ExpressionList *exl, int tok) {
   if (exl) {
     if (exl->Length() == 1) {
       ex = exl->GetExp(0);
       delete exl;
-    } else { /* only a list of numbers is valid here - throw exception for anything else */
+    } else { /* only a list of numbers is valid here - an error for anything else */
       ExpressionNumberTable *ent = new ExpressionNumberTable(pSymbolNameSpace);
       int n = exl->Length();
       int i;
@@ -121,8 +136,8 @@ Equation *VensimParse::AddEq(LeftHandSide *lhs, Expression *ex, ExpressionList *
           // alloe unary minus here
           ent->AddValue(0, -ex->GetArg(1)->Eval(NULL));  // note eval does not need context for number
         } else if (ex->GetType() != EXPTYPE_Number) {
-          mSyntaxError.str = "Expecting only comma delimited numbers ";
-          throw mSyntaxError;
+          SyntaxError("Expecting only comma delimited numbers ");
+          return NULL;
         } else
           ent->AddValue(0, ex->Eval(NULL));  // note eval does not need context for number
         delete ex;
@@ -143,7 +158,7 @@ Equation *VensimParse::AddTable(LeftHandSide *lhs, Expression *ex, ExpressionTab
     tbl->AddPair(1, 1);
     Variable *var = this->FindVariable("TIME");
     if (!var)
-      var = new Variable(this->pSymbolNameSpace, "TIME");
+      var = static_cast<Variable *>(pSymbolNameSpace->Kept(new Variable(pSymbolNameSpace, "TIME")));
     ex = new ExpressionVariable(this->pSymbolNameSpace, var, NULL);
   }
   if (legacy)
@@ -162,6 +177,13 @@ Equation *VensimParse::AddTable(LeftHandSide *lhs, Expression *ex, ExpressionTab
   against */
 void VensimParse::AddFullEq(Equation *eq, UnitExpression *un) {
   pSymbolNameSpace->ConfirmAllAllocations();  // now independently allocated
+  if (pChunkRead)
+    pChunkRead->vItems.push_back(ChunkItem{'|', eq, un, std::string()});
+  else
+    AddEquation(eq, un);
+}
+
+void VensimParse::AddEquation(Equation *eq, UnitExpression *un) {
   pActiveVar = eq->GetVariable();
   if (!_model->Groups().empty() && pActiveVar->GetAllEquations().empty() && !mInMacro)
     _model->Groups().back().vVariables.push_back(pActiveVar);
@@ -172,9 +194,26 @@ void VensimParse::AddFullEq(Equation *eq, UnitExpression *un) {
   }
 }
 
+void VensimParse::AddGroup(const std::string &name) {
+  // only change this if a new number
+  std::string group_owner;
+  char c = name.at(0);
+  if (_model->Groups().empty() || (_model->Groups().back().sName[0] != c && c >= '0' && c <= '9'))
+    group_owner = name;
+  else
+    group_owner = _model->Groups().back().sOwner;
+  _model->Groups().push_back(ModelGroup(name, group_owner));
+}
+
 int VensimParse::yyerror(const char *str) {
-  mSyntaxError.str = str;
-  throw mSyntaxError;
+  SyntaxError(str);
+  return 0;
+}
+
+void VensimParse::SyntaxError(const std::string &message) {
+  if (!bSyntaxError)  // the first is what went wrong
+    sSyntaxError = message;
+  bSyntaxError = true;
 }
 
 static std::string compress_whitespace(const std::string &s) {
@@ -203,65 +242,124 @@ static std::string compress_whitespace(const std::string &s) {
 
 bool VensimParse::ProcessFile(const std::string &filename, const char *contents, size_t contentsLen) {
   sFilename = filename;
+#ifndef XMUTIL_NO_THREADS
+  // a macro switches name spaces part way through, and shared expressions
+  // are found in file order, so those are only read in place - as is a
+  // file with no sketch or settings marker, which doesn't read
+  if (iThreads > 1 && !bShareExpressions) {
+    std::vector<VensimSpan> chunks;
+    if (!VensimLex::SplitEquations(contents, contentsLen, chunks) && chunks.back().Length()) {
+      std::vector<ChunkRead> reads;
+      return ProcessChunks(contents, contentsLen, chunks, reads);
+    }
+  }
+#endif
+  mVensimLex.Initialize(contents, contentsLen);
+  return ProcessContents();
+}
+
+bool VensimParse::ProcessStream(const std::string &filename, XMUtilReader read, void *context) {
+  sFilename = filename;
+  mVensimLex.Initialize(read, context);
+  return ProcessContents();
+}
 
+int VensimParse::ParseEquation(void) {
+  bSyntaxError = false;
+  if (!pParserState) {
+    SyntaxError("memory exhausted");
+    return -1;
+  }
+  ParseUnion lval;
+  int status;
+  iEquationEnd = 0;
+  do {
+    int tok = mVensimLex.yylex(&lval);
+    status = vpyypush_parse(pParserState, tok, &lval, this);
+  } while (status == YYPUSH_MORE);
+  if (status != 0) {
+    SyntaxError("syntax error");  // if nothing said what
+    return -1;
+  }
+  return iEquationEnd;
+}
+
+void VensimParse::ResetParser(void) {
+  // the stacks hold only pointers into the name space, whose unconfirmed
+  // allocations go with the equation
+  vpyypstate_delete(pParserState);
+  pParserState = vpyypstate_new();
+}
+
+// skipping the equation and looking for the next usable content - false
+// if there is none
+bool VensimParse::SkipEquation(const std::string &message) {
+  AddDiagnostic(message);
+  ForgetUnconfirmedShared();
+  pSymbolNameSpace->DeleteAllUnconfirmedAllocations();
+  return FindNextEq(false);
+}
+
+bool VensimParse::ProcessContents(void) {
   bool is_ok = true;
 
-  mVensimLex.Initialize(contents, contentsLen);
   int endtok = mVensimLex.GetEndToken();
-  // now we call the bison built parser which will call back to VensimLex
-  // for the tokenizing -
+  // now we push the tokens VensimLex gives to the bison built parser an
+  // equation at a time -
   int rval;
   do {
     rval = 0;
+    if (ConversionLimits::Stop())
+      break;  // ConvertMdl reports what stopped it
     try {
       mVensimLex.GetReady();
-      rval = vpyyparse();
-      if (rval == '~') {  // comment follows
+      pEquationVar = NULL;
+      {
+        XMUTIL_TIME(equationSeconds);
+        rval = ParseEquation();
+      }
+      if (rval < 0) {  // the parse was abandoned having noted why
+        is_ok = false;
+        if (!SkipEquation(sSyntaxError))
+          break;
+      } else if (rval == '~') {  // comment follows
         if (!FindNextEq(true))
           break;
       } else if (rval == '|') {
       } else if (rval == VPTT_groupstar) {
-        // fprintf(stderr, "%s\n", mVensimLex.CurToken()->c_str());
-        // only change this if a new number
-        std::string group_owner;
-        char c = mVensimLex.CurToken()->at(0);
-        if (_model->Groups().empty() || (_model->Groups().back().sName[0] != c && c >= '0' && c <= '9'))
-          group_owner = *mVensimLex.CurToken();
-        else
-          group_owner = _model->Groups().back().sOwner;
-        { _model->Groups().push_back(ModelGroup(*mVensimLex.CurToken(), group_owner)); }
+        AddGroup(*mVensimLex.CurToken());
       } else if (rval != endtok) {
         // std::cerr << "Unknown terminal token " << rval << std::endl;
         if (!FindNextEq(false))
           break;
       }
 
-    } catch (VensimParseSyntaxError &e) {
-      // std::cerr << e.str << std::endl;
-      // std::cerr << "Error at line " << mVensimLex.LineNumber() << " position " << mVensimLex.Position() << " in file
-      // "
-      //           << sFilename << std::endl;
-      // std::cerr << "(skipping the associated variable and looking for the next usable content)" << std::endl;
+    } catch (...) {  // only running out of memory throws
       is_ok = false;
-      pSymbolNameSpace->DeleteAllUnconfirmedAllocations();
-      if (!FindNextEq(false))
-        break;
-
-    } catch (...) {
-      is_ok = false;
-      pSymbolNameSpace->DeleteAllUnconfirmedAllocations();
-      if (!FindNextEq(false))
+      ResetParser();
+      if (!SkipEquation("unable to read equation"))
         break;
     }
+    ConversionProgress::Equation(mVensimLex.BytesRead());
   } while (rval != endtok);
-  char buf[BUFLEN];  // plenty big for sketch info
+  VensimSpan line;
   if (rval == endtok)
-    this->mVensimLex.BufferReadLine(buf, BUFLEN);  // get the marker line
-  while (true) {                                   // read in the sketch information
-    if (strncmp(buf, "\\\\\\---///", 9) != 0)
+    this->mVensimLex.MarkerLine(line);
+  ReadRest(line);
+  return is_ok;  // got something - try to put something out
+}
+
+void VensimParse::ReadViews(VensimSpan &line) {
+  if (bSkipViews && line.StartsWith("\\\\\\---///")) {
+    // straight to the settings - nothing but those needs the sketch read
+    while (this->mVensimLex.NextLine(line) && !line.StartsWith("///---\\\\\\"))
+      ;
+  }
+  while (true) {  // read in the sketch information
+    if (!line.StartsWith("\\\\\\---///") || ConversionLimits::Stop())
       break;
-    this->mVensimLex.ReadLine(buf, BUFLEN);  // version line
-    if (strncmp(buf, "V300 ", 5)) {
+    this->mVensimLex.NextLine(line);  // version line
+    if (!line.StartsWith("V300 ")) {
       // fprintf(stderr, "Unrecognized version - can't read sketch info\n");
       break;
     }
@@ -270,20 +368,24 @@ bool VensimParse::ProcessFile(const std::string &filename, const char *contents,
 
     _model->AddView(view);
     // next the title
-    this->mVensimLex.ReadLine(buf, BUFLEN);
-    view->SetTitle(buf +
-                   1);  // skip the star - we can try to name modules with this eventually subject to name collisions
-    this->mVensimLex.ReadLine(buf, BUFLEN);  // default font info - we can try to grab this later
-    view->ReadView(this, buf);               // will return with buf populated at next view
+    this->mVensimLex.NextLine(line);
+    // skip the star - we can try to name modules with this eventually subject to name collisions
+    view->SetTitle(line.From(1).ToString());
+    this->mVensimLex.NextLine(line);  // default font info - we can try to grab this later
+    view->ReadView(this, line);       // will return with line set to the next view
   }
+}
+
+void VensimParse::ReadRest(VensimSpan line) {
+  ReadViews(line);
   // there may be options at the end
-  if (strncmp(buf, "///---\\\\\\", 9) == 0) {
-    while (this->mVensimLex.ReadLine(buf, BUFLEN))  // looking for settings maker
+  if (line.StartsWith("///---\\\\\\")) {
+    while (this->mVensimLex.NextLine(line))  // looking for settings maker
     {
-      if (strncmp(buf, ":L\177<%^E!@", 9) == 0) {
-        while (this->mVensimLex.ReadLine(buf, BUFLEN)) {
+      if (line.StartsWith(":L\177<%^E!@")) {
+        while (this->mVensimLex.NextLine(line)) {
           int type;
-          char *curpos = GetIntChar(buf, type, ':');
+          VensimSpan curpos = GetIntChar(line, type, ':');
           if (type == 15)  // fourth entry is integration type
           {
             int im;
@@ -308,7 +410,7 @@ bool VensimParse::ProcessFile(const std::string &filename, const char *contents,
             _model->SetIntegrationType(it);
           } else if (type == 22)  // units equialences
           {
-            _model->UnitEquivs().push_back(curpos);
+            _model->UnitEquivs().push_back(curpos.ToString());
           }
         }
         break;
@@ -330,53 +432,230 @@ bool VensimParse::ProcessFile(const std::string &filename, const char *contents,
       }
     }
   }
-  return is_ok;  // got something - try to put something out
+  _model->CacheSubscriptElements();
+  ConversionProgress::Read(mVensimLex.BytesRead());
 }
 
-char *VensimParse::GetIntChar(char *s, int &val, char c) {
-  char *tv;
-  for (tv = s; *tv; tv++) {
-    if (*tv == c) {
-      *tv++ = 0;
-      break;
+bool VensimParse::ReadChunk(VensimSpan chunk, SymbolNameSpace::Log &log, ChunkRead &read) {
+  SymbolNameSpace::LogScope logScope{pSymbolNameSpace, &log};
+  mVensimLex.InitializeChunk(chunk.Begin(), chunk.Length());
+  pChunkRead = &read;
+  bChunkFailed = false;
+  int endtok = mVensimLex.GetEndToken();
+  bool is_ok = true;
+  int rval;
+  do {
+    try {
+      mVensimLex.GetReady();
+      pEquationVar = NULL;
+      {
+        XMUTIL_TIME(equationSeconds);
+        rval = ParseEquation();
+      }
+      if (rval < 0 || bChunkFailed) {
+        is_ok = false;  // left to the one reading in place to say why
+      } else if (rval == '~') {
+        if (!bSkipDocs) {
+          std::string comment = mVensimLex.GetComment("|");
+          if (!comment.empty())
+            read.vItems.push_back(ChunkItem{'~', NULL, NULL, comment});
+        }
+        mVensimLex.FindToken("|");
+      } else if (rval == VPTT_groupstar) {
+        read.vItems.push_back(ChunkItem{VPTT_groupstar, NULL, NULL, *mVensimLex.CurToken()});
+      }
+    } catch (...) {
+      ResetParser();
+      is_ok = false;
     }
+  } while (is_ok && rval != endtok);
+  pChunkRead = NULL;
+  read.vTouched.swap(log.vTouched);
+  log.vTouched.clear();
+  return is_ok;
+}
+
+void VensimParse::AddChunk(const ChunkRead &read) {
+  for (const ChunkItem &item : read.vItems) {
+    if (item.iKind == '|')
+      AddEquation(item.pEquation, item.pUnits);
+    else if (item.iKind == '~') {
+      if (pActiveVar)  // multile appearances okay - take last non empty
+        pActiveVar->SetComment(item.sText);
+    } else
+      AddGroup(item.sText);
   }
-  val = atoi(s);
-  return tv;
 }
-char *VensimParse::GetInt(char *s, int &val) {
-  char *tv;
-  for (tv = s; *tv; tv++) {
-    if (*tv == ',') {
-      *tv++ = 0;
-      break;
+
+// the chunks are handed out to the threads in pieces, each a run of
+// chunks read into an arena and allocation log of its own
+struct VensimPiece {
+  size_t iFirst;
+  size_t iLast;  // one past
+  SymbolArena mArena;
+  SymbolNameSpace::Log mLog;
+};
+#define PIECES_PER_THREAD 4  // so a slow piece doesn't hold up the rest
+
+bool VensimParse::ReadChunks(const std::vector<VensimSpan> &chunks, std::vector<ChunkRead> &reads) {
+  size_t count = chunks.size() - 1;  // the last is the sketch
+  reads.clear();
+  reads.resize(count);
+  size_t bytes = count ? chunks[count].Begin() - chunks[0].Begin() : 0;
+  uint32_t threads = iThreads > 0 ? iThreads : 1;
+#ifdef XMUTIL_NO_THREADS
+  threads = 1;
+#endif
+  size_t target = bytes / (threads * PIECES_PER_THREAD) + 1;
+  std::vector<std::unique_ptr<VensimPiece>> pieces;
+  for (size_t i = 0; i < count;) {
+    std::unique_ptr<VensimPiece> piece(new VensimPiece);
+    piece->iFirst = i;
+    const char *start = chunks[i].Begin();
+    while (i < count && static_cast<size_t>(chunks[i].End() - start) < target)
+      i++;
+    piece->iLast = i < count ? ++i : i;
+    pieces.push_back(std::move(piece));
+  }
+  if (threads > pieces.size())
+    threads = static_cast<uint32_t>(pieces.size());
+  // each thread has its own lexer and parser - made here as setting one up
+  // hands the name space its builtins
+  std::vector<std::unique_ptr<VensimParse>> readers;
+  for (uint32_t i = 0; i < threads; i++) {
+    readers.emplace_back(new VensimParse(_model));
+    readers.back()->SetSkipDocs(bSkipDocs);
+  }
+
+  size_t before = pSymbolNameSpace->Symbols().size();
+  pSymbolNameSpace->SetConcurrent(true);
+  bool ok = RunWorkers(pieces.size(), threads, [&](size_t i, uint32_t worker) {
+    VensimPiece &piece = *pieces[i];
+    SymbolArena::Scope arenaScope{&piece.mArena};
+    for (size_t j = piece.iFirst; j < piece.iLast; j++) {
+      if (!readers[worker]->ReadChunk(chunks[j], piece.mLog, reads[j]))
+        return false;
     }
+    return true;
+  });
+  pSymbolNameSpace->SetConcurrent(false);
+
+  // everything read goes with the model now, whatever happens next
+  SymbolArena *arena = _model->Arena();
+  for (std::unique_ptr<VensimPiece> &piece : pieces) {
+    arena->Adopt(piece->mArena);
+    pSymbolNameSpace->Adopt(piece->mLog);
   }
-  val = atoi(s);
-  return tv;
-}
-char *VensimParse::GetString(char *s, std::string &name) {
-  char *tv = s;
-  if (*tv == '\"') {
-    for (tv++; *tv; tv++) {
+  if (!ok)
+    return false;
+
+  // the symbols went in as the threads got to them - put them in the
+  // order reading in place would have, which is the order they were
+  // first used in
+  const std::vector<Symbol *> &symbols = pSymbolNameSpace->Symbols();
+  std::vector<Symbol *> order(symbols.begin(), symbols.begin() + before);
+  std::vector<bool> placed(symbols.size(), false);
+  std::fill(placed.begin(), placed.begin() + before, true);
+  for (size_t i = 0; i < count; i++) {
+    for (Symbol *sym : reads[i].vTouched) {
+      if (!placed[sym->NameSpacePos()]) {
+        placed[sym->NameSpacePos()] = true;
+        order.push_back(sym);
+      }
+    }
+    AddChunk(reads[i]);
+    ConversionProgress::Equation(chunks[i].End() - chunks[0].Begin());
+  }
+  assert(order.size() == symbols.size());
+  if (order.size() == symbols.size())
+    pSymbolNameSpace->SetOrder(order);
+  return true;
+}
+
+bool VensimParse::ProcessChunks(const char *contents, size_t length, const std::vector<VensimSpan> &chunks,
+                                std::vector<ChunkRead> &reads) {
+  if (!ReadChunks(chunks, reads)) {
+    // a piece stops at the first equation it can't read, so what is wrong
+    // with each comes from reading the whole in place, into a model that
+    // is then thrown away
+    Model scratch{};
+    SymbolArena::Scope arenaScope{scratch.Arena()};
+    VensimParse again{&scratch};
+    again.SetSkipViews(true);
+    again.SetSkipDocs(true);
+    again.ProcessFile(sFilename, contents, length);
+    vDiagnostics = again.Diagnostics();
+    if (vDiagnostics.empty())
+      vDiagnostics.push_back(Diagnostic(XMUTIL_ERROR_PARSE, "unable to read equation"));
+    return false;
+  }
+  mVensimLex.Initialize(contents, length);
+  mVensimLex.SkipTo(chunks.back().Begin() - contents);
+  VensimSpan line;
+  mVensimLex.MarkerLine(line);
+  XMUTIL_COUNT(tokens, 1);  // the end of the equations, as reading in place counts it
+  ReadRest(line);
+  return true;
+}
+
+void VensimParse::ReadViewsAgain(const char *contents, size_t length, VensimSpan sketch) {
+  _model->ClearViews();
+  mVensimLex.Initialize(contents, length);
+  mVensimLex.SkipTo(sketch.Begin() - contents);
+  VensimSpan line;
+  mVensimLex.MarkerLine(line);
+  ReadViews(line);
+}
+
+// atoi without needing a terminator
+static int SpanToInt(const char *s, const char *end) {
+  while (s < end && (*s == ' ' || *s == '\t'))
+    s++;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+'))
+    negative = *s++ == '-';
+  int val = 0;
+  for (; s < end && *s >= '0' && *s <= '9'; s++)
+    val = val * 10 + (*s - '0');
+  return negative ? -val : val;
+}
+
+VensimSpan VensimParse::GetIntChar(VensimSpan s, int &val, char c) {
+  const char *tv = static_cast<const char *>(memchr(s.Begin(), c, s.Length()));
+  if (!tv)
+    tv = s.End();
+  val = SpanToInt(s.Begin(), tv);
+  return VensimSpan(tv < s.End() ? tv + 1 : tv, s.End());
+}
+VensimSpan VensimParse::GetInt(VensimSpan s, int &val) {
+  return GetIntChar(s, val, ',');
+}
+// the end of a string field - quotes and escapes are kept in the name
+static const char *StringEnd(VensimSpan s) {
+  const char *tv = s.Begin();
+  const char *end = s.End();
+  if (tv < end && *tv == '\"') {
+    for (tv++; tv < end; tv++) {
       if (*tv == '\"') {
         tv++;
-        assert(*tv == ',');
-        *tv++ = 0;
+        assert(tv == end || *tv == ',');
         break;
-      } else if (*tv == '\\' && tv[1] == '\"')
+      } else if (*tv == '\\' && tv + 1 < end && tv[1] == '\"')
         tv++;
     }
-  } else {
-    for (tv = s; *tv; tv++) {
-      if (*tv == ',') {
-        *tv++ = 0;
-        break;
-      }
-    }
+    return tv;
   }
-  name = s;
-  return tv;
+  tv = static_cast<const char *>(memchr(tv, ',', end - tv));
+  return tv ? tv : end;
+}
+VensimSpan VensimParse::GetString(VensimSpan s, std::string &name) {
+  const char *tv = StringEnd(s);
+  name.assign(s.Begin(), tv);
+  return VensimSpan(tv < s.End() ? tv + 1 : tv, s.End());
+}
+VensimSpan VensimParse::SkipString(VensimSpan s) {
+  const char *tv = StringEnd(s);
+  return VensimSpan(tv < s.End() ? tv + 1 : tv, s.End());
 }
 
 Variable *VensimParse::FindVariable(const std::string &name) {
@@ -386,28 +665,36 @@ Variable *VensimParse::FindVariable(const std::string &name) {
   return NULL;
 }
 
-Variable *VensimParse::InsertVariable(const std::string &name) {
-  Variable *var = static_cast<Variable *>(pSymbolNameSpace->Find(name));
+Variable *VensimParse::InsertVariable(const char *name, size_t len) {
+  // the shared builtins first so a function name never touches the model's
+  // own table - no model name can be a builtin's, so the order is safe
+  Variable *var = static_cast<Variable *>(pSymbolNameSpace->FindBuiltinFirst(name, len));
   if (var && var->isType() != Symtype_Variable && var->isType() != Symtype_Function) {
-    mSyntaxError.str = "Type meaning mismatch for " + name;
-    throw mSyntaxError;
+    SyntaxError("Type meaning mismatch for " + std::string(name, len));
+    return NULL;
   }
   if (!var) {
-    var = new Variable(pSymbolNameSpace, name);
     // this will insert it into the name space for hash lookup as well
+    var = static_cast<Variable *>(pSymbolNameSpace->Kept(new Variable(pSymbolNameSpace, std::string(name, len))));
   }
+  if (!pEquationVar && var->isType() == Symtype_Variable)
+    pEquationVar = var;
   return var;
 }
-Units *VensimParse::InsertUnits(const std::string &name) {
-  std::string uname = ">" + name;  // an illegal variable name since we allow the same names to be used for vars and
-                                   // units - could use a separate namespace
+Units *VensimParse::InsertUnits(const char *name, size_t len) {
+  // an illegal variable name since we allow the same names to be used for vars and
+  // units - could use a separate namespace.  built in a reused buffer as this is
+  // called for every units token
+  static thread_local std::string uname;
+  uname.assign(1, '>');
+  uname.append(name, len);
   Units *u = static_cast<Units *>(pSymbolNameSpace->Find(uname));
   if (u && u->isType() != Symtype_Units) {
-    mSyntaxError.str = "Type meaning mismatch for " + name;
-    throw mSyntaxError;
+    SyntaxError("Type meaning mismatch for " + std::string(name, len));
+    return NULL;
   }
   if (!u) {
-    u = new Units(pSymbolNameSpace, uname);
+    u = static_cast<Units *>(pSymbolNameSpace->Kept(new Units(pSymbolNameSpace, uname)));
   }
   return u;
 }
@@ -417,14 +704,22 @@ UnitExpression *VensimParse::InsertUnitExpression(Units *u) {
   return uni;
 }
 
+// before the allocations are rolled back - the variable may go with them
+void VensimParse::AddDiagnostic(const std::string &message) {
+  vDiagnostics.push_back(Diagnostic(XMUTIL_ERROR_PARSE, message, mVensimLex.LineNumber(), mVensimLex.Position(),
+                                    pEquationVar ? pEquationVar->GetName() : std::string()));
+}
+
 // find the beginning of the next equation - for error recovery
 bool VensimParse::FindNextEq(bool want_comment) {
-  if (want_comment && this->pActiveVar) {
+  if (want_comment && this->pActiveVar && !bSkipDocs) {
     std::string comment = mVensimLex.GetComment("|");
     if (!comment.empty())  // multile appearances okay - take last non empty
       this->pActiveVar->SetComment(comment);
-  }
-  // just zip through to the first | then whatever follows is it
+  } else if (!want_comment)
+    XMUTIL_COUNT(recoverySkips, 1);
+  // just zip through to the first | then whatever follows is it (the
+  // comment too when it isn't wanted)
   return mVensimLex.FindToken("|");
 }
 
@@ -453,15 +748,15 @@ SymbolList *VensimParse::SymList(SymbolList *in, Variable *add, bool bang, Varia
     int low = atoi(start.c_str() + i);
     int high = atoi(finish.c_str() + j);
     if (i != j || start.compare(0, j, finish, 0, j) || low >= high) {
-      mSyntaxError.str = "Bad subscript range specification";
-      throw mSyntaxError;
+      SyntaxError("Bad subscript range specification");
+      return NULL;
     }
     start.erase(i, std::string::npos);
     for (i = low + 1; i < high; i++) {
       finish = start + std::to_string(i);
       v = static_cast<Variable *>(pSymbolNameSpace->Find(finish));
       if (!v)
-        v = new Variable(pSymbolNameSpace, finish);
+        v = static_cast<Variable *>(pSymbolNameSpace->Kept(new Variable(pSymbolNameSpace, finish)));
       sl->Append(v, bang);
     }
     sl->Append(end, bang);
@@ -485,7 +780,7 @@ UnitExpression *VensimParse::UnitsMult(UnitExpression *f, UnitExpression *s) {
 }
 UnitExpression *VensimParse::UnitsRange(UnitExpression *e, double minval, double maxval, double increment) {
   if (e == NULL) {
-    e = VPObject->InsertUnitExpression(VPObject->InsertUnits("1"));
+    e = InsertUnitExpression(InsertUnits("1"));
   }
   e->SetRange(minval, maxval, increment);
   return e;
@@ -515,7 +810,99 @@ ExpressionVariable *VensimParse::VarExpression(Variable *var, SymbolList *subs)
 ExpressionSymbolList *VensimParse::SymlistExpression(SymbolList *subs, SymbolList *map) {
   return new ExpressionSymbolList(pSymbolNameSpace, subs, map);
 }
+bool VensimParse::SharedKey::operator==(const SharedKey &o) const {
+  return type == o.type && op == o.op && bits == o.bits && p[0] == o.p[0] && p[1] == o.p[1] && p[2] == o.p[2] &&
+         p[3] == o.p[3];
+}
+size_t VensimParse::SharedKeyHash::operator()(const SharedKey &k) const {
+  size_t h = std::hash<uint64_t>()(k.bits) ^ (static_cast<size_t>(k.type) << 8 | static_cast<size_t>(k.op));
+  for (const void *p : k.p)
+    h = h * 31 + std::hash<const void *>()(p);
+  return h;
+}
+
+// only nodes that nothing changes after they are read are shared, and only
+// once everything under them is - subscripted variables, functions with
+// memory, tables and literals each keep their own
+Expression *VensimParse::Share(Expression *e) {
+  if (!bShareExpressions || mInMacro || !e || !SymbolArena::Active() || sShared.count(e))
+    return e;
+  SharedKey key = {e->GetType(), 0, {NULL, NULL, NULL, NULL}, 0};
+  switch (e->GetType()) {
+  case EXPTYPE_Number: {
+    double value = static_cast<ExpressionNumber *>(e)->GetValue();
+    memcpy(&key.bits, &value, sizeof(value));
+    break;
+  }
+  case EXPTYPE_Variable: {
+    ExpressionVariable *ev = static_cast<ExpressionVariable *>(e);
+    if (ev->GetSubs())
+      return e;
+    key.p[0] = ev->GetVariable();
+    break;
+  }
+  case EXPTYPE_Operator:
+  case EXPTYPE_Logical:
+  case EXPTYPE_Lookup:
+    if (e->GetType() == EXPTYPE_Operator)
+      key.op = static_cast<ExpressionOperator2 *>(e)->GetCode();
+    else if (e->GetType() == EXPTYPE_Logical)
+      key.op = static_cast<ExpressionLogical *>(e)->GetOper();
+    for (int i = 0; i < 2; i++) {
+      Expression *arg = e->GetArg(i);
+      if (arg && !sShared.count(arg))
+        return e;
+      key.p[i] = arg;
+    }
+    break;
+  case EXPTYPE_Function: {
+    ExpressionList *args = static_cast<ExpressionFunction *>(e)->GetArgs();
+    key.op = args ? args->Length() : 0;
+    if (key.op > 3)
+      return e;
+    key.p[0] = e->GetFunction();
+    for (int i = 0; i < key.op; i++) {
+      Expression *arg = args->GetExp(i);
+      if (!sShared.count(arg))
+        return e;
+      key.p[i + 1] = arg;
+    }
+    break;
+  }
+  default:
+    return e;
+  }
+  auto found = mShared.find(key);
+  if (found == mShared.end()) {
+    mShared.emplace(key, e);
+    sShared.insert(e);
+    return e;
+  }
+  // e is not yet confirmed so deleting it leaves what it points to alone
+  if (e->GetType() == EXPTYPE_Function)
+    delete static_cast<ExpressionFunction *>(e)->GetArgs();
+  delete e;
+  pSymbolNameSpace->SetSharesExpressions();
+  return found->second;
+}
+
+// the shared nodes from an equation that failed are about to be deleted
+void VensimParse::ForgetUnconfirmedShared(void) {
+  for (auto it = mShared.begin(); it != mShared.end();) {
+    if (it->second->HasGoodAlloc()) {
+      ++it;
+    } else {
+      sShared.erase(it->second);
+      it = mShared.erase(it);
+    }
+  }
+}
+
 Expression *VensimParse::OperatorExpression(int oper, Expression *exp1, Expression *exp2) {
+  if ((oper != '+' && oper != '-') || exp2) {  // the unary ones may yet flip the sign of a number
+    exp1 = Share(exp1);
+    exp2 = Share(exp2);
+  }
   switch (oper) {
   case '*':
     return new ExpressionMultiply(pSymbolNameSpace, exp1, exp2);
@@ -524,14 +911,14 @@ Expression *VensimParse::OperatorExpression(int oper, Expression *exp1, Expressi
   case '+':
     if (!exp2 && exp1 && exp1->GetType() == EXPTYPE_Number)
       return exp1; /* unary plus just ignore */
-    return new ExpressionAdd(pSymbolNameSpace, exp1, exp2);
+    return new ExpressionAdd(pSymbolNameSpace, Share(exp1), exp2);
   case '-':
     if (!exp2) {
       if (exp1 && exp1->GetType() == EXPTYPE_Number) {
         exp1->FlipSign();
         return exp1;
       }
-      return new ExpressionUnaryMinus(pSymbolNameSpace, exp1, NULL);
+      return new ExpressionUnaryMinus(pSymbolNameSpace, Share(exp1), NULL);
     }
     return new ExpressionSubtract(pSymbolNameSpace, exp1, exp2);
   case '^':
@@ -552,34 +939,41 @@ Expression *VensimParse::OperatorExpression(int oper, Expression *exp1, Expressi
     assert(exp2 == NULL);
     return new ExpressionLogical(pSymbolNameSpace, NULL, exp1, oper);
   default:
-    mSyntaxError.str = "Unknown operator internal error ";
-    throw mSyntaxError;
+    SyntaxError("Unknown operator internal error ");
+    return NULL;
   }
 }
 Expression *VensimParse::FunctionExpression(Function *func, ExpressionList *eargs) {
   if ((!eargs && func->NumberArgs() > 0) || (eargs && func->NumberArgs() != eargs->Length())) {
-    mSyntaxError.str = "Argument count mismatch for ";
-    mSyntaxError.str.append(func->GetName());
-    throw mSyntaxError;
+    SyntaxError("Argument count mismatch for " + func->GetName());
+    return NULL;
   }
+  for (int i = 0, n = eargs ? eargs->Length() : 0; i < n; i++)
+    eargs->SetExp(i, Share(eargs->GetExp(i)));
   if (func->IsMemoryless() && !func->IsTimeDependent())
     return new ExpressionFunction(pSymbolNameSpace, func, eargs);
   return new ExpressionFunctionMemory(pSymbolNameSpace, func, eargs);
 }
 Expression *VensimParse::LookupExpression(ExpressionVariable *var, Expression *exp) {
-  return new ExpressionLookup(pSymbolNameSpace, var, exp);
+  return new ExpressionLookup(pSymbolNameSpace, static_cast<ExpressionVariable *>(Share(var)), Share(exp));
 }
 
+// the grammar is left recursive so the first pair arrives before the rest
+// have been read - the lexer can tell us how many follow to size things
 ExpressionTable *VensimParse::TablePairs(ExpressionTable *table, double x, double y) {
-  if (!table)
+  if (!table) {
     table = new ExpressionTable(pSymbolNameSpace);
+    table->Reserve(1 + mVensimLex.CountAhead('('));
+  }
   table->AddPair(x, y);
   return table;
 }
 
 ExpressionTable *VensimParse::XYTableVec(ExpressionTable *table, double val) {
-  if (!table)
+  if (!table) {
     table = new ExpressionTable(pSymbolNameSpace);
+    table->Reserve(1 + mVensimLex.CountAhead(','));
+  }
   table->AddPair(val, 0);  // fix these after reducing
   return table;
 }
@@ -590,18 +984,28 @@ ExpressionTable *VensimParse::TableRange(ExpressionTable *table, double x1, doub
 }
 
 void VensimParse::MacroStart() {
+  if (pChunkRead) {  // SplitEquations should have seen it - the definition can only be read in place
+    bChunkFailed = true;
+    return;
+  }
   mInMacro = true;
   pMainSymbolNameSpace = pSymbolNameSpace;
   pSymbolNameSpace = new SymbolNameSpace();  // local name space for macro variables and macro name - macro name will go
                                              // into the main name space on close
-  ReadyFunctions();                          // against this new name space - somewhat duplicative
+  ReadyFunctions();                          // the same builtins as the main name space
 }
 
 void VensimParse::MacroExpression(Variable *name, ExpressionList *margs) {
+  if (pChunkRead)
+    return;
   // the macro functiongoes against the main name space - everything else is local
   mMacroFunctions.push_back(new MacroFunction(pMainSymbolNameSpace, pSymbolNameSpace, name->GetName(), margs));
 }
 void VensimParse::MacroEnd() {
+  if (pChunkRead) {
+    bChunkFailed = true;
+    return;
+  }
   pSymbolNameSpace = pMainSymbolNameSpace;
   mInMacro = false;
 }
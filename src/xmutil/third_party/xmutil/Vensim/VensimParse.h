@@ -1,22 +1,21 @@
 #ifndef _XMUTIL_VENSIM_VENSIMPARSE_H
 #define _XMUTIL_VENSIM_VENSIMPARSE_H
+#include <stdint.h>
+
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "../Function/Function.h"
 #include "../Symbol/Equation.h"
 #include "../Symbol/Parse.h"
 #include "../Symbol/Symbol.h"
 #include "../Symbol/Units.h"
+#include "../XMUtil.h"
 #include "VensimLex.h"
 
-#define BUFLEN 4096  // for reading sketch info
-
 class VensimView;
-
-class VensimParseSyntaxError {
-public:
-  std::string str;
-};
+struct vpyypstate;  // the bison parser's
 
 class VensimParse {
 public:
@@ -24,18 +23,64 @@ public:
   ~VensimParse(void);
   void ReadyFunctions();
   bool ProcessFile(const std::string &filename, const char *contents, size_t contentsLen);
-  inline int yylex(void) {
-    return mVensimLex.yylex();
+  // as ProcessFile with the contents coming from read as the lexer needs them
+  bool ProcessStream(const std::string &filename, XMUtilReader read, void *context);
+
+  // what reading one of the chunks VensimLex::SplitEquations gives comes
+  // to - kept out of the model so chunks can be read on threads of their
+  // own and then added to it in file order
+  struct ChunkItem {
+    int iKind;  // '|' for an equation, '~' for the comment after one, VPTT_groupstar for a group
+    Equation *pEquation;
+    UnitExpression *pUnits;
+    std::string sText;  // the comment (never empty) or the group's name
+  };
+  struct ChunkRead {
+    std::vector<ChunkItem> vItems;
+    std::vector<Symbol *> vTouched;  // see SymbolNameSpace::Log
+  };
+  // reads chunk into read, with its allocations going to log - false if
+  // it can't be read, which leaves them unconfirmed.  Only the name space
+  // and the allocations are touched so chunks can be read on different
+  // threads at once, each with its own VensimParse, log and arena, while
+  // the name space is concurrent
+  bool ReadChunk(VensimSpan chunk, SymbolNameSpace::Log &log, ChunkRead &read);
+  // adds what ReadChunk read to the model as reading it in place would
+  void AddChunk(const ChunkRead &read);
+  // the equations in chunks, split from contents, read on up to
+  // SetThreads threads into reads and added to the model in file order,
+  // then the sketch and settings in chunks.back().  Returns false as
+  // ProcessFile does - the model is then only fit to be deleted
+  bool ProcessChunks(const char *contents, size_t length, const std::vector<VensimSpan> &chunks,
+                     std::vector<ChunkRead> &reads);
+  // throws away the views and reads them again from sketch, the last of
+  // the chunks - for after equations have changed under AttachStragglers
+  void ReadViewsAgain(const char *contents, size_t length, VensimSpan sketch);
+  inline int yylex(ParseUnion *lvalp) {
+    return mVensimLex.yylex(lvalp);
   }
   int yyerror(const char *str);
+  // nothing throws for a bad equation - the parse is abandoned with the
+  // first message noted here, and the lexer and the grammar's helpers give
+  // back YYerror or NULL
+  void SyntaxError(const std::string &message);
+  void EquationEnd(int tok) {  // from the grammar as an equation is accepted
+    iEquationEnd = tok;
+  }
   Equation *AddEq(LeftHandSide *lhs, Expression *ex, ExpressionList *exl, int tok);
   Equation *AddTable(LeftHandSide *lhs, Expression *ex, ExpressionTable *table, bool legacy);
   inline SymbolNameSpace *GetSymbolNameSpace(void) {
     return pSymbolNameSpace;
   }
-  Variable *InsertVariable(const std::string &name);
+  Variable *InsertVariable(const std::string &name) {
+    return InsertVariable(name.c_str(), name.length());
+  }
+  Variable *InsertVariable(const char *name, size_t len);  // name is a token view - need not be terminated
   Variable *FindVariable(const std::string &name);
-  Units *InsertUnits(const std::string &name);
+  Units *InsertUnits(const std::string &name) {
+    return InsertUnits(name.c_str(), name.length());
+  }
+  Units *InsertUnits(const char *name, size_t len);
   UnitExpression *InsertUnitExpression(Units *u);
   void AddFullEq(Equation *eq, UnitExpression *un);
   LeftHandSide *AddExceptInterp(ExpressionVariable *var, SymbolListList *except, int interpmode);
@@ -63,9 +108,11 @@ public:
   VensimLex &Lexer() {
     return mVensimLex;
   }
-  char *GetInt(char *buf, int &val);
-  char *GetIntChar(char *buf, int &val, char c);
-  char *GetString(char *buf, std::string &s);
+  // each takes a field off the front of a sketch line returning what follows it
+  VensimSpan GetInt(VensimSpan fields, int &val);
+  VensimSpan GetIntChar(VensimSpan fields, int &val, char c);
+  VensimSpan GetString(VensimSpan fields, std::string &s);
+  VensimSpan SkipString(VensimSpan fields);  // as GetString for a field that isn't wanted
 
   void SetLongName(bool set) {
     bLongName = set;
@@ -73,21 +120,81 @@ public:
   bool LongName() const {
     return bLongName;
   }
+  // equations only - the sketch is passed over without building any views
+  void SetSkipViews(bool set) {
+    bSkipViews = set;
+  }
+  // the comment after each equation passed over rather than kept, so no
+  // variable has any documentation
+  void SetSkipDocs(bool set) {
+    bSkipDocs = set;
+  }
+  // equal subexpressions built once and pointed to from every equation
+  // using them - only taken up when the model is read into an arena
+  void SetShareExpressions(bool set) {
+    bShareExpressions = set;
+  }
+  // ProcessFile reads the equations on up to threads threads at once (see
+  // ProcessChunks) unless there are macros or expressions are shared - the
+  // model is the same as read on one
+  void SetThreads(uint32_t threads) {
+    iThreads = threads;
+  }
+  // what went wrong with the equations ProcessFile couldn't read
+  const std::vector<Diagnostic> &Diagnostics(void) const {
+    return vDiagnostics;
+  }
 
 private:
+  bool ProcessContents(void);  // what the lexer was initialized with
+  void ReadRest(VensimSpan line);   // the sketch and settings from line, the marker line, on
+  void ReadViews(VensimSpan &line);  // leaving line at the settings marker
+  bool ReadChunks(const std::vector<VensimSpan> &chunks, std::vector<ChunkRead> &reads);
+  void AddEquation(Equation *eq, UnitExpression *un);  // to the model
+  void AddGroup(const std::string &name);
+  // pushes tokens to the parser until it accepts an equation (or the group,
+  // macro or end marker standing in for one), returning how it ended
+  int ParseEquation(void);
+  void ResetParser(void);  // after running out of memory left it part way through
+  bool SkipEquation(const std::string &message);
   bool FindNextEq(bool want_comment);
+  // e, or the one already built just like it, which e is then deleted for
+  Expression *Share(Expression *e);
+  void ForgetUnconfirmedShared(void);
+  struct SharedKey {
+    int type;
+    int op;
+    const void *p[4];
+    uint64_t bits;
+    bool operator==(const SharedKey &o) const;
+  };
+  struct SharedKeyHash {
+    size_t operator()(const SharedKey &k) const;
+  };
+  void AddDiagnostic(const std::string &message);
   Model *_model;
   std::string sFilename;
   VensimLex mVensimLex;
-  VensimParseSyntaxError mSyntaxError;
+  std::string sSyntaxError;  // see SyntaxError
+  bool bSyntaxError;
+  vpyypstate *pParserState;  // kept from one equation to the next
+  int iEquationEnd;
   SymbolNameSpace *pSymbolNameSpace;
   SymbolNameSpace *pMainSymbolNameSpace;
   Variable *pActiveVar;
+  Variable *pEquationVar;  // the first name in the equation being read
+  std::vector<Diagnostic> vDiagnostics;
   bool mInMacro = false;
   bool bLongName = false;
+  bool bSkipViews = false;
+  bool bSkipDocs = false;
+  bool bShareExpressions = false;
+  uint32_t iThreads = 1;
+  ChunkRead *pChunkRead = NULL;  // what ReadChunk is reading into
+  bool bChunkFailed = false;     // something ReadChunk can't keep apart from the model
+  std::unordered_map<SharedKey, Expression *, SharedKeyHash> mShared;
+  std::unordered_set<Expression *> sShared;  // the values of mShared
   std::vector<MacroFunction *> mMacroFunctions;
 };
 
-extern VensimParse *VPObject;
-
 #endif
@@ -4,83 +4,86 @@
 #include "../XMUtil.h"
 #include "VensimParse.h"
 
-void vpyy_addfulleq(Equation *eq, UnitExpression *un) {
-  return VPObject->AddFullEq(eq, un);
+void vpyy_addfulleq(VensimParse *vp, Equation *eq, UnitExpression *un) {
+  return vp->AddFullEq(eq, un);
 }
-Equation *vpyy_addeq(LeftHandSide *lhs, Expression *ex, ExpressionList *exl, int token) {
-  return VPObject->AddEq(lhs, ex, exl, token);
+Equation *vpyy_addeq(VensimParse *vp, LeftHandSide *lhs, Expression *ex, ExpressionList *exl, int token) {
+  return vp->AddEq(lhs, ex, exl, token);
 }
-Equation *vpyy_add_lookup(LeftHandSide *lhs, Expression *ex, ExpressionTable *tvl, int legacy) {
-  return VPObject->AddTable(lhs, ex, tvl, legacy != 0);
+Equation *vpyy_add_lookup(VensimParse *vp, LeftHandSide *lhs, Expression *ex, ExpressionTable *tvl, int legacy) {
+  return vp->AddTable(lhs, ex, tvl, legacy != 0);
 }
-LeftHandSide *vpyy_addexceptinterp(ExpressionVariable *var, SymbolListList *except, int interpmode) {
-  return VPObject->AddExceptInterp(var, except, interpmode);
+LeftHandSide *vpyy_addexceptinterp(VensimParse *vp, ExpressionVariable *var, SymbolListList *except, int interpmode) {
+  return vp->AddExceptInterp(var, except, interpmode);
 }
-SymbolList *vpyy_symlist(SymbolList *in, Variable *add, int bang, Variable *end) {
-  return VPObject->SymList(in, add, !!bang, end);
+SymbolList *vpyy_symlist(VensimParse *vp, SymbolList *in, Variable *add, int bang, Variable *end) {
+  return vp->SymList(in, add, !!bang, end);
 }
-SymbolList *vpyy_mapsymlist(SymbolList *in, Variable *maprange, SymbolList *list) {
-  return VPObject->MapSymList(in, maprange, list);
+SymbolList *vpyy_mapsymlist(VensimParse *vp, SymbolList *in, Variable *maprange, SymbolList *list) {
+  return vp->MapSymList(in, maprange, list);
 }
-UnitExpression *vpyy_unitsdiv(UnitExpression *num, UnitExpression *denom) {
-  return VPObject->UnitsDiv(num, denom);
+UnitExpression *vpyy_unitsdiv(VensimParse *vp, UnitExpression *num, UnitExpression *denom) {
+  return vp->UnitsDiv(num, denom);
 }
-UnitExpression *vpyy_unitsmult(UnitExpression *f, UnitExpression *s) {
-  return VPObject->UnitsMult(f, s);
+UnitExpression *vpyy_unitsmult(VensimParse *vp, UnitExpression *f, UnitExpression *s) {
+  return vp->UnitsMult(f, s);
 }
-UnitExpression *vpyy_unitsrange(UnitExpression *f, double minval, double maxval, double increment) {
-  return VPObject->UnitsRange(f, minval, maxval, increment);
+UnitExpression *vpyy_unitsrange(VensimParse *vp, UnitExpression *f, double minval, double maxval, double increment) {
+  return vp->UnitsRange(f, minval, maxval, increment);
 }
-SymbolListList *vpyy_chain_sublist(SymbolListList *sll, SymbolList *nsl) {
-  return VPObject->ChainSublist(sll, nsl);
+SymbolListList *vpyy_chain_sublist(VensimParse *vp, SymbolListList *sll, SymbolList *nsl) {
+  return vp->ChainSublist(sll, nsl);
 }
-ExpressionList *vpyy_chain_exprlist(ExpressionList *el, Expression *e) {
-  return VPObject->ChainExpressionList(el, e);
+ExpressionList *vpyy_chain_exprlist(VensimParse *vp, ExpressionList *el, Expression *e) {
+  return vp->ChainExpressionList(el, e);
 }
-Expression *vpyy_num_expression(double num) {
-  return VPObject->NumExpression(num);
+Expression *vpyy_num_expression(VensimParse *vp, double num) {
+  return vp->NumExpression(num);
 }
-Expression *vpyy_literal_expression(const char *lit) {
-  return VPObject->LiteralExpression(lit);
+Expression *vpyy_literal_expression(VensimParse *vp, const char *lit) {
+  return vp->LiteralExpression(lit);
 }
-ExpressionVariable *vpyy_var_expression(Variable *var, SymbolList *subs) {
-  return VPObject->VarExpression(var, subs);
+ExpressionVariable *vpyy_var_expression(VensimParse *vp, Variable *var, SymbolList *subs) {
+  return vp->VarExpression(var, subs);
 }
-ExpressionSymbolList *vpyy_symlist_expression(SymbolList *sym, SymbolList *map) {
-  return VPObject->SymlistExpression(sym, map);
+ExpressionSymbolList *vpyy_symlist_expression(VensimParse *vp, SymbolList *sym, SymbolList *map) {
+  return vp->SymlistExpression(sym, map);
 }
-Expression *vpyy_operator_expression(int oper, Expression *exp1, Expression *exp2) {
-  return VPObject->OperatorExpression(oper, exp1, exp2);
+Expression *vpyy_operator_expression(VensimParse *vp, int oper, Expression *exp1, Expression *exp2) {
+  return vp->OperatorExpression(oper, exp1, exp2);
 }
-Expression *vpyy_function_expression(Function *func, ExpressionList *eargs) {
-  return VPObject->FunctionExpression(func, eargs);
+Expression *vpyy_function_expression(VensimParse *vp, Function *func, ExpressionList *eargs) {
+  return vp->FunctionExpression(func, eargs);
 }
-Expression *vpyy_lookup_expression(ExpressionVariable *var, Expression *exp) {
-  return VPObject->LookupExpression(var, exp);
+Expression *vpyy_lookup_expression(VensimParse *vp, ExpressionVariable *var, Expression *exp) {
+  return vp->LookupExpression(var, exp);
 }
-ExpressionTable *vpyy_tablepair(ExpressionTable *table, double x, double y) {
-  return VPObject->TablePairs(table, x, y);
+ExpressionTable *vpyy_tablepair(VensimParse *vp, ExpressionTable *table, double x, double y) {
+  return vp->TablePairs(table, x, y);
 }
-ExpressionTable *vpyy_tablevec(ExpressionTable *table, double val) {
-  return VPObject->XYTableVec(table, val);
+ExpressionTable *vpyy_tablevec(VensimParse *vp, ExpressionTable *table, double val) {
+  return vp->XYTableVec(table, val);
 }
-ExpressionTable *vpyy_tablerange(ExpressionTable *table, double x1, double y1, double x2, double y2) {
-  return VPObject->TableRange(table, x1, y1, x2, y2);
+ExpressionTable *vpyy_tablerange(VensimParse *vp, ExpressionTable *table, double x1, double y1, double x2, double y2) {
+  return vp->TableRange(table, x1, y1, x2, y2);
 }
-void vpyy_macro_start() {
-  VPObject->MacroStart();
+void vpyy_macro_start(VensimParse *vp) {
+  vp->MacroStart();
 }
-void vpyy_macro_expression(Variable *name, ExpressionList *margs) {
-  VPObject->MacroExpression(name, margs);
+void vpyy_macro_expression(VensimParse *vp, Variable *name, ExpressionList *margs) {
+  vp->MacroExpression(name, margs);
 }
-void vpyy_macro_end() {
-  VPObject->MacroEnd();
+void vpyy_macro_end(VensimParse *vp) {
+  vp->MacroEnd();
+}
+void vpyy_equation_end(VensimParse *vp, int tok) {
+  vp->EquationEnd(tok);
 }
 
 /* the default functions called by parser */
-int vpyylex(void) {
-  return VPObject->yylex();
+int vpyylex(ParseUnion *lvalp, VensimParse *vp) {
+  return vp->yylex(lvalp);
 }
-void vpyyerror(const char *str) {
-  VPObject->yyerror(str);
+void vpyyerror(VensimParse *vp, const char *str) {
+  vp->yyerror(str);
 }
@@ -2,29 +2,33 @@
 #define _XMUTIL_VENSIM_VENSIMPARSEFUNCTIONS_H
 #include "../Symbol/Parse.h"
 
-void vpyy_addfulleq(Equation *eq, UnitExpression *un);
-Equation *vpyy_addeq(LeftHandSide *lhs, Expression *ex, ExpressionList *exl, int token);
-Equation *vpyy_add_lookup(LeftHandSide *lhs, Expression *ex, ExpressionTable *tvl, int legacy);
-LeftHandSide *vpyy_addexceptinterp(ExpressionVariable *var, SymbolListList *except, int interpmode);
-SymbolList *vpyy_symlist(SymbolList *in, Variable *add, int bang, Variable *end);
-SymbolList *vpyy_mapsymlist(SymbolList *in, Variable *maprange, SymbolList *list);
-UnitExpression *vpyy_unitsdiv(UnitExpression *num, UnitExpression *denom);
-UnitExpression *vpyy_unitsmult(UnitExpression *f, UnitExpression *s);
-UnitExpression *vpyy_unitsrange(UnitExpression *f, double minval, double maxval, double increment);
-SymbolListList *vpyy_chain_sublist(SymbolListList *sll, SymbolList *nsl);
-ExpressionList *vpyy_chain_exprlist(ExpressionList *el, Expression *e);
-Expression *vpyy_num_expression(double num);
-Expression *vpyy_literal_expression(const char *tok);
-ExpressionVariable *vpyy_var_expression(Variable *var, SymbolList *subs);
-ExpressionSymbolList *vpyy_symlist_expression(SymbolList *subs, SymbolList *map);
-Expression *vpyy_operator_expression(int oper, Expression *exp1, Expression *exp2);
-Expression *vpyy_function_expression(Function *func, ExpressionList *args);
-Expression *vpyy_lookup_expression(ExpressionVariable *var, Expression *exp);
-ExpressionTable *vpyy_tablepair(ExpressionTable *table, double x, double y);
-ExpressionTable *vpyy_tablevec(ExpressionTable *table, double val);
-ExpressionTable *vpyy_tablerange(ExpressionTable *table, double x1, double y1, double x2, double y2);
-void vpyy_macro_start();
-void vpyy_macro_expression(Variable *name, ExpressionList *margs);
-void vpyy_macro_end();
+class VensimParse;
+
+
+void vpyy_addfulleq(VensimParse *vp, Equation *eq, UnitExpression *un);
+Equation *vpyy_addeq(VensimParse *vp, LeftHandSide *lhs, Expression *ex, ExpressionList *exl, int token);
+Equation *vpyy_add_lookup(VensimParse *vp, LeftHandSide *lhs, Expression *ex, ExpressionTable *tvl, int legacy);
+LeftHandSide *vpyy_addexceptinterp(VensimParse *vp, ExpressionVariable *var, SymbolListList *except, int interpmode);
+SymbolList *vpyy_symlist(VensimParse *vp, SymbolList *in, Variable *add, int bang, Variable *end);
+SymbolList *vpyy_mapsymlist(VensimParse *vp, SymbolList *in, Variable *maprange, SymbolList *list);
+UnitExpression *vpyy_unitsdiv(VensimParse *vp, UnitExpression *num, UnitExpression *denom);
+UnitExpression *vpyy_unitsmult(VensimParse *vp, UnitExpression *f, UnitExpression *s);
+UnitExpression *vpyy_unitsrange(VensimParse *vp, UnitExpression *f, double minval, double maxval, double increment);
+SymbolListList *vpyy_chain_sublist(VensimParse *vp, SymbolListList *sll, SymbolList *nsl);
+ExpressionList *vpyy_chain_exprlist(VensimParse *vp, ExpressionList *el, Expression *e);
+Expression *vpyy_num_expression(VensimParse *vp, double num);
+Expression *vpyy_literal_expression(VensimParse *vp, const char *tok);
+ExpressionVariable *vpyy_var_expression(VensimParse *vp, Variable *var, SymbolList *subs);
+ExpressionSymbolList *vpyy_symlist_expression(VensimParse *vp, SymbolList *subs, SymbolList *map);
+Expression *vpyy_operator_expression(VensimParse *vp, int oper, Expression *exp1, Expression *exp2);
+Expression *vpyy_function_expression(VensimParse *vp, Function *func, ExpressionList *args);
+Expression *vpyy_lookup_expression(VensimParse *vp, ExpressionVariable *var, Expression *exp);
+ExpressionTable *vpyy_tablepair(VensimParse *vp, ExpressionTable *table, double x, double y);
+ExpressionTable *vpyy_tablevec(VensimParse *vp, ExpressionTable *table, double val);
+ExpressionTable *vpyy_tablerange(VensimParse *vp, ExpressionTable *table, double x1, double y1, double x2, double y2);
+void vpyy_macro_start(VensimParse *vp);
+void vpyy_macro_expression(VensimParse *vp, Variable *name, ExpressionList *margs);
+void vpyy_macro_end(VensimParse *vp);
+void vpyy_equation_end(VensimParse *vp, int tok);
 
 #endif
@@ -1,9 +1,13 @@
 #include "VensimView.h"
 
+#include <algorithm>
+
 #include "../Symbol/Variable.h"
 #include "VensimParse.h"
 
-VensimVariableElement::VensimVariableElement(VensimView *view, char *curpos, char *buf, VensimParse *parser) {
+#define VIEW_MAX_UID (1 << 20)  // a UID past this is taken as a corrupt line, not a table that big
+
+VensimVariableElement::VensimVariableElement(VensimView *view, VensimSpan curpos, VensimParse *parser) {
   std::string name;
   curpos = parser->GetString(curpos, name);  // this might be an index number
 
@@ -52,27 +56,29 @@ VensimVariableElement::VensimVariableElement(VensimView *view, Variable *var, in
 #endif
 }
 
-VensimCommentElement::VensimCommentElement(char *curpos, char *buf, VensimParse *parser) {
-  std::string name;
-  curpos = parser->GetString(curpos, name);  // this might be an index number
+// the bits come after name, x, y, width, height and shape
+bool VensimCommentElement::HasScratchName(VensimSpan curpos, VensimParse *parser) {
+  int ignore, bits;
+  curpos = parser->SkipString(curpos);
+  for (int i = 0; i < 5; i++)
+    curpos = parser->GetInt(curpos, ignore);
+  parser->GetInt(curpos, bits);
+  return (bits & (1 << 2)) != 0;
+}
+
+// the text, here or on the scratch line, is never written out so it is
+// passed over rather than copied
+VensimCommentElement::VensimCommentElement(VensimSpan curpos, VensimSpan scratch, VensimParse *parser) {
+  curpos = parser->SkipString(curpos);
 
   curpos = parser->GetInt(curpos, _x);
   curpos = parser->GetInt(curpos, _y);
   curpos = parser->GetInt(curpos, _width);
   curpos = parser->GetInt(curpos, _height);
 
-  int shape, bits;
-  curpos = parser->GetInt(curpos, shape);
-  curpos = parser->GetInt(curpos, bits);
-
-  if (bits & (1 << 2))  // scratch name - it is the next line
-  {
-    parser->Lexer().ReadLine(buf, BUFLEN);
-    name = buf;
-  }
 }
 
-VensimValveElement::VensimValveElement(char *curpos, char *buf, VensimParse *parser) {
+VensimValveElement::VensimValveElement(VensimSpan curpos, VensimParse *parser) {
   std::string name;
   curpos = parser->GetString(curpos, name);  // this might be an index number
 
@@ -88,26 +94,19 @@ VensimValveElement::VensimValveElement(char *curpos, char *buf, VensimParse *par
     _attached = false;
 }
 
-VensimConnectorElement::VensimConnectorElement(char *curpos, char *buf, VensimParse *parser) {
+VensimConnectorElement::VensimConnectorElement(VensimSpan curpos, VensimParse *parser) {
   curpos = parser->GetInt(curpos, _from);
   curpos = parser->GetInt(curpos, _to);
-  std::string ignore;
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-  curpos = parser->GetString(curpos, ignore);
-
-  int npoints;
-  sscanf(curpos, "%d|(%d,%d)", &npoints, &_x, &_y);
-  _npoints = 1;  // todo get all of them
+  for (int i = 0; i < 9; i++)
+    curpos = parser->SkipString(curpos);
 
-  std::string name;
-  curpos = parser->GetString(curpos, name);  // this might be an index number
+  int npoints;  // then npoints|(x,y)|...
+  curpos = parser->GetIntChar(curpos, npoints, '|');
+  if (curpos.First() == '(') {
+    curpos = parser->GetInt(curpos.From(1), _x);
+    parser->GetIntChar(curpos, _y, ')');
+  }
+  _npoints = 1;  // todo get all of them
 }
 
 VensimConnectorElement::VensimConnectorElement(int from, int to, int x, int y) {
@@ -118,76 +117,108 @@ VensimConnectorElement::VensimConnectorElement(int from, int to, int x, int y) {
   _y = y;
 }
 
-void VensimView::ReadView(VensimParse *parser, char *buf) {
+// whether a connector end is something on the view - an attached valve
+// needs its flow just after it too
+static bool OnView(const VensimViewElements &elements, int uid) {
+  if (uid <= 0 || uid >= static_cast<int>(elements.size()) || !elements[uid])
+    return false;
+  VensimViewElement *ele = elements[uid];
+  return ele->Type() != VensimViewElement::ElementTypeVALVE || !static_cast<VensimValveElement *>(ele)->Attached() ||
+         elements[uid + 1];
+}
+
+void VensimView::ReadView(VensimParse *parser, VensimSpan &line) {
   VensimLex &lexer = parser->Lexer();
+  // first pass just finds the lines and the biggest UID so the table is
+  // sized once - UIDs are not always in order
+  struct ElementLines {
+    VensimSpan line;
+    VensimSpan scratch;  // comments may take the next line for their text
+  };
+  std::vector<ElementLines> lines;
+  int maxuid = -1;
   while (true) {
-    lexer.ReadLine(buf, BUFLEN);  // version line
-    if (buf[0] < '0' || buf[0] > '9')
+    lexer.NextLine(line);  // version line
+    if (line.First() < '0' || line.First() > '9')
       break;
-    int len = 0;
     int type = -1;
     int uid = -1;
-    char *curpos = parser->GetInt(buf, type);
+    VensimSpan curpos = parser->GetInt(parser->GetInt(line, type), uid);
+    if (type >= 0 && uid >= 0 && uid < VIEW_MAX_UID) {  // otherwise ignore
+      ElementLines element;
+      element.line = line;
+      if (type == 12 && VensimCommentElement::HasScratchName(curpos, parser))
+        lexer.NextLine(element.scratch);
+      lines.push_back(element);
+      if (uid > maxuid)
+        maxuid = uid;
+    }
+  }
+  if (maxuid < 0)
+    return;
+  // the spare slots at the end are where GetNextUID puts anything we add
+  vElements.resize(maxuid + 26, NULL);
+  for (const ElementLines &element : lines) {
+    int type = -1;
+    int uid = -1;
+    VensimSpan curpos = parser->GetInt(element.line, type);
     curpos = parser->GetInt(curpos, uid);
-    if (type >= 0 && uid >= 0)  // otherwise ignore
-    {
-      if (uid > len) {
-        len = uid + 25;
-        vElements.resize(len + 1, NULL);
-      }
-      switch (type) {
-      case 10:  // a variable
-        vElements[uid] = new VensimVariableElement(this, curpos, buf, parser);
-        break;
-      case 11:  // a valve if connected to a variable always just after it in the lest (??)
-        vElements[uid] = new VensimValveElement(curpos, buf, parser);
-        break;
-      case 12:  // a comment including clouds
-        vElements[uid] = new VensimCommentElement(curpos, buf, parser);
-        break;
-      case 1:  // a connector
-        vElements[uid] = new VensimConnectorElement(curpos, buf, parser);
-        break;
-      case 30:  // a ??????
-        break;
-      default:
-        assert(false);
-        break;
-      }
+    switch (type) {
+    case 10:  // a variable
+      vElements[uid] = NewElement(dVariables, this, curpos, parser);
+      break;
+    case 11:  // a valve if connected to a variable always just after it in the lest (??)
+      vElements[uid] = NewElement(dValves, curpos, parser);
+      break;
+    case 12:  // a comment including clouds
+      vElements[uid] = NewElement(dComments, curpos, element.scratch, parser);
+      break;
+    case 1:  // a connector
+      vElements[uid] = NewElement(dConnectors, curpos, parser);
+      break;
+    case 30:  // a ??????
+    default:  // nothing we know how to draw
+      break;
+    }
+    if (uid >= 0 && vElements[uid])
+      Bound(vElements[uid]);
+  }
+  // connectors to elements that aren't there would be followed into nothing
+  for (int uid = 0; uid <= maxuid; uid++) {
+    VensimViewElement *ele = vElements[uid];
+    if (ele && ele->Type() == VensimViewElement::ElementTypeCONNECTOR) {
+      VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(ele);
+      if (!OnView(vElements, cele->From()) || !OnView(vElements, cele->To()))
+        cele->Invalidate();
     }
   }
 }
 
 int VensimView::GetNextUID() {
-  for (size_t i = vElements.size(); --i > 0;) {
-    if (!vElements[i])
+  for (size_t i = vElements.size(); i > 1;) {  // a view may have no elements yet
+    if (!vElements[--i])
       return i;
   }
   vElements.resize(vElements.size() + 25, NULL);
   return GetNextUID();
 }
 
+void VensimView::Bound(VensimViewElement *ele) {
+  _min_x = std::min(_min_x, ele->X());
+  _min_y = std::min(_min_y, ele->Y());
+  _max_x = std::max(_max_x, ele->X());
+  _max_y = std::max(_max_y, ele->Y());
+  if (ele->Type() != VensimViewElement::ElementTypeCONNECTOR)  // the point a connector bends through
+    mGrid.Add(ele->X(), ele->Y(), ele->Width(), ele->Height());
+}
+
 int VensimView::SetViewStart(int startx, int starty, int uid_start) {
   _uid_offset = uid_start;
   if (this->vElements.empty())
     return _uid_offset;
-  int min_x = INT32_MAX;
-  int min_y = INT32_MAX;
-  for (VensimViewElement *ele : vElements) {
-    if (ele) {
-      if (ele->X() < min_x)
-        min_x = ele->X();
-      if (ele->Y() < min_y)
-        min_y = ele->Y();
-    }
-  }
-  int off_x = startx - min_x;
-  int off_y = starty - min_y;
-  for (VensimViewElement *ele : vElements) {
-    if (ele) {
-      ele->SetX(ele->X() + off_x);
-      ele->SetY(ele->Y() + off_y);
-    }
+  if (_min_x <= _max_x) {  // not just empty slots
+    _off_x = startx - _min_x;
+    _off_y = starty - _min_y;
   }
   return _uid_offset + vElements.size();
 }
@@ -195,41 +226,78 @@ int VensimView::SetViewStart(int startx, int starty, int uid_start) {
 int VensimView::GetViewMaxX(int defval) {
   if (this->vElements.empty())
     return defval;
-  int max_x = -INT32_MAX;
-  for (VensimViewElement *ele : vElements) {
-    if (ele) {
-      if (ele->X() > max_x)
-        max_x = ele->X();
-    }
-  }
-  return max_x;
+  return _min_x <= _max_x ? _max_x + _off_x : -INT32_MAX;
 }
 int VensimView::GetViewMaxY(int defval) {
   if (this->vElements.empty())
     return defval;
-  int max_y = -INT32_MAX;
-  for (VensimViewElement *ele : vElements) {
-    if (ele) {
-      if (ele->Y() > max_y)
-        max_y = ele->Y();
-    }
+  return _min_y <= _max_y ? _max_y + _off_y : -INT32_MAX;
+}
+
+// keep each list in UID order - GetNextUID hands out UIDs from the top down
+static void InsertUID(std::vector<int> &uids, int uid) {
+  uids.insert(std::lower_bound(uids.begin(), uids.end(), uid), uid);
+}
+
+static void Unindex(std::vector<int> &uids, int uid) {
+  uids.erase(std::lower_bound(uids.begin(), uids.end(), uid));
+}
+
+void VensimView::Index(int uid) {
+  VensimViewElement *ele = vElements[uid];
+  if (!ele)
+    return;
+  if (ele->Type() == VensimViewElement::ElementTypeVARIABLE) {
+    InsertUID(mVariableUIDs[static_cast<VensimVariableElement *>(ele)->GetVariable()], uid);
+  } else if (ele->Type() == VensimViewElement::ElementTypeCONNECTOR) {
+    VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(ele);
+    InsertUID(mConnectorsTo[cele->To()], uid);
+    InsertUID(mConnectorsFrom[cele->From()], uid);
   }
-  return max_y;
+}
+
+void VensimView::BuildIndex(void) {
+  if (bIndexed)
+    return;
+  bIndexed = true;
+  for (size_t uid = 0; uid < vElements.size(); uid++)
+    Index(static_cast<int>(uid));
+}
+
+void VensimView::SetElement(int uid, VensimViewElement *ele) {
+  vElements[uid] = ele;
+  Bound(ele);
+  if (bIndexed)
+    Index(uid);
+}
+
+const std::vector<int> &VensimView::Find(UIDIndex &index, int key) {
+  static const std::vector<int> none;
+  BuildIndex();
+  UIDIndex::const_iterator it = index.find(key);
+  return it == index.end() ? none : it->second;
+}
+
+const std::vector<int> &VensimView::VariableUIDs(Variable *var) {
+  static const std::vector<int> none;
+  BuildIndex();
+  std::unordered_map<Variable *, std::vector<int>>::const_iterator it = mVariableUIDs.find(var);
+  return it == mVariableUIDs.end() ? none : it->second;
+}
+
+const std::vector<int> &VensimView::ConnectorsFrom(int uid) {
+  return Find(mConnectorsFrom, uid);
 }
 
 bool VensimView::UpgradeGhost(Variable *var) {
-  for (VensimViewElement *ele : vElements) {
-    if (ele && ele->Type() == VensimViewElement::ElementTypeVARIABLE) {
-      VensimVariableElement *vele = static_cast<VensimVariableElement *>(ele);
-      if (vele->GetVariable() == var) {
-        assert(vele->Ghost());
-        vele->SetGhost(false);
-        var->SetView(this);  // now done
-        return true;
-      }
-    }
-  }
-  return false;
+  const std::vector<int> &uids = VariableUIDs(var);
+  if (uids.empty())
+    return false;
+  VensimVariableElement *vele = static_cast<VensimVariableElement *>(vElements[uids[0]]);
+  assert(vele->Ghost());
+  vele->SetGhost(false);
+  var->SetView(this);  // now done
+  return true;
 }
 
 bool VensimView::AddFlowDefinition(Variable *var, Variable *upstream, Variable *downstream) {
@@ -239,22 +307,27 @@ bool VensimView::AddFlowDefinition(Variable *var, Variable *upstream, Variable *
   xstart = ystart = xend = yend = 0;
   bool startfound = false;
   bool endfound = false;
-  for (VensimViewElement *ele : vElements) {
-    if (ele && ele->Type() == VensimViewElement::ElementTypeVARIABLE) {
-      VensimVariableElement *vele = static_cast<VensimVariableElement *>(ele);
-      if (vele->GetVariable() == upstream) {
-        xstart = vele->X();
-        ystart = vele->Y();
-        startfound = true;
-        if (endfound)
-          break;
-      } else if (vele->GetVariable() == downstream) {
-        xend = vele->X();
-        yend = vele->Y();
-        endfound = true;
-        if (startfound)
-          break;
-      }
+  // walk the two lists together in UID order - a later match moves the
+  // point until both have been seen (a matching upstream wins)
+  static const std::vector<int> none;
+  const std::vector<int> &ups = VariableUIDs(upstream);
+  const std::vector<int> &downs = upstream == downstream ? none : VariableUIDs(downstream);
+  size_t i = 0, j = 0;
+  while (i < ups.size() || j < downs.size()) {
+    bool up = j >= downs.size() || (i < ups.size() && ups[i] < downs[j]);
+    VensimViewElement *vele = vElements[up ? ups[i++] : downs[j++]];
+    if (up) {
+      xstart = vele->X();
+      ystart = vele->Y();
+      startfound = true;
+      if (endfound)
+        break;
+    } else {
+      xend = vele->X();
+      yend = vele->Y();
+      endfound = true;
+      if (startfound)
+        break;
     }
   }
   if (!startfound && !endfound)
@@ -270,18 +343,46 @@ bool VensimView::AddFlowDefinition(Variable *var, Variable *upstream, Variable *
     ystart = yend;
   }
   // add the var to this view
+  mGrid.FreeNear(xstart, ystart);
   int uid = this->GetNextUID();
-  vElements[uid] = new VensimVariableElement(this, var, xstart, ystart);
+  SetElement(uid, NewElement(dVariables, this, var, xstart, ystart));
   return true;
 }
 
 bool VensimView::AddVarDefinition(Variable *var, int x, int y) {
   // add the var to this view
   int uid = this->GetNextUID();
-  vElements[uid] = new VensimVariableElement(this, var, x, y);
+  SetElement(uid, NewElement(dVariables, this, var, x, y));
   return true;
 }
 
+bool VensimView::AddVarDefinitionAround(Variable *var, int x, int y) {
+  mGrid.FreeNear(x, y);
+  return AddVarDefinition(var, x, y);
+}
+
+bool VensimView::AddVarDefinitionNear(Variable *var, const std::vector<Variable *> &near, bool after) {
+  // past the ones here (where each is first shown) on the side it goes -
+  // right of its inputs or left of what uses it - level with their middle
+  int x = 0;
+  long y = 0;
+  int count = 0;
+  for (Variable *other : near) {
+    const std::vector<int> &uids = VariableUIDs(other);
+    if (!uids.empty()) {
+      VensimViewElement *ele = vElements[uids[0]];
+      int edge = after ? ele->X() + ele->Width() : ele->X() - ele->Width();
+      if (!count || (after ? edge > x : edge < x))
+        x = edge;
+      y += ele->Y();
+      count++;
+    }
+  }
+  if (!count)
+    return false;
+  return AddVarDefinitionAround(var, after ? x + VIEW_GRID_WIDTH : x - VIEW_GRID_WIDTH, static_cast<int>(y / count));
+}
+
 // add if msising - if extra just ignore
 void VensimView::CheckLinksIn() {
   int uid;
@@ -292,7 +393,7 @@ void VensimView::CheckLinksIn() {
       VensimVariableElement *vele = static_cast<VensimVariableElement *>(ele);
       Variable *var = vele->GetVariable();
       if (var && var->VariableType() != XMILE_Type_STOCK && !vele->Ghost()) {
-        std::vector<Variable *> ins = var->GetInputVars();
+        const std::vector<Variable *> &ins = var->GetInputVars();
         for (Variable *in : ins) {
           if (!this->FindInArrow(in, uid) && in->VariableType() != XMILE_Type_ARRAY &&
               in->VariableType() != XMILE_Type_ARRAY_ELM && in->VariableType() != XMILE_Type_UNKNOWN) {
@@ -300,7 +401,7 @@ void VensimView::CheckLinksIn() {
             int x = (vElements[fromuid]->X() + vele->X()) / 2;
             int y = (vElements[fromuid]->Y() + vele->Y()) / 2;
             int nuid = this->GetNextUID();
-            vElements[nuid] = new VensimConnectorElement(fromuid, uid, x, y);
+            SetElement(nuid, NewElement(dConnectors, fromuid, uid, x, y));
           }
         }
         this->RemoveExtraArrowsIn(ins, uid);  // sometimes there are anomolous arrows that show up
@@ -310,9 +411,10 @@ void VensimView::CheckLinksIn() {
 }
 
 bool VensimView::FindInArrow(Variable *in, int target) {
-  for (VensimViewElement *ele : this->vElements) {
-    if (ele && ele->Type() == VensimViewElement::ElementTypeCONNECTOR) {
-      VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(ele);
+  // arrows into a flow may point at the valve just before it
+  for (int key = target - 1; key <= target; key++) {
+    for (int cuid : Find(mConnectorsTo, key)) {
+      VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(vElements[cuid]);
       int to = cele->To();
       VensimValveElement *tele = static_cast<VensimValveElement *>(vElements[to]);
       if (tele && tele->Type() == VensimViewElement::ElementTypeVALVE && tele->Attached())
@@ -330,10 +432,12 @@ bool VensimView::FindInArrow(Variable *in, int target) {
   return false;
 }
 
-void VensimView::RemoveExtraArrowsIn(std::vector<Variable *> ins, int target) {
-  for (VensimViewElement *ele : this->vElements) {
-    if (ele && ele->Type() == VensimViewElement::ElementTypeCONNECTOR) {
-      VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(ele);
+void VensimView::RemoveExtraArrowsIn(const std::vector<Variable *> &ins, int target) {
+  std::vector<int> invalid;
+  // arrows into a flow may point at the valve just before it
+  for (int key = target - 1; key <= target; key++) {
+    for (int cuid : Find(mConnectorsTo, key)) {
+      VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(vElements[cuid]);
       int to = cele->To();
       VensimValveElement *tele = static_cast<VensimValveElement *>(vElements[to]);
       if (tele && tele->Type() == VensimViewElement::ElementTypeVALVE && tele->Attached())
@@ -351,23 +455,25 @@ void VensimView::RemoveExtraArrowsIn(std::vector<Variable *> ins, int target) {
           }
         }
         if (!found)
-          cele->Invalidate();
+          invalid.push_back(cuid);
       }
     }
   }
+  for (int cuid : invalid) {  // the indices move with the ends
+    VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(vElements[cuid]);
+    Unindex(mConnectorsTo[cele->To()], cuid);
+    Unindex(mConnectorsFrom[cele->From()], cuid);
+    cele->Invalidate();
+    Index(cuid);
+  }
 }
 
 int VensimView::FindVariable(Variable *in, int x, int y) {
-  int uid = 0;
-  for (VensimViewElement *ele : this->vElements) {
-    if (ele && ele->Type() == VensimViewElement::ElementTypeVARIABLE) {
-      VensimVariableElement *vele = static_cast<VensimVariableElement *>(ele);
-      if (vele->GetVariable() == in)
-        return uid;
-    }
-    uid++;
-  }
-  uid = GetNextUID();
-  vElements[uid] = new VensimVariableElement(this, in, x, y);
+  const std::vector<int> &uids = VariableUIDs(in);
+  if (!uids.empty())
+    return uids[0];
+  mGrid.FreeNear(x, y);
+  int uid = GetNextUID();
+  SetElement(uid, NewElement(dVariables, this, in, x, y));
   return uid;
 }
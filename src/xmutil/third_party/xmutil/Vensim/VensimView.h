@@ -1,11 +1,15 @@
 #ifndef _XMUTIL_VENSIM_VENSIMVIEW_H
 #define _XMUTIL_VENSIM_VENSIMVIEW_H
+#include <deque>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 #include "../Model.h"
 #include "../Symbol/Parse.h"
 #include "../Symbol/Symbol.h"
 #include "VensimLex.h"
+#include "ViewGrid.h"
 class VensimParse;
 class VensimView;
 class Variable;
@@ -13,6 +17,8 @@ class Variable;
 class VensimViewElement {
 public:
   enum ElementType { ElementTypeVARIABLE, ElementTypeVALVE, ElementTypeCOMMENT, ElementTypeCONNECTOR };
+  virtual ~VensimViewElement() {
+  }
   virtual ElementType Type() = 0;
   int X() {
     return _x;
@@ -26,6 +32,12 @@ public:
   void SetY(int y) {
     _y = y;
   }
+  int Width() {
+    return _width;
+  }
+  int Height() {
+    return _height;
+  }
 
 protected:
   int _x;
@@ -36,7 +48,7 @@ protected:
 typedef std::vector<VensimViewElement *> VensimViewElements;
 class VensimVariableElement : public VensimViewElement {
 public:
-  VensimVariableElement(VensimView *view, char *curpos, char *buf, VensimParse *parser);
+  VensimVariableElement(VensimView *view, VensimSpan curpos, VensimParse *parser);
   VensimVariableElement(VensimView *view, Variable *var, int x, int y);
   ElementType Type() {
     return ElementTypeVARIABLE;
@@ -64,7 +76,7 @@ public:
   ElementType Type() {
     return ElementTypeVALVE;
   }
-  VensimValveElement(char *curpos, char *buf, VensimParse *parser);
+  VensimValveElement(VensimSpan curpos, VensimParse *parser);
   bool Attached() {
     return _attached;
   }
@@ -77,14 +89,16 @@ public:
   ElementType Type() {
     return ElementTypeCOMMENT;
   }
-  VensimCommentElement(char *curpos, char *buf, VensimParse *parser);
+  // scratch is the line after curpos - only used if HasScratchName
+  VensimCommentElement(VensimSpan curpos, VensimSpan scratch, VensimParse *parser);
+  static bool HasScratchName(VensimSpan curpos, VensimParse *parser);
 };
 class VensimConnectorElement : public VensimViewElement {
 public:
   ElementType Type() {
     return ElementTypeCONNECTOR;
   }
-  VensimConnectorElement(char *curpos, char *buf, VensimParse *parser);
+  VensimConnectorElement(VensimSpan curpos, VensimParse *parser);
   VensimConnectorElement(int from, int to, int x, int y);
   int From() {
     return _from;
@@ -104,13 +118,17 @@ private:
 
 class VensimView : public View {
 public:
+  VensimView()
+      : _uid_offset(0), _min_x(INT32_MAX), _min_y(INT32_MAX), _max_x(-INT32_MAX), _max_y(-INT32_MAX), _off_x(0),
+        _off_y(0), bIndexed(false) {
+  }
   const std::string &Title() {
     return sTitle;
   }
   void SetTitle(const std::string &title) {
     sTitle = title;
   }
-  void ReadView(VensimParse *parser, char *buf);
+  void ReadView(VensimParse *parser, VensimSpan &line);
   int GetNextUID();
   VensimViewElements &Elements() {
     return vElements;
@@ -119,22 +137,65 @@ public:
   bool UpgradeGhost(Variable *var);
   bool AddFlowDefinition(Variable *var, Variable *upstream, Variable *downstream);
   bool AddVarDefinition(Variable *var, int x, int y);
+  bool AddVarDefinitionAround(Variable *var, int x, int y);
+  bool AddVarDefinitionNear(Variable *var, const std::vector<Variable *> &near, bool after);
   void CheckLinksIn();
   bool FindInArrow(Variable *source, int target);
-  void RemoveExtraArrowsIn(std::vector<Variable *> ins, int target);
+  void RemoveExtraArrowsIn(const std::vector<Variable *> &ins, int target);
   int FindVariable(Variable *in, int x, int y);  // add if necessary - returns UID
+  const std::vector<int> &ConnectorsFrom(int uid);  // in UID order
 
+  // the view is kept where the sketch put it and moved to start at x,y
+  // only as it is written out - add OffsetX and OffsetY to each element
   int SetViewStart(int x, int y, int uid);  // returns last uid val + 1
-  int GetViewMaxX(int defval);
+  int GetViewMaxX(int defval);              // once moved
   int GetViewMaxY(int defval);
   int UIDOffset() {
     return _uid_offset;
   }
+  int OffsetX() {
+    return _off_x;
+  }
+  int OffsetY() {
+    return _off_y;
+  }
 
 private:
+  typedef std::unordered_map<int, std::vector<int>> UIDIndex;
+  // elements live in per type pools owned by the view - a deque never moves
+  // what it holds so vElements can point straight into them
+  template <class T, class... Args> static T *NewElement(std::deque<T> &pool, Args &&...args) {
+    pool.emplace_back(std::forward<Args>(args)...);
+    return &pool.back();
+  }
+  void SetElement(int uid, VensimViewElement *ele);  // adds to the indices and the bounds as well
+  void Bound(VensimViewElement *ele);
+  void Index(int uid);
+  void BuildIndex(void);
+  const std::vector<int> &Find(UIDIndex &index, int key);
+  const std::vector<int> &VariableUIDs(Variable *var);
+
   VensimViewElements vElements;
+  std::deque<VensimVariableElement> dVariables;
+  std::deque<VensimValveElement> dValves;
+  std::deque<VensimCommentElement> dComments;
+  std::deque<VensimConnectorElement> dConnectors;
   std::string sTitle;
   int _uid_offset;
+  // the extent of the elements as they are added, and where SetViewStart moves them
+  int _min_x;
+  int _min_y;
+  int _max_x;
+  int _max_y;
+  int _off_x;
+  int _off_y;
+  // UIDs (ascending) of the variable elements for each variable and of the
+  // connectors by their ends - built on first use, once the sketch is read
+  std::unordered_map<Variable *, std::vector<int>> mVariableUIDs;
+  UIDIndex mConnectorsTo;
+  UIDIndex mConnectorsFrom;
+  ViewGrid mGrid;  // where elements other than connectors are, for putting more in free space
+  bool bIndexed;
 };
 
 #endif
\ No newline at end of file
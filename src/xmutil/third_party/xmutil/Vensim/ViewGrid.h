@@ -0,0 +1,90 @@
+#ifndef _XMUTIL_VENSIM_VIEWGRID_H
+#define _XMUTIL_VENSIM_VIEWGRID_H
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#define VIEW_GRID_WIDTH 80   // about the size of a variable's name
+#define VIEW_GRID_HEIGHT 40  // with room around it
+#define VIEW_GRID_RINGS 64   // as far as FreeNear looks before giving up
+
+/* ViewGrid - the cells of a uniform grid over a view that have an
+   element in them, so finding a free spot near a point looks only at the
+   cells around it (a hash lookup each) rather than at every element
+
+   an element takes every cell its box reaches into, and what is put in
+   a free cell goes in the middle of it, so nothing put in can overlap
+   what was there (or was put in) before
+
+   a ring around a point that was found full stays full as nothing is
+   taken off the grid, so many things put near one point (the stragglers
+   on the first view) go past the full rings straight away */
+class ViewGrid {
+public:
+  // width and height are from the middle to the edge, as in the sketch
+  void Add(int x, int y, int width, int height) {
+    width = std::min(std::max(width, 0), VIEW_GRID_WIDTH * VIEW_GRID_RINGS);  // not a cell per pixel for
+    height = std::min(std::max(height, 0), VIEW_GRID_HEIGHT * VIEW_GRID_RINGS);  // a nonsense size
+    int right = Cell(x + width, VIEW_GRID_WIDTH);
+    int bottom = Cell(y + height, VIEW_GRID_HEIGHT);
+    for (int cy = Cell(y - height, VIEW_GRID_HEIGHT); cy <= bottom; cy++) {
+      for (int cx = Cell(x - width, VIEW_GRID_WIDTH); cx <= right; cx++)
+        mCells.insert(Key(cx, cy));
+    }
+  }
+  // moves x,y to the middle of the nearest free cell, its own if that is
+  // free - left as it is if there is nothing free close enough
+  void FreeNear(int &x, int &y) {
+    int cx = Cell(x, VIEW_GRID_WIDTH);
+    int cy = Cell(y, VIEW_GRID_HEIGHT);
+    if (!Taken(cx, cy)) {
+      x = cx * VIEW_GRID_WIDTH + VIEW_GRID_WIDTH / 2;
+      y = cy * VIEW_GRID_HEIGHT + VIEW_GRID_HEIGHT / 2;
+      return;
+    }
+    int &first = mFullRings[Key(cx, cy)];  // the rings inside are known full
+    for (int ring = first > 1 ? first : 1; ring <= VIEW_GRID_RINGS; ring++) {
+      int best_dx = 0, best_dy = 0;
+      long best = -1;
+      for (int dy = -ring; dy <= ring; dy++) {
+        int step = abs(dy) == ring ? 1 : 2 * ring;  // just the edge of the ring
+        for (int dx = -ring; dx <= ring; dx += step) {
+          if (Taken(cx + dx, cy + dy))
+            continue;
+          long dist = static_cast<long>(dx) * dx * VIEW_GRID_WIDTH * VIEW_GRID_WIDTH +
+                      static_cast<long>(dy) * dy * VIEW_GRID_HEIGHT * VIEW_GRID_HEIGHT;
+          if (best < 0 || dist < best) {
+            best = dist;
+            best_dx = dx;
+            best_dy = dy;
+          }
+        }
+      }
+      if (best >= 0) {
+        first = ring;
+        x = (cx + best_dx) * VIEW_GRID_WIDTH + VIEW_GRID_WIDTH / 2;
+        y = (cy + best_dy) * VIEW_GRID_HEIGHT + VIEW_GRID_HEIGHT / 2;
+        return;
+      }
+    }
+    first = VIEW_GRID_RINGS + 1;
+  }
+
+private:
+  static int Cell(int v, int size) {
+    return v >= 0 ? v / size : -((-v + size - 1) / size);  // rounded down
+  }
+  static uint64_t Key(int cx, int cy) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32 | static_cast<uint32_t>(cy);
+  }
+  bool Taken(int cx, int cy) const {
+    return mCells.count(Key(cx, cy)) != 0;
+  }
+  std::unordered_set<uint64_t> mCells;
+  std::unordered_map<uint64_t, int> mFullRings;  // by the cell looked around
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "Workers.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Limits.h"
+#include "Progress.h"
+#include "Stats.h"
+#include "XMUtil.h"
+
+#ifndef XMUTIL_NO_THREADS
+#include <thread>
+#endif
+
+bool RunWorkers(size_t count, uint32_t threads, const std::function<bool(size_t item, uint32_t worker)> &work) {
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  auto worker = [&](uint32_t index) {
+    for (size_t i = next++; i < count && !failed; i = next++) {
+      if (!work(i, index)) {
+        failed = true;  // the others may as well stop too
+        break;
+      }
+    }
+  };
+
+#ifdef XMUTIL_NO_THREADS
+  worker(0);
+#else
+  if (threads == 0)
+    threads = _available_threads();
+  if (threads > count)
+    threads = static_cast<uint32_t>(count);
+  ConversionLimits *limits = ConversionLimits::Current();
+  ConversionProgress *progress = ConversionProgress::Current();
+  XMUtilStats *stats = ConversionStats::Current();
+  std::vector<std::unique_ptr<XMUtilStats>> counted;  // for each thread helping, when stats are being kept
+  std::vector<std::thread> workers;
+  for (uint32_t i = 1; i < threads; i++) {
+    XMUtilStats *own = NULL;
+    if (stats) {
+      counted.emplace_back(new XMUtilStats());
+      own = counted.back().get();
+    }
+    try {
+      workers.emplace_back([&worker, limits, progress, own, i]() {
+        ConversionLimits::Scope limitsScope{limits};
+        ConversionProgress::Scope progressScope{progress};
+        std::unique_ptr<ConversionStats::Scope> statsScope;
+        if (own)
+          statsScope.reset(new ConversionStats::Scope(own));
+        worker(i);
+      });
+    } catch (...) {
+      break;  // couldn't get another thread - make do with what we have
+    }
+  }
+  worker(0);  // the calling thread takes its share too
+  for (std::thread &t : workers)
+    t.join();
+  for (std::unique_ptr<XMUtilStats> &own : counted)
+    ConversionStats::Add(stats, *own);
+#endif
+  return !failed;
+}
@@ -0,0 +1,27 @@
+#ifndef _XMUTIL_WORKERS_H
+#define _XMUTIL_WORKERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+/* RunWorkers - spreads count items of work across up to threads threads,
+   the calling one among them
+
+   each thread claims the next item as it finishes one, so a slow item
+   only holds up the thread that has it.  work(item, worker) is told which
+   of the threads (0 being the calling one, up to threads - 1) is doing it,
+   for anything kept per thread.  Once any call returns false no more items
+   are started, and RunWorkers returns false.  A thread that can't be had
+   is done without, leaving the others more to do.
+
+   the threads helping take the calling thread's ConversionLimits and
+   ConversionProgress, and count into ConversionStats of their own that are
+   added to the calling thread's once they are done - so whatever they do
+   is stopped, reported and counted as it would be on the calling thread.
+   With XMUTIL_NO_THREADS everything is done in order on the calling
+   thread */
+bool RunWorkers(size_t count, uint32_t threads, const std::function<bool(size_t item, uint32_t worker)> &work);
+
+#endif
@@ -4,12 +4,35 @@
 #include "XMUtil.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <locale>
+#include <memory>
+#include <sstream>
+#include <vector>
 
+#include "CodeGenerator.h"
+#include "ConversionSession.h"
+#include "DataStore.h"
+#include "Limits.h"
+#include "MappedFile.h"
 #include "Model.h"
+#include "Progress.h"
+#include "Stats.h"
+#include "Symbol/SymbolArena.h"
 #include "Vensim/VensimParse.h"
+#include "Workers.h"
+#include "Xmile/GzipWriter.h"
+#include "Xmile/XMILEWriter.h"
 #include "libutf/utf.h"
 
+#ifndef XMUTIL_NO_THREADS
+#include <mutex>
+#include <thread>
+#endif
+
 std::string SpaceToUnderBar(const std::string &s) {
   std::string rval{s};
   std::replace(rval.begin(), rval.end(), ' ', '_');
@@ -23,27 +46,210 @@ bool StringMatch(const std::string &f, const std::string &s) {
   return strncasecmp(f.c_str(), s.c_str(), f.size()) == 0;
 }
 
-char *utf8ToLower(const char *src, size_t srcLen) {
-  int n;
-  Rune u;
+// the powers of 10 that are exact as doubles
+static const double ExactPowersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
 
-  size_t dstLen = 0;
-  for (size_t srcOff = 0; srcOff<srcLen && * src> 0 && (n = chartorune(&u, &src[srcOff])); srcOff += n) {
-    const Rune l = tolowerrune(u);
-    dstLen += runelen(l);
+double StringToDouble(const char *s, size_t len) {
+  // the common case of a short mantissa and a small exponent can be done
+  // exactly with a single multiply or divide (Clinger's fast path) - the
+  // rest go through the classic locale stream conversion
+  const char *end = s + len;
+  const char *p = s;
+  uint64_t mantissa = 0;
+  int digits = 0;       // significant digits in mantissa
+  int exponent = 0;     // power of 10 to apply to mantissa
+  bool exact = true;  // false if nonzero digits were dropped
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa)
+        digits++;
+    } else {
+      exponent++;
+      if (*p != '0')
+        exact = false;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa)
+          digits++;
+        exponent--;
+      } else if (*p != '0')
+        exact = false;
+    }
   }
+  const char *mantissaEnd = p;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-'))
+      negative = *p++ == '-';
+    int e = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (e < 100000)
+        e = e * 10 + (*p - '0');
+    }
+    exponent += negative ? -e : e;
+  }
+  if (mantissa == 0 && exact)
+    return 0;
+  if (exact && mantissa <= (uint64_t(1) << 53)) {
+    double m = static_cast<double>(mantissa);
+    if (exponent >= 0 && exponent <= 22)
+      return m * ExactPowersOf10[exponent];
+    if (exponent < 0 && exponent >= -22)
+      return m / ExactPowersOf10[-exponent];
+  }
+  // without an exponent the stream might not stop where we do
+  std::string text(s, p - s);
+  if (p != mantissaEnd && (text.back() < '0' || text.back() > '9'))
+    text.resize(mantissaEnd - s);  // 1e or 1e+ means no exponent
+  std::istringstream in(text);
+  in.imbue(std::locale::classic());
+  double val = 0;
+  in >> val;
+  return val;
+}
 
-  char *dst = new char[dstLen + 1];
-  memset(dst, 0, dstLen + 1);
+void AppendDouble(std::string &out, double val) {
+  // whole numbers print the same at any precision and are most of what
+  // shows up in equations
+  if (val > -1e6 && val < 1e6 && val == static_cast<double>(static_cast<int64_t>(val)) &&
+      !(val == 0 && std::signbit(val))) {
+    char digits[8];
+    int n = 0;
+    int64_t i = static_cast<int64_t>(val);
+    if (i < 0)
+      out.push_back('-');
+    uint64_t u = i < 0 ? -i : i;
+    do {
+      digits[n++] = static_cast<char>('0' + u % 10);
+      u /= 10;
+    } while (u);
+    while (n)
+      out.push_back(digits[--n]);
+    return;
+  }
+  char buf[32];
+  if (!std::isfinite(val)) {
+    snprintf(buf, sizeof(buf), "%g", val);
+    out.append(buf);
+    return;
+  }
+  // start from the 6 digits a stream would give, adding digits until the
+  // text reads back as the same number
+  double mag = std::fabs(val);
+  int len = 0;
+  for (int precision = 6; precision <= 17; precision++) {
+    len = snprintf(buf, sizeof(buf), "%.*g", precision, mag);
+    for (int i = 0; i < len; i++) {
+      if ((buf[i] < '0' || buf[i] > '9') && buf[i] != 'e' && buf[i] != '+' && buf[i] != '-')
+        buf[i] = '.';  // whatever the locale uses for a decimal point
+    }
+    if (StringToDouble(buf, len) == mag)
+      break;
+  }
+  if (std::signbit(val))
+    out.push_back('-');
+  out.append(buf, len);
+}
 
-  size_t dstOff = 0;
-  for (size_t srcOff = 0; srcOff<srcLen && * src> 0 && (n = chartorune(&u, &src[srcOff])); srcOff += n) {
-    Rune l = tolowerrune(u);
-    const int size = runetochar(&dst[dstOff], &l);
-    dstOff += size;
+void AppendFixed(std::string &out, double val) {
+  double mag = std::fabs(val);
+  double scaled = mag * 1e6;
+  double whole = std::floor(scaled);
+  // below 1e7 the scaling is off by far less than 0.01, so only values
+  // that land near a rounding boundary need printf to decide
+  if (mag < 1e7 && std::fabs(scaled - whole - 0.5) > 0.01) {
+    uint64_t u = static_cast<uint64_t>(scaled - whole > 0.5 ? whole + 1 : whole);
+    char digits[24];
+    int n = 0;
+    while (n < 6) {
+      digits[n++] = static_cast<char>('0' + u % 10);
+      u /= 10;
+    }
+    digits[n++] = '.';
+    do {
+      digits[n++] = static_cast<char>('0' + u % 10);
+      u /= 10;
+    } while (u);
+    if (std::signbit(val))
+      out.push_back('-');
+    while (n)
+      out.push_back(digits[--n]);
+    return;
+  }
+  char buf[512];  // %f of DBL_MAX is 316 characters
+  int len = snprintf(buf, sizeof(buf), "%f", val);
+  if (std::isfinite(val)) {
+    for (int i = 0; i < len; i++) {
+      if ((buf[i] < '0' || buf[i] > '9') && buf[i] != '-')
+        buf[i] = '.';
+    }
   }
+  out.append(buf, len);
+}
 
-  return dst;
+uint32_t RuneToLower(uint32_t u) {
+  // tolowerrune searches ranges - the whole BMP looked up once, then indexed
+  static const std::vector<uint16_t> bmp = [] {
+    std::vector<uint16_t> table(0x10000);
+    for (Rune r = 0; r < 0x10000; r++) {
+      Rune l = tolowerrune(r);
+      table[r] = static_cast<uint16_t>(l < 0x10000 ? l : r);
+    }
+    return table;
+  }();
+  return u < 0x10000 ? bmp[u] : tolowerrune(u);
+}
+
+size_t utf8ToLower(const char *src, size_t srcLen, char *dst) {
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t high = 0x8080808080808080ull;
+  size_t i = 0, o = 0;
+  while (i < srcLen) {
+    if (srcLen - i >= 8) {
+      uint64_t w;
+      memcpy(&w, src + i, 8);
+      // eight ascii bytes with no NUL among them - the high bit of each
+      // byte of a is set from 'A' up and of z past 'Z', so those between
+      // get 0x20 added
+      if (!((w | ((w - ones) & ~w)) & high)) {
+        uint64_t a = w + 0x3f * ones;
+        uint64_t z = w + 0x25 * ones;
+        w |= (a & ~z & high) >> 2;
+        memcpy(dst + o, &w, 8);
+        i += 8;
+        o += 8;
+        continue;
+      }
+    }
+    char c = src[i];
+    if (!c)
+      break;
+    if (!(c & 0x80)) {
+      dst[o++] = c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+      i++;
+      continue;
+    }
+    Rune u = Runeerror;
+    int len = 1;
+    if (fullrune(const_cast<char *>(src + i), static_cast<int>(srcLen - i)))
+      len = chartorune(&u, src + i);
+    if (u == Runeerror && len == 1) {
+      dst[o++] = c;  // not utf-8 or cut short - kept as it is
+    } else {
+      Rune l = RuneToLower(u);
+      o += runetochar(dst + o, &l);
+    }
+    i += len;
+  }
+  dst[o] = 0;
+  return o;
 }
 
 double AngleFromPoints(double startx, double starty, double pointx, double pointy, double endx, double endy) {
@@ -225,49 +431,825 @@ double AngleFromPoints(double startx, double starty, double pointx, double point
   return 33;
 }
 
+std::string Diagnostic::Describe(void) const {
+  std::string desc;
+  if (iLine > 0) {
+    desc = "line " + std::to_string(iLine) + ": ";
+  }
+  desc.append(sMessage);
+  if (!sVariable.empty()) {
+    desc.append(" (in " + sVariable + ")");
+  }
+  return desc;
+}
+
+// XMUTIL_OK unless the limits the conversion is under were hit, in which
+// case diags says which
+static int LimitStatus(std::vector<Diagnostic> *diags) {
+  ConversionLimits *limits = ConversionLimits::Current();
+  if (!limits || limits->Status() == XMUTIL_OK)
+    return XMUTIL_OK;
+  if (diags)
+    diags->push_back(Diagnostic(limits->Status(), limits->Describe()));
+  return limits->Status();
+}
+
+// the time each stage of a conversion took, into seconds[XMUTIL_STAGE_] -
+// nothing is timed if seconds is NULL
+class StageTimer {
+public:
+  explicit StageTimer(double *seconds) : pSeconds(seconds), tStart(std::chrono::steady_clock::now()) {
+  }
+  bool Timing(void) const {
+    return pSeconds != nullptr;
+  }
+  void End(int stage) {
+    if (pSeconds) {
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      pSeconds[stage] = std::chrono::duration<double>(now - tStart).count();
+      tStart = now;
+    }
+  }
+
+private:
+  double *pSeconds;
+  std::chrono::steady_clock::time_point tStart;
+};
+
+// hands back in *xmile what write - a conversion or a write of a model
+// already read - gives, as _convert_mdl_to_xmile_v2 describes.  write
+// is passed the XMILEWriter to use
+template <typename Write>
+static int Deliver(bool isCompact, uint32_t flags, char **xmile, size_t *xmileLen, std::vector<Diagnostic> &diags,
+                   Write write) {
+  // compressed as it is written, so the text is never all held at once
+  std::unique_ptr<GzipWriter> gzip(flags & XMUTIL_OUTPUT_GZIP ? new GzipWriter : nullptr);
+  XMILEWriter writer{isCompact, gzip ? GzipWriter::Sink : nullptr, gzip.get()};
+  int status = write(&writer);
+  if (status == XMUTIL_OK) {
+    if (gzip) {
+      writer.Flush();
+      gzip->Finish();
+      *xmile = gzip->Release(xmileLen);
+    } else {
+      *xmile = writer.Release(xmileLen);
+    }
+    if (*xmile)
+      return status;
+    status = XMUTIL_ERROR_OUTPUT;
+    diags.push_back(Diagnostic(XMUTIL_ERROR_OUTPUT, "out of memory writing the XMILE"));
+  }
+  std::string message;
+  for (const Diagnostic &diag : diags) {
+    if (!message.empty())
+      message.push_back('\n');
+    message.append(diag.Describe());
+  }
+  *xmile = strdup(message.c_str());
+  if (xmileLen)
+    *xmileLen = message.size();
+  return status;
+}
+
 extern "C" {
-// returns NULL on error or a string containing XMILE that the caller now owns
-char *_convert_mdl_to_xmile(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact) {
-  Model m{};
+// reads mdlSource into m and takes it through everything up to printing,
+// returning an XMUTIL_ status - diags gets whatever was found wrong with
+// the equations.  With read set the MDL comes from that rather than
+// mdlSource.  m's arena must be the current one
+static int ReadMdl(Model &m, const char *mdlSource, uint32_t mdlSourceLen, StageTimer &timer, uint32_t flags,
+                   std::vector<Diagnostic> *diags, XMUtilReader read, void *readContext) {
+  if (timer.Timing() && !read) {
+    VensimLex lex{nullptr};
+    lex.Initialize(mdlSource, mdlSourceLen);
+    lex.SkimTokens();
+    timer.End(XMUTIL_STAGE_LEX);
+  }
 
   // parse the input
   {
+    XMUTIL_TIME(readSeconds);
+    XMUTIL_ALLOCATIONS(XMUTIL_STAGE_PARSE);
     VensimParse vp{&m};
-    if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
-      return nullptr;
+    vp.SetSkipViews((flags & XMUTIL_SKIP_VIEWS) != 0);
+    vp.SetShareExpressions((flags & XMUTIL_SHARE_EXPRESSIONS) != 0);
+    vp.SetSkipDocs((flags & XMUTIL_SKIP_DOCS) != 0);
+    vp.SetThreads(flags & XMUTIL_PARALLEL_PARSE ? _available_threads() : 1);
+    bool ok = read ? vp.ProcessStream("<stream>", read, readContext)
+                   : vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen);
+    // what went wrong reading may only be from stopping short, so a limit
+    // being hit is all that is reported
+    if (int status = LimitStatus(diags))
+      return status;
+    if (!ok) {
+      if (diags)
+        *diags = vp.Diagnostics();
+      return XMUTIL_ERROR_PARSE;
     }
   }
+  timer.End(XMUTIL_STAGE_PARSE);
+  XMUTIL_COUNT(variables, m.GetNameSpace()->Variables().size());
 
-  // if(m->AnalyzeEquations()) {
-  //   m->Simulate() ;
-  //   m->OutputComputable(true);
-  // }
+  // before marking types turns INTEG expressions into flows with no units
+  if ((flags & XMUTIL_CHECK_UNITS) && diags)
+    m.UnitsCheck(*diags);
 
   // mark variable types and potentially convert INTEG equations
   // involving expressions into flows (a single net flow on the first
   // pass though this)
-  m.MarkVariableTypes(nullptr);
+  {
+    XMUTIL_TIME(markTypesSeconds);
+    XMUTIL_ALLOCATIONS(XMUTIL_STAGE_MARK_TYPES);
+    m.MarkVariableTypes(nullptr);
 
-  for (MacroFunction *mf : m.MacroFunctions()) {
-    m.MarkVariableTypes(mf->NameSpace());
+    for (MacroFunction *mf : m.MacroFunctions()) {
+      m.MarkVariableTypes(mf->NameSpace());
+    }
   }
+  timer.End(XMUTIL_STAGE_MARK_TYPES);
 
   // if there is a view then try to make sure everything is defined in
   // the views put unknowns in a heap in the first view at 20,20 but
   // for things that have connections try to put them in the right
   // place
-  m.AttachStragglers();
+  {
+    XMUTIL_TIME(attachSeconds);
+    XMUTIL_ALLOCATIONS(XMUTIL_STAGE_ATTACH);
+    m.AttachStragglers();
+  }
+  timer.End(XMUTIL_STAGE_ATTACH);
+  return LimitStatus(diags);
+}
 
-  // TODO: expose errs
+// writes m, as ReadMdl left it, to writer as XMILE.  flags are the
+// output ones, XMUTIL_MINIMAL
+static int WriteModel(Model &m, XMILEWriter *writer, StageTimer &timer, uint32_t flags,
+                      std::vector<Diagnostic> *diags) {
   std::vector<std::string> errs;
-  std::string xmile = m.PrintXMILE(isCompact, errs);
+  {
+    XMUTIL_TIME(printSeconds);
+    XMUTIL_ALLOCATIONS(XMUTIL_STAGE_PRINT);
+    writer->SetMinimal((flags & XMUTIL_MINIMAL) != 0);
+    m.PrintXMILE(writer, errs);
+  }
+  timer.End(XMUTIL_STAGE_PRINT);
+  XMUTIL_COUNT(outputBytes, writer->Written());
+  if (int status = LimitStatus(diags))
+    return status;  // the output is cut short
+
+  if (diags) {
+    for (const std::string &err : errs)
+      diags->push_back(Diagnostic(XMUTIL_ERROR_OUTPUT, err));
+  }
+  return errs.empty() ? XMUTIL_OK : XMUTIL_ERROR_OUTPUT;
+}
+
+// the conversion itself - stageSeconds is NULL unless the stages are being
+// timed.  Writes the XMILE for mdlSource to writer, returning an XMUTIL_
+// status - diags gets whatever was found wrong with the equations or the
+// output.  With read set the MDL comes from that rather than mdlSource
+static int ConvertMdl(const char *mdlSource, uint32_t mdlSourceLen, XMILEWriter *writer, double *stageSeconds,
+                      uint32_t flags = 0, std::vector<Diagnostic> *diags = nullptr, XMUtilReader read = nullptr,
+                      void *readContext = nullptr) {
+  StageTimer timer{stageSeconds};
+  Model m{};
+  SymbolArena::Scope arenaScope{m.Arena()};
+  if (int status = ReadMdl(m, mdlSource, mdlSourceLen, timer, flags, diags, read, readContext))
+    return status;
+  int status = WriteModel(m, writer, timer, flags, diags);
+  // once written, as looking changes the model
+  if (status == XMUTIL_OK && (flags & XMUTIL_CHECK_LOOPS) && diags)
+    m.LoopsCheck(*diags);
+  return status;
+}
+
+// the conversion shared by the functions that report more than NULL
+static int ConvertMdlDiagnosed(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags,
+                               char **xmile, size_t *xmileLen, std::vector<Diagnostic> &diags,
+                               XMUtilReader read = nullptr, void *readContext = nullptr) {
+  return Deliver(isCompact, flags, xmile, xmileLen, diags, [&](XMILEWriter *writer) {
+    return ConvertMdl(mdlSource, mdlSourceLen, writer, nullptr, flags, &diags, read, readContext);
+  });
+}
+
+char *_convert_mdl_to_xmile(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact) {
+  XMILEWriter writer{isCompact};
+  if (ConvertMdl(mdlSource, mdlSourceLen, &writer, nullptr) != XMUTIL_OK) {
+    return nullptr;
+  }
+  // the writer's buffer is handed over as is rather than copied
+  return writer.Release(nullptr);
+}
+
+char *_convert_mdl_to_xmile_flags(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags) {
+  XMILEWriter writer{isCompact};
+  if (ConvertMdl(mdlSource, mdlSourceLen, &writer, nullptr, flags) != XMUTIL_OK) {
+    return nullptr;
+  }
+  return writer.Release(nullptr);
+}
+
+char *_convert_mdl_to_xmile_stats(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags,
+                                  XMUtilStats *stats) {
+  ConversionStats::Scope statsScope{stats};
+  XMILEWriter writer{isCompact};
+  if (ConvertMdl(mdlSource, mdlSourceLen, &writer, nullptr, flags) != XMUTIL_OK) {
+    return nullptr;
+  }
+  return writer.Release(nullptr);
+}
+
+int _convert_mdl_to_xmile_v2(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags,
+                             char **xmile, size_t *xmileLen) {
+  std::vector<Diagnostic> diags;
+  return ConvertMdlDiagnosed(mdlSource, mdlSourceLen, isCompact, flags, xmile, xmileLen, diags);
+}
+
+// diags as the one block of XMUtilDiagnostic (strings packed in after the
+// structs) handed out by the functions that report them
+static void PackDiagnostics(const std::vector<Diagnostic> &diags, XMUtilDiagnostic **diagnostics,
+                            uint32_t *diagnosticCount) {
+  *diagnostics = nullptr;
+  *diagnosticCount = 0;
+  if (diags.empty())
+    return;
+
+  size_t size = diags.size() * sizeof(XMUtilDiagnostic);
+  for (const Diagnostic &diag : diags)
+    size += diag.sMessage.size() + diag.sVariable.size() + 2;
+  char *block = static_cast<char *>(malloc(size));
+  if (!block)
+    return;
+  XMUtilDiagnostic *out = reinterpret_cast<XMUtilDiagnostic *>(block);
+  char *text = block + diags.size() * sizeof(XMUtilDiagnostic);
+  auto pack = [&text](const std::string &s) {
+    memcpy(text, s.c_str(), s.size() + 1);
+    const char *packed = text;
+    text += s.size() + 1;
+    return packed;
+  };
+  for (size_t i = 0; i < diags.size(); i++) {
+    out[i].kind = diags[i].iKind;
+    out[i].line = diags[i].iLine;
+    out[i].position = diags[i].iPosition;
+    out[i].message = pack(diags[i].sMessage);
+    out[i].variable = pack(diags[i].sVariable);
+  }
+  *diagnostics = out;
+  *diagnosticCount = static_cast<uint32_t>(diags.size());
+}
+
+int _convert_mdl_to_xmile_diagnostics(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags,
+                                      char **xmile, size_t *xmileLen, XMUtilDiagnostic **diagnostics,
+                                      uint32_t *diagnosticCount) {
+  std::vector<Diagnostic> diags;
+  int status = ConvertMdlDiagnosed(mdlSource, mdlSourceLen, isCompact, flags, xmile, xmileLen, diags);
+  PackDiagnostics(diags, diagnostics, diagnosticCount);
+  return status;
+}
+
+int _convert_mdl_to_xmile_limited(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags,
+                                  const XMUtilLimits *limits, char **xmile, size_t *xmileLen,
+                                  XMUtilDiagnostic **diagnostics, uint32_t *diagnosticCount) {
+  ConversionLimits conversionLimits{limits};
+  ConversionLimits::Scope limitsScope{&conversionLimits};
+  std::vector<Diagnostic> diags;
+  int status = ConvertMdlDiagnosed(mdlSource, mdlSourceLen, isCompact, flags, xmile, xmileLen, diags);
+  PackDiagnostics(diags, diagnostics, diagnosticCount);
+  return status;
+}
+
+int _convert_mdl_to_xmile_progress(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact, uint32_t flags,
+                                   XMUtilProgress progress, void *context, char **xmile, size_t *xmileLen) {
+  ConversionProgress conversionProgress{progress, context, mdlSourceLen};
+  ConversionProgress::Scope progressScope{progress ? &conversionProgress : nullptr};
+  std::vector<Diagnostic> diags;
+  return ConvertMdlDiagnosed(mdlSource, mdlSourceLen, isCompact, flags, xmile, xmileLen, diags);
+}
+
+int _convert_mdl_file_to_xmile(const char *path, bool isCompact, uint32_t flags, char **xmile, size_t *xmileLen,
+                               XMUtilDiagnostic **diagnostics, uint32_t *diagnosticCount) {
+  std::vector<Diagnostic> diags;
+  MappedFile file;
+  int status = XMUTIL_ERROR_READ;
+  if (!file.Open(path))
+    diags.push_back(Diagnostic(XMUTIL_ERROR_READ, file.Error()));
+  else if (file.Length() > UINT32_MAX)
+    diags.push_back(Diagnostic(XMUTIL_ERROR_READ, std::string(path) + " is too big to convert"));
+  else
+    status = ConvertMdlDiagnosed(file.Data(), static_cast<uint32_t>(file.Length()), isCompact, flags, xmile, xmileLen,
+                                 diags);
+  if (status == XMUTIL_ERROR_READ) {
+    *xmile = strdup(diags.back().sMessage.c_str());
+    if (xmileLen)
+      *xmileLen = diags.back().sMessage.size();
+  }
+  PackDiagnostics(diags, diagnostics, diagnosticCount);
+  return status;
+}
+
+int _convert_mdl_reader_to_xmile(XMUtilReader read, void *context, bool isCompact, uint32_t flags, char **xmile,
+                                 size_t *xmileLen, XMUtilDiagnostic **diagnostics, uint32_t *diagnosticCount) {
+  std::vector<Diagnostic> diags;
+  int status = ConvertMdlDiagnosed(nullptr, 0, isCompact, flags, xmile, xmileLen, diags, read, context);
+  PackDiagnostics(diags, diagnostics, diagnosticCount);
+  return status;
+}
+
+void xmutil_free_result(void *result) {
+  free(result);
+}
+
+static thread_local char *tInputBuffer = nullptr;
+static thread_local uint32_t tInputBufferSize = 0;
+
+char *xmutil_input_buffer(uint32_t size) {
+  if (size > tInputBufferSize || !tInputBuffer) {
+    // grow geometrically so a run of slightly bigger models doesn't
+    // reallocate every time
+    uint32_t grown = std::max<uint32_t>(size, std::min<uint64_t>(uint64_t(tInputBufferSize) * 2, UINT32_MAX));
+    grown = std::max<uint32_t>(grown, 4096);
+    // the old contents needn't survive, so free first rather than realloc
+    free(tInputBuffer);
+    tInputBuffer = static_cast<char *>(malloc(grown));
+    tInputBufferSize = tInputBuffer ? grown : 0;
+  }
+  return tInputBuffer;
+}
+
+void xmutil_release_input_buffer(void) {
+  free(tInputBuffer);
+  tInputBuffer = nullptr;
+  tInputBufferSize = 0;
+  SymbolArena::Trim();
+}
+
+bool _convert_mdl_to_xmile_sink(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                void (*sink)(const char *data, size_t len, void *context), void *context) {
+  XMILEWriter writer{isCompact, sink, context};
+  return ConvertMdl(mdlSource, mdlSourceLen, &writer, nullptr) == XMUTIL_OK;
+}
+
+char *_convert_mdl_to_xmile_timed(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                  double *stageSeconds) {
+  for (int i = 0; i < XMUTIL_STAGE_COUNT; i++)
+    stageSeconds[i] = 0;
+  XMILEWriter writer{isCompact};
+  if (ConvertMdl(mdlSource, mdlSourceLen, &writer, stageSeconds) != XMUTIL_OK) {
+    return nullptr;
+  }
+  return writer.Release(nullptr);
+}
+
+static thread_local uint32_t tAvailableThreads = 0;  // 0 for one per core
+
+uint32_t _available_threads(void) {
+#ifdef XMUTIL_NO_THREADS
+  return 1;
+#else
+  if (tAvailableThreads)
+    return tAvailableThreads;
+  uint32_t n = std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;  // 0 when it can't be told
+#endif
+}
+
+void _set_available_threads(uint32_t threads) {
+  tAvailableThreads = threads;
+}
+
+// converts count MDL buffers using up to nThreads threads (0 means one per
+// core).  results[i] gets what _convert_mdl_to_xmile returns for source i
+void _convert_mdl_to_xmile_batch(const char *const *mdlSources, const uint32_t *mdlSourceLens, uint32_t count,
+                                 bool isCompact, uint32_t nThreads, char **results) {
+  // workers claim the next unconverted source as they finish, so one huge
+  // model only ties up a single thread while the others drain the rest
+  RunWorkers(count, nThreads, [&](size_t i, uint32_t) {
+    results[i] = _convert_mdl_to_xmile(mdlSources[i], mdlSourceLens[i], isCompact);
+    return true;
+  });
+}
+
+// a header line of tab separated names then one line of values per saved time
+static void AppendResults(std::string &out, const SimulationResults &results) {
+  for (size_t i = 0; i < results.vNames.size(); i++) {
+    if (i)
+      out.push_back('\t');
+    out.append(results.vNames[i]);
+  }
+  out.push_back('\n');
+  for (size_t row = 0; row < results.Rows(); row++) {
+    for (size_t col = 0; col < results.vNames.size(); col++) {
+      if (col)
+        out.push_back('\t');
+      AppendDouble(out, results.Value(row, col));
+    }
+    out.push_back('\n');
+  }
+}
+
+// runs the model with the native engine - see AppendResults for the text
+char *_simulate_mdl(const char *mdlSource, uint32_t mdlSourceLen) {
+  SimulationResults results;
+  {
+    Model m{};
+    SymbolArena::Scope arenaScope{m.Arena()};
+    {
+      VensimParse vp{&m};
+      vp.SetSkipViews(true);  // the run never looks at the diagram
+      if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
+        return nullptr;
+      }
+    }
+    if (!m.Simulate(&results)) {
+      return nullptr;
+    }
+  }
+
+  std::string out;
+  AppendResults(out, results);
+  return strdup(out.c_str());
+}
+
+char *_profile_mdl(const char *mdlSource, uint32_t mdlSourceLen) {
+  std::string out;
+  {
+    Model m{};
+    SymbolArena::Scope arenaScope{m.Arena()};
+    {
+      VensimParse vp{&m};
+      vp.SetSkipViews(true);
+      if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
+        return nullptr;
+      }
+    }
+    // the profile names the variables, so it is reported before they go
+    SimulationPlan plan;
+    SimulationResults results;
+    SimulationProfile profile;
+    if (!m.Compile(&plan) || !plan.Profile(&results, &profile)) {
+      return nullptr;
+    }
+    out = profile.Report();
+  }
+  return strdup(out.c_str());
+}
+
+char *_generate_c_mdl(const char *mdlSource, uint32_t mdlSourceLen) {
+  std::string out;
+  {
+    Model m{};
+    SymbolArena::Scope arenaScope{m.Arena()};
+    {
+      VensimParse vp{&m};
+      vp.SetSkipViews(true);
+      if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
+        return nullptr;
+      }
+    }
+    SimulationPlan plan;
+    if (!m.Compile(&plan, nullptr, 1, true) || !CodeGenerator(&plan).Generate(out)) {
+      return nullptr;
+    }
+  }
+  return strdup(out.c_str());
+}
+
+// _simulate_mdl_runs, or _simulate_mdl_sweep given parameters
+static bool _simulate_runs(const char *mdlSource, uint32_t mdlSourceLen, uint32_t runs, uint64_t seed,
+                           const char *const *parameters, uint32_t parameterCount, const double *values,
+                           const char *const *variables, uint32_t variableCount, uint32_t nThreads,
+                           void (*sink)(uint32_t run, const char *results, size_t len, void *context),
+                           void *context) {
+  Model m{};
+  SymbolArena::Scope arenaScope{m.Arena()};
+  {
+    VensimParse vp{&m};
+    vp.SetSkipViews(true);
+    if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
+      return false;
+    }
+  }
+  // only what the variables asked for (and the parameters) need is
+  // computed, and with enough runs to fill them the plan is compiled for
+  // lanes too.  Parameters aren't folded in as numbers, so they can be set
+  std::vector<std::string> names(variables, variables + variableCount);
+  std::vector<std::string> needed = names;
+  needed.insert(needed.end(), parameters, parameters + parameterCount);
+  SimulationPlan plan;
+  if (!m.Compile(&plan, variableCount ? &needed : nullptr, runs >= SIMULATION_LANES ? SIMULATION_LANES : 1,
+                 parameterCount != 0)) {
+    return false;
+  }
+  std::vector<int> columns;
+  if (variableCount) {
+    if (!plan.Columns(names, columns)) {
+      return false;
+    }
+  }
+  // each names one column, an element of an arrayed variable on its own
+  std::vector<int> set;
+  for (uint32_t i = 0; i < parameterCount; i++) {
+    std::vector<int> found;
+    if (!plan.Columns(std::vector<std::string>{parameters[i]}, found) || found.size() != 1) {
+      return false;
+    }
+    set.push_back(found[0]);
+  }
+  // anything that falls back to evaluating expressions uses the model's
+  // own arrays, so those runs have to take turns in them
+  bool shared = plan.Shared();
+  uint32_t lanes = static_cast<uint32_t>(plan.Lanes());
+
+  // as for batches the workers claim runs as they finish, each with its
+  // own arrays that the plan's code runs against - a lane's worth at a
+  // time, with any left over at the end run one by one
+  uint32_t threads = !shared ? 1 : nThreads ? nThreads : _available_threads();
+  struct Arrays {
+    std::vector<double> level, rate, aux;
+    std::vector<SimulationResults> results;
+    std::vector<SimulationSink *> sinks;
+    std::vector<double> values;  // the runs' parameters, each one's lanes together
+    std::string out;
+  };
+  std::vector<Arrays> arrays(threads);  // for each worker, made as it starts
+#ifndef XMUTIL_NO_THREADS
+  std::mutex sinking;
+#endif
+  return RunWorkers((runs + lanes - 1) / lanes, threads, [&](size_t claimed, uint32_t worker) {
+    Arrays &own = arrays[worker];
+    if (own.results.empty()) {
+      own.level.resize(plan.LevelCount() * lanes);
+      own.rate.resize(plan.LevelCount() * lanes);
+      own.aux.resize(plan.AuxCount() * lanes);
+      own.results.resize(lanes);
+      for (SimulationResults &r : own.results) {
+        own.sinks.push_back(&r);
+      }
+    }
+    uint32_t i = static_cast<uint32_t>(claimed) * lanes;
+    uint32_t count = std::min(lanes, runs - i);
+    // the values of the n runs from first on as RunWith takes them
+    auto spread = [&](uint32_t first, uint32_t n) {
+      own.values.resize(static_cast<size_t>(parameterCount) * n);
+      for (uint32_t p = 0; p < parameterCount; p++) {
+        for (uint32_t lane = 0; lane < n; lane++) {
+          own.values[p * n + lane] = values[static_cast<size_t>(first + lane) * parameterCount + p];
+        }
+      }
+    };
+    bool ok = true;
+    if (count == lanes && lanes > 1 && parameterCount) {
+      spread(i, lanes);
+      ok = plan.RunWith(own.sinks.data(), lanes, set, own.values.data(), seed, i, own.level.data(),
+                        own.rate.data(), own.aux.data(), variableCount ? &columns : nullptr);
+    } else if (count == lanes && lanes > 1) {
+      ok = plan.RunLanes(own.sinks.data(), seed, i, own.level.data(), own.rate.data(), own.aux.data(),
+                         variableCount ? &columns : nullptr);
+    } else {
+      for (uint32_t j = 0; j < count && ok; j++) {
+        if (parameterCount) {
+          // a plan with anything run through the model's own arrays is
+          // never shared, and those runs take the model's parameters
+          spread(i + j, 1);
+          ok = shared && plan.RunWith(&own.sinks[j], 1, set, own.values.data(), seed, i + j, own.level.data(),
+                                      own.rate.data(), own.aux.data(), variableCount ? &columns : nullptr);
+        } else {
+          ok = shared ? plan.Run(&own.results[j], seed, i + j, own.level.data(), own.rate.data(), own.aux.data(),
+                                 variableCount ? &columns : nullptr)
+                      : plan.Run(&own.results[j], seed, i + j, variableCount ? &columns : nullptr);
+        }
+      }
+    }
+    if (!ok) {
+      return false;
+    }
+    for (uint32_t j = 0; j < count; j++) {
+      own.out.clear();
+      AppendResults(own.out, own.results[j]);
+#ifndef XMUTIL_NO_THREADS
+      std::lock_guard<std::mutex> lock{sinking};
+#endif
+      sink(i + j, own.out.data(), own.out.size(), context);
+    }
+    return true;
+  });
+}
+
+bool _simulate_mdl_runs(const char *mdlSource, uint32_t mdlSourceLen, uint32_t runs, uint64_t seed,
+                        const char *const *variables, uint32_t variableCount, uint32_t nThreads,
+                        void (*sink)(uint32_t run, const char *results, size_t len, void *context), void *context) {
+  return _simulate_runs(mdlSource, mdlSourceLen, runs, seed, nullptr, 0, nullptr, variables, variableCount, nThreads,
+                        sink, context);
+}
+
+bool _simulate_mdl_sweep(const char *mdlSource, uint32_t mdlSourceLen, uint32_t runs, uint64_t seed,
+                         const char *const *parameters, uint32_t parameterCount, const double *values,
+                         const char *const *variables, uint32_t variableCount, uint32_t nThreads,
+                         void (*sink)(uint32_t run, const char *results, size_t len, void *context), void *context) {
+  return _simulate_runs(mdlSource, mdlSourceLen, runs, seed, parameters, parameterCount, values, variables,
+                        variableCount, nThreads, sink, context);
+}
+
+bool _simulate_mdl_columns(const char *mdlSource, uint32_t mdlSourceLen, const char *const *variables,
+                           uint32_t variableCount, uint32_t chunkRows,
+                           void (*sink)(const char *names, const double *const *columns, uint32_t columnCount,
+                                        uint32_t rows, void *context),
+                           void *context) {
+  Model m{};
+  SymbolArena::Scope arenaScope{m.Arena()};
+  {
+    VensimParse vp{&m};
+    vp.SetSkipViews(true);
+    if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
+      return false;
+    }
+  }
+  // only what the variables asked for need is computed
+  std::vector<std::string> names(variables, variables + variableCount);
+  SimulationPlan plan;
+  if (!m.Compile(&plan, variableCount ? &names : nullptr)) {
+    return false;
+  }
+  std::vector<int> columns;
+  if (variableCount) {
+    if (!plan.Columns(names, columns)) {
+      return false;
+    }
+  }
+  struct Chunks {
+    void (*sink)(const char *, const double *const *, uint32_t, uint32_t, void *);
+    void *context;
+    std::string names;  // joined for the first chunk
+    std::vector<const double *> columns;
+  } chunks{sink, context, std::string(), std::vector<const double *>()};
+  auto chunk = [](const SimulationColumns &cols, void *context) {
+    Chunks *chunks = static_cast<Chunks *>(context);
+    if (chunks->columns.empty()) {
+      for (const std::string &name : cols.Names()) {
+        if (!chunks->names.empty())
+          chunks->names.push_back('\t');
+        chunks->names.append(name);
+      }
+      chunks->columns.resize(cols.Names().size());
+    }
+    for (size_t i = 0; i < chunks->columns.size(); i++)
+      chunks->columns[i] = cols.Column(i);
+    chunks->sink(chunks->names.c_str(), chunks->columns.data(), static_cast<uint32_t>(chunks->columns.size()),
+                 static_cast<uint32_t>(cols.Rows()), chunks->context);
+  };
+  SimulationColumns cols(chunkRows, chunk, &chunks);
+  return plan.Run(&cols, 0, 0, variableCount ? &columns : nullptr);
+}
+
+// what _simulation_new keeps - the MDL is read again for each rerun, so
+// the constants' new values settle everything they size as they would
+// have from the start
+struct CheckpointedSimulation {
+  std::string sSource;
+  SimulationCheckpoints mCheckpoints;
+  SimulationResults mResults;
+  CheckpointedSimulation(const char *source, uint32_t len, double interval)
+      : sSource(source, len), mCheckpoints(interval) {
+  }
+};
 
-  if (errs.size() != 0) {
+void *_simulation_new(const char *mdlSource, uint32_t mdlSourceLen, double checkpointInterval) {
+  std::unique_ptr<CheckpointedSimulation> sim(new CheckpointedSimulation(mdlSource, mdlSourceLen, checkpointInterval));
+  Model m{};
+  SymbolArena::Scope arenaScope{m.Arena()};
+  {
+    VensimParse vp{&m};
+    vp.SetSkipViews(true);
+    if (!vp.ProcessFile("<in memory>", mdlSource, mdlSourceLen)) {
+      return nullptr;
+    }
+  }
+  SimulationPlan plan;
+  if (!m.Compile(&plan) || !plan.Run(&sim->mResults, 0, 0, nullptr, &sim->mCheckpoints)) {
     return nullptr;
   }
+  return sim.release();
+}
 
-  char *result = strdup(xmile.c_str());
+char *_simulation_rerun(void *simulation, const char *const *names, const double *values, uint32_t count,
+                        uint32_t *reusedRows) {
+  CheckpointedSimulation *sim = static_cast<CheckpointedSimulation *>(simulation);
+  SimulationResults results;
+  std::vector<int> unchanging;
+  {
+    Model m{};
+    SymbolArena::Scope arenaScope{m.Arena()};
+    {
+      VensimParse vp{&m};
+      vp.SetSkipViews(true);
+      if (!vp.ProcessFile("<in memory>", sim->sSource.c_str(), static_cast<uint32_t>(sim->sSource.size()))) {
+        return nullptr;
+      }
+    }
+    std::vector<Variable *> changed;
+    for (uint32_t i = 0; i < count; i++) {
+      double was;
+      Variable *var = m.SetConstant(names[i], values[i], &was);
+      if (!var) {
+        return nullptr;
+      }
+      if (values[i] != was) {
+        changed.push_back(var);
+      }
+    }
+    SimulationPlan plan;
+    if (!m.Compile(&plan) || !plan.Resume(&results, sim->mCheckpoints, changed)) {
+      return nullptr;
+    }
+    unchanging = plan.UnchangingColumns();
+  }
+  // the rows before the resumed ones are the first run's, with the new
+  // values of what the unchanging equations compute
+  const SimulationResults &first = sim->mResults;
+  if (results.vNames != first.vNames || !results.Rows()) {
+    return nullptr;
+  }
+  size_t reused = 0;
+  while (reused < first.Rows() && first.Value(reused, 0) < results.Value(0, 0)) {
+    reused++;
+  }
+  size_t width = first.vNames.size();
+  results.vValues.insert(results.vValues.begin(), first.vValues.begin(), first.vValues.begin() + reused * width);
+  for (size_t row = 0; row < reused; row++) {
+    for (int col : unchanging) {
+      results.vValues[row * width + col + 1] = results.vValues[reused * width + col + 1];
+    }
+  }
+  if (reusedRows) {
+    *reusedRows = static_cast<uint32_t>(reused);
+  }
+  std::string out;
+  AppendResults(out, results);
+  return strdup(out.c_str());
+}
+
+void _simulation_free(void *simulation) {
+  delete static_cast<CheckpointedSimulation *>(simulation);
+}
+
+bool _data_store_add(const char *name, const char *text, uint32_t textLen) {
+  return DataStore::Global().Add(name, text, textLen);
+}
+
+bool _data_store_load(const char *name, const char *path) {
+  return DataStore::Global().Load(name, path);
+}
+
+bool _data_store_write_cache(const char *name, const char *path) {
+  return DataStore::Global().WriteCache(name, path);
+}
+
+void _data_store_clear(void) {
+  DataStore::Global().Clear();
+}
+
+void *_mdl_session_new(bool isCompact, uint32_t flags) {
+  return new ConversionSession(isCompact, flags);
+}
+
+char *_mdl_session_convert(void *session, const char *mdlSource, uint32_t mdlSourceLen, uint32_t *reparsedChunks) {
+  ConversionSession *cs = static_cast<ConversionSession *>(session);
+  bool ok = cs->Convert(mdlSource, mdlSourceLen);
+  if (reparsedChunks)
+    *reparsedChunks = static_cast<uint32_t>(cs->ReparsedChunks());
+  return ok ? strdup(cs->XMILE().c_str()) : nullptr;
+}
+
+void _mdl_session_free(void *session) {
+  delete static_cast<ConversionSession *>(session);
+}
+
+void *_mdl_model_read(const char *mdlSource, uint32_t mdlSourceLen, uint32_t flags, XMUtilDiagnostic **diagnostics,
+                      uint32_t *diagnosticCount) {
+  std::unique_ptr<Model> m(new Model);
+  std::vector<Diagnostic> diags;
+  int status;
+  {
+    SymbolArena::Scope arenaScope{m->Arena()};
+    StageTimer timer{nullptr};
+    status = ReadMdl(*m, mdlSource, mdlSourceLen, timer, flags, &diags, nullptr, nullptr);
+  }
+  if (diagnostics)
+    PackDiagnostics(diags, diagnostics, diagnosticCount);
+  return status == XMUTIL_OK ? m.release() : nullptr;
+}
+
+int _mdl_model_write(void *model, bool isCompact, uint32_t flags, char **xmile, size_t *xmileLen) {
+  Model *m = static_cast<Model *>(model);
+  SymbolArena::Scope arenaScope{m->Arena()};
+  StageTimer timer{nullptr};
+  std::vector<Diagnostic> diags;
+  return Deliver(isCompact, flags, xmile, xmileLen, diags, [&](XMILEWriter *writer) {
+    return WriteModel(*m, writer, timer, flags, &diags);
+  });
+}
 
-  return result;
+void _mdl_model_free(void *model) {
+  delete static_cast<Model *>(model);
 }
 }
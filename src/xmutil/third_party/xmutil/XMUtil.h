@@ -57,19 +57,343 @@ inline void __cdecl operator delete[](void *p) {
 #endif
 #endif
 
+// plain wasm builds have no threads - whatever would be spread across
+// threads is done in order there
+#if defined(__wasm__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define XMUTIL_NO_THREADS
+#endif
+
 #define XMUTIL_EXPORT __attribute__((visibility("default")))
 
 extern "C" {
 // returns NULL on error or a string containing XMILE that the caller now owns
 XMUTIL_EXPORT char *_convert_mdl_to_xmile(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact);
+// as _convert_mdl_to_xmile but the XMILE is passed to sink in pieces as it
+// is written instead of being collected in memory - returns false on error,
+// in which case sink may already have been given part of the output
+XMUTIL_EXPORT bool _convert_mdl_to_xmile_sink(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                              void (*sink)(const char *data, size_t len, void *context),
+                                              void *context);
+// the threads the batch calls use for nThreads 0 - one per core, at least 1
+// - and that XMUTIL_PARALLEL_PARSE reads and large models are written across
+XMUTIL_EXPORT uint32_t _available_threads(void);
+// makes _available_threads give threads on the calling thread, whatever
+// the cores - 0 goes back to one per core.  For trying the threaded paths
+// on a machine with fewer cores than they need
+XMUTIL_EXPORT void _set_available_threads(uint32_t threads);
+// converts count sources across up to nThreads threads (0 for one per core),
+// storing each result as _convert_mdl_to_xmile would in results[i]
+XMUTIL_EXPORT void _convert_mdl_to_xmile_batch(const char *const *mdlSources, const uint32_t *mdlSourceLens,
+                                               uint32_t count, bool isCompact, uint32_t nThreads, char **results);
+// as _convert_mdl_to_xmile but also fills stageSeconds[XMUTIL_STAGE_COUNT]
+// with the time spent in each stage - tokenizing is timed as a separate
+// pass so this does a bit more work than a plain conversion
+#define XMUTIL_STAGE_LEX 0
+#define XMUTIL_STAGE_PARSE 1
+#define XMUTIL_STAGE_MARK_TYPES 2
+#define XMUTIL_STAGE_ATTACH 3
+#define XMUTIL_STAGE_PRINT 4
+#define XMUTIL_STAGE_COUNT 5
+XMUTIL_EXPORT char *_convert_mdl_to_xmile_timed(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                                double *stageSeconds);
+// flags for _convert_mdl_to_xmile_flags
+#define XMUTIL_SKIP_VIEWS 1  // no sketch parsing or diagram output - equations (and groups) only
+// build each subexpression that appears more than once (a*b, SQRT(x), 2)
+// once and point every equation using it at the same nodes - the output is
+// the same, the model takes less memory
+#define XMUTIL_SHARE_EXPRESSIONS 4
+// check the units given for each variable against its equation, adding an
+// XMUTIL_WARNING_UNITS diagnostic for each that doesn't fit - the
+// conversion goes ahead regardless
+#define XMUTIL_CHECK_UNITS 8
+// pass over the comment after each equation so no variable has any
+// documentation - for tools that only want the equations
+#define XMUTIL_SKIP_DOCS 16
+// hand back the output compressed as gzip, compressed as it is written -
+// only for the functions below that give its length as well.
+// What is handed back on an error is left as plain text
+#define XMUTIL_OUTPUT_GZIP 32
+// leave out what XMILE readers assume when it isn't there (the isee:prefs,
+// the header options, method="Euler") and write numbers in the fewest
+// digits that read back the same rather than with 6 decimals.  Along with
+// XMUTIL_SKIP_VIEWS and XMUTIL_SKIP_DOCS this gives the smallest XMILE
+#define XMUTIL_MINIMAL 64
+// look for loops of equations that each need the next computed first (a =
+// b + 1 with b = a * 0.5), adding an XMUTIL_WARNING_SIMULTANEOUS diagnostic
+// naming the variables around each - such a model converts but can't be
+// simulated
+#define XMUTIL_CHECK_LOOPS 128
+// read the equations on one thread per core, each taking a run of them,
+// and put what was read back together in file order - the output is the
+// same.  Models with macros, or read with XMUTIL_SHARE_EXPRESSIONS, are
+// read on one thread
+#define XMUTIL_PARALLEL_PARSE 256
+// as _convert_mdl_to_xmile with XMUTIL_ flags changing what is converted
+XMUTIL_EXPORT char *_convert_mdl_to_xmile_flags(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                                uint32_t flags);
+// where the time in a conversion went, and how much of each thing it did
+typedef struct XMUtilStats {
+  uint64_t inputBytes;
+  uint64_t tokens;
+  uint64_t lookups;        // of names, in the model or a macro
+  uint64_t lookupMisses;   // lookups that found nothing
+  uint64_t recoverySkips;  // equations passed over after an error in one
+  uint64_t variables;      // in the model, macros left out
+  uint64_t outputBytes;
+  double readSeconds;      // the MDL, sketch and settings included
+  double equationSeconds;  // the part of readSeconds spent parsing equations - summed
+                           // over the threads with XMUTIL_PARALLEL_PARSE, so can be more
+  double markTypesSeconds;
+  double attachSeconds;
+  double printSeconds;
+  double printVariablesSeconds;  // the parts of printSeconds writing variables
+  double printViewsSeconds;      // and views - the model's and the macros'
+  // the memory each stage (by XMUTIL_STAGE_, lexing aside) allocated with
+  // new - how many times, how many bytes in all and the most it held at
+  // once over what it started with.  Only counted in builds with
+  // XMUTIL_COUNT_ALLOCATIONS, where allocationsCounted is 1
+  uint64_t allocations[XMUTIL_STAGE_COUNT];
+  uint64_t allocatedBytes[XMUTIL_STAGE_COUNT];
+  uint64_t peakBytes[XMUTIL_STAGE_COUNT];
+  // still allocated once the conversion is done - leaks, along with the
+  // blocks the thread keeps to make its next conversion cheaper
+  int64_t retainedBytes;
+  uint64_t allocationsCounted;
+} XMUtilStats;
+// as _convert_mdl_to_xmile_flags and also fills *stats
+XMUTIL_EXPORT char *_convert_mdl_to_xmile_stats(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                                uint32_t flags, XMUtilStats *stats);
+// status codes for _convert_mdl_to_xmile_v2
+#define XMUTIL_OK 0
+#define XMUTIL_ERROR_PARSE 1   // the MDL couldn't be read
+#define XMUTIL_ERROR_OUTPUT 2  // it was read but couldn't all be written as XMILE
+#define XMUTIL_ERROR_READ 3    // the file it was to be read from couldn't be
+// a diagnostic kind only - never a status
+#define XMUTIL_WARNING_UNITS 4  // an equation whose units don't fit (with XMUTIL_CHECK_UNITS)
+// a conversion given XMUtilLimits that was stopped short
+#define XMUTIL_ERROR_CANCELLED 5  // the cancel flag was set
+#define XMUTIL_ERROR_DEADLINE 6   // it took longer than it was given
+#define XMUTIL_ERROR_MEMORY 7     // the model took more memory than it was given
+// a diagnostic kind only, as XMUTIL_WARNING_UNITS is
+#define XMUTIL_WARNING_SIMULTANEOUS 8  // a loop of simultaneous equations (with XMUTIL_CHECK_LOOPS)
+// as _convert_mdl_to_xmile_flags but returning an XMUTIL_ status and handing
+// back the length along with the text - on XMUTIL_OK *xmile is the XMILE,
+// otherwise a (possibly empty) description of what went wrong.  *xmile is
+// then the caller's to pass to xmutil_free_result.  xmileLen may be NULL
+XMUTIL_EXPORT int _convert_mdl_to_xmile_v2(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                           uint32_t flags, char **xmile, size_t *xmileLen);
+// one thing found wrong with a model
+typedef struct XMUtilDiagnostic {
+  int32_t kind;          // one of the XMUTIL_ERROR_ codes or XMUTIL_WARNING_ kinds
+  uint32_t line;         // 1 based, 0 when not from reading the MDL
+  uint32_t position;     // how far into the line reading had got
+  const char *message;
+  const char *variable;  // whose equation was being read - "" if none
+} XMUtilDiagnostic;
+// as _convert_mdl_to_xmile_v2 and also sets *diagnostics to
+// *diagnosticCount descriptions of what went wrong (NULL if nothing did),
+// held in one block - strings included - for xmutil_free_result.  Parsing
+// goes on past errors so all the bad equations are listed
+XMUTIL_EXPORT int _convert_mdl_to_xmile_diagnostics(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                                    uint32_t flags, char **xmile, size_t *xmileLen,
+                                                    XMUtilDiagnostic **diagnostics, uint32_t *diagnosticCount);
+// bounds on one conversion, so a bad file can't hold up a worker for long
+typedef struct XMUtilLimits {
+  // stops the conversion soon after it is set non-zero, from any thread -
+  // NULL for no flag
+  const int32_t *cancel;
+  double seconds;        // how long it may take, 0 for as long as it needs
+  uint64_t memoryBytes;  // how much memory the model may take, 0 for no limit
+} XMUtilLimits;
+// as _convert_mdl_to_xmile_diagnostics but giving up with one of the
+// XMUTIL_ERROR_ codes above once a limit is hit - *xmile then says which
+// and there is a diagnostic saying so too.  limits may be NULL
+XMUTIL_EXPORT int _convert_mdl_to_xmile_limited(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                                uint32_t flags, const XMUtilLimits *limits, char **xmile,
+                                                size_t *xmileLen, XMUtilDiagnostic **diagnostics,
+                                                uint32_t *diagnosticCount);
+// how far a conversion has got, for _convert_mdl_to_xmile_progress
+#define XMUTIL_PROGRESS_BYTES 0      // done is the bytes of MDL read so far, total all of them
+#define XMUTIL_PROGRESS_EQUATIONS 1  // done is the equations read so far, total 0 as it isn't known
+#define XMUTIL_PROGRESS_VIEWS 2      // done is the views written so far, total all of them
+typedef void (*XMUtilProgress)(void *context, int32_t stage, uint32_t done, uint32_t total);
+// as _convert_mdl_to_xmile_v2 but calling progress as the conversion goes
+// (see Progress.h for how often) - on the converting thread or one helping
+// it, but never two at once
+XMUTIL_EXPORT int _convert_mdl_to_xmile_progress(const char *mdlSource, uint32_t mdlSourceLen, bool isCompact,
+                                                 uint32_t flags, XMUtilProgress progress, void *context,
+                                                 char **xmile, size_t *xmileLen);
+// as _convert_mdl_to_xmile_diagnostics but converting the file at path,
+// which is memory mapped where possible rather than copied into a buffer
+// first.  XMUTIL_ERROR_READ if it can't be read
+XMUTIL_EXPORT int _convert_mdl_file_to_xmile(const char *path, bool isCompact, uint32_t flags, char **xmile,
+                                             size_t *xmileLen, XMUtilDiagnostic **diagnostics,
+                                             uint32_t *diagnosticCount);
+// gives the MDL a piece at a time - copies up to size bytes into buffer
+// returning how many, 0 once there is no more
+typedef size_t (*XMUtilReader)(void *context, char *buffer, size_t size);
+// as _convert_mdl_to_xmile_diagnostics but with the MDL pulled from read
+// as it is needed, so the whole of it never has to be in memory at once -
+// only the sketch and settings at the end are (a window of a little more
+// than the longest equation is kept while reading the rest)
+XMUTIL_EXPORT int _convert_mdl_reader_to_xmile(XMUtilReader read, void *context, bool isCompact, uint32_t flags,
+                                               char **xmile, size_t *xmileLen, XMUtilDiagnostic **diagnostics,
+                                               uint32_t *diagnosticCount);
+// frees what any of the functions here return
+XMUTIL_EXPORT void xmutil_free_result(void *result);
+// somewhere, reused from call to call, to copy at least size bytes of MDL
+// into before converting it - saves embedders (wasm especially) a malloc
+// and free per conversion.  It is the calling thread's and stays valid
+// until the next call asking for more or xmutil_release_input_buffer.
+// Returns NULL if out of memory
+XMUTIL_EXPORT char *xmutil_input_buffer(uint32_t size);
+// frees the input buffer along with the model memory the thread keeps
+// back to make its next conversion cheaper
+XMUTIL_EXPORT void xmutil_release_input_buffer(void);
+// simulates the model in process instead of converting it - returns NULL on
+// error or if the model uses something that can't be simulated yet,
+// otherwise tab separated results (names first, then a row per saved time)
+// that the caller now owns
+XMUTIL_EXPORT char *_simulate_mdl(const char *mdlSource, uint32_t mdlSourceLen);
+// simulates the model as _simulate_mdl does, timing each equation as it
+// goes, and returns NULL as it would or a tab separated table of where the
+// time went (see SimulationProfile::Report in Model.h) - a line for each
+// variable, the one that took the longest first
+XMUTIL_EXPORT char *_profile_mdl(const char *mdlSource, uint32_t mdlSourceLen);
+// the model as the source of a C module that simulates it with no
+// interpreter (see CodeGenerator.h for its interface), or NULL if it
+// doesn't simulate or some of it has no C to give
+XMUTIL_EXPORT char *_generate_c_mdl(const char *mdlSource, uint32_t mdlSourceLen);
+// simulates the model runs times over up to nThreads threads (0 for one
+// per core), compiling it only once.  Each run's random functions draw from
+// a stream of its own, so run i's results depend on just seed and i however
+// many threads there are.  sink is given each run's results as it finishes
+// - formatted as by _simulate_mdl, but with only Time and the variableCount
+// variables named (all of them if none are), and only what those need is
+// computed - in no particular order but never by two threads at once.
+// False if the model can't be simulated, a variable isn't in it or a run
+// fails, in which case some runs may already have gone to sink
+XMUTIL_EXPORT bool _simulate_mdl_runs(const char *mdlSource, uint32_t mdlSourceLen, uint32_t runs, uint64_t seed,
+                                      const char *const *variables, uint32_t variableCount, uint32_t nThreads,
+                                      void (*sink)(uint32_t run, const char *results, size_t len, void *context),
+                                      void *context);
+// simulates the model runs times as _simulate_mdl_runs does, but run i
+// with the parameterCount parameters named set to values[i *
+// parameterCount] on rather than as the MDL has them - a sensitivity
+// sweep.  A parameter is a variable whose equation is a number, or an
+// element of one named as its column is (stock[north]), other than the
+// control parameters.  The runs that go in step each take their own
+// values.  False as for _simulate_mdl_runs, or if a parameter can't be set
+// that way or the model needs to be run through its own arrays
+XMUTIL_EXPORT bool _simulate_mdl_sweep(const char *mdlSource, uint32_t mdlSourceLen, uint32_t runs, uint64_t seed,
+                                       const char *const *parameters, uint32_t parameterCount, const double *values,
+                                       const char *const *variables, uint32_t variableCount, uint32_t nThreads,
+                                       void (*sink)(uint32_t run, const char *results, size_t len, void *context),
+                                       void *context);
+// simulates the model once, with the random functions drawing from stream 0
+// of seed 0, handing sink what is recorded as columns rather than text -
+// Time and the variableCount variables named (all of them if none are).
+// names is their names, tab separated, and columns columnCount pointers to
+// rows float64s, in the same order.  Only chunkRows saved times (0 for the
+// whole run) are held at once and they go to sink each time they fill,
+// so sink is given the run a chunk at a time.  False as for
+// _simulate_mdl_runs, in which case some chunks may already have gone
+XMUTIL_EXPORT bool _simulate_mdl_columns(const char *mdlSource, uint32_t mdlSourceLen, const char *const *variables,
+                                         uint32_t variableCount, uint32_t chunkRows,
+                                         void (*sink)(const char *names, const double *const *columns,
+                                                      uint32_t columnCount, uint32_t rows, void *context),
+                                         void *context);
+// a model simulated once as _simulate_mdl does, taking a checkpoint every
+// checkpointInterval of model time (see SimulationCheckpoints in Model.h),
+// for what-if runs with _simulation_rerun - NULL if it can't be simulated
+XMUTIL_EXPORT void *_simulation_new(const char *mdlSource, uint32_t mdlSourceLen, double checkpointInterval);
+// the results _simulate_mdl would give for the model with the count
+// constants named set to values, the rest as the MDL has them.  The run
+// carries on from the last checkpoint before the earliest time those
+// constants can make a difference, found from what reads them, and the
+// rows before that are copied from the first run - reusedRows (if not
+// NULL) is set to how many were.  NULL as for _simulate_mdl, or if a name
+// isn't a variable whose equation is a number.  A simulation may be rerun
+// from any thread but not from two at once
+XMUTIL_EXPORT char *_simulation_rerun(void *simulation, const char *const *names, const double *values,
+                                      uint32_t count, uint32_t *reusedRows);
+XMUTIL_EXPORT void _simulation_free(void *simulation);
+// external data for GET DIRECT DATA and the GET DATA functions, kept for
+// the rest of the process and shared by every model simulated in it (see
+// DataStore.h) - name is the file as the models name it.  _data_store_add
+// is given CSV or tab separated text, _data_store_load a file of either or
+// a cache written by _data_store_write_cache, which is mapped rather than
+// parsed.  False if the data can't be read or written
+XMUTIL_EXPORT bool _data_store_add(const char *name, const char *text, uint32_t textLen);
+XMUTIL_EXPORT bool _data_store_load(const char *name, const char *path);
+XMUTIL_EXPORT bool _data_store_write_cache(const char *name, const char *path);
+// forgets all of it - simulations already compiled keep what they read
+XMUTIL_EXPORT void _data_store_clear(void);
+// a session converts successive edits of one MDL buffer - a version with
+// nothing changed since the last gets its XMILE back without converting,
+// and one with only some equations changed has just those read again (see
+// ConversionSession.h).  _mdl_session_convert returns what
+// _convert_mdl_to_xmile_flags would, and sets reparsedChunks (if not NULL)
+// to the number of equation chunks it read
+XMUTIL_EXPORT void *_mdl_session_new(bool isCompact, uint32_t flags);
+XMUTIL_EXPORT char *_mdl_session_convert(void *session, const char *mdlSource, uint32_t mdlSourceLen,
+                                         uint32_t *reparsedChunks);
+XMUTIL_EXPORT void _mdl_session_free(void *session);
+// a model read once and then written any number of times, for converting
+// the same MDL with different output options (isCompact, XMUTIL_MINIMAL,
+// XMUTIL_OUTPUT_GZIP) without reading and analyzing it again for each.
+// The flags given _mdl_model_read are those changing what is read - XMUTIL_SKIP_VIEWS, XMUTIL_SKIP_DOCS, XMUTIL_SHARE_EXPRESSIONS
+// and XMUTIL_CHECK_UNITS - finding loops sets a model up to be simulated,
+// so XMUTIL_CHECK_LOOPS is only for conversions.  It returns NULL if the
+// MDL can't be read, and sets *diagnostics (if diagnostics isn't NULL) as
+// _convert_mdl_to_xmile_diagnostics does, units warnings included.
+// _mdl_model_write hands back what _convert_mdl_to_xmile_v2 would for the
+// MDL with the read and output flags together.  A model may be written from
+// any thread but not from two at once
+XMUTIL_EXPORT void *_mdl_model_read(const char *mdlSource, uint32_t mdlSourceLen, uint32_t flags,
+                                    XMUtilDiagnostic **diagnostics, uint32_t *diagnosticCount);
+XMUTIL_EXPORT int _mdl_model_write(void *model, bool isCompact, uint32_t flags, char **xmile, size_t *xmileLen);
+XMUTIL_EXPORT void _mdl_model_free(void *model);
 }
 
-char *utf8ToLower(const char *src, size_t srcLen);
+// what goes into an XMUtilDiagnostic
+class Diagnostic {
+public:
+  Diagnostic(int kind, const std::string &message, int line = 0, int position = 0,
+             const std::string &variable = std::string())
+      : iKind(kind), iLine(line), iPosition(position), sMessage(message), sVariable(variable) {
+  }
+  std::string Describe(void) const;  // as one line of text
+  int iKind;
+  int iLine;
+  int iPosition;
+  std::string sMessage;
+  std::string sVariable;
+};
+
+// the lower case of a unicode code point
+uint32_t RuneToLower(uint32_t u);
+// lower cases utf-8 into dst, stopping at a NUL, and gives the length
+// written (dst is terminated too).  dst needs UTF8_LOWER_ROOM(srcLen)
+// bytes as a few letters take a byte more lower case (U+023A is U+2C65).
+// Bytes that aren't utf-8 are copied as they are
+#define UTF8_LOWER_ROOM(len) ((len) + (len) / 2 + 1)
+size_t utf8ToLower(const char *src, size_t srcLen, char *dst);
 
 // utility functions
 std::string SpaceToUnderBar(const std::string &s);
 // ascii only
 bool StringMatch(const std::string &f, const std::string &s);
+// digits[.digits][e[+-]digits] to the nearest double independent of the
+// locale - s need not be terminated, parsing stops at the first character
+// that does not fit
+double StringToDouble(const char *s, size_t len);
+// appends val using the fewest digits (but at least the 6 a stream would
+// use) that read back as exactly val, again independent of the locale
+void AppendDouble(std::string &out, double val);
+// appends val with 6 digits after the decimal point - the same text as
+// printf %f (and so std::to_string) but always with a '.'
+void AppendFixed(std::string &out, double val);
 double AngleFromPoints(double startx, double starty, double pointx, double pointy, double endx, double endy);
 std::string ReadFile(FILE *file, int &error);
 #endif
@@ -0,0 +1,469 @@
+#include "GzipWriter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "../XMUtil.h"
+
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+#define GZIP_END_BLOCK 256
+
+namespace {
+
+struct CrcTable {
+  CrcTable(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      entries[i] = c;
+    }
+  }
+  uint32_t entries[256];
+};
+const CrcTable kCrc;
+
+// the length codes (257 up) and distance codes with the extra bits after
+// them and what those are added to - RFC 1951 3.2.5
+int LengthCode(size_t len, int &extra, size_t &base) {
+  size_t v = len - GZIP_MIN_MATCH;
+  if (len == GZIP_MAX_MATCH) {
+    extra = 0;
+    base = GZIP_MAX_MATCH;
+    return 285;
+  }
+  if (v < 8) {
+    extra = 0;
+    base = len;
+    return 257 + static_cast<int>(v);
+  }
+  int n = 3;
+  while (v >> (n + 1))
+    n++;
+  size_t low = v >> (n - 2) & 3;
+  extra = n - 2;
+  base = ((4 | low) << (n - 2)) + GZIP_MIN_MATCH;
+  return 257 + 4 * (n - 1) + static_cast<int>(low);
+}
+int DistCode(size_t dist, int &extra, size_t &base) {
+  size_t v = dist - 1;
+  if (v < 4) {
+    extra = 0;
+    base = dist;
+    return static_cast<int>(v);
+  }
+  int n = 2;
+  while (v >> (n + 1))
+    n++;
+  size_t low = v >> (n - 1) & 1;
+  extra = n - 1;
+  base = ((2 | low) << (n - 1)) + 1;
+  return 2 * n + static_cast<int>(low);
+}
+
+// Huffman code lengths for freq[0..n) of no more than maxBits, 0 for the
+// symbols not used.  A symbol used alone still gets a 1 bit code
+void CodeLengths(const uint32_t *freq, int n, int maxBits, uint8_t *lengths) {
+  memset(lengths, 0, n);
+  std::vector<std::pair<uint32_t, int>> used;  // freq and symbol, least frequent first
+  for (int i = 0; i < n; i++) {
+    if (freq[i])
+      used.push_back(std::make_pair(freq[i], i));
+  }
+  if (used.empty())
+    return;
+  if (used.size() == 1) {
+    lengths[used[0].second] = 1;
+    return;
+  }
+  std::sort(used.begin(), used.end());
+
+  // the leaves are taken in order and the nodes made from them come out in
+  // order too, so the two lightest are always at the front of one or other
+  size_t m = used.size();
+  std::vector<uint64_t> weight(2 * m - 1);
+  std::vector<size_t> parent(2 * m - 1);
+  for (size_t i = 0; i < m; i++)
+    weight[i] = used[i].first;
+  size_t leaf = 0, node = m;
+  for (size_t made = m; made < 2 * m - 1; made++) {
+    size_t pick[2];
+    for (size_t &p : pick)
+      p = leaf < m && (node == made || weight[leaf] <= weight[node]) ? leaf++ : node++;
+    weight[made] = weight[pick[0]] + weight[pick[1]];
+    parent[pick[0]] = parent[pick[1]] = made;
+  }
+  std::vector<int> depth(2 * m - 1);
+  depth[2 * m - 2] = 0;
+  for (size_t i = 2 * m - 2; i-- > 0;)
+    depth[i] = depth[parent[i]] + 1;  // a parent is always made after its children
+
+  // codes too long are cut to maxBits and shorter ones lengthened until the
+  // lengths make a code again
+  std::vector<uint32_t> count(maxBits + 1, 0);
+  for (size_t i = 0; i < m; i++)
+    count[std::min(depth[i], maxBits)]++;
+  uint32_t total = 0;
+  for (int len = 1; len <= maxBits; len++)
+    total += count[len] << (maxBits - len);
+  for (; total > 1u << maxBits; total--) {
+    count[maxBits]--;
+    for (int len = maxBits - 1; len > 0; len--) {
+      if (count[len]) {
+        count[len]--;
+        count[len + 1] += 2;
+        break;
+      }
+    }
+  }
+  // the longest to the least frequent
+  size_t next = 0;
+  for (int len = maxBits; len > 0; len--) {
+    for (uint32_t i = 0; i < count[len]; i++)
+      lengths[used[next++].second] = static_cast<uint8_t>(len);
+  }
+}
+
+// the canonical codes for lengths, bit reversed as deflate sends them
+void Codes(const uint8_t *lengths, int n, uint16_t *codes) {
+  uint16_t count[16] = {0};
+  for (int i = 0; i < n; i++)
+    count[lengths[i]]++;
+  count[0] = 0;
+  uint16_t next[16];
+  uint16_t code = 0;
+  for (int len = 1; len < 16; len++) {
+    code = static_cast<uint16_t>((code + count[len - 1]) << 1);
+    next[len] = code;
+  }
+  for (int i = 0; i < n; i++) {
+    int len = lengths[i];
+    uint16_t c = len ? next[len]++ : 0;
+    uint16_t reversed = 0;
+    for (int b = 0; b < len; b++)
+      reversed = static_cast<uint16_t>(reversed << 1 | (c >> b & 1));
+    codes[i] = reversed;
+  }
+}
+
+// the code length codes - a length, or a run of them
+struct LengthRun {
+  uint8_t code;   // 0-15 a length, 16 the last again, 17 and 18 zeros
+  uint8_t extra;  // how many more than the least the run can be
+};
+const int kLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+const int kLengthExtra[19] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+
+void RunLengths(const uint8_t *lengths, int n, std::vector<LengthRun> &runs) {
+  for (int i = 0; i < n;) {
+    uint8_t len = lengths[i];
+    int run = 1;
+    while (i + run < n && lengths[i + run] == len)
+      run++;
+    i += run;
+    if (!len) {
+      for (; run >= 11; run -= std::min(run, 138))
+        runs.push_back(LengthRun{18, static_cast<uint8_t>(std::min(run, 138) - 11)});
+      if (run >= 3) {
+        runs.push_back(LengthRun{17, static_cast<uint8_t>(run - 3)});
+        run = 0;
+      }
+    } else {
+      runs.push_back(LengthRun{len, 0});
+      for (run--; run >= 3; run -= std::min(run, 6))
+        runs.push_back(LengthRun{16, static_cast<uint8_t>(std::min(run, 6) - 3)});
+    }
+    for (; run > 0; run--)
+      runs.push_back(LengthRun{len, 0});
+  }
+}
+
+}  // namespace
+
+GzipWriter::GzipWriter(void) : vHead(size_t(1) << GZIP_HASH_BITS, 0), vPrev(GZIP_WINDOW, 0) {
+  iBase = 0;
+  iPos = 0;
+  memset(vLitFreq, 0, sizeof(vLitFreq));
+  memset(vDistFreq, 0, sizeof(vDistFreq));
+  iCrc = 0xffffffff;
+  iTotal = 0;
+  iBits = 0;
+  iBitCount = 0;
+  pOut = NULL;
+  iOutLength = 0;
+  iOutCapacity = 0;
+  bFinished = false;
+  bFailed = false;
+  vSymbols.reserve(GZIP_BLOCK_SYMBOLS);
+  // no name, time or extra fields - deflate, and unknown OS
+  static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255};
+  for (uint8_t byte : header)
+    PutByte(byte);
+}
+
+GzipWriter::~GzipWriter(void) {
+  free(pOut);
+}
+
+void GzipWriter::PutByte(uint8_t byte) {
+  if (iOutLength == iOutCapacity && !bFailed) {
+    size_t capacity = iOutCapacity ? iOutCapacity * 2 : 4096;
+    char *out = static_cast<char *>(realloc(pOut, capacity));
+    if (!out)
+      bFailed = true;
+    else {
+      pOut = out;
+      iOutCapacity = capacity;
+    }
+  }
+  if (!bFailed)
+    pOut[iOutLength++] = static_cast<char>(byte);
+}
+
+void GzipWriter::PutBits(uint32_t value, int count) {
+  iBits |= static_cast<uint64_t>(value) << iBitCount;
+  iBitCount += count;
+  for (; iBitCount >= 8; iBitCount -= 8) {
+    PutByte(static_cast<uint8_t>(iBits));
+    iBits >>= 8;
+  }
+}
+
+void GzipWriter::Write(const char *data, size_t len) {
+  if (bFinished || bFailed || !len)
+    return;
+  uint32_t crc = iCrc;
+  for (size_t i = 0; i < len; i++)
+    crc = kCrc.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (crc >> 8);
+  iCrc = crc;
+  iTotal += static_cast<uint32_t>(len);
+  vInput.insert(vInput.end(), data, data + len);
+  // a match starting before end can go as far as it could with all the text
+  size_t end = iBase + vInput.size();
+  if (end - iPos > GZIP_MAX_MATCH)
+    Deflate(end - GZIP_MAX_MATCH);
+}
+
+void GzipWriter::Finish(void) {
+  if (bFinished)
+    return;
+  Deflate(iBase + vInput.size());
+  WriteBlock(true);
+  if (iBitCount)
+    PutBits(0, 8 - iBitCount);
+  for (uint32_t word : {~iCrc, iTotal}) {
+    for (int i = 0; i < 4; i++)
+      PutByte(static_cast<uint8_t>(word >> (8 * i)));
+  }
+  bFinished = true;
+  std::vector<unsigned char>().swap(vInput);
+}
+
+char *GzipWriter::Release(size_t *length) {
+  if (!bFinished || bFailed || !pOut) {
+    if (length)
+      *length = 0;
+    return NULL;
+  }
+  char *rval = pOut;
+  if (length)
+    *length = iOutLength;
+  pOut = NULL;
+  iOutLength = iOutCapacity = 0;
+  return rval;
+}
+
+void GzipWriter::Insert(size_t pos, size_t end) {
+  if (pos + GZIP_MIN_MATCH > end)
+    return;
+  const unsigned char *p = &vInput[pos - iBase];
+  uint32_t h = (static_cast<uint32_t>(p[0]) | p[1] << 8 | p[2] << 16) * 2654435761u >> (32 - GZIP_HASH_BITS);
+  vPrev[pos % GZIP_WINDOW] = vHead[h];
+  vHead[h] = pos + 1;
+}
+
+// the longest match for the text at pos that ends by end, 0 if there isn't
+// one of at least GZIP_MIN_MATCH - looked for before pos is put in the chains
+size_t GzipWriter::Longest(size_t pos, size_t end, size_t &dist) const {
+  size_t most = std::min<size_t>(end - pos, GZIP_MAX_MATCH);
+  if (most < GZIP_MIN_MATCH)
+    return 0;
+  const unsigned char *p = &vInput[pos - iBase];
+  uint32_t h = (static_cast<uint32_t>(p[0]) | p[1] << 8 | p[2] << 16) * 2654435761u >> (32 - GZIP_HASH_BITS);
+  size_t best = 0;
+  size_t candidate = vHead[h];
+  for (int chain = GZIP_MAX_CHAIN; candidate && chain > 0; chain--) {
+    size_t from = candidate - 1;
+    if (from >= pos || pos - from > GZIP_WINDOW)
+      break;  // gone past the window, into slots since reused
+    const unsigned char *q = &vInput[from - iBase];
+    if (q[best] == p[best]) {
+      size_t len = 0;
+      while (len < most && q[len] == p[len])
+        len++;
+      if (len > best) {
+        best = len;
+        dist = pos - from;
+        if (len == most)
+          break;
+      }
+    }
+    candidate = vPrev[from % GZIP_WINDOW];
+  }
+  return best >= GZIP_MIN_MATCH ? best : 0;
+}
+
+void GzipWriter::Literal(size_t pos) {
+  uint8_t byte = vInput[pos - iBase];
+  vLitFreq[byte]++;
+  vSymbols.push_back(Symbol{byte, 0});
+  if (vSymbols.size() == GZIP_BLOCK_SYMBOLS)
+    WriteBlock(false);
+}
+
+void GzipWriter::Match(size_t len, size_t dist) {
+  int extra;
+  size_t base;
+  vLitFreq[LengthCode(len, extra, base)]++;
+  vDistFreq[DistCode(dist, extra, base)]++;
+  vSymbols.push_back(Symbol{static_cast<uint16_t>(len), static_cast<uint16_t>(dist)});
+  if (vSymbols.size() == GZIP_BLOCK_SYMBOLS)
+    WriteBlock(false);
+}
+
+// turns the text up to stop into symbols - a match at a byte is put off
+// if the byte after starts a longer one
+void GzipWriter::Deflate(size_t stop) {
+  size_t end = iBase + vInput.size();
+  while (iPos < stop) {
+    size_t dist = 0;
+    size_t len = Longest(iPos, end, dist);
+    Insert(iPos, end);
+    if (len && len < GZIP_LAZY_MATCH && iPos + 1 < stop) {
+      size_t nextDist = 0;
+      size_t next = Longest(iPos + 1, end, nextDist);
+      if (next > len) {
+        Literal(iPos++);
+        len = next;
+        dist = nextDist;
+        Insert(iPos, end);
+      }
+    }
+    if (!len) {
+      Literal(iPos++);
+      continue;
+    }
+    Match(len, dist);
+    for (size_t i = 1; i < len; i++)
+      Insert(iPos + i, end);
+    iPos += len;
+  }
+  // only the window is needed again - dropped a window's worth at a time
+  // so the text isn't moved along for every chunk
+  if (iPos - iBase > 2 * GZIP_WINDOW) {
+    size_t drop = iPos - GZIP_WINDOW - iBase;
+    vInput.erase(vInput.begin(), vInput.begin() + drop);
+    iBase += drop;
+  }
+}
+
+void GzipWriter::WriteSymbols(const uint8_t *litLens, const uint16_t *litCodes, const uint8_t *distLens,
+                              const uint16_t *distCodes) {
+  for (const Symbol &sym : vSymbols) {
+    if (!sym.dist) {
+      PutBits(litCodes[sym.litLen], litLens[sym.litLen]);
+      continue;
+    }
+    int extra;
+    size_t base;
+    int code = LengthCode(sym.litLen, extra, base);
+    PutBits(litCodes[code], litLens[code]);
+    PutBits(static_cast<uint32_t>(sym.litLen - base), extra);
+    code = DistCode(sym.dist, extra, base);
+    PutBits(distCodes[code], distLens[code]);
+    PutBits(static_cast<uint32_t>(sym.dist - base), extra);
+  }
+  PutBits(litCodes[GZIP_END_BLOCK], litLens[GZIP_END_BLOCK]);
+}
+
+// the symbols so far as one block with whichever codes make it shorter
+void GzipWriter::WriteBlock(bool last) {
+  vLitFreq[GZIP_END_BLOCK] = 1;
+  uint8_t litLens[286], distLens[30];
+  CodeLengths(vLitFreq, 286, 15, litLens);
+  CodeLengths(vDistFreq, 30, 15, distLens);
+  int nLit = 286, nDist = 30;
+  while (nLit > 257 && !litLens[nLit - 1])
+    nLit--;
+  while (nDist > 1 && !distLens[nDist - 1])
+    nDist--;
+
+  uint8_t lengths[286 + 30];
+  memcpy(lengths, litLens, nLit);
+  memcpy(lengths + nLit, distLens, nDist);
+  std::vector<LengthRun> runs;
+  RunLengths(lengths, nLit + nDist, runs);
+  uint32_t runFreq[19] = {0};
+  for (const LengthRun &run : runs)
+    runFreq[run.code]++;
+  // inflate won't take a code length code of one symbol
+  if (std::count_if(runFreq, runFreq + 19, [](uint32_t freq) { return freq != 0; }) < 2)
+    runFreq[runFreq[0] ? 1 : 0]++;
+  uint8_t runLens[19];
+  uint16_t runCodes[19];
+  CodeLengths(runFreq, 19, 7, runLens);
+  Codes(runLens, 19, runCodes);
+  int nRun = 19;
+  while (nRun > 4 && !runLens[kLengthOrder[nRun - 1]])
+    nRun--;
+
+  // the fixed codes - RFC 1951 3.2.6
+  uint8_t fixedLit[288], fixedDist[30];
+  for (int i = 0; i < 288; i++)
+    fixedLit[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+  memset(fixedDist, 5, sizeof(fixedDist));
+
+  uint64_t dynamicBits = 14 + 3 * nRun, fixedBits = 0;
+  for (const LengthRun &run : runs)
+    dynamicBits += runLens[run.code] + kLengthExtra[run.code];
+  for (int i = 0; i < 286; i++) {
+    int extra = i >= 265 && i < 285 ? (i - 261) / 4 : 0;
+    dynamicBits += static_cast<uint64_t>(vLitFreq[i]) * (litLens[i] + extra);
+    fixedBits += static_cast<uint64_t>(vLitFreq[i]) * (fixedLit[i] + extra);
+  }
+  for (int i = 0; i < 30; i++) {
+    int extra = i < 4 ? 0 : i / 2 - 1;
+    dynamicBits += static_cast<uint64_t>(vDistFreq[i]) * (distLens[i] + extra);
+    fixedBits += static_cast<uint64_t>(vDistFreq[i]) * (fixedDist[i] + extra);
+  }
+
+  PutBits(last ? 1 : 0, 1);
+  uint16_t litCodes[288], distCodes[30];
+  if (fixedBits <= dynamicBits) {
+    PutBits(1, 2);
+    Codes(fixedLit, 288, litCodes);
+    Codes(fixedDist, 30, distCodes);
+    WriteSymbols(fixedLit, litCodes, fixedDist, distCodes);
+  } else {
+    PutBits(2, 2);
+    PutBits(nLit - 257, 5);
+    PutBits(nDist - 1, 5);
+    PutBits(nRun - 4, 4);
+    for (int i = 0; i < nRun; i++)
+      PutBits(runLens[kLengthOrder[i]], 3);
+    for (const LengthRun &run : runs) {
+      PutBits(runCodes[run.code], runLens[run.code]);
+      PutBits(run.extra, kLengthExtra[run.code]);
+    }
+    Codes(litLens, 286, litCodes);
+    Codes(distLens, 30, distCodes);
+    WriteSymbols(litLens, litCodes, distLens, distCodes);
+  }
+  vSymbols.clear();
+  memset(vLitFreq, 0, sizeof(vLitFreq));
+  memset(vDistFreq, 0, sizeof(vDistFreq));
+}
@@ -0,0 +1,83 @@
+#ifndef _XMUTIL_XMILE_GZIPWRITER_H
+#define _XMUTIL_XMILE_GZIPWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/* GzipWriter compresses text as it is given it into a gzip stream (RFC
+   1952 around RFC 1951 deflate) - as an XMILEWriter sink the XMILE is
+   compressed a chunk at a time while it is written, so only the last 32K
+   of the text is held along with the compressed output
+
+   matches are found through hash chains with one step of lazy matching,
+   and each block is written with Huffman codes made for it or the fixed
+   ones, whichever is shorter.  Running out of memory for the output is
+   remembered rather than thrown and shows up as Failed() */
+
+#define GZIP_WINDOW 32768         // how far back a match can be
+#define GZIP_HASH_BITS 15         // of the first three bytes of a match
+#define GZIP_MAX_CHAIN 64         // candidates looked at for each match
+#define GZIP_LAZY_MATCH 32        // a match this long is taken without looking one byte on
+#define GZIP_BLOCK_SYMBOLS 16384  // literals and matches in a block
+
+class GzipWriter {
+public:
+  GzipWriter(void);
+  ~GzipWriter(void);
+
+  void Write(const char *data, size_t len);
+  // for XMILEWriter(compact, GzipWriter::Sink, &gzip)
+  static void Sink(const char *data, size_t len, void *context) {
+    static_cast<GzipWriter *>(context)->Write(data, len);
+  }
+  // compresses what is left and ends the stream - nothing more can be
+  // written after
+  void Finish(void);
+  bool Failed(void) const {
+    return bFailed;
+  }
+  // the gzip stream, which the caller must free() - NULL if writing failed
+  // or Finish hasn't been called
+  char *Release(size_t *length);
+
+private:
+  GzipWriter(const GzipWriter &) = delete;
+  GzipWriter &operator=(const GzipWriter &) = delete;
+  struct Symbol {
+    uint16_t litLen;  // the byte of a literal or the length of a match
+    uint16_t dist;    // 0 for a literal
+  };
+  void Deflate(size_t end);
+  size_t Longest(size_t pos, size_t end, size_t &dist) const;
+  void Insert(size_t pos, size_t end);
+  void Literal(size_t pos);
+  void Match(size_t len, size_t dist);
+  void WriteBlock(bool last);
+  void WriteSymbols(const uint8_t *litLens, const uint16_t *litCodes, const uint8_t *distLens,
+                    const uint16_t *distCodes);
+  void PutBits(uint32_t value, int count);
+  void PutByte(uint8_t byte);
+
+  std::vector<unsigned char> vInput;  // from iBase - the window then what is still to compress
+  size_t iBase;
+  size_t iPos;                   // where compressing has got to
+  std::vector<size_t> vHead;     // by hash, the last position + 1 with it
+  std::vector<size_t> vPrev;     // by position in the window, the one before + 1 with the same hash
+  std::vector<Symbol> vSymbols;  // for the block being made
+  uint32_t vLitFreq[286];
+  uint32_t vDistFreq[30];
+  uint32_t iCrc;
+  uint32_t iTotal;  // mod 2^32 as gzip has it
+  uint64_t iBits;   // not yet whole bytes
+  int iBitCount;
+
+  char *pOut;  // malloc'd so Release can give it away
+  size_t iOutLength;
+  size_t iOutCapacity;
+  bool bFinished;
+  bool bFailed;
+};
+
+#endif
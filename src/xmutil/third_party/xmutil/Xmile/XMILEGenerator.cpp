@@ -1,107 +1,103 @@
 #include "XMILEGenerator.h"
 
+#include <string.h>
+
 #include <algorithm>
+#include <exception>
+#include <memory>
 
+#include "../Limits.h"
 #include "../Model.h"
+#include "../Progress.h"
 #include "../Symbol/ExpressionList.h"
 #include "../Vensim/VensimView.h"
+#include "../Stats.h"
+#include "../Workers.h"
 #include "../XMUtil.h"
+#include "XMILEWriter.h"
 
 XMILEGenerator::XMILEGenerator(Model *model) {
   _model = model;
 }
 
-std::string XMILEGenerator::Print(bool isCompact, std::vector<std::string> &errs) {
-  tinyxml2::XMLDocument doc;
-
-  tinyxml2::XMLElement *root = doc.NewElement("xmile");
-  root->SetName("xmile");
-  root->SetAttribute("xmlns", "http://docs.oasis-open.org/xmile/ns/XMILE/v1.0");
-  root->SetAttribute("xmlns:isee", "http://iseesystems.com/XMILE");
-  root->SetAttribute("version", "1.0");
-  doc.InsertFirstChild(root);
-
-  tinyxml2::XMLElement *prefs = doc.NewElement("isee:prefs");
-  root->InsertEndChild(prefs);
-  prefs->SetAttribute("show_module_prefix", "true");
-  prefs->SetAttribute("layer", "model");
-
-  tinyxml2::XMLElement *header = doc.NewElement("header");
-  this->generateHeader(header, errs);
-  root->InsertEndChild(header);
+void XMILEGenerator::Print(XMILEWriter *writer, std::vector<std::string> &errs) {
+  // a few hundred bytes for each variable and diagram element covers most models
+  size_t estimate = 4096 + _model->GetVariables().size() * 256;
+  for (View *view : _model->Views())
+    estimate += static_cast<VensimView *>(view)->Elements().size() * 128;
+  writer->SizeHint(estimate);
+
+  writer->OpenElement("xmile");
+  writer->Attribute("xmlns", "http://docs.oasis-open.org/xmile/ns/XMILE/v1.0");
+  writer->Attribute("xmlns:isee", "http://iseesystems.com/XMILE");
+  writer->Attribute("version", "1.0");
+
+  if (!writer->Minimal()) {
+    writer->OpenElement("isee:prefs");
+    writer->Attribute("show_module_prefix", "true");
+    writer->Attribute("layer", "model");
+    writer->CloseElement();
+  }
 
-  tinyxml2::XMLElement *specs = doc.NewElement("sim_specs");
-  this->generateSimSpecs(specs, errs);
-  root->InsertEndChild(specs);
+  writer->OpenElement("header");
+  this->generateHeader(writer, errs);
+  writer->CloseElement();
 
-  tinyxml2::XMLElement *model_units = doc.NewElement("model_units");
-  this->generateModelUnits(model_units, errs);
-  root->InsertEndChild(model_units);
+  writer->OpenElement("sim_specs");
+  this->generateSimSpecs(writer, errs);
+  writer->CloseElement();
 
-  tinyxml2::XMLElement *dimensions = doc.NewElement("dimensions");
-  this->generateDimensions(dimensions, errs);
-  root->InsertEndChild(dimensions);
+  this->generateModelUnits(writer, errs);
+  this->generateDimensions(writer, errs);
 
-  tinyxml2::XMLElement *model = doc.NewElement("model");
-  this->generateModel(model, errs, NULL);
-  root->InsertEndChild(model);
+  writer->OpenElement("model");
+  this->generateModel(writer, errs, NULL);
+  writer->CloseElement();
 
   // macros are presented as separate models
   for (MacroFunction *mf : _model->MacroFunctions()) {
-    tinyxml2::XMLElement *macro = doc.NewElement("macro");
-    macro->SetAttribute("name", mf->GetName().c_str());
+    writer->OpenElement("macro");
+    writer->Attribute("name", mf->GetName());
 
     // in vensim the equation is always just the name fo the macro
-    tinyxml2::XMLElement *xeqn = doc.NewElement("eqn");
-    macro->InsertEndChild(xeqn);
-    xeqn->SetText(mf->GetName().c_str());
+    writer->TextElement("eqn", mf->GetName());
     // the parms are all of the entries in the macro description
     ExpressionList *args = mf->Args();
     int n = args->Length();
     for (int i = 0; i < n; i++) {
-      tinyxml2::XMLElement *xparm = doc.NewElement("parm");
-      macro->InsertEndChild(xparm);
       Expression *pexp = args->GetExp(i);
       ContextInfo info;
       pexp->OutputComputable(&info);
-      xparm->SetText(info.str().c_str());
+      writer->TextElement("parm", info.str());
     }
 
-    this->generateModel(macro, errs, mf->NameSpace());
-    root->InsertEndChild(macro);
+    this->generateModel(writer, errs, mf->NameSpace());
+    writer->CloseElement();
   }
 
-  tinyxml2::XMLPrinter printer{nullptr, isCompact};
-  if (!doc.Accept(&printer)) {
-    if (doc.ErrorStr()) {
-      errs.push_back("TinyXML2 Error: " + std::string(doc.ErrorStr()));
-    }
-    return "";
-  }
-
-  std::string xmile = printer.CStr();
-
-  return xmile;
+  writer->CloseElement();
+  writer->Flush();
+  if (writer->Failed())
+    errs.push_back("XMILE Error: out of memory writing output");
 }
 
-void XMILEGenerator::generateHeader(tinyxml2::XMLElement *element, std::vector<std::string> &errs) {
-  tinyxml2::XMLDocument *doc = element->GetDocument();
-
-  tinyxml2::XMLElement *options = doc->NewElement("options");
-  options->SetAttribute("namespace", "std");
-  element->InsertEndChild(options);
+void XMILEGenerator::generateHeader(XMILEWriter *writer, std::vector<std::string> &errs) {
+  // std is the namespace when none is given
+  if (!writer->Minimal()) {
+    writer->OpenElement("options");
+    writer->Attribute("namespace", "std");
+    writer->CloseElement();
+  }
 
-  tinyxml2::XMLElement *vendor = doc->NewElement("vendor");
-  vendor->SetText("Ventana Systems, xmutil");
-  element->InsertEndChild(vendor);
+  writer->TextElement("vendor", "Ventana Systems, xmutil");
 
-  tinyxml2::XMLElement *product = doc->NewElement("product");
-  product->SetAttribute("lang", "en");
-  product->SetText("Vensim, xmutil");
-  element->InsertEndChild(product);
+  writer->OpenElement("product");
+  writer->Attribute("lang", "en");
+  writer->Text("Vensim, xmutil");
+  writer->CloseElement();
 }
 
-void XMILEGenerator::generateSimSpecs(tinyxml2::XMLElement *element, std::vector<std::string> &errs) {
+void XMILEGenerator::generateSimSpecs(XMILEWriter *writer, std::vector<std::string> &errs) {
   /*
   <sim_specs method = "Euler" time_units = "Months">
   <start>0< / start>
@@ -110,14 +106,39 @@ void XMILEGenerator::generateSimSpecs(tinyxml2::XMLElement *element, std::vector
   < / sim_specs>
   */
 
-  tinyxml2::XMLDocument *doc = element->GetDocument();
+  SimSpecs specs = this->simSpecs();
+  // Euler and a duration of 0 (as fast as it goes) are what is assumed
+  // without them
+  bool minimal = writer->Minimal();
+  if (!minimal || strcmp(specs.method, "Euler") != 0)
+    writer->Attribute("method", specs.method);
+  writer->Attribute("time_units", specs.timeUnits);
+
+  if (specs.speed > 0) {
+    double duration = (specs.stop - specs.start) / specs.saveper * specs.speed;
+    writer->AttributeFixed("isee:sim_duration", duration);
+  } else if (!minimal) {
+    writer->Attribute("isee:sim_duration", "0");
+  }
+
+  // attributes come before the children in the output
+  if (specs.saveper > specs.dt) {
+    writer->AttributeFixed("isee:save_interval", specs.saveper);
+  }
 
+  writer->TextElementFixed("start", specs.start);
+  writer->TextElementFixed("stop", specs.stop);
+  writer->TextElementFixed("dt", specs.dt);
+}
+
+XMILEGenerator::SimSpecs XMILEGenerator::simSpecs() {
+  SimSpecs specs;
   if (_model->IntegrationType() == Integration_Type_RK4)
-    element->SetAttribute("method", "RK4");
+    specs.method = "RK4";
   else if (_model->IntegrationType() == Integration_Type_RK2)
-    element->SetAttribute("method", "RK2");
+    specs.method = "RK2";
   else
-    element->SetAttribute("method", "Euler");
+    specs.method = "Euler";
 
   UnitExpression *uexpr = _model->GetUnits("TIME STEP");
   if (!uexpr)
@@ -125,56 +146,33 @@ void XMILEGenerator::generateSimSpecs(tinyxml2::XMLElement *element, std::vector
   if (!uexpr)
     uexpr = _model->GetUnits("INITIAL TIME");
   if (uexpr)
-    element->SetAttribute("time_units", uexpr->GetEquationString().c_str());
+    specs.timeUnits = uexpr->GetEquationString();
   else
-    element->SetAttribute("time_units", "Months");
+    specs.timeUnits = "Months";
 
-  double start = _model->GetConstanValue("INITIAL TIME", -1);  // default to 0 if INITIAL TIME is missing or an equation
-  double stop = _model->GetConstanValue("FINAL TIME", 100);
-  double dt = _model->GetConstanValue("TIME STEP", 1);
-  double saveper = _model->GetConstanValue("SAVEPER", dt);
-  double speed = _model->GetConstanValue("SIMULATION PAUSE", 0);
+  specs.start = _model->GetConstanValue("INITIAL TIME", -1);  // default to 0 if INITIAL TIME is missing or an equation
+  specs.stop = _model->GetConstanValue("FINAL TIME", 100);
+  specs.dt = _model->GetConstanValue("TIME STEP", 1);
+  specs.saveper = _model->GetConstanValue("SAVEPER", specs.dt);
+  specs.speed = _model->GetConstanValue("SIMULATION PAUSE", 0);
 
-  if (start == -1) {
-    if (stop > 200)  // this happens to work for national model - but hey
-      start = stop - 200;
+  if (specs.start == -1) {
+    if (specs.stop > 200)  // this happens to work for national model - but hey
+      specs.start = specs.stop - 200;
     else
-      start = 0;
-  }
-  if (stop <= start)
-    stop = start + 10 * dt;
-
-  if (speed > 0) {
-    double duration = (stop - start) / saveper * speed;
-    const auto dur = std::to_string(duration);
-    element->SetAttribute("isee:sim_duration", dur.c_str());
-  } else {
-    element->SetAttribute("isee:sim_duration", "0");
-  }
-
-  tinyxml2::XMLElement *startEle = doc->NewElement("start");
-  startEle->SetText(std::to_string(start).c_str());
-  element->InsertEndChild(startEle);
-
-  tinyxml2::XMLElement *stopEle = doc->NewElement("stop");
-  stopEle->SetText(std::to_string(stop).c_str());
-  element->InsertEndChild(stopEle);
-
-  tinyxml2::XMLElement *dtEle = doc->NewElement("dt");
-  dtEle->SetText(std::to_string(dt).c_str());
-  element->InsertEndChild(dtEle);
-
-  if (saveper > dt) {
-    element->SetAttribute("isee:save_interval", std::to_string(saveper).c_str());
+      specs.start = 0;
   }
+  if (specs.stop <= specs.start)
+    specs.stop = specs.start + 10 * specs.dt;
 
   _model->SetUnwanted("INITIAL TIME", "STARTTIME");
   _model->SetUnwanted("FINAL TIME", "STOPTIME");
   _model->SetUnwanted("TIME STEP", "DT");
   _model->SetUnwanted("SAVEPER", "DT");
+  return specs;
 }
 
-void XMILEGenerator::generateModelUnits(tinyxml2::XMLElement *element, std::vector<std::string> &errs) {
+void XMILEGenerator::generateModelUnits(XMILEWriter *writer, std::vector<std::string> &errs) {
   /*
           <model_units>
           <unit name="Dollar">
@@ -186,14 +184,29 @@ void XMILEGenerator::generateModelUnits(tinyxml2::XMLElement *element, std::vect
 
   */
 
-  tinyxml2::XMLDocument *doc = element->GetDocument();
+  std::vector<UnitEquiv> units = this->unitEquivs();
+  if (units.empty() && writer->Minimal())
+    return;  // left out when empty
+  writer->OpenElement("model_units");
+  for (UnitEquiv &unit : units) {
+    writer->OpenElement("unit");
+    writer->Attribute("name", unit.name);
+    if (!unit.eqn.empty())
+      writer->TextElement("eqn", unit.eqn);
+    for (std::string &alias : unit.aliases)
+      writer->TextElement("alias", alias);
+    writer->CloseElement();
+  }
+  writer->CloseElement();
+}
 
+std::vector<XMILEGenerator::UnitEquiv> XMILEGenerator::unitEquivs() {
+  std::vector<UnitEquiv> units;
   std::vector<std::string> &equivs = _model->UnitEquivs();
 
   for (std::string &equiv : equivs) {
-    std::string name;
-    std::string eqn;
-    std::vector<std::string> aliases;
+    units.emplace_back();
+    UnitEquiv &unit = units.back();
     const char *cur = equiv.c_str();
     while (*cur) {
       const char *tv = cur;
@@ -201,11 +214,11 @@ void XMILEGenerator::generateModelUnits(tinyxml2::XMLElement *element, std::vect
         if (*tv == ',' || !*tv) {
           std::string cur_e(cur, tv - cur);
           if (cur_e == "$")
-            eqn = cur_e;
-          else if (name.empty())
-            name = cur_e;
+            unit.eqn = cur_e;
+          else if (unit.name.empty())
+            unit.name = cur_e;
           else
-            aliases.push_back(cur_e);
+            unit.aliases.push_back(cur_e);
           if (*tv)
             tv++;
           break;
@@ -214,24 +227,30 @@ void XMILEGenerator::generateModelUnits(tinyxml2::XMLElement *element, std::vect
       }
       cur = tv;
     }
-    tinyxml2::XMLElement *xunit = doc->NewElement("unit");
-    xunit->SetAttribute("name", name.c_str());
-    if (!eqn.empty()) {
-      tinyxml2::XMLElement *xeqn = doc->NewElement("eqn");
-      xeqn->SetText(eqn.c_str());
-      xunit->InsertEndChild(xeqn);
-    }
-    for (std::string &alias : aliases) {
-      tinyxml2::XMLElement *xalias = doc->NewElement("alias");
-      xalias->SetText(alias.c_str());
-      xunit->InsertEndChild(xalias);
+  }
+  return units;
+}
+
+void XMILEGenerator::generateDimensions(XMILEWriter *writer, std::vector<std::string> &errs) {
+  std::vector<DimensionDef> defs = this->dimensionDefs();
+  if (defs.empty() && writer->Minimal())
+    return;
+  writer->OpenElement("dimensions");
+  for (DimensionDef &def : defs) {
+    writer->OpenElement("dim");
+    writer->Attribute("name", def.var->GetName());
+    for (Symbol *s : def.elms) {
+      writer->OpenElement("elem");
+      writer->Attribute("name", s->GetName());
+      writer->CloseElement();
     }
-    element->InsertEndChild(xunit);
+    writer->CloseElement();
   }
+  writer->CloseElement();
 }
 
-void XMILEGenerator::generateDimensions(tinyxml2::XMLElement *element, std::vector<std::string> &errs) {
-  tinyxml2::XMLDocument *doc = element->GetDocument();
+std::vector<XMILEGenerator::DimensionDef> XMILEGenerator::dimensionDefs() {
+  std::vector<DimensionDef> defs;
   std::vector<Variable *> vars = _model->GetVariables();  // all symbols that are variables
   for (Variable *var : vars) {
     if (var->VariableType() == XMILE_Type_ARRAY) {
@@ -246,113 +265,160 @@ void XMILEGenerator::generateDimensions(tinyxml2::XMLElement *element, std::vect
           for (int i = 0; i < n; i++) {
             const SymbolList::SymbolListEntry &elm = (*symlist)[i];
             if (elm.eType == SymbolList::EntryType_SYMBOL) {
-              Equation::GetSubscriptElements(expanded, elm.u.pSymbol);
+              const std::vector<Symbol *> &elms = _model->SubscriptElements(elm.u.pSymbol);
+              expanded.insert(expanded.end(), elms.begin(), elms.end());
             }
           }
           // we define subranges as if they were arrays themselves - because of the unique namespace in XMILE this
           // is proper - and it will make any model with partial definitions more or less okay -
           if (!expanded.empty() /* && expanded[0]->Owner() == var*/) {
-            tinyxml2::XMLElement *xsub = doc->NewElement("dim");
-            xsub->SetAttribute("name", var->GetName().c_str());
-            for (Symbol *s : expanded) {
-              tinyxml2::XMLElement *xelm = doc->NewElement("elem");
-              xelm->SetAttribute("name", s->GetName().c_str());
-              xsub->InsertEndChild(xelm);
-            }
-            element->InsertEndChild(xsub);
+            defs.push_back(DimensionDef());
+            defs.back().var = var;
+            defs.back().elms.swap(expanded);
           }
         }
       }
     }
   }
+  return defs;
 }
 
-// first pass if flat - we probably want to do this differently when we break up into modules
-void XMILEGenerator::generateModel(tinyxml2::XMLElement *element, std::vector<std::string> &errs, SymbolNameSpace *ns) {
-  tinyxml2::XMLDocument *doc = element->GetDocument();
-  tinyxml2::XMLElement *variables = doc->NewElement("variables");
-  element->InsertEndChild(variables);
-
-  std::vector<Variable *> vars = _model->GetVariables(ns);  // all symbols that are variables
-  for (Variable *var : vars) {
-    if (var->Unwanted())
-      continue;
-    XMILE_Type type = var->VariableType();
-    std::string tag;
-    switch (type) {
-    case XMILE_Type_AUX:
-      tag = "aux";
-      break;
-    case XMILE_Type_STOCK:
-      tag = "stock";
-      break;
-    case XMILE_Type_FLOW:
-      tag = "flow";
-      break;
-    case XMILE_Type_ARRAY:
-      continue;
-    case XMILE_Type_ARRAY_ELM:
-      continue;
-    default:
-      continue;
-      break;
-    }
-    tinyxml2::XMLElement *xvar = doc->NewElement(tag.c_str());
+// models with fewer wanted variables than this are written on the one
+// thread - more are split into runs of this many among as many threads as
+// _available_threads gives
+#define PARALLEL_VARIABLES 2048
 
-    variables->InsertEndChild(xvar);
-    xvar->SetAttribute("name", var->GetAlternateName().c_str());
+// first pass if flat - we probably want to do this differently when we break up into modules
+void XMILEGenerator::generateModel(XMILEWriter *writer, std::vector<std::string> &errs, SymbolNameSpace *ns) {
+  // each view gets a sector, and the sectors need a group at the end of the variables too
+  std::vector<std::string> sectors = this->sectorNames();
+  this->generateVariables(writer, ns, sectors);
 
-    std::vector<Equation *> eqns = var->GetAllEquations();
-    int eq_count = eqns.size();
+  // no views and no groups to stand in for them
+  if (writer->Minimal() && _model->Views().empty() && (ns || _model->Groups().empty()))
+    return;
+  writer->OpenElement("views");
+  {
+    XMUTIL_TIME(printViewsSeconds);
+    this->generateViews(writer, sectors, errs, ns == NULL);
+  }
+  writer->CloseElement();
+}
 
-    // dimensions
-    std::vector<Variable *> elmlist;
-    int dim_count = var->SubscriptCountVars(elmlist);
+void XMILEGenerator::generateVariables(XMILEWriter *writer, SymbolNameSpace *ns,
+                                       const std::vector<std::string> &sectors) {
+  XMUTIL_TIME(printVariablesSeconds);
+  writer->OpenElement("variables");
 
-    std::string comment = var->Comment();
-    if (!comment.empty()) {
-      tinyxml2::XMLElement *xcomment = doc->NewElement("doc");
-      xvar->InsertEndChild(xcomment);
-      xcomment->SetText(comment.c_str());
+  std::vector<Variable *> vars = _model->GetVariables(ns);  // all symbols that are variables
+  std::vector<Variable *> wanted;
+  for (Variable *var : vars) {
+    if (!var->Unwanted() && variableTag(var->VariableType()))
+      wanted.push_back(var);
+  }
+#ifndef XMUTIL_NO_THREADS
+  size_t runs = (wanted.size() + PARALLEL_VARIABLES - 1) / PARALLEL_VARIABLES;
+  uint32_t nThreads = static_cast<uint32_t>(std::min<size_t>(_available_threads(), runs));
+  if (runs > 1 && nThreads > 1) {
+    // each run goes into a fragment of its own and the fragments are put
+    // in in order, so the output is just what one thread would write.
+    // A quoted name is interned the first time it is asked for, by
+    // whichever thread gets to it first
+    std::vector<SymbolNameSpace *> spaces{_model->GetNameSpace()};
+    for (Variable *var : vars) {
+      if (std::find(spaces.begin(), spaces.end(), var->GetSymbolNameSpace()) == spaces.end())
+        spaces.push_back(var->GetSymbolNameSpace());
     }
-    if (type == XMILE_Type_STOCK) {
-      for (Variable *in : var->Inflows()) {
-        tinyxml2::XMLElement *inflow = doc->NewElement("inflow");
-        xvar->InsertEndChild(inflow);
-        inflow->SetText(SpaceToUnderBar(in->GetAlternateName()).c_str());
+    struct Concurrent {
+      const std::vector<SymbolNameSpace *> &spaces;
+      Concurrent(const std::vector<SymbolNameSpace *> &s) : spaces(s) {
+        for (SymbolNameSpace *sns : spaces)
+          sns->SetConcurrent(true);
+      }
+      ~Concurrent(void) {
+        for (SymbolNameSpace *sns : spaces)
+          sns->SetConcurrent(false);
       }
-      for (Variable *out : var->Outflows()) {
-        tinyxml2::XMLElement *outflow = doc->NewElement("outflow");
-        xvar->InsertEndChild(outflow);
-        outflow->SetText(SpaceToUnderBar(out->GetAlternateName()).c_str());
+    } concurrent{spaces};
+    std::vector<std::unique_ptr<XMILEWriter>> fragments(runs);
+    std::vector<std::exception_ptr> failures(runs);  // thrown as it would have been on the one thread
+    std::vector<std::string> rhs(nThreads);
+    std::vector<EquationLayout> layouts(nThreads);
+    RunWorkers(runs, nThreads, [&](size_t run, uint32_t worker) {
+      try {
+        fragments[run].reset(new XMILEWriter(writer->Compact(), writer->Depth()));
+        fragments[run]->SetMinimal(writer->Minimal());
+        size_t end = std::min(wanted.size(), (run + 1) * PARALLEL_VARIABLES);
+        for (size_t i = run * PARALLEL_VARIABLES; i < end && !ConversionLimits::Stop(); i++)
+          this->generateVariable(fragments[run].get(), wanted[i], layouts[worker], rhs[worker]);
+      } catch (...) {
+        failures[run] = std::current_exception();
       }
+      return true;
+    });
+    for (size_t run = 0; run < runs; run++) {
+      if (failures[run])
+        std::rethrow_exception(failures[run]);
+      writer->Append(*fragments[run]);
+    }
+  } else
+#endif
+  {
+    std::string rhs;  // reused for every equation
+    EquationLayout layout;
+    for (Variable *var : wanted) {
+      if (ConversionLimits::Stop())
+        break;
+      this->generateVariable(writer, var, layout, rhs);
     }
+  }
 
-    tinyxml2::XMLElement *xelement = xvar;  // usually these are the same - but for non a2a we have element entries
-    int eq_ind = 0;
-    size_t eq_pos = 0;
-    std::vector<Symbol *> subs;               // [ship,location]
-    std::vector<std::vector<Symbol *>> elms;  // [s1,l1]
-    std::vector<std::set<Symbol *>> entries;
-    std::vector<Symbol *> dims;
-    while (eq_ind < eq_count) {
-      Equation *eqn = eqns[eq_ind];
-      if (eq_count > 1) {
-        if (entries.empty())
-          entries.resize(dim_count);
-        // we will blow up everything to single elements
-        if (elms.empty()) {
-          eq_pos = 0;
-          elms.clear();
-          eqn->SubscriptExpand(elms, subs);
-          assert(!elms.empty());
-          for (std::vector<Symbol *> elm : elms) {
-            for (int i = 0; i < dim_count; i++) {
-              entries[i].insert(elm[i]);
-            }
-          }
-        }
-        dims = elms[eq_pos];
+  for (const std::string &name : sectors) {
+    writer->OpenElement("group");
+    writer->Attribute("name", name);
+    writer->CloseElement();
+  }
+  writer->CloseElement();  // variables
+}
+
+const char *XMILEGenerator::variableTag(XMILE_Type type) {
+  switch (type) {
+  case XMILE_Type_AUX:
+    return "aux";
+  case XMILE_Type_STOCK:
+    return "stock";
+  case XMILE_Type_FLOW:
+    return "flow";
+  default:
+    return NULL;  // arrays and their elements among them
+  }
+}
+
+// changes nothing in the model, so any number can be written at once
+void XMILEGenerator::generateVariable(XMILEWriter *writer, Variable *var, EquationLayout &layout, std::string &rhs) {
+  XMILE_Type type = var->VariableType();
+  writer->OpenElement(variableTag(type));
+  writer->Attribute("name", var->GetAlternateName());
+
+  std::string comment = var->Comment();
+  if (!comment.empty())
+    writer->TextElement("doc", comment);
+  if (type == XMILE_Type_STOCK) {
+    for (Variable *in : var->Inflows())
+      writer->TextElement("inflow", SpaceToUnderBar(in->GetAlternateName()));
+    for (Variable *out : var->Outflows())
+      writer->TextElement("outflow", SpaceToUnderBar(out->GetAlternateName()));
+  }
+
+  this->layoutEquations(var, layout, rhs);
+  const std::vector<Equation *> &eqns = *layout.eqns;
+  std::vector<Expansion> &expansions = layout.expansions;
+  if (layout.elements) {
+    for (size_t i = 0; i < eqns.size(); i++) {
+      Expansion &expansion = expansions[i];
+      for (const std::vector<Symbol *> &dims : expansion.elms) {
+        if (ConversionLimits::Stop())
+          break;  // everything after is left out - the conversion fails anyway
         std::string s;
         int dim_count = dims.size();
         for (int j = 0; j < dim_count; j++) {
@@ -360,204 +426,369 @@ void XMILEGenerator::generateModel(tinyxml2::XMLElement *element, std::vector<st
             s += ", ";
           s += dims[j]->GetName();
         }
-        xelement = doc->NewElement("element");
-        xelement->SetAttribute("subscript", s.c_str());
-        xvar->InsertEndChild(xelement);
-      }
-      tinyxml2::XMLElement *xeqn = doc->NewElement("eqn");
-      xelement->InsertEndChild(xeqn);
-      xeqn->SetText(eqn->RHSFormattedXMILE(subs, dims, false).c_str());
-
-      // it it is active init we need to store that separately
-      if (eqn->IsActiveInit()) {
-        tinyxml2::XMLElement *xieqn = doc->NewElement("init_eqn");
-        xelement->InsertEndChild(xieqn);
-        xieqn->SetText(eqn->RHSFormattedXMILE(subs, dims, true).c_str());
+        writer->OpenElement("element");
+        writer->Attribute("subscript", s);
+        this->generateEquation(writer, eqns[i], expansion.subs, dims, type, rhs);
+        writer->CloseElement();
       }
+    }
+  } else if (eqns.size() > 1) {
+    // every element has the same equation so the first stands in for all of them
+    this->generateEquation(writer, eqns[0], expansions[0].subs, expansions[0].elms[0], type, rhs);
+  } else if (!eqns.empty()) {
+    this->generateEquation(writer, eqns[0], std::vector<Symbol *>(), std::vector<Symbol *>(), type, rhs);
+  }
 
-      // if it has a lookup we need to store that separately
-      ExpressionTable *et = eqn->GetTable();
-      if (et) {
-        assert(type == XMILE_Type_AUX || type == XMILE_Type_FLOW);
-        std::vector<double> *xvals = et->GetXVals();
-        std::vector<double> *yvals = et->GetYVals();
-        tinyxml2::XMLElement *gf = doc->NewElement("gf");
-        if (et->Extrapolate())
-          gf->SetAttribute("type", "extrapolate");
-        xelement->InsertEndChild(gf);
-        tinyxml2::XMLElement *yscale = doc->NewElement("yscale");
-        gf->InsertEndChild(yscale);
-        tinyxml2::XMLElement *xpts = doc->NewElement("xpts");
-        gf->InsertEndChild(xpts);
-        tinyxml2::XMLElement *ypts = doc->NewElement("ypts");
-        gf->InsertEndChild(ypts);
-
-        std::string xstr;
-        for (size_t i = 0; i < xvals->size(); i++) {
-          if (i)
-            xstr += ",";
-          xstr += std::to_string((*xvals)[i]);
-        }
-        xpts->SetText(xstr.c_str());
-
-        std::string ystr;
-        double ymin = 0;
-        double ymax = 0;
-        for (size_t i = 0; i < yvals->size(); i++) {
-          if (i) {
-            ystr += ",";
-            if ((*yvals)[i] < ymin)
-              ymin = (*yvals)[i];
-            else if ((*yvals)[i] > ymax)
-              ymax = (*yvals)[i];
-          } else
-            ymin = ymax = (*yvals)[i];
-          ystr += std::to_string((*yvals)[i]);
-        }
-        ypts->SetText(ystr.c_str());
-
-        if (ymin == ymax)
-          ymax = ymin + 1;
-        yscale->SetAttribute("min", std::to_string(ymin).c_str());
-        yscale->SetAttribute("max", std::to_string(ymax).c_str());
-      }
-      if (eq_count > 1) {
-        eq_pos++;
-        if (eq_pos >= elms.size()) {
-          elms.clear();
-          eq_ind++;
-        }
-      } else
-        eq_ind++;
+  if (!layout.dimensions.empty()) {
+    writer->OpenElement("dimensions");
+    for (Symbol *dim : layout.dimensions) {
+      writer->OpenElement("dim");
+      writer->Attribute("name", dim->GetName());
+      writer->CloseElement();
     }
+    writer->CloseElement();
+  }
 
-    // use entries to try to figure out the appropriate dimensions
-    if (dim_count) {
-      // Vensim allowed partial definition sets - XMILE uses subranges as separate dimensions so we
-      // try to find the most compact set of dimensions possible that inlcude all the equations include
-      std::vector<Variable *> dimensions;
+  UnitExpression *un = var->Units();
+  if (un)
+    writer->TextElement("units", un->GetEquationString());
+  writer->CloseElement();
+}
 
-      tinyxml2::XMLElement *xdims = doc->NewElement("dimensions");
-      for (int i = 0; i < dim_count; i++) {
-        tinyxml2::XMLElement *xdim = doc->NewElement("dim");
+void XMILEGenerator::layoutEquations(Variable *var, EquationLayout &layout, std::string &rhs) {
+  layout.eqns = &var->GetAllEquations();
+  int eq_count = layout.eqns->size();
+
+  // dimensions
+  std::vector<Variable *> elmlist;
+  int dim_count = var->SubscriptCountVars(elmlist);
+
+  // for non a2a the equations go in element entries rather than directly in the variable - we work out
+  // every element combination up front so we can tell if they collapse back into a single a2a equation
+  layout.expansions.clear();
+  std::vector<Symbol *> owners;
+  std::vector<ElementSet> entries;
+  if (eq_count > 1) {
+    layout.expansions.resize(eq_count);
+    for (int i = 0; i < eq_count; i++) {
+      Expansion &expansion = layout.expansions[i];
+      (*layout.eqns)[i]->SubscriptExpand(expansion.elms, expansion.subs, _model);
+      assert(!expansion.elms.empty());
+      for (const std::vector<Symbol *> &elm : expansion.elms) {
         if (entries.empty()) {
-          // we might get a subrange in elmlist so need to get parent - but only if there is more than 1 equation
-          if (eq_count > 1 || elmlist[i]->GetAllEquations().empty())
-            xdim->SetAttribute("name", elmlist[i]->Owner()->GetName().c_str());
-          else
-            xdim->SetAttribute("name", elmlist[i]->GetName().c_str());
-        } else {
-          std::set<Symbol *> &entry = entries[i];
-          Symbol *parent = (*entry.begin())->Owner();
-          Symbol *best = parent;
-          if (parent->Subranges() != NULL &&
-              static_cast<size_t>(static_cast<Variable *>(parent)->Nelm()) > entry.size()) {
-            for (Symbol *subrange : *parent->Subranges()) {
-              const size_t subrange_size = static_cast<size_t>(static_cast<Variable *>(subrange)->Nelm());
-              if (subrange_size >= entry.size() &&
-                  subrange_size < static_cast<size_t>(static_cast<Variable *>(best)->Nelm())) {
-                // does it have them all
-                bool complete = true;
-                std::vector<Symbol *> telms;
-                Equation::GetSubscriptElements(telms, subrange);
-                for (Symbol *elm : entries[i]) {
-                  if (std::find(telms.begin(), telms.end(), elm) == telms.end()) {
-                    complete = false;
-                    break;
-                  }
-                }
-                if (complete)
-                  best = subrange;
-              }
-            }
+          for (int j = 0; j < dim_count; j++) {
+            owners.push_back(elm[j]->Owner());
+            entries.emplace_back(_model->ElementCount(owners[j]));
           }
-          xdim->SetAttribute("name", best->GetName().c_str());
         }
-        xdims->InsertEndChild(xdim);
+        for (int j = 0; j < dim_count; j++)
+          entries[j].Add(_model->ElementIndex(elm[j]));
+      }
+    }
+  }
+  layout.dimensions = this->arrayDimensions(elmlist, owners, entries, eq_count);
+  layout.elements = eq_count > 1 && !this->isApplyToAll(*layout.eqns, layout.expansions, layout.dimensions, rhs);
+}
+
+// the eqn, init_eqn and gf for one equation, at the element given by dims
+void XMILEGenerator::generateEquation(XMILEWriter *writer, Equation *eqn, const std::vector<Symbol *> &subs,
+                                      const std::vector<Symbol *> &dims, XMILE_Type type, std::string &rhs) {
+  eqn->RHSFormattedXMILE(subs, dims, false, rhs, _model);
+  writer->TextElement("eqn", rhs);
+
+  // it it is active init we need to store that separately
+  if (eqn->IsActiveInit()) {
+    eqn->RHSFormattedXMILE(subs, dims, true, rhs, _model);
+    writer->TextElement("init_eqn", rhs);
+  }
+
+  // if it has a lookup we need to store that separately
+  ExpressionTable *et = eqn->GetTable();
+  if (et) {
+    assert(type == XMILE_Type_AUX || type == XMILE_Type_FLOW);
+    std::vector<double> *xvals = et->GetXVals();
+    std::vector<double> *yvals = et->GetYVals();
+
+    // one pass over the points - the range and both lists together
+    size_t count = std::min(xvals->size(), yvals->size());
+    std::string xstr;
+    std::string ystr;
+    xstr.reserve(count * 12);
+    ystr.reserve(count * 12);
+    double ymin = count ? (*yvals)[0] : 0;
+    double ymax = ymin;
+    for (size_t i = 0; i < count; i++) {
+      double y = (*yvals)[i];
+      if (i) {
+        xstr.push_back(',');
+        ystr.push_back(',');
+        if (y < ymin)
+          ymin = y;
+        else if (y > ymax)
+          ymax = y;
+      }
+      if (writer->Minimal()) {
+        AppendDouble(xstr, (*xvals)[i]);
+        AppendDouble(ystr, y);
+      } else {
+        AppendFixed(xstr, (*xvals)[i]);
+        AppendFixed(ystr, y);
       }
-      xvar->InsertEndChild(xdims);
     }
+    if (ymin == ymax)
+      ymax = ymin + 1;
+
+    // yscale comes first so the range is worked out before anything is written
+    writer->OpenElement("gf");
+    if (et->Extrapolate())
+      writer->Attribute("type", "extrapolate");
+    writer->OpenElement("yscale");
+    writer->AttributeFixed("min", ymin);
+    writer->AttributeFixed("max", ymax);
+    writer->CloseElement();
+    writer->TextElement("xpts", xstr);
+    writer->TextElement("ypts", ystr);
+    writer->CloseElement();
+  }
+}
 
-    UnitExpression *un = var->Units();
-    if (un) {
-      tinyxml2::XMLElement *units = doc->NewElement("units");
-      xvar->InsertEndChild(units);
-      units->SetText(un->GetEquationString().c_str());
+// use entries to try to figure out the appropriate dimensions
+std::vector<Symbol *> XMILEGenerator::arrayDimensions(std::vector<Variable *> &elmlist, std::vector<Symbol *> &owners,
+                                                      std::vector<ElementSet> &entries, int eq_count) {
+  // Vensim allowed partial definition sets - XMILE uses subranges as separate dimensions so we
+  // try to find the most compact set of dimensions possible that inlcude all the equations include
+  std::vector<Symbol *> dimensions;
+  for (size_t i = 0; i < elmlist.size(); i++) {
+    if (entries.empty()) {
+      // we might get a subrange in elmlist so need to get parent - but only if there is more than 1 equation
+      if (eq_count > 1 || elmlist[i]->GetAllEquations().empty())
+        dimensions.push_back(elmlist[i]->Owner());
+      else
+        dimensions.push_back(elmlist[i]);
+    } else {
+      const ElementSet &entry = entries[i];
+      const size_t entry_size = entry.Count();
+      Symbol *parent = owners[i];
+      Symbol *best = parent;
+      if (parent->Subranges() != NULL && static_cast<size_t>(static_cast<Variable *>(parent)->Nelm()) > entry_size) {
+        for (Symbol *subrange : *parent->Subranges()) {
+          const size_t subrange_size = static_cast<size_t>(static_cast<Variable *>(subrange)->Nelm());
+          if (subrange_size >= entry_size &&
+              subrange_size < static_cast<size_t>(static_cast<Variable *>(best)->Nelm()) &&
+              _model->SubscriptSet(subrange).Contains(entry))  // does it have them all
+            best = subrange;
+        }
+      }
+      dimensions.push_back(best);
     }
   }
-  tinyxml2::XMLElement *views = doc->NewElement("views");
-  this->generateViews(views, variables, errs, ns == NULL);
-  element->InsertEndChild(views);
+  return dimensions;
 }
 
-void XMILEGenerator::generateViews(tinyxml2::XMLElement *element, tinyxml2::XMLElement *xvars,
-                                   std::vector<std::string> &errs, bool mainmodel) {
-  tinyxml2::XMLDocument *doc = element->GetDocument();
+// equations given for separate parts of an array are often all the same - if every
+// equation comes out the same no matter which element it is for, and together they define
+// every element of dimensions exactly once, we can write a single a2a equation instead
+bool XMILEGenerator::isApplyToAll(const std::vector<Equation *> &eqns, std::vector<Expansion> &expansions,
+                                  std::vector<Symbol *> &dimensions, std::string &rhs) {
+  if (dimensions.empty())
+    return false;
+  // each element combination gets a bit across dimensions, the last varying
+  // fastest - places[j] maps the ElementIndex of an element of dimension j
+  // to where it is in that dimension
+  std::vector<std::vector<size_t>> places(dimensions.size());
+  std::vector<size_t> sizes(dimensions.size());
+  size_t nelm = 1;
+  for (size_t j = 0; j < dimensions.size(); j++) {
+    const std::vector<Symbol *> &elms = _model->SubscriptElements(dimensions[j]);
+    places[j].assign(_model->ElementCount(dimensions[j]->Owner()), SIZE_MAX);
+    for (size_t k = 0; k < elms.size(); k++) {
+      size_t index = _model->ElementIndex(elms[k]);
+      if (index < places[j].size())
+        places[j][index] = k;
+    }
+    sizes[j] = elms.size();
+    nelm *= sizes[j];
+  }
+  ElementSet defined{nelm};
+  for (const Expansion &expansion : expansions) {
+    for (const std::vector<Symbol *> &elm : expansion.elms) {
+      size_t place = 0;
+      for (size_t j = 0; j < dimensions.size(); j++) {
+        size_t index = _model->ElementIndex(elm[j]);
+        if (index >= places[j].size() || places[j][index] == SIZE_MAX)
+          return false;  // outside the dimensions
+        place = place * sizes[j] + places[j][index];
+      }
+      if (defined.Has(place))
+        return false;  // defined twice
+      defined.Add(place);
+    }
+  }
+  if (defined.Count() != nelm)
+    return false;
+  std::string first;
+  std::string firstInit;
+  for (size_t i = 0; i < eqns.size(); i++) {
+    Equation *eqn = eqns[i];
+    const Expansion &expansion = expansions[i];
+    if (eqn->GetTable() || eqn->IsActiveInit() != eqns[0]->IsActiveInit())
+      return false;
+    if (eqn->RHSFormattedXMILE(expansion.subs, expansion.elms[0], false, rhs, _model))
+      return false;
+    if (!i)
+      first = rhs;
+    else if (rhs != first)
+      return false;
+    if (eqn->IsActiveInit()) {
+      if (eqn->RHSFormattedXMILE(expansion.subs, expansion.elms[0], true, rhs, _model))
+        return false;
+      if (!i)
+        firstInit = rhs;
+      else if (rhs != firstInit)
+        return false;
+    }
+  }
+  return true;
+}
+
+// with more than one view each is wrapped in a sector named after it
+std::vector<std::string> XMILEGenerator::sectorNames() {
+  std::vector<std::string> names;
+  std::vector<View *> &views = _model->Views();
+  if (views.size() > 1) {
+    for (View *gview : views) {
+      std::string name = static_cast<VensimView *>(gview)->Title();
+      while (_model->GetNameSpace()->Find(name)) {
+        name += "1";  // not very original
+      }
+      names.push_back(name);
+    }
+  }
+  return names;
+}
 
+void XMILEGenerator::generateViews(XMILEWriter *writer, const std::vector<std::string> &sectors,
+                                   std::vector<std::string> &errs, bool mainmodel) {
   std::vector<View *> &views = _model->Views();
   if (views.empty() && mainmodel) {
     std::vector<ModelGroup> &groups = _model->Groups();
     if (!groups.empty()) {
       for (ModelGroup &group : groups) {
-        tinyxml2::XMLElement *xgroup = doc->NewElement("group");
-        xgroup->SetAttribute("name", group.sName.c_str());
+        writer->OpenElement("group");
+        writer->Attribute("name", group.sName);
         if (group.sOwner != group.sName)
-          xgroup->SetAttribute("owner", group.sOwner.c_str());
-        element->InsertEndChild(xgroup);
-        for (Variable *var : group.vVariables) {
-          tinyxml2::XMLElement *xvar = doc->NewElement("var");
-          xvar->SetText(SpaceToUnderBar(var->GetAlternateName()).c_str());
-          xgroup->InsertEndChild(xvar);
-        }
+          writer->Attribute("owner", group.sOwner);
+        for (Variable *var : group.vVariables)
+          writer->TextElement("var", SpaceToUnderBar(var->GetAlternateName()));
+        writer->CloseElement();
       }
     }
     return;
   }
+  // all the views against a single xmile view - or break up into modules - need vector of models as input to do that
+  writer->OpenElement("view");
+  std::vector<SectorBox> boxes = this->placeViews();
+  for (size_t i = 0; i < views.size() && !ConversionLimits::Stop(); i++) {
+    // add a surrounding sector to contain this view - call it the view name
+    // 				<group locked="false" x="184" y="154" width="300" height="184" name="Sector 1"/>
+
+    if (!sectors.empty()) {
+      writer->OpenElement("group");
+      writer->Attribute("name", sectors[i]);
+      writer->Attribute("x", boxes[i].x);
+      writer->Attribute("y", boxes[i].y);
+      writer->Attribute("width", boxes[i].width);
+      writer->Attribute("height", boxes[i].height);
+      writer->CloseElement();
+    }
+
+    this->generateView(static_cast<VensimView *>(views[i]), writer, errs);
+    if (mainmodel)
+      ConversionProgress::View(i + 1, views.size());
+  }
+  writer->CloseElement();
+}
+
+std::vector<XMILEGenerator::SectorBox> XMILEGenerator::placeViews() {
+  std::vector<SectorBox> boxes;
+  std::vector<View *> &views = _model->Views();
   int x, y;
   // start at a reasonable distance from 0 - the x,y values are generally around hte center
   // of the var
   x = 100;
   y = 100;
-  // all the views against a single xmile view - or break up into modules - need vector of models as input to do that
-  tinyxml2::XMLElement *xview = doc->NewElement("view");
-  element->InsertEndChild(xview);
   int uid_off = 0;
-  for (View *gview : views) {
-    VensimView *view = static_cast<VensimView *>(gview);
+  for (size_t i = 0; i < views.size(); i++) {
+    VensimView *view = static_cast<VensimView *>(views[i]);
     // first update geometry - we put views one after another along the y axix - could lay out in pages or something
     uid_off = view->SetViewStart(x, y + 20, uid_off);
     int width = view->GetViewMaxX(100);
     int height = view->GetViewMaxY(y + 80) - y;
-    // add a surrounding sector to contain this view - call it the view name
-    // 				<group locked="false" x="184" y="154" width="300" height="184" name="Sector 1"/>
-
-    if (views.size() > 1) {
-      std::string name = view->Title();
-      while (_model->GetNameSpace()->Find(name)) {
-        name += "1";  // not very original
-      }
-      tinyxml2::XMLElement *xsectorvar = doc->NewElement("group");
-      xvars->InsertEndChild(xsectorvar);
-      xsectorvar->SetAttribute("name", name.c_str());
-      tinyxml2::XMLElement *xsector = doc->NewElement("group");
-      xview->InsertEndChild(xsector);
-      xsector->SetAttribute("name", name.c_str());
-      xsector->SetAttribute("x", std::to_string(x - 40).c_str());
-      xsector->SetAttribute("y", std::to_string(y).c_str());
-      xsector->SetAttribute("width", std::to_string(width + 60).c_str());
-      xsector->SetAttribute("height", std::to_string(height + 40).c_str());
-    }
+    SectorBox box = {x - 40, y, width + 60, height + 40};
+    boxes.push_back(box);
 
     y += height + 80;
+  }
+  return boxes;
+}
 
-    this->generateView(view, xview, errs);
+void XMILEGenerator::generateView(VensimView *view, XMILEWriter *writer, std::vector<std::string> &errs) {
+  std::vector<ViewItem> items;
+  this->viewItems(view, items);
+  for (const ViewItem &item : items) {
+    switch (item.kind) {
+    case ViewItem::ALIAS:
+      writer->OpenElement("alias");
+      writer->Attribute("x", item.x);
+      writer->Attribute("y", item.y);
+      writer->Attribute("uid", item.uid);
+      writer->TextElement("of", item.name);
+      writer->CloseElement();
+      break;
+    case ViewItem::AUX:
+    case ViewItem::STOCK:
+    case ViewItem::FLOW:
+      writer->OpenElement(item.kind == ViewItem::AUX ? "aux" : item.kind == ViewItem::STOCK ? "stock" : "flow");
+      writer->Attribute("name", item.name);
+      writer->Attribute("x", item.x);
+      writer->Attribute("y", item.y);
+      if (item.kind == ViewItem::FLOW) {
+        writer->OpenElement("pts");
+        for (int i = 0; i < 2; i++) {
+          writer->OpenElement("pt");
+          writer->Attribute("x", item.pts[i][0]);
+          writer->Attribute("y", item.pts[i][1]);
+          writer->CloseElement();
+        }
+        writer->CloseElement();
+      }
+      writer->CloseElement();
+      break;
+    case ViewItem::CONNECTOR:
+      writer->OpenElement("connector");
+      writer->Attribute("uid", item.uid);
+      writer->Attribute("angle", item.angle);
+      writer->OpenElement("from");
+      if (item.from.empty()) {
+        writer->OpenElement("alias");
+        writer->Attribute("uid", item.fromAlias);
+        writer->CloseElement();
+      } else {
+        writer->Text(item.from);
+      }
+      writer->CloseElement();
+      writer->TextElement("to", item.name);
+      writer->CloseElement();
+      break;
+    }
   }
 }
 
-void XMILEGenerator::generateView(VensimView *view, tinyxml2::XMLElement *element, std::vector<std::string> &errs) {
-  tinyxml2::XMLDocument *doc = element->GetDocument();
+void XMILEGenerator::viewItems(VensimView *view, std::vector<ViewItem> &items) {
   int uid = view->UIDOffset();
   int local_uid = 0;
+  int ox = view->OffsetX();
+  int oy = view->OffsetY();
   VensimViewElements &elements = view->Elements();
   for (VensimViewElement *ele : elements) {
     if (ele) {
@@ -569,110 +800,96 @@ void XMILEGenerator::generateView(VensimView *view, tinyxml2::XMLElement *elemen
           // do nothing
         } else if (vele->Ghost()) {
           assert(vele->GetVariable()->VariableType() != XMILE_Type_ARRAY);
-          tinyxml2::XMLElement *xghost = doc->NewElement("alias");
-          element->InsertEndChild(xghost);
-          xghost->SetAttribute("x", vele->X());
-          xghost->SetAttribute("y", vele->Y());
-          xghost->SetAttribute("uid", uid);
-          tinyxml2::XMLElement *xof = doc->NewElement("of");
-          xghost->InsertEndChild(xof);
-          xof->SetText(SpaceToUnderBar(vele->GetVariable()->GetAlternateName()).c_str());
+          items.push_back(ViewItem());
+          ViewItem &item = items.back();
+          item.kind = ViewItem::ALIAS;
+          item.uid = uid;
+          item.x = vele->X() + ox;
+          item.y = vele->Y() + oy;
+          item.name = SpaceToUnderBar(vele->GetVariable()->GetAlternateName());
         } else {
           XMILE_Type type = vele->GetVariable()->VariableType();
-          std::string tag;
+          ViewItem::Kind kind;
           switch (type) {
           case XMILE_Type_AUX:
-            tag = "aux";
+            kind = ViewItem::AUX;
             break;
           case XMILE_Type_STOCK:
-            tag = "stock";
+            kind = ViewItem::STOCK;
             break;
           case XMILE_Type_FLOW:
-            tag = "flow";
+            kind = ViewItem::FLOW;
             break;
           default:
             // fprintf(stderr, "unknown view element type %d\n", type);
-            break;
-          }
-          if (tag.empty())
             continue;
-          tinyxml2::XMLElement *xvar = doc->NewElement(tag.c_str());
-
-          element->InsertEndChild(xvar);
+          }
+          items.push_back(ViewItem());
+          ViewItem &item = items.back();
+          item.kind = kind;
+          item.uid = uid;
 
-          std::string name = vele->GetVariable()->GetAlternateName();
-          xvar->SetAttribute("name", SpaceToUnderBar(vele->GetVariable()->GetAlternateName()).c_str());
+          item.name = SpaceToUnderBar(vele->GetVariable()->GetAlternateName());
           if (type == XMILE_Type_FLOW && vele->Attached() && elements[local_uid - 1] &&
               elements[local_uid - 1]->Type() == VensimViewElement::ElementTypeVALVE) {
-            xvar->SetAttribute("x", elements[local_uid - 1]->X());
-            xvar->SetAttribute("y", elements[local_uid - 1]->Y());
+            item.x = elements[local_uid - 1]->X() + ox;
+            item.y = elements[local_uid - 1]->Y() + oy;
 
           } else {
-            xvar->SetAttribute("x", vele->X());
-            xvar->SetAttribute("y", vele->Y());
+            item.x = vele->X() + ox;
+            item.y = vele->Y() + oy;
           }
           if (type == XMILE_Type_FLOW) {
             // need points - these are the location of the from and to - no matter what they are
             // but we need to search through the list of eleemnts to find the from and to - flow
             // arrows are always out of the attached value which is just before us in the list
             // flow direction we need to take from the model proper - arbitrary if flow is not connected
-            size_t n = elements.size();
             int count = 0;
             int toind = -1;
             int xpt[2];
             int ypt[2];
-            for (size_t i = 0; i < n; i++) {
-              VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(elements[i]);
-              if (cele && cele->Type() == VensimViewElement::ElementTypeCONNECTOR) {
-                if (cele->From() == uid - 1) {
-                  // check to see what to is
-                  VensimVariableElement *stock = static_cast<VensimVariableElement *>(elements[cele->To()]);
-                  if (stock) {
-                    xpt[count] = stock->X();
-                    ypt[count] = stock->Y();
-                    if (stock->Type() == VensimViewElement::ElementTypeVARIABLE) {
-                      Variable *var = stock->GetVariable();
-                      if (toind == -1 && var && var->VariableType() == XMILE_Type_STOCK) {
-                        // are we an inflow or an outflow
-                        for (Variable *inflow : var->Inflows()) {
-                          if (inflow == vele->GetVariable()) {
-                            toind = count;
-                            break;
-                          }
-                        }
-                        if (toind == -1) {
-                          for (Variable *outflow : var->Outflows()) {
-                            if (outflow == vele->GetVariable()) {
-                              toind = count ? 0 : 1;
-                              break;
-                            }
-                          }
+            for (int cuid : view->ConnectorsFrom(uid - 1)) {
+              VensimConnectorElement *cele = static_cast<VensimConnectorElement *>(elements[cuid]);
+              // check to see what to is
+              VensimVariableElement *stock = static_cast<VensimVariableElement *>(elements[cele->To()]);
+              if (stock) {
+                xpt[count] = stock->X() + ox;
+                ypt[count] = stock->Y() + oy;
+                if (stock->Type() == VensimViewElement::ElementTypeVARIABLE) {
+                  Variable *var = stock->GetVariable();
+                  if (toind == -1 && var && var->VariableType() == XMILE_Type_STOCK) {
+                    // are we an inflow or an outflow
+                    for (Variable *inflow : var->Inflows()) {
+                      if (inflow == vele->GetVariable()) {
+                        toind = count;
+                        break;
+                      }
+                    }
+                    if (toind == -1) {
+                      for (Variable *outflow : var->Outflows()) {
+                        if (outflow == vele->GetVariable()) {
+                          toind = count ? 0 : 1;
+                          break;
                         }
                       }
                     }
-                    count++;
-                    if (count == 2)
-                      break;
                   }
                 }
+                count++;
+                if (count == 2)
+                  break;
               }
             }
             if (count < 2 || toind < 0) {
-              xpt[0] = vele->X() - 25;
-              xpt[1] = vele->X() + 25;
-              ypt[0] = ypt[1] = vele->Y();
+              xpt[0] = vele->X() + ox - 25;
+              xpt[1] = vele->X() + ox + 25;
+              ypt[0] = ypt[1] = vele->Y() + oy;
               toind = 1;
             }
-            tinyxml2::XMLElement *xpts = doc->NewElement("pts");
-            xvar->InsertEndChild(xpts);
-            tinyxml2::XMLElement *xxpt = doc->NewElement("pt");
-            xpts->InsertEndChild(xxpt);
-            xxpt->SetAttribute("x", xpt[1 - toind]);
-            xxpt->SetAttribute("y", ypt[1 - toind]);
-            xxpt = doc->NewElement("pt");
-            xpts->InsertEndChild(xxpt);
-            xxpt->SetAttribute("x", xpt[toind]);
-            xxpt->SetAttribute("y", ypt[toind]);
+            item.pts[0][0] = xpt[1 - toind];
+            item.pts[0][1] = ypt[1 - toind];
+            item.pts[1][0] = xpt[toind];
+            item.pts[1][1] = ypt[toind];
           }
         }
       } else if (ele->Type() == VensimViewElement::ElementTypeCONNECTOR) {
@@ -690,24 +907,18 @@ void XMILEGenerator::generateView(VensimView *view, tinyxml2::XMLElement *elemen
           if (from && to && from->Type() == VensimViewElement::ElementTypeVARIABLE && to &&
               to->Type() == VensimViewElement::ElementTypeVARIABLE && to->GetVariable() &&
               to->GetVariable()->VariableType() != XMILE_Type_STOCK) {
-            tinyxml2::XMLElement *xconnector = doc->NewElement("connector");
-            element->InsertEndChild(xconnector);
-            xconnector->SetAttribute("uid", uid);
+            items.push_back(ViewItem());
+            ViewItem &item = items.back();
+            item.kind = ViewItem::CONNECTOR;
+            item.uid = uid;
             // try to figure out the angle based on the 3 points -
-            xconnector->SetAttribute("angle",
-                                     AngleFromPoints(from->X(), from->Y(), cele->X(), cele->Y(), to->X(), to->Y()));
-            tinyxml2::XMLElement *xfrom = doc->NewElement("from");
-            xconnector->InsertEndChild(xfrom);
-            if (from->Ghost()) {
-              tinyxml2::XMLElement *xalias = doc->NewElement("alias");
-              xfrom->InsertEndChild(xalias);
-              xalias->SetAttribute("uid", view->UIDOffset() + cele->From());
-            } else {
-              xfrom->SetText(SpaceToUnderBar(from->GetVariable()->GetAlternateName()).c_str());
-            }
-            tinyxml2::XMLElement *xto = doc->NewElement("to");
-            xconnector->InsertEndChild(xto);
-            xto->SetText(SpaceToUnderBar(to->GetVariable()->GetAlternateName()).c_str());
+            item.angle = AngleFromPoints(from->X() + ox, from->Y() + oy, cele->X() + ox, cele->Y() + oy, to->X() + ox,
+                                         to->Y() + oy);  // where written, as the rounding follows
+            if (from->Ghost())
+              item.fromAlias = view->UIDOffset() + cele->From();
+            else
+              item.from = SpaceToUnderBar(from->GetVariable()->GetAlternateName());
+            item.name = SpaceToUnderBar(to->GetVariable()->GetAlternateName());
           }
         }
       }
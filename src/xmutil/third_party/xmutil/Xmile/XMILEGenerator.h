@@ -2,32 +2,103 @@
 #ifndef __XMILE_H
 #define __XMILE_H
 
-#include "../../third_party/tinyxml2/tinyxml2.h"
-
 #include <string>
 #include <vector>
 
+#include "../Symbol/ElementSet.h"
+#include "../Symbol/Variable.h"
+
 class Model;
 class VensimView;
 class SymbolNameSpace;
+class XMILEWriter;
 
 class XMILEGenerator {
 public:
   XMILEGenerator(Model *model);
 
-  std::string Print(bool isCompact, std::vector<std::string> &errs);
+  // streams the model to writer in document order
+  void Print(XMILEWriter *writer, std::vector<std::string> &errs);
 
 protected:
-  void generateHeader(tinyxml2::XMLElement *element, std::vector<std::string> &errs);
-  void generateSimSpecs(tinyxml2::XMLElement *element, std::vector<std::string> &errs);
-  void generateModelUnits(tinyxml2::XMLElement *element, std::vector<std::string> &errs);
-  void generateDimensions(tinyxml2::XMLElement *element, std::vector<std::string> &errs);
-  void generateModel(tinyxml2::XMLElement *element, std::vector<std::string> &errs, SymbolNameSpace *ns);
-  void generateViews(tinyxml2::XMLElement *views, tinyxml2::XMLElement *vars, std::vector<std::string> &errs,
+  void generateHeader(XMILEWriter *writer, std::vector<std::string> &errs);
+  void generateSimSpecs(XMILEWriter *writer, std::vector<std::string> &errs);
+  void generateModelUnits(XMILEWriter *writer, std::vector<std::string> &errs);
+  void generateDimensions(XMILEWriter *writer, std::vector<std::string> &errs);
+  void generateModel(XMILEWriter *writer, std::vector<std::string> &errs, SymbolNameSpace *ns);
+  void generateVariables(XMILEWriter *writer, SymbolNameSpace *ns, const std::vector<std::string> &sectors);
+  void generateViews(XMILEWriter *writer, const std::vector<std::string> &sectors, std::vector<std::string> &errs,
                      bool mainmodel);
-  void generateView(VensimView *view, tinyxml2::XMLElement *element, std::vector<std::string> &errs);
+  void generateView(VensimView *view, XMILEWriter *writer, std::vector<std::string> &errs);
+  std::vector<std::string> sectorNames();
+
+  // the element combinations one equation of an arrayed variable defines
+  struct Expansion {
+    std::vector<Symbol *> subs;               // [ship,location]
+    std::vector<std::vector<Symbol *>> elms;  // [s1,l1]
+  };
+  void generateEquation(XMILEWriter *writer, Equation *eqn, const std::vector<Symbol *> &subs,
+                        const std::vector<Symbol *> &dims, XMILE_Type type, std::string &rhs);
+  // entries[i] holds the elements used in place i, over owners[i]
+  std::vector<Symbol *> arrayDimensions(std::vector<Variable *> &elmlist, std::vector<Symbol *> &owners,
+                                        std::vector<ElementSet> &entries, int eq_count);
+  bool isApplyToAll(const std::vector<Equation *> &eqns, std::vector<Expansion> &expansions,
+                    std::vector<Symbol *> &dimensions, std::string &rhs);
+
+  // the layout decisions, kept apart from the writing so another output can make the same ones
+  struct SimSpecs {
+    const char *method;  // RK4, RK2 or Euler
+    std::string timeUnits;
+    double start;
+    double stop;
+    double dt;
+    double saveper;
+    double speed;
+  };
+  SimSpecs simSpecs();  // also marks the Vensim control variables unwanted
+  struct UnitEquiv {
+    std::string name;
+    std::string eqn;
+    std::vector<std::string> aliases;
+  };
+  std::vector<UnitEquiv> unitEquivs();
+  struct DimensionDef {
+    Variable *var;
+    std::vector<Symbol *> elms;
+  };
+  std::vector<DimensionDef> dimensionDefs();
+  // a variable's equations either go in one per element entry, or eqns[0] (for the element
+  // expansions[0].elms[0] when there are several) stands for the whole variable
+  struct EquationLayout {
+    const std::vector<Equation *> *eqns;  // the variable's own, not a copy
+    std::vector<Expansion> expansions;  // only filled in with more than one equation
+    std::vector<Symbol *> dimensions;   // empty unless arrayed
+    bool elements;
+  };
+  void layoutEquations(Variable *var, EquationLayout &layout, std::string &rhs);
+  static const char *variableTag(XMILE_Type type);  // NULL for a variable that isn't written out
+  void generateVariable(XMILEWriter *writer, Variable *var, EquationLayout &layout, std::string &rhs);
+  struct SectorBox {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+  std::vector<SectorBox> placeViews();  // puts the views one under the other
+  // one view element as it comes out - x,y is the valve for a flow, and pts its ends in flow order
+  struct ViewItem {
+    enum Kind { ALIAS, AUX, STOCK, FLOW, CONNECTOR } kind;
+    int uid;
+    std::string name;  // the alias's of and the connector's to
+    std::string from;  // connector only - empty when from an alias
+    int fromAlias;     // uid of the alias a connector is from
+    int x;
+    int y;
+    int pts[2][2];
+    double angle;
+  };
+  void viewItems(VensimView *view, std::vector<ViewItem> &items);
 
-private:
   Model *_model;
 };
 
@@ -0,0 +1,258 @@
+#include "XMILEWriter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../XMUtil.h"
+
+XMILEWriter::XMILEWriter(bool compact) : XMILEWriter(compact, NULL, NULL) {
+}
+
+XMILEWriter::XMILEWriter(bool compact, size_t depth) : XMILEWriter(compact, NULL, NULL) {
+  iBaseDepth = depth;
+  bFirstElement = false;
+}
+
+XMILEWriter::XMILEWriter(bool compact, Sink sink, void *context) {
+  pBuffer = NULL;
+  iLength = 0;
+  iCapacity = 0;
+  iFlushed = 0;
+  pSink = sink;
+  pSinkContext = context;
+  iBaseDepth = 0;
+  iTextDepth = -1;
+  bCompact = compact;
+  bMinimal = false;
+  bFirstElement = true;
+  bElementJustOpened = false;
+  bFailed = false;
+}
+
+XMILEWriter::~XMILEWriter(void) {
+  free(pBuffer);
+}
+
+void XMILEWriter::Reserve(size_t extra) {
+  if (iLength + extra < iCapacity)  // always leave room for the terminator
+    return;
+  size_t capacity = iCapacity ? iCapacity : 4096;
+  while (capacity <= iLength + extra)
+    capacity *= 2;
+  char *buffer = static_cast<char *>(realloc(pBuffer, capacity));
+  if (!buffer) {
+    bFailed = true;
+    return;
+  }
+  pBuffer = buffer;
+  iCapacity = capacity;
+}
+
+void XMILEWriter::SizeHint(size_t bytes) {
+  if (pSink && bytes > XMILE_WRITER_CHUNK)
+    bytes = XMILE_WRITER_CHUNK;  // a sink never holds more than a chunk
+  if (bytes > iLength)
+    Reserve(bytes - iLength);
+}
+
+void XMILEWriter::Write(const char *data, size_t len) {
+  if (bFailed)
+    return;
+  Reserve(len);
+  if (bFailed)
+    return;
+  memcpy(pBuffer + iLength, data, len);
+  iLength += len;
+  if (pSink && iLength >= XMILE_WRITER_CHUNK)
+    Flush();
+}
+
+void XMILEWriter::Write(const char *data) {
+  Write(data, strlen(data));
+}
+
+void XMILEWriter::Putc(char c) {
+  if (iLength + 1 < iCapacity && !bFailed)
+    pBuffer[iLength++] = c;
+  else
+    Write(&c, 1);
+}
+
+void XMILEWriter::Flush(void) {
+  if (!pSink)
+    return;  // everything stays in the buffer for Release
+  if (iLength && !bFailed)
+    pSink(pBuffer, iLength, pSinkContext);
+  iFlushed += iLength;
+  iLength = 0;
+}
+
+void XMILEWriter::Append(const XMILEWriter &fragment) {
+  if (fragment.bFailed)
+    bFailed = true;
+  SealElement();
+  if (fragment.iLength)
+    Write(fragment.pBuffer, fragment.iLength);
+  bFirstElement = false;
+}
+
+char *XMILEWriter::Release(size_t *length) {
+  if (pSink || bFailed || !pBuffer) {
+    if (length)
+      *length = 0;
+    return NULL;
+  }
+  pBuffer[iLength] = '\0';  // Reserve keeps a byte spare
+  char *rval = pBuffer;
+  if (length)
+    *length = iLength;
+  pBuffer = NULL;
+  iLength = iCapacity = 0;
+  return rval;
+}
+
+void XMILEWriter::Indent(void) {
+  for (size_t i = Depth(); i > 0; i--)
+    Write("    ", 4);
+}
+
+void XMILEWriter::SealElement(void) {
+  if (bElementJustOpened) {
+    bElementJustOpened = false;
+    Putc('>');
+  }
+}
+
+// the characters Escape stops at - ESCAPE_TEXT ones in text, ESCAPE_TEXT
+// and ESCAPE_ATTRIBUTE ones in attribute values.  The terminator stops both
+#define ESCAPE_TEXT 1
+#define ESCAPE_ATTRIBUTE 2
+
+static const unsigned char *EscapeTable(void) {
+  static unsigned char table[256];
+  if (!table['&']) {
+    table['\0'] = table['&'] = table['<'] = table['>'] = ESCAPE_TEXT;
+    table['"'] = table['\''] = ESCAPE_ATTRIBUTE;
+  }
+  return table;
+}
+
+// the same entities as tinyxml2 - text only needs & < and > escaped,
+// attribute values also get the quotes.  Runs needing nothing go across
+// in one copy
+void XMILEWriter::Escape(const char *p, bool text) {
+  static const unsigned char *table = EscapeTable();
+  const unsigned char stops = text ? ESCAPE_TEXT : ESCAPE_TEXT | ESCAPE_ATTRIBUTE;
+  for (;;) {
+    const char *q = p;
+    while (!(table[static_cast<unsigned char>(*q)] & stops))
+      q++;
+    Write(p, q - p);
+    const char *entity;
+    switch (*q) {
+    case '&':
+      entity = "&amp;";
+      break;
+    case '<':
+      entity = "&lt;";
+      break;
+    case '>':
+      entity = "&gt;";
+      break;
+    case '"':
+      entity = "&quot;";
+      break;
+    case '\'':
+      entity = "&apos;";
+      break;
+    default:
+      return;  // the terminator
+    }
+    Write(entity);
+    p = q + 1;
+  }
+}
+
+void XMILEWriter::OpenElement(const char *name) {
+  SealElement();
+  if (iTextDepth < 0 && !bFirstElement && !bCompact) {
+    Putc('\n');
+    Indent();
+  }
+  vOpen.push_back(name);
+  Putc('<');
+  Write(name);
+  bElementJustOpened = true;
+  bFirstElement = false;
+}
+
+void XMILEWriter::Attribute(const char *name, const char *value) {
+  Putc(' ');
+  Write(name);
+  Write("=\"", 2);
+  Escape(value, false);
+  Putc('"');
+}
+
+void XMILEWriter::Attribute(const char *name, int value) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%d", value);
+  Attribute(name, buf);
+}
+
+void XMILEWriter::Attribute(const char *name, double value) {
+  if (bMinimal) {
+    sNumber.clear();
+    AppendDouble(sNumber, value);
+    Attribute(name, sNumber.c_str());
+    return;
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.17g", value);
+  Attribute(name, buf);
+}
+
+const char *XMILEWriter::Fixed(double value) {
+  sNumber.clear();
+  if (bMinimal)
+    AppendDouble(sNumber, value);
+  else
+    AppendFixed(sNumber, value);
+  return sNumber.c_str();
+}
+
+void XMILEWriter::AttributeFixed(const char *name, double value) {
+  Attribute(name, Fixed(value));
+}
+
+void XMILEWriter::TextElementFixed(const char *name, double value) {
+  TextElement(name, Fixed(value));
+}
+
+void XMILEWriter::Text(const char *text) {
+  iTextDepth = static_cast<int>(vOpen.size()) - 1;
+  SealElement();
+  Escape(text, true);
+}
+
+void XMILEWriter::CloseElement(void) {
+  const char *name = vOpen.back();
+  vOpen.pop_back();
+  if (bElementJustOpened) {
+    Write("/>", 2);
+  } else {
+    if (iTextDepth < 0 && !bCompact) {
+      Putc('\n');
+      Indent();
+    }
+    Write("</", 2);
+    Write(name);
+    Putc('>');
+  }
+  if (iTextDepth == static_cast<int>(vOpen.size()))
+    iTextDepth = -1;
+  if (!Depth() && !bCompact)
+    Putc('\n');
+  bElementJustOpened = false;
+}
@@ -0,0 +1,127 @@
+#ifndef _XMUTIL_XMILE_WRITER_H
+#define _XMUTIL_XMILE_WRITER_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+/* XMILEWriter streams XML straight to its output in document order - there
+   is no DOM, so elements have to be opened, given their attributes, filled
+   and closed in the order they appear in the file
+
+   the formatting (indentation, escaping, number formatting, compact mode)
+   matches tinyxml2::XMLPrinter so the output is the same as printing the
+   equivalent XMLDocument
+
+   output goes to a growable malloc'd buffer that Release() hands off to the
+   caller, or to a sink callback that gets the text in chunks as it is
+   written.  Running out of memory is remembered rather than thrown and
+   shows up as Failed() */
+
+#define XMILE_WRITER_CHUNK 65536  // bytes buffered before calling the sink
+
+class XMILEWriter {
+public:
+  typedef void (*Sink)(const char *data, size_t len, void *context);
+
+  explicit XMILEWriter(bool compact);
+  XMILEWriter(bool compact, Sink sink, void *context);
+  // a writer for a piece of the output made on the side (on another thread
+  // say) and put in with Append - it is laid out as if written depth
+  // elements in
+  XMILEWriter(bool compact, size_t depth);
+  ~XMILEWriter(void);
+
+  // name must stay valid until the matching CloseElement
+  void OpenElement(const char *name);
+  void Attribute(const char *name, const char *value);
+  void Attribute(const char *name, const std::string &value) {
+    Attribute(name, value.c_str());
+  }
+  void Attribute(const char *name, int value);
+  void Attribute(const char *name, double value);
+  // value with 6 digits after the decimal point, as std::to_string has it -
+  // unless Minimal
+  void AttributeFixed(const char *name, double value);
+  void Text(const char *text);
+  void Text(const std::string &text) {
+    Text(text.c_str());
+  }
+  void CloseElement(void);
+  // an element holding only text - <name>text</name>
+  void TextElement(const char *name, const char *text) {
+    OpenElement(name);
+    Text(text);
+    CloseElement();
+  }
+  void TextElement(const char *name, const std::string &text) {
+    TextElement(name, text.c_str());
+  }
+  void TextElementFixed(const char *name, double value);
+  bool Compact(void) const {
+    return bCompact;
+  }
+  // numbers in the fewest digits that read back the same, the Fixed ones
+  // included, and the generator leaving out what readers assume anyway
+  void SetMinimal(bool minimal) {
+    bMinimal = minimal;
+  }
+  bool Minimal(void) const {
+    return bMinimal;
+  }
+  // the elements open just now
+  size_t Depth(void) const {
+    return iBaseDepth + vOpen.size();
+  }
+  // what fragment wrote (with every element it opened closed again) as if
+  // it had been written here
+  void Append(const XMILEWriter &fragment);
+
+  // roughly how much output is coming, so the buffer can be sized once
+  // rather than doubled up to it
+  void SizeHint(size_t bytes);
+
+  // passes anything still buffered to the sink
+  void Flush(void);
+  // bytes written so far, whether still buffered or passed to the sink
+  size_t Written(void) const {
+    return iFlushed + iLength;
+  }
+  bool Failed(void) const {
+    return bFailed;
+  }
+  // the nul terminated output, which the caller must free() - NULL if
+  // writing failed or a sink is in use
+  char *Release(size_t *length);
+
+private:
+  XMILEWriter(const XMILEWriter &) = delete;
+  XMILEWriter &operator=(const XMILEWriter &) = delete;
+  void Write(const char *data, size_t len);
+  void Write(const char *data);
+  void Putc(char c);
+  void Reserve(size_t extra);
+  const char *Fixed(double value);
+  void Escape(const char *p, bool text);
+  void Indent(void);
+  void SealElement(void);
+
+  char *pBuffer;  // malloc'd so Release can give it away
+  size_t iLength;
+  size_t iCapacity;
+  size_t iFlushed;  // passed to the sink
+  Sink pSink;
+  void *pSinkContext;
+  std::vector<const char *> vOpen;  // names of the open elements
+  std::string sNumber;              // reused for formatting numbers
+  size_t iBaseDepth;                // open outside a fragment
+  int iTextDepth;                   // depth of the element holding text, or -1
+  bool bCompact;
+  bool bMinimal;
+  bool bFirstElement;
+  bool bElementJustOpened;  // still inside the start tag
+  bool bFailed;
+};
+
+#endif